@@ -0,0 +1,514 @@
+// bench_box64_interp.c - 线程化代码解释器的校验和每秒指令数基准
+// 纯C，Linux上直接编译运行:
+//   ./run_portable_tests.sh bench_box64_interp
+// 先在一段含寄存器ALU、读改写内存、LEA、DEC+JNZ 的循环上对照C参考结果，
+// 再执行一个用 PUSH/POP、TEST、移位、IMUL、MOVZX/MOVSX、RET imm16 的函数，然后检查各种退出原因，
+// 最后与“每条指令一次 switch 分派 + 加锁并校验的寄存器写入”（旧的逐条模拟方式，不含ObjC消息发送开销）比较
+#include "Box64Interp.h"
+#include "Box64Trace.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define GUEST_SIZE      (1024 * 1024)
+#define CODE_BASE       0x1000ULL
+#define DATA_ADDRESS    0x8000ULL
+#define STACK_BASE      0xC0000ULL
+#define STACK_SIZE      0x10000ULL
+#define LOOP_INSNS      10
+#define VERIFY_ITERATIONS 1000
+#define BENCH_ITERATIONS  5000000
+
+static int failures = 0;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { printf("[InterpBench] ❌ " __VA_ARGS__); printf("\n"); failures++; } \
+} while (0)
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+//   mov ecx, N
+//   xor eax, eax
+//   mov rbx, DATA_ADDRESS
+// loop:
+//   add rax, rcx
+//   mov rdx, rax
+//   and edx, 0xFF
+//   add [rbx], rdx
+//   mov rsi, [rbx]
+//   xor rsi, rax
+//   lea rdi, [rsi + rcx*2]
+//   sub rdi, 3
+//   dec ecx
+//   jnz loop
+//   ret
+static size_t build_loop(uint8_t *code, uint32_t iterations) {
+    const uint8_t program[] = {
+        0xB9, 0, 0, 0, 0,
+        0x31, 0xC0,
+        0x48, 0xC7, 0xC3, 0x00, 0x80, 0x00, 0x00,
+        0x48, 0x01, 0xC8,
+        0x48, 0x89, 0xC2,
+        0x81, 0xE2, 0xFF, 0x00, 0x00, 0x00,
+        0x48, 0x01, 0x13,
+        0x48, 0x8B, 0x33,
+        0x48, 0x31, 0xC6,
+        0x48, 0x8D, 0x3C, 0x4E,
+        0x48, 0x83, 0xEF, 0x03,
+        0xFF, 0xC9,
+        0x75, 0xDF,
+        0xC3
+    };
+    memcpy(code, program, sizeof(program));
+    memcpy(code + 1, &iterations, sizeof(iterations));
+    return sizeof(program);
+}
+
+typedef struct Reference {
+    uint64_t rax, rdx, rsi, rdi, memory;
+} Reference;
+
+static Reference reference_loop(uint32_t iterations) {
+    Reference r = { 0, 0, 0, 0, 0 };
+    for (uint64_t c = iterations; c > 0; c--) {
+        r.rax += c;
+        r.rdx = (uint32_t)r.rax & 0xFF;
+        r.memory += r.rdx;
+        r.rsi = r.memory ^ r.rax;
+        r.rdi = r.rsi + c * 2 - 3;
+    }
+    return r;
+}
+
+// MARK: - 客户机环境
+
+typedef struct Guest {
+    Box64Context *ctx;
+    uint8_t *backing;
+    Box64TranslationCache *cache;
+    uint8_t code[256];
+    size_t code_length;
+} Guest;
+
+static bool guest_create(Guest *guest) {
+    memset(guest, 0, sizeof(*guest));
+    void *memory = NULL;
+    guest->ctx = calloc(1, sizeof(Box64Context));
+    guest->cache = box64_tc_create(64);
+    if (!guest->ctx || !guest->cache || posix_memalign(&memory, BOX64_PAGE_SIZE, GUEST_SIZE) != 0) {
+        return false;
+    }
+    guest->backing = memory;
+    memset(guest->backing, 0, GUEST_SIZE);
+    Box64Context *ctx = guest->ctx;
+    return box64_mmu_init(&ctx->mmu, guest->backing, GUEST_SIZE) &&
+           box64_mmu_map(&ctx->mmu, CODE_BASE, BOX64_PAGE_SIZE, BOX64_PROT_READ | BOX64_PROT_EXEC) &&
+           box64_mmu_map(&ctx->mmu, DATA_ADDRESS, BOX64_PAGE_SIZE, BOX64_PROT_READ | BOX64_PROT_WRITE) &&
+           box64_mmu_map(&ctx->mmu, STACK_BASE, STACK_SIZE, BOX64_PROT_READ | BOX64_PROT_WRITE);
+}
+
+static void guest_destroy(Guest *guest) {
+    if (guest->ctx) {
+        box64_mmu_destroy(&guest->ctx->mmu);
+    }
+    box64_tc_destroy(guest->cache);
+    free(guest->backing);
+    free(guest->ctx);
+}
+
+static void guest_reset(Guest *guest) {
+    Box64Context *ctx = guest->ctx;
+    memset(ctx->x86_regs, 0, sizeof(ctx->x86_regs));
+    box64_flags_set(ctx, 0x202);
+    ctx->stack_base = STACK_BASE;
+    ctx->stack_size = STACK_SIZE;
+    ctx->x86_regs[BOX64_INTERP_REG_RSP] = STACK_BASE + STACK_SIZE - 64;
+    ctx->rip = CODE_BASE;
+    ctx->instruction_count = 0;
+    box64_mmu_store(&ctx->mmu, DATA_ADDRESS, 8, 0);
+}
+
+// 与 Box64Engine 的执行循环相同的块查找/链接方式，快速层不支持的指令直接报告
+static Box64InterpExit run_threaded(Guest *guest, uint32_t max_instructions, Box64InterpResult *result) {
+    Box64Context *ctx = guest->ctx;
+    const Box64InterpBounds bounds = {
+        guest->cache, CODE_BASE, CODE_BASE + guest->code_length, max_instructions, 0, NULL
+    };
+    Box64Block *previous = NULL;
+    Box64BlockEdge edge = BOX64_EDGE_FALLTHROUGH;
+
+    for (;;) {
+        const uint64_t rip = ctx->rip;
+        if (rip < CODE_BASE || rip >= CODE_BASE + guest->code_length) {
+            return BOX64_INTERP_BLOCK_END;
+        }
+        Box64Block *block = previous ? box64_tc_follow(guest->cache, previous, edge, rip) : NULL;
+        if (!block) {
+            block = box64_tc_lookup(guest->cache, rip);
+            if (!block) {
+                block = box64_tc_translate(guest->cache, rip, guest->code + (rip - CODE_BASE),
+                                           guest->code_length - (size_t)(rip - CODE_BASE), NULL);
+                if (!block) {
+                    return BOX64_INTERP_FALLBACK;
+                }
+            }
+            if (previous) {
+                box64_tc_link(previous, edge, block);
+            }
+        }
+        box64_block_count_exec(block);
+
+        Box64InterpExit exit = box64_interp_run(ctx, &bounds, block, 0, result);
+        if (exit != BOX64_INTERP_BLOCK_END) {
+            return exit;
+        }
+        previous = result->block;
+        edge = ctx->rip == previous->successor_rip[BOX64_EDGE_FALLTHROUGH] ? BOX64_EDGE_FALLTHROUGH : BOX64_EDGE_TAKEN;
+    }
+}
+
+// MARK: - 旧方式：逐条 switch 分派
+
+static pthread_mutex_t register_lock;
+
+// 每次写寄存器都加锁，RSP 写入校验栈范围，相当于 writeGuestRegister / setX86Register
+__attribute__((noinline)) static bool locked_write(Box64Context *ctx, uint8_t reg, uint64_t value, uint8_t size) {
+    pthread_mutex_lock(&register_lock);
+    uint64_t merged = box64_merge_gpr(ctx->x86_regs[reg], value, size);
+    bool ok = reg != BOX64_INTERP_REG_RSP || (merged >= ctx->stack_base && merged < ctx->stack_base + ctx->stack_size);
+    if (ok) {
+        ctx->x86_regs[reg] = merged;
+    }
+    pthread_mutex_unlock(&register_lock);
+    return ok;
+}
+
+__attribute__((noinline)) static bool step_switch(Box64Context *ctx, const X86DecodedInsn *insn, uint64_t address) {
+    const bool memory = x86_insn_is_memory(insn);
+    const uint64_t next = address + insn->length;
+    const uint64_t ea = memory ? box64_effective_address(ctx, insn, next) : 0;
+    const uint8_t size = insn->operand_size;
+    uint64_t value;
+
+    switch (insn->map) {
+        case X86_MAP_PRIMARY:
+            switch (insn->opcode) {
+                case 0x01: case 0x31: {
+                    const uint8_t alu = insn->opcode >> 3;
+                    const uint64_t src = box64_read_gpr(ctx, insn->reg, size, insn->rex != 0);
+                    if (memory) {
+                        if (!box64_mmu_load(&ctx->mmu, ea, size, &value)) return false;
+                        return box64_mmu_store(&ctx->mmu, ea, size, box64_alu_compute(ctx, alu, value, src, size));
+                    }
+                    value = box64_alu_compute(ctx, alu, box64_read_gpr(ctx, insn->rm, size, insn->rex != 0), src, size);
+                    return locked_write(ctx, insn->rm, value, size);
+                }
+                case 0x81: case 0x83:
+                    value = box64_alu_compute(ctx, x86_insn_group_op(insn), box64_read_gpr(ctx, insn->rm, size, true),
+                                              (uint64_t)insn->imm, size);
+                    return locked_write(ctx, insn->rm, value, size);
+                case 0x89:
+                    return locked_write(ctx, insn->rm, box64_read_gpr(ctx, insn->reg, size, true), size);
+                case 0x8B:
+                    if (!box64_mmu_load(&ctx->mmu, ea, size, &value)) return false;
+                    return locked_write(ctx, insn->reg, value, size);
+                case 0x8D:
+                    return locked_write(ctx, insn->reg, ea, size);
+                case 0xB9: case 0xC7:
+                    return locked_write(ctx, insn->opcode == 0xB9 ? insn->reg : insn->rm,
+                                        box64_merge_gpr(0, (uint64_t)insn->imm, size), 8);
+                case 0xFF: {
+                    const uint64_t dst = box64_read_gpr(ctx, insn->rm, size, true);
+                    value = (dst - 1) & box64_size_mask(size);
+                    box64_flags_record_incdec(ctx, false, dst, value, size);
+                    return locked_write(ctx, insn->rm, value, size);
+                }
+                case 0x75:
+                    if (box64_flags_condition(ctx, 0x5)) {
+                        ctx->rip = next + (uint64_t)insn->imm;
+                    }
+                    return true;
+                case 0xC3:
+                    return true;
+                default:
+                    return false;
+            }
+        default:
+            return false;
+    }
+}
+
+// 每条指令后做一次完整安全检查，与旧执行循环相同
+static bool run_switch(Guest *guest) {
+    Box64Context *ctx = guest->ctx;
+    for (;;) {
+        const uint64_t rip = ctx->rip;
+        Box64Block *block = box64_tc_lookup(guest->cache, rip);
+        if (!block) {
+            block = box64_tc_translate(guest->cache, rip, guest->code + (rip - CODE_BASE),
+                                       guest->code_length - (size_t)(rip - CODE_BASE), NULL);
+            if (!block) {
+                return false;
+            }
+        }
+        uint64_t address = block->guest_start;
+        for (uint32_t i = 0; i < block->insn_count; i++) {
+            const X86DecodedInsn *insn = &block->insns[i];
+            ctx->rip = address + insn->length;
+            if (!step_switch(ctx, insn, address)) {
+                return false;
+            }
+            ctx->instruction_count++;
+            const uint64_t rsp = ctx->x86_regs[BOX64_INTERP_REG_RSP];
+            if (rsp < ctx->stack_base || rsp >= ctx->stack_base + ctx->stack_size) {
+                return false;
+            }
+            if (insn->opcode == 0xC3) {
+                return true;
+            }
+            address += insn->length;
+        }
+    }
+}
+
+// MARK: - 校验
+
+static bool matches_reference(const Guest *guest, uint32_t iterations, const char *label) {
+    const Reference expected = reference_loop(iterations);
+    const uint64_t *regs = guest->ctx->x86_regs;
+    uint64_t memory = 0;
+    box64_mmu_load(&guest->ctx->mmu, DATA_ADDRESS, 8, &memory);
+    const bool ok = regs[0] == expected.rax && regs[2] == expected.rdx && regs[6] == expected.rsi &&
+                    regs[7] == expected.rdi && regs[1] == 0 && memory == expected.memory;
+    CHECK(ok, "%s: rax %llx/%llx rsi %llx/%llx rdi %llx/%llx mem %llx/%llx", label,
+          (unsigned long long)regs[0], (unsigned long long)expected.rax, (unsigned long long)regs[6],
+          (unsigned long long)expected.rsi, (unsigned long long)regs[7], (unsigned long long)expected.rdi,
+          (unsigned long long)memory, (unsigned long long)expected.memory);
+    return ok;
+}
+
+static void verify_loop(Guest *guest) {
+    Box64InterpResult result;
+    guest->code_length = build_loop(guest->code, VERIFY_ITERATIONS);
+    guest_reset(guest);
+    Box64InterpExit exit = run_threaded(guest, UINT32_MAX, &result);
+    CHECK(exit == BOX64_INTERP_RETURN, "loop exit %d", exit);
+    CHECK(guest->ctx->instruction_count == 3 + VERIFY_ITERATIONS * LOOP_INSNS + 1, "instruction count %u",
+          guest->ctx->instruction_count);
+    CHECK(guest->ctx->rip == CODE_BASE + guest->code_length, "rip after RET 0x%llx", (unsigned long long)guest->ctx->rip);
+    matches_reference(guest, VERIFY_ITERATIONS, "threaded");
+
+    // 循环体块经链接直接回到自身，只有第一次经过执行循环
+    Box64TCStats stats;
+    box64_tc_get_stats(guest->cache, &stats);
+    CHECK(stats.chained >= VERIFY_ITERATIONS - 4, "loop not chained inside the interpreter: %llu",
+          (unsigned long long)stats.chained);
+
+    guest_reset(guest);
+    CHECK(run_switch(guest), "switch baseline failed");
+    matches_reference(guest, VERIFY_ITERATIONS, "switch");
+}
+
+// 保存被调用者寄存器，逐位统计 0xA5A5 中置位的个数，再做移位/乘法/扩展，最后 RET 16
+//   push rbx / push r12 / mov ebx, 0xA5A5 / xor r12d, r12d
+// loop:
+//   mov eax, ebx / test al, 1 / jz skip / inc r12d
+// skip:
+//   shr ebx, 1 / test ebx, ebx / jnz loop
+//   mov eax, r12d / shl rax, 4 / imul eax, eax, 3 / movzx ecx, al / movsx rdx, cl
+//   sar rdx, 3 / mov cl, 4 / shl rdx, cl / pop r12 / pop rbx / ret 16
+#define STACK_FUNCTION_INSNS (4 + 16 * 6 + 8 + 11)
+
+static void verify_stack_function(Guest *guest) {
+    static const uint8_t function[] = {
+        0x53, 0x41, 0x54, 0xBB, 0xA5, 0xA5, 0x00, 0x00, 0x45, 0x31, 0xE4,
+        0x89, 0xD8, 0xA8, 0x01, 0x74, 0x03, 0x41, 0xFF, 0xC4,
+        0xD1, 0xEB, 0x85, 0xDB, 0x75, 0xF1,
+        0x44, 0x89, 0xE0, 0x48, 0xC1, 0xE0, 0x04, 0x6B, 0xC0, 0x03,
+        0x0F, 0xB6, 0xC8, 0x48, 0x0F, 0xBE, 0xD1, 0x48, 0xC1, 0xFA, 0x03,
+        0xB1, 0x04, 0x48, 0xD3, 0xE2, 0x41, 0x5C, 0x5B, 0xC2, 0x10, 0x00
+    };
+    Box64InterpResult result;
+    memcpy(guest->code, function, sizeof(function));
+    guest->code_length = sizeof(function);
+    box64_tc_flush(guest->cache);
+    guest_reset(guest);
+    Box64Context *ctx = guest->ctx;
+    const uint64_t rsp = ctx->x86_regs[BOX64_INTERP_REG_RSP];
+    ctx->x86_regs[3] = 0x1111222233334444ULL;
+    ctx->x86_regs[12] = 0x5555666677778888ULL;
+
+    Box64InterpExit exit = run_threaded(guest, UINT32_MAX, &result);
+    CHECK(exit == BOX64_INTERP_RETURN, "stack function exit %d at 0x%llx", exit, (unsigned long long)ctx->rip);
+    CHECK(ctx->instruction_count == STACK_FUNCTION_INSNS, "stack function ran %u instructions", ctx->instruction_count);
+    CHECK(ctx->rip == CODE_BASE + sizeof(function) && result.stack_release == 16, "RET imm16: rip 0x%llx release %u",
+          (unsigned long long)ctx->rip, result.stack_release);
+
+    // popcount 8 → 8 << 4 = 0x80 → *3 = 0x180；AL = 0x80 → -128 >> 3 = -16 → << 4 = -256
+    const uint64_t *regs = ctx->x86_regs;
+    CHECK(regs[0] == 0x180 && regs[1] == 0x04 && regs[2] == 0xFFFFFFFFFFFFFF00ULL, "rax %llx rcx %llx rdx %llx",
+          (unsigned long long)regs[0], (unsigned long long)regs[1], (unsigned long long)regs[2]);
+    CHECK(regs[3] == 0x1111222233334444ULL && regs[12] == 0x5555666677778888ULL && regs[BOX64_INTERP_REG_RSP] == rsp,
+          "callee-saved rbx %llx r12 %llx rsp %llx", (unsigned long long)regs[3], (unsigned long long)regs[12],
+          (unsigned long long)regs[BOX64_INTERP_REG_RSP]);
+    uint64_t saved = 0;
+    box64_mmu_load(&ctx->mmu, rsp - 16, 8, &saved);
+    CHECK(saved == 0x5555666677778888ULL, "pushed r12 slot %llx", (unsigned long long)saved);
+    // 最后一条 shl rdx, 4 移出的位是 1
+    const uint64_t flags = box64_flags_materialize(ctx);
+    CHECK((flags & (X86_FLAG_CF | X86_FLAG_SF | X86_FLAG_ZF)) == (X86_FLAG_CF | X86_FLAG_SF), "flags after shl %llx",
+          (unsigned long long)flags);
+    for (uint32_t i = 0; i < result.block->insn_count; i++) {
+        CHECK(box64_interp_insn_supported(&result.block->insns[i]), "insn %u of the last block falls back", i);
+    }
+
+    // 移位组的其余子操作与 IMUL 溢出
+    box64_flags_set(ctx, 0x202 | X86_FLAG_CF);
+    CHECK(box64_shift_compute(ctx, 2, 0x80, 1, 1) == 0x01 && box64_flags_carry(ctx), "RCL8 through carry");
+    CHECK(box64_shift_compute(ctx, 1, 0x01, 1, 4) == 0x80000000U && box64_flags_carry(ctx), "ROR32");
+    CHECK(box64_shift_compute(ctx, 0, 0x8000000000000001ULL, 4, 8) == 0x18, "ROL64");
+    CHECK(box64_shift_compute(ctx, 7, 0x80, 7, 1) == 0xFF && !box64_flags_carry(ctx), "SAR8");
+    CHECK(box64_shift_compute(ctx, 5, 0xF8, 0x24, 1) == 0x0F && box64_flags_carry(ctx), "SHR8 count masked to 4");
+    box64_imul_compute(ctx, 0x10000, 0x10000, 4);
+    CHECK((box64_flags_materialize(ctx) & (X86_FLAG_CF | X86_FLAG_OF)) == (X86_FLAG_CF | X86_FLAG_OF), "IMUL32 overflow");
+    CHECK(box64_imul_compute(ctx, (uint64_t)-3, 7, 8) == (uint64_t)-21 &&
+          !(box64_flags_materialize(ctx) & X86_FLAG_OF), "IMUL64 negative");
+}
+
+// 预算、不支持的指令、缺页、跟踪环
+static void verify_exits(Guest *guest) {
+    Box64InterpResult result;
+
+    guest->code_length = build_loop(guest->code, VERIFY_ITERATIONS);
+    box64_tc_flush(guest->cache);
+    guest_reset(guest);
+    CHECK(run_threaded(guest, 25, &result) == BOX64_INTERP_LIMIT, "budget not enforced");
+    CHECK(guest->ctx->instruction_count == 25, "stopped after %u instructions", guest->ctx->instruction_count);
+    // 3条前导 + 2轮完整循环后，停在第三轮的第3条（and edx）
+    CHECK(guest->ctx->rip == CODE_BASE + 20 && result.index == 2, "limit rip 0x%llx index %u",
+          (unsigned long long)guest->ctx->rip, result.index);
+
+    // 第二条是 CPUID：执行 mov 后以 FALLBACK 退出，RIP 指向 CPUID
+    static const uint8_t fallback[] = { 0xB8, 0x07, 0x00, 0x00, 0x00, 0x0F, 0xA2, 0xC3 };
+    memcpy(guest->code, fallback, sizeof(fallback));
+    guest->code_length = sizeof(fallback);
+    box64_tc_flush(guest->cache);
+    guest_reset(guest);
+    CHECK(run_threaded(guest, UINT32_MAX, &result) == BOX64_INTERP_FALLBACK, "CPUID did not fall back");
+    CHECK(result.index == 1 && guest->ctx->rip == CODE_BASE + 5 && guest->ctx->x86_regs[0] == 7 &&
+          guest->ctx->instruction_count == 1, "fallback state rip 0x%llx", (unsigned long long)guest->ctx->rip);
+    CHECK(!box64_interp_insn_supported(&result.block->insns[1]), "CPUID reported as supported");
+
+    // mov rax, [0x20000]：未映射页
+    static const uint8_t faulting[] = { 0x48, 0x8B, 0x04, 0x25, 0x00, 0x00, 0x02, 0x00, 0xC3 };
+    memcpy(guest->code, faulting, sizeof(faulting));
+    guest->code_length = sizeof(faulting);
+    box64_tc_flush(guest->cache);
+    guest_reset(guest);
+    CHECK(run_threaded(guest, UINT32_MAX, &result) == BOX64_INTERP_FAULT, "unmapped load did not fault");
+    CHECK(result.fault_address == 0x20000 && result.fault_size == 8 && guest->ctx->rip == CODE_BASE,
+          "fault at 0x%llx size %u rip 0x%llx", (unsigned long long)result.fault_address, result.fault_size,
+          (unsigned long long)guest->ctx->rip);
+
+    // mov rdi, DATA+0xFF0; mov ecx, 32; mov al, 0xAB; rep stosb —— 后一页只读：
+    // 完成前16个元素后缺页，RIP 指向 rep stosb，RCX/RDI 只反映已完成的部分
+    CHECK(box64_mmu_map(&guest->ctx->mmu, DATA_ADDRESS + BOX64_PAGE_SIZE, BOX64_PAGE_SIZE, BOX64_PROT_READ),
+          "read-only page map failed");
+    static const uint8_t rep_fault[] = { 0x48, 0xC7, 0xC7, 0xF0, 0x8F, 0x00, 0x00, 0xB9, 0x20, 0x00, 0x00, 0x00,
+                                         0xB0, 0xAB, 0xF3, 0xAA, 0xC3 };
+    memcpy(guest->code, rep_fault, sizeof(rep_fault));
+    guest->code_length = sizeof(rep_fault);
+    box64_tc_flush(guest->cache);
+    guest_reset(guest);
+    uint64_t filled = 0;
+    CHECK(run_threaded(guest, UINT32_MAX, &result) == BOX64_INTERP_FAULT, "rep stosb into a read-only page did not fault");
+    box64_mmu_load(&guest->ctx->mmu, DATA_ADDRESS + 0xFF8, 8, &filled);
+    CHECK(guest->ctx->rip == CODE_BASE + 14 && result.fault_address == DATA_ADDRESS + BOX64_PAGE_SIZE &&
+          guest->ctx->x86_regs[1] == 16 && guest->ctx->x86_regs[7] == DATA_ADDRESS + BOX64_PAGE_SIZE &&
+          filled == 0xABABABABABABABABULL && guest->ctx->instruction_count == 3,
+          "rep stosb fault: rip 0x%llx rcx %llu rdi 0x%llx", (unsigned long long)guest->ctx->rip,
+          (unsigned long long)guest->ctx->x86_regs[1], (unsigned long long)guest->ctx->x86_regs[7]);
+
+    // xor eax, eax; add qword [DATA+0x1000], 1 —— 只读页上的读-改-写：缺页时标志仍是 xor 的结果
+    static const uint8_t rmw_fault[] = { 0x31, 0xC0, 0x48, 0x83, 0x04, 0x25, 0x00, 0x90, 0x00, 0x00, 0x01, 0xC3 };
+    memcpy(guest->code, rmw_fault, sizeof(rmw_fault));
+    guest->code_length = sizeof(rmw_fault);
+    box64_tc_flush(guest->cache);
+    guest_reset(guest);
+    CHECK(run_threaded(guest, UINT32_MAX, &result) == BOX64_INTERP_FAULT, "add to a read-only page did not fault");
+    CHECK(guest->ctx->rip == CODE_BASE + 2 && result.fault_address == DATA_ADDRESS + BOX64_PAGE_SIZE &&
+          box64_flags_condition(guest->ctx, 0x4), "rmw fault: rip 0x%llx, ZF lost", (unsigned long long)guest->ctx->rip);
+    box64_mmu_unmap(&guest->ctx->mmu, DATA_ADDRESS + BOX64_PAGE_SIZE, BOX64_PAGE_SIZE);
+
+    // 开启跟踪环后每条指令一条事件
+    Box64TraceRing *ring = box64_trace_ring_create(64);
+    Box64TraceEvent events[64];
+    guest->code_length = build_loop(guest->code, 2);
+    box64_tc_flush(guest->cache);
+    guest_reset(guest);
+    box64_trace_set_active(ring);
+    run_threaded(guest, UINT32_MAX, &result);
+    box64_trace_set_active(NULL);
+    size_t count = box64_trace_ring_snapshot(ring, events, 64);
+    CHECK(count == 3 + 2 * LOOP_INSNS + 1 && events[count - 1].rip == CODE_BASE + guest->code_length - 1 &&
+          events[count - 1].opcode == 0xC3, "trace recorded %zu events", count);
+    box64_trace_ring_destroy(ring);
+}
+
+// MARK: - 基准
+
+int main(void) {
+    Guest guest;
+    pthread_mutexattr_t attributes;
+    pthread_mutexattr_init(&attributes);
+    pthread_mutexattr_settype(&attributes, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&register_lock, &attributes);
+
+    if (!guest_create(&guest)) {
+        printf("[InterpBench] 客户机环境创建失败\n");
+        guest_destroy(&guest);
+        return 1;
+    }
+    verify_loop(&guest);
+    verify_stack_function(&guest);
+    verify_exits(&guest);
+    if (failures) {
+        printf("[InterpBench] %d failure(s)\n", failures);
+        guest_destroy(&guest);
+        return 1;
+    }
+    printf("[InterpBench] ✅ 结果与C参考一致，栈/移位/乘法函数正确，预算/回退/缺页/跟踪退出正确\n");
+
+    Box64InterpResult result;
+    guest.code_length = build_loop(guest.code, BENCH_ITERATIONS);
+    box64_tc_flush(guest.cache);
+
+    guest_reset(&guest);
+    double start = now_seconds();
+    run_switch(&guest);
+    const double switch_time = now_seconds() - start;
+    const double insns = (double)guest.ctx->instruction_count;
+    const bool switch_ok = matches_reference(&guest, BENCH_ITERATIONS, "switch bench");
+
+    guest_reset(&guest);
+    start = now_seconds();
+    run_threaded(&guest, UINT32_MAX, &result);
+    const double threaded_time = now_seconds() - start;
+    const bool threaded_ok = matches_reference(&guest, BENCH_ITERATIONS, "threaded bench");
+    guest_destroy(&guest);
+    if (!switch_ok || !threaded_ok) {
+        return 1;
+    }
+
+    printf("[InterpBench] switch + locked writes: %6.2f ns/insn  %8.1f M insn/s\n", switch_time * 1e9 / insns,
+           insns / switch_time / 1e6);
+    printf("[InterpBench] threaded code:          %6.2f ns/insn  %8.1f M insn/s  (%.2fx)\n",
+           threaded_time * 1e9 / insns, insns / threaded_time / 1e6, switch_time / threaded_time);
+    return 0;
+}
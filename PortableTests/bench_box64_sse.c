@@ -0,0 +1,640 @@
+// bench_box64_sse.c - SSE/SSE2 分类、执行语义的校验和吞吐基准
+// 纯C，Linux上直接编译运行:
+//   ./run_portable_tests.sh bench_box64_sse
+// 先检查强制前缀分类和访存宽度，再用随机输入把每个寄存器形式的内核与逐通道的C参考逐位比较，
+// 然后检查访存形式的清零/对齐/缺页、COMISS 标志、转换的不定值，以及线程化解释器中的SSE循环，
+// 最后与逐通道标量模拟比较每条指令的耗时
+#include "Box64SSE.h"
+#include "Box64Interp.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define GUEST_SIZE      (1024 * 1024)
+#define CODE_BASE       0x1000ULL
+#define DATA_ADDRESS    0x8000ULL       // 映射两页，其后一页不映射
+#define STACK_BASE      0xC0000ULL
+#define STACK_SIZE      0x10000ULL
+#define RANDOM_ROUNDS   2000
+#define LOOP_ITERATIONS 1000
+#define BENCH_ITERATIONS 2000000
+
+static int failures = 0;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { printf("[SSETest] ❌ " __VA_ARGS__); printf("\n"); failures++; } \
+} while (0)
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ULL;
+
+static uint64_t next_random(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+// 浮点通道偶尔取 ±0、相等值或超出 int32 范围的值，覆盖 MIN/MAX 与转换的边界
+static float random_float(void) {
+    switch (next_random() % 16) {
+        case 0: return 0.0f;
+        case 1: return -0.0f;
+        case 2: return 3.0e9f;
+        case 3: return -2.5f;
+        default: return (float)((int64_t)(next_random() % 2000001) - 1000000) / 64.0f;
+    }
+}
+
+static double random_double(void) {
+    return (double)random_float() * 1.25;
+}
+
+// MARK: - 客户机环境
+
+typedef struct Guest {
+    Box64Context *ctx;
+    uint8_t *backing;
+    Box64TranslationCache *cache;
+    uint8_t code[256];
+    size_t code_length;
+} Guest;
+
+static bool guest_create(Guest *guest) {
+    memset(guest, 0, sizeof(*guest));
+    void *memory = NULL;
+    guest->ctx = calloc(1, sizeof(Box64Context));
+    guest->cache = box64_tc_create(64);
+    if (!guest->ctx || !guest->cache || posix_memalign(&memory, BOX64_PAGE_SIZE, GUEST_SIZE) != 0) {
+        return false;
+    }
+    guest->backing = memory;
+    memset(guest->backing, 0, GUEST_SIZE);
+    Box64Context *ctx = guest->ctx;
+    box64_sse_reset(ctx);
+    return box64_mmu_init(&ctx->mmu, guest->backing, GUEST_SIZE) &&
+           box64_mmu_map(&ctx->mmu, CODE_BASE, BOX64_PAGE_SIZE, BOX64_PROT_READ | BOX64_PROT_EXEC) &&
+           box64_mmu_map(&ctx->mmu, DATA_ADDRESS, 2 * BOX64_PAGE_SIZE, BOX64_PROT_READ | BOX64_PROT_WRITE) &&
+           box64_mmu_map(&ctx->mmu, STACK_BASE, STACK_SIZE, BOX64_PROT_READ | BOX64_PROT_WRITE);
+}
+
+static void guest_destroy(Guest *guest) {
+    if (guest->ctx) {
+        box64_mmu_destroy(&guest->ctx->mmu);
+    }
+    box64_tc_destroy(guest->cache);
+    free(guest->backing);
+    free(guest->ctx);
+}
+
+static bool decode(const uint8_t *bytes, size_t length, X86DecodedInsn *insn) {
+    return x86_decode(bytes, length, insn) == X86_DECODE_OK && insn->length == length;
+}
+
+// 解码并执行一条指令，RIP 取 CODE_BASE
+static Box64SseStatus run_bytes(Box64Context *ctx, const uint8_t *bytes, size_t length, uint64_t *fault) {
+    X86DecodedInsn insn;
+    if (!decode(bytes, length, &insn)) {
+        return BOX64_SSE_UNSUPPORTED;
+    }
+    return box64_sse_execute(ctx, &insn, box64_sse_classify(&insn), CODE_BASE + length, fault);
+}
+
+// MARK: - 分类
+
+typedef struct ClassifyCase {
+    uint8_t bytes[8];
+    uint8_t length;
+    Box64SseOp op;
+    uint8_t memory_size;
+} ClassifyCase;
+
+static void test_classify(void) {
+    static const ClassifyCase cases[] = {
+        { { 0x0F, 0x58, 0xCA }, 3, BOX64_SSE_ADDPS, 0 },
+        { { 0x66, 0x0F, 0x58, 0xCA }, 4, BOX64_SSE_ADDPD, 0 },
+        { { 0xF3, 0x0F, 0x58, 0x0B }, 4, BOX64_SSE_ADDSS, 4 },
+        { { 0xF2, 0x0F, 0x58, 0x0B }, 4, BOX64_SSE_ADDSD, 8 },
+        { { 0x66, 0xF2, 0x0F, 0x58, 0xCA }, 5, BOX64_SSE_ADDSD, 0 },     // F2 优先于 66
+        { { 0x0F, 0x10, 0x0B }, 3, BOX64_SSE_MOVUPS_LOAD, 16 },
+        { { 0xF3, 0x0F, 0x10, 0x0B }, 4, BOX64_SSE_MOVSS_LOAD, 4 },
+        { { 0xF3, 0x0F, 0x6F, 0x0B }, 4, BOX64_SSE_MOVUPS_LOAD, 16 },    // MOVDQU
+        { { 0x66, 0x0F, 0x6F, 0x0B }, 4, BOX64_SSE_MOVAPS_LOAD, 16 },    // MOVDQA
+        { { 0x66, 0x0F, 0xEF, 0xC0 }, 4, BOX64_SSE_XORPS, 0 },           // PXOR
+        { { 0x66, 0x0F, 0xFE, 0xCA }, 4, BOX64_SSE_PADDD, 0 },
+        { { 0x66, 0x0F, 0xD7, 0xC2 }, 4, BOX64_SSE_PMOVMSKB, 0 },
+        { { 0x66, 0x0F, 0x70, 0xCA, 0x1B }, 5, BOX64_SSE_PSHUFD, 0 },
+        { { 0x66, 0x48, 0x0F, 0x6E, 0xC8 }, 5, BOX64_SSE_MOVD_TO_XMM, 0 },
+        { { 0x66, 0x48, 0x0F, 0x7E, 0x0B }, 5, BOX64_SSE_MOVD_FROM_XMM, 8 },
+        { { 0xF2, 0x48, 0x0F, 0x2A, 0x0B }, 5, BOX64_SSE_CVTSI2SD, 8 },
+        { { 0xF3, 0x0F, 0x2C, 0xC2 }, 4, BOX64_SSE_CVTTSS2SI, 0 },
+        { { 0x0F, 0x2E, 0xCA }, 3, BOX64_SSE_COMISS, 0 },
+        { { 0x0F, 0xFC, 0xCA }, 3, BOX64_SSE_NONE, 0 },                  // MMX PADDB
+        { { 0x0F, 0x2B, 0xCA }, 3, BOX64_SSE_NONE, 0 },                  // MOVNTPS 没有寄存器形式
+        { { 0x0F, 0xAF, 0xC1 }, 3, BOX64_SSE_NONE, 0 },                  // IMUL
+    };
+    for (size_t n = 0; n < sizeof(cases) / sizeof(cases[0]); n++) {
+        const ClassifyCase *c = &cases[n];
+        X86DecodedInsn insn;
+        if (!decode(c->bytes, c->length, &insn)) {
+            CHECK(false, "case %zu failed to decode", n);
+            continue;
+        }
+        const Box64SseOp op = box64_sse_classify(&insn);
+        CHECK(op == c->op, "case %zu classified as %s, expected %s", n, box64_sse_op_name(op), box64_sse_op_name(c->op));
+        CHECK(box64_sse_memory_size(op, &insn) == c->memory_size, "case %zu memory size %u", n,
+              box64_sse_memory_size(op, &insn));
+        CHECK(op == BOX64_SSE_NONE || box64_interp_insn_supported(&insn), "case %zu not taken by interpreter", n);
+    }
+}
+
+// MARK: - 随机输入对照
+
+typedef struct PackedCase {
+    uint8_t bytes[6];
+    uint8_t length;
+    Box64SseOp op;
+} PackedCase;
+
+// 所有寄存器形式都是 xmm1 ← xmm1 op xmm2（ModRM 0xCA），带 imm8 的放在末尾字节
+static const PackedCase packed_cases[] = {
+    { { 0x0F, 0x54, 0xCA }, 3, BOX64_SSE_ANDPS },
+    { { 0x0F, 0x55, 0xCA }, 3, BOX64_SSE_ANDNPS },
+    { { 0x0F, 0x56, 0xCA }, 3, BOX64_SSE_ORPS },
+    { { 0x0F, 0x57, 0xCA }, 3, BOX64_SSE_XORPS },
+    { { 0x66, 0x0F, 0xFC, 0xCA }, 4, BOX64_SSE_PADDB },
+    { { 0x66, 0x0F, 0xFD, 0xCA }, 4, BOX64_SSE_PADDW },
+    { { 0x66, 0x0F, 0xFE, 0xCA }, 4, BOX64_SSE_PADDD },
+    { { 0x66, 0x0F, 0xD4, 0xCA }, 4, BOX64_SSE_PADDQ },
+    { { 0x66, 0x0F, 0xF8, 0xCA }, 4, BOX64_SSE_PSUBB },
+    { { 0x66, 0x0F, 0xF9, 0xCA }, 4, BOX64_SSE_PSUBW },
+    { { 0x66, 0x0F, 0xFA, 0xCA }, 4, BOX64_SSE_PSUBD },
+    { { 0x66, 0x0F, 0xFB, 0xCA }, 4, BOX64_SSE_PSUBQ },
+    { { 0x66, 0x0F, 0x74, 0xCA }, 4, BOX64_SSE_PCMPEQB },
+    { { 0x66, 0x0F, 0x75, 0xCA }, 4, BOX64_SSE_PCMPEQW },
+    { { 0x66, 0x0F, 0x76, 0xCA }, 4, BOX64_SSE_PCMPEQD },
+    { { 0x0F, 0x58, 0xCA }, 3, BOX64_SSE_ADDPS },
+    { { 0x0F, 0x5C, 0xCA }, 3, BOX64_SSE_SUBPS },
+    { { 0x0F, 0x59, 0xCA }, 3, BOX64_SSE_MULPS },
+    { { 0x0F, 0x5E, 0xCA }, 3, BOX64_SSE_DIVPS },
+    { { 0x0F, 0x5D, 0xCA }, 3, BOX64_SSE_MINPS },
+    { { 0x0F, 0x5F, 0xCA }, 3, BOX64_SSE_MAXPS },
+    { { 0x0F, 0x51, 0xCA }, 3, BOX64_SSE_SQRTPS },
+    { { 0x66, 0x0F, 0x58, 0xCA }, 4, BOX64_SSE_ADDPD },
+    { { 0x66, 0x0F, 0x5C, 0xCA }, 4, BOX64_SSE_SUBPD },
+    { { 0x66, 0x0F, 0x59, 0xCA }, 4, BOX64_SSE_MULPD },
+    { { 0x66, 0x0F, 0x5E, 0xCA }, 4, BOX64_SSE_DIVPD },
+    { { 0x66, 0x0F, 0x5D, 0xCA }, 4, BOX64_SSE_MINPD },
+    { { 0x66, 0x0F, 0x5F, 0xCA }, 4, BOX64_SSE_MAXPD },
+    { { 0x66, 0x0F, 0x51, 0xCA }, 4, BOX64_SSE_SQRTPD },
+    { { 0xF3, 0x0F, 0x58, 0xCA }, 4, BOX64_SSE_ADDSS },
+    { { 0xF3, 0x0F, 0x5D, 0xCA }, 4, BOX64_SSE_MINSS },
+    { { 0xF2, 0x0F, 0x59, 0xCA }, 4, BOX64_SSE_MULSD },
+    { { 0xF2, 0x0F, 0x5F, 0xCA }, 4, BOX64_SSE_MAXSD },
+    { { 0x0F, 0xC6, 0xCA, 0x00 }, 4, BOX64_SSE_SHUFPS },
+    { { 0x66, 0x0F, 0xC6, 0xCA, 0x00 }, 5, BOX64_SSE_SHUFPD },
+    { { 0x66, 0x0F, 0x70, 0xCA, 0x00 }, 5, BOX64_SSE_PSHUFD },
+    { { 0x0F, 0x5B, 0xCA }, 3, BOX64_SSE_CVTDQ2PS },
+    { { 0x66, 0x0F, 0x5B, 0xCA }, 4, BOX64_SSE_CVTPS2DQ },
+    { { 0xF3, 0x0F, 0x5B, 0xCA }, 4, BOX64_SSE_CVTTPS2DQ },
+    { { 0x0F, 0x5A, 0xCA }, 3, BOX64_SSE_CVTPS2PD },
+    { { 0x66, 0x0F, 0x5A, 0xCA }, 4, BOX64_SSE_CVTPD2PS },
+    { { 0xF3, 0x0F, 0x5A, 0xCA }, 4, BOX64_SSE_CVTSS2SD },
+    { { 0xF2, 0x0F, 0x5A, 0xCA }, 4, BOX64_SSE_CVTSD2SS },
+};
+
+static bool uses_double(Box64SseOp op) {
+    switch (op) {
+        case BOX64_SSE_ADDPD: case BOX64_SSE_SUBPD: case BOX64_SSE_MULPD: case BOX64_SSE_DIVPD:
+        case BOX64_SSE_MINPD: case BOX64_SSE_MAXPD: case BOX64_SSE_SQRTPD: case BOX64_SSE_MULSD:
+        case BOX64_SSE_MAXSD: case BOX64_SSE_CVTPD2PS: case BOX64_SSE_CVTSD2SS:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static int32_t reference_cvt(float value, bool truncate) {
+    const float rounded = truncate ? truncf(value) : nearbyintf(value);
+    return (rounded >= -2147483648.0f && rounded < 2147483648.0f) ? (int32_t)rounded : INT32_MIN;
+}
+
+// 逐通道的C参考实现（也是吞吐比较里的“标量模拟”一侧）
+__attribute__((noinline)) static void reference(Box64SseOp op, Box64Xmm *d, const Box64Xmm *s, uint8_t imm) {
+    const Box64Xmm a = *d;
+    switch (op) {
+        case BOX64_SSE_ANDPS:  for (int l = 0; l < 2; l++) d->u64[l] = a.u64[l] & s->u64[l]; break;
+        case BOX64_SSE_ANDNPS: for (int l = 0; l < 2; l++) d->u64[l] = ~a.u64[l] & s->u64[l]; break;
+        case BOX64_SSE_ORPS:   for (int l = 0; l < 2; l++) d->u64[l] = a.u64[l] | s->u64[l]; break;
+        case BOX64_SSE_XORPS:  for (int l = 0; l < 2; l++) d->u64[l] = a.u64[l] ^ s->u64[l]; break;
+        case BOX64_SSE_PADDB:  for (int l = 0; l < 16; l++) d->u8[l] = (uint8_t)(a.u8[l] + s->u8[l]); break;
+        case BOX64_SSE_PADDW:  for (int l = 0; l < 8; l++) d->u16[l] = (uint16_t)(a.u16[l] + s->u16[l]); break;
+        case BOX64_SSE_PADDD:  for (int l = 0; l < 4; l++) d->u32[l] = a.u32[l] + s->u32[l]; break;
+        case BOX64_SSE_PADDQ:  for (int l = 0; l < 2; l++) d->u64[l] = a.u64[l] + s->u64[l]; break;
+        case BOX64_SSE_PSUBB:  for (int l = 0; l < 16; l++) d->u8[l] = (uint8_t)(a.u8[l] - s->u8[l]); break;
+        case BOX64_SSE_PSUBW:  for (int l = 0; l < 8; l++) d->u16[l] = (uint16_t)(a.u16[l] - s->u16[l]); break;
+        case BOX64_SSE_PSUBD:  for (int l = 0; l < 4; l++) d->u32[l] = a.u32[l] - s->u32[l]; break;
+        case BOX64_SSE_PSUBQ:  for (int l = 0; l < 2; l++) d->u64[l] = a.u64[l] - s->u64[l]; break;
+        case BOX64_SSE_PCMPEQB: for (int l = 0; l < 16; l++) d->u8[l] = a.u8[l] == s->u8[l] ? 0xFF : 0; break;
+        case BOX64_SSE_PCMPEQW: for (int l = 0; l < 8; l++) d->u16[l] = a.u16[l] == s->u16[l] ? 0xFFFF : 0; break;
+        case BOX64_SSE_PCMPEQD: for (int l = 0; l < 4; l++) d->u32[l] = a.u32[l] == s->u32[l] ? 0xFFFFFFFFu : 0; break;
+        case BOX64_SSE_ADDPS:  for (int l = 0; l < 4; l++) d->f32[l] = a.f32[l] + s->f32[l]; break;
+        case BOX64_SSE_SUBPS:  for (int l = 0; l < 4; l++) d->f32[l] = a.f32[l] - s->f32[l]; break;
+        case BOX64_SSE_MULPS:  for (int l = 0; l < 4; l++) d->f32[l] = a.f32[l] * s->f32[l]; break;
+        case BOX64_SSE_DIVPS:  for (int l = 0; l < 4; l++) d->f32[l] = a.f32[l] / s->f32[l]; break;
+        case BOX64_SSE_MINPS:  for (int l = 0; l < 4; l++) d->f32[l] = a.f32[l] < s->f32[l] ? a.f32[l] : s->f32[l]; break;
+        case BOX64_SSE_MAXPS:  for (int l = 0; l < 4; l++) d->f32[l] = a.f32[l] > s->f32[l] ? a.f32[l] : s->f32[l]; break;
+        case BOX64_SSE_SQRTPS: for (int l = 0; l < 4; l++) d->f32[l] = sqrtf(s->f32[l]); break;
+        case BOX64_SSE_ADDPD:  for (int l = 0; l < 2; l++) d->f64[l] = a.f64[l] + s->f64[l]; break;
+        case BOX64_SSE_SUBPD:  for (int l = 0; l < 2; l++) d->f64[l] = a.f64[l] - s->f64[l]; break;
+        case BOX64_SSE_MULPD:  for (int l = 0; l < 2; l++) d->f64[l] = a.f64[l] * s->f64[l]; break;
+        case BOX64_SSE_DIVPD:  for (int l = 0; l < 2; l++) d->f64[l] = a.f64[l] / s->f64[l]; break;
+        case BOX64_SSE_MINPD:  for (int l = 0; l < 2; l++) d->f64[l] = a.f64[l] < s->f64[l] ? a.f64[l] : s->f64[l]; break;
+        case BOX64_SSE_MAXPD:  for (int l = 0; l < 2; l++) d->f64[l] = a.f64[l] > s->f64[l] ? a.f64[l] : s->f64[l]; break;
+        case BOX64_SSE_SQRTPD: for (int l = 0; l < 2; l++) d->f64[l] = sqrt(s->f64[l]); break;
+        case BOX64_SSE_ADDSS:  d->f32[0] = a.f32[0] + s->f32[0]; break;
+        case BOX64_SSE_MINSS:  d->f32[0] = a.f32[0] < s->f32[0] ? a.f32[0] : s->f32[0]; break;
+        case BOX64_SSE_MULSD:  d->f64[0] = a.f64[0] * s->f64[0]; break;
+        case BOX64_SSE_MAXSD:  d->f64[0] = a.f64[0] > s->f64[0] ? a.f64[0] : s->f64[0]; break;
+        case BOX64_SSE_SHUFPS:
+            for (int l = 0; l < 4; l++) d->u32[l] = (l < 2 ? a : *s).u32[(imm >> (l * 2)) & 3];
+            break;
+        case BOX64_SSE_SHUFPD:
+            d->u64[0] = a.u64[imm & 1];
+            d->u64[1] = s->u64[(imm >> 1) & 1];
+            break;
+        case BOX64_SSE_PSHUFD:  for (int l = 0; l < 4; l++) d->u32[l] = s->u32[(imm >> (l * 2)) & 3]; break;
+        case BOX64_SSE_CVTDQ2PS:  for (int l = 0; l < 4; l++) d->f32[l] = (float)s->i32[l]; break;
+        case BOX64_SSE_CVTPS2DQ:  for (int l = 0; l < 4; l++) d->i32[l] = reference_cvt(s->f32[l], false); break;
+        case BOX64_SSE_CVTTPS2DQ: for (int l = 0; l < 4; l++) d->i32[l] = reference_cvt(s->f32[l], true); break;
+        case BOX64_SSE_CVTPS2PD:  d->f64[0] = s->f32[0]; d->f64[1] = s->f32[1]; break;
+        case BOX64_SSE_CVTPD2PS:  d->f32[0] = (float)s->f64[0]; d->f32[1] = (float)s->f64[1]; d->u64[1] = 0; break;
+        case BOX64_SSE_CVTSS2SD:  d->f64[0] = s->f32[0]; break;
+        case BOX64_SSE_CVTSD2SS:  d->f32[0] = (float)s->f64[0]; break;
+        default: break;
+    }
+}
+
+static void fill_random(Box64Xmm *x, bool doubles) {
+    if (doubles) {
+        x->f64[0] = random_double();
+        x->f64[1] = next_random() % 8 == 0 ? x->f64[0] : random_double();
+    } else {
+        for (int l = 0; l < 4; l++) {
+            x->f32[l] = random_float();
+        }
+    }
+    // 整数通道偶尔制造相等的字节，覆盖 PCMPEQ 的命中
+    if (next_random() % 4 == 0) {
+        x->u64[1] = x->u64[0];
+    }
+}
+
+static void test_packed(Box64Context *ctx) {
+    for (size_t n = 0; n < sizeof(packed_cases) / sizeof(packed_cases[0]); n++) {
+        PackedCase c = packed_cases[n];
+        X86DecodedInsn insn;
+        if (!decode(c.bytes, c.length, &insn) || box64_sse_classify(&insn) != c.op) {
+            CHECK(false, "%s: decode/classify mismatch", box64_sse_op_name(c.op));
+            continue;
+        }
+        int mismatches = 0;
+        for (int round = 0; round < RANDOM_ROUNDS; round++) {
+            const uint8_t imm = (uint8_t)next_random();
+            insn.imm = imm;
+            fill_random(&ctx->xmm[1], uses_double(c.op));
+            fill_random(&ctx->xmm[2], uses_double(c.op));
+            if (round % 7 == 0) {
+                ctx->xmm[2] = ctx->xmm[1];
+            }
+            Box64Xmm expected = ctx->xmm[1];
+            reference(c.op, &expected, &ctx->xmm[2], imm);
+            if (box64_sse_execute(ctx, &insn, c.op, CODE_BASE + c.length, NULL) != BOX64_SSE_OK ||
+                memcmp(&expected, &ctx->xmm[1], sizeof(expected)) != 0) {
+                mismatches++;
+            }
+        }
+        CHECK(mismatches == 0, "%s: %d/%d random inputs differ from reference", box64_sse_op_name(c.op),
+              mismatches, RANDOM_ROUNDS);
+    }
+}
+
+// MARK: - 访存、标志与转换
+
+static void test_memory(Guest *guest) {
+    Box64Context *ctx = guest->ctx;
+    uint64_t fault = 0;
+    uint8_t pattern[32];
+    for (int n = 0; n < 32; n++) {
+        pattern[n] = (uint8_t)(0xA0 + n);
+    }
+    box64_mmu_copy_to_guest(&ctx->mmu, DATA_ADDRESS, pattern, sizeof(pattern));
+    ctx->x86_regs[3] = DATA_ADDRESS;
+
+    // MOVSS xmm1, [rbx]：高96位清零；MOVSS xmm1, xmm2：只替换低32位
+    memset(ctx->xmm[1].u8, 0xFF, 16);
+    static const uint8_t movss_load[] = { 0xF3, 0x0F, 0x10, 0x0B };
+    CHECK(run_bytes(ctx, movss_load, sizeof(movss_load), &fault) == BOX64_SSE_OK, "MOVSS load failed");
+    CHECK(ctx->xmm[1].u32[0] == 0xA3A2A1A0u && ctx->xmm[1].u32[1] == 0 && ctx->xmm[1].u64[1] == 0,
+          "MOVSS load did not zero upper lanes");
+    ctx->xmm[2].u64[0] = 0x1111111122222222ULL;
+    memset(ctx->xmm[1].u8, 0xFF, 16);
+    static const uint8_t movss_reg[] = { 0xF3, 0x0F, 0x10, 0xCA };
+    CHECK(run_bytes(ctx, movss_reg, sizeof(movss_reg), &fault) == BOX64_SSE_OK &&
+          ctx->xmm[1].u32[0] == 0x22222222u && ctx->xmm[1].u32[1] == 0xFFFFFFFFu, "MOVSS reg merged wrong");
+
+    // MOVQ xmm1, [rbx]：高64位清零
+    memset(ctx->xmm[1].u8, 0xFF, 16);
+    static const uint8_t movq_load[] = { 0xF3, 0x0F, 0x7E, 0x0B };
+    CHECK(run_bytes(ctx, movq_load, sizeof(movq_load), &fault) == BOX64_SSE_OK &&
+          ctx->xmm[1].u64[0] == 0xA7A6A5A4A3A2A1A0ULL && ctx->xmm[1].u64[1] == 0, "MOVQ load wrong");
+
+    // MOVAPS 要求对齐，MOVUPS 不要求
+    static const uint8_t movaps_load[] = { 0x0F, 0x28, 0x0B };
+    static const uint8_t movups_load[] = { 0x0F, 0x10, 0x0B };
+    ctx->x86_regs[3] = DATA_ADDRESS + 4;
+    CHECK(run_bytes(ctx, movaps_load, sizeof(movaps_load), &fault) == BOX64_SSE_MISALIGNED, "MOVAPS misaligned accepted");
+    CHECK(run_bytes(ctx, movups_load, sizeof(movups_load), &fault) == BOX64_SSE_OK &&
+          ctx->xmm[1].u8[0] == 0xA4 && ctx->xmm[1].u8[15] == 0xB3, "MOVUPS unaligned load wrong");
+
+    // 跨页的 MOVUPS 存储走逐字节复制；写到未映射页报告缺页且不改内存
+    static const uint8_t movups_store[] = { 0x0F, 0x11, 0x0B };
+    memset(ctx->xmm[1].u8, 0x5A, 16);
+    ctx->x86_regs[3] = DATA_ADDRESS + BOX64_PAGE_SIZE - 8;
+    CHECK(run_bytes(ctx, movups_store, sizeof(movups_store), &fault) == BOX64_SSE_OK, "cross-page MOVUPS store failed");
+    uint64_t word = 0;
+    box64_mmu_load(&ctx->mmu, DATA_ADDRESS + BOX64_PAGE_SIZE, 8, &word);
+    CHECK(word == 0x5A5A5A5A5A5A5A5AULL, "cross-page store wrote 0x%llx", (unsigned long long)word);
+    ctx->x86_regs[3] = DATA_ADDRESS + 2 * BOX64_PAGE_SIZE - 8;
+    CHECK(run_bytes(ctx, movups_store, sizeof(movups_store), &fault) == BOX64_SSE_FAULT &&
+          fault == DATA_ADDRESS + 2 * BOX64_PAGE_SIZE - 8, "store into unmapped page not reported");
+    box64_mmu_load(&ctx->mmu, DATA_ADDRESS + 2 * BOX64_PAGE_SIZE - 8, 8, &word);
+    CHECK(word == 0, "faulting store modified memory");
+
+    // ADDPS xmm1, [rbx] 的16字节源
+    ctx->x86_regs[3] = DATA_ADDRESS + 64;
+    const float addend[4] = { 1.0f, 2.0f, 3.0f, 4.0f };
+    box64_mmu_copy_to_guest(&ctx->mmu, DATA_ADDRESS + 64, addend, sizeof(addend));
+    for (int l = 0; l < 4; l++) {
+        ctx->xmm[1].f32[l] = 0.5f;
+    }
+    static const uint8_t addps_mem[] = { 0x0F, 0x58, 0x0B };
+    CHECK(run_bytes(ctx, addps_mem, sizeof(addps_mem), &fault) == BOX64_SSE_OK &&
+          ctx->xmm[1].f32[0] == 1.5f && ctx->xmm[1].f32[3] == 4.5f, "ADDPS memory source wrong");
+}
+
+static void test_scalar(Box64Context *ctx) {
+    uint64_t fault = 0;
+    static const uint8_t comiss[] = { 0x0F, 0x2F, 0xCA };
+    const struct { float a, b; uint64_t flags; } compares[] = {
+        { 1.0f, 2.0f, X86_FLAG_CF },
+        { 2.0f, 1.0f, 0 },
+        { 3.0f, 3.0f, X86_FLAG_ZF },
+        { NAN, 1.0f, X86_FLAG_ZF | X86_FLAG_PF | X86_FLAG_CF },
+    };
+    for (size_t n = 0; n < sizeof(compares) / sizeof(compares[0]); n++) {
+        box64_flags_set(ctx, 0x202 | X86_FLAG_SF | X86_FLAG_OF);
+        ctx->xmm[1].f32[0] = compares[n].a;
+        ctx->xmm[2].f32[0] = compares[n].b;
+        CHECK(run_bytes(ctx, comiss, sizeof(comiss), &fault) == BOX64_SSE_OK, "COMISS failed");
+        CHECK((ctx->rflags & X86_FLAGS_ARITH) == compares[n].flags && (ctx->rflags & 0x200),
+              "COMISS case %zu flags 0x%llx", n, (unsigned long long)ctx->rflags);
+    }
+
+    // CVTTSS2SI eax / rax：截断；越界得到不定值；32位形式清零RAX高32位
+    static const uint8_t cvttss2si[] = { 0xF3, 0x0F, 0x2C, 0xC2 };
+    static const uint8_t cvttss2si64[] = { 0xF3, 0x48, 0x0F, 0x2C, 0xC2 };
+    ctx->x86_regs[0] = ~0ULL;
+    ctx->xmm[2].f32[0] = -7.9f;
+    CHECK(run_bytes(ctx, cvttss2si, sizeof(cvttss2si), &fault) == BOX64_SSE_OK &&
+          ctx->x86_regs[0] == 0xFFFFFFF9ULL, "CVTTSS2SI -7.9 gave 0x%llx", (unsigned long long)ctx->x86_regs[0]);
+    ctx->xmm[2].f32[0] = 3.0e9f;
+    run_bytes(ctx, cvttss2si, sizeof(cvttss2si), &fault);
+    CHECK(ctx->x86_regs[0] == 0x80000000ULL, "CVTTSS2SI overflow gave 0x%llx", (unsigned long long)ctx->x86_regs[0]);
+    run_bytes(ctx, cvttss2si64, sizeof(cvttss2si64), &fault);
+    CHECK(ctx->x86_regs[0] == 3000000000ULL, "CVTTSS2SI r64 gave %llu", (unsigned long long)ctx->x86_regs[0]);
+    ctx->xmm[2].f32[0] = NAN;
+    run_bytes(ctx, cvttss2si64, sizeof(cvttss2si64), &fault);
+    CHECK(ctx->x86_regs[0] == 0x8000000000000000ULL, "CVTTSS2SI NaN gave 0x%llx", (unsigned long long)ctx->x86_regs[0]);
+
+    // CVTSD2SI 按 MXCSR 舍入：默认就近偶数，RC=01 向下
+    static const uint8_t cvtsd2si[] = { 0xF2, 0x0F, 0x2D, 0xC2 };
+    ctx->xmm[2].f64[0] = 2.5;
+    run_bytes(ctx, cvtsd2si, sizeof(cvtsd2si), &fault);
+    CHECK(ctx->x86_regs[0] == 2, "CVTSD2SI 2.5 nearest gave %llu", (unsigned long long)ctx->x86_regs[0]);
+    ctx->mxcsr = BOX64_MXCSR_DEFAULT | (1u << BOX64_MXCSR_RC_SHIFT);
+    ctx->xmm[2].f64[0] = -2.5;
+    run_bytes(ctx, cvtsd2si, sizeof(cvtsd2si), &fault);
+    CHECK(ctx->x86_regs[0] == 0xFFFFFFFDULL, "CVTSD2SI -2.5 floor gave 0x%llx", (unsigned long long)ctx->x86_regs[0]);
+    ctx->mxcsr = BOX64_MXCSR_DEFAULT;
+
+    // CVTSI2SD xmm1, rax；MOVD xmm1, eax 清零高位；MOVQ rax, xmm1
+    static const uint8_t cvtsi2sd[] = { 0xF2, 0x48, 0x0F, 0x2A, 0xC8 };
+    static const uint8_t movd_to[] = { 0x66, 0x0F, 0x6E, 0xC8 };
+    static const uint8_t movq_from[] = { 0x66, 0x48, 0x0F, 0x7E, 0xC8 };
+    ctx->x86_regs[0] = (uint64_t)-5;
+    CHECK(run_bytes(ctx, cvtsi2sd, sizeof(cvtsi2sd), &fault) == BOX64_SSE_OK && ctx->xmm[1].f64[0] == -5.0,
+          "CVTSI2SD gave %f", ctx->xmm[1].f64[0]);
+    ctx->x86_regs[0] = 0xDEADBEEFCAFEF00DULL;
+    memset(ctx->xmm[1].u8, 0xFF, 16);
+    run_bytes(ctx, movd_to, sizeof(movd_to), &fault);
+    CHECK(ctx->xmm[1].u64[0] == 0xCAFEF00DULL && ctx->xmm[1].u64[1] == 0, "MOVD to xmm wrong");
+    ctx->xmm[1].u64[0] = 0x0123456789ABCDEFULL;
+    run_bytes(ctx, movq_from, sizeof(movq_from), &fault);
+    CHECK(ctx->x86_regs[0] == 0x0123456789ABCDEFULL, "MOVQ from xmm wrong");
+
+    // PMOVMSKB eax, xmm2
+    static const uint8_t pmovmskb[] = { 0x66, 0x0F, 0xD7, 0xC2 };
+    for (int l = 0; l < 16; l++) {
+        ctx->xmm[2].u8[l] = (0xA53Cu >> l) & 1 ? 0x80 : 0x7F;
+    }
+    run_bytes(ctx, pmovmskb, sizeof(pmovmskb), &fault);
+    CHECK(ctx->x86_regs[0] == 0xA53C, "PMOVMSKB gave 0x%llx", (unsigned long long)ctx->x86_regs[0]);
+}
+
+// MARK: - 解释器
+
+// 与 bench_box64_interp.c 相同的块查找/链接方式
+static Box64InterpExit run_threaded(Guest *guest, uint32_t max_instructions, Box64InterpResult *result) {
+    Box64Context *ctx = guest->ctx;
+    const Box64InterpBounds bounds = {
+        guest->cache, CODE_BASE, CODE_BASE + guest->code_length, max_instructions, 0, NULL
+    };
+    Box64Block *previous = NULL;
+    Box64BlockEdge edge = BOX64_EDGE_FALLTHROUGH;
+
+    for (;;) {
+        const uint64_t rip = ctx->rip;
+        if (rip < CODE_BASE || rip >= CODE_BASE + guest->code_length) {
+            return BOX64_INTERP_BLOCK_END;
+        }
+        Box64Block *block = previous ? box64_tc_follow(guest->cache, previous, edge, rip) : NULL;
+        if (!block) {
+            block = box64_tc_lookup(guest->cache, rip);
+            if (!block) {
+                block = box64_tc_translate(guest->cache, rip, guest->code + (rip - CODE_BASE),
+                                           guest->code_length - (size_t)(rip - CODE_BASE), NULL);
+                if (!block) {
+                    return BOX64_INTERP_FALLBACK;
+                }
+            }
+            if (previous) {
+                box64_tc_link(previous, edge, block);
+            }
+        }
+        box64_block_count_exec(block);
+
+        Box64InterpExit exit = box64_interp_run(ctx, &bounds, block, 0, result);
+        if (exit != BOX64_INTERP_BLOCK_END) {
+            return exit;
+        }
+        previous = result->block;
+        edge = ctx->rip == previous->successor_rip[BOX64_EDGE_FALLTHROUGH] ? BOX64_EDGE_FALLTHROUGH : BOX64_EDGE_TAKEN;
+    }
+}
+
+//   mov rbx, DATA_ADDRESS + offset
+//   mov ecx, N
+// loop:
+//   movaps xmm0, [rbx]
+//   addps xmm0, xmm1
+//   movaps [rbx], xmm0
+//   dec ecx
+//   jnz loop
+//   ret
+static void build_loop(Guest *guest, uint32_t offset, uint32_t iterations) {
+    const uint8_t program[] = {
+        0x48, 0xC7, 0xC3, 0, 0, 0, 0,
+        0xB9, 0, 0, 0, 0,
+        0x0F, 0x28, 0x03,
+        0x0F, 0x58, 0xC1,
+        0x0F, 0x29, 0x03,
+        0xFF, 0xC9,
+        0x75, 0xF3,
+        0xC3
+    };
+    const uint32_t address = (uint32_t)DATA_ADDRESS + offset;
+    memcpy(guest->code, program, sizeof(program));
+    memcpy(guest->code + 3, &address, sizeof(address));
+    memcpy(guest->code + 8, &iterations, sizeof(iterations));
+    guest->code_length = sizeof(program);
+    box64_tc_flush(guest->cache);
+}
+
+static Box64InterpExit run_loop(Guest *guest, Box64InterpResult *result) {
+    Box64Context *ctx = guest->ctx;
+    const float start[4] = { 0 };
+    box64_mmu_copy_to_guest(&ctx->mmu, DATA_ADDRESS + 128, start, sizeof(start));
+    const float step[4] = { 1.0f, 2.0f, 0.5f, 0.25f };
+    memcpy(ctx->xmm[1].f32, step, sizeof(step));
+    box64_flags_set(ctx, 0x202);
+    ctx->stack_base = STACK_BASE;
+    ctx->stack_size = STACK_SIZE;
+    ctx->x86_regs[BOX64_INTERP_REG_RSP] = STACK_BASE + STACK_SIZE - 64;
+    ctx->rip = CODE_BASE;
+    ctx->instruction_count = 0;
+    return run_threaded(guest, UINT32_MAX, result);
+}
+
+static void test_interpreter(Guest *guest) {
+    Box64InterpResult result;
+    build_loop(guest, 128, LOOP_ITERATIONS);
+    Box64InterpExit exit = run_loop(guest, &result);
+    float sums[4];
+    box64_mmu_copy_from_guest(&guest->ctx->mmu, sums, DATA_ADDRESS + 128, sizeof(sums));
+    CHECK(exit == BOX64_INTERP_RETURN, "SSE loop exit %d", exit);
+    CHECK(sums[0] == LOOP_ITERATIONS * 1.0f && sums[1] == LOOP_ITERATIONS * 2.0f &&
+          sums[2] == LOOP_ITERATIONS * 0.5f && sums[3] == LOOP_ITERATIONS * 0.25f,
+          "SSE loop sums %g %g %g %g", sums[0], sums[1], sums[2], sums[3]);
+
+    // 未对齐的 MOVAPS 以 FALLBACK 退出，RIP 停在该指令上
+    build_loop(guest, 132, LOOP_ITERATIONS);
+    exit = run_loop(guest, &result);
+    CHECK(exit == BOX64_INTERP_FALLBACK && guest->ctx->rip == CODE_BASE + 12,
+          "misaligned MOVAPS exit %d at 0x%llx", exit, (unsigned long long)guest->ctx->rip);
+}
+
+// MARK: - 基准
+
+static const Box64SseOp bench_ops[] = { BOX64_SSE_ADDPS, BOX64_SSE_MULPS, BOX64_SSE_MAXPS, BOX64_SSE_PADDD,
+                                        BOX64_SSE_PCMPEQB, BOX64_SSE_MULPD, BOX64_SSE_CVTTPS2DQ };
+
+static void bench(Guest *guest) {
+    Box64Context *ctx = guest->ctx;
+    const size_t op_count = sizeof(bench_ops) / sizeof(bench_ops[0]);
+    X86DecodedInsn insns[sizeof(bench_ops) / sizeof(bench_ops[0])];
+    for (size_t n = 0; n < op_count; n++) {
+        for (size_t c = 0; c < sizeof(packed_cases) / sizeof(packed_cases[0]); c++) {
+            if (packed_cases[c].op == bench_ops[n]) {
+                decode(packed_cases[c].bytes, packed_cases[c].length, &insns[n]);
+            }
+        }
+    }
+    for (int l = 0; l < 4; l++) {
+        ctx->xmm[1].f32[l] = 1.0f + l;
+        ctx->xmm[2].f32[l] = 1.0f;
+    }
+
+    printf("[SSETest] 基准：%d 次 × %zu 种打包运算\n", BENCH_ITERATIONS, op_count);
+
+    const Box64Xmm saved = ctx->xmm[1];
+    double start = now_seconds();
+    for (int iteration = 0; iteration < BENCH_ITERATIONS; iteration++) {
+        for (size_t n = 0; n < op_count; n++) {
+            box64_sse_execute(ctx, &insns[n], bench_ops[n], CODE_BASE, NULL);
+        }
+        ctx->xmm[1] = saved;
+    }
+    const double kernel_time = now_seconds() - start;
+
+    start = now_seconds();
+    for (int iteration = 0; iteration < BENCH_ITERATIONS; iteration++) {
+        for (size_t n = 0; n < op_count; n++) {
+            reference(bench_ops[n], &ctx->xmm[1], &ctx->xmm[2], 0);
+        }
+        ctx->xmm[1] = saved;
+    }
+    const double scalar_time = now_seconds() - start;
+
+    const double total = (double)BENCH_ITERATIONS * (double)op_count;
+    printf("[SSETest]   向量内核    %.2f ns/指令\n", kernel_time * 1e9 / total);
+    printf("[SSETest]   逐通道标量  %.2f ns/指令\n", scalar_time * 1e9 / total);
+    printf("[SSETest]   加速比      %.2fx\n", scalar_time / kernel_time);
+
+    Box64InterpResult result;
+    build_loop(guest, 128, BENCH_ITERATIONS);
+    start = now_seconds();
+    run_loop(guest, &result);
+    const double loop_time = now_seconds() - start;
+    printf("[SSETest]   解释器SSE循环 %.2f ns/迭代（5条指令）\n", loop_time * 1e9 / BENCH_ITERATIONS);
+}
+
+int main(void) {
+    Guest guest;
+    if (!guest_create(&guest)) {
+        printf("[SSETest] ❌ guest setup failed\n");
+        return 1;
+    }
+
+    test_classify();
+    test_packed(guest.ctx);
+    test_memory(&guest);
+    test_scalar(guest.ctx);
+    test_interpreter(&guest);
+    bench(&guest);
+
+    guest_destroy(&guest);
+    if (failures) {
+        printf("[SSETest] ❌ %d checks failed\n", failures);
+        return 1;
+    }
+    printf("[SSETest] ✅ all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,394 @@
+// bench_d3d_command_stream.c - D3D命令流的正确性检查与多线程编码基准
+// 纯C，Linux上直接编译运行:
+//   ./run_portable_tests.sh bench_d3d_command_stream
+// 用空后端对照：整帧在一个线程上编码 vs 拆成若干部分交给编码线程池；
+// 空后端的动作散列和切分方式无关，用来检查继承的状态和提交顺序
+#include "D3DCommandStream.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define FRAME_CALLS         60000
+#define BENCH_FRAMES        20
+#define WORK_PER_CALL       48
+#define POOL_WORKERS        3
+
+static int failures = 0;
+static volatile uint64_t benchSink;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { printf("[D3DCommandStreamBench] ❌ " __VA_ARGS__); printf("\n"); failures++; } \
+} while (0)
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static uint64_t rng_next(uint64_t *state) {
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
+
+static void record(D3DCommandRecorder *recorder, D3DCall call) {
+    if (!d3d_recorder_record(recorder, &call)) {
+        CHECK(0, "record opcode %u failed", call.opcode);
+    }
+}
+
+// 类似游戏的一帧：每隔一段换渲染目标，绘制之间穿插着色器、渲染状态、采样器、顶点缓冲的切换
+// set_targets 为false时开头不设置任何状态，完全依赖上一帧继承下来的
+static void record_frame(D3DCommandRecorder *recorder, uint64_t seed, uint32_t calls, bool set_targets) {
+    uint64_t rng = seed | 1;
+    uint32_t recorded = 0;
+    if (set_targets) {
+        record(recorder, (D3DCall){ .opcode = D3D_OP_OM_SET_RENDER_TARGETS, .args.bind = { 0, 1, 0x1000 } });
+        record(recorder, (D3DCall){ .opcode = D3D_OP_RS_SET_VIEWPORTS, .args.bind = { 0, 1, 0x500 } });
+        record(recorder, (D3DCall){ .opcode = D3D_OP_CLEAR_RENDER_TARGET_VIEW,
+                                    .args.clear = { { 0.0f, 0.0f, 0.0f, 1.0f }, 0x1000 } });
+        recorded = 3;
+    }
+    while (recorded < calls) {
+        const uint64_t r = rng_next(&rng);
+        D3DCall call = { 0 };
+        switch (r % 16) {
+            case 0:
+                call.opcode = D3D_OP_VS_SET_SHADER;
+                call.args.shader.handle = 0x2000 + (r >> 8) % 32;
+                break;
+            case 1:
+                call.opcode = D3D_OP_PS_SET_SHADER;
+                call.args.shader.handle = 0x3000 + (r >> 8) % 32;
+                break;
+            case 2:
+            case 3:
+                call.opcode = D3D_OP_SET_RENDER_STATE;
+                call.args.state.state = (uint32_t)(r >> 8) % 200;
+                call.args.state.value = (uint32_t)(r >> 20);
+                break;
+            case 4:
+                call.opcode = D3D_OP_SET_SAMPLER_STATE;
+                call.args.state.state = (uint32_t)(r >> 8) % 8;
+                call.args.state.value = (uint32_t)(r >> 16) % 13;
+                call.args.raw[1] = r >> 24;
+                break;
+            case 5:
+                call.opcode = D3D_OP_IA_SET_VERTEX_BUFFERS;
+                call.args.bind.start_slot = (uint32_t)(r >> 8) % 4;
+                call.args.bind.count = 1;
+                call.args.bind.first = 0x4000 + (r >> 16) % 64;
+                break;
+            case 6:
+                call.opcode = D3D_OP_OM_SET_BLEND_STATE;
+                call.args.shader.handle = (r >> 8) % 4;
+                break;
+            case 7:
+                if ((r >> 8) % 512 == 0) {
+                    call.opcode = D3D_OP_OM_SET_RENDER_TARGETS;
+                    call.args.bind.count = 1;
+                    call.args.bind.first = 0x1000 + (r >> 16) % 3;
+                } else {
+                    call.opcode = D3D_OP_IA_SET_PRIMITIVE_TOPOLOGY;
+                    call.args.state.state = (uint32_t)(r >> 8) % 5;
+                }
+                break;
+            case 8:
+            case 9:
+            case 10:
+                call.opcode = D3D_OP_DRAW_INDEXED;
+                call.args.draw_indexed.index_count = 3 + (uint32_t)(r >> 8) % 3000;
+                call.args.draw_indexed.start_index = (uint32_t)(r >> 24) % 10000;
+                call.args.draw_indexed.base_vertex = (int32_t)((r >> 40) % 100);
+                break;
+            case 11:
+                call.opcode = D3D_OP_DRAW_INDEXED_INSTANCED;
+                call.args.draw_indexed_instanced.index_count = 36;
+                call.args.draw_indexed_instanced.instance_count = 1 + (uint32_t)(r >> 8) % 100;
+                break;
+            default:
+                call.opcode = D3D_OP_DRAW;
+                call.args.draw.vertex_count = 3 + (uint32_t)(r >> 8) % 600;
+                call.args.draw.start_vertex = (uint32_t)(r >> 24) % 4096;
+                break;
+        }
+        record(recorder, call);
+        recorded++;
+    }
+}
+
+static D3DEncodeResult encode_frame(D3DCommandStream *stream, D3DEncodePool *pool, D3DNullBackend *backend,
+                                    uint32_t parts) {
+    d3d_stream_split(stream, parts, 0);
+    const D3DStreamBackend callbacks = d3d_null_backend(backend);
+    return d3d_stream_encode(stream, pool, &callbacks);
+}
+
+// MARK: - 正确性
+
+static void verify_packets(void) {
+    D3DCommandRecorder recorder;
+    d3d_recorder_init(&recorder);
+    for (int op = D3D_OP_INVALID + 1; op < D3D_OP_COUNT; op++) {
+        D3DCall call = { .opcode = (uint16_t)op };
+        for (int i = 0; i < D3D_CALL_MAX_ARGS; i++) {
+            call.args.raw[i] = 0x0101010101010101ULL * (uint64_t)(op + i);
+        }
+        record(&recorder, call);
+    }
+    D3DCall raw = { .opcode = D3D_OP_CREATE_DEVICE, .arg_count = D3D_CALL_MAX_ARGS };
+    for (int i = 0; i < D3D_CALL_MAX_ARGS; i++) {
+        raw.args.raw[i] = 1000 + (uint64_t)i;
+    }
+    record(&recorder, raw);
+    CHECK(!d3d_recorder_record(&recorder, &(D3DCall){ .opcode = D3D_OP_INVALID }), "INVALID was recorded");
+    CHECK(!d3d_recorder_record(&recorder, &(D3DCall){ .opcode = D3D_OP_COUNT }), "out-of-range opcode was recorded");
+    CHECK(recorder.packets == D3D_OP_COUNT, "packet count %u", recorder.packets);
+
+    D3DCommandStream stream;
+    d3d_stream_init(&stream);
+    D3DCommandRecorder *recorders[] = { &recorder };
+    CHECK(d3d_stream_build(&stream, recorders, 1), "build");
+    CHECK(stream.count == D3D_OP_COUNT, "stream count %u", stream.count);
+    for (uint32_t i = 0; i + 1 < stream.count; i++) {
+        const int op = (int)i + 1;
+        D3DCall decoded;
+        d3d_packet_decode(stream.packets[i], &decoded);
+        const uint32_t payload = d3d_call_payload_size(&decoded);
+        CHECK(decoded.opcode == op && stream.packets[i]->size == sizeof(D3DPacket) + payload, "%s header",
+              d3d_opcode_name((D3DOpcode)op));
+        for (uint32_t w = 0; w < D3D_CALL_MAX_ARGS; w++) {
+            const uint64_t expected = w < payload / 8 ? 0x0101010101010101ULL * (uint64_t)(op + (int)w) : 0;
+            CHECK(decoded.args.raw[w] == expected, "%s word %u", d3d_opcode_name((D3DOpcode)op), w);
+        }
+    }
+    D3DCall decoded;
+    d3d_packet_decode(stream.packets[stream.count - 1], &decoded);
+    CHECK(decoded.arg_count == D3D_CALL_MAX_ARGS && memcmp(&decoded.args, &raw.args, sizeof(raw.args)) == 0,
+          "raw arguments did not round-trip");
+
+    CHECK(d3d_opcode_recordable(D3D_OP_DRAW) && d3d_opcode_recordable(D3D_OP_SET_SAMPLER_STATE) &&
+          d3d_opcode_recordable(D3D_OP_PRESENT), "deferrable opcodes");
+    CHECK(!d3d_opcode_recordable(D3D_OP_CREATE_DEVICE) && !d3d_opcode_recordable(D3D_OP_CREATE_BUFFER) &&
+          !d3d_opcode_recordable(D3D_OP_INVALID), "immediate opcodes");
+    d3d_stream_destroy(&stream);
+    d3d_recorder_destroy(&recorder);
+}
+
+static void verify_recorder_reuse(void) {
+    D3DCommandRecorder recorder;
+    d3d_recorder_init(&recorder);
+    record_frame(&recorder, 7, 20000, true);
+    const uint32_t chunks = recorder.chunks;
+    const uint64_t bytes = recorder.bytes;
+    CHECK(chunks > 1, "frame should span several chunks (%u)", chunks);
+    for (int frame = 0; frame < 5; frame++) {
+        d3d_recorder_reset(&recorder);
+        CHECK(recorder.packets == 0 && recorder.bytes == 0, "reset");
+        record_frame(&recorder, 7, 20000, true);
+    }
+    CHECK(recorder.chunks == chunks, "reused frames allocated chunks: %u -> %u", chunks, recorder.chunks);
+    CHECK(recorder.bytes == bytes && recorder.packets == 20000, "re-recorded frame differs");
+    d3d_recorder_destroy(&recorder);
+}
+
+static void verify_split(void) {
+    D3DCommandRecorder first, second;
+    d3d_recorder_init(&first);
+    d3d_recorder_init(&second);
+    record_frame(&first, 11, 30000, true);
+    record_frame(&second, 12, 10000, false);
+
+    D3DCommandStream stream;
+    d3d_stream_init(&stream);
+    D3DCommandRecorder *recorders[] = { &first, &second };
+    CHECK(d3d_stream_build(&stream, recorders, 2), "build");
+    CHECK(stream.count == 40000, "stream count %u", stream.count);
+
+    const uint32_t counts[] = { 1, 2, 3, 4, 8, 16, 64 };
+    for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+        const uint32_t parts = d3d_stream_split(&stream, counts[c], 0);
+        CHECK(parts >= stream.pass_count && parts <= counts[c] * stream.pass_count, "%u parts for %u requested",
+              parts, counts[c]);
+        uint32_t expected_first = 0;
+        uint32_t pass = 0;
+        for (uint32_t p = 0; p < parts; p++) {
+            const D3DStreamPart *part = &stream.parts[p];
+            CHECK(part->first == expected_first && part->end > part->first, "part %u is not contiguous", p);
+            CHECK(part->pass == pass || part->pass == pass + 1, "part %u pass %u after %u", p, part->pass, pass);
+            const bool starts_pass = stream.packets[part->first]->opcode == D3D_OP_OM_SET_RENDER_TARGETS;
+            CHECK(p == 0 || (part->pass == pass + 1) == starts_pass, "part %u pass boundary", p);
+            for (uint32_t i = part->first + 1; i < part->end; i++) {
+                CHECK(stream.packets[i]->opcode != D3D_OP_OM_SET_RENDER_TARGETS, "part %u spans a render target", p);
+            }
+            CHECK(p == 0 || part->inherited_count > 0, "part %u inherited nothing", p);
+            pass = part->pass;
+            expected_first = part->end;
+        }
+        CHECK(expected_first == stream.count, "parts do not cover the stream");
+        CHECK(stream.pass_count == pass + 1, "pass count");
+    }
+    CHECK(d3d_stream_split(&stream, 4, 1000000) == stream.pass_count, "min_packets larger than the stream");
+
+    d3d_stream_destroy(&stream);
+    d3d_recorder_destroy(&second);
+    d3d_recorder_destroy(&first);
+}
+
+static void verify_equivalence(void) {
+    D3DCommandRecorder recorder;
+    d3d_recorder_init(&recorder);
+    record_frame(&recorder, 21, 50000, true);
+    D3DCommandStream stream;
+    d3d_stream_init(&stream);
+    D3DCommandRecorder *recorders[] = { &recorder };
+    CHECK(d3d_stream_build(&stream, recorders, 1), "build");
+
+    D3DNullBackend reference;
+    d3d_null_backend_init(&reference, 0);
+    const D3DEncodeResult serial = encode_frame(&stream, NULL, &reference, 1);
+    CHECK(serial.failed == 0 && serial.encoded == reference.calls, "serial encode failed");
+    CHECK(reference.calls - reference.inherited_calls == stream.count && reference.draws > 0,
+          "serial encoded %llu of %u", (unsigned long long)(reference.calls - reference.inherited_calls), stream.count);
+    CHECK(serial.passes == stream.pass_count && stream.pass_count > 1, "render target changes should start passes");
+
+    D3DEncodePool *pool = d3d_encode_pool_create(POOL_WORKERS);
+    CHECK(pool && d3d_encode_pool_workers(pool) == POOL_WORKERS, "pool");
+    const uint32_t counts[] = { 2, 3, 4, 7, 16, 100 };
+    for (int threaded = 0; threaded < 2; threaded++) {
+        for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+            D3DNullBackend backend;
+            d3d_null_backend_init(&backend, 0);
+            const D3DEncodeResult result = encode_frame(&stream, threaded ? pool : NULL, &backend, counts[c]);
+            CHECK(result.failed == 0 && result.passes == stream.pass_count, "%u parts: result", counts[c]);
+            CHECK(backend.calls - backend.inherited_calls == stream.count, "%u parts: recorded calls", counts[c]);
+            CHECK(backend.sequence == reference.sequence && backend.draws == reference.draws,
+                  "%u parts (%s): action sequence differs from serial encode", counts[c],
+                  threaded ? "pool" : "caller");
+            d3d_null_backend_destroy(&backend);
+        }
+    }
+    d3d_encode_pool_destroy(pool);
+    d3d_null_backend_destroy(&reference);
+    d3d_stream_destroy(&stream);
+    d3d_recorder_destroy(&recorder);
+}
+
+// 第二帧开头不设置任何状态：逐帧编码的结果必须等于两帧连在一起编码
+static void verify_frames(void) {
+    D3DCommandRecorder first, second;
+    d3d_recorder_init(&first);
+    d3d_recorder_init(&second);
+    record_frame(&first, 31, 8000, true);
+    record_frame(&second, 32, 8000, false);
+    D3DEncodePool *pool = d3d_encode_pool_create(POOL_WORKERS);
+
+    D3DCommandStream stream;
+    d3d_stream_init(&stream);
+    D3DNullBackend backend;
+    d3d_null_backend_init(&backend, 0);
+    D3DCommandRecorder *frame1[] = { &first };
+    CHECK(d3d_stream_build(&stream, frame1, 1), "build frame 1");
+    encode_frame(&stream, pool, &backend, 4);
+    const uint64_t sequence1 = backend.sequence;
+    CHECK(d3d_stream_end_frame(&stream), "end frame 1");
+
+    D3DCommandRecorder *frame2[] = { &second };
+    CHECK(d3d_stream_build(&stream, frame2, 1), "build frame 2");
+    encode_frame(&stream, pool, &backend, 4);
+    CHECK(stream.parts[0].inherited_count > 0, "frame 2 did not inherit frame 1 state");
+    const uint64_t sequence2 = backend.sequence;
+    const uint64_t scale2 = backend.scale;
+    CHECK(d3d_stream_end_frame(&stream), "end frame 2");
+
+    D3DCommandStream joined;
+    d3d_stream_init(&joined);
+    D3DNullBackend reference;
+    d3d_null_backend_init(&reference, 0);
+    D3DCommandRecorder *both[] = { &first, &second };
+    CHECK(d3d_stream_build(&joined, both, 2), "build joined");
+    encode_frame(&joined, NULL, &reference, 1);
+    CHECK(reference.sequence == sequence1 * scale2 + sequence2, "per-frame encode differs from joined encode");
+
+    d3d_null_backend_destroy(&reference);
+    d3d_stream_destroy(&joined);
+    d3d_null_backend_destroy(&backend);
+    d3d_stream_destroy(&stream);
+    d3d_encode_pool_destroy(pool);
+    d3d_recorder_destroy(&second);
+    d3d_recorder_destroy(&first);
+}
+
+// MARK: - 基准
+
+static void run_benchmark(void) {
+    D3DCommandRecorder recorder;
+    d3d_recorder_init(&recorder);
+    D3DCommandStream stream;
+    d3d_stream_init(&stream);
+    D3DEncodePool *pool = d3d_encode_pool_create(POOL_WORKERS);
+    D3DNullBackend serial_backend, pool_backend;
+    d3d_null_backend_init(&serial_backend, WORK_PER_CALL);
+    d3d_null_backend_init(&pool_backend, WORK_PER_CALL);
+    D3DCommandRecorder *recorders[] = { &recorder };
+
+    double record_time = 0, serial_time = 0, pool_time = 0;
+    for (int frame = 0; frame < BENCH_FRAMES; frame++) {
+        double start = now_seconds();
+        d3d_recorder_reset(&recorder);
+        record_frame(&recorder, 1000 + (uint64_t)frame, FRAME_CALLS, true);
+        record_time += now_seconds() - start;
+
+        d3d_stream_build(&stream, recorders, 1);
+        start = now_seconds();
+        encode_frame(&stream, NULL, &serial_backend, 1);
+        serial_time += now_seconds() - start;
+
+        start = now_seconds();
+        encode_frame(&stream, pool, &pool_backend, POOL_WORKERS + 1);
+        pool_time += now_seconds() - start;
+        CHECK(pool_backend.sequence == serial_backend.sequence, "frame %d: pool encode differs", frame);
+        d3d_stream_end_frame(&stream);
+    }
+
+    const double calls = (double)FRAME_CALLS * BENCH_FRAMES;
+    printf("[D3DCommandStreamBench] %d 帧 × %d 次调用，%ld 个CPU，%u 个编码线程 + 调用线程\n",
+           BENCH_FRAMES, FRAME_CALLS, sysconf(_SC_NPROCESSORS_ONLN), d3d_encode_pool_workers(pool));
+    printf("[D3DCommandStreamBench] 录制:         %.1f ns/次 (%.1f 字节/次，%u 块)\n",
+           record_time * 1e9 / calls, (double)recorder.bytes / FRAME_CALLS, recorder.chunks);
+    printf("[D3DCommandStreamBench] 单线程编码:   %.2f ms/帧\n", serial_time * 1e3 / BENCH_FRAMES);
+    printf("[D3DCommandStreamBench] 拆分并行编码: %.2f ms/帧 (%.2fx)\n", pool_time * 1e3 / BENCH_FRAMES,
+           serial_time / pool_time);
+    benchSink = serial_backend.sink ^ pool_backend.sink;
+
+    d3d_null_backend_destroy(&pool_backend);
+    d3d_null_backend_destroy(&serial_backend);
+    d3d_encode_pool_destroy(pool);
+    d3d_stream_destroy(&stream);
+    d3d_recorder_destroy(&recorder);
+}
+
+int main(void) {
+    verify_packets();
+    verify_recorder_reuse();
+    verify_split();
+    verify_equivalence();
+    verify_frames();
+    if (failures) {
+        printf("[D3DCommandStreamBench] %d failure(s)\n", failures);
+        return 1;
+    }
+    run_benchmark();
+    if (failures) {
+        printf("[D3DCommandStreamBench] %d failure(s)\n", failures);
+        return 1;
+    }
+    printf("[D3DCommandStreamBench] ✅ all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,260 @@
+// bench_d3d_dispatch.c - D3D 操作码表的正确性检查与分派基准
+// 纯C，Linux上直接编译运行:
+//   ./run_portable_tests.sh bench_d3d_dispatch
+// 与旧的翻译路径对照：每次调用都按函数名做一串子串匹配分类、再按名字比较选处理函数，并格式化一行带时间戳的日志
+#include "D3DDispatch.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_CALLS     5000000
+#define LOG_CAPACITY    64
+
+static int failures = 0;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { printf("[D3DDispatchBench] ❌ " __VA_ARGS__); printf("\n"); failures++; } \
+} while (0)
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static uint64_t drawnVertices = 0;
+
+static bool handle_draw(const D3DCall *call, void *user) {
+    (void)user;
+    drawnVertices += call->args.draw.vertex_count;
+    return true;
+}
+
+static bool handle_draw_indexed(const D3DCall *call, void *user) {
+    (void)user;
+    drawnVertices += call->args.draw_indexed.index_count;
+    return true;
+}
+
+static bool handle_state(const D3DCall *call, void *user) {
+    (*(uint64_t *)user) += call->args.state.value;
+    return true;
+}
+
+static bool handle_fail(const D3DCall *call, void *user) {
+    (void)call;
+    (void)user;
+    return false;
+}
+
+// MARK: - 正确性
+
+static void verify_opcodes(void) {
+    for (D3DOpcode op = D3D_OP_INVALID + 1; op < D3D_OP_COUNT; op++) {
+        const char *name = d3d_opcode_name(op);
+        CHECK(d3d_opcode_lookup(name) == op, "%s did not round-trip", name);
+    }
+    CHECK(d3d_opcode_lookup("DrawPrimitive") == D3D_OP_DRAW, "D3D9 alias");
+    CHECK(d3d_opcode_lookup("SetVertexShader") == D3D_OP_VS_SET_SHADER, "shader alias");
+    CHECK(d3d_opcode_lookup("drawindexed") == D3D_OP_INVALID, "lookup is case-insensitive");
+    CHECK(d3d_opcode_lookup("NotAFunction") == D3D_OP_INVALID && d3d_opcode_lookup(NULL) == D3D_OP_INVALID,
+          "unknown names");
+
+    CHECK(d3d_opcode_category(D3D_OP_CREATE_DEVICE) == D3D_CATEGORY_DEVICE, "device category");
+    CHECK(d3d_opcode_category(D3D_OP_DRAW_INSTANCED) == D3D_CATEGORY_DRAW, "draw category");
+    CHECK(d3d_opcode_category(D3D_OP_CREATE_PIXEL_SHADER) == D3D_CATEGORY_RESOURCE, "resource category");
+    CHECK(d3d_opcode_category(D3D_OP_PS_SET_SHADER) == D3D_CATEGORY_SHADER, "shader category");
+    CHECK(d3d_opcode_category(D3D_OP_RS_SET_STATE) == D3D_CATEGORY_STATE, "state category");
+    CHECK(d3d_opcode_category(D3D_OP_PRESENT) == D3D_CATEGORY_CONTEXT, "context category");
+    CHECK(d3d_opcode_category((D3DOpcode)999) == D3D_CATEGORY_CONTEXT, "out-of-range category");
+}
+
+static void verify_dispatch(void) {
+    uint64_t stateSum = 0;
+    D3DDispatchTable table;
+    d3d_dispatch_init(&table, NULL, &stateSum);
+    CHECK(d3d_dispatch_set_handler(&table, D3D_OP_DRAW, handle_draw), "set handler");
+    CHECK(d3d_dispatch_set_handler(&table, D3D_OP_SET_RENDER_STATE, handle_state), "set handler");
+    CHECK(!d3d_dispatch_set_handler(&table, D3D_OP_INVALID, handle_draw), "handler bound to INVALID");
+    CHECK(!d3d_dispatch_set_handler(&table, D3D_OP_COUNT, handle_draw), "handler bound past the table");
+
+    drawnVertices = 0;
+    D3DCall call = { .opcode = D3D_OP_DRAW, .args.draw = { 36, 0 } };
+    CHECK(d3d_dispatch(&table, &call) && drawnVertices == 36, "draw dispatch");
+    call = (D3DCall){ .opcode = D3D_OP_SET_RENDER_STATE, .args.state = { 7, 5 } };
+    CHECK(d3d_dispatch(&table, &call) && stateSum == 5, "state dispatch");
+
+    // 没有处理函数、也没有后备函数：失败
+    call = (D3DCall){ .opcode = D3D_OP_PRESENT };
+    CHECK(!d3d_dispatch(&table, &call), "unbound opcode succeeded without a fallback");
+    // 越界操作码计入 INVALID，不会调用后备函数
+    table.fallback = handle_draw;
+    call = (D3DCall){ .opcode = 0xFFFF };
+    CHECK(!d3d_dispatch(&table, &call), "out-of-range opcode dispatched");
+    call = (D3DCall){ .opcode = D3D_OP_PRESENT, .args.draw = { 3, 0 } };
+    CHECK(d3d_dispatch(&table, &call) && drawnVertices == 39, "fallback not used");
+    d3d_dispatch_set_handler(&table, D3D_OP_PRESENT, handle_fail);
+    CHECK(!d3d_dispatch(&table, &call), "failing handler");
+
+    CHECK(atomic_load(&table.calls[D3D_OP_PRESENT]) == 3 && atomic_load(&table.calls[D3D_OP_INVALID]) == 1 &&
+          atomic_load(&table.failures) == 3, "counts present %llu invalid %llu failures %llu",
+          (unsigned long long)atomic_load(&table.calls[D3D_OP_PRESENT]),
+          (unsigned long long)atomic_load(&table.calls[D3D_OP_INVALID]),
+          (unsigned long long)atomic_load(&table.failures));
+
+    // 日志默认关闭；打开后环形覆盖，按时间顺序取回
+    D3DCallRecord records[LOG_CAPACITY];
+    CHECK(d3d_dispatch_copy_log(&table, records, LOG_CAPACITY) == 0, "log recorded while disabled");
+    CHECK(d3d_dispatch_enable_log(&table, 4), "enable log");
+    for (uint32_t i = 0; i < 6; i++) {
+        call = (D3DCall){ .opcode = i % 2 ? D3D_OP_DRAW : D3D_OP_SET_RENDER_STATE };
+        d3d_dispatch(&table, &call);
+    }
+    const uint32_t count = d3d_dispatch_copy_log(&table, records, LOG_CAPACITY);
+    CHECK(count == 4 && records[0].opcode == D3D_OP_SET_RENDER_STATE && records[3].opcode == D3D_OP_DRAW &&
+          records[0].timestamp_ns <= records[3].timestamp_ns && records[3].result, "log ring order");
+    CHECK(d3d_dispatch_copy_log(&table, records, 2) == 2 && records[1].opcode == D3D_OP_DRAW, "log copy limit");
+    d3d_dispatch_clear_log(&table);
+    CHECK(d3d_dispatch_copy_log(&table, records, LOG_CAPACITY) == 0, "log not cleared");
+
+    // 缓冲区只分配一次：再次打开时更大的容量截到已分配的大小
+    CHECK(d3d_dispatch_enable_log(&table, LOG_CAPACITY) && atomic_load(&table.log.capacity) == 4,
+          "log capacity grew to %u", atomic_load(&table.log.capacity));
+    d3d_dispatch_destroy(&table);
+}
+
+static void *toggle_dispatch_thread(void *arg) {
+    D3DDispatchTable *table = arg;
+    for (uint32_t i = 0; i < 200000; i++) {
+        const D3DCall call = { .opcode = D3D_OP_DRAW, .args.draw = { 1, 0 } };
+        d3d_dispatch(table, &call);
+    }
+    return NULL;
+}
+
+// 分派进行中反复开关日志（setLoggingEnabled: 的用法）：记录总写在已分配的缓冲区内
+static void verify_log_toggle(void) {
+    D3DDispatchTable table;
+    d3d_dispatch_init(&table, NULL, NULL);
+    d3d_dispatch_set_handler(&table, D3D_OP_DRAW, handle_draw);
+    pthread_t thread;
+    pthread_create(&thread, NULL, toggle_dispatch_thread, &table);
+    for (uint32_t i = 0; i < 2000; i++) {
+        CHECK(d3d_dispatch_enable_log(&table, i % 2 ? 0 : LOG_CAPACITY / (1 + i % 3)), "enable log failed");
+    }
+    pthread_join(thread, NULL);
+    CHECK(table.log.allocated == LOG_CAPACITY, "log buffer reallocated to %u", table.log.allocated);
+    d3d_dispatch_destroy(&table);
+}
+
+// MARK: - 基准
+
+// 旧路径的等价物：containsString/hasPrefix 分类 + isEqualToString 选处理函数 + 每次一行时间戳日志
+static int legacy_category(const char *name) {
+    if (strstr(name, "CreateDevice") || strstr(name, "GetDevice")) {
+        return D3D_CATEGORY_DEVICE;
+    }
+    const size_t length = strlen(name);
+    if (strncmp(name, "Draw", 4) == 0 || (length >= 4 && strcmp(name + length - 4, "Draw") == 0)) {
+        return D3D_CATEGORY_DRAW;
+    }
+    if (strstr(name, "Create") && (strstr(name, "Buffer") || strstr(name, "Texture") || strstr(name, "Shader"))) {
+        return D3D_CATEGORY_RESOURCE;
+    }
+    if (strstr(name, "Shader")) {
+        return D3D_CATEGORY_SHADER;
+    }
+    if (strstr(name, "State")) {
+        return D3D_CATEGORY_STATE;
+    }
+    return D3D_CATEGORY_CONTEXT;
+}
+
+static bool legacy_translate(const char *name, const uint64_t *params, char *log, size_t logSize, uint64_t *stateSum) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    snprintf(log, logSize, "[%lld.%09ld] Translating: %s(%llu, %llu)\n", (long long)ts.tv_sec, ts.tv_nsec, name,
+             (unsigned long long)params[0], (unsigned long long)params[1]);
+    switch (legacy_category(name)) {
+        case D3D_CATEGORY_DRAW:
+            if (strcmp(name, "DrawIndexed") == 0 || strcmp(name, "Draw") == 0) {
+                drawnVertices += params[0];
+                return true;
+            }
+            return false;
+        case D3D_CATEGORY_STATE:
+            if (strstr(name, "SetRenderState")) {
+                *stateSum += params[1];
+                return true;
+            }
+            return false;
+        default:
+            return false;
+    }
+}
+
+static void bench(void) {
+    static const char *names[] = { "DrawIndexed", "SetRenderState", "Draw", "DrawIndexed" };
+    static const D3DOpcode opcodes[] = { D3D_OP_DRAW_INDEXED, D3D_OP_SET_RENDER_STATE, D3D_OP_DRAW, D3D_OP_DRAW_INDEXED };
+    char log[256];
+    uint64_t stateSum = 0;
+
+    drawnVertices = 0;
+    double start = now_seconds();
+    for (uint32_t i = 0; i < BENCH_CALLS; i++) {
+        const uint64_t params[2] = { i & 63, 1 };
+        legacy_translate(names[i & 3], params, log, sizeof(log), &stateSum);
+    }
+    const double legacy = now_seconds() - start;
+    const uint64_t legacyVertices = drawnVertices, legacyState = stateSum;
+
+    D3DDispatchTable table;
+    stateSum = 0;
+    drawnVertices = 0;
+    d3d_dispatch_init(&table, NULL, &stateSum);
+    d3d_dispatch_set_handler(&table, D3D_OP_DRAW, handle_draw);
+    d3d_dispatch_set_handler(&table, D3D_OP_DRAW_INDEXED, handle_draw_indexed);
+    d3d_dispatch_set_handler(&table, D3D_OP_SET_RENDER_STATE, handle_state);
+    start = now_seconds();
+    for (uint32_t i = 0; i < BENCH_CALLS; i++) {
+        D3DCall call = { .opcode = (uint16_t)opcodes[i & 3] };
+        call.args.raw[0] = i & 63;
+        if (call.opcode == D3D_OP_SET_RENDER_STATE) {
+            call.args.state.value = 1;
+        }
+        d3d_dispatch(&table, &call);
+    }
+    const double table_time = now_seconds() - start;
+    CHECK(drawnVertices == legacyVertices && stateSum == legacyState, "dispatch results differ from legacy path");
+
+    d3d_dispatch_enable_log(&table, 4096);
+    start = now_seconds();
+    for (uint32_t i = 0; i < BENCH_CALLS; i++) {
+        D3DCall call = { .opcode = (uint16_t)opcodes[i & 3] };
+        d3d_dispatch(&table, &call);
+    }
+    const double logged = now_seconds() - start;
+    d3d_dispatch_destroy(&table);
+
+    printf("[D3DDispatchBench] %d 次调用\n", BENCH_CALLS);
+    printf("[D3DDispatchBench] 字符串分类+日志: %.1f ns/次\n", legacy * 1e9 / BENCH_CALLS);
+    printf("[D3DDispatchBench] 操作码分派:       %.1f ns/次 (%.1fx)\n", table_time * 1e9 / BENCH_CALLS,
+           legacy / table_time);
+    printf("[D3DDispatchBench] 操作码分派+日志环: %.1f ns/次\n", logged * 1e9 / BENCH_CALLS);
+}
+
+int main(void) {
+    verify_opcodes();
+    verify_dispatch();
+    verify_log_toggle();
+    bench();
+
+    if (failures) {
+        printf("[D3DDispatchBench] %d failure(s)\n", failures);
+        return 1;
+    }
+    printf("[D3DDispatchBench] ✅ all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,315 @@
+// bench_d3d_frame_pacer.c - 帧节奏控制的正确性检查与并行帧基准
+// 纯C，Linux上直接编译运行:
+//   ./run_portable_tests.sh bench_d3d_frame_pacer
+// 模拟GPU：单独的线程按提交顺序“执行”每帧（睡眠 GPU 耗时），执行时检查本帧上传区域的数据
+// 没有被之后的帧覆盖，然后像 Metal 的完成回调一样交回凭据。
+// 对照：1 帧在途（下一帧等上一帧GPU完成，等同 presentFrame 里 waitUntilCompleted）vs 3 帧在途
+#include "D3DFramePacer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_FRAMES        40
+#define CPU_FRAME_NS        3000000ULL      // 每帧CPU录制耗时
+#define GPU_FRAME_NS        3000000ULL      // 每帧GPU执行耗时
+#define REFRESH_NS          16666667ULL
+#define UPLOAD_REGION       4096
+#define UPLOAD_PER_FRAME    1024
+#define GPU_QUEUE_SIZE      16
+
+static int failures = 0;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { printf("[D3DFramePacerBench] ❌ " __VA_ARGS__); printf("\n"); failures++; } \
+} while (0)
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static void sleep_ns(uint64_t ns) {
+    struct timespec ts = { (time_t)(ns / 1000000000ULL), (long)(ns % 1000000000ULL) };
+    while (nanosleep(&ts, &ts) != 0) {
+    }
+}
+
+// MARK: - 模拟GPU
+
+typedef struct SubmittedFrame {
+    D3DFrameTicket ticket;
+    uint64_t upload_offset;
+} SubmittedFrame;
+
+typedef struct SimulatedGPU {
+    D3DFramePacer *pacer;
+    uint8_t *upload;                        // 共享上传缓冲区
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    SubmittedFrame queue[GPU_QUEUE_SIZE];
+    uint32_t head;
+    uint32_t tail;
+    bool paused;
+    bool shutdown;
+    uint64_t frame_ns;
+    uint64_t executed;
+    uint64_t corrupted;
+    uint32_t max_in_flight_seen;
+    uint64_t last_frame;
+    uint64_t out_of_order;
+    pthread_t thread;
+} SimulatedGPU;
+
+static void *gpu_main(void *arg) {
+    SimulatedGPU *gpu = arg;
+    pthread_mutex_lock(&gpu->mutex);
+    for (;;) {
+        while (!gpu->shutdown && (gpu->paused || gpu->head == gpu->tail)) {
+            pthread_cond_wait(&gpu->cond, &gpu->mutex);
+        }
+        if (gpu->shutdown) {
+            break;
+        }
+        const SubmittedFrame frame = gpu->queue[gpu->head % GPU_QUEUE_SIZE];
+        gpu->head++;
+        pthread_mutex_unlock(&gpu->mutex);
+
+        const uint32_t in_flight = d3d_pacer_in_flight(gpu->pacer);
+        sleep_ns(gpu->frame_ns / 2);
+        // 执行到一半时CPU可能已经在录制后面的帧，本帧的上传数据必须保持不变
+        uint64_t bad = 0;
+        for (uint32_t i = 0; i < UPLOAD_PER_FRAME; i++) {
+            bad += gpu->upload[frame.upload_offset + i] != (uint8_t)frame.ticket.frame;
+        }
+        sleep_ns(gpu->frame_ns - gpu->frame_ns / 2);
+
+        pthread_mutex_lock(&gpu->mutex);
+        gpu->executed++;
+        gpu->corrupted += bad != 0;
+        gpu->out_of_order += frame.ticket.frame <= gpu->last_frame;
+        gpu->last_frame = frame.ticket.frame;
+        if (in_flight > gpu->max_in_flight_seen) {
+            gpu->max_in_flight_seen = in_flight;
+        }
+        pthread_mutex_unlock(&gpu->mutex);
+        d3d_pacer_frame_completed(gpu->pacer, &frame.ticket);
+        pthread_mutex_lock(&gpu->mutex);
+    }
+    pthread_mutex_unlock(&gpu->mutex);
+    return NULL;
+}
+
+static void gpu_start(SimulatedGPU *gpu, D3DFramePacer *pacer, uint8_t *upload, uint64_t frame_ns) {
+    memset(gpu, 0, sizeof(*gpu));
+    gpu->pacer = pacer;
+    gpu->upload = upload;
+    gpu->frame_ns = frame_ns;
+    pthread_mutex_init(&gpu->mutex, NULL);
+    pthread_cond_init(&gpu->cond, NULL);
+    pthread_create(&gpu->thread, NULL, gpu_main, gpu);
+}
+
+static void gpu_submit(SimulatedGPU *gpu, const D3DFrameTicket *ticket, uint64_t upload_offset) {
+    pthread_mutex_lock(&gpu->mutex);
+    gpu->queue[gpu->tail % GPU_QUEUE_SIZE] = (SubmittedFrame){ *ticket, upload_offset };
+    gpu->tail++;
+    pthread_cond_signal(&gpu->cond);
+    pthread_mutex_unlock(&gpu->mutex);
+}
+
+static void gpu_set_paused(SimulatedGPU *gpu, bool paused) {
+    pthread_mutex_lock(&gpu->mutex);
+    gpu->paused = paused;
+    pthread_cond_signal(&gpu->cond);
+    pthread_mutex_unlock(&gpu->mutex);
+}
+
+static void gpu_stop(SimulatedGPU *gpu) {
+    pthread_mutex_lock(&gpu->mutex);
+    gpu->shutdown = true;
+    pthread_cond_signal(&gpu->cond);
+    pthread_mutex_unlock(&gpu->mutex);
+    pthread_join(gpu->thread, NULL);
+    pthread_cond_destroy(&gpu->cond);
+    pthread_mutex_destroy(&gpu->mutex);
+}
+
+// CPU侧一帧：等槽位、往上传区域写本帧数据、模拟录制、提交
+static bool cpu_frame(D3DFramePacer *pacer, SimulatedGPU *gpu, uint8_t *upload, uint64_t cpu_ns) {
+    D3DFrameTicket ticket;
+    if (!d3d_pacer_begin_frame(pacer, D3D_PACER_WAIT_FOREVER, &ticket)) {
+        return false;
+    }
+    uint64_t offset;
+    if (!d3d_pacer_upload(pacer, &ticket, UPLOAD_PER_FRAME, 256, &offset)) {
+        CHECK(0, "frame %llu upload failed", (unsigned long long)ticket.frame);
+        d3d_pacer_frame_completed(pacer, &ticket);
+        return false;
+    }
+    memset(upload + offset, (uint8_t)ticket.frame, UPLOAD_PER_FRAME);
+    sleep_ns(cpu_ns);
+    gpu_submit(gpu, &ticket, offset);
+    return true;
+}
+
+static void drain(D3DFramePacer *pacer) {
+    CHECK(d3d_pacer_wait_in_flight(pacer, 0, D3D_PACER_WAIT_FOREVER), "drain");
+}
+
+// MARK: - 正确性
+
+static void verify_slots(void) {
+    D3DFramePacer pacer;
+    CHECK(!d3d_pacer_init(&pacer, 0, REFRESH_NS, 0), "0 frames in flight accepted");
+    CHECK(!d3d_pacer_init(&pacer, D3D_PACER_MAX_FRAMES_IN_FLIGHT + 1, REFRESH_NS, 0), "too many frames accepted");
+    CHECK(d3d_pacer_init(&pacer, 2, REFRESH_NS, UPLOAD_REGION), "init");
+
+    D3DFrameTicket a, b, c;
+    CHECK(d3d_pacer_begin_frame(&pacer, 0, &a) && d3d_pacer_begin_frame(&pacer, 0, &b), "two free slots");
+    CHECK(a.frame == 1 && b.frame == 2 && a.slot != b.slot, "tickets %llu/%u %llu/%u",
+          (unsigned long long)a.frame, a.slot, (unsigned long long)b.frame, b.slot);
+    CHECK(!d3d_pacer_should_render(&pacer), "should_render with every slot busy");
+    CHECK(!d3d_pacer_begin_frame(&pacer, 0, &c), "try-begin with every slot busy");
+    const double start = now_seconds();
+    CHECK(!d3d_pacer_begin_frame(&pacer, 20000000ULL, &c), "timed begin with every slot busy");
+    CHECK(now_seconds() - start >= 0.015, "timed begin returned early");
+    CHECK(d3d_pacer_wait_in_flight(&pacer, 2, 0) && !d3d_pacer_wait_in_flight(&pacer, 1, 0),
+          "wait_in_flight without waiting");
+    const double wait_start = now_seconds();
+    CHECK(!d3d_pacer_wait_in_flight(&pacer, 0, 20000000ULL) && now_seconds() - wait_start >= 0.015,
+          "timed wait_in_flight with frames pending");
+
+    // 上传区域：对齐、按槽位分开、用完失败
+    uint64_t o1, o2, o3;
+    CHECK(d3d_pacer_upload(&pacer, &a, 100, 16, &o1) && d3d_pacer_upload(&pacer, &a, 8, 256, &o2), "upload");
+    CHECK(o1 == a.slot * (uint64_t)UPLOAD_REGION && o2 == o1 + 256, "upload offsets %llu %llu",
+          (unsigned long long)o1, (unsigned long long)o2);
+    CHECK(d3d_pacer_upload(&pacer, &b, UPLOAD_REGION, 1, &o3) && o3 == b.slot * (uint64_t)UPLOAD_REGION,
+          "whole region");
+    CHECK(!d3d_pacer_upload(&pacer, &b, 1, 1, &o3), "region overflow accepted");
+    CHECK(!d3d_pacer_upload(&pacer, &a, 8, 3, &o3), "non power-of-two alignment accepted");
+
+    d3d_pacer_frame_completed(&pacer, &a);
+    d3d_pacer_frame_completed(&pacer, &a);          // 重复完成被忽略
+    CHECK(d3d_pacer_in_flight(&pacer) == 1, "in flight %u", d3d_pacer_in_flight(&pacer));
+    CHECK(!d3d_pacer_upload(&pacer, &a, 8, 1, &o3), "upload into a completed frame");
+    CHECK(d3d_pacer_should_render(&pacer) && d3d_pacer_begin_frame(&pacer, 0, &c), "slot freed by completion");
+    CHECK(c.frame == 3 && c.slot == a.slot, "freed slot reused");
+    CHECK(d3d_pacer_upload(&pacer, &c, 8, 1, &o3) && o3 == c.slot * (uint64_t)UPLOAD_REGION, "reused region reset");
+
+    d3d_pacer_frame_completed(&pacer, &b);
+    d3d_pacer_frame_completed(&pacer, &c);
+    const D3DFramePacerStats stats = d3d_pacer_stats(&pacer);
+    CHECK(stats.frames_begun == 3 && stats.frames_completed == 3, "frame counts");
+    CHECK(stats.skipped_refreshes == 1 && stats.timeouts == 2, "skipped %llu timeouts %llu",
+          (unsigned long long)stats.skipped_refreshes, (unsigned long long)stats.timeouts);
+    CHECK(stats.upload_peak == UPLOAD_REGION && stats.upload_failures == 2, "upload peak %llu failures %llu",
+          (unsigned long long)stats.upload_peak, (unsigned long long)stats.upload_failures);
+    d3d_pacer_destroy(&pacer);
+}
+
+// 模拟GPU暂停时CPU被挡在 begin，恢复后逐帧放行
+static void verify_blocking(void) {
+    D3DFramePacer pacer;
+    d3d_pacer_init(&pacer, 3, REFRESH_NS, UPLOAD_REGION);
+    uint8_t *upload = calloc(3, UPLOAD_REGION);
+    SimulatedGPU gpu;
+    gpu_start(&gpu, &pacer, upload, 1000000ULL);
+    gpu_set_paused(&gpu, true);
+    for (int i = 0; i < 3; i++) {
+        cpu_frame(&pacer, &gpu, upload, 0);
+    }
+    D3DFrameTicket ticket;
+    CHECK(!d3d_pacer_begin_frame(&pacer, 5000000ULL, &ticket), "fourth frame began with the GPU paused");
+    gpu_set_paused(&gpu, false);
+    for (int i = 0; i < 20; i++) {
+        cpu_frame(&pacer, &gpu, upload, 0);
+    }
+    drain(&pacer);
+    gpu_stop(&gpu);
+    CHECK(gpu.executed == 23 && gpu.corrupted == 0 && gpu.out_of_order == 0, "executed %llu corrupted %llu",
+          (unsigned long long)gpu.executed, (unsigned long long)gpu.corrupted);
+    CHECK(gpu.max_in_flight_seen <= 3, "%u frames in flight", gpu.max_in_flight_seen);
+    free(upload);
+    d3d_pacer_destroy(&pacer);
+}
+
+// GPU一帧超过 max_in_flight 个刷新周期：记为迟到
+static void verify_late_frames(void) {
+    D3DFramePacer pacer;
+    d3d_pacer_init(&pacer, 2, 1000000ULL, UPLOAD_REGION);
+    uint8_t *upload = calloc(2, UPLOAD_REGION);
+    SimulatedGPU gpu;
+    gpu_start(&gpu, &pacer, upload, 3000000ULL);
+    for (int i = 0; i < 5; i++) {
+        cpu_frame(&pacer, &gpu, upload, 0);
+    }
+    drain(&pacer);
+    gpu_stop(&gpu);
+    const D3DFramePacerStats stats = d3d_pacer_stats(&pacer);
+    CHECK(stats.late_frames == 5, "late frames %llu", (unsigned long long)stats.late_frames);
+    CHECK(stats.latency_ns_max >= 3000000ULL, "latency %llu", (unsigned long long)stats.latency_ns_max);
+    free(upload);
+    d3d_pacer_destroy(&pacer);
+}
+
+// MARK: - 基准
+
+static double run_frames(uint32_t max_in_flight, D3DFramePacerStats *stats, SimulatedGPU *result) {
+    D3DFramePacer pacer;
+    d3d_pacer_init(&pacer, max_in_flight, REFRESH_NS, UPLOAD_REGION);
+    uint8_t *upload = calloc(max_in_flight, UPLOAD_REGION);
+    SimulatedGPU gpu;
+    gpu_start(&gpu, &pacer, upload, GPU_FRAME_NS);
+
+    const double start = now_seconds();
+    for (int i = 0; i < BENCH_FRAMES; i++) {
+        cpu_frame(&pacer, &gpu, upload, CPU_FRAME_NS);
+    }
+    drain(&pacer);
+    const double elapsed = now_seconds() - start;
+    gpu_stop(&gpu);
+    *stats = d3d_pacer_stats(&pacer);
+    *result = gpu;
+    free(upload);
+    d3d_pacer_destroy(&pacer);
+    return elapsed;
+}
+
+static void run_benchmark(void) {
+    D3DFramePacerStats serialStats, pipelinedStats;
+    SimulatedGPU serialGPU, pipelinedGPU;
+    const double serial = run_frames(1, &serialStats, &serialGPU);
+    const double pipelined = run_frames(3, &pipelinedStats, &pipelinedGPU);
+    CHECK(pipelinedGPU.corrupted == 0 && serialGPU.corrupted == 0, "upload data overwritten while in flight");
+    CHECK(pipelinedGPU.max_in_flight_seen <= 3 && pipelinedGPU.max_in_flight_seen >= 2,
+          "pipelined run reached %u frames in flight", pipelinedGPU.max_in_flight_seen);
+    CHECK(serial / pipelined > 1.3, "frames in flight did not overlap CPU and GPU (%.2fx)", serial / pipelined);
+
+    printf("[D3DFramePacerBench] %d 帧，CPU %.1f ms/帧，GPU %.1f ms/帧\n", BENCH_FRAMES,
+           CPU_FRAME_NS / 1e6, GPU_FRAME_NS / 1e6);
+    printf("[D3DFramePacerBench] 每帧等GPU完成: %.2f ms/帧，CPU等待 %.2f ms/帧\n", serial * 1e3 / BENCH_FRAMES,
+           serialStats.wait_ns_total / 1e6 / BENCH_FRAMES);
+    printf("[D3DFramePacerBench] 3 帧在途:      %.2f ms/帧 (%.2fx)，CPU等待 %.2f ms/帧，最多在途 %u 帧\n",
+           pipelined * 1e3 / BENCH_FRAMES, serial / pipelined, pipelinedStats.wait_ns_total / 1e6 / BENCH_FRAMES,
+           pipelinedGPU.max_in_flight_seen);
+}
+
+int main(void) {
+    verify_slots();
+    verify_blocking();
+    verify_late_frames();
+    if (failures) {
+        printf("[D3DFramePacerBench] %d failure(s)\n", failures);
+        return 1;
+    }
+    run_benchmark();
+    if (failures) {
+        printf("[D3DFramePacerBench] %d failure(s)\n", failures);
+        return 1;
+    }
+    printf("[D3DFramePacerBench] ✅ all checks passed\n");
+    return 0;
+}
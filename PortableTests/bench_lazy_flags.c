@@ -0,0 +1,228 @@
+// bench_lazy_flags.c - 惰性标志与立即求值的对照校验和基准
+// 纯C，Linux上直接编译运行:
+//   cc -O2 -I../WineForIOS bench_lazy_flags.c ../WineForIOS/Box64Flags.c -o bench_lazy_flags
+// 先用随机运算链校验惰性求值的条件码/CF/rflags与立即求值完全一致，
+// 再在算术密集的循环上比较两种方式（每6条算术指令读一次条件，与常见的 CMP+Jcc 循环相当）
+#include "Box64Flags.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define VERIFY_STEPS    200000
+#define BENCH_ITERATIONS 20000000
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ULL;
+
+static uint64_t next_random(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+// 偏向边界值：0、1、全1、符号位附近
+static uint64_t random_operand(void) {
+    static const uint64_t edges[] = {
+        0, 1, 2, 0x7F, 0x80, 0xFF, 0x7FFF, 0x8000, 0xFFFF, 0x7FFFFFFF, 0x80000000ULL, 0xFFFFFFFFULL,
+        0x7FFFFFFFFFFFFFFFULL, 0x8000000000000000ULL, ~0ULL
+    };
+    uint64_t r = next_random();
+    if ((r & 3) == 0) {
+        return edges[(r >> 8) % (sizeof(edges) / sizeof(edges[0]))];
+    }
+    return next_random();
+}
+
+static bool eager_condition(uint64_t flags, uint8_t cc) {
+    bool cf = flags & X86_FLAG_CF, pf = flags & X86_FLAG_PF, zf = flags & X86_FLAG_ZF;
+    bool sf = flags & X86_FLAG_SF, of = flags & X86_FLAG_OF;
+    bool result;
+    switch (cc >> 1) {
+        case 0: result = of; break;
+        case 1: result = cf; break;
+        case 2: result = zf; break;
+        case 3: result = cf || zf; break;
+        case 4: result = sf; break;
+        case 5: result = pf; break;
+        case 6: result = sf != of; break;
+        default: result = (sf != of) || zf; break;
+    }
+    return (cc & 1) ? !result : result;
+}
+
+static uint64_t size_mask(uint8_t size) {
+    return size >= 8 ? ~0ULL : ((1ULL << (size * 8)) - 1);
+}
+
+// MARK: - 对照校验
+
+static int verify(void) {
+    static const Box64FlagOp ops[] = {
+        BOX64_FLAGS_ADD, BOX64_FLAGS_ADC, BOX64_FLAGS_SUB, BOX64_FLAGS_SBB,
+        BOX64_FLAGS_LOGIC, BOX64_FLAGS_INC, BOX64_FLAGS_DEC
+    };
+    static const uint8_t sizes[] = { 1, 2, 4, 8 };
+    Box64Context *ctx = calloc(1, sizeof(Box64Context));
+    Box64Context *probe = malloc(sizeof(Box64Context));
+    uint64_t eager = 0x202;
+    int failures = 0;
+
+    if (!ctx || !probe) {
+        printf("[LazyFlagsBench] 内存分配失败\n");
+        free(ctx);
+        free(probe);
+        return 1;
+    }
+    box64_flags_set(ctx, eager);
+
+    // 运算前后相接，覆盖 ADC/SBB/INC/DEC 对前一条运算CF的依赖
+    for (int step = 0; step < VERIFY_STEPS && failures < 10; step++) {
+        const Box64FlagOp op = ops[next_random() % (sizeof(ops) / sizeof(ops[0]))];
+        const uint8_t size = sizes[next_random() & 3];
+        const uint64_t mask = size_mask(size);
+        const uint64_t dst = random_operand() & mask;
+        uint64_t src = random_operand() & mask;
+
+        const bool eager_cf = eager & X86_FLAG_CF;
+        const bool lazy_cf = box64_flags_carry(ctx);
+        if (eager_cf != lazy_cf) {
+            printf("[LazyFlagsBench] ❌ step %d: carry %d != %d\n", step, lazy_cf, eager_cf);
+            failures++;
+        }
+
+        uint64_t result;
+        switch (op) {
+            case BOX64_FLAGS_ADD: result = dst + src; break;
+            case BOX64_FLAGS_ADC: result = dst + src + eager_cf; break;
+            case BOX64_FLAGS_SUB: result = dst - src; break;
+            case BOX64_FLAGS_SBB: result = dst - src - eager_cf; break;
+            case BOX64_FLAGS_INC: src = 1; result = dst + 1; break;
+            case BOX64_FLAGS_DEC: src = 1; result = dst - 1; break;
+            default:              result = dst ^ src; break;
+        }
+        result &= mask;
+
+        eager = box64_flags_compute(op, dst, src, result, size, eager);
+        if (op == BOX64_FLAGS_INC || op == BOX64_FLAGS_DEC) {
+            box64_flags_record_incdec(ctx, op == BOX64_FLAGS_INC, dst, result, size);
+        } else {
+            box64_flags_record(ctx, op, dst, src, result, size);
+        }
+
+        // 每个条件码在独立副本上求值，避免慢路径的求值掩盖快路径的错误
+        for (uint8_t cc = 0; cc < 16; cc++) {
+            memcpy(probe, ctx, sizeof(Box64Context));
+            if (box64_flags_condition(probe, cc) != eager_condition(eager, cc)) {
+                printf("[LazyFlagsBench] ❌ step %d: op %d size %u cc %u dst %llx src %llx\n", step, op, size, cc,
+                       (unsigned long long)dst, (unsigned long long)src);
+                failures++;
+            }
+        }
+        // 偶尔完整求值，后续运算从 NONE 状态继续
+        if ((next_random() & 7) == 0) {
+            uint64_t flags = box64_flags_materialize(ctx);
+            if ((flags & X86_FLAGS_ARITH) != (eager & X86_FLAGS_ARITH)) {
+                printf("[LazyFlagsBench] ❌ step %d: rflags %llx != %llx\n", step, (unsigned long long)flags,
+                       (unsigned long long)eager);
+                failures++;
+            }
+        }
+    }
+
+    free(probe);
+    free(ctx);
+    if (failures == 0) {
+        printf("[LazyFlagsBench] ✅ %d 步随机运算：16个条件码、CF、rflags 与立即求值一致\n", VERIFY_STEPS);
+    }
+    return failures;
+}
+
+// MARK: - 基准
+
+// 循环体: add / sub / and / xor / inc / cmp+jne，寄存器放在上下文里模拟解释器的访存
+static double run_eager(Box64Context *ctx, uint64_t *checksum) {
+    uint64_t *r = ctx->x86_regs;
+    uint64_t taken = 0;
+    double start = now_seconds();
+    for (uint32_t i = 0; i < BENCH_ITERATIONS; i++) {
+        uint64_t d;
+        d = r[0]; r[0] = d + r[1];           ctx->rflags = box64_flags_compute(BOX64_FLAGS_ADD, d, r[1], r[0], 8, ctx->rflags);
+        d = r[2]; r[2] = d - r[0];           ctx->rflags = box64_flags_compute(BOX64_FLAGS_SUB, d, r[0], r[2], 8, ctx->rflags);
+        d = r[3]; r[3] = d & r[2];           ctx->rflags = box64_flags_compute(BOX64_FLAGS_LOGIC, d, r[2], r[3], 8, ctx->rflags);
+        d = r[1]; r[1] = d ^ r[3];           ctx->rflags = box64_flags_compute(BOX64_FLAGS_LOGIC, d, r[3], r[1], 8, ctx->rflags);
+        d = r[5]; r[5] = d + 1;              ctx->rflags = box64_flags_compute(BOX64_FLAGS_INC, d, 1, r[5], 8, ctx->rflags);
+        ctx->rflags = box64_flags_compute(BOX64_FLAGS_SUB, r[5], r[4], r[5] - r[4], 8, ctx->rflags);
+        taken += eager_condition(ctx->rflags, 0x5);  // JNE
+    }
+    double elapsed = now_seconds() - start;
+    *checksum = taken ^ r[0] ^ r[1] ^ r[2] ^ r[3] ^ ctx->rflags;
+    return elapsed;
+}
+
+static double run_lazy(Box64Context *ctx, uint64_t *checksum) {
+    uint64_t *r = ctx->x86_regs;
+    uint64_t taken = 0;
+    double start = now_seconds();
+    for (uint32_t i = 0; i < BENCH_ITERATIONS; i++) {
+        uint64_t d;
+        d = r[0]; r[0] = d + r[1];           box64_flags_record(ctx, BOX64_FLAGS_ADD, d, r[1], r[0], 8);
+        d = r[2]; r[2] = d - r[0];           box64_flags_record(ctx, BOX64_FLAGS_SUB, d, r[0], r[2], 8);
+        d = r[3]; r[3] = d & r[2];           box64_flags_record(ctx, BOX64_FLAGS_LOGIC, d, r[2], r[3], 8);
+        d = r[1]; r[1] = d ^ r[3];           box64_flags_record(ctx, BOX64_FLAGS_LOGIC, d, r[3], r[1], 8);
+        d = r[5]; r[5] = d + 1;              box64_flags_record_incdec(ctx, true, d, r[5], 8);
+        box64_flags_record(ctx, BOX64_FLAGS_SUB, r[5], r[4], r[5] - r[4], 8);
+        taken += box64_flags_condition(ctx, 0x5);
+    }
+    double elapsed = now_seconds() - start;
+    *checksum = taken ^ r[0] ^ r[1] ^ r[2] ^ r[3] ^ box64_flags_materialize(ctx);
+    return elapsed;
+}
+
+static void seed(Box64Context *ctx) {
+    memset(ctx, 0, sizeof(Box64Context));
+    for (int i = 0; i < 16; i++) {
+        ctx->x86_regs[i] = 0x0123456789ABCDEFULL * (uint64_t)(i + 1);
+    }
+    ctx->x86_regs[4] = 12345;
+    box64_flags_set(ctx, 0x202);
+}
+
+int main(void) {
+    if (verify() != 0) {
+        printf("[LazyFlagsBench] 对照校验失败\n");
+        return 1;
+    }
+
+    Box64Context *ctx = malloc(sizeof(Box64Context));
+    if (!ctx) {
+        printf("[LazyFlagsBench] 内存分配失败\n");
+        return 1;
+    }
+    uint64_t eager_sum = 0, lazy_sum = 0;
+    seed(ctx);
+    double eager_time = run_eager(ctx, &eager_sum);
+    seed(ctx);
+    double lazy_time = run_lazy(ctx, &lazy_sum);
+    free(ctx);
+
+    if (eager_sum != lazy_sum) {
+        printf("[LazyFlagsBench] ❌ checksum 不一致: %llx != %llx\n", (unsigned long long)eager_sum,
+               (unsigned long long)lazy_sum);
+        return 1;
+    }
+
+    const double insns = (double)BENCH_ITERATIONS * 7;
+    printf("[LazyFlagsBench] eager flags: %6.2f ns/insn  %8.1f M insn/s\n", eager_time * 1e9 / insns,
+           insns / eager_time / 1e6);
+    printf("[LazyFlagsBench] lazy flags:  %6.2f ns/insn  %8.1f M insn/s  (%.2fx)\n", lazy_time * 1e9 / insns,
+           insns / lazy_time / 1e6, eager_time / lazy_time);
+    printf("[LazyFlagsBench] checksum: %llx\n", (unsigned long long)lazy_sum);
+    return 0;
+}
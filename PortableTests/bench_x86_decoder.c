@@ -0,0 +1,203 @@
+// bench_x86_decoder.c - X86Decoder 解码吞吐基准
+// 纯C，Linux上直接编译运行:
+//   cc -O2 -I../WineForIOS bench_x86_decoder.c ../WineForIOS/X86Decoder.c -o bench_x86_decoder
+#include "X86Decoder.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct EncodingSample {
+    const char *name;
+    uint8_t bytes[15];
+    uint8_t length;
+    const char *text;           // x86_format_insn 的期望输出（地址 0x401000）
+} EncodingSample;
+
+// 覆盖前缀 / REX / ModR/M / SIB / 位移 / 立即数 / 0F映射 的样本
+static const EncodingSample samples[] = {
+    { "NOP",                    { 0x90 }, 1, "NOP" },
+    { "RET",                    { 0xC3 }, 1, "RET" },
+    { "PUSH RBP",               { 0x55 }, 1, "PUSH RBP" },
+    { "PUSH R12",               { 0x41, 0x54 }, 2, "PUSH R12" },
+    { "MOV RBP, RSP",           { 0x48, 0x89, 0xE5 }, 3, "MOV RBP, RSP" },
+    { "MOV RAX, 42",            { 0x48, 0xC7, 0xC0, 0x2A, 0x00, 0x00, 0x00 }, 7, "MOV RAX, 0x2A" },
+    { "MOV EAX, 10",            { 0xB8, 0x0A, 0x00, 0x00, 0x00 }, 5, "MOV EAX, 0xA" },
+    { "MOV RAX, imm64",         { 0x48, 0xB8, 1, 2, 3, 4, 5, 6, 7, 8 }, 10, "MOV RAX, 0x807060504030201" },
+    { "ADD RAX, 1",             { 0x48, 0x83, 0xC0, 0x01 }, 4, "ADD RAX, 0x1" },
+    { "SUB RSP, 0x28",          { 0x48, 0x83, 0xEC, 0x28 }, 4, "SUB RSP, 0x28" },
+    { "ADD EAX, 5",             { 0x05, 0x05, 0x00, 0x00, 0x00 }, 5, "ADD EAX, 0x5" },
+    { "MOV RAX,[RBX+RCX*8+8]",  { 0x48, 0x8B, 0x44, 0xCB, 0x08 }, 5, "MOV RAX, QWORD PTR [RBX+RCX*8+0x8]" },
+    { "MOV [RSP+0x100], RDI",   { 0x48, 0x89, 0xBC, 0x24, 0x00, 0x01, 0x00, 0x00 }, 8, "MOV QWORD PTR [RSP+0x100], RDI" },
+    { "LEA RCX, [RIP+disp]",    { 0x48, 0x8D, 0x0D, 0x10, 0x20, 0x00, 0x00 }, 7, "LEA RCX, QWORD PTR [RIP+0x2010]" },
+    { "CMP DWORD [RBP-4], 10",  { 0x83, 0x7D, 0xFC, 0x0A }, 4, "CMP DWORD PTR [RBP-0x4], 0xA" },
+    { "MOV WORD [RAX], 0x1234", { 0x66, 0xC7, 0x00, 0x34, 0x12 }, 5, "MOV WORD PTR [RAX], 0x1234" },
+    { "JNE rel8",               { 0x75, 0xF0 }, 2, "JNE 0x400FF2" },
+    { "JE rel32",               { 0x0F, 0x84, 0x00, 0x01, 0x00, 0x00 }, 6, "JE 0x401106" },
+    { "CALL rel32",             { 0xE8, 0x00, 0x00, 0x00, 0x00 }, 5, "CALL 0x401005" },
+    { "CALL [RIP+disp]",        { 0xFF, 0x15, 0x00, 0x10, 0x00, 0x00 }, 6, "CALL QWORD PTR [RIP+0x1000]" },
+    { "MOVZX EAX, BYTE [RSI]",  { 0x0F, 0xB6, 0x06 }, 3, "MOVZX EAX, BYTE PTR [RSI]" },
+    { "CMOVL RAX, RDX",         { 0x48, 0x0F, 0x4C, 0xC2 }, 4, "CMOVL RAX, RDX" },
+    { "IMUL EAX, ECX, 100",     { 0x6B, 0xC1, 0x64 }, 3, "IMUL EAX, ECX, 0x64" },
+    { "TEST AL, 1",             { 0xA8, 0x01 }, 2, "TEST AL, 0x1" },
+    { "TEST DWORD [RAX], imm",  { 0xF7, 0x00, 0x01, 0x00, 0x00, 0x00 }, 6, "TEST DWORD PTR [RAX], 0x1" },
+    { "REP MOVSB",              { 0xF3, 0xA4 }, 2, "REP MOVSB" },
+    { "LOCK CMPXCHG [RDI],ECX", { 0xF0, 0x0F, 0xB1, 0x0F }, 4, "LOCK CMPXCHG DWORD PTR [RDI], ECX" },
+    { "MOVAPS XMM0, [RAX]",     { 0x0F, 0x28, 0x00 }, 3, "MOVAPS XMM0, XMMWORD PTR [RAX]" },
+    { "ADDSD XMM1, XMM2",       { 0xF2, 0x0F, 0x58, 0xCA }, 4, "ADDSD XMM1, XMM2" },
+    { "PADDD XMM8, XMM9",       { 0x66, 0x45, 0x0F, 0xFE, 0xC1 }, 5, "PADDD XMM8, XMM9" },
+    { "PSHUFB XMM0, XMM1",      { 0x66, 0x0F, 0x38, 0x00, 0xC1 }, 5, "0F38_00 XMM0, XMM1" },
+    { "PALIGNR XMM0, XMM1, 4",  { 0x66, 0x0F, 0x3A, 0x0F, 0xC1, 0x04 }, 6, "0F3A_0F XMM0, XMM1, 0x4" },
+    { "MOV FS:[0x30], RAX",     { 0x64, 0x48, 0x89, 0x04, 0x25, 0x30, 0x00, 0x00, 0x00 }, 9, "MOV QWORD PTR FS:[0x30], RAX" },
+    { "SHL RAX, 4",             { 0x48, 0xC1, 0xE0, 0x04 }, 4, "SHL RAX, 0x4" },
+    { "ENTER 0x20, 0",          { 0xC8, 0x20, 0x00, 0x00 }, 4, "ENTER 0x20, 0x0" },
+    { "ENTER 0x1000, 3",        { 0xC8, 0x00, 0x10, 0x03 }, 4, "ENTER 0x1000, 0x3" },
+    { "MOVDQA XMM0, [RSI]",     { 0x66, 0x0F, 0x6F, 0x06 }, 4, "MOVDQA XMM0, XMMWORD PTR [RSI]" },
+    { "MOVDQU [RDI], XMM3",     { 0xF3, 0x0F, 0x7F, 0x1F }, 4, "MOVDQU XMMWORD PTR [RDI], XMM3" },
+    { "MOVQ XMM0, [RAX]",       { 0xF3, 0x0F, 0x7E, 0x00 }, 4, "MOVQ XMM0, QWORD PTR [RAX]" },
+    { "MOVQ [RAX], XMM1",       { 0x66, 0x0F, 0xD6, 0x08 }, 4, "MOVQ QWORD PTR [RAX], XMM1" },
+    { "MOVQ XMM0, RAX",         { 0x66, 0x48, 0x0F, 0x6E, 0xC0 }, 5, "MOVQ XMM0, RAX" },
+    { "MOVD EAX, XMM2",         { 0x66, 0x0F, 0x7E, 0xD0 }, 4, "MOVD EAX, XMM2" },
+    { "MOVSD XMM0, [RBP-8]",    { 0xF2, 0x0F, 0x10, 0x45, 0xF8 }, 5, "MOVSD XMM0, QWORD PTR [RBP-0x8]" },
+    { "CVTSI2SD XMM0, EAX",     { 0xF2, 0x0F, 0x2A, 0xC0 }, 4, "CVTSI2SD XMM0, EAX" },
+    { "CVTTSD2SI RAX, XMM1",    { 0xF2, 0x48, 0x0F, 0x2C, 0xC1 }, 5, "CVTTSD2SI RAX, XMM1" },
+    { "CVTSS2SD XMM0, [RAX]",   { 0xF3, 0x0F, 0x5A, 0x00 }, 4, "CVTSS2SD XMM0, DWORD PTR [RAX]" },
+    { "UCOMISD XMM0, XMM1",     { 0x66, 0x0F, 0x2E, 0xC1 }, 4, "UCOMISD XMM0, XMM1" },
+    { "PMOVMSKB EAX, XMM0",     { 0x66, 0x0F, 0xD7, 0xC0 }, 4, "PMOVMSKB EAX, XMM0" },
+};
+
+#define SAMPLE_COUNT (sizeof(samples) / sizeof(samples[0]))
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ULL;
+
+static uint32_t next_random(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return (uint32_t)rng_state;
+}
+
+static int verify_samples(void) {
+    int failures = 0;
+    char text[96];
+    for (size_t i = 0; i < SAMPLE_COUNT; i++) {
+        X86DecodedInsn insn;
+        X86DecodeStatus status = x86_decode(samples[i].bytes, samples[i].length, &insn);
+        if (status != X86_DECODE_OK || insn.length != samples[i].length) {
+            printf("[X86DecoderBench] ❌ %-24s status=%d length=%u (expected %u)\n",
+                   samples[i].name, status, insn.length, samples[i].length);
+            failures++;
+            continue;
+        }
+        x86_format_insn(&insn, 0x401000, text, sizeof(text));
+        if (strcmp(text, samples[i].text) != 0) {
+            printf("[X86DecoderBench] ❌ %-24s -> %s (expected %s)\n", samples[i].name, text, samples[i].text);
+            failures++;
+            continue;
+        }
+        printf("[X86DecoderBench] ✅ %-24s -> %s\n", samples[i].name, text);
+    }
+
+    // 截断检测：去掉最后一个字节必须报告 TRUNCATED
+    for (size_t i = 0; i < SAMPLE_COUNT; i++) {
+        if (samples[i].length < 2) {
+            continue;
+        }
+        X86DecodedInsn insn;
+        if (x86_decode(samples[i].bytes, samples[i].length - 1u, &insn) != X86_DECODE_TRUNCATED) {
+            printf("[X86DecoderBench] ❌ %s: truncation not detected\n", samples[i].name);
+            failures++;
+        }
+    }
+    return failures;
+}
+
+int main(int argc, char **argv) {
+    size_t stream_mb = (argc > 1) ? (size_t)strtoul(argv[1], NULL, 10) : 64;
+    int passes = (argc > 2) ? atoi(argv[2]) : 5;
+    if (stream_mb == 0) stream_mb = 64;
+    if (passes <= 0) passes = 5;
+
+    if (verify_samples() != 0) {
+        printf("[X86DecoderBench] 样本校验失败\n");
+        return 1;
+    }
+
+    // 生成合成字节流：随机拼接样本编码
+    size_t capacity = stream_mb * 1024 * 1024;
+    uint8_t *stream = malloc(capacity + X86_MAX_INSN_LENGTH);
+    if (!stream) {
+        printf("[X86DecoderBench] 内存分配失败\n");
+        return 1;
+    }
+    size_t used = 0;
+    size_t expected_insns = 0;
+    while (used + X86_MAX_INSN_LENGTH <= capacity) {
+        const EncodingSample *s = &samples[next_random() % SAMPLE_COUNT];
+        memcpy(stream + used, s->bytes, s->length);
+        used += s->length;
+        expected_insns++;
+    }
+
+    printf("[X86DecoderBench] 字节流: %.1f MB, %zu 条指令, %d 轮\n",
+           (double)used / (1024.0 * 1024.0), expected_insns, passes);
+
+    // 纯解码
+    double best = 1e30;
+    uint64_t checksum = 0;
+    for (int pass = 0; pass < passes; pass++) {
+        double start = now_seconds();
+        size_t pos = 0;
+        size_t count = 0;
+        X86DecodedInsn insn;
+        while (pos < used) {
+            if (x86_decode(stream + pos, used - pos, &insn) != X86_DECODE_OK) {
+                printf("[X86DecoderBench] ❌ 解码失败 @%zu\n", pos);
+                free(stream);
+                return 1;
+            }
+            checksum += insn.opcode + insn.form + (uint64_t)insn.imm;
+            pos += insn.length;
+            count++;
+        }
+        double elapsed = now_seconds() - start;
+        if (count != expected_insns) {
+            printf("[X86DecoderBench] ❌ 指令数不符: %zu != %zu\n", count, expected_insns);
+            free(stream);
+            return 1;
+        }
+        if (elapsed < best) best = elapsed;
+    }
+    printf("[X86DecoderBench] decode only:     %8.1f MB/s  %8.1f M insn/s  %6.2f ns/insn\n",
+           (double)used / best / (1024.0 * 1024.0),
+           (double)expected_insns / best / 1e6,
+           best * 1e9 / (double)expected_insns);
+
+    // 解码 + 格式化（旧实现每条指令都要做的事），只跑一轮作对比
+    {
+        char text[96];
+        size_t pos = 0;
+        X86DecodedInsn insn;
+        double start = now_seconds();
+        while (pos < used) {
+            x86_decode(stream + pos, used - pos, &insn);
+            checksum += x86_format_insn(&insn, pos, text, sizeof(text));
+            pos += insn.length;
+        }
+        double elapsed = now_seconds() - start;
+        printf("[X86DecoderBench] decode + format: %8.1f MB/s  %8.1f M insn/s  %6.2f ns/insn\n",
+               (double)used / elapsed / (1024.0 * 1024.0),
+               (double)expected_insns / elapsed / 1e6,
+               elapsed * 1e9 / (double)expected_insns);
+    }
+
+    printf("[X86DecoderBench] checksum: %llx\n", (unsigned long long)checksum);
+    free(stream);
+    return 0;
+}
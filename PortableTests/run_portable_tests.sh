@@ -0,0 +1,102 @@
+#!/bin/bash
+# 可移植C核心的主机端测试/基准脚本
+# WineForIOS/ 下的纯C模块（无Foundation依赖）在Linux/macOS主机上直接用cc编译运行，
+# 不需要Xcode和iOS设备。用法:
+#   ./run_portable_tests.sh            # 编译并运行全部
+#   ./run_portable_tests.sh bench_x86_decoder
+
+set -e
+
+# 颜色输出
+RED='\033[0;31m'
+GREEN='\033[0;32m'
+YELLOW='\033[1;33m'
+BLUE='\033[0;34m'
+NC='\033[0m'
+
+log_info() { echo -e "${BLUE}[INFO]${NC} $1"; }
+log_success() { echo -e "${GREEN}[SUCCESS]${NC} $1"; }
+log_warning() { echo -e "${YELLOW}[WARNING]${NC} $1"; }
+log_error() { echo -e "${RED}[ERROR]${NC} $1"; }
+
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+SOURCE_DIR="$SCRIPT_DIR/../WineForIOS"
+BUILD_DIR="$SCRIPT_DIR/build"
+CC="${CC:-cc}"
+CFLAGS="${CFLAGS:--std=gnu11 -O2 -Wall -Wextra}"
+LDLIBS="${LDLIBS:--lpthread -lm}"
+
+# 目标表: "目标名:依赖的WineForIOS源文件(空格分隔)"
+TARGETS=(
+    "bench_x86_decoder:X86Decoder.c"
+    "bench_lazy_flags:Box64Flags.c"
+    "test_box64_mmu:Box64MMU.c"
+    "test_box64_heap:Box64Heap.c"
+    "test_box64_trace:Box64Trace.c"
+    "test_box64_pe_loader:Box64PELoader.c Box64MMU.c"
+    "test_box64_imports:Box64Imports.c Box64PELoader.c Box64MMU.c"
+    "bench_wine_message_queue:WineMessageQueue.c"
+    "test_wine_handle_table:WineHandleTable.c"
+    "bench_wine_gdi_raster:WineGDIRaster.c"
+    "bench_d3d_dispatch:D3DDispatch.c"
+    "bench_d3d_command_stream:D3DCommandStream.c D3DDispatch.c"
+    "bench_d3d_frame_pacer:D3DFramePacer.c"
+    "test_d3d_pipeline_cache:D3DPipelineCache.c"
+    "test_d3d_shader_cache:D3DShaderDiskCache.c"
+    "test_wine_profiler:WineProfiler.c"
+    "bench_box64_sse:Box64SSE.c Box64X87.c Box64String.c Box64Interp.c Box64Flags.c Box64MMU.c Box64TranslationCache.c X86Decoder.c Box64Trace.c"
+    "test_box64_x87:Box64X87.c Box64Interp.c Box64SSE.c Box64String.c Box64Flags.c Box64MMU.c Box64TranslationCache.c X86Decoder.c Box64Trace.c"
+    "test_box64_string:Box64String.c Box64Interp.c Box64SSE.c Box64X87.c Box64Flags.c Box64MMU.c Box64TranslationCache.c X86Decoder.c Box64Trace.c"
+    "bench_box64_interp:Box64Interp.c Box64SSE.c Box64X87.c Box64String.c Box64Flags.c Box64MMU.c Box64TranslationCache.c X86Decoder.c Box64Trace.c"
+    "test_box64_thread:Box64Sync.c Box64Thread.c Box64Interp.c Box64SSE.c Box64X87.c Box64String.c Box64Flags.c Box64MMU.c Box64TranslationCache.c X86Decoder.c Box64Trace.c"
+    "test_arm64_jit:ARM64Emitter.c Box64JIT.c Box64Flags.c Box64TranslationCache.c X86Decoder.c"
+    "test_box64_code_cache:Box64CodeCache.c Box64TranslationCache.c X86Decoder.c"
+)
+
+build_target() {
+    local name="$1"
+    local sources="$2"
+    local inputs=("$SCRIPT_DIR/$name.c")
+    for src in $sources; do
+        inputs+=("$SOURCE_DIR/$src")
+    done
+
+    log_info "编译 $name..."
+    # shellcheck disable=SC2086
+    $CC $CFLAGS -I"$SOURCE_DIR" "${inputs[@]}" -o "$BUILD_DIR/$name" $LDLIBS
+}
+
+run_target() {
+    local name="$1"
+    log_info "运行 $name..."
+    if "$BUILD_DIR/$name"; then
+        log_success "$name 通过"
+        return 0
+    fi
+    log_error "$name 失败"
+    return 1
+}
+
+main() {
+    mkdir -p "$BUILD_DIR"
+    local filter="$1"
+    local failed=0
+
+    for entry in "${TARGETS[@]}"; do
+        local name="${entry%%:*}"
+        local sources="${entry#*:}"
+        if [ -n "$filter" ] && [ "$filter" != "$name" ]; then
+            continue
+        fi
+        build_target "$name" "$sources"
+        run_target "$name" || failed=$((failed + 1))
+    done
+
+    if [ "$failed" -ne 0 ]; then
+        log_error "$failed 个目标失败"
+        exit 1
+    fi
+    log_success "全部目标完成"
+}
+
+main "$@"
@@ -0,0 +1,651 @@
+// test_arm64_jit.c - ARM64Emitter 编码 / Box64JIT 寄存器分配与块编译测试
+// 编码对照 llvm-mc -triple=aarch64 -show-encoding 的输出；
+// 编译出的块在aarch64主机上装入可执行内存直接运行，其他主机上用下面的最小AArch64解释器运行
+#include "ARM64Emitter.h"
+#include "Box64JIT.h"
+#include "Box64Flags.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__aarch64__)
+#include <sys/mman.h>
+#endif
+
+static int failures = 0;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { printf("[ARM64JITTest] ❌ " __VA_ARGS__); printf("\n"); failures++; } \
+} while (0)
+
+// MARK: - 编码对照
+
+typedef struct EncodingCase {
+    const char *text;
+    uint32_t expected;
+} EncodingCase;
+
+static void check_encodings(void) {
+    uint32_t storage[64];
+    ARM64CodeBuffer buf;
+    arm64_buffer_init(&buf, storage, 64);
+
+    arm64_movz(&buf, true, A64_X3, 0x1234, 16);
+    arm64_movk(&buf, false, A64_X5, 0xBEEF, 0);
+    arm64_movn(&buf, true, A64_X0, 0, 0);
+    arm64_mov_reg(&buf, true, A64_X19, A64_X8);
+    arm64_mov_reg(&buf, false, A64_X20, A64_X21);
+    arm64_mov_sp(&buf, A64_FP, A64_SP);
+    arm64_add_imm(&buf, true, false, A64_X0, A64_X19, 0x10);
+    arm64_sub_imm(&buf, false, true, A64_X1, A64_X2, 0x1000);
+    arm64_add_reg(&buf, true, true, A64_X0, A64_X19, A64_X20);
+    arm64_sub_reg(&buf, false, true, A64_X0, A64_X21, A64_X1);
+    arm64_and_reg(&buf, true, true, A64_X0, A64_X1, A64_X2);
+    arm64_orr_reg(&buf, true, A64_X28, A64_X28, A64_X2, A64_LSL, 6);
+    arm64_eor_reg(&buf, true, A64_X6, A64_X0, A64_X0, A64_LSR, 4);
+    arm64_bic_reg(&buf, true, A64_X28, A64_X28, A64_X16);
+    arm64_and_imm(&buf, true, false, A64_X7, A64_X7, 0x10);
+    arm64_eor_imm(&buf, true, A64_X6, A64_X6, 1);
+    arm64_orr_imm(&buf, false, A64_X3, A64_X4, 0xFF00FF00);
+    arm64_ubfx(&buf, true, A64_X16, A64_X28, 11, 1);
+    arm64_cset(&buf, true, A64_X2, A64_COND_EQ);
+    arm64_cset(&buf, false, A64_X5, A64_COND_LO);
+    arm64_ldr_imm(&buf, true, A64_X19, A64_X27, 24);
+    arm64_str_imm(&buf, false, A64_X16, A64_X27, 2900);
+    arm64_stp_pre(&buf, A64_FP, A64_LR, A64_SP, -96);
+    arm64_stp_off(&buf, A64_X27, A64_X28, A64_SP, 80);
+    arm64_ldp_off(&buf, A64_X19, A64_X20, A64_SP, 16);
+    arm64_ldp_post(&buf, A64_FP, A64_LR, A64_SP, 96);
+    arm64_ret(&buf);
+    arm64_nop(&buf);
+    arm64_ldrb_imm(&buf, A64_X16, A64_X27, 300);
+    arm64_strb_imm(&buf, A64_X16, A64_X27, 300);
+    arm64_lslv(&buf, true, A64_X0, A64_X0, A64_X16);
+    arm64_lslv(&buf, false, A64_X1, A64_X2, A64_X3);
+    arm64_ldr_d_reg(&buf, 16, A64_X7, A64_X16);
+    arm64_str_d_reg(&buf, 17, A64_X7, A64_X16);
+    arm64_fmov_d(&buf, 16, 17);
+    arm64_fmov_d_from_x(&buf, 16, A64_X16);
+    arm64_fadd_d(&buf, 1, 2, 3);
+    arm64_fsub_d(&buf, 1, 2, 3);
+    arm64_fmul_d(&buf, 1, 2, 3);
+    arm64_fdiv_d(&buf, 1, 2, 3);
+    arm64_fneg_d(&buf, 1, 2);
+    arm64_fabs_d(&buf, 1, 2);
+
+    // 分支：目标为指令字下标（与 llvm-objdump 对同一段标签代码的输出一致）
+    size_t base = buf.count;
+    arm64_b(&buf, base + 8);
+    arm64_b_cond(&buf, A64_COND_NE, base);
+    arm64_cbz(&buf, true, A64_X16, base + 8);
+    arm64_cbnz(&buf, false, A64_X3, base);
+    arm64_tbz(&buf, A64_X28, 6, base + 8);
+    arm64_tbnz(&buf, A64_X28, 11, base);
+    arm64_tbnz(&buf, A64_X1, 40, base + 8);
+
+    static const EncodingCase expected[] = {
+        { "movz x3, #0x1234, lsl #16",  0xD2A24683 },
+        { "movk w5, #0xbeef",           0x7297DDE5 },
+        { "movn x0, #0",                0x92800000 },
+        { "mov x19, x8",                0xAA0803F3 },
+        { "mov w20, w21",               0x2A1503F4 },
+        { "mov x29, sp",                0x910003FD },
+        { "add x0, x19, #0x10",         0x91004260 },
+        { "subs w1, w2, #1, lsl #12",   0x71400441 },
+        { "adds x0, x19, x20",          0xAB140260 },
+        { "subs w0, w21, w1",           0x6B0102A0 },
+        { "ands x0, x1, x2",            0xEA020020 },
+        { "orr x28, x28, x2, lsl #6",   0xAA021B9C },
+        { "eor x6, x0, x0, lsr #4",     0xCA401006 },
+        { "bic x28, x28, x16",          0x8A30039C },
+        { "and x7, x7, #0x10",          0x927C00E7 },
+        { "eor x6, x6, #1",             0xD24000C6 },
+        { "orr w3, w4, #0xff00ff00",    0x32089C83 },
+        { "ubfx x16, x28, #11, #1",     0xD34B2F90 },
+        { "cset x2, eq",                0x9A9F17E2 },
+        { "cset w5, lo",                0x1A9F27E5 },
+        { "ldr x19, [x27, #24]",        0xF9400F73 },
+        { "str w16, [x27, #2900]",      0xB90B5770 },
+        { "stp x29, x30, [sp, #-96]!",  0xA9BA7BFD },
+        { "stp x27, x28, [sp, #80]",    0xA90573FB },
+        { "ldp x19, x20, [sp, #16]",    0xA94153F3 },
+        { "ldp x29, x30, [sp], #96",    0xA8C67BFD },
+        { "ret",                        0xD65F03C0 },
+        { "nop",                        0xD503201F },
+        { "ldrb w16, [x27, #300]",      0x3944B370 },
+        { "strb w16, [x27, #300]",      0x3904B370 },
+        { "lsl x0, x0, x16",            0x9AD02000 },
+        { "lsl w1, w2, w3",             0x1AC32041 },
+        { "ldr d16, [x7, x16, lsl #3]", 0xFC7078F0 },
+        { "str d17, [x7, x16, lsl #3]", 0xFC3078F1 },
+        { "fmov d16, d17",              0x1E604230 },
+        { "fmov d16, x16",              0x9E670210 },
+        { "fadd d1, d2, d3",            0x1E632841 },
+        { "fsub d1, d2, d3",            0x1E633841 },
+        { "fmul d1, d2, d3",            0x1E630841 },
+        { "fdiv d1, d2, d3",            0x1E631841 },
+        { "fneg d1, d2",                0x1E614041 },
+        { "fabs d1, d2",                0x1E60C041 },
+        { "b +8",                       0x14000008 },
+        { "b.ne -1",                    0x54FFFFE1 },
+        { "cbz x16, +6",                0xB40000D0 },
+        { "cbnz w3, -3",                0x35FFFFA3 },
+        { "tbz w28, #6, +4",            0x3630009C },
+        { "tbnz w28, #11, -5",          0x375FFF7C },
+        { "tbnz x1, #40, +2",           0xB7400041 },
+    };
+    const size_t count = sizeof(expected) / sizeof(expected[0]);
+
+    CHECK(!buf.overflow && buf.count == count, "emitted %zu words, expected %zu", buf.count, count);
+    for (size_t i = 0; i < count && i < buf.count; i++) {
+        CHECK(storage[i] == expected[i].expected, "%-28s got 0x%08X expected 0x%08X",
+              expected[i].text, storage[i], expected[i].expected);
+    }
+
+    // 不可编码的值必须被拒绝而不是生成错误指令
+    uint32_t encoding;
+    CHECK(!arm64_encode_logical_imm(0, true, &encoding), "logical imm 0 accepted");
+    CHECK(!arm64_encode_logical_imm(0x41, true, &encoding), "logical imm 0x41 accepted");
+    CHECK(!arm64_add_imm(&buf, true, false, A64_X0, A64_X0, 0x1001), "add imm 0x1001 accepted");
+
+    // MOVZ/MOVN 序列长度
+    arm64_buffer_init(&buf, storage, 64);
+    arm64_mov_imm(&buf, true, A64_X0, 0xFFFFFFFFFFFFFFFEULL);
+    CHECK(buf.count == 1 && storage[0] == 0x92800020, "mov x0, #-2 -> %zu words 0x%08X", buf.count, storage[0]);
+    arm64_buffer_init(&buf, storage, 64);
+    arm64_mov_imm(&buf, true, A64_X0, 0x0000123400005678ULL);
+    CHECK(buf.count == 2, "mov x0, #0x123400005678 -> %zu words", buf.count);
+
+    // 溢出只置标志
+    arm64_buffer_init(&buf, storage, 1);
+    arm64_nop(&buf);
+    arm64_nop(&buf);
+    CHECK(buf.overflow && buf.count == 1, "overflow not reported");
+}
+
+// MARK: - 最小AArch64解释器（只覆盖 Box64JIT 生成的指令）
+
+typedef struct SimCPU {
+    uint64_t x[32];     // x[31] 作 SP 使用，XZR 单独处理
+    double d[32];       // 浮点寄存器的低64位
+    uint32_t nzcv;      // N=8 Z=4 C=2 V=1
+} SimCPU;
+
+static inline uint64_t sim_reg(const SimCPU *cpu, uint32_t r, bool sp) {
+    return r == 31 ? (sp ? cpu->x[31] : 0) : cpu->x[r];
+}
+
+static inline void sim_set(SimCPU *cpu, uint32_t r, uint64_t v, bool is64, bool sp) {
+    if (r == 31 && !sp) return;
+    cpu->x[r] = is64 ? v : (v & 0xFFFFFFFFULL);
+}
+
+static uint64_t sim_shift(uint64_t v, uint32_t type, uint32_t amount, bool is64) {
+    if (!is64) v &= 0xFFFFFFFFULL;
+    switch (type) {
+        case 0: v <<= amount; break;
+        case 1: v >>= amount; break;
+        default: return v;
+    }
+    return is64 ? v : (v & 0xFFFFFFFFULL);
+}
+
+static uint64_t sim_bitmask(uint32_t n, uint32_t immr, uint32_t imms) {
+    uint32_t combined = (n << 6) | (~imms & 0x3F);
+    int len = 31 - __builtin_clz(combined);
+    uint32_t size = 1u << len;
+    uint32_t s = imms & (size - 1), r = immr & (size - 1);
+    uint64_t mask = size == 64 ? ~0ULL : ((1ULL << size) - 1);
+    uint64_t element = s + 1 == 64 ? ~0ULL : ((1ULL << (s + 1)) - 1);
+    if (r) element = ((element >> r) | (element << (size - r))) & mask;
+    uint64_t result = 0;
+    for (uint32_t i = 0; i < 64; i += size) result |= element << i;
+    return result;
+}
+
+static void sim_flags_add(SimCPU *cpu, uint64_t a, uint64_t b, uint64_t carry_in, bool is64) {
+    const uint64_t mask = is64 ? ~0ULL : 0xFFFFFFFFULL;
+    const uint64_t sign = is64 ? (1ULL << 63) : (1ULL << 31);
+    a &= mask; b &= mask;
+    uint64_t r = (a + b + carry_in) & mask;
+    bool c = is64 ? (r < a || (carry_in && r == a)) : ((a + b + carry_in) >> 32) != 0;
+    bool v = ((~(a ^ b) & (a ^ r)) & sign) != 0;
+    cpu->nzcv = ((r & sign) ? 8 : 0) | (r == 0 ? 4 : 0) | (c ? 2 : 0) | (v ? 1 : 0);
+}
+
+static bool sim_cond(const SimCPU *cpu, uint32_t cond) {
+    bool n = cpu->nzcv & 8, z = cpu->nzcv & 4, c = cpu->nzcv & 2, v = cpu->nzcv & 1;
+    bool result;
+    switch (cond >> 1) {
+        case 0: result = z; break;
+        case 1: result = c; break;
+        case 2: result = n; break;
+        case 3: result = v; break;
+        case 4: result = c && !z; break;
+        case 5: result = n == v; break;
+        case 6: result = n == v && !z; break;
+        default: result = true; break;
+    }
+    return (cond & 1) && cond != 15 ? !result : result;
+}
+
+static uint64_t sim_run(const uint32_t *code, size_t words, Box64Context *ctx) {
+    static uint64_t stack[256];
+    SimCPU cpu;
+    memset(&cpu, 0, sizeof(cpu));
+    cpu.x[0] = (uint64_t)(uintptr_t)ctx;
+    cpu.x[31] = (uint64_t)(uintptr_t)&stack[256];
+    cpu.x[30] = 0xDEAD0000;     // 返回地址哨兵
+
+    size_t pc = 0;
+    for (int steps = 0; steps < 100000 && pc < words; steps++) {
+        const uint32_t w = code[pc];
+        const bool is64 = w >> 31;
+        const uint32_t rd = w & 31, rn = (w >> 5) & 31, rm = (w >> 16) & 31;
+        size_t next = pc + 1;
+
+        if (w == ARM64_RET_WORD) {
+            return cpu.x[0];
+        } else if (w == ARM64_NOP_WORD) {
+        } else if ((w & 0xFFFFFC1F) == 0xD63F0000) {                 // BLR：只允许调用惰性标志求值
+            if (cpu.x[rn] != (uint64_t)(uintptr_t)&box64_flags_materialize) {
+                printf("[ARM64JITTest] ❌ simulator: BLR to unknown target\n");
+                failures++;
+                return 0;
+            }
+            uint64_t result = box64_flags_materialize((Box64Context *)(uintptr_t)cpu.x[0]);
+            // 按调用约定破坏 x0-x18 与NZCV，暴露调用后仍依赖它们的代码
+            for (int r = 1; r <= 18; r++) cpu.x[r] = 0xBAD0000000000000ULL | (uint64_t)r;
+            for (int r = 0; r < 32; r++) if (r < 8 || r > 15) cpu.d[r] = -1e300;
+            cpu.x[0] = result;
+            cpu.nzcv = 0xF;
+        } else if ((w & 0xFFC00000) == 0x39400000 || (w & 0xFFC00000) == 0x39000000) {  // LDRB/STRB 无符号偏移
+            uint8_t *addr = (uint8_t *)(uintptr_t)(sim_reg(&cpu, rn, true) + ((w >> 10) & 0xFFF));
+            if ((w >> 22) & 1) sim_set(&cpu, rd, *addr, false, false);
+            else *addr = (uint8_t)sim_reg(&cpu, rd, false);
+        } else if ((w & 0x7FE0FC00) == 0x1AC02000) {                 // LSLV
+            uint64_t amount = sim_reg(&cpu, rm, false) & (is64 ? 63 : 31);
+            sim_set(&cpu, rd, sim_shift(sim_reg(&cpu, rn, false), 0, (uint32_t)amount, is64), is64, false);
+        } else if ((w & 0xFFE0FC00) == 0xFC607800 || (w & 0xFFE0FC00) == 0xFC207800) {  // LDR/STR D 寄存器偏移
+            uint8_t *addr = (uint8_t *)(uintptr_t)(sim_reg(&cpu, rn, true) + (sim_reg(&cpu, rm, false) << 3));
+            if ((w >> 22) & 1) memcpy(&cpu.d[rd], addr, 8);
+            else memcpy(addr, &cpu.d[rd], 8);
+        } else if ((w & 0xFFFFFC00) == 0x1E604000) {                 // FMOV Dd, Dn
+            cpu.d[rd] = cpu.d[rn];
+        } else if ((w & 0xFFFFFC00) == 0x9E670000) {                 // FMOV Dd, Xn
+            uint64_t bits = sim_reg(&cpu, rn, false);
+            memcpy(&cpu.d[rd], &bits, 8);
+        } else if ((w & 0xFFE00C00) == 0x1E600800) {                 // FMUL/FDIV/FADD/FSUB 标量双精度
+            const double a = cpu.d[rn], b = cpu.d[rm];
+            switch ((w >> 12) & 15) {
+                case 0: cpu.d[rd] = a * b; break;
+                case 1: cpu.d[rd] = a / b; break;
+                case 2: cpu.d[rd] = a + b; break;
+                case 3: cpu.d[rd] = a - b; break;
+                default:
+                    printf("[ARM64JITTest] ❌ simulator: unknown fp op 0x%08X\n", w);
+                    failures++;
+                    return 0;
+            }
+        } else if ((w & 0xFFFFFC00) == 0x1E614000) {                 // FNEG
+            cpu.d[rd] = -cpu.d[rn];
+        } else if ((w & 0xFFFFFC00) == 0x1E60C000) {                 // FABS
+            cpu.d[rd] = cpu.d[rn] < 0 || (cpu.d[rn] == 0 && 1 / cpu.d[rn] < 0) ? -cpu.d[rn] : cpu.d[rn];
+        } else if ((w & 0x1F800000) == 0x12800000) {                 // MOVN/MOVZ/MOVK
+            uint32_t opc = (w >> 29) & 3, hw = (w >> 21) & 3;
+            uint64_t imm = (uint64_t)((w >> 5) & 0xFFFF) << (hw * 16);
+            uint64_t value = opc == 0 ? ~imm : opc == 2 ? imm
+                           : ((sim_reg(&cpu, rd, false) & ~(0xFFFFULL << (hw * 16))) | imm);
+            sim_set(&cpu, rd, value, is64, false);
+        } else if ((w & 0x1F000000) == 0x11000000) {                 // ADD/SUB(S) 立即数
+            bool sub = (w >> 30) & 1, s = (w >> 29) & 1;
+            uint64_t imm = ((w >> 10) & 0xFFF) << (((w >> 22) & 1) * 12);
+            uint64_t a = sim_reg(&cpu, rn, true);
+            uint64_t r;
+            if (sub) { r = a - imm; if (s) sim_flags_add(&cpu, a, ~imm, 1, is64); }
+            else     { r = a + imm; if (s) sim_flags_add(&cpu, a, imm, 0, is64); }
+            sim_set(&cpu, rd, r, is64, !s);
+        } else if ((w & 0x1F200000) == 0x0B000000) {                 // ADD/SUB(S) 寄存器
+            bool sub = (w >> 30) & 1, s = (w >> 29) & 1;
+            uint64_t a = sim_reg(&cpu, rn, false);
+            uint64_t b = sim_shift(sim_reg(&cpu, rm, false), (w >> 22) & 3, (w >> 10) & 63, is64);
+            uint64_t r;
+            if (sub) { r = a - b; if (s) sim_flags_add(&cpu, a, ~b, 1, is64); }
+            else     { r = a + b; if (s) sim_flags_add(&cpu, a, b, 0, is64); }
+            sim_set(&cpu, rd, r, is64, false);
+        } else if ((w & 0x1F000000) == 0x0A000000) {                 // 逻辑 移位寄存器
+            uint32_t opc = (w >> 29) & 3;
+            uint64_t a = sim_reg(&cpu, rn, false);
+            uint64_t b = sim_shift(sim_reg(&cpu, rm, false), (w >> 22) & 3, (w >> 10) & 63, is64);
+            if ((w >> 21) & 1) b = ~b;
+            uint64_t r = opc == 1 ? (a | b) : opc == 2 ? (a ^ b) : (a & b);
+            if (!is64) r &= 0xFFFFFFFFULL;
+            if (opc == 3) {
+                uint64_t sign = is64 ? (1ULL << 63) : (1ULL << 31);
+                cpu.nzcv = ((r & sign) ? 8 : 0) | (r == 0 ? 4 : 0);
+            }
+            sim_set(&cpu, rd, r, is64, false);
+        } else if ((w & 0x1F800000) == 0x12000000) {                 // 逻辑 立即数
+            uint32_t opc = (w >> 29) & 3;
+            uint64_t imm = sim_bitmask((w >> 22) & 1, (w >> 16) & 63, (w >> 10) & 63);
+            uint64_t a = sim_reg(&cpu, rn, false);
+            uint64_t r = opc == 1 ? (a | imm) : opc == 2 ? (a ^ imm) : (a & imm);
+            if (!is64) r &= 0xFFFFFFFFULL;
+            if (opc == 3) {
+                uint64_t sign = is64 ? (1ULL << 63) : (1ULL << 31);
+                cpu.nzcv = ((r & sign) ? 8 : 0) | (r == 0 ? 4 : 0);
+            }
+            sim_set(&cpu, rd, r, is64, opc != 3);
+        } else if ((w & 0x7F800000) == 0x53000000) {                 // UBFM（仅UBFX形式）
+            uint32_t immr = (w >> 16) & 63, imms = (w >> 10) & 63;
+            uint64_t v = sim_reg(&cpu, rn, false) >> immr;
+            uint32_t width = imms - immr + 1;
+            sim_set(&cpu, rd, width >= 64 ? v : (v & ((1ULL << width) - 1)), is64, false);
+        } else if ((w & 0x7FE00C00) == 0x1A800400) {                 // CSINC
+            uint64_t v = sim_cond(&cpu, (w >> 12) & 15) ? sim_reg(&cpu, rn, false) : sim_reg(&cpu, rm, false) + 1;
+            sim_set(&cpu, rd, v, is64, false);
+        } else if ((w & 0xBFC00000) == 0xB9400000 || (w & 0xBFC00000) == 0xB9000000) {  // LDR/STR 无符号偏移
+            bool wide = (w >> 30) & 1, load = (w >> 22) & 1;
+            uint8_t *addr = (uint8_t *)(uintptr_t)(sim_reg(&cpu, rn, true) + (((w >> 10) & 0xFFF) << (wide ? 3 : 2)));
+            if (load) {
+                uint64_t v = 0;
+                memcpy(&v, addr, wide ? 8 : 4);
+                sim_set(&cpu, rd, v, true, false);
+            } else {
+                uint64_t v = sim_reg(&cpu, rd, false);
+                memcpy(addr, &v, wide ? 8 : 4);
+            }
+        } else if ((w & 0xFC000000) == 0xA8000000) {                 // STP/LDP
+            uint32_t mode = (w >> 23) & 3;   // 1=post 2=offset 3=pre
+            bool load = (w >> 22) & 1;
+            int64_t offset = (int64_t)((int32_t)(w << 10) >> 25) * 8;
+            uint64_t base = sim_reg(&cpu, rn, true);
+            uint64_t *addr = (uint64_t *)(uintptr_t)(mode == 1 ? base : base + (uint64_t)offset);
+            uint32_t rt2 = (w >> 10) & 31;
+            if (load) { cpu.x[rd] = addr[0]; cpu.x[rt2] = addr[1]; }
+            else      { addr[0] = sim_reg(&cpu, rd, false); addr[1] = sim_reg(&cpu, rt2, false); }
+            if (mode != 2) cpu.x[rn] = base + (uint64_t)offset;
+        } else if ((w & 0xFC000000) == 0x14000000) {                 // B
+            next = pc + (size_t)(int64_t)((int32_t)(w << 6) >> 6);
+        } else if ((w & 0xFF000010) == 0x54000000) {                 // B.cond
+            if (sim_cond(&cpu, w & 15)) next = pc + (size_t)(int64_t)((int32_t)(w << 8) >> 13);
+        } else if ((w & 0x7E000000) == 0x34000000) {                 // CBZ/CBNZ
+            uint64_t v = sim_reg(&cpu, rd, false);
+            if (!is64) v &= 0xFFFFFFFFULL;
+            if ((v == 0) != ((w >> 24) & 1)) next = pc + (size_t)(int64_t)((int32_t)(w << 8) >> 13);
+        } else if ((w & 0x7E000000) == 0x36000000) {                 // TBZ/TBNZ
+            uint32_t bit = ((w >> 31) << 5) | ((w >> 19) & 31);
+            bool set = (sim_reg(&cpu, rd, false) >> bit) & 1;
+            if (set == ((w >> 24) & 1)) next = pc + (size_t)(int64_t)((int32_t)(w << 13) >> 18);
+        } else {
+            printf("[ARM64JITTest] ❌ simulator: unknown word 0x%08X at %zu\n", w, pc);
+            failures++;
+            return 0;
+        }
+        pc = next;
+    }
+    printf("[ARM64JITTest] ❌ simulator: ran off the end / step limit\n");
+    failures++;
+    return 0;
+}
+
+// MARK: - 块编译与执行
+
+static uint64_t run_block(const uint32_t *code, size_t words, Box64Context *ctx) {
+#if defined(__aarch64__)
+    size_t size = (words * sizeof(uint32_t) + 4095) & ~(size_t)4095;
+    void *memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        failures++;
+        return 0;
+    }
+    memcpy(memory, code, words * sizeof(uint32_t));
+    // W^X: 写完后切到R|X，再失效指令缓存
+    mprotect(memory, size, PROT_READ | PROT_EXEC);
+    __builtin___clear_cache((char *)memory, (char *)memory + words * sizeof(uint32_t));
+    uint64_t next = ((Box64JITBlockFn)memory)(ctx);
+    munmap(memory, size);
+    return next;
+#else
+    return sim_run(code, words, ctx);
+#endif
+}
+
+#define GUEST_BASE 0x400000ULL
+
+typedef struct BlockCase {
+    const char *name;
+    uint8_t bytes[48];
+    size_t length;
+    uint64_t initial_rflags;
+    uint32_t expect_insns;          // 预期可编译的指令数（0=不可编译）
+    uint64_t expect_rip;
+    int check_reg;                  // 检查的客户机寄存器，-1为不检查
+    uint64_t expect_value;
+    uint64_t expect_flags;          // 与 0x8D5 相与后比较
+} BlockCase;
+
+static const BlockCase block_cases[] = {
+    // mov eax,10; mov ecx,20; add eax,ecx; cmp eax,30; je +2 → 跳转成立
+    { "mov/add/cmp/je", { 0xB8, 10, 0, 0, 0, 0xB9, 20, 0, 0, 0, 0x01, 0xC8, 0x83, 0xF8, 30, 0x74, 0x02 }, 17,
+      0x202, 5, GUEST_BASE + 17 + 2, 0, 30, 0x44 },
+    // mov rax,-1; add rax,1 → 0，CF ZF PF AF，块因数据结束而结束
+    { "add carry", { 0x48, 0xC7, 0xC0, 0xFF, 0xFF, 0xFF, 0xFF, 0x48, 0x83, 0xC0, 0x01 }, 11,
+      0x202, 2, GUEST_BASE + 11, 0, 0, 0x55 },
+    // mov eax,5; sub eax,7; jl -16 → 0xFFFFFFFE（零扩展），CF SF AF，L成立
+    { "sub borrow/jl", { 0xB8, 5, 0, 0, 0, 0x83, 0xE8, 0x07, 0x7C, 0xF0 }, 10,
+      0x202, 3, GUEST_BASE + 10 - 16, 0, 0xFFFFFFFEULL, 0x91 },
+    // mov edx,0x7FFFFFFF; inc edx; jno +5 → OF置位，跳转不成立，CF保持为1
+    { "inc overflow/jno", { 0xBA, 0xFF, 0xFF, 0xFF, 0x7F, 0xFF, 0xC2, 0x71, 0x05 }, 9,
+      0x203, 3, GUEST_BASE + 9, 2, 0x80000000ULL, 0x895 },
+    // mov r9d,3; xchg rax,r9; xor ecx,ecx → RAX=3
+    { "r9/xchg/xor", { 0x41, 0xB9, 3, 0, 0, 0, 0x49, 0x91, 0x31, 0xC9 }, 10,
+      0x203, 3, GUEST_BASE + 10, 0, 3, 0x44 },
+    // mov r8,5; push rax; ret → 只编译第一条，返回PUSH的地址
+    { "prefix stops at push", { 0x49, 0xC7, 0xC0, 5, 0, 0, 0, 0x50, 0xC3 }, 9,
+      0x202, 1, GUEST_BASE + 7, 8, 5, 0 },
+    // or rbx,rbx; jbe +0x10 → 0x34有奇数个1，PF=0；ZF=0 CF=0，跳转不成立
+    { "or/jbe", { 0x48, 0x09, 0xDB, 0x0F, 0x86, 0x10, 0, 0, 0 }, 9,
+      0x202, 2, GUEST_BASE + 9, 3, 0x1234, 0 },
+    // mov eax,1; add eax,2; jp +4 → PF无法用NZCV表示，块内调用求值函数；3有偶数个1，跳转成立
+    { "add/jp helper", { 0xB8, 1, 0, 0, 0, 0x83, 0xC0, 0x02, 0x7A, 0x04 }, 10,
+      0x202, 3, GUEST_BASE + 10 + 4, 0, 3, 0x04 },
+    // mov ecx,1; dec ecx; jbe +3 → DEC的CF取自入口rflags，BE需要CF，走求值函数
+    { "dec/jbe entry cf", { 0xB9, 1, 0, 0, 0, 0xFF, 0xC9, 0x76, 0x03 }, 9,
+      0x203, 3, GUEST_BASE + 9 + 3, 1, 0, 0x45 },
+    // mov rax,-1; add rax,1; inc rax; jb +2 → INC保留ADD产生的CF
+    { "add/inc/jb carry", { 0x48, 0xC7, 0xC0, 0xFF, 0xFF, 0xFF, 0xFF, 0x48, 0x83, 0xC0, 0x01, 0x48, 0xFF, 0xC0, 0x72, 0x02 }, 16,
+      0x202, 4, GUEST_BASE + 16 + 2, 0, 1, 0x01 },
+    // jb +2 → 只读入口标志
+    { "jb entry flags", { 0x72, 0x02 }, 2, 0x203, 1, GUEST_BASE + 2 + 2, -1, 0, 0 },
+    // mov rsp,rax → RSP写入必须留给解释器
+    { "rsp write rejected", { 0x48, 0x89, 0xC4 }, 3, 0x202, 0, 0, -1, 0, 0 },
+};
+
+static void check_blocks(void) {
+    Box64TranslationCache *cache = box64_tc_create(16);
+    static uint32_t code[BOX64_JIT_MAX_BLOCK_WORDS];
+
+    for (size_t i = 0; i < sizeof(block_cases) / sizeof(block_cases[0]); i++) {
+        const BlockCase *tc = &block_cases[i];
+        box64_tc_flush(cache);
+        Box64Block *block = box64_tc_translate(cache, GUEST_BASE, tc->bytes, tc->length, NULL);
+        if (!block) {
+            CHECK(0, "%s: translate failed", tc->name);
+            continue;
+        }
+
+        Box64JITRegUsage usage;
+        size_t words = box64_jit_compile_block(block, code, BOX64_JIT_MAX_BLOCK_WORDS, &usage);
+        if (tc->expect_insns == 0) {
+            CHECK(words == 0, "%s: compiled %zu words, expected rejection", tc->name, words);
+            continue;
+        }
+        CHECK(words > 0 && usage.compiled_insns == tc->expect_insns, "%s: compiled %u insns, expected %u",
+              tc->name, usage.compiled_insns, tc->expect_insns);
+        if (words == 0) {
+            continue;
+        }
+
+        // 序言/尾声形状
+        CHECK(code[0] == 0xA9BA7BFD && code[1] == 0x910003FD && code[7] == 0xAA0003FB,
+              "%s: unexpected prologue", tc->name);
+        CHECK(code[words - 1] == ARM64_RET_WORD && code[words - 2] == 0xA8C67BFD,
+              "%s: unexpected epilogue", tc->name);
+
+        Box64Context *ctx = calloc(1, sizeof(Box64Context));
+        for (int r = 0; r < 16; r++) {
+            ctx->x86_regs[r] = 0x1111111100000000ULL * (uint64_t)(r + 1);
+        }
+        ctx->x86_regs[3] = 0x1234;
+        ctx->rflags = tc->initial_rflags;
+        ctx->instruction_count = 7;
+
+        uint64_t next = run_block(code, words, ctx);
+        CHECK(next == tc->expect_rip, "%s: next rip 0x%llx, expected 0x%llx", tc->name,
+              (unsigned long long)next, (unsigned long long)tc->expect_rip);
+        CHECK(ctx->instruction_count == 7 + tc->expect_insns, "%s: instruction_count %u", tc->name, ctx->instruction_count);
+        if (tc->check_reg >= 0) {
+            CHECK(ctx->x86_regs[tc->check_reg] == tc->expect_value, "%s: reg%d = 0x%llx, expected 0x%llx", tc->name,
+                  tc->check_reg, (unsigned long long)ctx->x86_regs[tc->check_reg], (unsigned long long)tc->expect_value);
+        }
+        if (usage.writes_flags) {
+            box64_flags_materialize(ctx);
+            CHECK((ctx->rflags & 0x8D5) == tc->expect_flags, "%s: rflags 0x%llx, expected 0x%llx", tc->name,
+                  (unsigned long long)(ctx->rflags & 0x8D5), (unsigned long long)tc->expect_flags);
+            CHECK((ctx->rflags & 0x200) != 0, "%s: IF lost", tc->name);
+        }
+        free(ctx);
+    }
+    box64_tc_destroy(cache);
+}
+
+// 寄存器分配：写在读之前的寄存器不装入，只写回改过的寄存器
+static void check_register_usage(void) {
+    Box64TranslationCache *cache = box64_tc_create(16);
+    // mov eax,10; add rax,rbx; mov rcx,rdx; cmp r8,r9; je
+    static const uint8_t bytes[] = { 0xB8, 10, 0, 0, 0, 0x48, 0x01, 0xD8, 0x48, 0x89, 0xD1, 0x4D, 0x39, 0xC8, 0x74, 0x00 };
+    Box64Block *block = box64_tc_translate(cache, GUEST_BASE, bytes, sizeof(bytes), NULL);
+    Box64JITRegUsage usage;
+    uint32_t count = block ? box64_jit_analyze(block, &usage) : 0;
+
+    CHECK(count == 5, "analyze: %u insns", count);
+    CHECK(usage.live_in == ((1u << 3) | (1u << 2) | (1u << 8) | (1u << 9)),
+          "analyze: live_in 0x%04X", usage.live_in);
+    CHECK(usage.dirty == ((1u << 0) | (1u << 1)), "analyze: dirty 0x%04X", usage.dirty);
+    CHECK(usage.reads_flags && usage.writes_flags, "analyze: flag usage");
+
+    // 映射避开 X16-X18 与 X27/X28
+    for (int r = 0; r < 16; r++) {
+        uint8_t host = box64_jit_guest_register_map[r];
+        CHECK(host != A64_X16 && host != A64_X17 && host != A64_X18 && host < A64_X27, "map[%d] = x%u", r, host);
+    }
+    box64_tc_destroy(cache);
+}
+
+// 入口处上下文中还有待计算的标志（解释器留下的 CMP），块开头先求值
+static void check_entry_lazy_flags(void) {
+    Box64TranslationCache *cache = box64_tc_create(16);
+    static const uint8_t bytes[] = { 0x72, 0x10 };     // jb +0x10
+    static uint32_t code[BOX64_JIT_MAX_BLOCK_WORDS];
+    Box64Block *block = box64_tc_translate(cache, GUEST_BASE, bytes, sizeof(bytes), NULL);
+    Box64JITRegUsage usage;
+    size_t words = block ? box64_jit_compile_block(block, code, BOX64_JIT_MAX_BLOCK_WORDS, &usage) : 0;
+    CHECK(words > 0 && usage.needs_entry_flags, "entry flags: not compiled / not flagged");
+
+    Box64Context *ctx = calloc(1, sizeof(Box64Context));
+    ctx->rflags = 0x202;
+    box64_flags_record(ctx, BOX64_FLAGS_SUB, 1, 2, (uint64_t)-1, 4);   // cmp 1,2 → CF=1
+    uint64_t next = words ? run_block(code, words, ctx) : 0;
+    CHECK(next == GUEST_BASE + 2 + 0x10, "entry flags: next rip 0x%llx", (unsigned long long)next);
+    CHECK(ctx->lazy_flags.op == BOX64_FLAGS_NONE && (ctx->rflags & 0x8D5) == 0x95,
+          "entry flags: rflags 0x%llx op %u", (unsigned long long)ctx->rflags, ctx->lazy_flags.op);
+    free(ctx);
+    box64_tc_destroy(cache);
+}
+
+// x87 快速模式：栈槽在块内缓存于浮点寄存器，出块时写回值、非空位与 TOP
+static void check_x87_blocks(void) {
+    Box64TranslationCache *cache = box64_tc_create(16);
+    static uint32_t code[BOX64_JIT_MAX_BLOCK_WORDS];
+    // fld st(1); fmul st,st(1); fxch st(2); fstp st(1); fchs
+    static const uint8_t bytes[] = { 0xD9, 0xC1, 0xD8, 0xC9, 0xD9, 0xCA, 0xDD, 0xD9, 0xD9, 0xE0 };
+    Box64Block *block = box64_tc_translate(cache, GUEST_BASE, bytes, sizeof(bytes), NULL);
+    Box64JITRegUsage usage;
+    size_t words = block ? box64_jit_compile_block(block, code, BOX64_JIT_MAX_BLOCK_WORDS, &usage) : 0;
+    CHECK(words > 0 && usage.compiled_insns == 5, "x87: compiled %u insns", usage.compiled_insns);
+    CHECK(usage.x87_live_in == 0x03 && usage.x87_require_valid == 0x03 && usage.x87_require_empty == 0x80,
+          "x87: live_in 0x%02X require_valid 0x%02X require_empty 0x%02X",
+          usage.x87_live_in, usage.x87_require_valid, usage.x87_require_empty);
+    CHECK(usage.x87_final_valid == 0x03 && usage.x87_touched == 0x83 && usage.x87_top_delta == 0,
+          "x87: final_valid 0x%02X touched 0x%02X delta %u",
+          usage.x87_final_valid, usage.x87_touched, usage.x87_top_delta);
+
+    // 0: 正常执行；1: 扩展精度模式；2: ST(1) 为空 —— 后两者不执行任何指令，返回块首
+    for (int variant = 0; words && variant < 3; variant++) {
+        Box64Context *ctx = calloc(1, sizeof(Box64Context));
+        ctx->x87.top = 5;
+        ctx->x87.valid = variant == 2 ? 0x20 : 0x60;
+        ctx->x87.extended = variant == 1;
+        ctx->x87.st[5] = 3.0;
+        ctx->x87.st[6] = 4.0;
+        ctx->instruction_count = 7;
+
+        uint64_t next = run_block(code, words, ctx);
+        if (variant == 0) {
+            CHECK(next == GUEST_BASE + sizeof(bytes), "x87: next rip 0x%llx", (unsigned long long)next);
+            CHECK(ctx->instruction_count == 12, "x87: instruction_count %u", ctx->instruction_count);
+            CHECK(ctx->x87.top == 5 && ctx->x87.valid == 0x60, "x87: top %u valid 0x%02X", ctx->x87.top, ctx->x87.valid);
+            CHECK(ctx->x87.st[5] == -4.0 && ctx->x87.st[6] == 12.0, "x87: st5 %g st6 %g", ctx->x87.st[5], ctx->x87.st[6]);
+        } else {
+            CHECK(next == GUEST_BASE && ctx->instruction_count == 7, "x87 bail %d: next 0x%llx count %u", variant,
+                  (unsigned long long)next, ctx->instruction_count);
+            CHECK(ctx->x87.top == 5 && ctx->x87.st[5] == 3.0, "x87 bail %d: state changed", variant);
+        }
+        free(ctx);
+    }
+
+    // fld1; fld1; faddp; fld1; fdivrp → 压栈进入空栈，入口只要求目标槽为空
+    static const uint8_t push_bytes[] = { 0xD9, 0xE8, 0xD9, 0xE8, 0xDE, 0xC1, 0xD9, 0xE8, 0xDE, 0xF1 };
+    box64_tc_flush(cache);
+    block = box64_tc_translate(cache, GUEST_BASE, push_bytes, sizeof(push_bytes), NULL);
+    words = block ? box64_jit_compile_block(block, code, BOX64_JIT_MAX_BLOCK_WORDS, &usage) : 0;
+    CHECK(words > 0 && usage.x87_live_in == 0 && usage.x87_require_valid == 0 && usage.x87_top_delta == 7,
+          "x87 push: live_in 0x%02X require_valid 0x%02X delta %u",
+          usage.x87_live_in, usage.x87_require_valid, usage.x87_top_delta);
+    if (words) {
+        Box64Context *ctx = calloc(1, sizeof(Box64Context));
+        ctx->x87.valid = 0x01;      // 空栈之外的寄存器非空位不受影响
+        ctx->x87.st[0] = 9.0;
+        run_block(code, words, ctx);
+        CHECK(ctx->x87.top == 7 && ctx->x87.valid == 0x81 && ctx->x87.st[7] == 0.5 && ctx->x87.st[0] == 9.0,
+              "x87 push: top %u valid 0x%02X st7 %g", ctx->x87.top, ctx->x87.valid, ctx->x87.st[7]);
+        free(ctx);
+    }
+
+    // fld1; fstp st(0); fld st(7) → ST(7) 是刚弹出的槽（栈下溢），留给解释器
+    static const uint8_t underflow_bytes[] = { 0xD9, 0xE8, 0xDD, 0xD8, 0xD9, 0xC7 };
+    box64_tc_flush(cache);
+    block = box64_tc_translate(cache, GUEST_BASE, underflow_bytes, sizeof(underflow_bytes), NULL);
+    CHECK(block && box64_jit_analyze(block, &usage) == 2, "x87 underflow: compiled %u insns", usage.compiled_insns);
+    box64_tc_destroy(cache);
+}
+
+int main(void) {
+    check_encodings();
+    check_register_usage();
+    check_blocks();
+    check_entry_lazy_flags();
+    check_x87_blocks();
+
+#if defined(__aarch64__)
+    printf("[ARM64JITTest] blocks executed natively\n");
+#else
+    printf("[ARM64JITTest] blocks executed on the built-in AArch64 interpreter (non-aarch64 host)\n");
+#endif
+    if (failures) {
+        printf("[ARM64JITTest] %d failure(s)\n", failures);
+        return 1;
+    }
+    printf("[ARM64JITTest] ✅ all checks passed\n");
+    return 0;
+}
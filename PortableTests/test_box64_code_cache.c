@@ -0,0 +1,358 @@
+// test_box64_code_cache.c - JIT本机代码缓存的分配、反查、淘汰和清空校验
+// 纯C，Linux上直接编译运行:
+//   ./run_portable_tests.sh test_box64_code_cache
+// 检查区域内的对齐和顺序分配、整页钉住块不与其他块共用页面、本机地址到客户机RIP的反查、释放后区域整体复用、
+// 分代模式下只淘汰最旧且没有钉住块的区域、整体模式下清空全部可淘汰块，
+// 再按引擎的用法把缓存接到翻译缓存上（块失效时释放本机代码，区域淘汰时清掉块的本机代码指针）；
+// 末尾比较顺序分配与每块一次 mmap/munmap 的开销
+#include "Box64CodeCache.h"
+#include "Box64TranslationCache.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#define REGION_SIZE     (64 * 1024)
+#define MAX_REGIONS     4
+#define BLOCK_SIZE      1000                // 对齐后占 1008 字节
+#define BLOCKS_PER_REGION (REGION_SIZE / 1008)
+#define BENCH_ROUNDS    20000
+
+static int failures = 0;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { printf("[CodeCacheTest] ❌ " __VA_ARGS__); printf("\n"); failures++; } \
+} while (0)
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// 淘汰回调记录被淘汰块的RIP
+#define MAX_RECORDED 1024
+static uint64_t evicted_rips[MAX_RECORDED];
+static uint32_t evicted_count;
+
+static void record_evict(void *user, void *code, uint64_t guest_rip) {
+    (void)code;
+    (void)user;
+    if (evicted_count < MAX_RECORDED) {
+        evicted_rips[evicted_count] = guest_rip;
+    }
+    evicted_count++;
+}
+
+static bool was_evicted(uint64_t guest_rip) {
+    for (uint32_t i = 0; i < evicted_count && i < MAX_RECORDED; i++) {
+        if (evicted_rips[i] == guest_rip) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// MARK: - 分配与反查
+
+static void test_alloc_lookup(void) {
+    Box64CodeCache *cache = box64_code_cache_create(REGION_SIZE, MAX_REGIONS, BOX64_CODE_FLUSH_GENERATIONAL, 0);
+    CHECK(cache != NULL, "create failed");
+    if (!cache) {
+        return;
+    }
+
+    static const size_t sizes[] = { 4, 20, 64, 100, 4096, 12 };
+    uint8_t *blocks[6];
+    for (int i = 0; i < 6; i++) {
+        blocks[i] = box64_code_cache_alloc(cache, sizes[i], 0x401000 + i * 0x10, record_evict, NULL);
+        CHECK(blocks[i] != NULL, "alloc %zu failed", sizes[i]);
+        CHECK(((uintptr_t)blocks[i] & (BOX64_CODE_CACHE_ALIGN - 1)) == 0, "block %d not 16-byte aligned", i);
+        memset(blocks[i], 0xC0 + i, sizes[i]);   // 区域是可写的，写满整个块
+    }
+    for (int i = 1; i < 6; i++) {
+        CHECK(blocks[i] >= blocks[i - 1] + sizes[i - 1], "block %d overlaps previous", i);
+    }
+    for (int i = 0; i < 6; i++) {
+        CHECK(blocks[i][sizes[i] - 1] == 0xC0 + i, "block %d clobbered by a neighbour", i);
+    }
+    CHECK(box64_code_cache_region_count(cache) == 1, "small blocks should share one region");
+
+    Box64CodeBlockInfo info;
+    CHECK(box64_code_cache_find(cache, blocks[3] + 57, &info), "interior address not found");
+    CHECK(info.start == blocks[3] && info.size == 100 && info.guest_rip == 0x401030 && !info.pinned,
+          "wrong reverse map: start %p size %zu rip 0x%llx", info.start, info.size, (unsigned long long)info.guest_rip);
+    CHECK(box64_code_cache_find(cache, blocks[0], &info) && info.guest_rip == 0x401000, "first block lookup");
+    CHECK(box64_code_cache_find(cache, blocks[5] + 11, &info) && info.guest_rip == 0x401050, "last block lookup");
+    CHECK(!box64_code_cache_find(cache, blocks[0] + 4, NULL), "alignment padding must not resolve");
+    CHECK(!box64_code_cache_find(cache, blocks[5] + 16, NULL), "address past cursor must not resolve");
+    CHECK(!box64_code_cache_find(cache, &info, NULL), "foreign address must not resolve");
+
+    CHECK(box64_code_cache_free(cache, blocks[3]), "free failed");
+    CHECK(!box64_code_cache_free(cache, blocks[3]), "double free accepted");
+    CHECK(!box64_code_cache_free(cache, blocks[4] + 16), "interior free accepted");
+    CHECK(!box64_code_cache_find(cache, blocks[3] + 57, NULL), "freed block still resolves");
+
+    Box64CodeCacheStats stats;
+    box64_code_cache_get_stats(cache, &stats);
+    CHECK(stats.live_blocks == 5 && stats.freed_bytes == 100, "stats after free: %u live, %zu freed",
+          stats.live_blocks, stats.freed_bytes);
+    CHECK(stats.live_bytes == 4 + 20 + 64 + 4096 + 12, "live bytes %zu", stats.live_bytes);
+    CHECK(stats.reserved_bytes == REGION_SIZE && stats.region_maps == 1, "one region should be mapped");
+
+    CHECK(box64_code_cache_alloc(cache, REGION_SIZE + 1, 0, NULL, NULL) == NULL, "oversized block accepted");
+    CHECK(box64_code_cache_alloc(cache, 0, 0, NULL, NULL) == NULL, "empty block accepted");
+    box64_code_cache_get_stats(cache, &stats);
+    CHECK(stats.failures == 2, "failures %llu", (unsigned long long)stats.failures);
+
+    // 区域里的块全部释放后游标归零，下一块从区域起点开始
+    for (int i = 0; i < 6; i++) {
+        if (i != 3) {
+            CHECK(box64_code_cache_free(cache, blocks[i]), "free %d failed", i);
+        }
+    }
+    uint8_t *again = box64_code_cache_alloc(cache, 32, 0x402000, record_evict, NULL);
+    CHECK(again == blocks[0], "emptied region not reused from the start");
+    box64_code_cache_get_stats(cache, &stats);
+    CHECK(stats.freed_bytes == 0 && stats.used_bytes == 32 && stats.region_resets == 1,
+          "reset stats: freed %zu used %zu resets %llu", stats.freed_bytes, stats.used_bytes,
+          (unsigned long long)stats.region_resets);
+
+    box64_code_cache_destroy(cache);
+}
+
+// 整页对齐的钉住块（IOSJITEngine 的 allocateJITMemory 用法）不与其他块共用页面，切换权限只影响自己
+static void test_page_aligned(void) {
+    const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    Box64CodeCache *cache = box64_code_cache_create(REGION_SIZE, MAX_REGIONS, BOX64_CODE_FLUSH_GENERATIONAL, 0);
+    uint8_t *before = box64_code_cache_alloc(cache, 40, 0x1000, record_evict, NULL);
+    uint8_t *pinned = box64_code_cache_alloc_aligned(cache, page, page, 0, NULL, NULL);
+    uint8_t *after = box64_code_cache_alloc(cache, 40, 0x2000, record_evict, NULL);
+    CHECK(before && pinned && after, "aligned allocation failed");
+    CHECK(((uintptr_t)pinned & (page - 1)) == 0, "pinned block %p not page aligned", (void *)pinned);
+    CHECK(before + 40 <= pinned && after >= pinned + page, "pinned page shared with a neighbour");
+    Box64CodeBlockInfo info;
+    CHECK(!box64_code_cache_find(cache, before + 48, NULL), "alignment gap must not resolve");
+    CHECK(box64_code_cache_find(cache, pinned + page - 1, &info) && info.pinned && info.size == page,
+          "pinned page lookup");
+    CHECK(box64_code_cache_alloc_aligned(cache, 16, 24, 0, NULL, NULL) == NULL, "non power-of-two alignment accepted");
+    CHECK(box64_code_cache_alloc_aligned(cache, 16, page * 2, 0, NULL, NULL) == NULL, "alignment above a page accepted");
+    box64_code_cache_destroy(cache);
+
+#ifndef MAP_JIT
+    CHECK(box64_code_cache_create(0, 0, BOX64_CODE_FLUSH_GENERATIONAL, BOX64_CODE_CACHE_MAP_JIT) == NULL,
+          "MAP_JIT requested on a host without it");
+#endif
+}
+
+// MARK: - 淘汰
+
+// 填满 regions 个区域，块的 RIP 为 区域序号 << 16 | 块序号
+static void fill_regions(Box64CodeCache *cache, uint32_t regions, uint8_t **first_blocks) {
+    for (uint32_t r = 0; r < regions; r++) {
+        for (uint32_t b = 0; b < BLOCKS_PER_REGION; b++) {
+            void *block = box64_code_cache_alloc(cache, BLOCK_SIZE, ((uint64_t)r << 16) | b, record_evict, NULL);
+            CHECK(block != NULL, "fill region %u block %u failed", r, b);
+            if (b == 0 && first_blocks) {
+                first_blocks[r] = block;
+            }
+        }
+    }
+}
+
+static void test_generational(void) {
+    Box64CodeCache *cache = box64_code_cache_create(REGION_SIZE, MAX_REGIONS, BOX64_CODE_FLUSH_GENERATIONAL, 0);
+    uint8_t *first[MAX_REGIONS] = { 0 };
+    evicted_count = 0;
+    fill_regions(cache, MAX_REGIONS, first);
+    CHECK(evicted_count == 0, "eviction before the cache was full");
+    CHECK(box64_code_cache_region_count(cache) == MAX_REGIONS, "expected %d regions", MAX_REGIONS);
+
+    // 满了：淘汰最旧的区域0，新块放在它的起点
+    void *block = box64_code_cache_alloc(cache, BLOCK_SIZE, 0xAAAA0000, record_evict, NULL);
+    CHECK(block == first[0], "oldest region not reused");
+    CHECK(evicted_count == BLOCKS_PER_REGION, "evicted %u blocks, expected %d", evicted_count, BLOCKS_PER_REGION);
+    CHECK(was_evicted(0) && was_evicted(BLOCKS_PER_REGION - 1) && !was_evicted(1u << 16),
+          "wrong blocks evicted");
+    Box64CodeBlockInfo info;
+    CHECK(box64_code_cache_find(cache, block, &info) && info.guest_rip == 0xAAAA0000, "new block lookup");
+    CHECK(box64_code_cache_find(cache, first[1], &info) && info.guest_rip == 1u << 16, "region 1 must survive");
+
+    // 释放区域1的一块，在当前区域0里放一个钉住块并填满，下一次淘汰跳过区域0，淘汰区域1
+    box64_code_cache_free(cache, first[1]);
+    Box64CodeCacheStats stats;
+    box64_code_cache_get_stats(cache, &stats);
+    CHECK(stats.live_blocks == MAX_REGIONS * BLOCKS_PER_REGION - BLOCKS_PER_REGION + 1 - 1, "live blocks %u",
+          stats.live_blocks);
+    void *pinned = box64_code_cache_alloc(cache, 16, 0, NULL, NULL);   // 落在当前区域0
+    CHECK(pinned != NULL, "pinned alloc failed");
+    for (uint32_t b = 1; b < BLOCKS_PER_REGION; b++) {
+        box64_code_cache_alloc(cache, BLOCK_SIZE, 0xBBBB0000 + b, record_evict, NULL);
+    }
+    // 区域0（最新，含钉住块）已满，区域1最旧
+    evicted_count = 0;
+    block = box64_code_cache_alloc(cache, BLOCK_SIZE, 0xCCCC0000, record_evict, NULL);
+    CHECK(block == first[1], "region 1 should be evicted next");
+    CHECK(evicted_count == BLOCKS_PER_REGION - 1, "evicted %u blocks from region 1", evicted_count);
+    CHECK(box64_code_cache_find(cache, pinned, &info) && info.pinned, "pinned block lost");
+
+    box64_code_cache_get_stats(cache, &stats);
+    CHECK(stats.evicted_regions == 2 && stats.region_maps == MAX_REGIONS, "evicted %llu regions, %llu mmaps",
+          (unsigned long long)stats.evicted_regions, (unsigned long long)stats.region_maps);
+    CHECK(stats.generation == MAX_REGIONS + 2, "generation %llu", (unsigned long long)stats.generation);
+    box64_code_cache_destroy(cache);
+}
+
+static void test_flush_all(void) {
+    Box64CodeCache *cache = box64_code_cache_create(REGION_SIZE, 2, BOX64_CODE_FLUSH_ALL, 0);
+    void *pinned = box64_code_cache_alloc(cache, 64, 0x1234, NULL, NULL);
+    evicted_count = 0;
+    for (uint32_t b = 0; b < 2 * BLOCKS_PER_REGION - 1; b++) {
+        CHECK(box64_code_cache_alloc(cache, BLOCK_SIZE, b, record_evict, NULL) != NULL, "fill block %u", b);
+    }
+    CHECK(evicted_count == 0, "eviction before the cache was full");
+
+    // 满了：清空全部可淘汰块，钉住块所在的区域保持游标，另一个区域整体复用
+    void *block = box64_code_cache_alloc(cache, BLOCK_SIZE, 0xF00D, record_evict, NULL);
+    CHECK(block != NULL, "alloc after flush failed");
+    CHECK(evicted_count == 2 * BLOCKS_PER_REGION - 1, "flush evicted %u blocks", evicted_count);
+    Box64CodeBlockInfo info;
+    CHECK(box64_code_cache_find(cache, pinned, &info) && info.guest_rip == 0x1234, "pinned block lost in flush");
+
+    Box64CodeCacheStats stats;
+    box64_code_cache_get_stats(cache, &stats);
+    CHECK(stats.flushes == 1 && stats.live_blocks == 2, "flushes %llu live %u",
+          (unsigned long long)stats.flushes, stats.live_blocks);
+    CHECK(stats.freed_bytes > 0, "pinned region should report fragmentation");
+
+    // 显式清空，再释放钉住块后两个区域都空了
+    evicted_count = 0;
+    CHECK(box64_code_cache_flush(cache) == 1 && evicted_count == 1, "explicit flush");
+    CHECK(box64_code_cache_free(cache, pinned), "free pinned block");
+    box64_code_cache_get_stats(cache, &stats);
+    CHECK(stats.used_bytes == 0 && stats.live_blocks == 0 && stats.freed_bytes == 0, "cache should be empty");
+
+    // 全部钉住时放不下就失败，不淘汰
+    box64_code_cache_destroy(cache);
+    cache = box64_code_cache_create(REGION_SIZE, 1, BOX64_CODE_FLUSH_GENERATIONAL, 0);
+    CHECK(box64_code_cache_alloc(cache, REGION_SIZE, 0, NULL, NULL) != NULL, "full-region pinned block");
+    CHECK(box64_code_cache_alloc(cache, 16, 0, record_evict, NULL) == NULL, "pinned cache should refuse");
+    box64_code_cache_destroy(cache);
+}
+
+// MARK: - 接到翻译缓存
+
+// 与 Box64Engine 相同的接法
+static void release_native(Box64Block *block, void *userdata) {
+    if (block->native_code) {
+        box64_code_cache_free((Box64CodeCache *)userdata, block->native_code);
+    }
+}
+
+static void evict_native(void *user, void *code, uint64_t guest_rip) {
+    Box64Block *block = (Box64Block *)user;
+    if (block->native_code == code && block->guest_start == guest_rip) {
+        block->native_code = NULL;
+        block->native_insn_count = 0;
+        atomic_store_explicit(&block->exec_count, 0, memory_order_relaxed);
+    }
+}
+
+static void test_translation_cache(void) {
+    // 每块一条 ret，所以块首地址就是块
+    uint8_t code[64];
+    memset(code, 0xC3, sizeof(code));
+    const uint32_t block_count = 16;
+    Box64CodeCache *cache = box64_code_cache_create(REGION_SIZE, 1, BOX64_CODE_FLUSH_GENERATIONAL, 0);
+    Box64TranslationCache *tc = box64_tc_create(64);
+    box64_tc_set_release_callback(tc, release_native, cache);
+
+    for (uint32_t i = 0; i < block_count; i++) {
+        X86DecodeStatus status;
+        Box64Block *block = box64_tc_translate(tc, 0x1000 + i, code + i, sizeof(code) - i, &status);
+        CHECK(block != NULL, "translate %u failed", i);
+        if (block) {
+            block->native_code = box64_code_cache_alloc(cache, REGION_SIZE / 32, block->guest_start, evict_native, block);
+            CHECK(block->native_code != NULL, "native alloc %u failed", i);
+        }
+    }
+
+    // SMC失效：前4块的本机代码被释放
+    CHECK(box64_tc_invalidate_range(tc, 0x1000, 4) == 4, "invalidate range");
+    Box64CodeCacheStats stats;
+    box64_code_cache_get_stats(cache, &stats);
+    CHECK(stats.live_blocks == block_count - 4 && stats.frees == 4, "after invalidate: %u live, %llu frees",
+          stats.live_blocks, (unsigned long long)stats.frees);
+
+    // 继续分配直到唯一的区域被淘汰：存活块的本机代码指针被清掉，块本身还在
+    evicted_count = 0;
+    for (uint32_t i = 0; i < 32 && stats.evicted_regions == 0; i++) {
+        box64_code_cache_alloc(cache, REGION_SIZE / 32, 0x9000 + i, record_evict, NULL);
+        box64_code_cache_get_stats(cache, &stats);
+    }
+    CHECK(stats.evicted_regions == 1, "region was never evicted");
+    CHECK(stats.evicted_blocks == block_count - 4 + evicted_count, "evicted %llu blocks",
+          (unsigned long long)stats.evicted_blocks);
+    for (uint32_t i = 4; i < block_count; i++) {
+        Box64Block *survivor = box64_tc_lookup(tc, 0x1000 + i);
+        CHECK(survivor && survivor->native_code == NULL && survivor->exec_count == 0,
+              "block %u still has native code after eviction", i);
+    }
+
+    // 翻译缓存销毁时本机代码已经不在了，不能重复释放
+    const uint64_t frees = stats.frees;
+    box64_tc_destroy(tc);
+    box64_code_cache_get_stats(cache, &stats);
+    CHECK(stats.frees == frees, "destroy freed evicted code again");
+    box64_code_cache_destroy(cache);
+}
+
+// MARK: - 性能
+
+static void bench(void) {
+    static void *blocks[256];
+    Box64CodeCache *cache = box64_code_cache_create(0, 0, BOX64_CODE_FLUSH_GENERATIONAL, 0);
+    double start = now_seconds();
+    for (uint32_t round = 0; round < BENCH_ROUNDS; round++) {
+        void **slot = &blocks[round & 255];
+        if (*slot) {
+            box64_code_cache_free(cache, *slot);
+        }
+        *slot = box64_code_cache_alloc(cache, 64 + (round & 63) * 4, round, record_evict, NULL);
+    }
+    const double ours = (now_seconds() - start) * 1e9 / BENCH_ROUNDS;
+    Box64CodeCacheStats stats;
+    box64_code_cache_get_stats(cache, &stats);
+    box64_code_cache_destroy(cache);
+
+    start = now_seconds();
+    for (uint32_t round = 0; round < BENCH_ROUNDS; round++) {
+        void *memory = mmap(NULL, 16 * 1024, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        ((volatile uint8_t *)memory)[0] = 0xC3;
+        munmap(memory, 16 * 1024);
+    }
+    const double theirs = (now_seconds() - start) * 1e9 / BENCH_ROUNDS;
+
+    printf("[CodeCacheTest] 分配+释放：区域内顺序分配 %.1f ns  每块 mmap/munmap %.1f ns\n", ours, theirs);
+    printf("[CodeCacheTest] %u 个区域，%llu 次 mmap，%llu 次区域淘汰，碎片率 %.1f%%\n", stats.regions,
+           (unsigned long long)stats.region_maps, (unsigned long long)stats.evicted_regions,
+           stats.used_bytes ? 100.0 * stats.freed_bytes / stats.used_bytes : 0.0);
+}
+
+int main(void) {
+    test_alloc_lookup();
+    test_page_aligned();
+    test_generational();
+    test_flush_all();
+    test_translation_cache();
+    bench();
+
+    if (failures) {
+        printf("[CodeCacheTest] ❌ %d checks failed\n", failures);
+        return 1;
+    }
+    printf("[CodeCacheTest] ✅ all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,190 @@
+// test_box64_heap.c - Box64Heap 大小类 / 页段合并 / 重复释放 / 统计测试
+#include "Box64Heap.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HEAP_BASE   0x10000ULL
+#define HEAP_PAGES  1024
+#define HEAP_SIZE   ((uint64_t)HEAP_PAGES * BOX64_HEAP_PAGE_SIZE)
+#define STRESS_OPS  200000
+#define STRESS_LIVE 512
+
+static int failures = 0;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { printf("[HeapTest] ❌ " __VA_ARGS__); printf("\n"); failures++; } \
+} while (0)
+
+static uint64_t rng_state = 0x2545F4914F6CDD1DULL;
+
+static uint64_t next_random(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+// 小块按大小类复用，地址对齐，重复释放和野指针被拒绝
+static void check_small(Box64Heap *heap) {
+    uint64_t a = box64_heap_alloc(heap, 24);
+    uint64_t b = box64_heap_alloc(heap, 24);
+    CHECK(a && b && a != b, "small alloc failed");
+    CHECK(a % BOX64_HEAP_ALIGNMENT == 0 && b % BOX64_HEAP_ALIGNMENT == 0, "misaligned small block");
+    CHECK(box64_heap_block_size(heap, a) == 32, "24 bytes -> class %llu", (unsigned long long)box64_heap_block_size(heap, a));
+    CHECK(box64_heap_block_size(heap, box64_heap_alloc(heap, 0)) == 16, "zero-size alloc not rounded to 16");
+
+    CHECK(box64_heap_free(heap, a), "free failed");
+    CHECK(!box64_heap_free(heap, a), "double free accepted");
+    CHECK(!box64_heap_free(heap, b + 8), "interior pointer accepted");
+    CHECK(!box64_heap_free(heap, HEAP_BASE - 16), "pointer below heap accepted");
+    CHECK(box64_heap_block_size(heap, a) == 0, "freed block still has a size");
+    CHECK(box64_heap_alloc(heap, 30) == a, "freed slot not reused");
+
+    box64_heap_reset(heap);
+}
+
+// 大块按页对齐；任意释放顺序后相邻空闲段完全合并
+static void check_large(Box64Heap *heap) {
+    Box64HeapStats stats;
+    uint64_t blocks[6];
+    for (int i = 0; i < 6; i++) {
+        blocks[i] = box64_heap_alloc(heap, 3 * BOX64_HEAP_PAGE_SIZE - 100);
+        CHECK(blocks[i] && blocks[i] % BOX64_HEAP_PAGE_SIZE == 0, "large block %d misaligned", i);
+        CHECK(box64_heap_block_size(heap, blocks[i]) == 3 * BOX64_HEAP_PAGE_SIZE, "large block %d size", i);
+    }
+    CHECK(!box64_heap_free(heap, blocks[0] + BOX64_HEAP_PAGE_SIZE), "tail page of a large block accepted");
+
+    // 释放 1、3 后中间夹着已分配块，只有两个3页空洞
+    box64_heap_free(heap, blocks[1]);
+    box64_heap_free(heap, blocks[3]);
+    box64_heap_get_stats(heap, &stats);
+    CHECK(stats.largest_free_run == HEAP_PAGES - 18, "largest run %u", stats.largest_free_run);
+    uint64_t hole = box64_heap_alloc(heap, 3 * BOX64_HEAP_PAGE_SIZE);
+    CHECK(hole == blocks[1] || hole == blocks[3], "3-page hole not reused exactly");
+    CHECK(box64_heap_free(heap, hole), "free failed");
+
+    // 再释放 2：1-3 合并为9页
+    box64_heap_free(heap, blocks[2]);
+    CHECK(box64_heap_alloc(heap, 9 * BOX64_HEAP_PAGE_SIZE) == blocks[1], "freed neighbours not coalesced");
+    box64_heap_free(heap, blocks[1]);
+
+    box64_heap_free(heap, blocks[5]);
+    box64_heap_free(heap, blocks[0]);
+    box64_heap_free(heap, blocks[4]);
+    box64_heap_get_stats(heap, &stats);
+    CHECK(stats.free_pages == HEAP_PAGES && stats.largest_free_run == HEAP_PAGES,
+          "heap not whole again: free %u largest %u", stats.free_pages, stats.largest_free_run);
+    CHECK(stats.external_fragmentation == 0.0, "fragmentation %.3f after full free", stats.external_fragmentation);
+    CHECK(stats.peak_bytes_in_use == 18 * BOX64_HEAP_PAGE_SIZE, "peak %llu", (unsigned long long)stats.peak_bytes_in_use);
+
+    CHECK(box64_heap_alloc(heap, HEAP_SIZE + 1) == 0, "oversized alloc succeeded");
+    CHECK(box64_heap_alloc(heap, HEAP_SIZE) == HEAP_BASE, "whole-heap alloc failed");
+    CHECK(box64_heap_alloc(heap, 16) == 0, "alloc from a full heap succeeded");
+    box64_heap_get_stats(heap, &stats);
+    CHECK(stats.failed_allocations == 2, "failed allocations %llu", (unsigned long long)stats.failed_allocations);
+
+    box64_heap_reset(heap);
+}
+
+// 与左侧空闲段合并后，被释放块的首页不能仍被当作大块：重复释放必须被拒绝，之后的分配互不重叠
+static void check_merged_double_free(Box64Heap *heap) {
+    const uint64_t size = 2 * BOX64_HEAP_PAGE_SIZE;
+    uint64_t a = box64_heap_alloc(heap, size);
+    uint64_t b = box64_heap_alloc(heap, size);
+    uint64_t guard = box64_heap_alloc(heap, size);
+    CHECK(a && b == a + size && guard == b + size, "blocks not laid out back to back");
+
+    CHECK(box64_heap_free(heap, a), "free of left block failed");
+    CHECK(box64_heap_free(heap, b), "free of merged block failed");
+    CHECK(!box64_heap_free(heap, b), "double free of a left-merged block accepted");
+    CHECK(box64_heap_block_size(heap, b) == 0, "left-merged block still has a size");
+
+    Box64HeapStats stats;
+    box64_heap_get_stats(heap, &stats);
+    CHECK(stats.free_pages == HEAP_PAGES - 2, "free pages %u after double free", stats.free_pages);
+
+    uint64_t x = box64_heap_alloc(heap, size);
+    uint64_t y = box64_heap_alloc(heap, size);
+    CHECK(x && y && (x + size <= y || y + size <= x), "allocations alias: 0x%llx 0x%llx",
+          (unsigned long long)x, (unsigned long long)y);
+
+    box64_heap_reset(heap);
+}
+
+// 随机混合分配释放：块互不重叠，全部释放后恢复为单一空闲段
+static void check_stress(Box64Heap *heap) {
+    static uint8_t owner[HEAP_PAGES * BOX64_HEAP_PAGE_SIZE / BOX64_HEAP_ALIGNMENT];
+    uint64_t live[STRESS_LIVE] = { 0 };
+    memset(owner, 0, sizeof(owner));
+
+    for (int op = 0; op < STRESS_OPS && failures < 10; op++) {
+        const uint32_t index = (uint32_t)(next_random() % STRESS_LIVE);
+        if (live[index]) {
+            const uint64_t size = box64_heap_block_size(heap, live[index]);
+            const uint64_t first = (live[index] - HEAP_BASE) / BOX64_HEAP_ALIGNMENT;
+            memset(&owner[first], 0, (size_t)(size / BOX64_HEAP_ALIGNMENT));
+            CHECK(size && box64_heap_free(heap, live[index]), "op %d: free of live block failed", op);
+            live[index] = 0;
+            continue;
+        }
+
+        const uint64_t r = next_random();
+        const uint64_t size = (r & 7) == 0 ? 1 + r % (24 * BOX64_HEAP_PAGE_SIZE) : 1 + (r >> 8) % BOX64_HEAP_SMALL_MAX;
+        const uint64_t address = box64_heap_alloc(heap, size);
+        if (!address) {
+            continue;
+        }
+        const uint64_t block = box64_heap_block_size(heap, address);
+        CHECK(block >= size && address >= HEAP_BASE && address + block <= HEAP_BASE + HEAP_SIZE,
+              "op %d: block 0x%llx+%llu outside heap", op, (unsigned long long)address, (unsigned long long)block);
+        const uint64_t first = (address - HEAP_BASE) / BOX64_HEAP_ALIGNMENT;
+        for (uint64_t unit = 0; unit < block / BOX64_HEAP_ALIGNMENT; unit++) {
+            if (owner[first + unit]) {
+                CHECK(0, "op %d: block 0x%llx overlaps a live block", op, (unsigned long long)address);
+                break;
+            }
+            owner[first + unit] = 1;
+        }
+        live[index] = address;
+    }
+
+    Box64HeapStats stats;
+    box64_heap_get_stats(heap, &stats);
+    CHECK(stats.internal_fragmentation >= 0.0 && stats.internal_fragmentation < 1.0, "internal fragmentation %.3f",
+          stats.internal_fragmentation);
+    for (uint32_t i = 0; i < STRESS_LIVE; i++) {
+        if (live[i]) {
+            CHECK(box64_heap_free(heap, live[i]), "final free failed");
+        }
+    }
+    box64_heap_get_stats(heap, &stats);
+    CHECK(stats.live_blocks == 0 && stats.bytes_in_use == 0, "leaked %u blocks", stats.live_blocks);
+    // 每个大小类最多缓存一个空slab
+    CHECK(stats.free_pages + stats.slab_pages == HEAP_PAGES && stats.large_pages == 0, "pages lost: free %u slab %u",
+          stats.free_pages, stats.slab_pages);
+    printf("[HeapTest] stress: %llu allocs, peak %llu KB, %u cached slabs\n", (unsigned long long)stats.allocations,
+           (unsigned long long)(stats.peak_bytes_in_use / 1024), stats.slab_pages);
+}
+
+int main(void) {
+    CHECK(box64_heap_create(HEAP_BASE + 8, HEAP_SIZE) == NULL, "unaligned base accepted");
+    Box64Heap *heap = box64_heap_create(HEAP_BASE, HEAP_SIZE + 100);
+    if (!heap) {
+        printf("[HeapTest] 堆创建失败\n");
+        return 1;
+    }
+
+    check_small(heap);
+    check_large(heap);
+    check_merged_double_free(heap);
+    check_stress(heap);
+    box64_heap_destroy(heap);
+
+    if (failures) {
+        printf("[HeapTest] %d failure(s)\n", failures);
+        return 1;
+    }
+    printf("[HeapTest] ✅ all checks passed\n");
+    return 0;
+}
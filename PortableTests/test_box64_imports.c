@@ -0,0 +1,497 @@
+// test_box64_imports.c - 导入表绑定与宿主桩分派测试
+// 构造带 kernel32 / user32 导入的PE32+镜像，经 Box64PELoader 映射后绑定导入：
+// 检查注册表查找、IAT改写、惰性解析、Win64参数转换和各种错误路径，最后测量每次调用的分派开销
+#include "Box64Imports.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#define GUEST_MEMORY_SIZE   (8u * 1024 * 1024)
+#define IMAGE_BASE          0x400000ULL
+#define STACK_BASE          0x100000ULL
+#define STACK_SIZE          0x10000ULL
+#define STUB_BASE           0x200000ULL
+#define FILE_SIZE           0x800
+#define IDATA_RVA           0x2000
+#define DISPATCH_ITERATIONS 10000000
+#define CONCURRENT_THREADS  4
+#define CONCURRENT_ROUNDS   20000
+
+static int failures = 0;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { printf("[ImportsTest] ❌ " __VA_ARGS__); printf("\n"); failures++; } \
+} while (0)
+
+// MARK: - 镜像构造
+
+static void put16(uint8_t *p, uint16_t v) { p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); }
+static void put32(uint8_t *p, uint32_t v) { put16(p, (uint16_t)v); put16(p + 2, (uint16_t)(v >> 16)); }
+static void put64(uint8_t *p, uint64_t v) { put32(p, (uint32_t)v); put32(p + 4, (uint32_t)(v >> 32)); }
+
+// .idata 布局（RVA）：描述符 0x2000，ILT 0x2040/0x2060，IAT 0x2080/0x20A0，名称 0x2100 起
+#define KERNEL32_ILT    0x2040
+#define USER32_ILT      0x2060
+#define KERNEL32_IAT    0x2080
+#define USER32_IAT      0x20A0
+#define NAME_SUM6       0x2100
+#define NAME_EXIT       0x2120
+#define NAME_MESSAGEBOX 0x2140
+#define NAME_MISSING    0x2160
+#define DLL_KERNEL32    0x2180
+#define DLL_USER32      0x21A0
+
+static void put_name(uint8_t *idata, uint32_t rva, const char *name) {
+    memcpy(idata + (rva - IDATA_RVA) + 2, name, strlen(name) + 1);
+}
+
+// dll_name_rva 用于构造损坏的描述符
+static void build_pe(uint8_t *file, uint32_t dll_name_rva) {
+    memset(file, 0, FILE_SIZE);
+    file[0] = 'M';
+    file[1] = 'Z';
+    put32(file + 60, 64);
+    memcpy(file + 64, "PE\0\0", 4);
+
+    uint8_t *coff = file + 68;
+    put16(coff + 0, BOX64_PE_MACHINE_AMD64);
+    put16(coff + 2, 2);
+    put16(coff + 16, 240);
+    put16(coff + 18, 0x022);
+
+    uint8_t *optional = coff + 20;
+    put16(optional + 0, 0x020B);
+    put32(optional + 16, 0x1000);
+    put64(optional + 24, IMAGE_BASE);
+    put32(optional + 32, 0x1000);
+    put32(optional + 36, 0x200);
+    put32(optional + 56, 0x3000);
+    put32(optional + 60, 0x400);
+    put32(optional + 108, 16);
+    uint8_t *directories = optional + 112;
+    put32(directories + BOX64_PE_DIR_IMPORT * 8, IDATA_RVA);
+    put32(directories + BOX64_PE_DIR_IMPORT * 8 + 4, 60);
+
+    uint8_t *table = optional + 240;
+    memcpy(table, ".text", 5);
+    put32(table + 8, 0x10);
+    put32(table + 12, 0x1000);
+    put32(table + 16, 0x200);
+    put32(table + 20, 0x400);
+    put32(table + 36, 0x60000020);
+    memcpy(table + 40, ".idata", 6);
+    put32(table + 48, 0x200);
+    put32(table + 52, IDATA_RVA);
+    put32(table + 56, 0x200);
+    put32(table + 60, 0x600);
+    put32(table + 76, 0x40000040);      // 只读
+
+    file[0x400] = 0xC3;
+
+    uint8_t *idata = file + 0x600;
+    // kernel32: Sum6, ExitProcess, 序号5；user32: MessageBoxA, Missing
+    put32(idata + 0, KERNEL32_ILT);
+    put32(idata + 12, dll_name_rva);
+    put32(idata + 16, KERNEL32_IAT);
+    put32(idata + 20, USER32_ILT);
+    put32(idata + 32, DLL_USER32);
+    put32(idata + 36, USER32_IAT);
+
+    const uint64_t kernel32[] = { NAME_SUM6, NAME_EXIT, (1ULL << 63) | 5, 0 };
+    const uint64_t user32[] = { NAME_MESSAGEBOX, NAME_MISSING, 0 };
+    for (int i = 0; i < 4; i++) {
+        put64(idata + (KERNEL32_ILT - IDATA_RVA) + i * 8, kernel32[i]);
+        put64(idata + (KERNEL32_IAT - IDATA_RVA) + i * 8, kernel32[i]);
+    }
+    for (int i = 0; i < 3; i++) {
+        put64(idata + (USER32_ILT - IDATA_RVA) + i * 8, user32[i]);
+        put64(idata + (USER32_IAT - IDATA_RVA) + i * 8, user32[i]);
+    }
+    put_name(idata, NAME_SUM6, "Sum6");
+    put_name(idata, NAME_EXIT, "ExitProcess");
+    put_name(idata, NAME_MESSAGEBOX, "MessageBoxA");
+    put_name(idata, NAME_MISSING, "Missing");
+    memcpy(idata + (DLL_KERNEL32 - IDATA_RVA), "KERNEL32.dll", 13);
+    memcpy(idata + (DLL_USER32 - IDATA_RVA), "user32", 7);
+}
+
+// MARK: - 宿主桩
+
+static uint64_t last_args[BOX64_THUNK_MAX_ARGS];
+
+static uint64_t thunk_sum6(Box64ThunkCall *call) {
+    memcpy(last_args, call->args, sizeof(last_args));
+    uint64_t sum = 0;
+    for (int i = 0; i < 6; i++) {
+        sum += call->args[i];
+    }
+    return sum;
+}
+
+static uint64_t thunk_exit(Box64ThunkCall *call) {
+    call->exit_requested = true;
+    return call->args[0];
+}
+
+static uint64_t thunk_ordinal(Box64ThunkCall *call) {
+    (void)call;
+    return 0x505;
+}
+
+// 读取 LPCSTR 参数
+static uint64_t thunk_message_box(Box64ThunkCall *call) {
+    char text[32];
+    if (!box64_thunk_read_string(&call->ctx->mmu, call->args[1], text, sizeof(text))) {
+        return 0;
+    }
+    return strcmp(text, "hello") == 0 ? 1 : 2;
+}
+
+static uint64_t thunk_noop(Box64ThunkCall *call) {
+    (void)call;
+    return 0;
+}
+
+static _Atomic uint64_t concurrent_calls;
+
+static uint64_t thunk_count(Box64ThunkCall *call) {
+    atomic_fetch_add(&concurrent_calls, 1);
+    return call->args[0];
+}
+
+// MARK: - 辅助
+
+typedef struct Guest {
+    uint8_t *backing;
+    Box64Context ctx;
+    Box64PEImage image;
+    Box64ImportTable table;
+} Guest;
+
+static bool setup_guest(Guest *guest, const Box64ThunkRegistry *registry, uint32_t dll_name_rva,
+                        Box64ImportStatus *scan_status) {
+    static uint8_t file[FILE_SIZE];
+    memset(guest->backing, 0, GUEST_MEMORY_SIZE);
+    memset(&guest->ctx, 0, offsetof(Box64Context, mmu));
+    box64_mmu_init(&guest->ctx.mmu, guest->backing, GUEST_MEMORY_SIZE);
+    box64_mmu_map(&guest->ctx.mmu, STACK_BASE, STACK_SIZE, BOX64_PROT_READ | BOX64_PROT_WRITE);
+
+    build_pe(file, dll_name_rva);
+    if (box64_pe_parse(file, sizeof(file), &guest->image) != BOX64_PE_OK ||
+        box64_pe_map(&guest->ctx.mmu, file, sizeof(file), &guest->image, 0) != BOX64_PE_OK) {
+        return false;
+    }
+    box64_imports_init(&guest->table, registry);
+    *scan_status = box64_imports_scan(&guest->table, &guest->ctx.mmu, &guest->image);
+    return true;
+}
+
+static void teardown_guest(Guest *guest) {
+    box64_imports_destroy(&guest->table);
+    box64_mmu_destroy(&guest->ctx.mmu);
+}
+
+static uint64_t load(Guest *guest, uint64_t address, uint8_t size) {
+    uint64_t value = 0;
+    box64_mmu_load(&guest->ctx.mmu, address, size, &value);
+    return value;
+}
+
+static uint64_t iat_entry(Guest *guest, uint32_t rva, int index) {
+    return load(guest, IMAGE_BASE + rva + (uint64_t)index * 8, 8);
+}
+
+// 模拟客户机 CALL [IAT]：压入返回地址，RIP 取自IAT项
+static uint64_t guest_call(Guest *guest, uint32_t iat_rva, int index, uint64_t return_address) {
+    guest->ctx.x86_regs[4] -= 8;
+    box64_mmu_store(&guest->ctx.mmu, guest->ctx.x86_regs[4], 8, return_address);
+    return iat_entry(guest, iat_rva, index);
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// MARK: - 测试
+
+static void check_registry(void) {
+    Box64ThunkRegistry *registry = box64_thunk_registry_create();
+    char symbol[32];
+    bool registered = true;
+    for (int i = 0; i < 2000; i++) {
+        snprintf(symbol, sizeof(symbol), "Function%d", i);
+        registered &= box64_thunk_register(registry, i & 1 ? "GDI32.DLL" : "gdi32", symbol, thunk_noop, (uint8_t)(i % 8), NULL);
+    }
+    CHECK(registered && box64_thunk_registry_count(registry) == 2000, "registry: %u thunks",
+          box64_thunk_registry_count(registry));
+
+    int found = 0;
+    for (int i = 0; i < 2000; i++) {
+        snprintf(symbol, sizeof(symbol), "Function%d", i);
+        const Box64Thunk *thunk = box64_thunk_lookup(registry, "Gdi32.dll", symbol);
+        found += thunk && thunk->arg_count == i % 8;
+    }
+    CHECK(found == 2000, "registry: found %d of 2000", found);
+    CHECK(box64_thunk_lookup(registry, "gdi32", "function1") == NULL, "registry: symbols are case sensitive");
+    CHECK(box64_thunk_lookup(registry, "gdi", "Function1") == NULL, "registry: dll prefix matched");
+    CHECK(box64_thunk_lookup(registry, "gdi32.dll", "Function20000") == NULL, "registry: missing symbol found");
+
+    const Box64Thunk *before = box64_thunk_lookup(registry, "gdi32", "Function7");
+    box64_thunk_register(registry, "GDI32", "Function7", thunk_sum6, 6, NULL);
+    const Box64Thunk *after = box64_thunk_lookup(registry, "gdi32", "Function7");
+    CHECK(after == before && after->fn == thunk_sum6 && after->arg_count == 6 &&
+          box64_thunk_registry_count(registry) == 2000, "registry: re-registration did not replace in place");
+
+    char long_name[BOX64_THUNK_NAME_MAX + 8];
+    memset(long_name, 'A', sizeof(long_name) - 1);
+    long_name[sizeof(long_name) - 1] = '\0';
+    CHECK(!box64_thunk_register(registry, "gdi32", long_name, thunk_noop, 0, NULL), "registry: overlong key accepted");
+    CHECK(!box64_thunk_register(registry, "gdi32", "TooMany", thunk_noop, BOX64_THUNK_MAX_ARGS + 1, NULL),
+          "registry: too many arguments accepted");
+    CHECK(!box64_thunk_register(registry, ".dll", "Empty", thunk_noop, 0, NULL), "registry: empty dll accepted");
+    box64_thunk_registry_destroy(registry);
+}
+
+static void check_bind_and_dispatch(Guest *guest) {
+    Box64ThunkRegistry *registry = box64_thunk_registry_create();
+    box64_thunk_register(registry, "kernel32.dll", "Sum6", thunk_sum6, 6, NULL);
+    box64_thunk_register(registry, "kernel32", "ExitProcess", thunk_exit, 1, NULL);
+    box64_thunk_register(registry, "kernel32", "#5", thunk_ordinal, 0, NULL);
+
+    Box64ImportStatus status;
+    if (!setup_guest(guest, registry, DLL_KERNEL32, &status)) {
+        CHECK(0, "cannot map import image");
+        return;
+    }
+    Box64ImportTable *table = &guest->table;
+    CHECK(status == BOX64_IMPORT_OK && table->count == 5 && table->dll_count == 2, "scan: %s, %u imports, %u dlls",
+          box64_import_status_string(status), table->count, table->dll_count);
+    CHECK(table->slots[2].name_rva == 0 && table->slots[2].ordinal == 5, "scan: ordinal import");
+    CHECK(table->slots[3].iat_address == IMAGE_BASE + USER32_IAT, "scan: IAT address 0x%llx",
+          (unsigned long long)table->slots[3].iat_address);
+    CHECK(iat_entry(guest, KERNEL32_IAT, 0) == NAME_SUM6, "scan modified the IAT");
+
+    box64_mmu_map(&guest->ctx.mmu, STUB_BASE, box64_imports_stub_size(table), BOX64_PROT_READ | BOX64_PROT_WRITE);
+    status = box64_imports_bind(table, &guest->ctx.mmu, STUB_BASE);
+    CHECK(status == BOX64_IMPORT_OK, "bind: %s", box64_import_status_string(status));
+    CHECK(box64_mmu_query(&guest->ctx.mmu, IMAGE_BASE + KERNEL32_IAT) == BOX64_PROT_READ, "bind changed IAT protection");
+    for (int i = 0; i < 3; i++) {
+        CHECK(iat_entry(guest, KERNEL32_IAT, i) == STUB_BASE + i * BOX64_THUNK_STUB_SIZE, "bind: kernel32 IAT[%d]", i);
+    }
+    CHECK(iat_entry(guest, KERNEL32_IAT, 3) == 0, "bind: IAT terminator overwritten");
+    CHECK(iat_entry(guest, USER32_IAT, 1) == STUB_BASE + 4 * BOX64_THUNK_STUB_SIZE, "bind: user32 IAT[1]");
+    CHECK(load(guest, STUB_BASE + 4 * BOX64_THUNK_STUB_SIZE, 4) == 0x343642CC &&
+          load(guest, STUB_BASE + 4 * BOX64_THUNK_STUB_SIZE + 4, 4) == 4, "bind: stub bytes");
+    CHECK(table->resolved == 0, "bind resolved %u imports eagerly", table->resolved);
+    CHECK(box64_imports_contains(table, STUB_BASE) && box64_imports_contains(table, STUB_BASE + 39) &&
+          !box64_imports_contains(table, STUB_BASE + 40) && !box64_imports_contains(table, STUB_BASE - 1),
+          "contains: stub range");
+
+    // Win64: RCX/RDX/R8/R9 + [RSP+0x28]/[RSP+0x30]
+    Box64Context *ctx = &guest->ctx;
+    ctx->x86_regs[4] = STACK_BASE + STACK_SIZE - 0x100;
+    box64_mmu_store(&ctx->mmu, ctx->x86_regs[4] - 8 + 0x28, 8, 50);
+    box64_mmu_store(&ctx->mmu, ctx->x86_regs[4] - 8 + 0x30, 8, 60);
+    ctx->x86_regs[1] = 10;
+    ctx->x86_regs[2] = 20;
+    ctx->x86_regs[8] = 30;
+    ctx->x86_regs[9] = 40;
+    const uint64_t rsp = ctx->x86_regs[4];
+    uint64_t rip = guest_call(guest, KERNEL32_IAT, 0, 0x401234);
+    const Box64ImportSlot *slot = NULL;
+    Box64ThunkStatus thunk_status = box64_imports_dispatch(table, ctx, rip, &slot);
+    CHECK(thunk_status == BOX64_THUNK_OK && ctx->x86_regs[0] == 210, "Sum6: status %d, RAX %llu", thunk_status,
+          (unsigned long long)ctx->x86_regs[0]);
+    CHECK(last_args[4] == 50 && last_args[5] == 60 && last_args[6] == 0, "Sum6: stack arguments");
+    CHECK(ctx->rip == 0x401234 && ctx->x86_regs[4] == rsp, "Sum6: return RIP 0x%llx RSP 0x%llx",
+          (unsigned long long)ctx->rip, (unsigned long long)ctx->x86_regs[4]);
+    CHECK(slot == &table->slots[0] && slot->calls == 1 && table->resolved == 1, "Sum6: lazy resolution");
+
+    rip = guest_call(guest, KERNEL32_IAT, 0, 0x401240);
+    box64_imports_dispatch(table, ctx, rip, NULL);
+    CHECK(table->slots[0].calls == 2 && table->resolved == 1, "Sum6: resolved twice");
+
+    rip = guest_call(guest, KERNEL32_IAT, 2, 0x401250);
+    CHECK(box64_imports_dispatch(table, ctx, rip, NULL) == BOX64_THUNK_OK && ctx->x86_regs[0] == 0x505, "ordinal import");
+
+    ctx->x86_regs[1] = 3;
+    rip = guest_call(guest, KERNEL32_IAT, 1, 0x401260);
+    CHECK(box64_imports_dispatch(table, ctx, rip, NULL) == BOX64_THUNK_EXIT && ctx->x86_regs[0] == 3, "ExitProcess");
+
+    // 未注册：状态不变，可以报告名称
+    rip = guest_call(guest, USER32_IAT, 0, 0x401270);
+    const uint64_t before_rsp = ctx->x86_regs[4];
+    thunk_status = box64_imports_dispatch(table, ctx, rip, &slot);
+    char name[64];
+    box64_imports_describe(table, &ctx->mmu, slot, name, sizeof(name));
+    CHECK(thunk_status == BOX64_THUNK_UNRESOLVED && ctx->x86_regs[4] == before_rsp && ctx->rip != 0x401270,
+          "unregistered: status %d", thunk_status);
+    CHECK(strcmp(name, "user32!MessageBoxA") == 0, "describe: %s", name);
+    table->slots[3].resolve_failed = false;
+
+    // 绑定之后注册同样生效
+    box64_thunk_register(registry, "USER32.DLL", "MessageBoxA", thunk_message_box, 4, NULL);
+    box64_mmu_copy_to_guest(&ctx->mmu, STACK_BASE + 0x100, "hello", 6);
+    ctx->x86_regs[2] = STACK_BASE + 0x100;
+    thunk_status = box64_imports_dispatch(table, ctx, rip, NULL);
+    CHECK(thunk_status == BOX64_THUNK_OK && ctx->x86_regs[0] == 1 && ctx->rip == 0x401270, "late registration: %d",
+          thunk_status);
+
+    // 栈不可读：不调用、不改状态
+    box64_thunk_register(registry, "user32", "Missing", thunk_sum6, 6, NULL);
+    ctx->x86_regs[4] = STACK_BASE + STACK_SIZE - 0x10;
+    ctx->rip = 0;
+    const uint64_t calls = table->slots[4].calls;
+    thunk_status = box64_imports_dispatch(table, ctx, iat_entry(guest, USER32_IAT, 1), NULL);
+    CHECK(thunk_status == BOX64_THUNK_FAULT && ctx->rip == 0 && table->slots[4].calls == calls,
+          "stack fault: status %d", thunk_status);
+    CHECK(box64_imports_dispatch(table, ctx, STUB_BASE + 3, NULL) == BOX64_THUNK_UNRESOLVED, "misaligned stub entry");
+
+    // 单次分派的开销（已解析）
+    ctx->x86_regs[4] = STACK_BASE + STACK_SIZE - 0x100;
+    box64_mmu_store(&ctx->mmu, ctx->x86_regs[4], 8, 0x401280);
+    const double start = now_seconds();
+    for (int i = 0; i < DISPATCH_ITERATIONS; i++) {
+        box64_imports_dispatch(table, ctx, STUB_BASE, NULL);
+        ctx->x86_regs[4] -= 8;
+    }
+    const double elapsed = now_seconds() - start;
+    CHECK(table->slots[0].calls == 2 + DISPATCH_ITERATIONS, "dispatch loop");
+    printf("[ImportsTest] 6-argument thunk dispatch: %.1f ns/call (%d calls)\n",
+           elapsed * 1e9 / DISPATCH_ITERATIONS, DISPATCH_ITERATIONS);
+
+    teardown_guest(guest);
+    box64_thunk_registry_destroy(registry);
+}
+
+typedef struct DispatchWorker {
+    Guest *guest;
+    uint64_t stack_top;
+    uint32_t mismatches;
+} DispatchWorker;
+
+// 每个线程自己的上下文（页表视图、寄存器）和栈，同时第一次调用同一个未解析的导入
+static void *dispatch_worker(void *argument) {
+    DispatchWorker *worker = argument;
+    Box64Context *ctx = calloc(1, sizeof(Box64Context));
+    if (!ctx || !box64_mmu_attach(&ctx->mmu, &worker->guest->ctx.mmu)) {
+        worker->mismatches = CONCURRENT_ROUNDS;
+        free(ctx);
+        return NULL;
+    }
+    for (uint32_t round = 0; round < CONCURRENT_ROUNDS; round++) {
+        ctx->x86_regs[4] = worker->stack_top;
+        ctx->x86_regs[1] = round;
+        box64_mmu_store(&ctx->mmu, worker->stack_top, 8, 0x401000 + round);
+        Box64ThunkCall call;
+        const Box64Thunk *thunk = NULL;
+        Box64ThunkStatus status = box64_imports_prepare(&worker->guest->table, ctx, STUB_BASE, &call, &thunk, NULL);
+        if (status == BOX64_THUNK_OK) {
+            status = box64_imports_call(thunk, &call);
+        }
+        if (status != BOX64_THUNK_OK || ctx->x86_regs[0] != round || ctx->rip != 0x401000 + round ||
+            ctx->x86_regs[4] != worker->stack_top + 8) {
+            worker->mismatches++;
+        }
+    }
+    box64_mmu_destroy(&ctx->mmu);
+    free(ctx);
+    return NULL;
+}
+
+// 多个线程同时分派：槽位只解析一次，调用计数不丢
+static void check_concurrent_dispatch(Guest *guest) {
+    Box64ThunkRegistry *registry = box64_thunk_registry_create();
+    box64_thunk_register(registry, "kernel32", "Sum6", thunk_count, 6, NULL);
+    Box64ImportStatus status;
+    if (!setup_guest(guest, registry, DLL_KERNEL32, &status)) {
+        CHECK(0, "cannot map import image");
+        box64_thunk_registry_destroy(registry);
+        return;
+    }
+    box64_mmu_map(&guest->ctx.mmu, STUB_BASE, box64_imports_stub_size(&guest->table), BOX64_PROT_READ | BOX64_PROT_WRITE);
+    status = box64_imports_bind(&guest->table, &guest->ctx.mmu, STUB_BASE);
+    CHECK(status == BOX64_IMPORT_OK, "concurrent bind: %s", box64_import_status_string(status));
+
+    atomic_store(&concurrent_calls, 0);
+    pthread_t threads[CONCURRENT_THREADS];
+    DispatchWorker workers[CONCURRENT_THREADS];
+    for (uint32_t i = 0; i < CONCURRENT_THREADS; i++) {
+        workers[i] = (DispatchWorker){ guest, STACK_BASE + (uint64_t)(i + 1) * 0x3000, 0 };
+        pthread_create(&threads[i], NULL, dispatch_worker, &workers[i]);
+    }
+    uint32_t mismatches = 0;
+    for (uint32_t i = 0; i < CONCURRENT_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+        mismatches += workers[i].mismatches;
+    }
+    const uint64_t expected = (uint64_t)CONCURRENT_THREADS * CONCURRENT_ROUNDS;
+    CHECK(mismatches == 0, "concurrent: %u dispatches returned wrong state", mismatches);
+    CHECK(guest->table.resolved == 1, "concurrent: slot resolved %u times", guest->table.resolved);
+    CHECK(guest->table.slots[0].calls == expected && atomic_load(&concurrent_calls) == expected,
+          "concurrent: %llu calls counted, %llu made of %llu", (unsigned long long)guest->table.slots[0].calls,
+          (unsigned long long)atomic_load(&concurrent_calls), (unsigned long long)expected);
+
+    teardown_guest(guest);
+    box64_thunk_registry_destroy(registry);
+}
+
+static void check_malformed(Guest *guest) {
+    Box64ImportStatus status;
+    if (setup_guest(guest, NULL, 0x9000, &status)) {
+        CHECK(status == BOX64_IMPORT_BAD_DIRECTORY, "dll name outside image: %s", box64_import_status_string(status));
+        teardown_guest(guest);
+    }
+    if (setup_guest(guest, NULL, 0, &status)) {
+        CHECK(status == BOX64_IMPORT_BAD_DIRECTORY, "missing dll name: %s", box64_import_status_string(status));
+        teardown_guest(guest);
+    }
+
+    // 没有导入目录
+    if (setup_guest(guest, NULL, DLL_KERNEL32, &status)) {
+        guest->image.directories[BOX64_PE_DIR_IMPORT].rva = 0;
+        status = box64_imports_scan(&guest->table, &guest->ctx.mmu, &guest->image);
+        CHECK(status == BOX64_IMPORT_OK && guest->table.count == 0 && !box64_imports_contains(&guest->table, 0),
+              "no imports: %s", box64_import_status_string(status));
+
+        // 目录指向镜像末尾，描述符越界
+        guest->image.directories[BOX64_PE_DIR_IMPORT].rva = 0x2FF0;
+        status = box64_imports_scan(&guest->table, &guest->ctx.mmu, &guest->image);
+        CHECK(status == BOX64_IMPORT_BAD_DIRECTORY, "descriptor past image: %s", box64_import_status_string(status));
+        teardown_guest(guest);
+    }
+
+    // IAT 页没有映射时绑定失败
+    if (setup_guest(guest, NULL, DLL_KERNEL32, &status)) {
+        box64_mmu_map(&guest->ctx.mmu, STUB_BASE, box64_imports_stub_size(&guest->table), BOX64_PROT_READ | BOX64_PROT_WRITE);
+        box64_mmu_unmap(&guest->ctx.mmu, IMAGE_BASE + IDATA_RVA, 0x1000);
+        status = box64_imports_bind(&guest->table, &guest->ctx.mmu, STUB_BASE);
+        CHECK(status == BOX64_IMPORT_STUB_FAILED, "unmapped IAT: %s", box64_import_status_string(status));
+        teardown_guest(guest);
+    }
+}
+
+int main(void) {
+    Guest guest;
+    guest.backing = aligned_alloc(BOX64_PAGE_SIZE, GUEST_MEMORY_SIZE);
+    if (!guest.backing) {
+        return 1;
+    }
+
+    check_registry();
+    check_bind_and_dispatch(&guest);
+    check_concurrent_dispatch(&guest);
+    check_malformed(&guest);
+
+    free(guest.backing);
+    if (failures) {
+        printf("[ImportsTest] %d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("[ImportsTest] ✅ all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,144 @@
+// test_box64_mmu.c - Box64MMU 页表 / 权限 / TLB / 跨页访问测试
+#include "Box64MMU.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int failures = 0;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { printf("[MMUTest] ❌ " __VA_ARGS__); printf("\n"); failures++; } \
+} while (0)
+
+static uint8_t *alloc_backing(size_t size) {
+    void *memory = NULL;
+    if (posix_memalign(&memory, BOX64_PAGE_SIZE, size) != 0) {
+        return NULL;
+    }
+    memset(memory, 0, size);
+    return memory;
+}
+
+// 映射前后的读写与权限
+static void check_permissions(Box64MMU *mmu) {
+    uint64_t value = 0;
+    CHECK(!box64_mmu_load(mmu, 0x2000, 4, &value), "unmapped read succeeded");
+    CHECK(mmu->fault_address == 0x2000 && mmu->fault_access == BOX64_ACCESS_READ, "fault not recorded");
+
+    CHECK(box64_mmu_map(mmu, 0x2000, 0x1800, BOX64_PROT_READ | BOX64_PROT_WRITE), "map failed");
+    CHECK(box64_mmu_query(mmu, 0x3FFF) == (BOX64_PROT_READ | BOX64_PROT_WRITE), "map not rounded up to page");
+    CHECK(box64_mmu_query(mmu, 0x4000) == BOX64_PROT_NONE, "map overran");
+
+    CHECK(box64_mmu_store(mmu, 0x2010, 8, 0x1122334455667788ULL), "store failed");
+    CHECK(box64_mmu_load(mmu, 0x2010, 2, &value) && value == 0x7788, "load 2 = 0x%llx", (unsigned long long)value);
+    CHECK(box64_mmu_load(mmu, 0x2010, 8, &value) && value == 0x1122334455667788ULL, "load 8 mismatch");
+    CHECK(mmu->backing[0x2010] == 0x88, "default mapping is not backing + address");
+
+    // 只读后写入失败，TLB中的写项必须作废
+    CHECK(box64_mmu_protect(mmu, 0x2000, BOX64_PAGE_SIZE, BOX64_PROT_READ), "protect failed");
+    CHECK(!box64_mmu_store(mmu, 0x2010, 1, 0), "write to read-only page succeeded");
+    CHECK(box64_mmu_load(mmu, 0x2010, 1, &value) && value == 0x88, "read-only page not readable");
+    CHECK(!box64_mmu_protect(mmu, 0x3000, 0x2000, BOX64_PROT_READ), "protect over unmapped page succeeded");
+    CHECK(box64_mmu_query(mmu, 0x3000) == (BOX64_PROT_READ | BOX64_PROT_WRITE), "failed protect modified pages");
+
+    // 执行权限独立于读写
+    CHECK(!box64_mmu_check(mmu, 0x2000, 1, BOX64_ACCESS_EXEC), "exec allowed without PROT_EXEC");
+    CHECK(box64_mmu_protect(mmu, 0x2000, 1, BOX64_PROT_READ | BOX64_PROT_EXEC), "protect exec failed");
+    CHECK(box64_mmu_translate(mmu, 0x2000, 1, BOX64_ACCESS_EXEC) != NULL, "exec translate failed");
+
+    CHECK(box64_mmu_unmap(mmu, 0x2000, 0x2000), "unmap failed");
+    CHECK(!box64_mmu_load(mmu, 0x2010, 1, &value), "read after unmap succeeded");
+    CHECK(!box64_mmu_map(mmu, mmu->size - BOX64_PAGE_SIZE, 2 * BOX64_PAGE_SIZE, BOX64_PROT_READ), "map past end succeeded");
+    CHECK(mmu->stats.mapped_pages == 0, "mapped_pages = %u", mmu->stats.mapped_pages);
+}
+
+// 跨页访问：连续宿主页直接访问，不连续时逐页复制；任一页缺失时不写入
+static void check_page_crossing(Box64MMU *mmu) {
+    uint64_t value = 0;
+    CHECK(box64_mmu_map(mmu, 0x8000, 2 * BOX64_PAGE_SIZE, BOX64_PROT_READ | BOX64_PROT_WRITE), "map failed");
+    CHECK(box64_mmu_store(mmu, 0x8FFC, 8, 0xAABBCCDDEEFF0011ULL), "crossing store failed");
+    CHECK(box64_mmu_load(mmu, 0x8FFC, 8, &value) && value == 0xAABBCCDDEEFF0011ULL, "crossing load mismatch");
+
+    // 第二页换成外部宿主页
+    uint8_t *external = alloc_backing(BOX64_PAGE_SIZE);
+    CHECK(box64_mmu_map_host(mmu, 0x9000, BOX64_PAGE_SIZE, external, BOX64_PROT_READ | BOX64_PROT_WRITE), "map_host failed");
+    CHECK(box64_mmu_translate(mmu, 0x8FFC, 8, BOX64_ACCESS_WRITE) == NULL, "non-contiguous span returned a pointer");
+    CHECK(box64_mmu_store(mmu, 0x8FFE, 4, 0x44332211), "split store failed");
+    CHECK(mmu->backing[0x8FFF] == 0x22 && external[0] == 0x33 && external[1] == 0x44, "split store landed wrong");
+    CHECK(box64_mmu_load(mmu, 0x8FFE, 4, &value) && value == 0x44332211, "split load mismatch");
+
+    // 第二页只读：跨页写入整体失败，第一页不被部分修改
+    CHECK(box64_mmu_protect(mmu, 0x9000, 1, BOX64_PROT_READ), "protect failed");
+    uint8_t before = mmu->backing[0x8FFF];
+    uint64_t faults = mmu->stats.faults;
+    CHECK(!box64_mmu_store(mmu, 0x8FFE, 4, 0), "store into read-only page succeeded");
+    CHECK(mmu->backing[0x8FFF] == before, "partial write before fault");
+    CHECK(mmu->fault_address == 0x9000 && mmu->stats.faults == faults + 1, "fault address 0x%llx / count",
+          (unsigned long long)mmu->fault_address);
+
+    uint8_t buffer[3 * BOX64_PAGE_SIZE];
+    memset(buffer, 0x5A, sizeof(buffer));
+    CHECK(!box64_mmu_copy_to_guest(mmu, 0x8000, buffer, sizeof(buffer)), "copy over unmapped page succeeded");
+    CHECK(box64_mmu_copy_from_guest(mmu, buffer, 0x8800, 0x1000), "copy_from_guest failed");
+
+    box64_mmu_unmap(mmu, 0x8000, 2 * BOX64_PAGE_SIZE);
+    free(external);
+}
+
+// 同页重复访问命中TLB；映射变化只作废受影响的项
+static void check_tlb(Box64MMU *mmu) {
+    uint64_t value = 0;
+    CHECK(box64_mmu_map(mmu, 0x10000, 4 * BOX64_PAGE_SIZE, BOX64_PROT_READ | BOX64_PROT_WRITE), "map failed");
+    box64_mmu_load(mmu, 0x10000, 8, &value);
+    uint64_t misses = mmu->stats.tlb_misses;
+    for (int i = 0; i < 100; i++) {
+        box64_mmu_store(mmu, 0x10000 + (uint64_t)i * 8, 8, (uint64_t)i);
+        box64_mmu_load(mmu, 0x10000 + (uint64_t)i * 8, 8, &value);
+    }
+    CHECK(mmu->stats.tlb_misses == misses, "same-page accesses missed the TLB (%llu)",
+          (unsigned long long)(mmu->stats.tlb_misses - misses));
+
+    box64_mmu_load(mmu, 0x11000, 8, &value);
+    misses = mmu->stats.tlb_misses;
+    box64_mmu_protect(mmu, 0x10000, 1, BOX64_PROT_READ);
+    box64_mmu_load(mmu, 0x11000, 8, &value);
+    CHECK(mmu->stats.tlb_misses == misses, "protect of another page evicted the entry");
+    box64_mmu_load(mmu, 0x10000, 8, &value);
+    CHECK(mmu->stats.tlb_misses == misses + 1, "protected page still cached");
+
+    // 与 0x10000 冲突的页（相差 TLB_ENTRIES 页）
+    const uint64_t alias = 0x10000 + BOX64_TLB_ENTRIES * BOX64_PAGE_SIZE;
+    if (alias + BOX64_PAGE_SIZE <= mmu->size) {
+        CHECK(box64_mmu_map(mmu, alias, BOX64_PAGE_SIZE, BOX64_PROT_READ | BOX64_PROT_WRITE), "alias map failed");
+        CHECK(box64_mmu_store(mmu, alias, 8, 0xABCD), "alias store failed");
+        CHECK(box64_mmu_load(mmu, 0x10000, 8, &value) && value == 0, "aliasing TLB entry returned wrong page");
+    }
+}
+
+int main(void) {
+    const size_t size = (BOX64_TLB_ENTRIES + 32) * BOX64_PAGE_SIZE;
+    uint8_t *backing = alloc_backing(size);
+    Box64MMU *mmu = calloc(1, sizeof(Box64MMU));
+    if (!backing || !mmu) {
+        printf("[MMUTest] 内存分配失败\n");
+        return 1;
+    }
+    CHECK(!box64_mmu_init(mmu, backing + 1, size), "unaligned backing accepted");
+    CHECK(box64_mmu_init(mmu, backing, size + 100), "init failed");
+    CHECK(mmu->size == size && mmu->stats.mapped_pages == 0, "address space size %llu", (unsigned long long)mmu->size);
+
+    check_permissions(mmu);
+    check_page_crossing(mmu);
+    check_tlb(mmu);
+
+    box64_mmu_destroy(mmu);
+    free(mmu);
+    free(backing);
+
+    if (failures) {
+        printf("[MMUTest] %d failure(s)\n", failures);
+        return 1;
+    }
+    printf("[MMUTest] ✅ all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,571 @@
+// test_box64_pe_loader.c - PE加载器测试
+// 镜像按 TestBinaryCreator 的布局在内存中生成（同样的头部字段、0x400处的.text），
+// 另外构造多节（.data/.bss/.reloc）、PE32 和各种损坏的文件；按页对齐的文件经 mmap 直接映射
+#include "Box64PELoader.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#define GUEST_MEMORY_SIZE   (16u * 1024 * 1024)
+#define FALLBACK_BASE       0x800000ULL
+#define FILE_CAPACITY       0x10000
+#define LARGE_IMAGE_SIZE    (32u * 1024 * 1024)
+
+static int failures = 0;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { printf("[PELoaderTest] ❌ " __VA_ARGS__); printf("\n"); failures++; } \
+} while (0)
+
+// MARK: - 镜像构造
+
+static void put16(uint8_t *p, uint16_t v) { p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); }
+static void put32(uint8_t *p, uint32_t v) { put16(p, (uint16_t)v); put16(p + 2, (uint16_t)(v >> 16)); }
+static void put64(uint8_t *p, uint64_t v) { put32(p, (uint32_t)v); put32(p + 4, (uint32_t)(v >> 32)); }
+
+typedef struct TestSection {
+    const char *name;
+    uint32_t virtual_address;
+    uint32_t virtual_size;
+    uint32_t raw_size;              // 文件中占用的字节数（按0x200取整），0表示没有文件内容
+    uint32_t characteristics;
+    const uint8_t *data;
+    size_t data_size;
+} TestSection;
+
+typedef struct TestImage {
+    bool pe32;
+    uint32_t file_alignment;        // 0 表示 TestBinaryCreator 的 0x200（头部0x400）
+    uint16_t characteristics;
+    uint64_t image_base;
+    uint32_t size_of_image;
+    uint32_t entry_rva;
+    uint32_t reloc_rva;
+    uint32_t reloc_size;
+    const TestSection *sections;
+    int section_count;
+} TestImage;
+
+// DOS头(64) + "PE\0\0" + COFF头 + 可选头 + 节表，头部填充到0x400（或文件对齐）；节数据随后依次存放
+static size_t build_pe(const TestImage *spec, uint8_t *file) {
+    const uint32_t file_alignment = spec->file_alignment ? spec->file_alignment : 0x200;
+    const uint32_t headers = file_alignment > 0x400 ? file_alignment : 0x400;
+    memset(file, 0, FILE_CAPACITY);
+    file[0] = 'M';
+    file[1] = 'Z';
+    put32(file + 60, 64);
+    memcpy(file + 64, "PE\0\0", 4);
+
+    uint8_t *coff = file + 68;
+    const uint16_t optional_size = spec->pe32 ? 224 : 240;
+    put16(coff + 0, spec->pe32 ? BOX64_PE_MACHINE_I386 : BOX64_PE_MACHINE_AMD64);
+    put16(coff + 2, (uint16_t)spec->section_count);
+    put16(coff + 16, optional_size);
+    put16(coff + 18, spec->characteristics);
+
+    uint8_t *optional = coff + 20;
+    put16(optional + 0, spec->pe32 ? 0x010B : 0x020B);
+    optional[2] = 1;
+    put32(optional + 4, 0x200);
+    put32(optional + 16, spec->entry_rva);
+    put32(optional + 20, 0x1000);
+    if (spec->pe32) {
+        put32(optional + 28, (uint32_t)spec->image_base);
+    } else {
+        put64(optional + 24, spec->image_base);
+    }
+    put32(optional + 32, 0x1000);
+    put32(optional + 36, file_alignment);
+    put16(optional + 40, 6);
+    put16(optional + 44, 6);
+    put16(optional + 48, 6);
+    put32(optional + 56, spec->size_of_image);
+    put32(optional + 60, headers);
+    put16(optional + 68, 3);
+    uint8_t *directories;
+    if (spec->pe32) {
+        put32(optional + 72, 0x100000);
+        put32(optional + 76, 0x1000);
+        put32(optional + 92, 16);
+        directories = optional + 96;
+    } else {
+        put64(optional + 72, 0x100000);
+        put64(optional + 80, 0x1000);
+        put64(optional + 88, 0x100000);
+        put64(optional + 96, 0x1000);
+        put32(optional + 108, 16);
+        directories = optional + 112;
+    }
+    put32(directories + BOX64_PE_DIR_BASERELOC * 8, spec->reloc_rva);
+    put32(directories + BOX64_PE_DIR_BASERELOC * 8 + 4, spec->reloc_size);
+
+    uint8_t *table = optional + optional_size;
+    uint32_t raw_offset = headers;
+    for (int i = 0; i < spec->section_count; i++) {
+        const TestSection *section = &spec->sections[i];
+        uint8_t *header = table + i * 40;
+        memcpy(header, section->name, strlen(section->name));
+        put32(header + 8, section->virtual_size);
+        put32(header + 12, section->virtual_address);
+        put32(header + 16, section->raw_size);
+        put32(header + 20, section->raw_size ? raw_offset : 0);
+        put32(header + 36, section->characteristics);
+        if (section->raw_size) {
+            memcpy(file + raw_offset, section->data, section->data_size);
+            raw_offset += section->raw_size;
+        }
+    }
+    return raw_offset;
+}
+
+// TestBinaryCreator createSimpleTestPE / createHelloWorldPE / createInstructionTestPE 的布局：
+// 单个.text节，VA 0x1000，文件偏移0x400，大小0x200，入口点RVA 0x1000，ImageBase 0x400000
+static size_t build_creator_pe(const uint8_t *code, size_t code_size, uint8_t *file) {
+    const TestSection text = { ".text", 0x1000, 0x200, 0x200, 0x60000020, code, code_size };
+    const TestImage spec = { false, 0, 0x022, 0x400000, 0x2000, 0x1000, 0, 0, &text, 1 };
+    return build_pe(&spec, file);
+}
+
+static const uint8_t simple_code[] = {
+    0x48, 0xC7, 0xC0, 0x2A, 0x00, 0x00, 0x00,   // MOV RAX, 42
+    0x90, 0x90, 0x90,                           // NOP x3
+    0xC3                                        // RET
+};
+
+static const uint8_t hello_code[] = {
+    0x48, 0xC7, 0xC0, 0x01, 0x00, 0x00, 0x00,   // MOV RAX, 1
+    0x48, 0x83, 0xC0, 0x01,                     // ADD RAX, 1
+    0x90,
+    0xC3
+};
+
+static const uint8_t instruction_code[] = {
+    0xB8, 0x0A, 0x00, 0x00, 0x00,               // MOV EAX, 10
+    0x05, 0x05, 0x00, 0x00, 0x00,               // ADD EAX, 5
+    0x2D, 0x03, 0x00, 0x00, 0x00,               // SUB EAX, 3
+    0x90,
+    0xC3
+};
+
+// 多节镜像：.text / .data（含两个需要重定位的指针，文件中 VirtualSize 之后有不应映射的哨兵）
+// / .bss（无文件内容，跨两页）/ .reloc
+#define MULTI_BASE          0x600000ULL
+#define MULTI_DATA_RVA      0x2000
+#define MULTI_BSS_RVA       0x3000
+#define MULTI_RELOC_RVA     0x5000
+
+static uint8_t multi_data[0x200];
+static uint8_t multi_reloc[12];
+
+static size_t build_multi_pe(bool pe32, uint16_t characteristics, uint8_t reloc_type, uint8_t *file) {
+    memset(multi_data, 0, sizeof(multi_data));
+    put64(multi_data + 0, MULTI_BASE + MULTI_BSS_RVA + 0x10);          // DIR64
+    put32(multi_data + 8, (uint32_t)(MULTI_BASE + 0x1000));             // HIGHLOW
+    memset(multi_data + 0x20, 0xEE, 0x1E0);                             // VirtualSize(0x20)之后
+
+    put32(multi_reloc + 0, MULTI_DATA_RVA);
+    put32(multi_reloc + 4, sizeof(multi_reloc));
+    put16(multi_reloc + 8, (uint16_t)(reloc_type << 12 | 0x000));
+    put16(multi_reloc + 10, (uint16_t)(BOX64_PE_REL_HIGHLOW << 12 | 0x008));
+
+    const TestSection sections[] = {
+        { ".text",  0x1000,          0x0B,   0x200, 0x60000020, simple_code, sizeof(simple_code) },
+        { ".data",  MULTI_DATA_RVA,  0x20,   0x200, 0xC0000040, multi_data, sizeof(multi_data) },
+        { ".bss",   MULTI_BSS_RVA,   0x1800, 0,     0xC0000080, NULL, 0 },
+        { ".reloc", MULTI_RELOC_RVA, sizeof(multi_reloc), 0x200, 0x42000040, multi_reloc, sizeof(multi_reloc) },
+    };
+    const TestImage spec = { pe32, 0, characteristics, MULTI_BASE, 0x6000, 0x1000, MULTI_RELOC_RVA,
+                             sizeof(multi_reloc), sections, 4 };
+    return build_pe(&spec, file);
+}
+
+// 按页对齐的镜像（FileAlignment 0x1000），可以经 box64_pe_map_file 直接映射：
+// .text / .rdata（VirtualSize 之后的文件字节非0）/ .data（含DIR64指针）/ .bss / .reloc
+#define ALIGNED_BASE        0x500000ULL
+
+static uint8_t aligned_rdata[0x2000];
+static uint8_t aligned_data[0x1000];
+static uint8_t aligned_reloc[12];
+
+static size_t build_aligned_pe(uint8_t *file) {
+    for (size_t i = 0; i < sizeof(aligned_rdata); i++) {
+        aligned_rdata[i] = i < 0x1800 ? (uint8_t)(i * 7 + 1) : 0xAB;
+    }
+    memset(aligned_data, 0, sizeof(aligned_data));
+    put64(aligned_data, ALIGNED_BASE + 0x2000);
+    memset(aligned_data + 0x30, 0xEE, 0x10);
+
+    put32(aligned_reloc + 0, 0x4000);
+    put32(aligned_reloc + 4, sizeof(aligned_reloc));
+    put16(aligned_reloc + 8, (uint16_t)(BOX64_PE_REL_DIR64 << 12 | 0x000));
+    put16(aligned_reloc + 10, 0);
+
+    const TestSection sections[] = {
+        { ".text",  0x1000, 0x0B,   0x1000, 0x60000020, simple_code, sizeof(simple_code) },
+        { ".rdata", 0x2000, 0x1800, 0x2000, 0x40000040, aligned_rdata, sizeof(aligned_rdata) },
+        { ".data",  0x4000, 0x30,   0x1000, 0xC0000040, aligned_data, sizeof(aligned_data) },
+        { ".bss",   0x5000, 0x2000, 0,      0xC0000080, NULL, 0 },
+        { ".reloc", 0x7000, sizeof(aligned_reloc), 0x1000, 0x42000040, aligned_reloc, sizeof(aligned_reloc) },
+    };
+    const TestImage spec = { false, 0x1000, 0x022, ALIGNED_BASE, 0x8000, 0x1000, 0x7000, sizeof(aligned_reloc),
+                             sections, 5 };
+    return build_pe(&spec, file);
+}
+
+// MARK: - 辅助
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static bool write_temp_file(const uint8_t *data, size_t size, char *path, size_t path_size) {
+    snprintf(path, path_size, "/tmp/box64_pe_XXXXXX");
+    const int fd = mkstemp(path);
+    if (fd < 0) {
+        return false;
+    }
+    const bool ok = write(fd, data, size) == (ssize_t)size;
+    close(fd);
+    return ok;
+}
+
+static bool file_matches(const char *path, const uint8_t *expected, size_t size) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        return false;
+    }
+    bool same = true;
+    for (size_t i = 0; i < size && same; i++) {
+        same = fgetc(fp) == expected[i];
+    }
+    fclose(fp);
+    return same;
+}
+
+static uint8_t *guest_backing;
+
+static void fresh_mmu(Box64MMU *mmu) {
+    box64_mmu_destroy(mmu);
+    memset(guest_backing, 0xCC, GUEST_MEMORY_SIZE);    // 残留内容必须被加载器清零
+    box64_mmu_init(mmu, guest_backing, GUEST_MEMORY_SIZE);
+}
+
+static uint64_t load(Box64MMU *mmu, uint64_t address, uint8_t size) {
+    uint64_t value = 0;
+    if (!box64_mmu_load(mmu, address, size, &value)) {
+        return 0xDEADDEADDEADDEADULL;
+    }
+    return value;
+}
+
+// MARK: - 用例
+
+static void check_creator_binaries(Box64MMU *mmu, uint8_t *file) {
+    const struct { const char *name; const uint8_t *code; size_t size; } binaries[] = {
+        { "simple_test.exe",      simple_code,      sizeof(simple_code) },
+        { "hello_world.exe",      hello_code,       sizeof(hello_code) },
+        { "instruction_test.exe", instruction_code, sizeof(instruction_code) },
+    };
+    for (size_t b = 0; b < sizeof(binaries) / sizeof(binaries[0]); b++) {
+        const size_t size = build_creator_pe(binaries[b].code, binaries[b].size, file);
+        CHECK(size == 0x600, "%s: file size 0x%zx", binaries[b].name, size);
+
+        Box64PEImage image;
+        Box64PEStatus status = box64_pe_parse(file, size, &image);
+        CHECK(status == BOX64_PE_OK, "%s: parse %s", binaries[b].name, box64_pe_status_string(status));
+        CHECK(image.pe32_plus && image.machine == BOX64_PE_MACHINE_AMD64 && image.subsystem == 3 &&
+              image.section_count == 1 && image.stack_reserve == 0x100000 && image.directory_count == 16,
+              "%s: header fields", binaries[b].name);
+
+        fresh_mmu(mmu);
+        status = box64_pe_map(mmu, file, size, &image, FALLBACK_BASE);
+        CHECK(status == BOX64_PE_OK && image.base == 0x400000 && !image.relocated, "%s: map %s base 0x%llx",
+              binaries[b].name, box64_pe_status_string(status), (unsigned long long)image.base);
+        CHECK(image.entry_point == 0x401000, "%s: entry 0x%llx", binaries[b].name, (unsigned long long)image.entry_point);
+
+        uint8_t mapped[0x200];
+        CHECK(box64_mmu_copy_from_guest(mmu, mapped, image.entry_point, sizeof(mapped)), "%s: entry unreadable",
+              binaries[b].name);
+        CHECK(memcmp(mapped, binaries[b].code, binaries[b].size) == 0, "%s: code differs at entry", binaries[b].name);
+        CHECK(load(mmu, 0x401000 + 0x200, 8) == 0 && load(mmu, 0x401FF8, 8) == 0, "%s: section tail not zeroed",
+              binaries[b].name);
+        CHECK(load(mmu, 0x400000, 2) == 0x5A4D, "%s: headers not mapped", binaries[b].name);
+
+        CHECK(box64_mmu_query(mmu, 0x400000) == BOX64_PROT_READ, "%s: header prot %u", binaries[b].name,
+              box64_mmu_query(mmu, 0x400000));
+        CHECK(box64_mmu_query(mmu, 0x401000) == (BOX64_PROT_READ | BOX64_PROT_EXEC), "%s: .text prot %u",
+              binaries[b].name, box64_mmu_query(mmu, 0x401000));
+        CHECK(!box64_mmu_store(mmu, 0x401000, 1, 0), "%s: .text writable", binaries[b].name);
+        CHECK(box64_mmu_query(mmu, 0x402000) == BOX64_PROT_NONE && box64_mmu_query(mmu, 0x3FF000) == BOX64_PROT_NONE,
+              "%s: pages outside image mapped", binaries[b].name);
+    }
+
+    // 首选基址被占用（例如客户机堆覆盖了0x400000）：没有重定位表也可以整体搬到备用基址
+    const size_t size = build_creator_pe(simple_code, sizeof(simple_code), file);
+    Box64PEImage image;
+    box64_pe_parse(file, size, &image);
+    fresh_mmu(mmu);
+    box64_mmu_map(mmu, 0x400000, BOX64_PAGE_SIZE, BOX64_PROT_READ | BOX64_PROT_WRITE);
+    Box64PEStatus status = box64_pe_map(mmu, file, size, &image, FALLBACK_BASE);
+    CHECK(status == BOX64_PE_OK && image.base == FALLBACK_BASE && image.relocated && image.relocations_applied == 0,
+          "occupied base: %s base 0x%llx", box64_pe_status_string(status), (unsigned long long)image.base);
+    CHECK(image.entry_point == FALLBACK_BASE + 0x1000 && load(mmu, image.entry_point, 4) == 0x2AC0C748,
+          "occupied base: entry 0x%llx", (unsigned long long)image.entry_point);
+    CHECK(box64_mmu_query(mmu, 0x400000) == (BOX64_PROT_READ | BOX64_PROT_WRITE), "occupied base: existing mapping changed");
+
+    fresh_mmu(mmu);
+    box64_mmu_map(mmu, 0x401000, BOX64_PAGE_SIZE, BOX64_PROT_READ);
+    status = box64_pe_map(mmu, file, size, &image, 0);
+    CHECK(status == BOX64_PE_BASE_UNAVAILABLE, "no fallback: %s", box64_pe_status_string(status));
+}
+
+static void check_multi_section(Box64MMU *mmu, uint8_t *file) {
+    size_t size = build_multi_pe(false, 0x022, BOX64_PE_REL_DIR64, file);
+    Box64PEImage image;
+    Box64PEStatus status = box64_pe_parse(file, size, &image);
+    CHECK(status == BOX64_PE_OK && image.section_count == 4, "multi: parse %s", box64_pe_status_string(status));
+
+    // 首选基址空闲：不应用重定位
+    fresh_mmu(mmu);
+    status = box64_pe_map(mmu, file, size, &image, FALLBACK_BASE);
+    CHECK(status == BOX64_PE_OK && image.base == MULTI_BASE && !image.relocated, "multi: map %s",
+          box64_pe_status_string(status));
+    CHECK(load(mmu, MULTI_BASE + MULTI_DATA_RVA, 8) == MULTI_BASE + MULTI_BSS_RVA + 0x10, "multi: DIR64 changed");
+    CHECK(load(mmu, MULTI_BASE + MULTI_DATA_RVA + 0x20, 8) == 0, "multi: data past VirtualSize was mapped");
+    CHECK(load(mmu, MULTI_BASE + MULTI_BSS_RVA, 8) == 0 && load(mmu, MULTI_BASE + MULTI_BSS_RVA + 0x17F8, 8) == 0,
+          "multi: .bss not zero-filled");
+    CHECK(box64_mmu_store(mmu, MULTI_BASE + MULTI_BSS_RVA + 0x1000, 8, 1), "multi: .bss second page not writable");
+    CHECK(box64_mmu_query(mmu, MULTI_BASE + MULTI_DATA_RVA) == (BOX64_PROT_READ | BOX64_PROT_WRITE),
+          "multi: .data prot %u", box64_mmu_query(mmu, MULTI_BASE + MULTI_DATA_RVA));
+    CHECK(box64_mmu_query(mmu, MULTI_BASE + MULTI_RELOC_RVA) == BOX64_PROT_READ, "multi: .reloc prot");
+    const Box64PESection *section = box64_pe_section_for_rva(&image, MULTI_BSS_RVA + 0x1200);
+    CHECK(section && strcmp(section->name, ".bss") == 0, "multi: section_for_rva");
+    CHECK(box64_pe_section_for_rva(&image, 0x4F00) != NULL && box64_pe_section_for_rva(&image, 0x5000 + 0x1000) == NULL,
+          "multi: section span");
+
+    // 首选基址被占用：DIR64 和 HIGHLOW 都加上差值
+    fresh_mmu(mmu);
+    box64_mmu_map(mmu, MULTI_BASE + 0x3000, BOX64_PAGE_SIZE, BOX64_PROT_READ);
+    status = box64_pe_map(mmu, file, size, &image, FALLBACK_BASE);
+    const uint64_t delta = FALLBACK_BASE - MULTI_BASE;
+    CHECK(status == BOX64_PE_OK && image.relocated && image.relocations_applied == 2, "multi relocated: %s (%u fixups)",
+          box64_pe_status_string(status), image.relocations_applied);
+    CHECK(load(mmu, FALLBACK_BASE + MULTI_DATA_RVA, 8) == MULTI_BASE + delta + MULTI_BSS_RVA + 0x10,
+          "multi relocated: DIR64 0x%llx", (unsigned long long)load(mmu, FALLBACK_BASE + MULTI_DATA_RVA, 8));
+    CHECK(load(mmu, FALLBACK_BASE + MULTI_DATA_RVA + 8, 4) == (uint32_t)(MULTI_BASE + delta + 0x1000),
+          "multi relocated: HIGHLOW 0x%llx", (unsigned long long)load(mmu, FALLBACK_BASE + MULTI_DATA_RVA + 8, 4));
+    CHECK(image.entry_point == FALLBACK_BASE + 0x1000, "multi relocated: entry");
+
+    // RELOCS_STRIPPED 的镜像不能搬走
+    size = build_multi_pe(false, 0x023, BOX64_PE_REL_DIR64, file);
+    box64_pe_parse(file, size, &image);
+    status = box64_pe_map(mmu, file, size, &image, 0xA00000);
+    CHECK(status == BOX64_PE_BASE_UNAVAILABLE, "stripped: %s", box64_pe_status_string(status));
+    CHECK(box64_mmu_query(mmu, 0xA00000) == BOX64_PROT_NONE, "stripped: fallback touched");
+
+    // 不支持的重定位类型
+    size = build_multi_pe(false, 0x022, 7, file);
+    box64_pe_parse(file, size, &image);
+    status = box64_pe_map(mmu, file, size, &image, 0xA00000);
+    CHECK(status == BOX64_PE_BAD_RELOCATION, "bad reloc type: %s", box64_pe_status_string(status));
+
+    // PE32：32位基址字段和较短的可选头
+    size = build_multi_pe(true, 0x102, BOX64_PE_REL_HIGHLOW, file);
+    status = box64_pe_parse(file, size, &image);
+    CHECK(status == BOX64_PE_OK && !image.pe32_plus && image.machine == BOX64_PE_MACHINE_I386 &&
+          image.preferred_base == MULTI_BASE, "pe32: parse %s", box64_pe_status_string(status));
+    fresh_mmu(mmu);
+    box64_mmu_map(mmu, MULTI_BASE, BOX64_PAGE_SIZE, BOX64_PROT_READ);
+    status = box64_pe_map(mmu, file, size, &image, FALLBACK_BASE);
+    CHECK(status == BOX64_PE_OK && load(mmu, FALLBACK_BASE + MULTI_DATA_RVA, 4) == (uint32_t)(FALLBACK_BASE + MULTI_BSS_RVA + 0x10),
+          "pe32: %s fixup 0x%llx", box64_pe_status_string(status),
+          (unsigned long long)load(mmu, FALLBACK_BASE + MULTI_DATA_RVA, 4));
+}
+
+static void check_malformed(uint8_t *file) {
+    Box64PEImage image;
+    size_t size = build_creator_pe(simple_code, sizeof(simple_code), file);
+
+    CHECK(box64_pe_parse(file, 0x30, &image) == BOX64_PE_TRUNCATED, "tiny file accepted");
+    CHECK(box64_pe_parse(file, 0x100, &image) == BOX64_PE_TRUNCATED, "truncated optional header accepted");
+    CHECK(box64_pe_parse(file, 0x500, &image) == BOX64_PE_BAD_SECTION, "section data past EOF accepted");
+
+    file[1] = 'X';
+    CHECK(box64_pe_parse(file, size, &image) == BOX64_PE_BAD_DOS_HEADER, "bad MZ accepted");
+    file[1] = 'Z';
+    put32(file + 60, 0x7FFFFFF0);
+    CHECK(box64_pe_parse(file, size, &image) == BOX64_PE_TRUNCATED, "e_lfanew past EOF accepted");
+    put32(file + 60, 64);
+    file[66] = 'X';
+    CHECK(box64_pe_parse(file, size, &image) == BOX64_PE_BAD_SIGNATURE, "bad PE signature accepted");
+    file[66] = 0;
+
+    uint8_t *optional = file + 88;
+    put16(optional, 0x0107);
+    CHECK(box64_pe_parse(file, size, &image) == BOX64_PE_BAD_OPTIONAL_HEADER, "bad optional magic accepted");
+    put16(optional, 0x020B);
+    put32(optional + 16, 0x2000);
+    CHECK(box64_pe_parse(file, size, &image) == BOX64_PE_BAD_OPTIONAL_HEADER, "entry outside image accepted");
+    put32(optional + 16, 0x1000);
+    put32(optional + 32, 0x1800);
+    CHECK(box64_pe_parse(file, size, &image) == BOX64_PE_BAD_OPTIONAL_HEADER, "non power-of-two alignment accepted");
+    put32(optional + 32, 0x1000);
+
+    uint8_t *section = optional + 240;
+    put32(section + 8, 0x1200);
+    CHECK(box64_pe_parse(file, size, &image) == BOX64_PE_BAD_SECTION, "section past SizeOfImage accepted");
+    put32(section + 8, 0x200);
+    put32(section + 12, 0x0800);
+    CHECK(box64_pe_parse(file, size, &image) == BOX64_PE_BAD_SECTION, "section over headers accepted");
+    put32(section + 12, 0x1000);
+
+    CHECK(box64_pe_parse(file, size, &image) == BOX64_PE_OK, "restored file rejected");
+}
+
+static void check_file_mapping(Box64MMU *mmu, uint8_t *file) {
+    const size_t size = build_aligned_pe(file);
+    char path[64];
+    if (!write_temp_file(file, size, path, sizeof(path))) {
+        CHECK(0, "cannot write temp file");
+        return;
+    }
+
+    Box64PEFile mapped;
+    CHECK(box64_pe_file_open(path, &mapped) && mapped.size == size, "file open");
+    Box64PEImage image;
+    Box64PEStatus status = box64_pe_parse(mapped.data, mapped.size, &image);
+    CHECK(status == BOX64_PE_OK, "aligned: parse %s", box64_pe_status_string(status));
+
+    fresh_mmu(mmu);
+    status = box64_pe_map_file(mmu, &mapped, &image, FALLBACK_BASE);
+    CHECK(status == BOX64_PE_OK && image.base == ALIGNED_BASE, "aligned: map %s", box64_pe_status_string(status));
+    CHECK(image.file_backed_pages == 5, "aligned: %u file-backed pages", image.file_backed_pages);
+
+    // 零复制：客户机页直接指向文件映射
+    CHECK(box64_mmu_translate(mmu, ALIGNED_BASE + 0x1000, 1, BOX64_ACCESS_EXEC) == mapped.data + 0x1000,
+          "aligned: .text copied instead of mapped");
+    CHECK(box64_mmu_translate(mmu, ALIGNED_BASE + 0x2000, 0x1800, BOX64_ACCESS_READ) == mapped.data + 0x2000,
+          "aligned: .rdata copied instead of mapped");
+    CHECK(load(mmu, ALIGNED_BASE + 0x1000, 4) == 0x2AC0C748, "aligned: entry bytes");
+    CHECK(load(mmu, ALIGNED_BASE + 0x2000 + 0x17F8, 8) != 0 && load(mmu, ALIGNED_BASE + 0x3800, 8) == 0 &&
+          load(mmu, ALIGNED_BASE + 0x3FF8, 8) == 0, "aligned: .rdata past VirtualSize not zero");
+    CHECK(load(mmu, ALIGNED_BASE + 0x4030, 8) == 0, "aligned: .data past VirtualSize not zero");
+    CHECK(load(mmu, ALIGNED_BASE + 0x5000, 8) == 0 && load(mmu, ALIGNED_BASE + 0x6FF8, 8) == 0, "aligned: .bss not zero");
+    CHECK(box64_mmu_query(mmu, ALIGNED_BASE + 0x2000) == BOX64_PROT_READ &&
+          box64_mmu_query(mmu, ALIGNED_BASE + 0x4000) == (BOX64_PROT_READ | BOX64_PROT_WRITE), "aligned: prots");
+
+    // 写时复制：客户机写入不回写磁盘
+    CHECK(box64_mmu_store(mmu, ALIGNED_BASE + 0x4008, 8, 0x1122334455667788ULL) &&
+          load(mmu, ALIGNED_BASE + 0x4008, 8) == 0x1122334455667788ULL, "aligned: .data store");
+    CHECK(file_matches(path, file, size), "aligned: guest write reached the file");
+
+    // 重定位写入同样只落在私有副本；没有修正项的页仍然直接映射
+    box64_mmu_unmap(mmu, ALIGNED_BASE, image.size_of_image);
+    box64_pe_file_close(&mapped);
+    box64_pe_file_open(path, &mapped);
+    box64_pe_parse(mapped.data, mapped.size, &image);
+    box64_mmu_map(mmu, ALIGNED_BASE + 0x6000, BOX64_PAGE_SIZE, BOX64_PROT_READ);
+    status = box64_pe_map_file(mmu, &mapped, &image, FALLBACK_BASE);
+    CHECK(status == BOX64_PE_OK && image.relocated && image.relocations_applied == 1, "aligned relocated: %s",
+          box64_pe_status_string(status));
+    CHECK(load(mmu, FALLBACK_BASE + 0x4000, 8) == FALLBACK_BASE + 0x2000, "aligned relocated: DIR64 0x%llx",
+          (unsigned long long)load(mmu, FALLBACK_BASE + 0x4000, 8));
+    CHECK(box64_mmu_translate(mmu, FALLBACK_BASE + 0x2000, 1, BOX64_ACCESS_READ) == mapped.data + 0x2000,
+          "aligned relocated: .rdata no longer mapped");
+    CHECK(file_matches(path, file, size), "aligned relocated: fixup reached the file");
+
+    box64_mmu_unmap(mmu, FALLBACK_BASE, image.size_of_image);
+    box64_pe_file_close(&mapped);
+    unlink(path);
+}
+
+// 大镜像：复制加载与文件映射加载的耗时
+static void measure_large_image(uint8_t *header) {
+    const size_t size = 0x1000 + LARGE_IMAGE_SIZE;
+    uint8_t *file = malloc(size);
+    uint8_t *backing = mmap(NULL, 2 * LARGE_IMAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (!file || backing == MAP_FAILED) {
+        CHECK(0, "large image allocation failed");
+        free(file);
+        return;
+    }
+    const TestSection text = { ".text", 0x1000, LARGE_IMAGE_SIZE, LARGE_IMAGE_SIZE, 0x60000020, simple_code,
+                               sizeof(simple_code) };
+    const TestImage spec = { false, 0x1000, 0x022, 0x400000, 0x1000 + LARGE_IMAGE_SIZE, 0x1000, 0, 0, &text, 1 };
+    build_pe(&spec, header);
+    memcpy(file, header, 0x1000);
+    for (size_t i = 0x1000; i < size; i++) {
+        file[i] = (uint8_t)(i * 31 + 7);
+    }
+    memcpy(file + 0x1000, simple_code, sizeof(simple_code));
+
+    char path[64];
+    if (!write_temp_file(file, size, path, sizeof(path))) {
+        CHECK(0, "cannot write large temp file");
+        free(file);
+        munmap(backing, 2 * LARGE_IMAGE_SIZE);
+        return;
+    }
+
+    Box64MMU mmu;
+    Box64PEImage image;
+    box64_mmu_init(&mmu, backing, 2 * LARGE_IMAGE_SIZE);
+    box64_pe_parse(file, size, &image);
+    double start = now_seconds();
+    Box64PEStatus status = box64_pe_map(&mmu, file, size, &image, 0);
+    const double copied = now_seconds() - start;
+    CHECK(status == BOX64_PE_OK, "large copy: %s", box64_pe_status_string(status));
+    box64_mmu_unmap(&mmu, image.base, image.size_of_image);
+
+    Box64PEFile mapped;
+    start = now_seconds();
+    box64_pe_file_open(path, &mapped);
+    box64_pe_parse(mapped.data, mapped.size, &image);
+    status = box64_pe_map_file(&mmu, &mapped, &image, 0);
+    const double file_backed = now_seconds() - start;
+    CHECK(status == BOX64_PE_OK && image.file_backed_pages == LARGE_IMAGE_SIZE / BOX64_PAGE_SIZE,
+          "large file: %s (%u pages)", box64_pe_status_string(status), image.file_backed_pages);
+    CHECK(load(&mmu, image.entry_point, 4) == 0x2AC0C748, "large file: entry bytes");
+
+    printf("[PELoaderTest] %u MB image: copy load %.2f ms, file-backed load %.2f ms (%u pages mapped, 0 copied)\n",
+           LARGE_IMAGE_SIZE >> 20, copied * 1e3, file_backed * 1e3, image.file_backed_pages);
+
+    box64_mmu_destroy(&mmu);
+    box64_pe_file_close(&mapped);
+    unlink(path);
+    munmap(backing, 2 * LARGE_IMAGE_SIZE);
+    free(file);
+}
+
+int main(void) {
+    guest_backing = aligned_alloc(BOX64_PAGE_SIZE, GUEST_MEMORY_SIZE);
+    uint8_t *file = malloc(FILE_CAPACITY);
+    Box64MMU mmu;
+    memset(&mmu, 0, sizeof(mmu));
+    if (!guest_backing || !file) {
+        printf("[PELoaderTest] ❌ allocation failed\n");
+        return 1;
+    }
+
+    check_creator_binaries(&mmu, file);
+    check_multi_section(&mmu, file);
+    check_malformed(file);
+    check_file_mapping(&mmu, file);
+    measure_large_image(file);
+
+    box64_mmu_destroy(&mmu);
+    free(file);
+    free(guest_backing);
+
+    if (failures) {
+        printf("[PELoaderTest] %d failure(s)\n", failures);
+        return 1;
+    }
+    printf("[PELoaderTest] ✅ all checks passed\n");
+    return 0;
+}
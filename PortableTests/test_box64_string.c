@@ -0,0 +1,613 @@
+// test_box64_string.c - 字符串指令整段执行的语义校验与吞吐基准
+// 纯C，Linux上直接编译运行:
+//   ./run_portable_tests.sh test_box64_string
+// 以逐元素经MMU读写的参考实现为准，随机比较各种指令/宽度/前缀/方向/寻址宽度下的寄存器、标志和内存，
+// 数据区包含一个宿主不连续的页；再单独检查重叠复制、strlen、缺页后重新执行、线程化解释器中的循环，
+// 最后比较整段执行与逐元素执行的吞吐
+#include "Box64String.h"
+#include "Box64Interp.h"
+#include "Box64Flags.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define GUEST_SIZE      (1024 * 1024)
+#define CODE_BASE       0x1000ULL
+#define DATA_BASE       0x10000ULL      // 4页宿主连续 + 1页单独的宿主内存，其后一页不映射
+#define DATA_SIZE       0x5000ULL
+#define SPLIT_PAGE      0x14000ULL
+#define HOLE_PAGE       0x15000ULL
+#define BENCH_BASE      0x40000ULL
+#define BENCH_BYTES     0x10000ULL
+#define STACK_BASE      0xC0000ULL
+#define STACK_SIZE      0x10000ULL
+#define RANDOM_CASES    6000
+#define BENCH_ROUNDS    2000
+#define REFERENCE_ROUNDS 20
+
+#define REG_RAX         0
+#define REG_RCX         1
+#define REG_RSI         6
+#define REG_RDI         7
+
+static int failures = 0;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { printf("[StringTest] ❌ " __VA_ARGS__); printf("\n"); failures++; } \
+} while (0)
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ULL;
+
+static uint64_t next_random(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+// MARK: - 客户机环境
+
+typedef struct Guest {
+    Box64Context *ctx;
+    uint8_t *backing;
+    uint8_t *split_page;
+    Box64TranslationCache *cache;
+    uint8_t code[256];
+    size_t code_length;
+} Guest;
+
+static bool guest_create(Guest *guest) {
+    memset(guest, 0, sizeof(*guest));
+    void *memory = NULL, *page = NULL;
+    guest->ctx = calloc(1, sizeof(Box64Context));
+    guest->cache = box64_tc_create(64);
+    if (!guest->ctx || !guest->cache || posix_memalign(&memory, BOX64_PAGE_SIZE, GUEST_SIZE) != 0 ||
+        posix_memalign(&page, BOX64_PAGE_SIZE, BOX64_PAGE_SIZE) != 0) {
+        return false;
+    }
+    guest->backing = memory;
+    guest->split_page = page;
+    memset(guest->backing, 0, GUEST_SIZE);
+    Box64MMU *mmu = &guest->ctx->mmu;
+    const uint32_t rw = BOX64_PROT_READ | BOX64_PROT_WRITE;
+    return box64_mmu_init(mmu, guest->backing, GUEST_SIZE) &&
+           box64_mmu_map(mmu, CODE_BASE, BOX64_PAGE_SIZE, BOX64_PROT_READ | BOX64_PROT_EXEC) &&
+           box64_mmu_map(mmu, DATA_BASE, SPLIT_PAGE - DATA_BASE, rw) &&
+           box64_mmu_map_host(mmu, SPLIT_PAGE, BOX64_PAGE_SIZE, guest->split_page, rw) &&
+           box64_mmu_map(mmu, BENCH_BASE, 2 * BENCH_BYTES, rw) &&
+           box64_mmu_map(mmu, STACK_BASE, STACK_SIZE, rw);
+}
+
+static void guest_destroy(Guest *guest) {
+    if (guest->ctx) {
+        box64_mmu_destroy(&guest->ctx->mmu);
+    }
+    box64_tc_destroy(guest->cache);
+    free(guest->split_page);
+    free(guest->backing);
+    free(guest->ctx);
+}
+
+static bool decode(const uint8_t *bytes, size_t length, X86DecodedInsn *insn) {
+    return x86_decode(bytes, length, insn) == X86_DECODE_OK && insn->length == length;
+}
+
+// [67] [F2/F3] [66] [REX.W] 操作码
+static size_t encode(uint8_t *bytes, uint8_t opcode, uint8_t size, uint8_t rep, bool address32) {
+    size_t length = 0;
+    if (address32) {
+        bytes[length++] = 0x67;
+    }
+    if (rep) {
+        bytes[length++] = rep;
+    }
+    if (size == 2) {
+        bytes[length++] = 0x66;
+    } else if (size == 8) {
+        bytes[length++] = 0x48;
+    }
+    bytes[length++] = size == 1 ? opcode : (uint8_t)(opcode | 1);
+    return length;
+}
+
+// MARK: - 参考实现
+
+// 逐元素执行：每个元素都经 box64_mmu_load/store，比较类指令每个元素都记录一次标志
+static Box64StringStatus reference_execute(Box64Context *ctx, const X86DecodedInsn *insn, uint64_t *fault_address) {
+    const uint8_t base = insn->opcode & ~1u;
+    const uint8_t size = insn->operand_size;
+    const int64_t step = (ctx->rflags & X86_FLAG_DF) ? -(int64_t)size : (int64_t)size;
+    const bool rep = (insn->prefixes & (X86_PREFIX_REP | X86_PREFIX_REPNE)) != 0;
+    const bool repne = (insn->prefixes & X86_PREFIX_REPNE) != 0;
+    const uint64_t mask = insn->address_size == 4 ? 0xFFFFFFFFULL : ~0ULL;
+    const uint64_t size_mask = box64_size_mask(size);
+    const uint64_t acc = ctx->x86_regs[REG_RAX] & size_mask;
+    uint64_t *regs = ctx->x86_regs;
+    uint64_t count = rep ? regs[REG_RCX] & mask : 1;
+
+    while (count > 0) {
+        const uint64_t si = regs[REG_RSI] & mask, di = regs[REG_RDI] & mask;
+        uint64_t src = 0, dst = 0;
+        bool compared = false;
+        if ((base == 0xA4 || base == 0xA6 || base == 0xAC) && !box64_mmu_load(&ctx->mmu, si, size, &src)) {
+            *fault_address = si;
+            return BOX64_STRING_FAULT;
+        }
+        switch (base) {
+            case 0xA4:
+            case 0xAA:
+                if (!box64_mmu_store(&ctx->mmu, di, size, base == 0xA4 ? src : acc)) {
+                    *fault_address = di;
+                    return BOX64_STRING_FAULT;
+                }
+                break;
+            case 0xAC:
+                box64_write_gpr(ctx, REG_RAX, src, size, true);
+                break;
+            default:
+                if (!box64_mmu_load(&ctx->mmu, di, size, &dst)) {
+                    *fault_address = di;
+                    return BOX64_STRING_FAULT;
+                }
+                if (base == 0xAE) {
+                    src = acc;
+                }
+                box64_flags_record(ctx, BOX64_FLAGS_SUB, src, dst, (src - dst) & size_mask, size);
+                compared = true;
+                break;
+        }
+        if (base != 0xAA && base != 0xAE) {
+            regs[REG_RSI] = (si + (uint64_t)step) & mask;
+        }
+        if (base != 0xAC) {
+            regs[REG_RDI] = (di + (uint64_t)step) & mask;
+        }
+        count--;
+        if (rep) {
+            regs[REG_RCX] = count;
+        }
+        if (compared && rep && ((src == dst) == repne)) {
+            break;
+        }
+    }
+    return BOX64_STRING_OK;
+}
+
+// MARK: - 随机对照
+
+typedef struct Snapshot {
+    uint64_t regs[16];
+    uint64_t rflags;
+    uint8_t data[DATA_SIZE];
+} Snapshot;
+
+static void take_snapshot(Box64Context *ctx, Snapshot *snapshot) {
+    memcpy(snapshot->regs, ctx->x86_regs, sizeof(snapshot->regs));
+    snapshot->rflags = box64_flags_materialize(ctx);
+    box64_mmu_copy_from_guest(&ctx->mmu, snapshot->data, DATA_BASE, DATA_SIZE);
+}
+
+static void restore_snapshot(Box64Context *ctx, const Snapshot *snapshot) {
+    memcpy(ctx->x86_regs, snapshot->regs, sizeof(snapshot->regs));
+    box64_flags_set(ctx, snapshot->rflags);
+    box64_mmu_copy_to_guest(&ctx->mmu, DATA_BASE, snapshot->data, DATA_SIZE);
+}
+
+// 大部分为0、偶尔夹杂少量取值，REPE/REPNE 既有长段也有很快停下的情形
+static void fill_pattern(Box64Context *ctx) {
+    static uint8_t data[DATA_SIZE];
+    for (uint64_t k = 0; k < DATA_SIZE; k++) {
+        const uint64_t r = next_random();
+        data[k] = (r & 63) == 0 ? (uint8_t)(1 + (r >> 8) % 3) : 0;
+    }
+    box64_mmu_copy_to_guest(&ctx->mmu, DATA_BASE, data, DATA_SIZE);
+}
+
+// 在数据区内为 count 个元素选一个起始地址（按方向，整段不出数据区）
+static uint64_t pick_address(uint64_t count, uint8_t size, bool down) {
+    const uint64_t span = count * size;
+    const uint64_t room = DATA_SIZE - (span ? span : size);
+    const uint64_t offset = next_random() % (room + 1);
+    return down ? DATA_BASE + offset + (span ? span - size : 0) : DATA_BASE + offset;
+}
+
+static const uint8_t random_opcodes[] = { 0xA4, 0xA6, 0xAA, 0xAC, 0xAE };
+static const uint8_t random_sizes[] = { 1, 2, 4, 8 };
+static const uint8_t random_prefixes[] = { 0, 0xF3, 0xF2 };
+
+static void test_random(Guest *guest) {
+    Box64Context *ctx = guest->ctx;
+    static Snapshot before, expected;
+    int compared = 0;
+
+    for (int n = 0; n < RANDOM_CASES; n++) {
+        const uint8_t opcode = random_opcodes[next_random() % sizeof(random_opcodes)];
+        const uint8_t size = random_sizes[next_random() % sizeof(random_sizes)];
+        const uint8_t rep = random_prefixes[next_random() % sizeof(random_prefixes)];
+        const bool address32 = next_random() % 4 == 0;
+        const bool down = next_random() % 2;
+        const uint64_t limit = (n % 8 == 0) ? DATA_SIZE / size : 300;
+        const uint64_t count = next_random() % (limit + 1);
+
+        uint8_t bytes[8];
+        X86DecodedInsn insn;
+        const size_t length = encode(bytes, opcode, size, rep, address32);
+        if (!decode(bytes, length, &insn)) {
+            CHECK(false, "decode failed for %02X size %u", opcode, size);
+            continue;
+        }
+
+        fill_pattern(ctx);
+        const uint64_t high = address32 ? next_random() << 32 : 0;
+        uint64_t si = pick_address(count, size, down);
+        uint64_t di = pick_address(count, size, down);
+        if (opcode == 0xA4 && next_random() % 2) {
+            // 近距离重叠（含元素内重叠）
+            const int64_t delta = (int64_t)(next_random() % 41) - 20;
+            di = si + (uint64_t)delta;
+            const uint64_t span = count * size;
+            const uint64_t low = down ? di - (span ? span - size : 0) : di;
+            if (low < DATA_BASE || low + (span ? span : size) > DATA_BASE + DATA_SIZE) {
+                di = si;
+            }
+        } else if (opcode == 0xA6 && next_random() % 2) {
+            // 让两段大部分相同，只在一处不同
+            uint8_t chunk[DATA_SIZE];
+            const uint64_t span = count * size;
+            const uint64_t src_low = down ? si - (span ? span - size : 0) : si;
+            const uint64_t dst_low = down ? di - (span ? span - size : 0) : di;
+            if (span && box64_mmu_copy_from_guest(&ctx->mmu, chunk, src_low, span)) {
+                chunk[next_random() % span] ^= 0x5A;
+                box64_mmu_copy_to_guest(&ctx->mmu, dst_low, chunk, span);
+            }
+        }
+
+        ctx->x86_regs[REG_RSI] = high | si;
+        ctx->x86_regs[REG_RDI] = high | di;
+        ctx->x86_regs[REG_RCX] = (address32 ? next_random() << 32 : 0) | count;
+        ctx->x86_regs[REG_RAX] = (next_random() % 4 == 0) ? next_random() % 4 : 0;
+        box64_flags_set(ctx, 0x202 | (down ? X86_FLAG_DF : 0));
+
+        take_snapshot(ctx, &before);
+        uint64_t expected_fault = 0, fault = 0;
+        const Box64StringStatus expected_status = reference_execute(ctx, &insn, &expected_fault);
+        take_snapshot(ctx, &expected);
+        restore_snapshot(ctx, &before);
+        const Box64StringStatus status = box64_string_execute(ctx, &insn, &fault);
+
+        CHECK(status == expected_status && fault == expected_fault,
+              "case %d (%02X size %u rep %02X a32 %d df %d n %llu): status %d/%d fault 0x%llx/0x%llx",
+              n, opcode, size, rep, address32, down, (unsigned long long)count, status, expected_status,
+              (unsigned long long)fault, (unsigned long long)expected_fault);
+        CHECK(memcmp(ctx->x86_regs, expected.regs, sizeof(expected.regs)) == 0,
+              "case %d (%02X size %u rep %02X a32 %d df %d n %llu): RSI 0x%llx/0x%llx RDI 0x%llx/0x%llx RCX 0x%llx/0x%llx RAX 0x%llx/0x%llx",
+              n, opcode, size, rep, address32, down, (unsigned long long)count,
+              (unsigned long long)ctx->x86_regs[REG_RSI], (unsigned long long)expected.regs[REG_RSI],
+              (unsigned long long)ctx->x86_regs[REG_RDI], (unsigned long long)expected.regs[REG_RDI],
+              (unsigned long long)ctx->x86_regs[REG_RCX], (unsigned long long)expected.regs[REG_RCX],
+              (unsigned long long)ctx->x86_regs[REG_RAX], (unsigned long long)expected.regs[REG_RAX]);
+        CHECK(box64_flags_materialize(ctx) == expected.rflags, "case %d (%02X size %u rep %02X): rflags 0x%llx/0x%llx",
+              n, opcode, size, rep, (unsigned long long)box64_flags_materialize(ctx), (unsigned long long)expected.rflags);
+        take_snapshot(ctx, &before);
+        CHECK(memcmp(before.data, expected.data, DATA_SIZE) == 0, "case %d (%02X size %u rep %02X df %d n %llu): memory differs",
+              n, opcode, size, rep, down, (unsigned long long)count);
+        compared++;
+        if (failures > 20) {
+            break;
+        }
+    }
+    printf("[StringTest] 随机对照 %d 例\n", compared);
+}
+
+// MARK: - 单项
+
+static Box64StringStatus run_bytes(Box64Context *ctx, const uint8_t *bytes, size_t length, uint64_t *fault) {
+    X86DecodedInsn insn;
+    if (!decode(bytes, length, &insn)) {
+        return BOX64_STRING_UNSUPPORTED;
+    }
+    return box64_string_execute(ctx, &insn, fault);
+}
+
+static void test_support(void) {
+    static const struct { uint8_t bytes[4]; uint8_t length; bool supported; } cases[] = {
+        { { 0xA4 }, 1, true },                  // movsb
+        { { 0xF3, 0x48, 0xA5 }, 3, true },      // rep movsq
+        { { 0xF2, 0xAE }, 2, true },            // repne scasb
+        { { 0x66, 0xAB }, 2, true },            // stosw
+        { { 0xA8, 0x01 }, 2, false },           // test al, 1
+        { { 0x66, 0xA9, 0, 0 }, 4, false },     // test ax, imm16
+        { { 0x64, 0xA4 }, 2, false },           // fs: movsb
+        { { 0x0F, 0xA4, 0xC0, 0x01 }, 4, false } // shld
+    };
+    for (size_t n = 0; n < sizeof(cases) / sizeof(cases[0]); n++) {
+        X86DecodedInsn insn;
+        if (x86_decode(cases[n].bytes, cases[n].length, &insn) != X86_DECODE_OK) {
+            CHECK(false, "support case %zu: decode failed", n);
+            continue;
+        }
+        CHECK(box64_string_supported(&insn) == cases[n].supported, "support case %zu: expected %d", n, cases[n].supported);
+    }
+}
+
+static void test_overlap(Box64Context *ctx) {
+    // 前向 dst = src + 1：逐元素复制会把首字节铺满整段
+    const char text[] = "ABCDEFGHIJKLMNOP";
+    box64_mmu_copy_to_guest(&ctx->mmu, DATA_BASE, text, 16);
+    ctx->x86_regs[REG_RSI] = DATA_BASE;
+    ctx->x86_regs[REG_RDI] = DATA_BASE + 1;
+    ctx->x86_regs[REG_RCX] = 15;
+    box64_flags_set(ctx, 0x202);
+    const uint8_t rep_movsb[] = { 0xF3, 0xA4 };
+    CHECK(run_bytes(ctx, rep_movsb, sizeof(rep_movsb), NULL) == BOX64_STRING_OK, "overlap movsb status");
+    char result[17] = { 0 };
+    box64_mmu_copy_from_guest(&ctx->mmu, result, DATA_BASE, 16);
+    CHECK(strcmp(result, "AAAAAAAAAAAAAAAA") == 0, "overlap forward: %s", result);
+
+    // 反向（DF=1）dst = src + 4 的 MOVSD：等同于 memmove
+    box64_mmu_copy_to_guest(&ctx->mmu, DATA_BASE, text, 16);
+    ctx->x86_regs[REG_RSI] = DATA_BASE + 8;
+    ctx->x86_regs[REG_RDI] = DATA_BASE + 12;
+    ctx->x86_regs[REG_RCX] = 3;
+    box64_flags_set(ctx, 0x202 | X86_FLAG_DF);
+    const uint8_t rep_movsd[] = { 0xF3, 0xA5 };
+    CHECK(run_bytes(ctx, rep_movsd, sizeof(rep_movsd), NULL) == BOX64_STRING_OK, "overlap movsd status");
+    box64_mmu_copy_from_guest(&ctx->mmu, result, DATA_BASE, 16);
+    CHECK(strcmp(result, "ABCDABCDEFGHIJKL") == 0 && ctx->x86_regs[REG_RSI] == DATA_BASE - 4 &&
+          ctx->x86_regs[REG_RDI] == DATA_BASE && ctx->x86_regs[REG_RCX] == 0,
+          "overlap backward: %s rsi 0x%llx rdi 0x%llx", result,
+          (unsigned long long)ctx->x86_regs[REG_RSI], (unsigned long long)ctx->x86_regs[REG_RDI]);
+    box64_flags_set(ctx, 0x202);
+}
+
+static void test_strlen(Box64Context *ctx) {
+    // repne scasb，AL=0，RCX=-1：长度为 ~RCX - 1，ZF=1
+    const char text[] = "hello, world";
+    box64_mmu_copy_to_guest(&ctx->mmu, DATA_BASE + 0x100, text, sizeof(text));
+    ctx->x86_regs[REG_RDI] = DATA_BASE + 0x100;
+    ctx->x86_regs[REG_RCX] = ~0ULL;
+    ctx->x86_regs[REG_RAX] = 0;
+    box64_flags_set(ctx, 0x202);
+    const uint8_t repne_scasb[] = { 0xF2, 0xAE };
+    CHECK(run_bytes(ctx, repne_scasb, sizeof(repne_scasb), NULL) == BOX64_STRING_OK, "strlen status");
+    CHECK(~ctx->x86_regs[REG_RCX] - 1 == strlen(text) && ctx->x86_regs[REG_RDI] == DATA_BASE + 0x100 + sizeof(text),
+          "strlen: rcx 0x%llx rdi 0x%llx", (unsigned long long)ctx->x86_regs[REG_RCX],
+          (unsigned long long)ctx->x86_regs[REG_RDI]);
+    CHECK(box64_flags_condition(ctx, 0x4), "strlen: ZF not set");
+}
+
+static void test_fault(Guest *guest) {
+    Box64Context *ctx = guest->ctx;
+    // rep stosd 从数据区末尾写进未映射页：缺页时已写的元素保留，寄存器指向出错元素
+    const uint64_t start = HOLE_PAGE - 0x100;
+    ctx->x86_regs[REG_RDI] = start;
+    ctx->x86_regs[REG_RCX] = 0x80;
+    ctx->x86_regs[REG_RAX] = 0x11223344;
+    box64_flags_set(ctx, 0x202);
+    const uint8_t rep_stosd[] = { 0xF3, 0xAB };
+    uint64_t fault = 0;
+    CHECK(run_bytes(ctx, rep_stosd, sizeof(rep_stosd), &fault) == BOX64_STRING_FAULT && fault == HOLE_PAGE,
+          "stosd fault: 0x%llx", (unsigned long long)fault);
+    CHECK(ctx->x86_regs[REG_RDI] == HOLE_PAGE && ctx->x86_regs[REG_RCX] == 0x40,
+          "stosd fault: rdi 0x%llx rcx 0x%llx", (unsigned long long)ctx->x86_regs[REG_RDI],
+          (unsigned long long)ctx->x86_regs[REG_RCX]);
+    uint32_t last = 0;
+    box64_mmu_copy_from_guest(&ctx->mmu, &last, HOLE_PAGE - 4, 4);
+    CHECK(last == 0x11223344, "stosd fault: completed elements lost (0x%08X)", last);
+
+    // 映射后从同一条指令重新执行，接着做完剩余部分
+    CHECK(box64_mmu_map(&ctx->mmu, HOLE_PAGE, BOX64_PAGE_SIZE, BOX64_PROT_READ | BOX64_PROT_WRITE), "map hole page");
+    CHECK(run_bytes(ctx, rep_stosd, sizeof(rep_stosd), NULL) == BOX64_STRING_OK && ctx->x86_regs[REG_RCX] == 0 &&
+          ctx->x86_regs[REG_RDI] == start + 0x200, "stosd resume: rcx 0x%llx", (unsigned long long)ctx->x86_regs[REG_RCX]);
+    box64_mmu_copy_from_guest(&ctx->mmu, &last, start + 0x1FC, 4);
+    CHECK(last == 0x11223344, "stosd resume: last element 0x%08X", last);
+
+    // 元素本身跨进未映射页的 movsq：一个元素都不完成
+    box64_mmu_unmap(&ctx->mmu, HOLE_PAGE, BOX64_PAGE_SIZE);
+    ctx->x86_regs[REG_RSI] = HOLE_PAGE - 4;
+    ctx->x86_regs[REG_RDI] = DATA_BASE;
+    ctx->x86_regs[REG_RCX] = 4;
+    const uint8_t rep_movsq[] = { 0xF3, 0x48, 0xA5 };
+    CHECK(run_bytes(ctx, rep_movsq, sizeof(rep_movsq), &fault) == BOX64_STRING_FAULT && fault == HOLE_PAGE - 4 &&
+          ctx->x86_regs[REG_RCX] == 4 && ctx->x86_regs[REG_RSI] == HOLE_PAGE - 4,
+          "movsq cross-page fault: 0x%llx rcx %llu", (unsigned long long)fault, (unsigned long long)ctx->x86_regs[REG_RCX]);
+}
+
+// MARK: - 解释器
+
+// 与 bench_box64_interp.c 相同的块查找/链接方式
+static Box64InterpExit run_threaded(Guest *guest, uint32_t max_instructions, Box64InterpResult *result) {
+    Box64Context *ctx = guest->ctx;
+    const Box64InterpBounds bounds = {
+        guest->cache, CODE_BASE, CODE_BASE + guest->code_length, max_instructions, 0, NULL
+    };
+    Box64Block *previous = NULL;
+    Box64BlockEdge edge = BOX64_EDGE_FALLTHROUGH;
+
+    for (;;) {
+        const uint64_t rip = ctx->rip;
+        if (rip < CODE_BASE || rip >= CODE_BASE + guest->code_length) {
+            return BOX64_INTERP_BLOCK_END;
+        }
+        Box64Block *block = previous ? box64_tc_follow(guest->cache, previous, edge, rip) : NULL;
+        if (!block) {
+            block = box64_tc_lookup(guest->cache, rip);
+            if (!block) {
+                block = box64_tc_translate(guest->cache, rip, guest->code + (rip - CODE_BASE),
+                                           guest->code_length - (size_t)(rip - CODE_BASE), NULL);
+                if (!block) {
+                    return BOX64_INTERP_FALLBACK;
+                }
+            }
+            if (previous) {
+                box64_tc_link(previous, edge, block);
+            }
+        }
+        box64_block_count_exec(block);
+
+        Box64InterpExit exit = box64_interp_run(ctx, &bounds, block, 0, result);
+        if (exit != BOX64_INTERP_BLOCK_END) {
+            return exit;
+        }
+        previous = result->block;
+        edge = ctx->rip == previous->successor_rip[BOX64_EDGE_FALLTHROUGH] ? BOX64_EDGE_FALLTHROUGH : BOX64_EDGE_TAKEN;
+    }
+}
+
+//   mov rdi, BENCH_BASE
+//   mov ecx, N
+//   mov eax, 'A'
+//   cld
+//   rep stosb
+//   mov rsi, BENCH_BASE
+//   mov rdi, BENCH_BASE + BENCH_BYTES
+//   mov ecx, N
+//   rep movsb
+//   mov rdi, BENCH_BASE + BENCH_BYTES
+//   xor eax, eax
+//   mov rcx, -1
+//   repne scasb
+//   ret
+static void build_program(Guest *guest, uint32_t length) {
+    const uint8_t program[] = {
+        0x48, 0xC7, 0xC7, 0, 0, 0, 0,
+        0xB9, 0, 0, 0, 0,
+        0xB8, 0x41, 0, 0, 0,
+        0xFC,
+        0xF3, 0xAA,
+        0x48, 0xC7, 0xC6, 0, 0, 0, 0,
+        0x48, 0xC7, 0xC7, 0, 0, 0, 0,
+        0xB9, 0, 0, 0, 0,
+        0xF3, 0xA4,
+        0x48, 0xC7, 0xC7, 0, 0, 0, 0,
+        0x31, 0xC0,
+        0x48, 0xC7, 0xC1, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xF2, 0xAE,
+        0xC3
+    };
+    const uint32_t source = (uint32_t)BENCH_BASE, destination = (uint32_t)(BENCH_BASE + BENCH_BYTES);
+    memcpy(guest->code, program, sizeof(program));
+    memcpy(guest->code + 3, &source, 4);
+    memcpy(guest->code + 8, &length, 4);
+    memcpy(guest->code + 23, &source, 4);
+    memcpy(guest->code + 30, &destination, 4);
+    memcpy(guest->code + 35, &length, 4);
+    memcpy(guest->code + 44, &destination, 4);
+    guest->code_length = sizeof(program);
+    box64_tc_flush(guest->cache);
+}
+
+static Box64InterpExit run_program(Guest *guest, Box64InterpResult *result) {
+    Box64Context *ctx = guest->ctx;
+    // 先置 DF，程序里的 CLD 必须清掉它
+    box64_flags_set(ctx, 0x202 | X86_FLAG_DF);
+    ctx->stack_base = STACK_BASE;
+    ctx->stack_size = STACK_SIZE;
+    ctx->x86_regs[BOX64_INTERP_REG_RSP] = STACK_BASE + STACK_SIZE - 64;
+    ctx->rip = CODE_BASE;
+    ctx->instruction_count = 0;
+    return run_threaded(guest, UINT32_MAX, result);
+}
+
+static void test_interpreter(Guest *guest) {
+    Box64Context *ctx = guest->ctx;
+    const uint32_t length = 1000;
+    Box64InterpResult result;
+    box64_mmu_copy_to_guest(&ctx->mmu, BENCH_BASE + BENCH_BYTES + length, "", 1);
+    build_program(guest, length);
+    const Box64InterpExit exit = run_program(guest, &result);
+    CHECK(exit == BOX64_INTERP_RETURN && ctx->instruction_count == 14, "string program exit %d, %llu instructions",
+          exit, (unsigned long long)ctx->instruction_count);
+    CHECK(~ctx->x86_regs[REG_RCX] - 1 == length, "string program: strlen %llu",
+          (unsigned long long)(~ctx->x86_regs[REG_RCX] - 1));
+    CHECK((ctx->rflags & X86_FLAG_DF) == 0, "string program: CLD did not clear DF");
+    uint8_t copied[1000];
+    box64_mmu_copy_from_guest(&ctx->mmu, copied, BENCH_BASE + BENCH_BYTES, length);
+    bool all_a = true;
+    for (uint32_t k = 0; k < length; k++) {
+        all_a &= copied[k] == 'A';
+    }
+    CHECK(all_a, "string program: copied data wrong");
+}
+
+// MARK: - 基准
+
+typedef struct BenchCase {
+    const char *name;
+    uint8_t bytes[4];
+    uint8_t length;
+    uint8_t size;
+} BenchCase;
+
+static const BenchCase bench_cases[] = {
+    { "rep movsb",   { 0xF3, 0xA4 }, 2, 1 },
+    { "rep movsq",   { 0xF3, 0x48, 0xA5 }, 3, 8 },
+    { "rep stosd",   { 0xF3, 0xAB }, 2, 4 },
+    { "repne scasb", { 0xF2, 0xAE }, 2, 1 },
+    { "repe cmpsb",  { 0xF3, 0xA6 }, 2, 1 }
+};
+
+static double bench_run(Box64Context *ctx, const X86DecodedInsn *insn, uint8_t size, int rounds, bool bulk) {
+    const double start = now_seconds();
+    for (int round = 0; round < rounds; round++) {
+        ctx->x86_regs[REG_RSI] = BENCH_BASE;
+        ctx->x86_regs[REG_RDI] = BENCH_BASE + BENCH_BYTES;
+        ctx->x86_regs[REG_RCX] = BENCH_BYTES / size;
+        ctx->x86_regs[REG_RAX] = 0x7F;
+        uint64_t fault = 0;
+        const Box64StringStatus status = bulk ? box64_string_execute(ctx, insn, &fault) : reference_execute(ctx, insn, &fault);
+        if (status != BOX64_STRING_OK || ctx->x86_regs[REG_RCX] != 0) {
+            CHECK(false, "bench (bulk %d): status %d rcx %llu", bulk, status, (unsigned long long)ctx->x86_regs[REG_RCX]);
+            break;
+        }
+    }
+    return (now_seconds() - start) * 1e9 / ((double)rounds * (double)BENCH_BYTES);
+}
+
+static void bench(Guest *guest) {
+    Box64Context *ctx = guest->ctx;
+    box64_flags_set(ctx, 0x202);
+    printf("[StringTest] 基准：每次 %llu KiB，整段执行 vs 逐元素经MMU\n", (unsigned long long)(BENCH_BYTES / 1024));
+    for (size_t n = 0; n < sizeof(bench_cases) / sizeof(bench_cases[0]); n++) {
+        const BenchCase *bench_case = &bench_cases[n];
+        X86DecodedInsn insn;
+        decode(bench_case->bytes, bench_case->length, &insn);
+        // 两段内容相同且不含 0x7F，REPE/REPNE 都会跑完整段
+        box64_mmu_copy_to_guest(&ctx->mmu, BENCH_BASE + BENCH_BYTES, guest->backing + BENCH_BASE, BENCH_BYTES);
+        const double bulk = bench_run(ctx, &insn, bench_case->size, BENCH_ROUNDS, true);
+        const double element = bench_run(ctx, &insn, bench_case->size, REFERENCE_ROUNDS, false);
+        printf("[StringTest]   %-12s 整段 %.3f ns/字节  逐元素 %.3f ns/字节  加速比 %.1fx\n",
+               bench_case->name, bulk, element, element / bulk);
+    }
+}
+
+int main(void) {
+    Guest guest;
+    if (!guest_create(&guest)) {
+        printf("[StringTest] ❌ guest setup failed\n");
+        return 1;
+    }
+
+    test_support();
+    test_random(&guest);
+    test_overlap(guest.ctx);
+    test_strlen(guest.ctx);
+    test_fault(&guest);
+    test_interpreter(&guest);
+    bench(&guest);
+
+    guest_destroy(&guest);
+    if (failures) {
+        printf("[StringTest] ❌ %d checks failed\n", failures);
+        return 1;
+    }
+    printf("[StringTest] ✅ all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,626 @@
+// test_box64_thread.c - 客户机线程、同步原语和共享翻译缓存的多线程校验
+// 纯C，Linux上直接编译运行:
+//   ./run_portable_tests.sh test_box64_thread
+// 先单独检查 CRITICAL_SECTION 语义的互斥量、事件、写者优先的读写锁和线程生命周期（挂起/恢复/退出码），
+// 再检查MMU视图在页表修改后的TLB同步，最后让几个线程在同一个翻译缓存上按引擎的加锁方式解释执行，
+// 同时另一个线程不停地失效整个代码区，结果必须与单线程一致；末尾比较无竞争加解锁与 pthread_mutex 的开销
+#include "Box64Sync.h"
+#include "Box64Thread.h"
+#include "Box64Interp.h"
+#include "Box64Flags.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+
+#define GUEST_SIZE      (1024 * 1024)
+#define CODE_BASE       0x1000ULL
+#define DATA_BASE       0x8000ULL
+#define STACK_BASE      0xC0000ULL
+#define STACK_SIZE      0x10000ULL
+#define STACK_PER_WORKER 0x2000ULL
+
+#define MUTEX_THREADS   4
+#define MUTEX_ROUNDS    100000
+#define WORKERS         4
+#define WORKER_RUNS     300
+#define BENCH_ROUNDS    5000000
+
+#define REG_RAX         0
+#define REG_RSP         4
+
+static int failures = 0;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { printf("[ThreadTest] ❌ " __VA_ARGS__); printf("\n"); failures++; } \
+} while (0)
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static void sleep_ms(unsigned milliseconds) {
+    usleep(milliseconds * 1000u);
+}
+
+// MARK: - 互斥量
+
+typedef struct MutexShared {
+    Box64Mutex mutex;
+    uint64_t counter;                   // 只在持锁时修改
+    uint32_t recursion_errors;
+} MutexShared;
+
+typedef struct MutexWorker {
+    MutexShared *shared;
+    uint32_t id;
+} MutexWorker;
+
+static void *mutex_worker(void *argument) {
+    MutexWorker *worker = argument;
+    MutexShared *shared = worker->shared;
+    for (uint32_t i = 0; i < MUTEX_ROUNDS; i++) {
+        box64_mutex_lock(&shared->mutex, worker->id);
+        // 每16次重入一次，重入后计数器仍由同一个持有者修改
+        if ((i & 15) == 0) {
+            box64_mutex_lock(&shared->mutex, worker->id);
+            shared->counter++;
+            if (!box64_mutex_unlock(&shared->mutex, worker->id)) {
+                shared->recursion_errors++;
+            }
+        } else {
+            shared->counter++;
+        }
+        box64_mutex_unlock(&shared->mutex, worker->id);
+    }
+    return NULL;
+}
+
+static void test_mutex(void) {
+    MutexShared shared;
+    memset(&shared, 0, sizeof(shared));
+    box64_mutex_init(&shared.mutex, BOX64_MUTEX_DEFAULT_SPIN);
+
+    // 单线程语义：重入、非持有者解锁失败、其他线程 try 失败
+    CHECK(box64_mutex_trylock(&shared.mutex, 0x100), "trylock on free mutex");
+    CHECK(box64_mutex_trylock(&shared.mutex, 0x100), "recursive trylock");
+    CHECK(!box64_mutex_trylock(&shared.mutex, 0x104), "trylock by another thread must fail");
+    CHECK(!box64_mutex_unlock(&shared.mutex, 0x104), "unlock by non-owner must fail");
+    CHECK(box64_mutex_unlock(&shared.mutex, 0x100) && atomic_load(&shared.mutex.owner) == 0x100,
+          "first unlock keeps ownership");
+    CHECK(box64_mutex_unlock(&shared.mutex, 0x100) && atomic_load(&shared.mutex.owner) == 0, "second unlock releases");
+    CHECK(!box64_mutex_unlock(&shared.mutex, 0x100), "unlock of free mutex must fail");
+
+    // 限时加锁：持有者不放时超时且不取得锁，放开后立即取得
+    CHECK(box64_mutex_lock_timed(&shared.mutex, 0x100, 0), "timed lock on free mutex");
+    CHECK(!box64_mutex_lock_timed(&shared.mutex, 0x104, 20), "timed lock on held mutex must time out");
+    CHECK(atomic_load(&shared.mutex.owner) == 0x100, "timed-out lock changed the owner");
+    CHECK(box64_mutex_unlock(&shared.mutex, 0x100), "unlock after timed-out waiter");
+    CHECK(box64_mutex_lock_timed(&shared.mutex, 0x104, 20) && box64_mutex_unlock(&shared.mutex, 0x104),
+          "timed lock after release");
+
+    pthread_t threads[MUTEX_THREADS];
+    MutexWorker workers[MUTEX_THREADS];
+    for (uint32_t i = 0; i < MUTEX_THREADS; i++) {
+        workers[i] = (MutexWorker){ &shared, 0x200 + i * 4 };
+        pthread_create(&threads[i], NULL, mutex_worker, &workers[i]);
+    }
+    for (uint32_t i = 0; i < MUTEX_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    CHECK(shared.counter == (uint64_t)MUTEX_THREADS * MUTEX_ROUNDS, "contended counter %llu",
+          (unsigned long long)shared.counter);
+    CHECK(shared.recursion_errors == 0, "%u recursive unlocks failed", shared.recursion_errors);
+    CHECK(atomic_load(&shared.mutex.state) == 0 && atomic_load(&shared.mutex.owner) == 0, "mutex left held");
+}
+
+// MARK: - 事件
+
+typedef struct EventWaiter {
+    Box64Event *event;
+    uint32_t result;
+    double waited;
+} EventWaiter;
+
+static void *event_waiter(void *argument) {
+    EventWaiter *waiter = argument;
+    const double start = now_seconds();
+    waiter->result = box64_event_wait(waiter->event, BOX64_INFINITE);
+    waiter->waited = now_seconds() - start;
+    return NULL;
+}
+
+static void test_event(void) {
+    Box64Event event;
+    box64_event_init(&event, false, true);
+    CHECK(box64_event_wait(&event, 0) == BOX64_WAIT_OBJECT_0, "auto-reset: initial state");
+    CHECK(box64_event_wait(&event, 0) == BOX64_WAIT_TIMEOUT, "auto-reset: wait consumes the signal");
+
+    box64_event_init(&event, true, false);
+    CHECK(box64_event_wait(&event, 0) == BOX64_WAIT_TIMEOUT, "manual-reset: initially clear");
+    box64_event_set(&event);
+    CHECK(box64_event_wait(&event, 0) == BOX64_WAIT_OBJECT_0 && box64_event_wait(&event, 0) == BOX64_WAIT_OBJECT_0,
+          "manual-reset: stays signaled");
+    box64_event_reset(&event);
+    const double start = now_seconds();
+    const uint32_t timed = box64_event_wait(&event, 50);
+    const double elapsed = now_seconds() - start;
+    CHECK(timed == BOX64_WAIT_TIMEOUT && elapsed >= 0.045, "timeout: result 0x%x after %.1f ms", timed, elapsed * 1e3);
+
+    // 跨线程：等待者睡眠，set 唤醒全部（手动复位）
+    EventWaiter waiters[3];
+    pthread_t threads[3];
+    for (int i = 0; i < 3; i++) {
+        waiters[i] = (EventWaiter){ &event, BOX64_WAIT_FAILED, 0 };
+        pthread_create(&threads[i], NULL, event_waiter, &waiters[i]);
+    }
+    sleep_ms(20);
+    box64_event_set(&event);
+    for (int i = 0; i < 3; i++) {
+        pthread_join(threads[i], NULL);
+        CHECK(waiters[i].result == BOX64_WAIT_OBJECT_0 && waiters[i].waited >= 0.010,
+              "waiter %d: result 0x%x after %.1f ms", i, waiters[i].result, waiters[i].waited * 1e3);
+    }
+}
+
+// MARK: - 读写锁
+
+typedef struct RWShared {
+    Box64RWLock lock;
+    _Atomic uint32_t written;
+    _Atomic uint32_t reader_saw_write;
+    _Atomic uint32_t reader_done;
+} RWShared;
+
+static void *rw_writer(void *argument) {
+    RWShared *shared = argument;
+    box64_rwlock_write_lock(&shared->lock);
+    atomic_store(&shared->written, 1);
+    box64_rwlock_write_unlock(&shared->lock);
+    return NULL;
+}
+
+static void *rw_late_reader(void *argument) {
+    RWShared *shared = argument;
+    box64_rwlock_read_lock(&shared->lock);
+    atomic_store(&shared->reader_saw_write, atomic_load(&shared->written));
+    box64_rwlock_read_unlock(&shared->lock);
+    atomic_store(&shared->reader_done, 1);
+    return NULL;
+}
+
+static void test_rwlock(void) {
+    RWShared shared;
+    memset(&shared, 0, sizeof(shared));
+
+    // 写者优先：写者排队后，新来的读者要等它完成
+    box64_rwlock_read_lock(&shared.lock);
+    pthread_t writer, reader;
+    pthread_create(&writer, NULL, rw_writer, &shared);
+    while (!box64_rwlock_writer_pending(&shared.lock)) {
+        sched_yield();
+    }
+    pthread_create(&reader, NULL, rw_late_reader, &shared);
+    sleep_ms(20);
+    CHECK(!atomic_load(&shared.reader_done) && !atomic_load(&shared.written), "late reader overtook a pending writer");
+    CHECK(box64_rwlock_read_yield(&shared.lock), "read_yield must yield to the pending writer");
+    CHECK(atomic_load(&shared.written), "writer did not run during read_yield");
+    box64_rwlock_read_unlock(&shared.lock);
+    pthread_join(writer, NULL);
+    pthread_join(reader, NULL);
+    CHECK(atomic_load(&shared.reader_saw_write), "late reader ran before the writer");
+    CHECK(atomic_load(&shared.lock.state) == 0, "rwlock state 0x%x after writer test", atomic_load(&shared.lock.state));
+
+    // 降级：写锁直接换成读锁，其他读者可以同时进入，写者要等降级后的读锁释放
+    box64_rwlock_write_lock(&shared.lock);
+    box64_rwlock_write_downgrade(&shared.lock);
+    CHECK(atomic_load(&shared.lock.state) == 1, "downgraded state 0x%x", atomic_load(&shared.lock.state));
+    box64_rwlock_read_lock(&shared.lock);
+    atomic_store(&shared.written, 0);
+    pthread_create(&writer, NULL, rw_writer, &shared);
+    sleep_ms(10);
+    CHECK(!atomic_load(&shared.written), "writer entered while downgraded readers held the lock");
+    box64_rwlock_read_unlock(&shared.lock);
+    box64_rwlock_read_unlock(&shared.lock);
+    pthread_join(writer, NULL);
+    CHECK(atomic_load(&shared.written) && atomic_load(&shared.lock.state) == 0, "writer after downgrade");
+}
+
+// MARK: - 线程生命周期
+
+typedef struct ThreadProbe {
+    _Atomic uint32_t ran;
+    _Atomic uint32_t destroyed;
+    uint32_t seen_id;
+    Box64Thread *seen_thread;
+    void *seen_user;
+} ThreadProbe;
+
+static uint32_t probe_main(Box64Thread *thread, void *user) {
+    ThreadProbe *probe = user;
+    probe->seen_id = box64_thread_current_id();
+    probe->seen_thread = box64_thread_current();
+    probe->seen_user = box64_thread_user(thread);
+    atomic_store(&probe->ran, 1);
+    return 42;
+}
+
+static void probe_destroy(Box64Thread *thread, void *user) {
+    (void)thread;
+    atomic_store(&((ThreadProbe *)user)->destroyed, 1);
+}
+
+static void test_thread_lifecycle(void) {
+    const uint32_t main_id = box64_thread_current_id();
+    CHECK(main_id != 0 && main_id % 4 == 0 && box64_thread_current_id() == main_id && box64_thread_current() == NULL,
+          "host thread id %u", main_id);
+
+    ThreadProbe probe;
+    memset(&probe, 0, sizeof(probe));
+    Box64Thread *thread = box64_thread_create(probe_main, probe_destroy, &probe, true, 0);
+    CHECK(thread != NULL, "thread create");
+    if (!thread) {
+        return;
+    }
+    const uint32_t id = box64_thread_id(thread);
+    CHECK(id != main_id && id % 4 == 0, "thread id %u", id);
+    sleep_ms(20);
+    CHECK(!atomic_load(&probe.ran), "suspended thread ran");
+    CHECK(box64_thread_exit_code(thread) == BOX64_STILL_ACTIVE, "exit code before start");
+    CHECK(box64_thread_wait(thread, 10) == BOX64_WAIT_TIMEOUT, "wait on suspended thread must time out");
+    CHECK(box64_thread_live_count() == 1, "live count %u", box64_thread_live_count());
+
+    CHECK(box64_thread_resume(thread) == 1, "resume returns previous suspend count");
+    CHECK(box64_thread_wait(thread, BOX64_INFINITE) == BOX64_WAIT_OBJECT_0, "wait for exit");
+    CHECK(atomic_load(&probe.ran) && box64_thread_exit_code(thread) == 42, "exit code %u", box64_thread_exit_code(thread));
+    CHECK(probe.seen_id == id && probe.seen_thread == thread && probe.seen_user == &probe, "thread-local identity");
+    CHECK(box64_thread_resume(thread) == 0, "resume of a running thread returns 0");
+
+    // 线程自己的引用在 exited 置位后才释放，句柄引用释放后 destroy 最终被调用一次
+    box64_thread_release(thread);
+    for (int i = 0; i < 1000 && !atomic_load(&probe.destroyed); i++) {
+        sleep_ms(1);
+    }
+    CHECK(atomic_load(&probe.destroyed), "destroy callback not called");
+    CHECK(box64_thread_live_count() == 0, "live count %u after exit", box64_thread_live_count());
+}
+
+// MARK: - MMU视图
+
+static void test_mmu_views(void) {
+    uint8_t *backing = NULL;
+    if (posix_memalign((void **)&backing, BOX64_PAGE_SIZE, GUEST_SIZE) != 0) {
+        CHECK(false, "backing allocation");
+        return;
+    }
+    Box64MMU owner, view;
+    CHECK(box64_mmu_init(&owner, backing, GUEST_SIZE) && box64_mmu_attach(&view, &owner), "init/attach");
+    CHECK(box64_mmu_map(&view, DATA_BASE, 2 * BOX64_PAGE_SIZE, BOX64_PROT_READ | BOX64_PROT_WRITE),
+          "map through a view");
+    CHECK(owner.stats.mapped_pages == 2 && view.stats.mapped_pages == 0, "mapped pages counted on the owner");
+
+    // 视图先缓存翻译，所有者再取消映射：同步前可能命中旧TLB项，同步后必须缺页
+    CHECK(box64_mmu_store(&view, DATA_BASE, 8, 0x1122334455667788ULL), "store through view");
+    uint64_t value = 0;
+    CHECK(box64_mmu_load(&owner, DATA_BASE, 8, &value) && value == 0x1122334455667788ULL, "owner sees view store");
+    box64_mmu_unmap(&owner, DATA_BASE, BOX64_PAGE_SIZE);
+    box64_mmu_sync(&view);
+    CHECK(!box64_mmu_translate(&view, DATA_BASE, 8, BOX64_ACCESS_READ), "stale TLB entry survived sync");
+    CHECK(box64_mmu_translate(&view, DATA_BASE + BOX64_PAGE_SIZE, 8, BOX64_ACCESS_READ) != NULL,
+          "untouched page must stay mapped");
+
+    box64_mmu_destroy(&view);
+    CHECK(box64_mmu_translate(&owner, DATA_BASE + BOX64_PAGE_SIZE, 8, BOX64_ACCESS_READ) != NULL,
+          "destroying a view must not free the page table");
+    box64_mmu_destroy(&owner);
+    free(backing);
+}
+
+// MARK: - 共享翻译缓存
+
+//   mov ecx, N
+//   xor eax, eax
+// loop:
+//   add rax, rcx
+//   dec ecx
+//   jnz loop
+//   ret
+static const uint8_t sum_program[] = {
+    0xB9, 0, 0, 0, 0,
+    0x31, 0xC0,
+    0x48, 0x01, 0xC8,
+    0xFF, 0xC9,
+    0x75, 0xF9,
+    0xC3,
+};
+#define SUM_COUNT_OFFSET 1
+
+typedef struct SharedGuest {
+    uint8_t *backing;
+    Box64MMU mmu;
+    Box64TranslationCache *cache;
+    Box64RWLock gate;
+    uint8_t code[64];
+    size_t code_length;
+    _Atomic uint32_t stop;
+    _Atomic uint32_t invalidations;
+} SharedGuest;
+
+typedef struct Worker {
+    SharedGuest *guest;
+    Box64Context *ctx;
+    uint32_t index;
+    uint32_t count;
+    uint32_t mismatches;
+    uint32_t failures;
+} Worker;
+
+// 与 Box64Engine 的 translateBlockAt 相同：读锁换写锁，重新查找后再翻译/链接，最后降级
+static Box64Block *translate_locked(SharedGuest *guest, uint64_t rip, Box64Block *previous, Box64BlockEdge edge) {
+    const uint64_t previous_start = previous ? previous->guest_start : 0;
+    box64_rwlock_read_unlock(&guest->gate);
+    box64_rwlock_write_lock(&guest->gate);
+    Box64Block *block = box64_tc_lookup(guest->cache, rip);
+    if (!block) {
+        block = box64_tc_translate(guest->cache, rip, guest->code + (rip - CODE_BASE),
+                                   guest->code_length - (size_t)(rip - CODE_BASE), NULL);
+    }
+    if (block) {
+        box64_interp_prepare(block);
+        if (previous && previous->valid && previous->guest_start == previous_start) {
+            box64_tc_link(previous, edge, block);
+        }
+    }
+    box64_rwlock_write_downgrade(&guest->gate);
+    return block;
+}
+
+// 引擎执行循环的精简版：整段持有读锁，块边界是安全点
+static bool run_guarded(Worker *worker) {
+    SharedGuest *guest = worker->guest;
+    Box64Context *ctx = worker->ctx;
+    const uint64_t code_end = CODE_BASE + guest->code_length;
+    const Box64InterpBounds bounds = { guest->cache, CODE_BASE, code_end, UINT32_MAX, 0, &guest->gate };
+    Box64Block *previous = NULL;
+    Box64BlockEdge edge = BOX64_EDGE_FALLTHROUGH;
+    bool ok = false;
+
+    box64_rwlock_read_lock(&guest->gate);
+    for (;;) {
+        if (box64_rwlock_read_yield(&guest->gate)) {
+            previous = NULL;
+        }
+        box64_mmu_sync(&ctx->mmu);
+        const uint64_t rip = ctx->rip;
+        if (rip < CODE_BASE || rip >= code_end) {
+            break;
+        }
+        Box64Block *block = previous ? box64_tc_follow(guest->cache, previous, edge, rip) : NULL;
+        if (!block) {
+            block = box64_tc_lookup(guest->cache, rip);
+            const bool can_link = previous && previous->successor_rip[edge] == rip;
+            if (!block || can_link) {
+                block = translate_locked(guest, rip, can_link ? previous : NULL, edge);
+                if (!block) {
+                    break;
+                }
+            }
+        }
+        Box64InterpResult result;
+        const Box64InterpExit exit = box64_interp_run(ctx, &bounds, block, 0, &result);
+        if (exit == BOX64_INTERP_RETURN) {
+            ok = true;
+            break;
+        }
+        if (exit != BOX64_INTERP_BLOCK_END) {
+            break;
+        }
+        previous = result.block;
+        edge = ctx->rip == previous->successor_rip[BOX64_EDGE_FALLTHROUGH] ? BOX64_EDGE_FALLTHROUGH : BOX64_EDGE_TAKEN;
+    }
+    box64_rwlock_read_unlock(&guest->gate);
+    return ok;
+}
+
+static void *interp_worker(void *argument) {
+    Worker *worker = argument;
+    Box64Context *ctx = worker->ctx;
+    const uint64_t stack_top = STACK_BASE + (uint64_t)(worker->index + 1) * STACK_PER_WORKER - 16;
+    for (uint32_t run = 0; run < WORKER_RUNS; run++) {
+        ctx->stack_base = STACK_BASE + (uint64_t)worker->index * STACK_PER_WORKER;
+        ctx->stack_size = STACK_PER_WORKER;
+        ctx->x86_regs[REG_RSP] = stack_top;
+        ctx->rip = CODE_BASE;
+        ctx->instruction_count = 0;
+        if (!run_guarded(worker)) {
+            worker->failures++;
+            continue;
+        }
+        const uint64_t n = worker->count;
+        if (ctx->x86_regs[REG_RAX] != n * (n + 1) / 2) {
+            worker->mismatches++;
+        }
+    }
+    return NULL;
+}
+
+static void *invalidator(void *argument) {
+    SharedGuest *guest = argument;
+    while (!atomic_load(&guest->stop)) {
+        box64_rwlock_write_lock(&guest->gate);
+        box64_tc_invalidate_range(guest->cache, CODE_BASE, guest->code_length);
+        box64_rwlock_write_unlock(&guest->gate);
+        atomic_fetch_add(&guest->invalidations, 1);
+        sched_yield();
+    }
+    return NULL;
+}
+
+static void test_shared_cache(void) {
+    SharedGuest guest;
+    memset(&guest, 0, sizeof(guest));
+    guest.cache = box64_tc_create(64);
+    if (!guest.cache || posix_memalign((void **)&guest.backing, BOX64_PAGE_SIZE, GUEST_SIZE) != 0) {
+        CHECK(false, "shared guest allocation");
+        return;
+    }
+    memset(guest.backing, 0, GUEST_SIZE);
+    CHECK(box64_mmu_init(&guest.mmu, guest.backing, GUEST_SIZE) &&
+          box64_mmu_map(&guest.mmu, CODE_BASE, BOX64_PAGE_SIZE, BOX64_PROT_READ | BOX64_PROT_EXEC) &&
+          box64_mmu_map(&guest.mmu, STACK_BASE, STACK_SIZE, BOX64_PROT_READ | BOX64_PROT_WRITE), "shared guest setup");
+    memcpy(guest.code, sum_program, sizeof(sum_program));
+    guest.code_length = sizeof(sum_program);
+    const uint32_t count = 2000;
+    memcpy(guest.code + SUM_COUNT_OFFSET, &count, sizeof(count));
+
+    Worker workers[WORKERS];
+    pthread_t threads[WORKERS], invalidate_thread;
+    for (uint32_t i = 0; i < WORKERS; i++) {
+        Box64Context *ctx = calloc(1, sizeof(Box64Context));
+        workers[i] = (Worker){ &guest, ctx, i, count, 0, 0 };
+        CHECK(ctx && box64_mmu_attach(&ctx->mmu, &guest.mmu), "worker %u context", i);
+        box64_flags_set(ctx, 0x202);
+    }
+
+    const double start = now_seconds();
+    pthread_create(&invalidate_thread, NULL, invalidator, &guest);
+    for (uint32_t i = 0; i < WORKERS; i++) {
+        pthread_create(&threads[i], NULL, interp_worker, &workers[i]);
+    }
+    for (uint32_t i = 0; i < WORKERS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    atomic_store(&guest.stop, 1);
+    pthread_join(invalidate_thread, NULL);
+    const double elapsed = now_seconds() - start;
+
+    uint32_t mismatches = 0, run_failures = 0;
+    for (uint32_t i = 0; i < WORKERS; i++) {
+        mismatches += workers[i].mismatches;
+        run_failures += workers[i].failures;
+        box64_mmu_destroy(&workers[i].ctx->mmu);
+        free(workers[i].ctx);
+    }
+    CHECK(run_failures == 0, "%u runs failed", run_failures);
+    CHECK(mismatches == 0, "%u runs computed a wrong sum", mismatches);
+    CHECK(atomic_load(&guest.gate.state) == 0, "gate state 0x%x after workers", atomic_load(&guest.gate.state));
+    printf("[ThreadTest] 共享翻译缓存：%d 线程 × %d 次，期间失效 %u 次，%.1f ms\n",
+           WORKERS, WORKER_RUNS, atomic_load(&guest.invalidations), elapsed * 1e3);
+
+    box64_mmu_destroy(&guest.mmu);
+    box64_tc_destroy(guest.cache);
+    free(guest.backing);
+}
+
+// 读锁下的执行计数和查找统计：多个线程同时累加，不能丢
+#define COUNTER_ROUNDS  200000
+
+typedef struct CounterArgs {
+    Box64TranslationCache *cache;
+    Box64Block *block;
+    Box64RWLock *gate;
+} CounterArgs;
+
+static void *counter_worker(void *argument) {
+    CounterArgs *args = argument;
+    box64_rwlock_read_lock(args->gate);
+    for (uint32_t i = 0; i < COUNTER_ROUNDS; i++) {
+        box64_block_count_exec(args->block);
+        box64_tc_lookup(args->cache, CODE_BASE);
+    }
+    box64_rwlock_read_unlock(args->gate);
+    return NULL;
+}
+
+static void test_shared_counters(void) {
+    static const uint8_t ret = 0xC3;
+    Box64TranslationCache *cache = box64_tc_create(16);
+    Box64RWLock gate = { 0 };
+    X86DecodeStatus status;
+    Box64Block *block = box64_tc_translate(cache, CODE_BASE, &ret, 1, &status);
+    CHECK(block != NULL, "translate ret failed");
+    if (!block) {
+        box64_tc_destroy(cache);
+        return;
+    }
+
+    CounterArgs args = { cache, block, &gate };
+    pthread_t threads[WORKERS];
+    for (uint32_t i = 0; i < WORKERS; i++) {
+        pthread_create(&threads[i], NULL, counter_worker, &args);
+    }
+    for (uint32_t i = 0; i < WORKERS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    const uint64_t expected = (uint64_t)WORKERS * COUNTER_ROUNDS;
+    const uint64_t executed = atomic_load(&block->exec_count);
+    Box64TCStats stats;
+    box64_tc_get_stats(cache, &stats);
+    CHECK(executed == expected, "exec_count %llu, expected %llu", (unsigned long long)executed,
+          (unsigned long long)expected);
+    CHECK(stats.hits == expected, "tc hits %llu, expected %llu", (unsigned long long)stats.hits,
+          (unsigned long long)expected);
+    // 越过阈值的块仍然算热；编译失败或已有本机代码后不再算
+    CHECK(box64_block_is_hot(block, executed, 64), "block past the threshold must stay hot");
+    block->native_rejected = true;
+    CHECK(!box64_block_is_hot(block, executed, 64), "rejected block must not be retried");
+    box64_tc_destroy(cache);
+}
+
+// MARK: - 基准
+
+static void bench(void) {
+    Box64Mutex mutex;
+    box64_mutex_init(&mutex, BOX64_MUTEX_DEFAULT_SPIN);
+    const uint32_t id = box64_thread_current_id();
+    double start = now_seconds();
+    for (uint32_t i = 0; i < BENCH_ROUNDS; i++) {
+        box64_mutex_lock(&mutex, id);
+        box64_mutex_unlock(&mutex, id);
+    }
+    const double ours = (now_seconds() - start) * 1e9 / BENCH_ROUNDS;
+
+    pthread_mutexattr_t attributes;
+    pthread_mutexattr_init(&attributes);
+    pthread_mutexattr_settype(&attributes, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_t recursive;
+    pthread_mutex_init(&recursive, &attributes);
+    start = now_seconds();
+    for (uint32_t i = 0; i < BENCH_ROUNDS; i++) {
+        pthread_mutex_lock(&recursive);
+        pthread_mutex_unlock(&recursive);
+    }
+    const double theirs = (now_seconds() - start) * 1e9 / BENCH_ROUNDS;
+    pthread_mutex_destroy(&recursive);
+    pthread_mutexattr_destroy(&attributes);
+
+    Box64SyncStats stats;
+    box64_sync_get_stats(&stats);
+    printf("[ThreadTest] 无竞争加解锁：Box64Mutex %.1f ns  递归 pthread_mutex %.1f ns\n", ours, theirs);
+    printf("[ThreadTest] 等待队列：睡眠 %llu 次，唤醒 %llu 个，超时 %llu 次\n", (unsigned long long)stats.parks,
+           (unsigned long long)stats.wakes, (unsigned long long)stats.timeouts);
+}
+
+int main(void) {
+    test_mutex();
+    test_event();
+    test_rwlock();
+    test_thread_lifecycle();
+    test_mmu_views();
+    test_shared_cache();
+    test_shared_counters();
+    bench();
+
+    if (failures) {
+        printf("[ThreadTest] ❌ %d checks failed\n", failures);
+        return 1;
+    }
+    printf("[ThreadTest] ✅ all checks passed\n");
+    return 0;
+}
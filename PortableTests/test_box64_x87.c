@@ -0,0 +1,551 @@
+// test_box64_x87.c - x87 寄存器栈、两种精度模式的语义校验与吞吐基准
+// 纯C，Linux上直接编译运行:
+//   ./run_portable_tests.sh test_box64_x87
+// 先检查支持范围和访存宽度，再检查栈上溢/下溢、比较结果（C0-C3 与 FCOMI 的 RFLAGS）、
+// 整数存储的舍入与不定值、扩展精度与快速模式的差异（1 + 2^-60、m80 往返、精度控制、FSQRT），
+// 然后在线程化解释器中跑一个x87循环，最后比较两种模式每条指令的耗时
+#include "Box64X87.h"
+#include "Box64Interp.h"
+#include "Box64Flags.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define GUEST_SIZE      (1024 * 1024)
+#define CODE_BASE       0x1000ULL
+#define DATA_ADDRESS    0x8000ULL       // 映射一页，其后一页不映射
+#define STACK_BASE      0xC0000ULL
+#define STACK_SIZE      0x10000ULL
+#define LOOP_ITERATIONS 1000
+#define BENCH_ITERATIONS 1000000
+#define REG_RBX         3
+
+static int failures = 0;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { printf("[X87Test] ❌ " __VA_ARGS__); printf("\n"); failures++; } \
+} while (0)
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// MARK: - 客户机环境
+
+typedef struct Guest {
+    Box64Context *ctx;
+    uint8_t *backing;
+    Box64TranslationCache *cache;
+    uint8_t code[256];
+    size_t code_length;
+} Guest;
+
+static bool guest_create(Guest *guest) {
+    memset(guest, 0, sizeof(*guest));
+    void *memory = NULL;
+    guest->ctx = calloc(1, sizeof(Box64Context));
+    guest->cache = box64_tc_create(64);
+    if (!guest->ctx || !guest->cache || posix_memalign(&memory, BOX64_PAGE_SIZE, GUEST_SIZE) != 0) {
+        return false;
+    }
+    guest->backing = memory;
+    memset(guest->backing, 0, GUEST_SIZE);
+    Box64Context *ctx = guest->ctx;
+    box64_x87_reset(ctx);
+    return box64_mmu_init(&ctx->mmu, guest->backing, GUEST_SIZE) &&
+           box64_mmu_map(&ctx->mmu, CODE_BASE, BOX64_PAGE_SIZE, BOX64_PROT_READ | BOX64_PROT_EXEC) &&
+           box64_mmu_map(&ctx->mmu, DATA_ADDRESS, BOX64_PAGE_SIZE, BOX64_PROT_READ | BOX64_PROT_WRITE) &&
+           box64_mmu_map(&ctx->mmu, STACK_BASE, STACK_SIZE, BOX64_PROT_READ | BOX64_PROT_WRITE);
+}
+
+static void guest_destroy(Guest *guest) {
+    if (guest->ctx) {
+        box64_mmu_destroy(&guest->ctx->mmu);
+    }
+    box64_tc_destroy(guest->cache);
+    free(guest->backing);
+    free(guest->ctx);
+}
+
+static bool decode(const uint8_t *bytes, size_t length, X86DecodedInsn *insn) {
+    return x86_decode(bytes, length, insn) == X86_DECODE_OK && insn->length == length;
+}
+
+// 解码并执行一条指令；内存操作数统一用 [rbx]（modrm 的 rm=3），RBX 指向 DATA_ADDRESS + offset
+static Box64X87Status run_bytes(Box64Context *ctx, const uint8_t *bytes, size_t length, uint64_t *fault) {
+    X86DecodedInsn insn;
+    if (!decode(bytes, length, &insn)) {
+        return BOX64_X87_UNSUPPORTED;
+    }
+    return box64_x87_execute(ctx, &insn, CODE_BASE + length, fault);
+}
+
+#define RUN(ctx, ...) do { \
+    const uint8_t bytes_[] = { __VA_ARGS__ }; \
+    const Box64X87Status status_ = run_bytes((ctx), bytes_, sizeof(bytes_), NULL); \
+    CHECK(status_ == BOX64_X87_OK, "line %d: status %d", __LINE__, status_); \
+} while (0)
+
+static void set_memory(Box64Context *ctx, uint32_t offset, const void *data, size_t size) {
+    box64_mmu_copy_to_guest(&ctx->mmu, DATA_ADDRESS + offset, data, size);
+    ctx->x86_regs[REG_RBX] = DATA_ADDRESS + offset;
+}
+
+static void get_memory(Box64Context *ctx, uint32_t offset, void *data, size_t size) {
+    box64_mmu_copy_from_guest(&ctx->mmu, data, DATA_ADDRESS + offset, size);
+}
+
+static void push_double(Box64Context *ctx, double value) {
+    set_memory(ctx, 0, &value, sizeof(value));
+    RUN(ctx, 0xDD, 0x03);                                   // fld qword [rbx]
+}
+
+static void push_f80(Box64Context *ctx, uint64_t mantissa, uint16_t sign_exponent) {
+    uint8_t bytes[10];
+    memcpy(bytes, &mantissa, 8);
+    memcpy(bytes + 8, &sign_exponent, 2);
+    set_memory(ctx, 0, bytes, sizeof(bytes));
+    RUN(ctx, 0xDB, 0x2B);                                   // fld tword [rbx]
+}
+
+static double pop_double(Box64Context *ctx) {
+    double value = 0;
+    ctx->x86_regs[REG_RBX] = DATA_ADDRESS + 64;
+    RUN(ctx, 0xDD, 0x1B);                                   // fstp qword [rbx]
+    get_memory(ctx, 64, &value, sizeof(value));
+    return value;
+}
+
+static Box64F80 pop_f80(Box64Context *ctx) {
+    uint8_t bytes[10];
+    Box64F80 value;
+    ctx->x86_regs[REG_RBX] = DATA_ADDRESS + 64;
+    RUN(ctx, 0xDB, 0x3B);                                   // fstp tword [rbx]
+    get_memory(ctx, 64, bytes, sizeof(bytes));
+    memcpy(&value.mantissa, bytes, 8);
+    memcpy(&value.sign_exponent, bytes + 8, 2);
+    return value;
+}
+
+static void set_control(Box64Context *ctx, uint16_t control) {
+    set_memory(ctx, 32, &control, sizeof(control));
+    RUN(ctx, 0xD9, 0x2B);                                   // fldcw [rbx]
+}
+
+// MARK: - 支持范围
+
+typedef struct SupportCase {
+    uint8_t bytes[4];
+    uint8_t length;
+    bool supported;
+    uint8_t memory_size;
+} SupportCase;
+
+static const SupportCase support_cases[] = {
+    { { 0xD9, 0x03 }, 2, true, 4 },             // fld dword [rbx]
+    { { 0xDD, 0x03 }, 2, true, 8 },             // fld qword [rbx]
+    { { 0xDB, 0x2B }, 2, true, 10 },            // fld tword [rbx]
+    { { 0xDF, 0x2B }, 2, true, 8 },             // fild qword [rbx]
+    { { 0xDE, 0x03 }, 2, true, 2 },             // fiadd word [rbx]
+    { { 0xDD, 0x3B }, 2, true, 2 },             // fnstsw [rbx]
+    { { 0xD8, 0xC1 }, 2, true, 0 },             // fadd st, st(1)
+    { { 0xDF, 0xE0 }, 2, true, 0 },             // fnstsw ax
+    { { 0xDB, 0xE3 }, 2, true, 0 },             // fninit
+    { { 0x9B }, 1, true, 0 },                   // fwait
+    { { 0xD9, 0x23 }, 2, false, 0 },            // fldenv
+    { { 0xDD, 0x33 }, 2, false, 0 },            // fnsave
+    { { 0xDF, 0x23 }, 2, false, 0 },            // fbld
+    { { 0xD9, 0xD1 }, 2, false, 0 },            // 保留编码
+};
+
+static void test_support(void) {
+    for (size_t n = 0; n < sizeof(support_cases) / sizeof(support_cases[0]); n++) {
+        const SupportCase *tc = &support_cases[n];
+        X86DecodedInsn insn;
+        if (!decode(tc->bytes, tc->length, &insn)) {
+            CHECK(0, "case %zu: decode failed", n);
+            continue;
+        }
+        CHECK(box64_x87_supported(&insn) == tc->supported, "case %zu (%02X %02X): supported %d",
+              n, tc->bytes[0], tc->bytes[1], box64_x87_supported(&insn));
+        if (tc->supported) {
+            CHECK(box64_x87_memory_size(&insn) == tc->memory_size, "case %zu: memory size %u, expected %u",
+                  n, box64_x87_memory_size(&insn), tc->memory_size);
+        }
+    }
+}
+
+// MARK: - 栈与比较
+
+static void test_stack(Box64Context *ctx) {
+    box64_x87_reset(ctx);
+    CHECK(box64_x87_tag_word(ctx) == 0xFFFF && box64_x87_status_word(ctx) == 0, "reset: tag 0x%04X status 0x%04X",
+          box64_x87_tag_word(ctx), box64_x87_status_word(ctx));
+
+    // 8 次压栈填满，TOP 回到 0；第9次上溢：IE|SF|C1，ST(0) 为不定值
+    for (int n = 0; n < 8; n++) {
+        RUN(ctx, 0xD9, 0xE8);                               // fld1
+    }
+    CHECK(ctx->x87.valid == 0xFF && ctx->x87.top == 0 && box64_x87_status_word(ctx) == 0,
+          "full stack: valid 0x%02X top %u", ctx->x87.valid, ctx->x87.top);
+    RUN(ctx, 0xD9, 0xEE);                                   // fldz
+    const uint16_t overflow = BOX64_X87_SW_IE | BOX64_X87_SW_SF | BOX64_X87_SW_C1;
+    CHECK((box64_x87_status_word(ctx) & overflow) == overflow && isnan(box64_x87_read_st(ctx, 0)),
+          "overflow: status 0x%04X st0 %g", box64_x87_status_word(ctx), box64_x87_read_st(ctx, 0));
+
+    // 空栈上的 FADDP：IE|SF 且 C1=0（下溢），仍然出栈
+    box64_x87_reset(ctx);
+    RUN(ctx, 0xDE, 0xC1);                                   // faddp st(1), st
+    CHECK((box64_x87_status_word(ctx) & (overflow | BOX64_X87_SW_TOP)) == (BOX64_X87_SW_IE | BOX64_X87_SW_SF | (1u << 11)),
+          "underflow: status 0x%04X", box64_x87_status_word(ctx));
+
+    // FFREE 后 FXAM 报告空寄存器（C3|C0）
+    box64_x87_reset(ctx);
+    RUN(ctx, 0xD9, 0xE8);                                   // fld1
+    RUN(ctx, 0xDD, 0xC0);                                   // ffree st(0)
+    RUN(ctx, 0xD9, 0xE5);                                   // fxam
+    CHECK((box64_x87_status_word(ctx) & 0x4500) == 0x4100, "fxam empty: status 0x%04X", box64_x87_status_word(ctx));
+    CHECK(box64_x87_tag_word(ctx) == 0xFFFF, "ffree: tag 0x%04X", box64_x87_tag_word(ctx));
+
+    // 标记字：有效、零、特殊值
+    box64_x87_reset(ctx);
+    push_double(ctx, INFINITY);
+    RUN(ctx, 0xD9, 0xEE);                                   // fldz
+    RUN(ctx, 0xD9, 0xE8);                                   // fld1
+    CHECK(box64_x87_tag_word(ctx) == 0x93FF, "tag word 0x%04X", box64_x87_tag_word(ctx));
+}
+
+static void test_compare(Box64Context *ctx) {
+    box64_x87_reset(ctx);
+    RUN(ctx, 0xD9, 0xE8);                                   // fld1
+    RUN(ctx, 0xD9, 0xEE);                                   // fldz：ST0=0 ST1=1
+    RUN(ctx, 0xD8, 0xD1);                                   // fcom st(1)
+    ctx->x86_regs[0] = 0xFFFFFFFFFFFF0000ULL;
+    RUN(ctx, 0xDF, 0xE0);                                   // fnstsw ax
+    CHECK((ctx->x86_regs[0] & 0x4500) == 0x0100 && ((ctx->x86_regs[0] >> 11) & 7) == 6 &&
+          (ctx->x86_regs[0] >> 16) == 0xFFFFFFFFFFFFULL, "fcom less: ax 0x%llx", (unsigned long long)ctx->x86_regs[0]);
+
+    box64_flags_set(ctx, 0x202);
+    RUN(ctx, 0xDB, 0xF1);                                   // fcomi st, st(1)
+    uint64_t rflags = box64_flags_materialize(ctx);
+    CHECK((rflags & 0x8D5) == 0x01 && (rflags & 0x200), "fcomi less: rflags 0x%llx", (unsigned long long)rflags);
+
+    RUN(ctx, 0xD9, 0xC9);                                   // fxch st(1)：ST0=1 ST1=0
+    RUN(ctx, 0xDB, 0xF1);
+    rflags = box64_flags_materialize(ctx);
+    CHECK((rflags & 0x8D5) == 0x00, "fcomi greater: rflags 0x%llx", (unsigned long long)rflags);
+
+    // 无序：FUCOMIP 不报 IE，ZF PF CF 全置
+    push_double(ctx, NAN);
+    RUN(ctx, 0xDF, 0xE9);                                   // fucomip st, st(1)
+    rflags = box64_flags_materialize(ctx);
+    CHECK((rflags & 0x8D5) == 0x45 && !(box64_x87_status_word(ctx) & BOX64_X87_SW_IE) && ctx->x87.top == 6,
+          "fucomip nan: rflags 0x%llx status 0x%04X", (unsigned long long)rflags, box64_x87_status_word(ctx));
+
+    // FCOMPP：相等 → C3，出栈两次
+    RUN(ctx, 0xD9, 0xC0);                                   // fld st(0)
+    RUN(ctx, 0xDE, 0xD9);                                   // fcompp
+    CHECK((box64_x87_status_word(ctx) & 0x4500) == 0x4000 && ctx->x87.top == 7,
+          "fcompp equal: status 0x%04X", box64_x87_status_word(ctx));
+}
+
+// MARK: - 整数存储
+
+static int32_t fistp32(Box64Context *ctx, double value) {
+    int32_t result = 0;
+    push_double(ctx, value);
+    ctx->x86_regs[REG_RBX] = DATA_ADDRESS + 64;
+    RUN(ctx, 0xDB, 0x1B);                                   // fistp dword [rbx]
+    get_memory(ctx, 64, &result, sizeof(result));
+    return result;
+}
+
+static void test_integer(Box64Context *ctx) {
+    box64_x87_reset(ctx);
+    CHECK(fistp32(ctx, 2.5) == 2 && fistp32(ctx, 3.5) == 4 && fistp32(ctx, -2.5) == -2, "fistp round-to-even");
+    set_control(ctx, BOX64_X87_CONTROL_DEFAULT | (1u << BOX64_X87_RC_SHIFT));   // 向下舍入
+    CHECK(fistp32(ctx, -2.5) == -3 && fistp32(ctx, 2.9) == 2, "fistp round-down");
+    set_control(ctx, BOX64_X87_CONTROL_DEFAULT);
+    CHECK(!(box64_x87_status_word(ctx) & BOX64_X87_SW_IE), "fistp in range raised IE");
+
+    // 越界：整数不定值 + IE
+    CHECK(fistp32(ctx, 1e10) == INT32_MIN && (box64_x87_status_word(ctx) & BOX64_X87_SW_IE), "fistp overflow");
+
+    // FISTTP 总是截断；FILD m64 精确装入 2^63-1（扩展精度下）再存回
+    box64_x87_reset(ctx);
+    push_double(ctx, -7.9);
+    int64_t wide = 0;
+    ctx->x86_regs[REG_RBX] = DATA_ADDRESS + 64;
+    RUN(ctx, 0xDD, 0x0B);                                   // fisttp qword [rbx]
+    get_memory(ctx, 64, &wide, sizeof(wide));
+    CHECK(wide == -7, "fisttp: %lld", (long long)wide);
+
+    box64_x87_set_extended(ctx, true);
+    wide = INT64_MAX;
+    set_memory(ctx, 0, &wide, sizeof(wide));
+    RUN(ctx, 0xDF, 0x2B);                                   // fild qword [rbx]
+    RUN(ctx, 0xDF, 0x3B);                                   // fistp qword [rbx]
+    get_memory(ctx, 0, &wide, sizeof(wide));
+    CHECK(wide == INT64_MAX, "fild/fistp m64 extended: %lld", (long long)wide);
+    box64_x87_set_extended(ctx, false);
+}
+
+// MARK: - 精度模式
+
+// 使用当前的控制字
+static double one_plus_tiny_minus_one(Box64Context *ctx) {
+    RUN(ctx, 0xD9, 0xE8);                                   // fld1
+    push_f80(ctx, 1ULL << 63, 16383 - 60);                  // 2^-60
+    RUN(ctx, 0xDE, 0xC1);                                   // faddp
+    RUN(ctx, 0xD9, 0xE8);                                   // fld1
+    RUN(ctx, 0xDE, 0xE9);                                   // fsubp：ST1 - ST0
+    return pop_double(ctx);
+}
+
+static void test_precision(Box64Context *ctx) {
+    // 1 + 2^-60 在64位尾数下可表示，double 下被舍掉
+    box64_x87_set_extended(ctx, true);
+    box64_x87_reset(ctx);
+    const double extended = one_plus_tiny_minus_one(ctx);
+    box64_x87_set_extended(ctx, false);
+    box64_x87_reset(ctx);
+    const double fast = one_plus_tiny_minus_one(ctx);
+    CHECK(extended == ldexp(1.0, -60) && fast == 0.0, "1+2^-60-1: extended %g fast %g", extended, fast);
+
+    // m80 往返：扩展精度逐位保持；快速模式舍入到 double
+    box64_x87_set_extended(ctx, true);
+    push_f80(ctx, 0xC90FDAA22168C235ULL, 0x4000);           // π
+    Box64F80 pi = pop_f80(ctx);
+    CHECK(pi.mantissa == 0xC90FDAA22168C235ULL && pi.sign_exponent == 0x4000, "m80 round trip extended");
+    box64_x87_set_extended(ctx, false);
+    push_f80(ctx, 0xC90FDAA22168C235ULL, 0x4000);
+    pi = pop_f80(ctx);
+    CHECK(pi.mantissa == 0xC90FDAA22168C000ULL && pi.sign_exponent == 0x4000 && box64_f80_to_double(pi) == M_PI,
+          "m80 round trip fast: 0x%016llx", (unsigned long long)pi.mantissa);
+
+    // FSQRT / FDIV 在64位尾数下正确舍入
+    box64_x87_set_extended(ctx, true);
+    box64_x87_reset(ctx);
+    push_double(ctx, 2.0);
+    RUN(ctx, 0xD9, 0xFA);                                   // fsqrt
+    Box64F80 root = pop_f80(ctx);
+    CHECK(root.mantissa == 0xB504F333F9DE6484ULL && root.sign_exponent == 0x3FFF,
+          "fsqrt(2): 0x%04X 0x%016llx", root.sign_exponent, (unsigned long long)root.mantissa);
+    RUN(ctx, 0xD9, 0xE8);                                   // fld1
+    push_double(ctx, 3.0);
+    RUN(ctx, 0xDE, 0xF9);                                   // fdivp：1/3
+    Box64F80 third = pop_f80(ctx);
+    CHECK(third.mantissa == 0xAAAAAAAAAAAAAAABULL && third.sign_exponent == 0x3FFD,
+          "1/3: 0x%04X 0x%016llx", third.sign_exponent, (unsigned long long)third.mantissa);
+    CHECK(box64_x87_status_word(ctx) & BOX64_X87_SW_PE, "1/3 did not raise PE");
+
+    // 精度控制：PC=24/53 时结果舍入到 float/double 的尾数
+    set_control(ctx, BOX64_X87_CONTROL_DEFAULT & ~(3u << BOX64_X87_PC_SHIFT));
+    RUN(ctx, 0xD9, 0xE8);
+    push_double(ctx, 3.0);
+    RUN(ctx, 0xDE, 0xF9);
+    CHECK(pop_double(ctx) == (double)(1.0f / 3.0f), "PC=24: 1/3 not rounded to float");
+    set_control(ctx, (BOX64_X87_CONTROL_DEFAULT & ~(3u << BOX64_X87_PC_SHIFT)) | (2u << BOX64_X87_PC_SHIFT));
+    CHECK(one_plus_tiny_minus_one(ctx) == 0.0, "PC=53: 1+2^-60 kept");
+
+    // 切回快速模式时已有的寄存器值转换为 double
+    box64_x87_reset(ctx);
+    push_f80(ctx, 0xAAAAAAAAAAAAAAABULL, 0x3FFD);
+    box64_x87_set_extended(ctx, false);
+    CHECK(box64_x87_read_st(ctx, 0) == 1.0 / 3.0 && ctx->x87.valid == 0x80, "mode switch kept value");
+    box64_x87_reset(ctx);
+}
+
+static void test_fault(Guest *guest) {
+    Box64Context *ctx = guest->ctx;
+    box64_x87_reset(ctx);
+    RUN(ctx, 0xD9, 0xE8);
+    const uint16_t status = box64_x87_status_word(ctx);
+    const uint8_t valid = ctx->x87.valid;
+
+    // 跨到未映射页的 FSTP m64：报告缺页，栈不变
+    ctx->x86_regs[REG_RBX] = DATA_ADDRESS + BOX64_PAGE_SIZE - 4;
+    const uint8_t fstp[] = { 0xDD, 0x1B };
+    uint64_t fault = 0;
+    CHECK(run_bytes(ctx, fstp, sizeof(fstp), &fault) == BOX64_X87_FAULT && fault == DATA_ADDRESS + BOX64_PAGE_SIZE - 4,
+          "fstp fault: 0x%llx", (unsigned long long)fault);
+    CHECK(box64_x87_status_word(ctx) == status && ctx->x87.valid == valid, "fstp fault changed the stack");
+    box64_x87_reset(ctx);
+}
+
+// MARK: - 解释器
+
+// 与 bench_box64_interp.c 相同的块查找/链接方式
+static Box64InterpExit run_threaded(Guest *guest, uint32_t max_instructions, Box64InterpResult *result) {
+    Box64Context *ctx = guest->ctx;
+    const Box64InterpBounds bounds = {
+        guest->cache, CODE_BASE, CODE_BASE + guest->code_length, max_instructions, 0, NULL
+    };
+    Box64Block *previous = NULL;
+    Box64BlockEdge edge = BOX64_EDGE_FALLTHROUGH;
+
+    for (;;) {
+        const uint64_t rip = ctx->rip;
+        if (rip < CODE_BASE || rip >= CODE_BASE + guest->code_length) {
+            return BOX64_INTERP_BLOCK_END;
+        }
+        Box64Block *block = previous ? box64_tc_follow(guest->cache, previous, edge, rip) : NULL;
+        if (!block) {
+            block = box64_tc_lookup(guest->cache, rip);
+            if (!block) {
+                block = box64_tc_translate(guest->cache, rip, guest->code + (rip - CODE_BASE),
+                                           guest->code_length - (size_t)(rip - CODE_BASE), NULL);
+                if (!block) {
+                    return BOX64_INTERP_FALLBACK;
+                }
+            }
+            if (previous) {
+                box64_tc_link(previous, edge, block);
+            }
+        }
+        box64_block_count_exec(block);
+
+        Box64InterpExit exit = box64_interp_run(ctx, &bounds, block, 0, result);
+        if (exit != BOX64_INTERP_BLOCK_END) {
+            return exit;
+        }
+        previous = result->block;
+        edge = ctx->rip == previous->successor_rip[BOX64_EDGE_FALLTHROUGH] ? BOX64_EDGE_FALLTHROUGH : BOX64_EDGE_TAKEN;
+    }
+}
+
+//   mov rbx, DATA_ADDRESS
+//   mov ecx, N
+//   fldz
+//   fld1
+// loop:
+//   fadd st(1), st
+//   dec ecx
+//   jnz loop
+//   fstp st(0)
+//   fstp qword [rbx]
+//   ret
+static void build_loop(Guest *guest, uint32_t iterations) {
+    const uint8_t program[] = {
+        0x48, 0xC7, 0xC3, 0, 0, 0, 0,
+        0xB9, 0, 0, 0, 0,
+        0xD9, 0xEE,
+        0xD9, 0xE8,
+        0xDC, 0xC1,
+        0xFF, 0xC9,
+        0x75, 0xFA,
+        0xDD, 0xD8,
+        0xDD, 0x1B,
+        0xC3
+    };
+    const uint32_t address = (uint32_t)DATA_ADDRESS;
+    memcpy(guest->code, program, sizeof(program));
+    memcpy(guest->code + 3, &address, sizeof(address));
+    memcpy(guest->code + 8, &iterations, sizeof(iterations));
+    guest->code_length = sizeof(program);
+    box64_tc_flush(guest->cache);
+}
+
+static Box64InterpExit run_loop(Guest *guest, Box64InterpResult *result) {
+    Box64Context *ctx = guest->ctx;
+    box64_x87_reset(ctx);
+    box64_flags_set(ctx, 0x202);
+    ctx->stack_base = STACK_BASE;
+    ctx->stack_size = STACK_SIZE;
+    ctx->x86_regs[BOX64_INTERP_REG_RSP] = STACK_BASE + STACK_SIZE - 64;
+    ctx->rip = CODE_BASE;
+    ctx->instruction_count = 0;
+    return run_threaded(guest, UINT32_MAX, result);
+}
+
+static void test_interpreter(Guest *guest) {
+    Box64InterpResult result;
+    for (int extended = 0; extended < 2; extended++) {
+        box64_x87_set_extended(guest->ctx, extended);
+        build_loop(guest, LOOP_ITERATIONS);
+        Box64InterpExit exit = run_loop(guest, &result);
+        double sum = 0;
+        get_memory(guest->ctx, 0, &sum, sizeof(sum));
+        CHECK(exit == BOX64_INTERP_RETURN, "x87 loop exit %d (extended %d)", exit, extended);
+        CHECK(sum == LOOP_ITERATIONS && guest->ctx->x87.valid == 0 && guest->ctx->x87.top == 0,
+              "x87 loop: sum %g valid 0x%02X top %u (extended %d)", sum, guest->ctx->x87.valid, guest->ctx->x87.top, extended);
+    }
+    box64_x87_set_extended(guest->ctx, false);
+}
+
+// MARK: - 基准
+
+// ST0=1.5 ST1=0.5 ST2=2：fadd st,st(1); fmul st,st(2); fdiv st,st(2); fsub st,st(1)，ST0 每轮回到原值
+static const uint8_t bench_program[][2] = {
+    { 0xD8, 0xC1 }, { 0xD8, 0xCA }, { 0xD8, 0xF2 }, { 0xD8, 0xE1 }
+};
+
+static double bench_mode(Box64Context *ctx, bool extended) {
+    const size_t op_count = sizeof(bench_program) / sizeof(bench_program[0]);
+    X86DecodedInsn insns[sizeof(bench_program) / sizeof(bench_program[0])];
+    for (size_t n = 0; n < op_count; n++) {
+        decode(bench_program[n], 2, &insns[n]);
+    }
+    box64_x87_set_extended(ctx, extended);
+    box64_x87_reset(ctx);
+    push_double(ctx, 2.0);
+    push_double(ctx, 0.5);
+    push_double(ctx, 1.5);
+
+    const double start = now_seconds();
+    for (int iteration = 0; iteration < BENCH_ITERATIONS; iteration++) {
+        for (size_t n = 0; n < op_count; n++) {
+            box64_x87_execute(ctx, &insns[n], CODE_BASE, NULL);
+        }
+    }
+    const double elapsed = now_seconds() - start;
+    CHECK(box64_x87_read_st(ctx, 0) == 1.5, "bench (extended %d): st0 drifted to %g", extended, box64_x87_read_st(ctx, 0));
+    box64_x87_set_extended(ctx, false);
+    box64_x87_reset(ctx);
+    return elapsed * 1e9 / ((double)BENCH_ITERATIONS * (double)op_count);
+}
+
+static void bench(Guest *guest) {
+    printf("[X87Test] 基准：%d 次 × 4 条寄存器算术\n", BENCH_ITERATIONS);
+    const double fast = bench_mode(guest->ctx, false);
+    const double extended = bench_mode(guest->ctx, true);
+    printf("[X87Test]   快速模式（double）   %.2f ns/指令\n", fast);
+    printf("[X87Test]   扩展精度（软件浮点） %.2f ns/指令\n", extended);
+    printf("[X87Test]   快速模式加速比       %.2fx\n", extended / fast);
+
+    Box64InterpResult result;
+    build_loop(guest, BENCH_ITERATIONS);
+    const double start = now_seconds();
+    run_loop(guest, &result);
+    const double loop_time = now_seconds() - start;
+    printf("[X87Test]   解释器x87循环 %.2f ns/迭代（3条指令）\n", loop_time * 1e9 / BENCH_ITERATIONS);
+}
+
+int main(void) {
+    Guest guest;
+    if (!guest_create(&guest)) {
+        printf("[X87Test] ❌ guest setup failed\n");
+        return 1;
+    }
+
+    test_support();
+    test_stack(guest.ctx);
+    test_compare(guest.ctx);
+    test_integer(guest.ctx);
+    test_precision(guest.ctx);
+    test_fault(&guest);
+    test_interpreter(&guest);
+    bench(&guest);
+
+    guest_destroy(&guest);
+    if (failures) {
+        printf("[X87Test] ❌ %d checks failed\n", failures);
+        return 1;
+    }
+    printf("[X87Test] ✅ all checks passed\n");
+    return 0;
+}
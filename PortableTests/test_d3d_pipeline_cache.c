@@ -0,0 +1,379 @@
+// test_d3d_pipeline_cache.c - D3DPipelineCache 哈希规范化 / 编译状态 / LRU淘汰 / 碰撞 / 并发编译测试
+// 最后给出命中查找的耗时（每次绘制前都要查一次）
+#include "D3DPipelineCache.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define STRESS_THREADS      4
+#define STRESS_LOOKUPS      20000
+#define STRESS_VARIANTS     64
+#define LOOKUP_ROUNDS       5000000
+
+static int failures = 0;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { printf("[PipelineCacheTest] ❌ " __VA_ARGS__); printf("\n"); failures++; } \
+} while (0)
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// 一个带两个属性、一个颜色附件、开深度测试的典型描述符
+static D3DPipelineDesc make_desc(uint64_t vertex_shader) {
+    D3DPipelineDesc desc;
+    memset(&desc, 0, sizeof(desc));
+    desc.vertex_shader = vertex_shader;
+    desc.fragment_shader = 0xF00D;
+    desc.attribute_count = 2;
+    desc.attributes[0] = (D3DVertexAttribute){ .format = 30, .buffer = 0, .offset = 0 };
+    desc.attributes[1] = (D3DVertexAttribute){ .format = 31, .buffer = 0, .offset = 12 };
+    desc.buffer_count = 1;
+    desc.buffer_strides[0] = 28;
+    desc.color_formats[0] = 80;
+    desc.blend[0].write_mask = 0xF;
+    desc.depth_stencil_format = 252;
+    desc.depth_test = 1;
+    desc.depth_write = 1;
+    desc.depth_compare = 3;
+    desc.topology_class = 3;
+    desc.sample_count = 1;
+    return desc;
+}
+
+// 记录释放回调收到的管线
+static int released[1024];
+static int released_count = 0;
+
+static void record_release(void *pipeline, void *userdata) {
+    (void)userdata;
+    if (released_count < 1024) {
+        released[released_count] = (int)(intptr_t)pipeline;
+    }
+    released_count++;
+}
+
+// 每个参与键的字段都改变哈希；未使用部分的残留值、关闭混合时的混合因子不改变哈希
+static void check_hash(void) {
+    const D3DPipelineDesc base = make_desc(1);
+    const uint64_t base_hash = d3d_pipeline_desc_hash(&base);
+    CHECK(base_hash != 0, "zero hash");
+    CHECK(d3d_pipeline_desc_hash(&base) == base_hash, "hash not deterministic");
+
+    D3DPipelineDesc variants[16];
+    int n = 0;
+    variants[n] = base; variants[n++].vertex_shader = 2;
+    variants[n] = base; variants[n++].fragment_shader = 2;
+    variants[n] = base; variants[n++].attributes[1].offset = 16;
+    variants[n] = base; variants[n++].attributes[0].format = 29;
+    variants[n] = base; variants[n++].attribute_count = 1;
+    variants[n] = base; variants[n++].buffer_strides[0] = 32;
+    variants[n] = base; variants[n++].buffer_per_instance[0] = 1;
+    variants[n] = base; variants[n++].color_formats[0] = 81;
+    variants[n] = base; variants[n++].color_formats[1] = 80;
+    variants[n] = base; variants[n++].blend[0].write_mask = 0x7;
+    variants[n] = base; variants[n].blend[0].enabled = 1; variants[n++].blend[0].src_rgb = 4;
+    variants[n] = base; variants[n++].depth_compare = 5;
+    variants[n] = base; variants[n++].cull_mode = 2;
+    variants[n] = base; variants[n++].sample_count = 4;
+    variants[n] = base; variants[n++].depth_stencil_format = 260;
+    for (int i = 0; i < n; i++) {
+        CHECK(d3d_pipeline_desc_hash(&variants[i]) != base_hash, "variant %d does not change the hash", i);
+        CHECK(!d3d_pipeline_desc_equal(&variants[i], &base), "variant %d compares equal", i);
+        for (int j = 0; j < i; j++) {
+            CHECK(d3d_pipeline_desc_hash(&variants[i]) != d3d_pipeline_desc_hash(&variants[j]),
+                  "variants %d and %d collide", i, j);
+        }
+    }
+
+    D3DPipelineDesc noise = base;
+    noise.attributes[5].format = 99;                // 超出 attribute_count
+    noise.buffer_strides[3] = 64;                   // 超出 buffer_count
+    noise.blend[2].src_rgb = 7;                     // 附件未使用
+    noise.blend[0].dst_alpha = 9;                   // 混合关闭
+    CHECK(d3d_pipeline_desc_hash(&noise) == base_hash, "unused state changes the hash");
+    CHECK(d3d_pipeline_desc_equal(&noise, &base), "unused state breaks equality");
+
+    D3DPipelineDesc depth_off = base;
+    depth_off.depth_test = 0;
+    D3DPipelineDesc depth_off_other = depth_off;
+    depth_off_other.depth_compare = 7;
+    depth_off_other.depth_write = 0;
+    CHECK(d3d_pipeline_desc_equal(&depth_off, &depth_off_other), "depth compare matters with depth test off");
+}
+
+// 未命中登记为编译中，重复查找不再触发编译，完成后命中；失败条目查找时不重试，显式重试后可以重新编译
+static void check_lifecycle(void) {
+    D3DPipelineCache *cache = d3d_pso_cache_create(8);
+    const D3DPipelineDesc desc = make_desc(1);
+    const uint64_t hash = d3d_pipeline_desc_hash(&desc);
+    void *pipeline = (void *)1;
+
+    CHECK(d3d_pso_cache_acquire(cache, &desc, hash, &pipeline) == D3D_PSO_MISS, "first lookup not a miss");
+    CHECK(pipeline == NULL, "miss returned a pipeline");
+    CHECK(d3d_pso_cache_acquire(cache, &desc, hash, &pipeline) == D3D_PSO_COMPILING, "second lookup not compiling");
+    CHECK(d3d_pso_cache_complete(cache, &desc, hash, (void *)100), "complete rejected");
+    CHECK(!d3d_pso_cache_complete(cache, &desc, hash, (void *)101), "duplicate complete accepted");
+    CHECK(d3d_pso_cache_acquire(cache, &desc, hash, &pipeline) == D3D_PSO_READY && pipeline == (void *)100,
+          "ready lookup returned %p", pipeline);
+
+    const D3DPipelineDesc broken = make_desc(2);
+    const uint64_t broken_hash = d3d_pipeline_desc_hash(&broken);
+    CHECK(d3d_pso_cache_acquire(cache, &broken, broken_hash, &pipeline) == D3D_PSO_MISS, "broken not a miss");
+    CHECK(d3d_pso_cache_complete(cache, &broken, broken_hash, NULL), "failed complete rejected");
+    CHECK(d3d_pso_cache_acquire(cache, &broken, broken_hash, &pipeline) == D3D_PSO_FAILED && pipeline == NULL,
+          "failed pipeline retried");
+
+    D3DPipelineCacheStats stats;
+    d3d_pso_cache_get_stats(cache, &stats);
+    CHECK(stats.hits == 1 && stats.misses == 2 && stats.compiling_hits == 1 && stats.failed_hits == 1,
+          "stats hits=%llu misses=%llu compiling=%llu failed=%llu", (unsigned long long)stats.hits,
+          (unsigned long long)stats.misses, (unsigned long long)stats.compiling_hits,
+          (unsigned long long)stats.failed_hits);
+    CHECK(stats.compiled == 1 && stats.compile_failures == 1 && stats.entries == 2 && stats.compiling == 0,
+          "stats compiled=%llu failures=%llu entries=%u", (unsigned long long)stats.compiled,
+          (unsigned long long)stats.compile_failures, stats.entries);
+
+    CHECK(!d3d_pso_cache_retry(cache, &desc, hash), "ready pipeline accepted a retry");
+    CHECK(d3d_pso_cache_retry(cache, &broken, broken_hash), "failed pipeline not retried");
+    CHECK(!d3d_pso_cache_retry(cache, &broken, broken_hash), "retry accepted while already compiling");
+    CHECK(d3d_pso_cache_acquire(cache, &broken, broken_hash, &pipeline) == D3D_PSO_COMPILING,
+          "retried pipeline not compiling");
+    CHECK(d3d_pso_cache_complete(cache, &broken, broken_hash, (void *)200), "retried complete rejected");
+    CHECK(d3d_pso_cache_acquire(cache, &broken, broken_hash, &pipeline) == D3D_PSO_READY && pipeline == (void *)200,
+          "retried pipeline not ready");
+    d3d_pso_cache_get_stats(cache, &stats);
+    CHECK(stats.retries == 1 && stats.compiled == 2 && stats.compiling == 0, "retry stats retries=%llu compiled=%llu",
+          (unsigned long long)stats.retries, (unsigned long long)stats.compiled);
+    d3d_pso_cache_destroy(cache);
+}
+
+// 满了按LRU淘汰，最近命中的保留，编译中的不淘汰
+static void check_lru(void) {
+    D3DPipelineCache *cache = d3d_pso_cache_create(4);
+    d3d_pso_cache_set_release_callback(cache, record_release, NULL);
+    released_count = 0;
+    void *pipeline = NULL;
+
+    D3DPipelineDesc descs[8];
+    uint64_t hashes[8];
+    for (int i = 0; i < 8; i++) {
+        descs[i] = make_desc(10 + i);
+        hashes[i] = d3d_pipeline_desc_hash(&descs[i]);
+    }
+    for (int i = 0; i < 4; i++) {
+        d3d_pso_cache_acquire(cache, &descs[i], hashes[i], &pipeline);
+        d3d_pso_cache_complete(cache, &descs[i], hashes[i], (void *)(intptr_t)(100 + i));
+    }
+    // 0 最近用过，1 成为最久未用
+    d3d_pso_cache_acquire(cache, &descs[0], hashes[0], &pipeline);
+    CHECK(d3d_pso_cache_acquire(cache, &descs[4], hashes[4], &pipeline) == D3D_PSO_MISS, "insert into full cache");
+    CHECK(released_count == 1 && released[0] == 101, "evicted %d (count %d), expected 101",
+          released_count ? released[0] : -1, released_count);
+    CHECK(d3d_pso_cache_acquire(cache, &descs[0], hashes[0], &pipeline) == D3D_PSO_READY, "recent entry evicted");
+
+    // 4 仍在编译；再插入三个，淘汰 2、3、0，不动 4
+    for (int i = 5; i < 8; i++) {
+        CHECK(d3d_pso_cache_acquire(cache, &descs[i], hashes[i], &pipeline) == D3D_PSO_MISS, "insert %d", i);
+    }
+    CHECK(released_count == 4, "released %d pipelines", released_count);
+    CHECK(d3d_pso_cache_acquire(cache, &descs[4], hashes[4], &pipeline) == D3D_PSO_COMPILING,
+          "compiling entry evicted");
+    // 全部在编译：不登记，按编译中返回
+    CHECK(d3d_pso_cache_acquire(cache, &descs[1], hashes[1], &pipeline) == D3D_PSO_COMPILING,
+          "inserted into a cache full of compiling entries");
+
+    for (int i = 4; i < 8; i++) {
+        d3d_pso_cache_complete(cache, &descs[i], hashes[i], (void *)(intptr_t)(100 + i));
+    }
+    D3DPipelineCacheStats stats;
+    d3d_pso_cache_get_stats(cache, &stats);
+    CHECK(stats.evictions == 4 && stats.entries == 4 && stats.compiling == 0,
+          "evictions=%llu entries=%u", (unsigned long long)stats.evictions, stats.entries);
+
+    d3d_pso_cache_flush(cache);
+    CHECK(released_count == 8, "flush released %d pipelines in total", released_count);
+    CHECK(d3d_pso_cache_acquire(cache, &descs[5], hashes[5], &pipeline) == D3D_PSO_MISS, "entry survived flush");
+    d3d_pso_cache_complete(cache, &descs[5], hashes[5], (void *)105);
+    d3d_pso_cache_destroy(cache);
+    CHECK(released_count == 9, "destroy did not release the last pipeline");
+}
+
+// 强行使用相同的哈希：不同的描述符仍是不同条目
+static void check_collisions(void) {
+    D3DPipelineCache *cache = d3d_pso_cache_create(8);
+    const D3DPipelineDesc a = make_desc(1);
+    const D3DPipelineDesc b = make_desc(2);
+    void *pipeline = NULL;
+
+    d3d_pso_cache_acquire(cache, &a, 42, &pipeline);
+    d3d_pso_cache_complete(cache, &a, 42, (void *)1);
+    CHECK(d3d_pso_cache_acquire(cache, &b, 42, &pipeline) == D3D_PSO_MISS, "colliding descriptor hit");
+    d3d_pso_cache_complete(cache, &b, 42, (void *)2);
+    CHECK(d3d_pso_cache_acquire(cache, &a, 42, &pipeline) == D3D_PSO_READY && pipeline == (void *)1, "a lost");
+    CHECK(d3d_pso_cache_acquire(cache, &b, 42, &pipeline) == D3D_PSO_READY && pipeline == (void *)2, "b lost");
+
+    D3DPipelineCacheStats stats;
+    d3d_pso_cache_get_stats(cache, &stats);
+    CHECK(stats.collisions > 0 && stats.entries == 2, "collisions not counted");
+    d3d_pso_cache_destroy(cache);
+}
+
+// 多个渲染线程抢同一组描述符，后台线程编译：每个描述符只编译一次，命中的管线与描述符对应
+typedef struct StressShared {
+    D3DPipelineCache *cache;
+    D3DPipelineDesc descs[STRESS_VARIANTS];
+    uint64_t hashes[STRESS_VARIANTS];
+    int compile_queue[STRESS_VARIANTS * 2];
+    int queued;
+    int compiles[STRESS_VARIANTS];
+    int wrong_pipeline;
+    int done_threads;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+} StressShared;
+
+static void *render_thread(void *arg) {
+    StressShared *shared = arg;
+    uint64_t rng = (uint64_t)(uintptr_t)&rng | 1;
+    for (int i = 0; i < STRESS_LOOKUPS; i++) {
+        rng ^= rng << 13;
+        rng ^= rng >> 7;
+        rng ^= rng << 17;
+        const int v = (int)(rng % STRESS_VARIANTS);
+        void *pipeline = NULL;
+        const D3DPipelineState state = d3d_pso_cache_acquire(shared->cache, &shared->descs[v], shared->hashes[v],
+                                                             &pipeline);
+        pthread_mutex_lock(&shared->mutex);
+        if (state == D3D_PSO_MISS) {
+            shared->compile_queue[shared->queued++] = v;
+            pthread_cond_signal(&shared->cond);
+        } else if (state == D3D_PSO_READY && pipeline != (void *)(intptr_t)(1000 + v)) {
+            shared->wrong_pipeline++;
+        }
+        pthread_mutex_unlock(&shared->mutex);
+    }
+    pthread_mutex_lock(&shared->mutex);
+    shared->done_threads++;
+    pthread_cond_signal(&shared->cond);
+    pthread_mutex_unlock(&shared->mutex);
+    return NULL;
+}
+
+static void *compile_thread(void *arg) {
+    StressShared *shared = arg;
+    int next = 0;
+    pthread_mutex_lock(&shared->mutex);
+    for (;;) {
+        while (next == shared->queued && shared->done_threads < STRESS_THREADS) {
+            pthread_cond_wait(&shared->cond, &shared->mutex);
+        }
+        if (next == shared->queued) {
+            break;
+        }
+        const int v = shared->compile_queue[next++];
+        shared->compiles[v]++;
+        pthread_mutex_unlock(&shared->mutex);
+        d3d_pso_cache_complete(shared->cache, &shared->descs[v], shared->hashes[v], (void *)(intptr_t)(1000 + v));
+        pthread_mutex_lock(&shared->mutex);
+    }
+    pthread_mutex_unlock(&shared->mutex);
+    return NULL;
+}
+
+static void check_concurrent(void) {
+    static StressShared shared;
+    memset(&shared, 0, sizeof(shared));
+    shared.cache = d3d_pso_cache_create(STRESS_VARIANTS);
+    pthread_mutex_init(&shared.mutex, NULL);
+    pthread_cond_init(&shared.cond, NULL);
+    for (int v = 0; v < STRESS_VARIANTS; v++) {
+        shared.descs[v] = make_desc(0x1000 + v);
+        shared.descs[v].blend[0].enabled = (uint8_t)(v & 1);
+        shared.hashes[v] = d3d_pipeline_desc_hash(&shared.descs[v]);
+    }
+
+    pthread_t compiler;
+    pthread_t renderers[STRESS_THREADS];
+    pthread_create(&compiler, NULL, compile_thread, &shared);
+    for (int i = 0; i < STRESS_THREADS; i++) {
+        pthread_create(&renderers[i], NULL, render_thread, &shared);
+    }
+    for (int i = 0; i < STRESS_THREADS; i++) {
+        pthread_join(renderers[i], NULL);
+    }
+    pthread_join(compiler, NULL);
+
+    int compiled_once = 0;
+    for (int v = 0; v < STRESS_VARIANTS; v++) {
+        compiled_once += shared.compiles[v] == 1;
+    }
+    CHECK(compiled_once == STRESS_VARIANTS, "%d of %d variants compiled exactly once", compiled_once, STRESS_VARIANTS);
+    CHECK(shared.wrong_pipeline == 0, "%d lookups returned another descriptor's pipeline", shared.wrong_pipeline);
+
+    D3DPipelineCacheStats stats;
+    d3d_pso_cache_get_stats(shared.cache, &stats);
+    CHECK(stats.misses == STRESS_VARIANTS && stats.evictions == 0, "misses=%llu", (unsigned long long)stats.misses);
+    printf("[PipelineCacheTest] %d 个线程 %d 次查找: 命中 %llu，编译中 %llu，未命中 %llu\n",
+           STRESS_THREADS, STRESS_THREADS * STRESS_LOOKUPS, (unsigned long long)stats.hits,
+           (unsigned long long)stats.compiling_hits, (unsigned long long)stats.misses);
+
+    d3d_pso_cache_destroy(shared.cache);
+    pthread_cond_destroy(&shared.cond);
+    pthread_mutex_destroy(&shared.mutex);
+}
+
+static void bench_lookup(void) {
+    D3DPipelineCache *cache = d3d_pso_cache_create(0);
+    D3DPipelineDesc descs[STRESS_VARIANTS];
+    for (int v = 0; v < STRESS_VARIANTS; v++) {
+        descs[v] = make_desc(0x2000 + v);
+        void *pipeline = NULL;
+        const uint64_t hash = d3d_pipeline_desc_hash(&descs[v]);
+        d3d_pso_cache_acquire(cache, &descs[v], hash, &pipeline);
+        d3d_pso_cache_complete(cache, &descs[v], hash, (void *)(intptr_t)(v + 1));
+    }
+
+    uintptr_t sink = 0;
+    double start = now_seconds();
+    for (int i = 0; i < LOOKUP_ROUNDS; i++) {
+        const D3DPipelineDesc *desc = &descs[i % STRESS_VARIANTS];
+        sink += (uintptr_t)d3d_pipeline_desc_hash(desc);
+    }
+    const double hash_time = now_seconds() - start;
+
+    start = now_seconds();
+    for (int i = 0; i < LOOKUP_ROUNDS; i++) {
+        const D3DPipelineDesc *desc = &descs[i % STRESS_VARIANTS];
+        void *pipeline = NULL;
+        d3d_pso_cache_acquire(cache, desc, d3d_pipeline_desc_hash(desc), &pipeline);
+        sink += (uintptr_t)pipeline;
+    }
+    const double lookup_time = now_seconds() - start;
+
+    printf("[PipelineCacheTest] 描述符哈希: %.1f ns/次\n", hash_time * 1e9 / LOOKUP_ROUNDS);
+    printf("[PipelineCacheTest] 哈希+命中查找: %.1f ns/次 (sink %lu)\n", lookup_time * 1e9 / LOOKUP_ROUNDS,
+           (unsigned long)(sink & 0xFF));
+    d3d_pso_cache_destroy(cache);
+}
+
+int main(void) {
+    check_hash();
+    check_lifecycle();
+    check_lru();
+    check_collisions();
+    check_concurrent();
+    bench_lookup();
+
+    if (failures) {
+        printf("[PipelineCacheTest] %d 项检查失败\n", failures);
+        return 1;
+    }
+    printf("[PipelineCacheTest] ✅ all checks passed\n");
+    return 0;
+}
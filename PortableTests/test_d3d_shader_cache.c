@@ -0,0 +1,292 @@
+// test_d3d_shader_cache.c - D3DShaderDiskCache 跨打开持久化 / 版本隔离 / 崩溃尾部恢复 / LRU压缩测试
+// 最后对比冷启动（逐个“翻译”）和热启动（打开缓存 + 映射读取）的耗时
+#include "D3DShaderDiskCache.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define TRANSLATOR_VERSION  3
+#define WARM_SHADERS        2000
+#define TRANSLATE_WORK      20000       // 模拟翻译一个着色器的计算量
+
+static int failures = 0;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { printf("[ShaderCacheTest] ❌ " __VA_ARGS__); printf("\n"); failures++; } \
+} while (0)
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static char cache_dir[256];
+
+static const char *cache_file(void) {
+    static char path[320];
+    snprintf(path, sizeof(path), "%s/%s", cache_dir, D3D_SHADER_CACHE_FILE);
+    return path;
+}
+
+static uint64_t file_size(void) {
+    struct stat st;
+    return stat(cache_file(), &st) == 0 ? (uint64_t)st.st_size : 0;
+}
+
+// 伪字节码：第 n 个着色器的内容确定、互不相同
+static void make_bytecode(uint32_t n, uint8_t *bytecode, size_t size) {
+    uint64_t state = 0x9E3779B97F4A7C15ULL * (n + 1);
+    for (size_t i = 0; i < size; i++) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        bytecode[i] = (uint8_t)state;
+    }
+}
+
+// 模拟翻译：生成源码和反射数据（反射为输入/输出寄存器计数）
+static uint32_t translate(uint32_t n, char *source, size_t capacity, uint32_t reflection[2]) {
+    volatile uint64_t sink = n;
+    for (int i = 0; i < TRANSLATE_WORK; i++) {
+        sink = sink * 6364136223846793005ULL + 1442695040888963407ULL;
+    }
+    reflection[0] = n % 16;
+    reflection[1] = n % 8 + 1;
+    return (uint32_t)snprintf(source, capacity,
+                              "vertex float4 vertex_main_%u(uint vid [[vertex_id]]) { return float4(%u); }\n", n, n);
+}
+
+static bool blob_matches(const D3DShaderBlob *blob, uint32_t n) {
+    char expected[256];
+    uint32_t reflection[2];
+    const uint32_t length = translate(n, expected, sizeof(expected), reflection);
+    return blob->source_size == length && memcmp(blob->source, expected, length) == 0 &&
+           blob->reflection_size == sizeof(reflection) && memcmp(blob->reflection, reflection, sizeof(reflection)) == 0;
+}
+
+static D3DShaderKey key_for(uint32_t n, uint32_t version) {
+    uint8_t bytecode[96];
+    make_bytecode(n, bytecode, sizeof(bytecode));
+    return d3d_shader_key(bytecode, sizeof(bytecode), version);
+}
+
+static bool store_shader(D3DShaderDiskCache *cache, uint32_t n) {
+    char source[256];
+    uint32_t reflection[2];
+    const uint32_t length = translate(n, source, sizeof(source), reflection);
+    return d3d_shader_cache_store(cache, key_for(n, TRANSLATOR_VERSION), source, length, reflection,
+                                  sizeof(reflection));
+}
+
+static void reset_dir(void) {
+    unlink(cache_file());
+}
+
+// 键区分内容和版本；写入后关闭再打开仍能读到；同键重复写入不追加
+static void check_persistence(void) {
+    reset_dir();
+    D3DShaderDiskCache *cache = d3d_shader_cache_open(cache_dir, 0);
+    CHECK(cache != NULL, "open failed");
+    if (!cache) return;
+
+    const D3DShaderKey a = key_for(1, TRANSLATOR_VERSION);
+    const D3DShaderKey b = key_for(2, TRANSLATOR_VERSION);
+    const D3DShaderKey a_next = key_for(1, TRANSLATOR_VERSION + 1);
+    CHECK(a.lo != b.lo && a.hi != b.hi, "different bytecode, same key");
+    CHECK(a.lo != a_next.lo && a.hi != a_next.hi, "translator version does not change the key");
+
+    D3DShaderBlob blob;
+    CHECK(!d3d_shader_cache_lookup(cache, a, &blob), "empty cache hit");
+    for (uint32_t n = 0; n < 10; n++) {
+        CHECK(store_shader(cache, n), "store %u failed", n);
+    }
+    const uint64_t size = file_size();
+    CHECK(store_shader(cache, 3), "duplicate store failed");
+    CHECK(file_size() == size, "duplicate store appended");
+    CHECK(d3d_shader_cache_lookup(cache, key_for(4, TRANSLATOR_VERSION), &blob) && blob_matches(&blob, 4),
+          "lookup after store");
+    d3d_shader_cache_close(cache);
+
+    cache = d3d_shader_cache_open(cache_dir, 0);
+    int matched = 0;
+    for (uint32_t n = 0; n < 10; n++) {
+        matched += d3d_shader_cache_lookup(cache, key_for(n, TRANSLATOR_VERSION), &blob) && blob_matches(&blob, n);
+    }
+    CHECK(matched == 10, "%d of 10 shaders survived reopen", matched);
+    CHECK(!d3d_shader_cache_lookup(cache, key_for(1, TRANSLATOR_VERSION + 1), &blob), "old version served");
+
+    D3DShaderCacheStats stats;
+    d3d_shader_cache_get_stats(cache, &stats);
+    CHECK(stats.entries == 10 && stats.recovered_bytes == 0 && stats.file_bytes == size,
+          "entries=%u recovered=%llu", stats.entries, (unsigned long long)stats.recovered_bytes);
+    d3d_shader_cache_close(cache);
+}
+
+// 最后一条记录只写了一半（崩溃）：打开时截掉，前面的记录完好，之后照常追加
+static void check_torn_tail(void) {
+    reset_dir();
+    D3DShaderDiskCache *cache = d3d_shader_cache_open(cache_dir, 0);
+    for (uint32_t n = 0; n < 5; n++) {
+        store_shader(cache, n);
+    }
+    const uint64_t four = file_size();
+    store_shader(cache, 5);
+    const uint64_t five = file_size();
+    d3d_shader_cache_close(cache);
+
+    CHECK(truncate(cache_file(), (off_t)(five - 9)) == 0, "truncate failed");
+    cache = d3d_shader_cache_open(cache_dir, 0);
+    D3DShaderBlob blob;
+    CHECK(!d3d_shader_cache_lookup(cache, key_for(5, TRANSLATOR_VERSION), &blob), "torn record served");
+    CHECK(d3d_shader_cache_lookup(cache, key_for(4, TRANSLATOR_VERSION), &blob) && blob_matches(&blob, 4),
+          "record before the torn one lost");
+    CHECK(file_size() == four, "torn tail not truncated (%llu vs %llu)", (unsigned long long)file_size(),
+          (unsigned long long)four);
+    CHECK(store_shader(cache, 5), "store after recovery");
+    d3d_shader_cache_close(cache);
+
+    // 尾部写入了校验不过的垃圾
+    const int fd = open(cache_file(), O_WRONLY | O_APPEND);
+    const char garbage[64] = "SREC garbage that is not a valid record at all ..............";
+    CHECK(write(fd, garbage, sizeof(garbage)) == (ssize_t)sizeof(garbage), "append garbage");
+    close(fd);
+    cache = d3d_shader_cache_open(cache_dir, 0);
+    CHECK(d3d_shader_cache_lookup(cache, key_for(5, TRANSLATOR_VERSION), &blob) && blob_matches(&blob, 5),
+          "record before garbage lost");
+    D3DShaderCacheStats stats;
+    d3d_shader_cache_get_stats(cache, &stats);
+    CHECK(stats.recovered_bytes == sizeof(garbage) && stats.entries == 6, "recovered=%llu entries=%u",
+          (unsigned long long)stats.recovered_bytes, stats.entries);
+    d3d_shader_cache_close(cache);
+
+    // 文件头损坏：整个重建
+    const int header_fd = open(cache_file(), O_WRONLY);
+    CHECK(pwrite(header_fd, "XXXX", 4, 0) == 4, "corrupt header");
+    close(header_fd);
+    cache = d3d_shader_cache_open(cache_dir, 0);
+    d3d_shader_cache_get_stats(cache, &stats);
+    CHECK(stats.entries == 0 && cache != NULL, "corrupt header not reset");
+    CHECK(store_shader(cache, 7), "store after reset");
+    d3d_shader_cache_close(cache);
+}
+
+// 超过上限时压缩：最近用过的保留，最久未用的淘汰，重新打开后仍然如此
+static void check_lru_compaction(void) {
+    reset_dir();
+    const uint64_t limit = 4096;
+    D3DShaderDiskCache *cache = d3d_shader_cache_open(cache_dir, limit);
+    D3DShaderBlob blob;
+    uint32_t stored = 0;
+    for (; stored < 20; stored++) {
+        store_shader(cache, stored);
+    }
+    // 反复使用 0..3，其余只写一次
+    for (int round = 0; round < 3; round++) {
+        for (uint32_t n = 0; n < 4; n++) {
+            d3d_shader_cache_lookup(cache, key_for(n, TRANSLATOR_VERSION), &blob);
+        }
+    }
+    D3DShaderCacheStats stats;
+    d3d_shader_cache_get_stats(cache, &stats);
+    const uint64_t compactions_before = stats.compactions;
+    for (; stats.compactions == compactions_before && stored < 200; stored++) {
+        store_shader(cache, stored);
+        d3d_shader_cache_get_stats(cache, &stats);
+    }
+    CHECK(stats.compactions > compactions_before, "no compaction after %u stores", stored);
+    CHECK(stats.file_bytes <= limit, "file %llu bytes over limit", (unsigned long long)stats.file_bytes);
+    CHECK(stats.evictions > 0, "compaction evicted nothing");
+
+    int hot = 0;
+    for (uint32_t n = 0; n < 4; n++) {
+        hot += d3d_shader_cache_lookup(cache, key_for(n, TRANSLATOR_VERSION), &blob) && blob_matches(&blob, n);
+    }
+    CHECK(hot == 4, "%d of 4 hot shaders survived compaction", hot);
+    CHECK(!d3d_shader_cache_lookup(cache, key_for(4, TRANSLATOR_VERSION), &blob), "coldest shader kept");
+    CHECK(d3d_shader_cache_lookup(cache, key_for(stored - 1, TRANSLATOR_VERSION), &blob),
+          "newest shader evicted");
+    const uint32_t entries = stats.entries;
+    d3d_shader_cache_close(cache);
+
+    struct stat st;
+    char temp[320];
+    snprintf(temp, sizeof(temp), "%s.tmp", cache_file());
+    CHECK(stat(temp, &st) != 0, "temporary file left behind");
+
+    cache = d3d_shader_cache_open(cache_dir, limit);
+    d3d_shader_cache_get_stats(cache, &stats);
+    CHECK(stats.entries == entries && stats.recovered_bytes == 0, "reopen after compaction: %u entries, expected %u",
+          stats.entries, entries);
+    hot = 0;
+    for (uint32_t n = 0; n < 4; n++) {
+        hot += d3d_shader_cache_lookup(cache, key_for(n, TRANSLATOR_VERSION), &blob);
+    }
+    CHECK(hot == 4, "hot shaders lost after reopen");
+    d3d_shader_cache_close(cache);
+}
+
+// 冷启动每个着色器都要翻译；热启动打开缓存后全部映射读取
+static void bench_warm_start(void) {
+    reset_dir();
+    char source[256];
+    uint32_t reflection[2];
+
+    double start = now_seconds();
+    D3DShaderDiskCache *cache = d3d_shader_cache_open(cache_dir, 0);
+    for (uint32_t n = 0; n < WARM_SHADERS; n++) {
+        D3DShaderBlob blob;
+        if (!d3d_shader_cache_lookup(cache, key_for(n, TRANSLATOR_VERSION), &blob)) {
+            const uint32_t length = translate(n, source, sizeof(source), reflection);
+            d3d_shader_cache_store(cache, key_for(n, TRANSLATOR_VERSION), source, length, reflection,
+                                   sizeof(reflection));
+        }
+    }
+    d3d_shader_cache_close(cache);
+    const double cold = now_seconds() - start;
+
+    start = now_seconds();
+    cache = d3d_shader_cache_open(cache_dir, 0);
+    const double open_time = now_seconds() - start;
+    int hits = 0;
+    for (uint32_t n = 0; n < WARM_SHADERS; n++) {
+        D3DShaderBlob blob;
+        hits += d3d_shader_cache_lookup(cache, key_for(n, TRANSLATOR_VERSION), &blob);
+    }
+    const double warm = now_seconds() - start;
+    d3d_shader_cache_close(cache);
+
+    CHECK(hits == WARM_SHADERS, "warm start hit %d of %d", hits, WARM_SHADERS);
+    CHECK(warm < cold, "warm start not faster");
+    printf("[ShaderCacheTest] %d 个着色器，文件 %.1f KB\n", WARM_SHADERS, file_size() / 1024.0);
+    printf("[ShaderCacheTest] 冷启动（翻译+写入）: %.2f ms\n", cold * 1e3);
+    printf("[ShaderCacheTest] 热启动（打开 %.2f ms + 查找）: %.2f ms (%.1fx)\n", open_time * 1e3, warm * 1e3,
+           cold / warm);
+}
+
+int main(void) {
+    snprintf(cache_dir, sizeof(cache_dir), "/tmp/d3d_shader_cache_XXXXXX");
+    if (!mkdtemp(cache_dir)) {
+        printf("[ShaderCacheTest] ❌ mkdtemp failed\n");
+        return 1;
+    }
+
+    check_persistence();
+    check_torn_tail();
+    check_lru_compaction();
+    bench_warm_start();
+
+    reset_dir();
+    rmdir(cache_dir);
+
+    if (failures) {
+        printf("[ShaderCacheTest] %d 项检查失败\n", failures);
+        return 1;
+    }
+    printf("[ShaderCacheTest] ✅ all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,203 @@
+// test_wine_handle_table.c - WineHandleTable 编码 / 代数复用 / 类型检查 / 增长 / 统计测试
+// 最后给出每次查找的耗时，供和 NSNumber 装箱 + 字典查找对照
+#include "WineHandleTable.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define STRESS_OPS      200000
+#define STRESS_LIVE     1000
+#define LOOKUP_ROUNDS   20000000
+
+static int failures = 0;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { printf("[HandleTest] ❌ " __VA_ARGS__); printf("\n"); failures++; } \
+} while (0)
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ULL;
+
+static uint64_t next_random(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static int objects[4096];
+
+// 句柄非0、可经32位符号扩展往返、按类型查找，释放后旧句柄失效
+static void check_basic(void) {
+    WineHandleTable *table = wine_handles_create(4);
+    WineHandle window = wine_handles_alloc(table, WINE_HANDLE_WINDOW, &objects[0]);
+    WineHandle dc = wine_handles_alloc(table, WINE_HANDLE_DC, &objects[1]);
+    CHECK(window && dc && window != dc, "alloc failed");
+    CHECK((uint64_t)(int64_t)(int32_t)window == window, "handle 0x%x changes under sign extension", window);
+
+    CHECK(wine_handles_lookup(table, window, WINE_HANDLE_WINDOW) == &objects[0], "window lookup");
+    CHECK(wine_handles_lookup(table, dc, WINE_HANDLE_DC) == &objects[1], "dc lookup");
+    CHECK(wine_handles_lookup(table, dc, WINE_HANDLE_WINDOW) == NULL, "dc accepted as window");
+    CHECK(wine_handles_lookup(table, 0, WINE_HANDLE_WINDOW) == NULL, "null handle resolved");
+    CHECK(wine_handles_lookup(table, window | 0xFFFFF, WINE_HANDLE_WINDOW) == NULL, "out-of-range index resolved");
+    WineHandleType type = WINE_HANDLE_FREE;
+    CHECK(wine_handles_lookup_any(table, dc, &type) == &objects[1] && type == WINE_HANDLE_DC, "lookup_any");
+
+    CHECK(wine_handles_alloc(table, WINE_HANDLE_FREE, &objects[2]) == 0, "FREE type allocated");
+    CHECK(wine_handles_alloc(table, WINE_HANDLE_BRUSH, NULL) == 0, "NULL object allocated");
+
+    CHECK(wine_handles_free(table, window, WINE_HANDLE_DC) == NULL, "freed with wrong type");
+    CHECK(wine_handles_free(table, window, WINE_HANDLE_WINDOW) == &objects[0], "free returned wrong object");
+    CHECK(wine_handles_free(table, window, WINE_HANDLE_WINDOW) == NULL, "double free accepted");
+    CHECK(wine_handles_lookup(table, window, WINE_HANDLE_WINDOW) == NULL, "stale handle resolved");
+
+    WineHandleStats stats;
+    wine_handles_get_stats(table, &stats);
+    CHECK(stats.live[WINE_HANDLE_WINDOW] == 0 && stats.peak[WINE_HANDLE_WINDOW] == 1 &&
+          stats.live[WINE_HANDLE_DC] == 1 && stats.live[WINE_HANDLE_FREE] == 3 && stats.capacity == 4,
+          "stats live window %u dc %u free %u", stats.live[WINE_HANDLE_WINDOW], stats.live[WINE_HANDLE_DC],
+          stats.live[WINE_HANDLE_FREE]);
+    CHECK(stats.stale_lookups == 5, "stale lookups %llu", (unsigned long long)stats.stale_lookups);
+    wine_handles_destroy(table, NULL, NULL);
+}
+
+// 先进先出复用：刚释放的槽位排在其他空闲槽位之后；代数在127后回到1
+static void check_reuse(void) {
+    WineHandleTable *table = wine_handles_create(4);
+    WineHandle handles[4];
+    for (int i = 0; i < 4; i++) {
+        handles[i] = wine_handles_alloc(table, WINE_HANDLE_BRUSH, &objects[i]);
+    }
+    wine_handles_free(table, handles[1], WINE_HANDLE_BRUSH);
+    wine_handles_free(table, handles[3], WINE_HANDLE_BRUSH);
+    WineHandle a = wine_handles_alloc(table, WINE_HANDLE_PEN, &objects[10]);
+    WineHandle b = wine_handles_alloc(table, WINE_HANDLE_PEN, &objects[11]);
+    CHECK((a & 0xFFFFF) == (handles[1] & 0xFFFFF) && (b & 0xFFFFF) == (handles[3] & 0xFFFFF),
+          "reuse order 0x%x 0x%x", a, b);
+    CHECK(a != handles[1] && wine_handles_lookup(table, handles[1], WINE_HANDLE_BRUSH) == NULL,
+          "reused slot kept the old handle valid");
+
+    // 满了以后倍增，已有句柄保持有效
+    WineHandle grown = wine_handles_alloc(table, WINE_HANDLE_FONT, &objects[12]);
+    CHECK(grown && wine_handles_lookup(table, a, WINE_HANDLE_PEN) == &objects[10], "growth broke old handles");
+    CHECK(wine_handles_live_count(table, WINE_HANDLE_FREE) == 3, "free after growth %u",
+          wine_handles_live_count(table, WINE_HANDLE_FREE));
+
+    // 单槽位表反复分配释放：代数 1..127 循环，不出现0
+    WineHandleTable *single = wine_handles_create(1);
+    WineHandle first = wine_handles_alloc(single, WINE_HANDLE_DC, &objects[0]);
+    WineHandle previous = first;
+    bool distinct = true;
+    for (int i = 0; i < WINE_HANDLE_MAX_GENERATION; i++) {
+        wine_handles_free(single, previous, WINE_HANDLE_DC);
+        WineHandle next = wine_handles_alloc(single, WINE_HANDLE_DC, &objects[0]);
+        distinct &= next != previous && (next >> WINE_HANDLE_GENERATION_SHIFT) != 0;
+        previous = next;
+    }
+    CHECK(distinct, "generation reached 0 or repeated early");
+    CHECK(previous == first, "generation did not wrap after %d reuses", WINE_HANDLE_MAX_GENERATION);
+    wine_handles_destroy(single, NULL, NULL);
+    wine_handles_destroy(table, NULL, NULL);
+}
+
+static bool count_visit(WineHandle handle, void *object, void *context) {
+    (void)handle;
+    (void)object;
+    (*(int *)context)++;
+    return true;
+}
+
+static void count_release(void *object, WineHandleType type, void *context) {
+    (void)object;
+    ((int *)context)[type]++;
+}
+
+// 随机分配/释放，与影子表对照；销毁时回调释放剩下的对象
+static void check_stress(void) {
+    WineHandleTable *table = wine_handles_create(0);
+    WineHandle live[STRESS_LIVE] = { 0 };
+    WineHandleType types[STRESS_LIVE];
+    WineHandle retired[64] = { 0 };
+    uint32_t retiredCount = 0;
+    bool consistent = true;
+
+    for (int op = 0; op < STRESS_OPS; op++) {
+        const uint32_t i = (uint32_t)(next_random() % STRESS_LIVE);
+        if (live[i]) {
+            consistent &= wine_handles_free(table, live[i], types[i]) == &objects[i];
+            retired[retiredCount++ % 64] = live[i];
+            live[i] = 0;
+        } else {
+            types[i] = (WineHandleType)(1 + next_random() % (WINE_HANDLE_TYPE_COUNT - 1));
+            live[i] = wine_handles_alloc(table, types[i], &objects[i]);
+            consistent &= live[i] != 0;
+        }
+        // 最近释放的句柄在复用后也不能解析
+        const WineHandle old = retired[next_random() % 64];
+        if (old) {
+            for (uint32_t j = 0; j < STRESS_LIVE; j++) {
+                consistent &= live[j] != old;
+            }
+            consistent &= wine_handles_lookup_any(table, old, NULL) == NULL;
+        }
+    }
+    int expected[WINE_HANDLE_TYPE_COUNT] = { 0 };
+    for (uint32_t i = 0; i < STRESS_LIVE; i++) {
+        if (live[i]) {
+            consistent &= wine_handles_lookup(table, live[i], types[i]) == &objects[i];
+            expected[types[i]]++;
+        }
+    }
+    CHECK(consistent, "table diverged from the shadow table");
+
+    int visited = 0;
+    wine_handles_enumerate(table, WINE_HANDLE_DC, count_visit, &visited);
+    CHECK(visited == expected[WINE_HANDLE_DC] &&
+          wine_handles_live_count(table, WINE_HANDLE_DC) == (uint32_t)expected[WINE_HANDLE_DC],
+          "enumerated %d DCs, expected %d", visited, expected[WINE_HANDLE_DC]);
+
+    WineHandleStats stats;
+    wine_handles_get_stats(table, &stats);
+    CHECK(stats.capacity <= 1024, "capacity grew to %u for %d live objects", stats.capacity, STRESS_LIVE);
+
+    int released[WINE_HANDLE_TYPE_COUNT] = { 0 };
+    wine_handles_destroy(table, count_release, released);
+    CHECK(memcmp(released, expected, sizeof(released)) == 0, "destroy did not release every live object");
+}
+
+static void measure_lookup(void) {
+    WineHandleTable *table = wine_handles_create(0);
+    WineHandle handles[1024];
+    for (int i = 0; i < 1024; i++) {
+        handles[i] = wine_handles_alloc(table, WINE_HANDLE_DC, &objects[i]);
+    }
+    uintptr_t sink = 0;
+    const double start = now_seconds();
+    for (uint32_t i = 0; i < LOOKUP_ROUNDS; i++) {
+        sink += (uintptr_t)wine_handles_lookup(table, handles[(i * 7) & 1023], WINE_HANDLE_DC);
+    }
+    const double elapsed = now_seconds() - start;
+    CHECK(sink != 0, "lookups returned NULL");
+    printf("[HandleTest] %d 次查找 %.2f ns/次\n", LOOKUP_ROUNDS, elapsed * 1e9 / LOOKUP_ROUNDS);
+    wine_handles_destroy(table, NULL, NULL);
+}
+
+int main(void) {
+    check_basic();
+    check_reuse();
+    check_stress();
+    measure_lookup();
+
+    if (failures) {
+        printf("[HandleTest] %d failure(s)\n", failures);
+        return 1;
+    }
+    printf("[HandleTest] ✅ all checks passed\n");
+    return 0;
+}
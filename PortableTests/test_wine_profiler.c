@@ -0,0 +1,311 @@
+// test_wine_profiler.c - 性能标记：登记、嵌套自身耗时、分位数、环覆盖、多线程、Chrome trace 导出与开销
+#include "WineProfiler.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define WORKER_THREADS      4
+#define SPANS_PER_WORKER    20000
+#define OVERHEAD_PAIRS      2000000
+
+static int failures = 0;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { printf("[ProfilerTest] ❌ " __VA_ARGS__); printf("\n"); failures++; } \
+} while (0)
+
+static void spin_ns(uint64_t duration) {
+    uint64_t end = wine_prof_now_ns() + duration;
+    while (wine_prof_now_ns() < end) {
+    }
+}
+
+static void check_intern(void) {
+    WineProfMarker frame = wine_prof_intern("Frame");
+    CHECK(frame != WINE_PROF_INVALID_MARKER, "intern failed");
+    CHECK(wine_prof_intern("Frame") == frame, "same name got a different id");
+    WineProfMarker draw = wine_prof_intern("Draw");
+    CHECK(draw != frame, "different names share an id");
+    CHECK(strcmp(wine_prof_marker_name(draw), "Draw") == 0, "name lookup: '%s'", wine_prof_marker_name(draw));
+    CHECK(wine_prof_intern("") == WINE_PROF_INVALID_MARKER && wine_prof_intern(NULL) == WINE_PROF_INVALID_MARKER,
+          "empty name accepted");
+
+    char long_name[128];
+    memset(long_name, 'x', sizeof(long_name) - 1);
+    long_name[sizeof(long_name) - 1] = '\0';
+    WineProfMarker truncated = wine_prof_intern(long_name);
+    CHECK(truncated != WINE_PROF_INVALID_MARKER && wine_prof_intern(long_name) == truncated, "long name not stable");
+    CHECK(strlen(wine_prof_marker_name(truncated)) == WINE_PROF_MAX_NAME - 1, "long name not truncated");
+
+    // 无效ID上的 begin/end 是空操作
+    wine_prof_begin(WINE_PROF_INVALID_MARKER);
+    wine_prof_end(WINE_PROF_INVALID_MARKER);
+}
+
+// Frame 包含两段 Draw 和一段 Present：Frame 的自身耗时扣除子标记
+static void check_nesting(void) {
+    wine_prof_reset();
+    WineProfMarker frame = wine_prof_intern("Frame");
+    WineProfMarker draw = wine_prof_intern("Draw");
+    WineProfMarker present = wine_prof_intern("Present");
+
+    wine_prof_begin(frame);
+    spin_ns(200000);
+    wine_prof_begin(draw);
+    spin_ns(300000);
+    wine_prof_end(draw);
+    wine_prof_begin(draw);
+    spin_ns(300000);
+    wine_prof_end(draw);
+    wine_prof_begin(present);
+    spin_ns(100000);
+    wine_prof_end(present);
+    wine_prof_end(frame);
+
+    WineProfMarkerStats frame_stats, draw_stats, present_stats;
+    CHECK(wine_prof_get_marker_stats(frame, &frame_stats) && frame_stats.count == 1, "frame not recorded");
+    CHECK(wine_prof_get_marker_stats(draw, &draw_stats) && draw_stats.count == 2, "draw count %llu",
+          (unsigned long long)draw_stats.count);
+    CHECK(wine_prof_get_marker_stats(present, &present_stats) && present_stats.count == 1, "present not recorded");
+    CHECK(frame_stats.total_ns >= 900000, "frame total %llu ns", (unsigned long long)frame_stats.total_ns);
+    CHECK(frame_stats.self_ns == frame_stats.total_ns - draw_stats.total_ns - present_stats.total_ns,
+          "frame self %llu != total - children", (unsigned long long)frame_stats.self_ns);
+    CHECK(draw_stats.self_ns == draw_stats.total_ns, "leaf self time differs from total");
+
+    // end 外层标记时，未结束的内层标记被隐式结束
+    wine_prof_begin(frame);
+    wine_prof_begin(draw);
+    wine_prof_end(frame);
+    wine_prof_end(draw);
+    WineProfCounters counters;
+    wine_prof_get_counters(&counters);
+    CHECK(counters.implicit_ends == 1, "implicit ends %llu", (unsigned long long)counters.implicit_ends);
+    CHECK(counters.unmatched_ends == 1, "unmatched ends %llu", (unsigned long long)counters.unmatched_ends);
+    wine_prof_get_marker_stats(draw, &draw_stats);
+    CHECK(draw_stats.count == 3, "implicitly ended draw not recorded");
+
+    // 超过最大深度的层只保持配对
+    WineProfMarker deep = wine_prof_intern("Deep");
+    for (int i = 0; i < WINE_PROF_MAX_DEPTH + 4; i++) wine_prof_begin(deep);
+    for (int i = 0; i < WINE_PROF_MAX_DEPTH + 4; i++) wine_prof_end(deep);
+    WineProfMarkerStats deep_stats;
+    wine_prof_get_marker_stats(deep, &deep_stats);
+    wine_prof_get_counters(&counters);
+    CHECK(deep_stats.count == WINE_PROF_MAX_DEPTH, "deep count %llu", (unsigned long long)deep_stats.count);
+    CHECK(counters.depth_overflows == 4 && counters.unmatched_ends == 1, "depth overflow accounting");
+
+    // 关闭后不记录
+    wine_prof_set_enabled(false);
+    wine_prof_begin(present);
+    wine_prof_end(present);
+    wine_prof_set_enabled(true);
+    wine_prof_get_marker_stats(present, &present_stats);
+    CHECK(present_stats.count == 1, "recorded while disabled");
+}
+
+// 100个约20µs的样本 + 3个约2ms的样本：p50 落在短样本，p99 落在长样本
+static void check_percentiles(void) {
+    wine_prof_reset();
+    WineProfMarker marker = wine_prof_intern("Percentile");
+    for (int i = 0; i < 100; i++) {
+        wine_prof_begin(marker);
+        spin_ns(20000);
+        wine_prof_end(marker);
+    }
+    for (int i = 0; i < 3; i++) {
+        wine_prof_begin(marker);
+        spin_ns(2000000);
+        wine_prof_end(marker);
+    }
+    WineProfMarkerStats stats;
+    CHECK(wine_prof_get_marker_stats(marker, &stats) && stats.count == 103, "percentile samples missing");
+    CHECK(stats.p50_ns >= 18000 && stats.p50_ns < 200000, "p50 %llu ns", (unsigned long long)stats.p50_ns);
+    CHECK(stats.p99_ns >= 1800000, "p99 %llu ns", (unsigned long long)stats.p99_ns);
+    CHECK(stats.p50_ns <= stats.p95_ns && stats.p95_ns <= stats.p99_ns && stats.p99_ns <= stats.max_ns,
+          "percentiles not ordered");
+    CHECK(stats.min_ns >= 20000 && stats.max_ns >= 2000000, "min/max %llu/%llu", (unsigned long long)stats.min_ns,
+          (unsigned long long)stats.max_ns);
+    printf("[ProfilerTest] 分位数: p50 %.1f µs, p95 %.1f µs, p99 %.1f µs, max %.1f µs\n", stats.p50_ns / 1000.0,
+           stats.p95_ns / 1000.0, stats.p99_ns / 1000.0, stats.max_ns / 1000.0);
+}
+
+// MARK: - Chrome trace
+
+static char *export_to_string(uint64_t *events) {
+    FILE *file = tmpfile();
+    if (!file) return NULL;
+    *events = wine_prof_export_chrome_trace(file);
+    long size = ftell(file);
+    rewind(file);
+    char *text = calloc(1, (size_t)size + 1);
+    if (text && fread(text, 1, (size_t)size, file) != (size_t)size) {
+        free(text);
+        text = NULL;
+    }
+    fclose(file);
+    return text;
+}
+
+static int count_occurrences(const char *text, const char *needle) {
+    int count = 0;
+    for (const char *p = strstr(text, needle); p; p = strstr(p + 1, needle)) count++;
+    return count;
+}
+
+// 括号配对、字符串内的转义都正确（不做完整的JSON解析）
+static int json_balanced(const char *text) {
+    int depth = 0, in_string = 0;
+    for (const char *p = text; *p; p++) {
+        if (in_string) {
+            if (*p == '\\') p++;
+            else if (*p == '"') in_string = 0;
+        } else if (*p == '"') {
+            in_string = 1;
+        } else if (*p == '{' || *p == '[') {
+            depth++;
+        } else if (*p == '}' || *p == ']') {
+            if (--depth < 0) return 0;
+        }
+    }
+    return depth == 0 && !in_string;
+}
+
+static void check_chrome_trace(void) {
+    wine_prof_reset();
+    wine_prof_set_thread_name("main \"render\"");
+    WineProfMarker frame = wine_prof_intern("Frame");
+    WineProfMarker quoted = wine_prof_intern("Draw \"quad\"");
+    wine_prof_begin(frame);
+    wine_prof_begin(quoted);
+    wine_prof_end(quoted);
+    wine_prof_end(frame);
+
+    uint64_t events = 0;
+    char *text = export_to_string(&events);
+    CHECK(text != NULL, "export failed");
+    if (!text) return;
+    CHECK(events == 4, "exported %llu events", (unsigned long long)events);
+    CHECK(strncmp(text, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", 39) == 0, "bad header");
+    CHECK(json_balanced(text), "unbalanced JSON");
+    CHECK(strstr(text, "\"Draw \\\"quad\\\"\"") != NULL, "name not escaped");
+    CHECK(strstr(text, "main \\\"render\\\"") != NULL, "thread name missing");
+    CHECK(count_occurrences(text, "\"ph\":\"B\"") == 2 && count_occurrences(text, "\"ph\":\"E\"") == 2,
+          "begin/end mismatch");
+    free(text);
+
+    // 环被覆盖后只输出能配对的事件：开头那些 begin 已被覆盖的 end 被跳过
+    wine_prof_reset();
+    wine_prof_begin(frame);
+    for (int i = 0; i < WINE_PROF_RING_EVENTS; i++) {
+        wine_prof_begin(quoted);
+        wine_prof_end(quoted);
+    }
+    wine_prof_end(frame);
+    text = export_to_string(&events);
+    if (!text) {
+        CHECK(0, "export after wrap failed");
+        return;
+    }
+    int begins = count_occurrences(text, "\"ph\":\"B\"");
+    int ends = count_occurrences(text, "\"ph\":\"E\"");
+    CHECK(events <= WINE_PROF_RING_EVENTS && begins == ends, "wrapped export %llu events, %d B / %d E",
+          (unsigned long long)events, begins, ends);
+    CHECK(json_balanced(text), "unbalanced JSON after wrap");
+    free(text);
+}
+
+// MARK: - 多线程
+
+static void *worker_main(void *arg) {
+    char name[32];
+    snprintf(name, sizeof(name), "worker %d", (int)(intptr_t)arg);
+    wine_prof_set_thread_name(name);
+    WineProfMarker outer = wine_prof_intern("Worker.Outer");
+    for (int i = 0; i < SPANS_PER_WORKER; i++) {
+        wine_prof_begin(outer);
+        // 各线程并发登记同一批名字，ID必须一致
+        WineProfMarker inner = wine_prof_intern((i & 1) ? "Worker.Odd" : "Worker.Even");
+        wine_prof_begin(inner);
+        wine_prof_end(inner);
+        wine_prof_end(outer);
+    }
+    return NULL;
+}
+
+static void check_threads(void) {
+    wine_prof_reset();
+    pthread_t threads[WORKER_THREADS];
+    for (intptr_t t = 0; t < WORKER_THREADS; t++) {
+        pthread_create(&threads[t], NULL, worker_main, (void *)t);
+    }
+    // 写入进行中反复导出，输出必须始终配对
+    int bad_exports = 0;
+    for (int i = 0; i < 20; i++) {
+        uint64_t events;
+        char *text = export_to_string(&events);
+        if (!text || !json_balanced(text) ||
+            count_occurrences(text, "\"ph\":\"B\"") < count_occurrences(text, "\"ph\":\"E\"")) {
+            bad_exports++;
+        }
+        free(text);
+    }
+    for (int t = 0; t < WORKER_THREADS; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    CHECK(bad_exports == 0, "%d malformed exports during concurrent writes", bad_exports);
+
+    WineProfMarkerStats outer, odd, even;
+    wine_prof_get_marker_stats(wine_prof_intern("Worker.Outer"), &outer);
+    wine_prof_get_marker_stats(wine_prof_intern("Worker.Odd"), &odd);
+    wine_prof_get_marker_stats(wine_prof_intern("Worker.Even"), &even);
+    CHECK(outer.count == WORKER_THREADS * SPANS_PER_WORKER, "outer count %llu", (unsigned long long)outer.count);
+    CHECK(odd.count + even.count == outer.count && odd.count == even.count, "inner counts %llu/%llu",
+          (unsigned long long)odd.count, (unsigned long long)even.count);
+    WineProfCounters counters;
+    wine_prof_get_counters(&counters);
+    CHECK(counters.unmatched_ends == 0 && counters.implicit_ends == 0, "unbalanced spans across threads");
+    CHECK(counters.events == 4ull * WORKER_THREADS * SPANS_PER_WORKER, "event count %llu",
+          (unsigned long long)counters.events);
+}
+
+// begin/end 一对的开销：包含两次取时间、两次写环、一次直方图更新
+static void bench_overhead(void) {
+    wine_prof_reset();
+    WineProfMarker marker = wine_prof_intern("Overhead");
+    uint64_t start = wine_prof_now_ns();
+    for (int i = 0; i < OVERHEAD_PAIRS; i++) {
+        wine_prof_begin(marker);
+        wine_prof_end(marker);
+    }
+    uint64_t elapsed = wine_prof_now_ns() - start;
+    double per_pair = (double)elapsed / OVERHEAD_PAIRS;
+
+    wine_prof_set_enabled(false);
+    start = wine_prof_now_ns();
+    for (int i = 0; i < OVERHEAD_PAIRS; i++) {
+        wine_prof_begin(marker);
+        wine_prof_end(marker);
+    }
+    double disabled = (double)(wine_prof_now_ns() - start) / OVERHEAD_PAIRS;
+    wine_prof_set_enabled(true);
+
+    printf("[ProfilerTest] begin/end 一对: %.1f ns（关闭时 %.1f ns）\n", per_pair, disabled);
+    CHECK(per_pair < 2000.0, "marker pair costs %.1f ns", per_pair);
+}
+
+int main(void) {
+    check_intern();
+    check_nesting();
+    check_percentiles();
+    check_chrome_trace();
+    check_threads();
+    bench_overhead();
+
+    if (failures == 0) {
+        printf("[ProfilerTest] ✅ all checks passed\n");
+        return 0;
+    }
+    printf("[ProfilerTest] %d check(s) failed\n", failures);
+    return 1;
+}
@@ -0,0 +1,407 @@
+// ARM64Emitter.c - AArch64指令编码实现
+// 编码依据 Arm ARM A64 指令集章节，每个编码在 PortableTests 中有对照字节
+#include "ARM64Emitter.h"
+
+#define SF(is64) ((is64) ? 0x80000000u : 0u)
+#define REG(r)   ((uint32_t)(r) & 0x1F)
+
+void arm64_buffer_init(ARM64CodeBuffer *buf, uint32_t *storage, size_t capacity) {
+    buf->code = storage;
+    buf->capacity = capacity;
+    buf->count = 0;
+    buf->overflow = false;
+}
+
+void arm64_emit(ARM64CodeBuffer *buf, uint32_t word) {
+    if (buf->count >= buf->capacity) {
+        buf->overflow = true;
+        return;
+    }
+    buf->code[buf->count++] = word;
+}
+
+// MARK: - 数据传送
+
+static void emit_move_wide(ARM64CodeBuffer *buf, uint32_t opc, bool is64, uint8_t rd, uint16_t imm16, uint8_t shift) {
+    uint32_t hw = (uint32_t)(shift / 16) & (is64 ? 3 : 1);
+    arm64_emit(buf, SF(is64) | opc | (hw << 21) | ((uint32_t)imm16 << 5) | REG(rd));
+}
+
+void arm64_movz(ARM64CodeBuffer *buf, bool is64, uint8_t rd, uint16_t imm16, uint8_t shift) {
+    emit_move_wide(buf, 0x52800000u, is64, rd, imm16, shift);
+}
+
+void arm64_movk(ARM64CodeBuffer *buf, bool is64, uint8_t rd, uint16_t imm16, uint8_t shift) {
+    emit_move_wide(buf, 0x72800000u, is64, rd, imm16, shift);
+}
+
+void arm64_movn(ARM64CodeBuffer *buf, bool is64, uint8_t rd, uint16_t imm16, uint8_t shift) {
+    emit_move_wide(buf, 0x12800000u, is64, rd, imm16, shift);
+}
+
+void arm64_mov_imm(ARM64CodeBuffer *buf, bool is64, uint8_t rd, uint64_t value) {
+    const int halves = is64 ? 4 : 2;
+    if (!is64) {
+        value &= 0xFFFFFFFFULL;
+    }
+
+    // 0xFFFF半字多于0半字时用MOVN起头更短
+    int zeros = 0, ones = 0;
+    for (int i = 0; i < halves; i++) {
+        uint16_t half = (uint16_t)(value >> (i * 16));
+        zeros += (half == 0);
+        ones += (half == 0xFFFF);
+    }
+    const bool inverted = ones > zeros;
+    const uint16_t filler = inverted ? 0xFFFF : 0;
+
+    bool first = true;
+    for (int i = 0; i < halves; i++) {
+        uint16_t half = (uint16_t)(value >> (i * 16));
+        if (half == filler) {
+            continue;
+        }
+        if (first) {
+            if (inverted) {
+                arm64_movn(buf, is64, rd, (uint16_t)~half, (uint8_t)(i * 16));
+            } else {
+                arm64_movz(buf, is64, rd, half, (uint8_t)(i * 16));
+            }
+            first = false;
+        } else {
+            arm64_movk(buf, is64, rd, half, (uint8_t)(i * 16));
+        }
+    }
+    if (first) {
+        // 全0或全1
+        if (inverted) {
+            arm64_movn(buf, is64, rd, 0, 0);
+        } else {
+            arm64_movz(buf, is64, rd, 0, 0);
+        }
+    }
+}
+
+void arm64_mov_reg(ARM64CodeBuffer *buf, bool is64, uint8_t rd, uint8_t rm) {
+    arm64_orr_reg(buf, is64, rd, A64_XZR, rm, A64_LSL, 0);
+}
+
+void arm64_mov_sp(ARM64CodeBuffer *buf, uint8_t rd, uint8_t rn) {
+    arm64_add_imm(buf, true, false, rd, rn, 0);
+}
+
+// MARK: - 算术/逻辑
+
+static bool emit_addsub_imm(ARM64CodeBuffer *buf, uint32_t opc, bool is64, bool setflags,
+                            uint8_t rd, uint8_t rn, uint32_t imm) {
+    uint32_t shifted = 0;
+    if (imm > 0xFFF) {
+        if ((imm & 0xFFF) != 0 || imm > 0xFFF000) {
+            return false;
+        }
+        imm >>= 12;
+        shifted = 1;
+    }
+    arm64_emit(buf, SF(is64) | opc | (setflags ? 0x20000000u : 0) | (shifted << 22) |
+                    (imm << 10) | (REG(rn) << 5) | REG(rd));
+    return true;
+}
+
+bool arm64_add_imm(ARM64CodeBuffer *buf, bool is64, bool setflags, uint8_t rd, uint8_t rn, uint32_t imm) {
+    return emit_addsub_imm(buf, 0x11000000u, is64, setflags, rd, rn, imm);
+}
+
+bool arm64_sub_imm(ARM64CodeBuffer *buf, bool is64, bool setflags, uint8_t rd, uint8_t rn, uint32_t imm) {
+    return emit_addsub_imm(buf, 0x51000000u, is64, setflags, rd, rn, imm);
+}
+
+void arm64_add_reg(ARM64CodeBuffer *buf, bool is64, bool setflags, uint8_t rd, uint8_t rn, uint8_t rm) {
+    arm64_emit(buf, SF(is64) | 0x0B000000u | (setflags ? 0x20000000u : 0) |
+                    (REG(rm) << 16) | (REG(rn) << 5) | REG(rd));
+}
+
+void arm64_sub_reg(ARM64CodeBuffer *buf, bool is64, bool setflags, uint8_t rd, uint8_t rn, uint8_t rm) {
+    arm64_emit(buf, SF(is64) | 0x4B000000u | (setflags ? 0x20000000u : 0) |
+                    (REG(rm) << 16) | (REG(rn) << 5) | REG(rd));
+}
+
+// opc: AND=0x0A ORR=0x2A EOR=0x4A ANDS=0x6A（左移24位），N位取反第二操作数
+static void emit_logical_reg(ARM64CodeBuffer *buf, uint32_t opc, bool negate, bool is64,
+                             uint8_t rd, uint8_t rn, uint8_t rm, ARM64Shift shift, uint8_t amount) {
+    arm64_emit(buf, SF(is64) | opc | ((uint32_t)shift << 22) | (negate ? 0x00200000u : 0) |
+                    (REG(rm) << 16) | (((uint32_t)amount & 0x3F) << 10) | (REG(rn) << 5) | REG(rd));
+}
+
+void arm64_and_reg(ARM64CodeBuffer *buf, bool is64, bool setflags, uint8_t rd, uint8_t rn, uint8_t rm) {
+    emit_logical_reg(buf, setflags ? 0x6A000000u : 0x0A000000u, false, is64, rd, rn, rm, A64_LSL, 0);
+}
+
+void arm64_orr_reg(ARM64CodeBuffer *buf, bool is64, uint8_t rd, uint8_t rn, uint8_t rm, ARM64Shift shift, uint8_t amount) {
+    emit_logical_reg(buf, 0x2A000000u, false, is64, rd, rn, rm, shift, amount);
+}
+
+void arm64_eor_reg(ARM64CodeBuffer *buf, bool is64, uint8_t rd, uint8_t rn, uint8_t rm, ARM64Shift shift, uint8_t amount) {
+    emit_logical_reg(buf, 0x4A000000u, false, is64, rd, rn, rm, shift, amount);
+}
+
+void arm64_bic_reg(ARM64CodeBuffer *buf, bool is64, uint8_t rd, uint8_t rn, uint8_t rm) {
+    emit_logical_reg(buf, 0x0A000000u, true, is64, rd, rn, rm, A64_LSL, 0);
+}
+
+// 位图立即数：值必须是某个2/4/.../64位元素的重复，元素为循环移位后的连续1
+bool arm64_encode_logical_imm(uint64_t value, bool is64, uint32_t *encoding) {
+    if (!is64) {
+        value &= 0xFFFFFFFFULL;
+        value |= value << 32;
+    }
+    if (value == 0 || value == ~0ULL) {
+        return false;
+    }
+
+    unsigned size = 64;
+    while (size > 2) {
+        unsigned half = size / 2;
+        uint64_t mask = (1ULL << half) - 1;
+        if ((value & mask) != ((value >> half) & mask)) {
+            break;
+        }
+        size = half;
+    }
+
+    const uint64_t mask = size == 64 ? ~0ULL : ((1ULL << size) - 1);
+    const uint64_t element = value & mask;
+    const unsigned ones = (unsigned)__builtin_popcountll(element);
+    const uint64_t run = ones == 64 ? ~0ULL : ((1ULL << ones) - 1);
+
+    for (unsigned rotation = 0; rotation < size; rotation++) {
+        uint64_t rotated = rotation == 0 ? element
+                         : (((element >> rotation) | (element << (size - rotation))) & mask);
+        if (rotated == run) {
+            uint32_t n = size == 64 ? 1 : 0;
+            uint32_t immr = (size - rotation) & (size - 1);
+            uint32_t imms = ((~(size * 2 - 1)) & 0x3F) | (ones - 1);
+            *encoding = (n << 12) | (immr << 6) | imms;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool emit_logical_imm(ARM64CodeBuffer *buf, uint32_t opc, bool is64, uint8_t rd, uint8_t rn, uint64_t value) {
+    uint32_t encoding;
+    if (!arm64_encode_logical_imm(value, is64, &encoding)) {
+        return false;
+    }
+    arm64_emit(buf, SF(is64) | opc | (encoding << 10) | (REG(rn) << 5) | REG(rd));
+    return true;
+}
+
+bool arm64_and_imm(ARM64CodeBuffer *buf, bool is64, bool setflags, uint8_t rd, uint8_t rn, uint64_t value) {
+    return emit_logical_imm(buf, setflags ? 0x72000000u : 0x12000000u, is64, rd, rn, value);
+}
+
+bool arm64_orr_imm(ARM64CodeBuffer *buf, bool is64, uint8_t rd, uint8_t rn, uint64_t value) {
+    return emit_logical_imm(buf, 0x32000000u, is64, rd, rn, value);
+}
+
+bool arm64_eor_imm(ARM64CodeBuffer *buf, bool is64, uint8_t rd, uint8_t rn, uint64_t value) {
+    return emit_logical_imm(buf, 0x52000000u, is64, rd, rn, value);
+}
+
+void arm64_lslv(ARM64CodeBuffer *buf, bool is64, uint8_t rd, uint8_t rn, uint8_t rm) {
+    arm64_emit(buf, SF(is64) | 0x1AC02000u | (REG(rm) << 16) | (REG(rn) << 5) | REG(rd));
+}
+
+void arm64_ubfx(ARM64CodeBuffer *buf, bool is64, uint8_t rd, uint8_t rn, uint8_t lsb, uint8_t width) {
+    // UBFM rd, rn, #lsb, #(lsb + width - 1)
+    uint32_t base = is64 ? 0xD3400000u : 0x53000000u;
+    arm64_emit(buf, base | ((uint32_t)lsb << 16) | ((uint32_t)(lsb + width - 1) << 10) | (REG(rn) << 5) | REG(rd));
+}
+
+void arm64_cset(ARM64CodeBuffer *buf, bool is64, uint8_t rd, ARM64Cond cond) {
+    // CSINC rd, zr, zr, invert(cond)
+    arm64_emit(buf, SF(is64) | 0x1A9F07E0u | ((uint32_t)(cond ^ 1) << 12) | REG(rd));
+}
+
+// MARK: - 访存
+
+void arm64_ldr_imm(ARM64CodeBuffer *buf, bool is64, uint8_t rt, uint8_t rn, uint32_t offset) {
+    uint32_t scale = is64 ? 3 : 2;
+    if ((offset & ((1u << scale) - 1)) || (offset >> scale) > 0xFFF) {
+        buf->overflow = true;
+        return;
+    }
+    arm64_emit(buf, (is64 ? 0xF9400000u : 0xB9400000u) | ((offset >> scale) << 10) | (REG(rn) << 5) | REG(rt));
+}
+
+void arm64_str_imm(ARM64CodeBuffer *buf, bool is64, uint8_t rt, uint8_t rn, uint32_t offset) {
+    uint32_t scale = is64 ? 3 : 2;
+    if ((offset & ((1u << scale) - 1)) || (offset >> scale) > 0xFFF) {
+        buf->overflow = true;
+        return;
+    }
+    arm64_emit(buf, (is64 ? 0xF9000000u : 0xB9000000u) | ((offset >> scale) << 10) | (REG(rn) << 5) | REG(rt));
+}
+
+static void emit_pair(ARM64CodeBuffer *buf, uint32_t opc, uint8_t rt, uint8_t rt2, uint8_t rn, int32_t offset) {
+    if ((offset & 7) || offset < -512 || offset > 504) {
+        buf->overflow = true;
+        return;
+    }
+    uint32_t imm7 = (uint32_t)(offset / 8) & 0x7F;
+    arm64_emit(buf, opc | (imm7 << 15) | (REG(rt2) << 10) | (REG(rn) << 5) | REG(rt));
+}
+
+void arm64_stp_pre(ARM64CodeBuffer *buf, uint8_t rt, uint8_t rt2, uint8_t rn, int32_t offset) {
+    emit_pair(buf, 0xA9800000u, rt, rt2, rn, offset);
+}
+
+void arm64_ldp_post(ARM64CodeBuffer *buf, uint8_t rt, uint8_t rt2, uint8_t rn, int32_t offset) {
+    emit_pair(buf, 0xA8C00000u, rt, rt2, rn, offset);
+}
+
+void arm64_stp_off(ARM64CodeBuffer *buf, uint8_t rt, uint8_t rt2, uint8_t rn, int32_t offset) {
+    emit_pair(buf, 0xA9000000u, rt, rt2, rn, offset);
+}
+
+void arm64_ldp_off(ARM64CodeBuffer *buf, uint8_t rt, uint8_t rt2, uint8_t rn, int32_t offset) {
+    emit_pair(buf, 0xA9400000u, rt, rt2, rn, offset);
+}
+
+void arm64_ldrb_imm(ARM64CodeBuffer *buf, uint8_t rt, uint8_t rn, uint32_t offset) {
+    if (offset > 0xFFF) {
+        buf->overflow = true;
+        return;
+    }
+    arm64_emit(buf, 0x39400000u | (offset << 10) | (REG(rn) << 5) | REG(rt));
+}
+
+void arm64_strb_imm(ARM64CodeBuffer *buf, uint8_t rt, uint8_t rn, uint32_t offset) {
+    if (offset > 0xFFF) {
+        buf->overflow = true;
+        return;
+    }
+    arm64_emit(buf, 0x39000000u | (offset << 10) | (REG(rn) << 5) | REG(rt));
+}
+
+// MARK: - 标量双精度浮点
+
+void arm64_ldr_d_reg(ARM64CodeBuffer *buf, uint8_t vt, uint8_t rn, uint8_t rm) {
+    arm64_emit(buf, 0xFC607800u | (REG(rm) << 16) | (REG(rn) << 5) | REG(vt));
+}
+
+void arm64_str_d_reg(ARM64CodeBuffer *buf, uint8_t vt, uint8_t rn, uint8_t rm) {
+    arm64_emit(buf, 0xFC207800u | (REG(rm) << 16) | (REG(rn) << 5) | REG(vt));
+}
+
+void arm64_fmov_d(ARM64CodeBuffer *buf, uint8_t vd, uint8_t vn) {
+    arm64_emit(buf, 0x1E604000u | (REG(vn) << 5) | REG(vd));
+}
+
+void arm64_fmov_d_from_x(ARM64CodeBuffer *buf, uint8_t vd, uint8_t rn) {
+    arm64_emit(buf, 0x9E670000u | (REG(rn) << 5) | REG(vd));
+}
+
+// 双精度二元运算：opcode 字段 FMUL=0 FDIV=1 FADD=2 FSUB=3
+static void emit_fp_binary(ARM64CodeBuffer *buf, uint32_t opcode, uint8_t vd, uint8_t vn, uint8_t vm) {
+    arm64_emit(buf, 0x1E600800u | (opcode << 12) | (REG(vm) << 16) | (REG(vn) << 5) | REG(vd));
+}
+
+void arm64_fadd_d(ARM64CodeBuffer *buf, uint8_t vd, uint8_t vn, uint8_t vm) {
+    emit_fp_binary(buf, 2, vd, vn, vm);
+}
+
+void arm64_fsub_d(ARM64CodeBuffer *buf, uint8_t vd, uint8_t vn, uint8_t vm) {
+    emit_fp_binary(buf, 3, vd, vn, vm);
+}
+
+void arm64_fmul_d(ARM64CodeBuffer *buf, uint8_t vd, uint8_t vn, uint8_t vm) {
+    emit_fp_binary(buf, 0, vd, vn, vm);
+}
+
+void arm64_fdiv_d(ARM64CodeBuffer *buf, uint8_t vd, uint8_t vn, uint8_t vm) {
+    emit_fp_binary(buf, 1, vd, vn, vm);
+}
+
+void arm64_fneg_d(ARM64CodeBuffer *buf, uint8_t vd, uint8_t vn) {
+    arm64_emit(buf, 0x1E614000u | (REG(vn) << 5) | REG(vd));
+}
+
+void arm64_fabs_d(ARM64CodeBuffer *buf, uint8_t vd, uint8_t vn) {
+    arm64_emit(buf, 0x1E60C000u | (REG(vn) << 5) | REG(vd));
+}
+
+// MARK: - 控制流
+
+static inline int64_t branch_delta(const ARM64CodeBuffer *buf, size_t target) {
+    return (int64_t)target - (int64_t)buf->count;
+}
+
+void arm64_b(ARM64CodeBuffer *buf, size_t target) {
+    arm64_emit(buf, 0x14000000u | ((uint32_t)branch_delta(buf, target) & 0x03FFFFFF));
+}
+
+void arm64_b_cond(ARM64CodeBuffer *buf, ARM64Cond cond, size_t target) {
+    arm64_emit(buf, 0x54000000u | (((uint32_t)branch_delta(buf, target) & 0x7FFFF) << 5) | (uint32_t)cond);
+}
+
+void arm64_cbz(ARM64CodeBuffer *buf, bool is64, uint8_t rt, size_t target) {
+    arm64_emit(buf, SF(is64) | 0x34000000u | (((uint32_t)branch_delta(buf, target) & 0x7FFFF) << 5) | REG(rt));
+}
+
+void arm64_cbnz(ARM64CodeBuffer *buf, bool is64, uint8_t rt, size_t target) {
+    arm64_emit(buf, SF(is64) | 0x35000000u | (((uint32_t)branch_delta(buf, target) & 0x7FFFF) << 5) | REG(rt));
+}
+
+static void emit_test_branch(ARM64CodeBuffer *buf, uint32_t opc, uint8_t rt, uint8_t bit, size_t target) {
+    arm64_emit(buf, opc | ((uint32_t)(bit >> 5) << 31) | ((uint32_t)(bit & 0x1F) << 19) |
+                    (((uint32_t)branch_delta(buf, target) & 0x3FFF) << 5) | REG(rt));
+}
+
+void arm64_tbz(ARM64CodeBuffer *buf, uint8_t rt, uint8_t bit, size_t target) {
+    emit_test_branch(buf, 0x36000000u, rt, bit, target);
+}
+
+void arm64_tbnz(ARM64CodeBuffer *buf, uint8_t rt, uint8_t bit, size_t target) {
+    emit_test_branch(buf, 0x37000000u, rt, bit, target);
+}
+
+void arm64_blr(ARM64CodeBuffer *buf, uint8_t rn) {
+    arm64_emit(buf, 0xD63F0000u | ((uint32_t)(rn & 31) << 5));
+}
+
+void arm64_ret(ARM64CodeBuffer *buf) {
+    arm64_emit(buf, ARM64_RET_WORD);
+}
+
+void arm64_nop(ARM64CodeBuffer *buf) {
+    arm64_emit(buf, ARM64_NOP_WORD);
+}
+
+void arm64_patch_branch(ARM64CodeBuffer *buf, size_t at, size_t target) {
+    if (at >= buf->count) {
+        buf->overflow = true;
+        return;
+    }
+    uint32_t word = buf->code[at];
+    int64_t delta = (int64_t)target - (int64_t)at;
+
+    if ((word & 0x7C000000u) == 0x14000000u) {                 // B
+        if (delta < -(1 << 25) || delta >= (1 << 25)) goto out_of_range;
+        word = (word & 0xFC000000u) | ((uint32_t)delta & 0x03FFFFFF);
+    } else if ((word & 0x7E000000u) == 0x36000000u) {          // TBZ/TBNZ
+        if (delta < -(1 << 13) || delta >= (1 << 13)) goto out_of_range;
+        word = (word & ~(0x3FFFu << 5)) | (((uint32_t)delta & 0x3FFF) << 5);
+    } else if ((word & 0xFF000010u) == 0x54000000u ||           // B.cond
+               (word & 0x7E000000u) == 0x34000000u) {          // CBZ/CBNZ
+        if (delta < -(1 << 18) || delta >= (1 << 18)) goto out_of_range;
+        word = (word & ~(0x7FFFFu << 5)) | (((uint32_t)delta & 0x7FFFF) << 5);
+    } else {
+        goto out_of_range;
+    }
+    buf->code[at] = word;
+    return;
+
+out_of_range:
+    buf->overflow = true;
+}
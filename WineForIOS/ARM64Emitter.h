@@ -0,0 +1,142 @@
+// ARM64Emitter.h - AArch64指令编码器
+// 纯C实现，只负责生成指令字，不涉及可执行内存（由 IOSJITEngine 负责W^X切换）
+// 可在任意主机上编译并对照已知字节序列测试（见 PortableTests/test_arm64_jit.c）
+#ifndef ARM64_EMITTER_H
+#define ARM64_EMITTER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 通用寄存器编号；31在不同指令中表示XZR或SP
+enum {
+    A64_X0 = 0, A64_X1, A64_X2, A64_X3, A64_X4, A64_X5, A64_X6, A64_X7,
+    A64_X8, A64_X9, A64_X10, A64_X11, A64_X12, A64_X13, A64_X14, A64_X15,
+    A64_X16, A64_X17, A64_X18, A64_X19, A64_X20, A64_X21, A64_X22, A64_X23,
+    A64_X24, A64_X25, A64_X26, A64_X27, A64_X28, A64_FP = 29, A64_LR = 30,
+    A64_SP = 31, A64_XZR = 31
+};
+
+// 条件码
+typedef enum ARM64Cond {
+    A64_COND_EQ = 0, A64_COND_NE, A64_COND_HS, A64_COND_LO,
+    A64_COND_MI, A64_COND_PL, A64_COND_VS, A64_COND_VC,
+    A64_COND_HI, A64_COND_LS, A64_COND_GE, A64_COND_LT,
+    A64_COND_GT, A64_COND_LE, A64_COND_AL
+} ARM64Cond;
+
+// 移位类型（移位寄存器操作数）
+typedef enum ARM64Shift {
+    A64_LSL = 0, A64_LSR, A64_ASR, A64_ROR
+} ARM64Shift;
+
+#define ARM64_NOP_WORD  0xD503201Fu
+#define ARM64_RET_WORD  0xD65F03C0u
+
+// 代码缓冲区：越界后只置 overflow，不再写入，由调用方在结束时统一检查
+typedef struct ARM64CodeBuffer {
+    uint32_t *code;
+    size_t capacity;        // 以指令字计
+    size_t count;
+    bool overflow;
+} ARM64CodeBuffer;
+
+void arm64_buffer_init(ARM64CodeBuffer *buf, uint32_t *storage, size_t capacity);
+void arm64_emit(ARM64CodeBuffer *buf, uint32_t word);
+
+static inline size_t arm64_buffer_size_bytes(const ARM64CodeBuffer *buf) {
+    return buf->count * sizeof(uint32_t);
+}
+
+// MARK: - 数据传送
+
+void arm64_movz(ARM64CodeBuffer *buf, bool is64, uint8_t rd, uint16_t imm16, uint8_t shift);
+void arm64_movk(ARM64CodeBuffer *buf, bool is64, uint8_t rd, uint16_t imm16, uint8_t shift);
+void arm64_movn(ARM64CodeBuffer *buf, bool is64, uint8_t rd, uint16_t imm16, uint8_t shift);
+// 用最短的 MOVZ/MOVN + MOVK 序列装入任意常量
+void arm64_mov_imm(ARM64CodeBuffer *buf, bool is64, uint8_t rd, uint64_t value);
+// MOV rd, rm（ORR rd, zr, rm）；32位形式会零扩展高32位
+void arm64_mov_reg(ARM64CodeBuffer *buf, bool is64, uint8_t rd, uint8_t rm);
+// MOV rd|sp, rn|sp（ADD #0）
+void arm64_mov_sp(ARM64CodeBuffer *buf, uint8_t rd, uint8_t rn);
+
+// MARK: - 算术/逻辑
+
+// ADD/SUB/ADDS/SUBS 立即数；imm12 超出范围时返回 false 且不生成代码
+bool arm64_add_imm(ARM64CodeBuffer *buf, bool is64, bool setflags, uint8_t rd, uint8_t rn, uint32_t imm);
+bool arm64_sub_imm(ARM64CodeBuffer *buf, bool is64, bool setflags, uint8_t rd, uint8_t rn, uint32_t imm);
+void arm64_add_reg(ARM64CodeBuffer *buf, bool is64, bool setflags, uint8_t rd, uint8_t rn, uint8_t rm);
+void arm64_sub_reg(ARM64CodeBuffer *buf, bool is64, bool setflags, uint8_t rd, uint8_t rn, uint8_t rm);
+
+// 逻辑运算（移位寄存器形式）
+void arm64_and_reg(ARM64CodeBuffer *buf, bool is64, bool setflags, uint8_t rd, uint8_t rn, uint8_t rm);
+void arm64_orr_reg(ARM64CodeBuffer *buf, bool is64, uint8_t rd, uint8_t rn, uint8_t rm, ARM64Shift shift, uint8_t amount);
+void arm64_eor_reg(ARM64CodeBuffer *buf, bool is64, uint8_t rd, uint8_t rn, uint8_t rm, ARM64Shift shift, uint8_t amount);
+void arm64_bic_reg(ARM64CodeBuffer *buf, bool is64, uint8_t rd, uint8_t rn, uint8_t rm);
+
+// 逻辑立即数（位图编码）；value 不可编码时返回 false 且不生成代码
+bool arm64_encode_logical_imm(uint64_t value, bool is64, uint32_t *encoding);
+bool arm64_and_imm(ARM64CodeBuffer *buf, bool is64, bool setflags, uint8_t rd, uint8_t rn, uint64_t value);
+bool arm64_orr_imm(ARM64CodeBuffer *buf, bool is64, uint8_t rd, uint8_t rn, uint64_t value);
+bool arm64_eor_imm(ARM64CodeBuffer *buf, bool is64, uint8_t rd, uint8_t rn, uint64_t value);
+
+// LSL rd, rn, rm（LSLV，移位量取 rm 的低6/5位）
+void arm64_lslv(ARM64CodeBuffer *buf, bool is64, uint8_t rd, uint8_t rn, uint8_t rm);
+
+// UBFX rd, rn, #lsb, #width
+void arm64_ubfx(ARM64CodeBuffer *buf, bool is64, uint8_t rd, uint8_t rn, uint8_t lsb, uint8_t width);
+// CSET rd, cond
+void arm64_cset(ARM64CodeBuffer *buf, bool is64, uint8_t rd, ARM64Cond cond);
+
+// MARK: - 访存（无符号偏移 / 成对）
+
+void arm64_ldr_imm(ARM64CodeBuffer *buf, bool is64, uint8_t rt, uint8_t rn, uint32_t offset);
+void arm64_str_imm(ARM64CodeBuffer *buf, bool is64, uint8_t rt, uint8_t rn, uint32_t offset);
+void arm64_stp_pre(ARM64CodeBuffer *buf, uint8_t rt, uint8_t rt2, uint8_t rn, int32_t offset);
+void arm64_ldp_post(ARM64CodeBuffer *buf, uint8_t rt, uint8_t rt2, uint8_t rn, int32_t offset);
+void arm64_stp_off(ARM64CodeBuffer *buf, uint8_t rt, uint8_t rt2, uint8_t rn, int32_t offset);
+void arm64_ldp_off(ARM64CodeBuffer *buf, uint8_t rt, uint8_t rt2, uint8_t rn, int32_t offset);
+// LDRB/STRB wt, [rn, #offset]
+void arm64_ldrb_imm(ARM64CodeBuffer *buf, uint8_t rt, uint8_t rn, uint32_t offset);
+void arm64_strb_imm(ARM64CodeBuffer *buf, uint8_t rt, uint8_t rn, uint32_t offset);
+
+// MARK: - 标量双精度浮点（V寄存器编号 0-31，只用低64位 Dn）
+
+// LDR/STR dt, [rn, rm, LSL #3]
+void arm64_ldr_d_reg(ARM64CodeBuffer *buf, uint8_t vt, uint8_t rn, uint8_t rm);
+void arm64_str_d_reg(ARM64CodeBuffer *buf, uint8_t vt, uint8_t rn, uint8_t rm);
+// FMOV dd, dn / FMOV dd, xn（按位搬运）
+void arm64_fmov_d(ARM64CodeBuffer *buf, uint8_t vd, uint8_t vn);
+void arm64_fmov_d_from_x(ARM64CodeBuffer *buf, uint8_t vd, uint8_t rn);
+void arm64_fadd_d(ARM64CodeBuffer *buf, uint8_t vd, uint8_t vn, uint8_t vm);
+void arm64_fsub_d(ARM64CodeBuffer *buf, uint8_t vd, uint8_t vn, uint8_t vm);
+void arm64_fmul_d(ARM64CodeBuffer *buf, uint8_t vd, uint8_t vn, uint8_t vm);
+void arm64_fdiv_d(ARM64CodeBuffer *buf, uint8_t vd, uint8_t vn, uint8_t vm);
+void arm64_fneg_d(ARM64CodeBuffer *buf, uint8_t vd, uint8_t vn);
+void arm64_fabs_d(ARM64CodeBuffer *buf, uint8_t vd, uint8_t vn);
+
+// MARK: - 控制流
+// 分支目标以指令字下标表示；目标未知时先传当前位置，之后用 arm64_patch_branch 回填
+
+void arm64_b(ARM64CodeBuffer *buf, size_t target);
+void arm64_b_cond(ARM64CodeBuffer *buf, ARM64Cond cond, size_t target);
+void arm64_cbz(ARM64CodeBuffer *buf, bool is64, uint8_t rt, size_t target);
+void arm64_cbnz(ARM64CodeBuffer *buf, bool is64, uint8_t rt, size_t target);
+void arm64_tbz(ARM64CodeBuffer *buf, uint8_t rt, uint8_t bit, size_t target);
+void arm64_tbnz(ARM64CodeBuffer *buf, uint8_t rt, uint8_t bit, size_t target);
+void arm64_blr(ARM64CodeBuffer *buf, uint8_t rn);   // 调用宿主C函数，x0-x18与NZCV被破坏
+void arm64_ret(ARM64CodeBuffer *buf);
+void arm64_nop(ARM64CodeBuffer *buf);
+
+// 把 at 处的 B/B.cond/CBZ/CBNZ/TBZ/TBNZ 改为跳到 target；偏移超出范围时置 overflow
+void arm64_patch_branch(ARM64CodeBuffer *buf, size_t at, size_t target);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ARM64_EMITTER_H
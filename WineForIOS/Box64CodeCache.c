@@ -0,0 +1,406 @@
+// Box64CodeCache.c - JIT本机代码缓存实现
+#include "Box64CodeCache.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#define CODE_CACHE_MIN_REGION   (16 * 1024)
+#define CODE_CACHE_MIN_ENTRIES  64
+
+// 区域内的块按偏移递增追加，释放/淘汰只清 live，游标归零时整体丢弃
+typedef struct CodeEntry {
+    uint32_t offset;
+    uint32_t size;
+    uint64_t guest_rip;
+    Box64CodeEvictCallback evict;
+    void *user;
+    bool live;
+} CodeEntry;
+
+typedef struct CodeRegion {
+    uint8_t *base;
+    size_t used;
+    size_t live_bytes;
+    size_t freed_bytes;
+    uint32_t live_blocks;
+    uint32_t pinned_blocks;
+    uint64_t generation;
+    CodeEntry *entries;
+    uint32_t entry_count;
+    uint32_t entry_capacity;
+} CodeRegion;
+
+struct Box64CodeCache {
+    CodeRegion *regions;
+    uint32_t region_count;
+    uint32_t max_regions;
+    int32_t current;                // 正在顺序分配的区域，-1表示还没有
+    size_t region_size;
+    size_t page_size;
+    Box64CodeFlushMode mode;
+    uint32_t flags;
+    Box64CodeCacheStats stats;      // 只维护计数器，容量类字段在 get_stats 时汇总
+};
+
+static size_t host_page_size(void) {
+    const long page = sysconf(_SC_PAGESIZE);
+    return page > 0 ? (size_t)page : 4096;
+}
+
+Box64CodeCache *box64_code_cache_create(size_t region_size, uint32_t max_regions, Box64CodeFlushMode mode,
+                                        uint32_t flags) {
+#ifndef MAP_JIT
+    if (flags & BOX64_CODE_CACHE_MAP_JIT) {
+        return NULL;
+    }
+#endif
+    const size_t page = host_page_size();
+    if (region_size == 0) {
+        region_size = BOX64_CODE_CACHE_DEFAULT_REGION;
+    }
+    if (region_size < CODE_CACHE_MIN_REGION) {
+        region_size = CODE_CACHE_MIN_REGION;
+    }
+    if (region_size > UINT32_MAX) {
+        return NULL;   // 块偏移用32位保存
+    }
+    region_size = (region_size + page - 1) & ~(page - 1);
+    if (max_regions == 0) {
+        max_regions = BOX64_CODE_CACHE_DEFAULT_REGIONS;
+    }
+
+    Box64CodeCache *cache = calloc(1, sizeof(Box64CodeCache));
+    if (!cache) {
+        return NULL;
+    }
+    cache->regions = calloc(max_regions, sizeof(CodeRegion));
+    if (!cache->regions) {
+        free(cache);
+        return NULL;
+    }
+    cache->max_regions = max_regions;
+    cache->current = -1;
+    cache->region_size = region_size;
+    cache->page_size = page;
+    cache->mode = mode;
+    cache->flags = flags;
+    return cache;
+}
+
+void box64_code_cache_destroy(Box64CodeCache *cache) {
+    if (!cache) {
+        return;
+    }
+    for (uint32_t i = 0; i < cache->region_count; i++) {
+        munmap(cache->regions[i].base, cache->region_size);
+        free(cache->regions[i].entries);
+    }
+    free(cache->regions);
+    free(cache);
+}
+
+// MARK: - 区域
+
+static void reset_region(Box64CodeCache *cache, CodeRegion *region) {
+    if (region->used != 0) {
+        cache->stats.region_resets++;
+    }
+    region->used = 0;
+    region->live_bytes = 0;
+    region->freed_bytes = 0;
+    region->live_blocks = 0;
+    region->pinned_blocks = 0;
+    region->entry_count = 0;
+}
+
+static CodeRegion *map_region(Box64CodeCache *cache) {
+    int protection = PROT_READ | PROT_WRITE;
+    int mapping = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_JIT
+    if (cache->flags & BOX64_CODE_CACHE_MAP_JIT) {
+        protection |= PROT_EXEC;
+        mapping |= MAP_JIT;
+    }
+#endif
+    void *base = mmap(NULL, cache->region_size, protection, mapping, -1, 0);
+    if (base == MAP_FAILED) {
+        return NULL;
+    }
+    CodeRegion *region = &cache->regions[cache->region_count++];
+    memset(region, 0, sizeof(CodeRegion));
+    region->base = base;
+    cache->stats.region_maps++;
+    return region;
+}
+
+// 淘汰区域内所有可淘汰块；没有钉住块时游标归零
+static uint32_t evict_region(Box64CodeCache *cache, CodeRegion *region) {
+    uint32_t evicted = 0;
+    for (uint32_t i = 0; i < region->entry_count; i++) {
+        CodeEntry *entry = &region->entries[i];
+        if (!entry->live || !entry->evict) {
+            continue;
+        }
+        entry->live = false;
+        region->live_blocks--;
+        region->live_bytes -= entry->size;
+        region->freed_bytes += entry->size;
+        entry->evict(entry->user, region->base + entry->offset, entry->guest_rip);
+        evicted++;
+    }
+    if (region->live_blocks == 0) {
+        reset_region(cache, region);
+    }
+    cache->stats.evicted_blocks += evicted;
+    return evicted;
+}
+
+static CodeRegion *find_empty_region(Box64CodeCache *cache) {
+    for (uint32_t i = 0; i < cache->region_count; i++) {
+        if (cache->regions[i].used == 0) {
+            return &cache->regions[i];
+        }
+    }
+    return NULL;
+}
+
+static CodeRegion *oldest_evictable_region(Box64CodeCache *cache) {
+    CodeRegion *oldest = NULL;
+    for (uint32_t i = 0; i < cache->region_count; i++) {
+        CodeRegion *region = &cache->regions[i];
+        if (region->pinned_blocks == 0 && (!oldest || region->generation < oldest->generation)) {
+            oldest = region;
+        }
+    }
+    return oldest;
+}
+
+// 当前区域放不下时换一个区域：空区域 → 新映射 → 按模式淘汰
+static CodeRegion *open_region(Box64CodeCache *cache) {
+    CodeRegion *region = find_empty_region(cache);
+    if (!region && cache->region_count < cache->max_regions) {
+        region = map_region(cache);
+    }
+    if (!region && cache->mode == BOX64_CODE_FLUSH_GENERATIONAL) {
+        region = oldest_evictable_region(cache);
+        if (region) {
+            evict_region(cache, region);
+            cache->stats.evicted_regions++;
+        }
+    }
+    if (!region && cache->mode == BOX64_CODE_FLUSH_ALL) {
+        box64_code_cache_flush(cache);
+        region = find_empty_region(cache);
+    }
+    if (!region) {
+        return NULL;
+    }
+    region->generation = ++cache->stats.generation;
+    cache->current = (int32_t)(region - cache->regions);
+    return region;
+}
+
+// MARK: - 分配与释放
+
+static bool append_entry(CodeRegion *region, const CodeEntry *entry) {
+    if (region->entry_count == region->entry_capacity) {
+        const uint32_t capacity = region->entry_capacity ? region->entry_capacity * 2 : CODE_CACHE_MIN_ENTRIES;
+        CodeEntry *entries = realloc(region->entries, capacity * sizeof(CodeEntry));
+        if (!entries) {
+            return false;
+        }
+        region->entries = entries;
+        region->entry_capacity = capacity;
+    }
+    region->entries[region->entry_count++] = *entry;
+    return true;
+}
+
+void *box64_code_cache_alloc(Box64CodeCache *cache, size_t size, uint64_t guest_rip,
+                             Box64CodeEvictCallback evict, void *user) {
+    return box64_code_cache_alloc_aligned(cache, size, BOX64_CODE_CACHE_ALIGN, guest_rip, evict, user);
+}
+
+void *box64_code_cache_alloc_aligned(Box64CodeCache *cache, size_t size, size_t alignment, uint64_t guest_rip,
+                                     Box64CodeEvictCallback evict, void *user) {
+    if (!cache) {
+        return NULL;
+    }
+    if (size == 0 || size > cache->region_size || alignment < BOX64_CODE_CACHE_ALIGN ||
+        (alignment & (alignment - 1)) != 0 || alignment > cache->page_size) {
+        cache->stats.failures++;
+        return NULL;
+    }
+    const size_t mask = alignment - 1;
+    const size_t aligned = (size + BOX64_CODE_CACHE_ALIGN - 1) & ~(size_t)(BOX64_CODE_CACHE_ALIGN - 1);
+
+    // 区域起点按页对齐，对齐不超过一页时区域内偏移对齐即地址对齐
+    CodeRegion *region = cache->current >= 0 ? &cache->regions[cache->current] : NULL;
+    size_t offset = region ? (region->used + mask) & ~mask : 0;
+    if (!region || offset > cache->region_size || aligned > cache->region_size - offset) {
+        region = open_region(cache);
+        if (!region) {
+            cache->stats.failures++;
+            return NULL;
+        }
+        offset = 0;
+    }
+
+    const CodeEntry entry = {
+        .offset = (uint32_t)offset,
+        .size = (uint32_t)size,
+        .guest_rip = guest_rip,
+        .evict = evict,
+        .user = user,
+        .live = true
+    };
+    if (!append_entry(region, &entry)) {
+        cache->stats.failures++;
+        return NULL;
+    }
+    region->used = offset + aligned;
+    region->live_bytes += size;
+    region->live_blocks++;
+    if (!evict) {
+        region->pinned_blocks++;
+    }
+    cache->stats.allocations++;
+    return region->base + entry.offset;
+}
+
+static CodeRegion *region_for_address(const Box64CodeCache *cache, const void *address) {
+    const uint8_t *pointer = (const uint8_t *)address;
+    for (uint32_t i = 0; i < cache->region_count; i++) {
+        CodeRegion *region = &cache->regions[i];
+        if (pointer >= region->base && pointer < region->base + region->used) {
+            return region;
+        }
+    }
+    return NULL;
+}
+
+// 偏移不大于 offset 的最后一个块
+static CodeEntry *entry_at_or_before(const CodeRegion *region, uint32_t offset) {
+    uint32_t low = 0;
+    uint32_t high = region->entry_count;
+    while (low < high) {
+        const uint32_t middle = low + (high - low) / 2;
+        if (region->entries[middle].offset <= offset) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low ? &region->entries[low - 1] : NULL;
+}
+
+bool box64_code_cache_free(Box64CodeCache *cache, void *code) {
+    if (!cache || !code) {
+        return false;
+    }
+    CodeRegion *region = region_for_address(cache, code);
+    if (!region) {
+        return false;
+    }
+    const uint32_t offset = (uint32_t)((uint8_t *)code - region->base);
+    CodeEntry *entry = entry_at_or_before(region, offset);
+    if (!entry || entry->offset != offset || !entry->live) {
+        return false;
+    }
+    entry->live = false;
+    region->live_blocks--;
+    region->live_bytes -= entry->size;
+    region->freed_bytes += entry->size;
+    if (!entry->evict) {
+        region->pinned_blocks--;
+    }
+    cache->stats.frees++;
+    if (region->live_blocks == 0) {
+        reset_region(cache, region);
+    }
+    return true;
+}
+
+bool box64_code_cache_find(const Box64CodeCache *cache, const void *address, Box64CodeBlockInfo *info) {
+    if (!cache || !address) {
+        return false;
+    }
+    const CodeRegion *region = region_for_address(cache, address);
+    if (!region) {
+        return false;
+    }
+    const uint32_t offset = (uint32_t)((const uint8_t *)address - region->base);
+    const CodeEntry *entry = entry_at_or_before(region, offset);
+    if (!entry || !entry->live || offset >= entry->offset + entry->size) {
+        return false;
+    }
+    if (info) {
+        info->start = region->base + entry->offset;
+        info->size = entry->size;
+        info->guest_rip = entry->guest_rip;
+        info->generation = region->generation;
+        info->pinned = entry->evict == NULL;
+    }
+    return true;
+}
+
+uint32_t box64_code_cache_flush(Box64CodeCache *cache) {
+    if (!cache) {
+        return 0;
+    }
+    uint32_t evicted = 0;
+    for (uint32_t i = 0; i < cache->region_count; i++) {
+        evicted += evict_region(cache, &cache->regions[i]);
+    }
+    cache->stats.flushes++;
+    return evicted;
+}
+
+// MARK: - 统计
+
+uint32_t box64_code_cache_region_count(const Box64CodeCache *cache) {
+    return cache ? cache->region_count : 0;
+}
+
+bool box64_code_cache_region_info(const Box64CodeCache *cache, uint32_t index, Box64CodeRegionInfo *info) {
+    if (!cache || index >= cache->region_count || !info) {
+        return false;
+    }
+    const CodeRegion *region = &cache->regions[index];
+    info->base = region->base;
+    info->size = cache->region_size;
+    info->used = region->used;
+    info->live_bytes = region->live_bytes;
+    info->freed_bytes = region->freed_bytes;
+    info->live_blocks = region->live_blocks;
+    info->pinned_blocks = region->pinned_blocks;
+    info->generation = region->generation;
+    return true;
+}
+
+void box64_code_cache_get_stats(const Box64CodeCache *cache, Box64CodeCacheStats *stats) {
+    if (!stats) {
+        return;
+    }
+    if (!cache) {
+        memset(stats, 0, sizeof(Box64CodeCacheStats));
+        return;
+    }
+    *stats = cache->stats;
+    stats->regions = cache->region_count;
+    stats->max_regions = cache->max_regions;
+    stats->region_size = cache->region_size;
+    stats->reserved_bytes = cache->region_count * cache->region_size;
+    stats->used_bytes = 0;
+    stats->live_bytes = 0;
+    stats->freed_bytes = 0;
+    stats->live_blocks = 0;
+    for (uint32_t i = 0; i < cache->region_count; i++) {
+        const CodeRegion *region = &cache->regions[i];
+        stats->used_bytes += region->used;
+        stats->live_bytes += region->live_bytes;
+        stats->freed_bytes += region->freed_bytes;
+        stats->live_blocks += region->live_blocks;
+    }
+}
@@ -0,0 +1,110 @@
+// Box64CodeCache.h - JIT本机代码缓存：预留大区域，区域内顺序分配
+// 纯C实现，替代每次分配一次 mmap、用固定数组记录页面的做法：
+//   区域：一次 mmap 预留 region_size（按宿主页对齐），块在区域内按16字节对齐顺序追加，分配不进内核
+//   反查：每个区域按地址顺序记录块（偏移、大小、客户机RIP），本机代码地址 → 客户机RIP 二分查找，
+//         用于把本机代码里的崩溃/缺页归到客户机指令
+//   释放：块可以单独释放（只记账，空洞不复用）；区域里的块全部释放后游标归零，整区复用
+//   淘汰：区域数达到上限且当前区域放不下时，分代模式淘汰最旧的一个区域，整体模式清空整个缓存；
+//         带 evict 回调的块才会被淘汰，淘汰前调用回调，调用方据此清掉指向该块的本机代码指针；
+//         没有回调的块（钉住）一直保留到显式释放，含钉住块的区域不会被整体回收
+// 这里不改页面权限、不写代码区内容（页面此时可能是只读可执行的），W^X 切换和icache失效由调用方负责：
+//   默认区域映射为可读写，调用方用 mprotect 按页切换（同页上的块一起切换）；
+//   BOX64_CODE_CACHE_MAP_JIT 映射为 MAP_JIT 的读写执行区域，调用方按线程切换写保护，不影响其他线程执行
+// 非线程安全，调用方加锁；回调在调用方持锁时执行，回调里不能再调用本模块
+#ifndef BOX64_CODE_CACHE_H
+#define BOX64_CODE_CACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BOX64_CODE_CACHE_ALIGN              16
+#define BOX64_CODE_CACHE_DEFAULT_REGION     (1024 * 1024)
+#define BOX64_CODE_CACHE_DEFAULT_REGIONS    16
+
+// create 的 flags
+#define BOX64_CODE_CACHE_MAP_JIT            0x1u    // 需要宿主支持 MAP_JIT，不支持时 create 失败
+
+typedef enum Box64CodeFlushMode {
+    BOX64_CODE_FLUSH_GENERATIONAL = 0,      // 满时淘汰最旧的区域
+    BOX64_CODE_FLUSH_ALL = 1                // 满时清空整个缓存
+} Box64CodeFlushMode;
+
+// 块被淘汰时调用；code 是块起始地址，之后这段内存会被复用
+typedef void (*Box64CodeEvictCallback)(void *user, void *code, uint64_t guest_rip);
+
+typedef struct Box64CodeBlockInfo {
+    void *start;
+    size_t size;                    // 申请的字节数（不含对齐填充）
+    uint64_t guest_rip;
+    uint64_t generation;            // 所在区域开始使用时的代号，越大越新
+    bool pinned;                    // 没有淘汰回调
+} Box64CodeBlockInfo;
+
+typedef struct Box64CodeRegionInfo {
+    void *base;
+    size_t size;
+    size_t used;                    // 分配游标
+    size_t live_bytes;
+    size_t freed_bytes;             // 已释放但游标归零前不能复用的字节
+    uint32_t live_blocks;
+    uint32_t pinned_blocks;
+    uint64_t generation;
+} Box64CodeRegionInfo;
+
+typedef struct Box64CodeCacheStats {
+    uint32_t regions;               // 已映射的区域数
+    uint32_t max_regions;
+    size_t region_size;
+    size_t reserved_bytes;          // regions * region_size
+    size_t used_bytes;              // 各区域游标之和
+    size_t live_bytes;
+    size_t freed_bytes;
+    uint32_t live_blocks;
+    uint64_t allocations;
+    uint64_t frees;
+    uint64_t failures;              // 放不下（过大或全部钉住）
+    uint64_t region_maps;           // mmap 次数
+    uint64_t region_resets;         // 区域游标归零次数（释放空或淘汰后）
+    uint64_t evicted_regions;
+    uint64_t evicted_blocks;
+    uint64_t flushes;               // 整体清空次数（满时或显式）
+    uint64_t generation;
+} Box64CodeCacheStats;
+
+typedef struct Box64CodeCache Box64CodeCache;
+
+// region_size 为0时使用默认值，向上取整到宿主页大小；max_regions 为0时使用默认值
+Box64CodeCache *box64_code_cache_create(size_t region_size, uint32_t max_regions, Box64CodeFlushMode mode,
+                                        uint32_t flags);
+// 解除全部映射，不调用淘汰回调
+void box64_code_cache_destroy(Box64CodeCache *cache);
+
+// 分配 size 字节（16字节对齐）；evict 为NULL时块被钉住；放不下返回NULL
+void *box64_code_cache_alloc(Box64CodeCache *cache, size_t size, uint64_t guest_rip,
+                             Box64CodeEvictCallback evict, void *user);
+// 同上，起始地址按 alignment（2的幂，16到宿主页大小之间）对齐；size 取整到 alignment 时块独占这些对齐单元（如整页）
+void *box64_code_cache_alloc_aligned(Box64CodeCache *cache, size_t size, size_t alignment, uint64_t guest_rip,
+                                     Box64CodeEvictCallback evict, void *user);
+// code 必须是存活块的起始地址，否则返回false；不调用淘汰回调
+bool box64_code_cache_free(Box64CodeCache *cache, void *code);
+
+// address 落在某个存活块内时填写 info 并返回true
+bool box64_code_cache_find(const Box64CodeCache *cache, const void *address, Box64CodeBlockInfo *info);
+
+// 淘汰全部可淘汰块（调用回调），区域保持映射；返回淘汰的块数
+uint32_t box64_code_cache_flush(Box64CodeCache *cache);
+
+uint32_t box64_code_cache_region_count(const Box64CodeCache *cache);
+bool box64_code_cache_region_info(const Box64CodeCache *cache, uint32_t index, Box64CodeRegionInfo *info);
+void box64_code_cache_get_stats(const Box64CodeCache *cache, Box64CodeCacheStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BOX64_CODE_CACHE_H
@@ -0,0 +1,118 @@
+// Box64Context.h - 客户机CPU执行上下文
+// 纯C定义，Box64Engine（ObjC）与JIT/解释器等C模块共享同一布局，
+// JIT生成的代码按 offsetof 直接读写其中的字段
+#ifndef BOX64_CONTEXT_H
+#define BOX64_CONTEXT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "Box64MMU.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 内存安全常量
+#define MEMORY_GUARD_SIZE 4096
+#define MAX_INSTRUCTIONS_PER_EXECUTION 1000
+#define MIN_VALID_ADDRESS 0x1000
+#define MAX_MEMORY_SIZE (256 * 1024 * 1024)  // 256MB最大内存
+
+// 惰性标志的来源运算；NONE 表示 rflags 中的算术标志已是最新
+typedef enum Box64FlagOp {
+    BOX64_FLAGS_NONE = 0,
+    BOX64_FLAGS_ADD,
+    BOX64_FLAGS_ADC,
+    BOX64_FLAGS_SUB,            // SUB / CMP
+    BOX64_FLAGS_SBB,
+    BOX64_FLAGS_LOGIC,          // AND / OR / XOR / TEST：CF=OF=0
+    BOX64_FLAGS_INC,            // CF 保留在 rflags 中
+    BOX64_FLAGS_DEC
+} Box64FlagOp;
+
+// 惰性标志：算术指令只记录运算类型、操作数和结果，读标志时才计算 CF/PF/AF/ZF/SF/OF
+// JIT生成的代码按 offsetof 写入这些字段，op 与 size 需相邻（一次64位存储）
+typedef struct Box64LazyFlags {
+    uint64_t dst;               // 运算前的目的操作数
+    uint64_t src;               // 源操作数
+    uint64_t result;
+    uint32_t op;                // Box64FlagOp
+    uint32_t size;              // 操作数字节数: 1/2/4/8
+} Box64LazyFlags;
+
+// 128位XMM寄存器，各视图共享同一存储（小端，lane 0 在低地址）
+typedef union Box64Xmm {
+    _Alignas(16) uint8_t u8[16];
+    uint16_t u16[8];
+    uint32_t u32[4];
+    uint64_t u64[2];
+    int32_t i32[4];
+    int64_t i64[2];
+    float f32[4];
+    double f64[2];
+} Box64Xmm;
+
+// MXCSR：复位值屏蔽全部浮点异常、就近舍入
+#define BOX64_MXCSR_DEFAULT     0x1F80
+#define BOX64_MXCSR_RC_SHIFT    13
+#define BOX64_MXCSR_RC_MASK     (3u << BOX64_MXCSR_RC_SHIFT)
+
+// x87 80位扩展精度值：带显式整数位的64位尾数 + 符号位/15位指数
+typedef struct Box64F80 {
+    uint64_t mantissa;
+    uint16_t sign_exponent;
+} Box64F80;
+
+// x87 FPU 状态（Box64X87.c 执行）；寄存器按物理编号存放，ST(i) 是物理寄存器 (top + i) & 7
+typedef struct Box64X87 {
+    double st[8];                       // 快速模式的寄存器值，JIT按 offsetof 以 LDR/STR D 访问
+    Box64F80 st80[8];                   // 80位软件浮点模式的寄存器值
+    uint16_t control;                   // 控制字（舍入、精度、异常屏蔽）
+    uint16_t status;                    // 状态字，TOP 字段不在这里而在 top
+    uint8_t top;
+    uint8_t valid;                      // 位i = 物理寄存器i非空（标记字的简化形式）
+    uint8_t extended;                   // 非0时寄存器值在 st80 中
+} Box64X87;
+
+// CPU执行上下文 - 增强版
+typedef struct Box64Context {
+    uint64_t x86_regs[16];              // x86寄存器状态
+    uint64_t arm64_regs[32];            // ARM64寄存器状态
+    uint64_t rip;                       // 指令指针
+    uint64_t rflags;                    // 标志寄存器（算术标志可能滞后，读取前调用 box64_flags_materialize）
+    Box64LazyFlags lazy_flags;          // 待计算的算术标志
+    uint8_t *memory_base;               // 客户机内存的宿主后备区（页对齐），只经 mmu 访问
+    size_t memory_size;                 // 客户机地址空间大小
+
+    // 内存布局（客户机地址）
+    uint64_t stack_base;                // 栈基址
+    uint64_t stack_size;                // 栈大小
+    uint64_t heap_base;                 // 堆基址
+    uint64_t heap_size;                 // 堆大小
+
+    // 执行安全
+    uint32_t instruction_count;         // 已执行指令数
+    uint32_t max_instructions;          // 最大指令数限制
+    bool is_in_safe_mode;              // 安全模式标志
+
+    // 调试信息
+    uint64_t last_valid_rip;           // 最后有效的RIP
+    char last_instruction[16];          // 最后执行的指令
+
+    // SSE状态（Box64SSE.c 执行），JIT按 offsetof 以 LDR/STR Q 访问
+    Box64Xmm xmm[16];
+    uint32_t mxcsr;
+
+    // x87状态（Box64X87.c 执行）
+    Box64X87 x87;
+
+    // 客户机地址空间（含TLB，体积较大）放在末尾，JIT按 offsetof 访问的字段保持在LDR/STR立即数偏移范围内
+    Box64MMU mmu;
+} Box64Context;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BOX64_CONTEXT_H
@@ -1,15 +1,15 @@
 // Box64Engine.h - 完整的头文件声明
 #import <Foundation/Foundation.h>
 #import "IOSJITEngine.h"
+#import "Box64Context.h"
+#import "X86Decoder.h"
+#import "Box64TranslationCache.h"
+#import "Box64Trace.h"
+#import "Box64PELoader.h"
+#import "Box64Imports.h"
 
 NS_ASSUME_NONNULL_BEGIN
 
-// 内存安全常量
-#define MEMORY_GUARD_SIZE 4096
-#define MAX_INSTRUCTIONS_PER_EXECUTION 1000
-#define MIN_VALID_ADDRESS 0x1000
-#define MAX_MEMORY_SIZE (256 * 1024 * 1024)  // 256MB最大内存
-
 // 🔧 修复：x86寄存器定义 - 确保 X86_RIP 正确定义
 typedef NS_ENUM(NSUInteger, X86Register) {
     X86_RAX = 0, X86_RCX, X86_RDX, X86_RBX,
@@ -31,45 +31,8 @@ typedef NS_ENUM(NSUInteger, ARM64Register) {
     ARM64_X28, ARM64_X29, ARM64_X30, ARM64_SP = 31
 };
 
-// 内存区域结构
-typedef struct MemoryRegion {
-    uint64_t start_address;
-    uint64_t size;
-    BOOL is_allocated;
-    BOOL is_executable;
-    BOOL is_writable;
-    char name[64];
-} MemoryRegion;
-
-// CPU执行上下文 - 增强版
-typedef struct Box64Context {
-    uint64_t x86_regs[16];              // x86寄存器状态
-    uint64_t arm64_regs[32];            // ARM64寄存器状态
-    uint64_t rip;                       // 指令指针
-    uint64_t rflags;                    // 标志寄存器
-    uint8_t *memory_base;               // 内存基址
-    size_t memory_size;                 // 内存大小
-    void *jit_cache;                   // JIT缓存
-    
-    // 内存安全增强
-    MemoryRegion memory_regions[32];    // 内存区域记录
-    uint32_t region_count;              // 区域数量
-    uint64_t stack_base;                // 栈基址
-    uint64_t stack_size;                // 栈大小
-    uint64_t heap_base;                 // 堆基址
-    uint64_t heap_size;                 // 堆大小
-    
-    // 执行安全
-    uint32_t instruction_count;         // 已执行指令数
-    uint32_t max_instructions;          // 最大指令数限制
-    BOOL is_in_safe_mode;              // 安全模式标志
-    
-    // 调试信息
-    uint64_t last_valid_rip;           // 最后有效的RIP
-    char last_instruction[16];          // 最后执行的指令
-} Box64Context;
-
-// 指令解码结果 - 增强版
+// 指令解码结果 - 表驱动解码器输出 + 兼容字段
+// 助记符不再在解码时生成，需要时调用 disassembleInstruction:
 typedef struct X86Instruction {
     uint8_t opcode;                    // 操作码
     uint8_t modrm;                     // ModR/M字节
@@ -85,7 +48,7 @@ typedef struct X86Instruction {
     // 安全检查
     BOOL is_valid;                     // 指令是否有效
     BOOL is_safe;                      // 指令是否安全
-    char mnemonic[32];                 // 助记符
+    X86DecodedInsn insn;               // 完整的操作数形式记录（前缀/REX/ModRM/SIB）
 } X86Instruction;
 
 @interface Box64Engine : NSObject
@@ -93,8 +56,13 @@ typedef struct X86Instruction {
 @property (nonatomic, readonly) Box64Context *context;
 @property (nonatomic, readonly) BOOL isInitialized;
 @property (nonatomic, readonly) BOOL isSafeMode;
-@property (nonatomic, strong) IOSJITEngine *jitEngine;
+@property (nonatomic, readonly) IOSJITEngine *jitEngine;              // 本进程独占的代码缓存，线程引擎共用进程引擎的
+@property (nonatomic, readonly) Box64ThunkRegistry *thunkRegistry;    // 导入的宿主实现，按需注册（加载镜像后注册同样生效）
+@property (nonatomic, readonly) uint32_t guestExitCode;               // 客户机调用 ExitProcess 时的退出码
+@property (nonatomic, assign) BOOL x87ExtendedPrecision;            // x87 用80位软件浮点（默认用 double 的快速模式）
 
+// 进程引擎；客户机 CreateThread 的每个线程在自己的 pthread 上运行一个线程引擎，
+// 共享这里的客户机内存、翻译缓存、导入表和JIT代码区，寄存器和栈各自独立
 + (instancetype)sharedEngine;
 
 // 初始化和清理
@@ -107,16 +75,39 @@ typedef struct X86Instruction {
 - (uint8_t *)allocateMemory:(size_t)size;
 - (uint8_t *)allocateMemoryAt:(uint64_t)address size:(size_t)size;
 - (void)freeMemory:(uint8_t *)memory;
+
+// 客户机堆 - HeapAlloc / VirtualAlloc 的后备，返回客户机地址，失败返回0
+- (uint64_t)allocateGuestHeap:(size_t)size zeroed:(BOOL)zeroed;
+- (BOOL)freeGuestHeap:(uint64_t)address;
+- (size_t)guestHeapBlockSize:(uint64_t)address;
+- (uint64_t)reallocateGuestHeap:(uint64_t)address size:(size_t)size zeroed:(BOOL)zeroed;
+- (uint64_t)allocateGuestPages:(size_t)size executable:(BOOL)executable;
+
 - (BOOL)isValidMemoryAddress:(uint64_t)address size:(size_t)size;
 - (BOOL)mapMemory:(uint64_t)address size:(size_t)size data:(nullable NSData *)data;
 - (BOOL)unmapMemory:(uint64_t)address size:(size_t)size;
 - (BOOL)protectMemory:(uint64_t)address size:(size_t)size executable:(BOOL)executable writable:(BOOL)writable;
 
+// PE镜像 - 按节映射到客户机地址空间，首选基址被占用时从客户机堆取备用基址并重定位
+// 同一时刻只保留一个镜像，加载新镜像前自动卸载旧的
+- (BOOL)loadPEImage:(NSData *)fileData image:(Box64PEImage *)image;
+// 从文件加载：整个文件私有映射，页对齐的节直接映射文件页（写时复制），卸载时关闭映射
+- (BOOL)loadPEImageAtPath:(NSString *)path image:(Box64PEImage *)image;
+- (void)unloadPEImage;
+
+// 导入表 - 加载镜像时IAT项指向陷阱桩，执行到桩时在 thunkRegistry 中查找实现（只在第一次调用时查找）
+- (NSDictionary *)getImportStatistics;
+
+// 翻译缓存 - 原地改写已执行过的代码后需要调用
+- (void)invalidateTranslationCacheInRange:(uint64_t)address size:(size_t)size;
+
 // 🔧 修复：指令执行 - 完整的方法声明
 - (BOOL)executeX86Code:(const uint8_t *)code length:(size_t)length;
 - (BOOL)executeSingleInstruction:(const uint8_t *)instruction;
 - (BOOL)executeWithSafetyCheck:(const uint8_t *)code length:(size_t)length maxInstructions:(uint32_t)maxInstructions;
 - (BOOL)executeWithSafetyCheck:(const uint8_t *)code length:(size_t)length maxInstructions:(uint32_t)maxInstructions baseAddress:(uint64_t)baseAddress;
+// 执行已映射的客户机代码：[codeStart, codeStart+length) 须可执行，从 entryPoint 开始
+- (BOOL)executeGuestCodeAt:(uint64_t)entryPoint codeStart:(uint64_t)codeStart length:(size_t)length maxInstructions:(uint32_t)maxInstructions;
 
 // 🔧 修复：新增的简化执行方法
 - (BOOL)executeX86CodeSimplified:(const uint8_t *)code length:(size_t)length maxInstructions:(uint32_t)maxInstructions baseAddress:(uint64_t)baseAddress;
@@ -132,6 +123,7 @@ typedef struct X86Instruction {
 - (X86Instruction)decodeInstruction:(const uint8_t *)instruction maxLength:(size_t)maxLength;
 - (BOOL)validateInstruction:(const X86Instruction *)instruction;
 - (NSString *)disassembleInstruction:(const X86Instruction *)instruction;
+- (NSString *)disassembleInstruction:(const X86Instruction *)instruction address:(uint64_t)address;
 
 // 调试和状态
 - (void)dumpRegisters;
@@ -140,6 +132,11 @@ typedef struct X86Instruction {
 - (NSDictionary *)getSystemState;
 - (NSString *)getLastError;
 
+// 日志级别/类别（运行时），二进制跟踪环（执行失败时自动导出最近事件）
+- (void)setLogLevel:(Box64LogLevel)level categories:(uint32_t)categories;
+- (void)enableTraceRing:(BOOL)enabled capacity:(uint32_t)capacity;
+- (void)dumpTraceRing:(NSUInteger)maxEvents;
+
 // 🔧 修复：安全检查 - 完整的方法声明
 - (BOOL)performSafetyCheck;
 - (BOOL)performSafetyCheckWithRIP:(uint64_t)rip;
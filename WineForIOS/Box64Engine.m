@@ -1,26 +1,69 @@
 // Box64Engine.m - 修复版：解决JIT执行和ARM64代码生成问题
 #import "Box64Engine.h"
+#import "Box64JIT.h"
+#import "Box64Flags.h"
+#import "Box64Interp.h"
+#import "Box64SSE.h"
+#import "Box64String.h"
+#import "Box64X87.h"
+#import "Box64Heap.h"
+#import "Box64Trace.h"
+#import "Box64Sync.h"
+#import "Box64Thread.h"
+#import "WineHandleTable.h"
 #import <sys/mman.h>
 #import <pthread.h>
+#import <sched.h>
+#import <unistd.h>
 #import <errno.h>
 #import <string.h>
+#import <time.h>
 
-// ARM64指令编码宏 - 修复版本
-#define ARM64_NOP()           0xD503201F
-#define ARM64_RET()           0xD65F03C0
-#define ARM64_MOVZ_X(rd, imm) (0xD2800000 | (((imm) & 0xFFFF) << 5) | ((rd) & 0x1F))
-#define ARM64_ADD_IMM_X(rd, rn, imm) (0x91000000 | (((imm) & 0xFFF) << 10) | (((rn) & 0x1F) << 5) | ((rd) & 0x1F))
-#define ARM64_MOV_W0_ZERO()   0x52800000  // MOV W0, #0
-#define ARM64_STP_X29_X30()   0xA9BF7BFD  // STP X29, X30, [SP, #-16]!
-#define ARM64_MOV_X29_SP()    0x910003FD  // MOV X29, SP
-#define ARM64_LDP_X29_X30()   0xA8C17BFD  // LDP X29, X30, [SP], #16
-
-// x86到ARM64寄存器映射 - 避免使用系统寄存器
-static const ARM64Register x86_to_arm64_mapping[16] = {
-    ARM64_X19, ARM64_X20, ARM64_X21, ARM64_X22, ARM64_X23, ARM64_X24,
-    ARM64_X25, ARM64_X26, ARM64_X8, ARM64_X9, ARM64_X10, ARM64_X11,
-    ARM64_X12, ARM64_X13, ARM64_X14, ARM64_X15
-};
+// 执行失败时自动导出的最近跟踪事件数
+#define BOX64_TRACE_POSTMORTEM_EVENTS 32
+
+// kernel32 常量
+#define WIN32_HEAP_ZERO_MEMORY      0x00000008
+#define WIN32_MEM_RELEASE           0x00008000
+#define WIN32_PAGE_EXECUTE_MASK     0x000000F0
+#define WIN32_CREATE_SUSPENDED      0x00000004
+
+// CreateThread 的 dwStackSize 为0时的客户机栈大小；栈从客户机堆按页分配
+#define BOX64_GUEST_THREAD_STACK_SIZE   (256 * 1024)
+#define BOX64_GUEST_THREAD_STACK_MIN    (16 * 1024)
+#define BOX64_GUEST_THREAD_STACK_MAX    (8 * 1024 * 1024)
+
+// 客户机线程的指令预算：不继承单次执行的上限（默认只有 MAX_INSTRUCTIONS_PER_EXECUTION 条），只拦住失控的线程
+#define BOX64_GUEST_THREAD_MAX_INSTRUCTIONS UINT32_MAX
+
+// 线程入口的 Win64 栈帧：返回地址 + 32字节影子空间，入口处 RSP+8 按16字节对齐
+#define WIN64_ENTRY_FRAME_SIZE      0x28
+
+// cleanup / ExitProcess 之后等待客户机线程退出的时间
+#define BOX64_THREAD_DRAIN_TIMEOUT_MS   2000
+
+// 阻塞的桩（Sleep、等待、进入临界区）每等这么久检查一次 exiting
+#define BOX64_EXIT_POLL_MS              50
+
+// 客户机线程异常结束（执行失败）时的退出码
+#define BOX64_THREAD_FAILURE_EXIT_CODE  0xFFFFFFFFu
+
+// 纯C模块（MMU、堆、JIT等）的日志统一走NSLog
+static void box64_nslog_sink(Box64LogLevel level, uint32_t category, const char *message) {
+    (void)category;
+    NSLog(@"[Box64][%s] %s", box64_log_level_name(level), message);
+}
+
+// 进程内全部客户机线程共享的状态：进程引擎（sharedEngine 或直接 init 的引擎）分配，线程引擎只引用
+// 锁顺序：processState → codeGate → handleLock；持有 codeGate 读锁时不能再等 processState
+typedef struct Box64ProcessShared {
+    Box64RWLock codeGate;               // 翻译缓存和JIT代码区：执行中的线程持读锁，翻译/链接/编译/失效持写锁
+    Box64Mutex processState;            // 页表修改、客户机堆、镜像加载和引擎状态，可重入
+    Box64Lock handleLock;               // 保护 kernelHandles
+    WineHandleTable *kernelHandles;     // CreateThread / CreateEventA 返回的句柄
+    _Atomic uint32_t exiting;           // ExitProcess 或 cleanup：各线程在下一个块边界或阻塞的桩里停止
+    _Atomic uint32_t liveThreads;       // 本进程 runGuestThread 尚未返回的线程数，不为0时不能释放进程内存
+} Box64ProcessShared;
 
 @interface Box64Engine()
 @property (nonatomic, assign) Box64Context *context;
@@ -28,11 +71,442 @@ static const ARM64Register x86_to_arm64_mapping[16] = {
 @property (nonatomic, assign) BOOL isSafeMode;
 @property (nonatomic, strong) NSMutableArray<NSString *> *safetyWarnings;
 @property (nonatomic, strong) NSString *lastError;
-@property (nonatomic, strong) NSRecursiveLock *contextLock;
+@property (nonatomic, strong, nullable) Box64Engine *processEngine;  // 线程引擎所属的进程引擎，进程引擎自身为nil
+@property (nonatomic, assign) Box64ProcessShared *shared;
+@property (nonatomic, assign) Box64ImportTable *imports;         // 进程引擎的 importTable，执行循环经它分派导入桩
 @property (nonatomic, strong) NSMutableSet<NSNumber *> *immediateValueRegisters;
+@property (nonatomic, assign) Box64TranslationCache *translationCache;
+@property (nonatomic, assign) Box64Heap *guestHeap;                // 客户机堆，覆盖 [heap_base, heap_base+heap_size)
+@property (nonatomic, assign) Box64TraceRing *traceRing;           // 二进制跟踪环，NULL表示关闭
+@property (nonatomic, assign) const uint8_t *boundCode;          // 当前翻译缓存对应的代码缓冲区
+@property (nonatomic, assign) size_t boundCodeLength;
+@property (nonatomic, assign) uint64_t boundCodeBase;
+@property (nonatomic, assign) BOOL nativeJITEnabled;             // 生成的ARM64代码能否在本机直接运行
+@property (nonatomic, assign) uint64_t jitCompiledBlocks;
+@property (nonatomic, assign) uint64_t jitNativeExecutions;
+@property (nonatomic, assign) uint64_t interpreterFallbacks;     // 快速解释层交回逐条执行的指令数
+@property (nonatomic, assign) uint64_t loadedImageBase;          // 当前PE镜像，0表示没有
+@property (nonatomic, assign) uint64_t loadedImageSize;
+@property (nonatomic, assign) BOOL loadedImageOnHeap;            // 镜像占用的是客户机堆上的备用区间
+@property (nonatomic, assign) Box64PEFile peFile;                // loadPEImageAtPath 的文件映射，镜像页直接指向它
+@property (nonatomic, assign) Box64ThunkRegistry *thunkRegistry;
+@property (nonatomic, assign) Box64ImportTable importTable;      // 当前镜像的导入槽位，桩区从客户机堆分配
+@property (nonatomic, assign) uint32_t guestExitCode;
+@property (nonatomic, assign) NSUInteger guestCallDepth;         // 本次执行中尚未返回的CALL数，为0时RET结束执行
+@property (nonatomic, assign) uint64_t threadStackBase;          // 线程引擎的客户机栈（从客户机堆分配），0表示没有
+@property (nonatomic, assign) uint64_t threadStart;
+@property (nonatomic, assign) uint32_t threadExitCode;           // ExitThread 的参数
+@property (nonatomic, assign) BOOL threadExitRequested;
+@property (nonatomic, assign) BOOL instructionLimitHit;          // 上一次执行因指令预算用完而停止，不是返回或退出
+
+- (uint64_t)createGuestThreadAt:(uint64_t)start parameter:(uint64_t)parameter stackSize:(uint64_t)stackSize
+                      suspended:(BOOL)suspended threadId:(uint32_t *)threadId;
+- (uint32_t)runGuestThread;
 @end
 
-@implementation Box64Engine
+#pragma mark - kernel32 内存桩
+
+// call->user 为注册桩的进程引擎（注册表随引擎销毁，不持有引用）
+static inline Box64Engine *thunk_engine(Box64ThunkCall *call) {
+    return (__bridge Box64Engine *)call->user;
+}
+
+// 调用线程自己的引擎：客户机线程上是它的线程引擎，宿主线程（executeGuestCodeAt 的调用方）上是进程引擎
+// 改页表的桩要经调用线程的MMU视图修改，修改方自己的TLB才会立即作废
+static inline Box64Engine *thunk_current_engine(Box64ThunkCall *call) {
+    Box64Thread *thread = box64_thread_current();
+    return thread ? (__bridge Box64Engine *)box64_thread_user(thread) : thunk_engine(call);
+}
+
+// 进程堆句柄取堆的起始地址，保证非0
+static uint64_t thunk_GetProcessHeap(Box64ThunkCall *call) {
+    return thunk_engine(call).context->heap_base;
+}
+
+// HeapAlloc(hHeap, dwFlags, dwBytes)
+static uint64_t thunk_HeapAlloc(Box64ThunkCall *call) {
+    return [thunk_current_engine(call) allocateGuestHeap:(size_t)call->args[2]
+                                                  zeroed:(call->args[1] & WIN32_HEAP_ZERO_MEMORY) != 0];
+}
+
+// HeapFree(hHeap, dwFlags, lpMem)：释放NULL视为成功
+static uint64_t thunk_HeapFree(Box64ThunkCall *call) {
+    return call->args[2] == 0 || [thunk_current_engine(call) freeGuestHeap:call->args[2]];
+}
+
+// HeapReAlloc(hHeap, dwFlags, lpMem, dwBytes)
+static uint64_t thunk_HeapReAlloc(Box64ThunkCall *call) {
+    if (call->args[2] == 0) {
+        return 0;
+    }
+    return [thunk_current_engine(call) reallocateGuestHeap:call->args[2] size:(size_t)call->args[3]
+                                                    zeroed:(call->args[1] & WIN32_HEAP_ZERO_MEMORY) != 0];
+}
+
+// HeapSize(hHeap, dwFlags, lpMem)：失败返回 (SIZE_T)-1
+static uint64_t thunk_HeapSize(Box64ThunkCall *call) {
+    size_t size = [thunk_current_engine(call) guestHeapBlockSize:call->args[2]];
+    return size ? size : UINT64_MAX;
+}
+
+// VirtualAlloc(lpAddress, dwSize, flAllocationType, flProtect)：不支持指定地址
+static uint64_t thunk_VirtualAlloc(Box64ThunkCall *call) {
+    if (call->args[0] != 0 || call->args[1] == 0) {
+        return 0;
+    }
+    return [thunk_current_engine(call) allocateGuestPages:(size_t)call->args[1]
+                                               executable:(call->args[3] & WIN32_PAGE_EXECUTE_MASK) != 0];
+}
+
+// VirtualFree(lpAddress, dwSize, dwFreeType)：MEM_DECOMMIT 保留页，直接成功
+static uint64_t thunk_VirtualFree(Box64ThunkCall *call) {
+    if (!(call->args[2] & WIN32_MEM_RELEASE)) {
+        return 1;
+    }
+    return [thunk_current_engine(call) freeGuestHeap:call->args[0]];
+}
+
+// GetModuleHandleA(NULL) 返回当前镜像基址，不支持按名称查找
+static uint64_t thunk_GetModuleHandleA(Box64ThunkCall *call) {
+    return call->args[0] == 0 ? thunk_engine(call).loadedImageBase : 0;
+}
+
+// ExitProcess：调用线程立即结束，其他线程在下一个块边界停止
+static uint64_t thunk_ExitProcess(Box64ThunkCall *call) {
+    Box64Engine *process = thunk_engine(call);
+    process.guestExitCode = (uint32_t)call->args[0];
+    atomic_store(&process.shared->exiting, 1);
+    call->exit_requested = true;
+    return 0;
+}
+
+#pragma mark - kernel32 线程与同步桩
+
+// 桩在执行线程释放翻译缓存读锁后调用，可以阻塞（等待、进入临界区、Sleep）而不挡住其他线程的翻译
+
+static inline Box64ProcessShared *thunk_shared(Box64ThunkCall *call) {
+    return thunk_engine(call).shared;
+}
+
+static uint64_t kernel_monotonic_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000 + (uint64_t)now.tv_nsec / 1000000;
+}
+
+// 等一段（毫秒，不会是 BOX64_INFINITE），返回 BOX64_WAIT_OBJECT_0 或 BOX64_WAIT_TIMEOUT
+typedef uint32_t (*KernelWaitSlice)(void *object, uint32_t timeout_ms);
+
+// 阻塞的桩按 BOX64_EXIT_POLL_MS 分段等待，段间检查 exiting，drain 不用等 INFINITE 的等待自己结束；
+// 进程退出时结束调用线程并返回 BOX64_WAIT_FAILED
+static uint32_t kernel_wait(Box64ThunkCall *call, uint32_t timeout_ms, KernelWaitSlice wait, void *object) {
+    Box64ProcessShared *shared = thunk_shared(call);
+    const uint64_t start = kernel_monotonic_ms();
+    for (;;) {
+        if (atomic_load(&shared->exiting)) {
+            call->exit_requested = true;
+            return BOX64_WAIT_FAILED;
+        }
+        uint32_t slice = BOX64_EXIT_POLL_MS;
+        if (timeout_ms != BOX64_INFINITE) {
+            const uint64_t elapsed = kernel_monotonic_ms() - start;
+            const uint64_t remaining = elapsed < timeout_ms ? timeout_ms - elapsed : 0;
+            slice = (uint32_t)MIN(remaining, (uint64_t)slice);
+        }
+        const uint32_t result = wait(object, slice);
+        if (result != BOX64_WAIT_TIMEOUT ||
+            (timeout_ms != BOX64_INFINITE && kernel_monotonic_ms() - start >= timeout_ms)) {
+            return result;
+        }
+    }
+}
+
+static uint32_t kernel_wait_thread(void *object, uint32_t timeout_ms) {
+    return box64_thread_wait((Box64Thread *)object, timeout_ms);
+}
+
+static uint32_t kernel_wait_event(void *object, uint32_t timeout_ms) {
+    return box64_event_wait((Box64Event *)object, timeout_ms);
+}
+
+static uint32_t kernel_wait_sleep(void *object, uint32_t timeout_ms) {
+    (void)object;
+    const uint64_t nanoseconds = (uint64_t)timeout_ms * 1000000ull;
+    struct timespec duration = { .tv_sec = (time_t)(nanoseconds / 1000000000ull),
+                                 .tv_nsec = (long)(nanoseconds % 1000000000ull) };
+    while (nanosleep(&duration, &duration) != 0 && errno == EINTR) {
+    }
+    return BOX64_WAIT_TIMEOUT;
+}
+
+typedef struct KernelCriticalSectionWait {
+    Box64Mutex *mutex;
+    uint32_t threadId;
+} KernelCriticalSectionWait;
+
+static uint32_t kernel_wait_critical_section(void *object, uint32_t timeout_ms) {
+    KernelCriticalSectionWait *wait = object;
+    return box64_mutex_lock_timed(wait->mutex, wait->threadId, timeout_ms) ? BOX64_WAIT_OBJECT_0 : BOX64_WAIT_TIMEOUT;
+}
+
+// 事件对象：句柄持有一个引用，每次查找（等待、SetEvent、ResetEvent）再持有一个，
+// CloseHandle 只放掉句柄的引用，仍在等待的线程用完才释放
+typedef struct KernelEvent {
+    Box64Event event;
+    _Atomic uint32_t refs;
+} KernelEvent;
+
+static void kernel_event_release(KernelEvent *event) {
+    if (atomic_fetch_sub_explicit(&event->refs, 1, memory_order_acq_rel) == 1) {
+        free(event);
+    }
+}
+
+// 按句柄和类型取内核对象并多持有一个引用：线程由调用方 box64_thread_release，事件由 kernel_event_release
+static void *kernel_object_lookup(Box64ProcessShared *shared, uint64_t handle, WineHandleType type) {
+    box64_lock(&shared->handleLock);
+    void *object = wine_handles_lookup(shared->kernelHandles, (WineHandle)handle, type);
+    if (object && type == WINE_HANDLE_THREAD) {
+        box64_thread_retain((Box64Thread *)object);
+    } else if (object && type == WINE_HANDLE_EVENT) {
+        atomic_fetch_add_explicit(&((KernelEvent *)object)->refs, 1, memory_order_relaxed);
+    }
+    box64_unlock(&shared->handleLock);
+    return object;
+}
+
+// 放掉句柄持有的引用（CloseHandle、句柄表销毁）
+static void kernel_object_release(void *object, WineHandleType type, void *context) {
+    (void)context;
+    if (type == WINE_HANDLE_THREAD) {
+        box64_thread_release((Box64Thread *)object);
+    } else if (type == WINE_HANDLE_EVENT) {
+        kernel_event_release((KernelEvent *)object);
+    }
+}
+
+// CreateThread(lpThreadAttributes, dwStackSize, lpStartAddress, lpParameter, dwCreationFlags, lpThreadId)
+static uint64_t thunk_CreateThread(Box64ThunkCall *call) {
+    uint32_t threadId = 0;
+    const uint64_t handle = [thunk_current_engine(call) createGuestThreadAt:call->args[2]
+                                                                  parameter:call->args[3]
+                                                                  stackSize:call->args[1]
+                                                                  suspended:(call->args[4] & WIN32_CREATE_SUSPENDED) != 0
+                                                                   threadId:&threadId];
+    if (handle && call->args[5]) {
+        box64_mmu_store(&call->ctx->mmu, call->args[5], 4, threadId);
+    }
+    return handle;
+}
+
+// ExitThread(dwExitCode)：结束调用线程的执行循环；在主线程上等同于结束本次执行
+static uint64_t thunk_ExitThread(Box64ThunkCall *call) {
+    Box64Engine *engine = thunk_current_engine(call);
+    engine.threadExitCode = (uint32_t)call->args[0];
+    engine.threadExitRequested = YES;
+    call->exit_requested = true;
+    return 0;
+}
+
+// ResumeThread(hThread)：返回之前的挂起计数，句柄无效返回 (DWORD)-1
+static uint64_t thunk_ResumeThread(Box64ThunkCall *call) {
+    Box64Thread *thread = kernel_object_lookup(thunk_shared(call), call->args[0], WINE_HANDLE_THREAD);
+    if (!thread) {
+        return UINT32_MAX;
+    }
+    const uint32_t previous = box64_thread_resume(thread);
+    box64_thread_release(thread);
+    return previous;
+}
+
+// GetExitCodeThread(hThread, lpExitCode)：运行中为 STILL_ACTIVE
+static uint64_t thunk_GetExitCodeThread(Box64ThunkCall *call) {
+    Box64Thread *thread = kernel_object_lookup(thunk_shared(call), call->args[0], WINE_HANDLE_THREAD);
+    if (!thread) {
+        return 0;
+    }
+    const uint32_t exitCode = box64_thread_exit_code(thread);
+    box64_thread_release(thread);
+    return box64_mmu_store(&call->ctx->mmu, call->args[1], 4, exitCode);
+}
+
+// WaitForSingleObject(hHandle, dwMilliseconds)：线程（等它结束）和事件
+static uint64_t thunk_WaitForSingleObject(Box64ThunkCall *call) {
+    Box64ProcessShared *shared = thunk_shared(call);
+    const uint32_t timeout = (uint32_t)call->args[1];
+    Box64Thread *thread = kernel_object_lookup(shared, call->args[0], WINE_HANDLE_THREAD);
+    if (thread) {
+        const uint32_t result = kernel_wait(call, timeout, kernel_wait_thread, thread);
+        box64_thread_release(thread);
+        return result;
+    }
+    KernelEvent *event = kernel_object_lookup(shared, call->args[0], WINE_HANDLE_EVENT);
+    if (!event) {
+        return BOX64_WAIT_FAILED;
+    }
+    const uint32_t result = kernel_wait(call, timeout, kernel_wait_event, &event->event);
+    kernel_event_release(event);
+    return result;
+}
+
+// CloseHandle(hObject)：只释放句柄对应的引用，线程继续运行
+static uint64_t thunk_CloseHandle(Box64ThunkCall *call) {
+    Box64ProcessShared *shared = thunk_shared(call);
+    WineHandleType type = WINE_HANDLE_FREE;
+    box64_lock(&shared->handleLock);
+    void *object = wine_handles_lookup_any(shared->kernelHandles, (WineHandle)call->args[0], &type);
+    if (object) {
+        wine_handles_free(shared->kernelHandles, (WineHandle)call->args[0], type);
+    }
+    box64_unlock(&shared->handleLock);
+    if (!object) {
+        return 0;
+    }
+    kernel_object_release(object, type, NULL);
+    return 1;
+}
+
+// Sleep(dwMilliseconds)：0 让出时间片；INFINITE 一直睡到进程退出
+static uint64_t thunk_Sleep(Box64ThunkCall *call) {
+    const uint32_t milliseconds = (uint32_t)call->args[0];
+    if (milliseconds == 0) {
+        sched_yield();
+    } else {
+        kernel_wait(call, milliseconds, kernel_wait_sleep, NULL);
+    }
+    return 0;
+}
+
+// CRITICAL_SECTION 的40字节归模拟器使用：Box64Mutex 放在偏移8（LockCount/RecursionCount/OwningThread 处），
+// 锁字直接在客户机内存里，无竞争时进入/离开只有一次原子操作，不经过句柄表
+#define WIN32_CRITICAL_SECTION_SIZE     40
+#define WIN32_CRITICAL_SECTION_LOCK     8
+_Static_assert(WIN32_CRITICAL_SECTION_LOCK + sizeof(Box64Mutex) <= WIN32_CRITICAL_SECTION_SIZE,
+               "Box64Mutex does not fit in CRITICAL_SECTION");
+
+static Box64Mutex *thunk_critical_section(Box64ThunkCall *call) {
+    const uint64_t address = call->args[0] + WIN32_CRITICAL_SECTION_LOCK;
+    if (call->args[0] == 0 || (address & 3)) {
+        return NULL;
+    }
+    return (Box64Mutex *)box64_mmu_translate(&call->ctx->mmu, address, sizeof(Box64Mutex), BOX64_ACCESS_WRITE);
+}
+
+// InitializeCriticalSection(lpCriticalSection)
+static uint64_t thunk_InitializeCriticalSection(Box64ThunkCall *call) {
+    Box64Mutex *mutex = thunk_critical_section(call);
+    if (mutex) {
+        box64_mutex_init(mutex, 0);
+    }
+    return 0;
+}
+
+// InitializeCriticalSectionAndSpinCount(lpCriticalSection, dwSpinCount)
+static uint64_t thunk_InitializeCriticalSectionAndSpinCount(Box64ThunkCall *call) {
+    Box64Mutex *mutex = thunk_critical_section(call);
+    if (!mutex) {
+        return 0;
+    }
+    box64_mutex_init(mutex, (uint32_t)call->args[1]);
+    return 1;
+}
+
+// 进程退出时不取得锁就结束调用线程
+static uint64_t thunk_EnterCriticalSection(Box64ThunkCall *call) {
+    Box64Mutex *mutex = thunk_critical_section(call);
+    if (mutex) {
+        KernelCriticalSectionWait wait = { mutex, box64_thread_current_id() };
+        kernel_wait(call, BOX64_INFINITE, kernel_wait_critical_section, &wait);
+    }
+    return 0;
+}
+
+static uint64_t thunk_TryEnterCriticalSection(Box64ThunkCall *call) {
+    Box64Mutex *mutex = thunk_critical_section(call);
+    return mutex && box64_mutex_trylock(mutex, box64_thread_current_id());
+}
+
+static uint64_t thunk_LeaveCriticalSection(Box64ThunkCall *call) {
+    Box64Mutex *mutex = thunk_critical_section(call);
+    if (mutex && !box64_mutex_unlock(mutex, box64_thread_current_id())) {
+        B64LogWarn(BOX64_LOG_EXEC, @"[Box64Engine] WARNING: LeaveCriticalSection(0x%llx) by non-owner thread %u",
+                   call->args[0], box64_thread_current_id());
+    }
+    return 0;
+}
+
+// DeleteCriticalSection：锁字就在客户机内存里，没有宿主资源要释放
+static uint64_t thunk_DeleteCriticalSection(Box64ThunkCall *call) {
+    (void)call;
+    return 0;
+}
+
+// CreateEventA(lpEventAttributes, bManualReset, bInitialState, lpName)：不支持命名事件，名字被忽略
+static uint64_t thunk_CreateEventA(Box64ThunkCall *call) {
+    KernelEvent *event = malloc(sizeof(KernelEvent));
+    if (!event) {
+        return 0;
+    }
+    box64_event_init(&event->event, call->args[1] != 0, call->args[2] != 0);
+    atomic_init(&event->refs, 1);
+    Box64ProcessShared *shared = thunk_shared(call);
+    box64_lock(&shared->handleLock);
+    const WineHandle handle = wine_handles_alloc(shared->kernelHandles, WINE_HANDLE_EVENT, event);
+    box64_unlock(&shared->handleLock);
+    if (!handle) {
+        free(event);
+    }
+    return handle;
+}
+
+static uint64_t thunk_SetEvent(Box64ThunkCall *call) {
+    KernelEvent *event = kernel_object_lookup(thunk_shared(call), call->args[0], WINE_HANDLE_EVENT);
+    if (!event) {
+        return 0;
+    }
+    box64_event_set(&event->event);
+    kernel_event_release(event);
+    return 1;
+}
+
+static uint64_t thunk_ResetEvent(Box64ThunkCall *call) {
+    KernelEvent *event = kernel_object_lookup(thunk_shared(call), call->args[0], WINE_HANDLE_EVENT);
+    if (!event) {
+        return 0;
+    }
+    box64_event_reset(&event->event);
+    kernel_event_release(event);
+    return 1;
+}
+
+// drain 时放行仍挂起的线程：它们一开始执行就看到 exiting 而退出，不会在内存释放后才被 ResumeThread
+static bool kernel_thread_release_suspended(WineHandle handle, void *object, void *context) {
+    (void)handle;
+    (void)context;
+    while (box64_thread_resume((Box64Thread *)object) > 1) {
+    }
+    return true;
+}
+
+#pragma mark - 客户机线程入口
+
+// 新 pthread 上运行线程引擎；user 是 create 时转移给线程对象的引擎引用
+static uint32_t guest_thread_main(Box64Thread *thread, void *user) {
+    (void)thread;
+    @autoreleasepool {
+        return [(__bridge Box64Engine *)user runGuestThread];
+    }
+}
+
+static void guest_thread_destroy(Box64Thread *thread, void *user) {
+    (void)thread;
+    Box64Engine *engine = CFBridgingRelease(user);
+    (void)engine;
+}
+
+@implementation Box64Engine {
+    Box64Mutex _executionLock;          // 同一个引擎同时只执行一段客户机代码，不挡其他线程的引擎
+}
 
 + (instancetype)sharedEngine {
     static Box64Engine *sharedInstance = nil;
@@ -48,56 +522,193 @@ static const ARM64Register x86_to_arm64_mapping[16] = {
     if (self) {
         _isInitialized = NO;
         _isSafeMode = YES;
-        _jitEngine = [IOSJITEngine sharedEngine];
+        // 每个进程引擎独占一个代码缓存：淘汰回调改写的块、W^X 切换的页都只属于本进程，
+        // 由本进程的 codeGate 保护（共享缓存时另一个引擎的分配会在没有持有我们 codeGate 的情况下淘汰我们的块）
+        _jitEngine = [[IOSJITEngine alloc] init];
         _safetyWarnings = [NSMutableArray array];
-        _contextLock = [[NSRecursiveLock alloc] init];
         
         // 🔧 新增：初始化立即数跟踪
         _immediateValueRegisters = [[NSMutableSet alloc] init];
         
         // 安全的内存分配
         _context = calloc(1, sizeof(Box64Context));
-        if (!_context) {
-            NSLog(@"[Box64Engine] CRITICAL: Failed to allocate context");
+        _shared = calloc(1, sizeof(Box64ProcessShared));
+        if (!_context || !_shared) {
+            B64LogError(BOX64_LOG_CORE, @"[Box64Engine] CRITICAL: Failed to allocate context");
             _lastError = @"无法分配执行上下文内存";
             return nil;
         }
+        box64_mutex_init(&_shared->processState, BOX64_MUTEX_DEFAULT_SPIN);
+        _shared->kernelHandles = wine_handles_create(0);
+        if (!_shared->kernelHandles) {
+            B64LogError(BOX64_LOG_CORE, @"[Box64Engine] CRITICAL: Failed to allocate kernel handle table");
+            _lastError = @"无法分配句柄表";
+            return nil;
+        }
+        box64_sse_reset(_context);
+        box64_x87_reset(_context);
+        
+        box64_log_set_sink(box64_nslog_sink);
+        
+        _thunkRegistry = box64_thunk_registry_create();
+        box64_imports_init(&_importTable, _thunkRegistry);
+        _imports = &_importTable;
+        [self registerKernel32Thunks];
         
         // 初始化安全参数
         _context->is_in_safe_mode = YES;
         _context->max_instructions = MAX_INSTRUCTIONS_PER_EXECUTION;
         _context->instruction_count = 0;
         
-        NSLog(@"[Box64Engine] Initialized with enhanced memory safety and immediate value tracking");
+        B64LogInfo(BOX64_LOG_CORE, @"[Box64Engine] Initialized with enhanced memory safety and immediate value tracking");
+    }
+    return self;
+}
+
+// 客户机线程的引擎：自己的上下文（寄存器、TLB、调用深度）和栈，翻译缓存、堆、导入表和JIT代码区用进程引擎的
+- (instancetype)initWithProcessEngine:(Box64Engine *)process {
+    self = [super init];
+    if (self) {
+        _processEngine = process;
+        _shared = process->_shared;
+        _isSafeMode = process->_isSafeMode;
+        _jitEngine = process->_jitEngine;
+        _safetyWarnings = [NSMutableArray array];
+        _immediateValueRegisters = [[NSMutableSet alloc] init];
+        
+        _context = calloc(1, sizeof(Box64Context));
+        if (!_context) {
+            B64LogError(BOX64_LOG_CORE, @"[Box64Engine] CRITICAL: Failed to allocate thread context");
+            return nil;
+        }
+        const Box64Context *parent = process->_context;
+        _context->memory_base = parent->memory_base;
+        _context->memory_size = parent->memory_size;
+        _context->heap_base = parent->heap_base;
+        _context->heap_size = parent->heap_size;
+        _context->is_in_safe_mode = parent->is_in_safe_mode;
+        if (!box64_mmu_attach(&_context->mmu, (Box64MMU *)&parent->mmu)) {
+            B64LogError(BOX64_LOG_CORE, @"[Box64Engine] CRITICAL: Failed to attach thread MMU view");
+            free(_context);
+            _context = NULL;
+            return nil;
+        }
+        box64_sse_reset(_context);
+        box64_x87_reset(_context);
+        box64_x87_set_extended(_context, parent->x87.extended != 0);
+        box64_flags_set(_context, 0x202);
+        
+        _thunkRegistry = process->_thunkRegistry;
+        _translationCache = process->_translationCache;
+        _guestHeap = process->_guestHeap;
+        _imports = &process->_importTable;
+        _isInitialized = YES;
     }
     return self;
 }
 
 - (void)dealloc {
-    [self cleanup];
+    if (_processEngine) {
+        // 线程引擎：共享对象归进程引擎，只释放自己的上下文
+        if (_context) {
+            box64_mmu_destroy(&_context->mmu);
+            free(_context);
+            _context = NULL;
+        }
+        return;
+    }
+    if (_shared) {
+        [self cleanup];
+        [self enableTraceRing:NO capacity:0];
+        wine_handles_destroy(_shared->kernelHandles, kernel_object_release, NULL);
+        free(_shared);
+        _shared = NULL;
+    }
+    box64_thunk_registry_destroy(_thunkRegistry);
+    _thunkRegistry = NULL;
     if (_context) {
         free(_context);
         _context = NULL;
     }
 }
 
+#pragma mark - 进程状态锁
+
+// 同一个引擎的寄存器读写和执行互斥；可重入，执行中的线程可以再读写自己的寄存器
+- (void)lockExecution {
+    box64_mutex_lock(&_executionLock, box64_thread_current_id());
+}
+
+- (void)unlockExecution {
+    box64_mutex_unlock(&_executionLock, box64_thread_current_id());
+}
+
+- (void)lockProcessState {
+    box64_mutex_lock(&_shared->processState, box64_thread_current_id());
+}
+
+- (void)unlockProcessState {
+    box64_mutex_unlock(&_shared->processState, box64_thread_current_id());
+}
+
+// 通知本进程的客户机线程停止并等它们退出；调用方不能持有 processState 或 codeGate，线程退出前可能还要拿它们
+// 超时后仍有线程在运行返回NO，exiting 保持置位，调用方不能释放它们可能还在访问的进程内存
+- (BOOL)drainGuestThreads {
+    atomic_store(&_shared->exiting, 1);
+    box64_lock(&_shared->handleLock);
+    wine_handles_enumerate(_shared->kernelHandles, WINE_HANDLE_THREAD, kernel_thread_release_suspended, NULL);
+    box64_unlock(&_shared->handleLock);
+    uint32_t waited = 0;
+    while (atomic_load(&_shared->liveThreads) > 0 && waited < BOX64_THREAD_DRAIN_TIMEOUT_MS) {
+        usleep(1000);
+        waited++;
+    }
+    const uint32_t live = atomic_load(&_shared->liveThreads);
+    if (live > 0) {
+        B64LogWarn(BOX64_LOG_CORE, @"[Box64Engine] WARNING: %u guest threads still running after %u ms", live, waited);
+        return NO;
+    }
+    return YES;
+}
+
 - (void)cleanup {
-    [_contextLock lock];
+    if (_processEngine || !_shared) {
+        return;
+    }
+    if (![self drainGuestThreads]) {
+        // 泄漏好过让仍在运行的线程访问已释放的客户机内存、翻译缓存和导入表；下次 cleanup 再试
+        B64LogError(BOX64_LOG_CORE, @"[Box64Engine] ❌ Cleanup deferred: guest threads did not exit");
+        _lastError = @"客户机线程未退出，清理推迟";
+        return;
+    }
+    atomic_store(&_shared->exiting, 0);
+    [self lockProcessState];
     @try {
         if (_isInitialized && _context) {
-            if (_context->memory_base) {
-                free(_context->memory_base - MEMORY_GUARD_SIZE);
-                _context->memory_base = NULL;
-            }
-            if (_context->jit_cache) {
-                [_jitEngine freeJITMemory:_context->jit_cache];
-                _context->jit_cache = NULL;
-            }
+            [self releaseGuestMemory];
+            box64_pe_file_close(&_peFile);
         }
+        if (_translationCache) {
+            box64_rwlock_write_lock(&_shared->codeGate);
+            box64_tc_destroy(_translationCache);
+            _translationCache = NULL;
+            box64_rwlock_write_unlock(&_shared->codeGate);
+        }
+        _boundCode = NULL;
+        _boundCodeLength = 0;
+        _boundCodeBase = 0;
+        _loadedImageBase = 0;
+        _loadedImageSize = 0;
+        _loadedImageOnHeap = NO;
+        box64_rwlock_write_lock(&_shared->codeGate);
+        box64_imports_destroy(&_importTable);
+        box64_rwlock_write_unlock(&_shared->codeGate);
+        _guestCallDepth = 0;
+        _nativeJITEnabled = NO;
         _isInitialized = NO;
-        NSLog(@"[Box64Engine] Cleanup completed");
+        B64LogInfo(BOX64_LOG_CORE, @"[Box64Engine] Cleanup completed");
     } @finally {
-        [_contextLock unlock];
+        [self unlockProcessState];
     }
 }
 
@@ -108,65 +719,77 @@ static const ARM64Register x86_to_arm64_mapping[16] = {
 }
 
 - (BOOL)initializeWithMemorySize:(size_t)memorySize safeMode:(BOOL)safeMode {
-    [_contextLock lock];
+    [self lockProcessState];
     
     @try {
         if (_isInitialized) {
-            NSLog(@"[Box64Engine] Already initialized");
+            B64LogInfo(BOX64_LOG_CORE, @"[Box64Engine] Already initialized");
             return YES;
         }
         
         // 内存大小安全检查
         if (memorySize < MEMORY_GUARD_SIZE * 4 || memorySize > MAX_MEMORY_SIZE) {
-            NSLog(@"[Box64Engine] SECURITY: Invalid memory size: %zu bytes", memorySize);
+            B64LogWarn(BOX64_LOG_CORE, @"[Box64Engine] SECURITY: Invalid memory size: %zu bytes", memorySize);
             _lastError = [NSString stringWithFormat:@"无效的内存大小: %zu字节", memorySize];
             return NO;
         }
         
-        NSLog(@"[Box64Engine] Initializing with %zu MB memory (Safe Mode: %@)",
+        B64LogInfo(BOX64_LOG_CORE, @"[Box64Engine] Initializing with %zu MB memory (Safe Mode: %@)",
               memorySize / (1024 * 1024), safeMode ? @"ON" : @"OFF");
         
         // 初始化JIT引擎
         if (![_jitEngine initializeJIT]) {
-            NSLog(@"[Box64Engine] CRITICAL: Failed to initialize JIT engine");
+            B64LogError(BOX64_LOG_CORE, @"[Box64Engine] CRITICAL: Failed to initialize JIT engine");
             _lastError = @"JIT引擎初始化失败";
             return NO;
         }
         
-        // 分配虚拟内存空间 - 带保护页
-        _context->memory_base = malloc(memorySize + MEMORY_GUARD_SIZE * 2);
-        if (!_context->memory_base) {
-            NSLog(@"[Box64Engine] CRITICAL: Failed to allocate memory");
+        // 分配客户机内存的后备区 - mmap保证页对齐且已清零，前后各留保护页
+        memorySize &= ~(size_t)BOX64_PAGE_OFFSET_MASK;
+        uint8_t *reserved = mmap(NULL, memorySize + MEMORY_GUARD_SIZE * 2, PROT_READ | PROT_WRITE,
+                                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (reserved == MAP_FAILED) {
+            B64LogError(BOX64_LOG_CORE, @"[Box64Engine] CRITICAL: Failed to allocate memory: %s", strerror(errno));
             _lastError = @"内存分配失败";
             return NO;
         }
         
-        _context->memory_size = memorySize;
-        memset(_context->memory_base, 0, memorySize + MEMORY_GUARD_SIZE * 2);
-        
         // 设置保护页
-        if (mprotect(_context->memory_base, MEMORY_GUARD_SIZE, PROT_NONE) != 0) {
-            NSLog(@"[Box64Engine] WARNING: Could not set front guard page: %s", strerror(errno));
+        if (mprotect(reserved, MEMORY_GUARD_SIZE, PROT_NONE) != 0) {
+            B64LogWarn(BOX64_LOG_CORE, @"[Box64Engine] WARNING: Could not set front guard page: %s", strerror(errno));
         }
         
-        uint8_t *end_guard = _context->memory_base + MEMORY_GUARD_SIZE + memorySize;
+        uint8_t *end_guard = reserved + MEMORY_GUARD_SIZE + memorySize;
         if (mprotect(end_guard, MEMORY_GUARD_SIZE, PROT_NONE) != 0) {
-            NSLog(@"[Box64Engine] WARNING: Could not set end guard page: %s", strerror(errno));
+            B64LogWarn(BOX64_LOG_CORE, @"[Box64Engine] WARNING: Could not set end guard page: %s", strerror(errno));
         }
         
         // 调整内存基址到可用区域
-        _context->memory_base += MEMORY_GUARD_SIZE;
-        
-        // 分配JIT缓存 - 更大的缓存以支持复杂指令序列
-        _context->jit_cache = [_jitEngine allocateJITMemory:8192]; // 8KB
-        if (!_context->jit_cache) {
-            NSLog(@"[Box64Engine] CRITICAL: Failed to allocate JIT cache");
-            _lastError = @"JIT缓存分配失败";
-            free(_context->memory_base - MEMORY_GUARD_SIZE);
-            _context->memory_base = NULL;
+        _context->memory_base = reserved + MEMORY_GUARD_SIZE;
+        _context->memory_size = memorySize;
+        
+        // 客户机页表：初始全部未映射，由 initializeMemoryRegions / mapMemory 建立映射
+        if (!box64_mmu_init(&_context->mmu, _context->memory_base, memorySize)) {
+            B64LogError(BOX64_LOG_CORE, @"[Box64Engine] CRITICAL: Failed to allocate guest page table");
+            _lastError = @"页表分配失败";
+            [self releaseGuestMemory];
             return NO;
         }
         
+        // 基本块翻译缓存
+        _translationCache = box64_tc_create(BOX64_TC_DEFAULT_CAPACITY);
+        if (!_translationCache) {
+            B64LogError(BOX64_LOG_CORE, @"[Box64Engine] CRITICAL: Failed to allocate translation cache");
+            _lastError = @"翻译缓存分配失败";
+            [self releaseGuestMemory];
+            return NO;
+        }
+        // 块被淘汰/失效时把它的本机代码还给代码缓存
+        box64_tc_set_release_callback(_translationCache, box64_engine_release_native_code, (__bridge void *)_jitEngine);
+        
+        _nativeJITEnabled = _jitEngine.canExecuteNativeCode;
+        B64LogInfo(BOX64_LOG_CORE, @"[Box64Engine] Block JIT: %@", _nativeJITEnabled ? @"native ARM64" : @"disabled (interpreter only)");
+        
         // 初始化内存区域管理
         [self initializeMemoryRegions];
         
@@ -178,57 +801,50 @@ static const ARM64Register x86_to_arm64_mapping[16] = {
         _context->is_in_safe_mode = safeMode;
         
         _isInitialized = YES;
-        NSLog(@"[Box64Engine] Successfully initialized with enhanced security");
+        B64LogInfo(BOX64_LOG_CORE, @"[Box64Engine] Successfully initialized with enhanced security");
         return YES;
         
     } @finally {
-        [_contextLock unlock];
+        [self unlockProcessState];
     }
 }
 
+// 初始客户机地址空间：低地址不映射（捕获空指针），堆从0x10000开始，栈在地址空间顶端
 - (void)initializeMemoryRegions {
     if (!_context) return;
     
-    // 清空区域记录
-    memset(_context->memory_regions, 0, sizeof(_context->memory_regions));
-    _context->region_count = 0;
+    const uint64_t quarter = (_context->memory_size / 4) & BOX64_PAGE_MASK;
+    _context->stack_size = MIN(1024 * 1024, quarter);  // 1MB栈
+    _context->stack_base = _context->memory_size - _context->stack_size;
     
-    // 设置基础内存区域
-    _context->stack_size = 1024 * 1024;  // 1MB栈
-    _context->stack_base = (uint64_t)_context->memory_base + _context->memory_size - _context->stack_size;
+    _context->heap_base = MIN(0x10000, quarter);  // 64KB后开始堆
+    _context->heap_size = MIN(_context->memory_size / 2, _context->stack_base - _context->heap_base);
     
-    _context->heap_base = (uint64_t)_context->memory_base + 0x10000;  // 64KB后开始堆
-    _context->heap_size = _context->memory_size / 2;  // 一半内存作为堆
-    
-    // 添加栈区域
-    [self addMemoryRegion:_context->stack_base size:_context->stack_size
-                     name:"Stack" executable:NO writable:YES];
+    if (!box64_mmu_map(&_context->mmu, _context->stack_base, _context->stack_size, BOX64_PROT_READ | BOX64_PROT_WRITE) ||
+        !box64_mmu_map(&_context->mmu, _context->heap_base, _context->heap_size, BOX64_PROT_READ | BOX64_PROT_WRITE)) {
+        B64LogWarn(BOX64_LOG_CORE, @"[Box64Engine] WARNING: Failed to map initial stack/heap pages");
+    }
     
-    // 添加堆区域
-    [self addMemoryRegion:_context->heap_base size:_context->heap_size
-                     name:"Heap" executable:NO writable:YES];
+    box64_heap_destroy(_guestHeap);
+    _guestHeap = box64_heap_create(_context->heap_base, _context->heap_size);
+    if (!_guestHeap) {
+        B64LogWarn(BOX64_LOG_CORE, @"[Box64Engine] WARNING: Failed to create guest heap");
+    }
     
-    NSLog(@"[Box64Engine] Memory regions initialized: Stack=0x%llx-0x%llx, Heap=0x%llx-0x%llx",
+    B64LogInfo(BOX64_LOG_CORE, @"[Box64Engine] Memory regions initialized: Stack=0x%llx-0x%llx, Heap=0x%llx-0x%llx",
           _context->stack_base, _context->stack_base + _context->stack_size,
           _context->heap_base, _context->heap_base + _context->heap_size);
 }
 
-- (BOOL)addMemoryRegion:(uint64_t)address size:(uint64_t)size name:(const char *)name executable:(BOOL)executable writable:(BOOL)writable {
-    if (!_context || _context->region_count >= 32) {
-        return NO;
+// 释放客户机内存后备区和页表
+- (void)releaseGuestMemory {
+    box64_heap_destroy(_guestHeap);
+    _guestHeap = NULL;
+    box64_mmu_destroy(&_context->mmu);
+    if (_context->memory_base) {
+        munmap(_context->memory_base - MEMORY_GUARD_SIZE, _context->memory_size + MEMORY_GUARD_SIZE * 2);
+        _context->memory_base = NULL;
     }
-    
-    MemoryRegion *region = &_context->memory_regions[_context->region_count];
-    region->start_address = address;
-    region->size = size;
-    region->is_allocated = YES;
-    region->is_executable = executable;
-    region->is_writable = writable;
-    strncpy(region->name, name, sizeof(region->name) - 1);
-    region->name[sizeof(region->name) - 1] = '\0';
-    
-    _context->region_count++;
-    return YES;
 }
 
 #pragma mark - 指令执行 - 修复版本
@@ -238,366 +854,1296 @@ static const ARM64Register x86_to_arm64_mapping[16] = {
 }
 
 - (BOOL)executeWithSafetyCheck:(const uint8_t *)code length:(size_t)length maxInstructions:(uint32_t)maxInstructions baseAddress:(uint64_t)baseAddress {
-    [_contextLock lock];
+    return [self executeWithSafetyCheck:code length:length maxInstructions:maxInstructions baseAddress:baseAddress entryPoint:baseAddress];
+}
+
+- (BOOL)executeGuestCodeAt:(uint64_t)entryPoint codeStart:(uint64_t)codeStart length:(size_t)length maxInstructions:(uint32_t)maxInstructions {
+    [self lockExecution];
     
     @try {
         if (!_isInitialized || !_context) {
-            NSLog(@"[Box64Engine] SECURITY: Engine not initialized or context is NULL");
+            B64LogWarn(BOX64_LOG_EXEC, @"[Box64Engine] SECURITY: Engine not initialized or context is NULL");
+            return NO;
+        }
+        
+        if (length == 0 || entryPoint < codeStart || entryPoint - codeStart >= length) {
+            B64LogWarn(BOX64_LOG_EXEC, @"[Box64Engine] SECURITY: Entry 0x%llx outside code range 0x%llx-0x%llx",
+                  entryPoint, codeStart, codeStart + length);
+            _lastError = [NSString stringWithFormat:@"入口点 0x%llx 不在代码区间内", entryPoint];
+            return NO;
+        }
+        
+        // 镜像由 box64_mmu_map 映射到连续的后备区，整个可执行区间可以一次翻译成宿主指针
+        const uint8_t *code = box64_mmu_translate(&_context->mmu, codeStart, length, BOX64_ACCESS_EXEC);
+        if (!code) {
+            B64LogWarn(BOX64_LOG_EXEC, @"[Box64Engine] SECURITY: Code range 0x%llx-0x%llx is not executable",
+                  codeStart, codeStart + length);
+            _lastError = [NSString stringWithFormat:@"代码区间 0x%llx 不可执行", codeStart];
+            return NO;
+        }
+        
+        return [self executeWithSafetyCheck:code length:length maxInstructions:maxInstructions baseAddress:codeStart entryPoint:entryPoint];
+        
+    } @finally {
+        [self unlockExecution];
+    }
+}
+
+- (BOOL)executeWithSafetyCheck:(const uint8_t *)code length:(size_t)length maxInstructions:(uint32_t)maxInstructions baseAddress:(uint64_t)baseAddress entryPoint:(uint64_t)entryPoint {
+    // 执行期间不持有 processState：客户机线程的堆、VirtualAlloc 桩要拿它
+    [self lockExecution];
+    
+    @try {
+        if (!_isInitialized || !_context) {
+            B64LogWarn(BOX64_LOG_EXEC, @"[Box64Engine] SECURITY: Engine not initialized or context is NULL");
             return NO;
         }
         
         if (!code || length == 0) {
-            NSLog(@"[Box64Engine] SECURITY: Invalid code parameters");
+            B64LogWarn(BOX64_LOG_EXEC, @"[Box64Engine] SECURITY: Invalid code parameters");
             return NO;
         }
         
         if (length > 1024 * 1024) {
-            NSLog(@"[Box64Engine] SECURITY: Code too large: %zu bytes", length);
+            B64LogWarn(BOX64_LOG_EXEC, @"[Box64Engine] SECURITY: Code too large: %zu bytes", length);
             return NO;
         }
         
-        NSLog(@"[Box64Engine] 🔧 执行参数检查:");
-        NSLog(@"[Box64Engine]   代码指针: %p", code);
-        NSLog(@"[Box64Engine]   代码长度: %zu字节", length);
-        NSLog(@"[Box64Engine]   最大指令数: %u", maxInstructions);
-        NSLog(@"[Box64Engine]   基地址: 0x%llx", baseAddress);
+        B64LogDebug(BOX64_LOG_EXEC, @"[Box64Engine] 🔧 执行参数检查:");
+        B64LogDebug(BOX64_LOG_EXEC, @"[Box64Engine]   代码指针: %p", code);
+        B64LogDebug(BOX64_LOG_EXEC, @"[Box64Engine]   代码长度: %zu字节", length);
+        B64LogDebug(BOX64_LOG_EXEC, @"[Box64Engine]   最大指令数: %u", maxInstructions);
+        B64LogDebug(BOX64_LOG_EXEC, @"[Box64Engine]   基地址: 0x%llx", baseAddress);
         
         // 显示前几个字节
         if (length >= 8) {
-            NSLog(@"[Box64Engine]   前8字节: %02X %02X %02X %02X %02X %02X %02X %02X",
+            B64LogDebug(BOX64_LOG_EXEC, @"[Box64Engine]   前8字节: %02X %02X %02X %02X %02X %02X %02X %02X",
                   code[0], code[1], code[2], code[3], code[4], code[5], code[6], code[7]);
         }
         
-        NSLog(@"[Box64Engine] Executing %zu bytes of x86 code (max %u instructions) at base 0x%llx", length, maxInstructions, baseAddress);
+        B64LogDebug(BOX64_LOG_EXEC, @"[Box64Engine] Executing %zu bytes of x86 code (max %u instructions) at base 0x%llx", length, maxInstructions, baseAddress);
         
         // 重置执行计数器
         _context->instruction_count = 0;
         _context->max_instructions = maxInstructions;
         _context->last_valid_rip = 0;
         
-        // 🔧 修复：使用传入的基地址初始化RIP
-        _context->rip = baseAddress;
+        // 🔧 修复：从入口点开始执行（片段执行时即基地址）
+        _context->rip = entryPoint;
+        _guestCallDepth = 0;
+        _threadExitRequested = NO;
+        _instructionLimitHit = NO;
         
-        NSLog(@"[Box64Engine] 🔧 开始执行循环...");
+        // 上一次执行以 ExitProcess 结束：等遗留的客户机线程退出后再开始新的执行
+        if (!_processEngine && atomic_load(&_shared->exiting)) {
+            if (![self drainGuestThreads]) {
+                _lastError = @"上一次执行的客户机线程未退出";
+                return NO;
+            }
+            atomic_store(&_shared->exiting, 0);
+        }
+        
+        B64LogDebug(BOX64_LOG_EXEC, @"[Box64Engine] 🔧 开始执行循环...");
         
         // 🔧 修复：使用简化的执行模式，传递基地址
-        BOOL success = [self executeX86CodeSimplified:code length:length maxInstructions:maxInstructions baseAddress:baseAddress];
+        // 整个执行循环持有翻译缓存读锁，只在块边界的安全点和导入桩调用时让出
+        BOOL success = NO;
+        box64_rwlock_read_lock(&_shared->codeGate);
+        @try {
+            success = [self executeX86CodeSimplified:code length:length maxInstructions:maxInstructions baseAddress:baseAddress];
+        } @finally {
+            box64_rwlock_read_unlock(&_shared->codeGate);
+        }
         
         if (success) {
-            NSLog(@"[Box64Engine] ✅ x86 code execution completed successfully (%u instructions)", _context->instruction_count);
+            B64LogDebug(BOX64_LOG_EXEC, @"[Box64Engine] ✅ x86 code execution completed successfully (%u instructions)", _context->instruction_count);
         } else {
-            NSLog(@"[Box64Engine] ❌ x86 code execution failed after %u instructions", _context->instruction_count);
+            B64LogError(BOX64_LOG_EXEC, @"[Box64Engine] ❌ x86 code execution failed after %u instructions", _context->instruction_count);
+            // 跟踪环是进程级的，线程引擎的失败也导出进程引擎的环
+            Box64Engine *owner = _processEngine ?: self;
+            if (owner.traceRing) {
+                [owner dumpTraceRing:BOX64_TRACE_POSTMORTEM_EVENTS];
+            }
         }
         
         return success;
         
     } @finally {
-        [_contextLock unlock];
+        [self unlockExecution];
     }
 }
 
 // 🔧 新增：简化的x86指令执行，避免JIT编译问题
+// 按基本块执行：先沿后继链接找块，再查翻译缓存，最后才解码新块
 - (BOOL)executeX86CodeSimplified:(const uint8_t *)code length:(size_t)length maxInstructions:(uint32_t)maxInstructions baseAddress:(uint64_t)baseAddress {
-    size_t executed_bytes = 0;
-    
-    NSLog(@"[Box64Engine] 🔧 executeX86CodeSimplified 开始:");
-    NSLog(@"[Box64Engine]   代码长度: %zu", length);
-    NSLog(@"[Box64Engine]   最大指令数: %u", maxInstructions);
-    NSLog(@"[Box64Engine]   基地址: 0x%llx", baseAddress);
-    
-    while (executed_bytes < length && _context->instruction_count < maxInstructions) {
-        const uint8_t *current_instruction = code + executed_bytes;
-        size_t remaining_bytes = length - executed_bytes;
-        
-        NSLog(@"[Box64Engine] 📍 指令 %u: 偏移=%zu, 剩余=%zu字节", _context->instruction_count + 1, executed_bytes, remaining_bytes);
-        NSLog(@"[Box64Engine]   当前字节: %02X %02X %02X %02X",
-              current_instruction[0],
-              remaining_bytes > 1 ? current_instruction[1] : 0,
-              remaining_bytes > 2 ? current_instruction[2] : 0,
-              remaining_bytes > 3 ? current_instruction[3] : 0);
-        
-        // 解码指令
-        X86Instruction decoded = [self decodeInstruction:current_instruction maxLength:remaining_bytes];
-        
-        NSLog(@"[Box64Engine] 🔍 指令解码结果:");
-        NSLog(@"[Box64Engine]   有效: %s", decoded.is_valid ? "是" : "否");
-        NSLog(@"[Box64Engine]   安全: %s", decoded.is_safe ? "是" : "否");
-        NSLog(@"[Box64Engine]   长度: %d字节", decoded.length);
-        NSLog(@"[Box64Engine]   助记符: %s", decoded.mnemonic);
-        
-        if (!decoded.is_valid) {
-            NSLog(@"[Box64Engine] SECURITY: Invalid instruction at offset %zu", executed_bytes);
-            return NO;
+    B64LogDebug(BOX64_LOG_EXEC, @"[Box64Engine] 🔧 executeX86CodeSimplified 开始: 长度=%zu, 最大指令数=%u, 基地址=0x%llx",
+          length, maxInstructions, baseAddress);
+    
+    [self bindCodeSource:code length:length baseAddress:baseAddress];
+    
+    // JIT代码区和开关归进程引擎，所有线程共用
+    Box64Engine *owner = _processEngine ?: self;
+    const uint64_t codeEnd = baseAddress + length;
+    Box64Block *previous = NULL;
+    Box64BlockEdge previousEdge = BOX64_EDGE_FALLTHROUGH;
+    BOOL finished = NO;
+    
+    while (!finished && _context->instruction_count < maxInstructions) {
+        // 安全点：有写者（失效、翻译、编译）等待时先让它完成；让出过的话手里的块指针不再可信
+        if (box64_rwlock_read_yield(&_shared->codeGate)) {
+            previous = NULL;
         }
-        
-        if (!decoded.is_safe && _isSafeMode) {
-            NSLog(@"[Box64Engine] SECURITY: Unsafe instruction %s blocked in safe mode", decoded.mnemonic);
-            return NO;
+        if (atomic_load_explicit(&_shared->exiting, memory_order_relaxed)) {
+            B64LogDebug(BOX64_LOG_EXEC, @"[Box64Engine] Process exiting, stopping at 0x%llx", _context->rip);
+            break;
         }
+        box64_mmu_sync(&_context->mmu);
+        uint64_t rip = _context->rip;
         
-        // 记录最后有效的RIP
-        _context->last_valid_rip = _context->rip;
-        memcpy(_context->last_instruction, current_instruction, MIN(decoded.length, sizeof(_context->last_instruction)));
-        
-        NSLog(@"[Box64Engine] 🚀 开始执行指令: %s", decoded.mnemonic);
-        
-        // 🔧 修复：直接模拟指令执行，避免JIT编译
-        if (![self simulateInstructionExecution:&decoded]) {
-            NSLog(@"[Box64Engine] SECURITY: Failed to simulate instruction at offset %zu", executed_bytes);
+        // 导入桩不在代码范围内，先于翻译缓存按地址区间识别
+        if (box64_imports_contains(_imports, rip)) {
+            if (![self dispatchImportAt:rip finished:&finished]) {
+                return NO;
+            }
+            previous = NULL;
+            continue;
+        }
+        if (rip == codeEnd) {
+            break;  // 顺序执行到代码末尾
+        }
+        if (rip < baseAddress || rip > codeEnd) {
+            B64LogWarn(BOX64_LOG_EXEC, @"[Box64Engine] SECURITY: RIP 0x%llx left code range 0x%llx-0x%llx", rip, baseAddress, codeEnd);
             return NO;
         }
         
-        executed_bytes += decoded.length;
-        _context->instruction_count++;
+        // 1. 直接后继链接 → 2. 缓存查找 → 3. 解码新块
+        // 读锁下只查找；翻译新块和补链接要修改缓存，换成写锁
+        Box64Block *block = previous ? box64_tc_follow(_translationCache, previous, previousEdge, rip) : NULL;
+        if (!block) {
+            block = box64_tc_lookup(_translationCache, rip);
+            const BOOL canLink = previous && previous->successor_rip[previousEdge] == rip;
+            if (!block || canLink) {
+                X86DecodeStatus status = X86_DECODE_OK;
+                block = [self translateBlockAt:rip code:code baseAddress:baseAddress codeEnd:codeEnd
+                                      previous:canLink ? previous : NULL edge:previousEdge status:&status];
+                if (!block) {
+                    const uint8_t *bytes = code + (rip - baseAddress);
+                    size_t remaining = (size_t)(codeEnd - rip);
+                    B64LogWarn(BOX64_LOG_EXEC, @"[Box64Engine] SECURITY: Invalid instruction at offset %llu (status %d, bytes %02X %02X %02X %02X)",
+                          rip - baseAddress, status, bytes[0],
+                          remaining > 1 ? bytes[1] : 0, remaining > 2 ? bytes[2] : 0, remaining > 3 ? bytes[3] : 0);
+                    return NO;
+                }
+            }
+        }
+        const uint64_t execCount = box64_block_count_exec(block);
+        
+        // 热块编译为本机代码；本机代码覆盖块前缀，剩余部分（如RET、内存操作数）继续解释
+        // 编译期间释放过读锁，返回的是重新查找到的块；块已被淘汰时从头再来
+        if (owner->_nativeJITEnabled && box64_block_is_hot(block, execCount, BOX64_JIT_HOT_THRESHOLD)) {
+            block = [self compileBlockNatively:block];
+            if (!block) {
+                previous = NULL;
+                continue;
+            }
+        }
         
-        // 🔧 修复：正确更新RIP为绝对地址
-        _context->rip = baseAddress + executed_bytes;
+        uint32_t firstInsn = 0;
+        if (block->native_code && _context->instruction_count + block->native_insn_count <= maxInstructions) {
+            _context->last_valid_rip = block->guest_start;
+            box64_trace(BOX64_TRACE_NATIVE_BLOCK, block->guest_start, 0, 0, block->native_insn_count);
+            const uint64_t countBefore = _context->instruction_count;
+            uint64_t next = ((Box64JITBlockFn)block->native_code)(_context);
+            [self syncHostRegisterMirror];
+            _context->rip = next;
+            owner->_jitNativeExecutions++;
+            
+            if (![self performSafetyCheckWithRIP:next]) {
+                B64LogWarn(BOX64_LOG_EXEC, @"[Box64Engine] SECURITY: Safety check failed after native block 0x%llx", block->guest_start);
+                return NO;
+            }
+            // x87 入口检查失败时本机代码什么都没执行（计数不变，返回块首），整块交给解释器
+            firstInsn = _context->instruction_count != countBefore ? block->native_insn_count : 0;
+        }
         
-        NSLog(@"[Box64Engine] ✅ 指令执行完成:");
-        NSLog(@"[Box64Engine]   执行字节数: %zu", executed_bytes);
-        NSLog(@"[Box64Engine]   指令计数: %u", _context->instruction_count);
-        NSLog(@"[Box64Engine]   新RIP: 0x%llx", _context->rip);
+        // 其余部分交给线程化解释器；它沿已链接的后继连续执行多个块，只在需要引擎处理时返回
+        // 寄存器直接读写上下文，栈指针和RIP的检查在每次返回时做一次
+        const Box64InterpBounds bounds = {
+            _translationCache, baseAddress, codeEnd, maxInstructions,
+            owner->_nativeJITEnabled ? BOX64_JIT_HOT_THRESHOLD : 0, &_shared->codeGate
+        };
+        uint32_t index = firstInsn;
+        while (!finished && index < block->insn_count) {
+            Box64InterpResult result;
+            Box64InterpExit exit = box64_interp_run(_context, &bounds, block, index, &result);
+            block = result.block;
+            index = block->insn_count;
+            if (result.last_rip) {
+                _context->last_valid_rip = result.last_rip;
+            }
+            
+            switch (exit) {
+                case BOX64_INTERP_BLOCK_END:
+                case BOX64_INTERP_LIMIT:
+                    break;
+                    
+                case BOX64_INTERP_RETURN:
+                    // 入口函数的RET结束执行；被调用函数的RET弹出返回地址
+                    if (_guestCallDepth > 0) {
+                        [self syncHostRegisterMirror];
+                        if (![self returnFromGuestCallReleasing:result.stack_release]) {
+                            return NO;
+                        }
+                        break;
+                    }
+                    B64LogDebug(BOX64_LOG_EXEC, @"[Box64Engine] ℹ️ 遇到RET指令，正常结束执行");
+                    finished = YES;
+                    break;
+                    
+                case BOX64_INTERP_FAULT:
+                    [self syncHostRegisterMirror];
+                    [self reportPageFault:result.fault_address size:result.fault_size];
+                    B64LogWarn(BOX64_LOG_EXEC, @"[Box64Engine] SECURITY: Failed to simulate %@ at 0x%llx",
+                          [self disassembleDecodedInstruction:&block->insns[result.index] address:result.last_rip], result.last_rip);
+                    return NO;
+                    
+                case BOX64_INTERP_FALLBACK: {
+                    // 快速层不支持的指令逐条执行，之后从下一条继续
+                    const X86DecodedInsn *insn = &block->insns[result.index];
+                    const uint64_t insnAddress = _context->rip;
+                    [self syncHostRegisterMirror];
+                    if (![self executeFallbackInstruction:insn address:insnAddress]) {
+                        return NO;
+                    }
+                    index = result.index + 1;
+                    break;
+                }
+            }
+        }
+        [self syncHostRegisterMirror];
+        if (_context->last_valid_rip >= baseAddress && _context->last_valid_rip < codeEnd) {
+            const uint64_t offset = _context->last_valid_rip - baseAddress;
+            memcpy(_context->last_instruction, code + offset, MIN(sizeof(_context->last_instruction), (size_t)(length - offset)));
+        }
         
-        // 执行后安全检查 - 修复RIP检查逻辑
+        // 块边界安全检查
         if (![self performSafetyCheckWithRIP:_context->rip]) {
-            NSLog(@"[Box64Engine] SECURITY: Safety check failed after instruction %u", _context->instruction_count);
+            B64LogWarn(BOX64_LOG_EXEC, @"[Box64Engine] SECURITY: Safety check failed after block 0x%llx (%u instructions)",
+                  block->guest_start, _context->instruction_count);
             return NO;
         }
         
-        NSLog(@"[Box64Engine] Executed instruction %u: %s, new RIP: 0x%llx", _context->instruction_count, decoded.mnemonic, _context->rip);
+        // 块尾跳转方向决定沿哪条边链接
+        previous = block;
+        previousEdge = (_context->rip == block->successor_rip[BOX64_EDGE_FALLTHROUGH]) ? BOX64_EDGE_FALLTHROUGH : BOX64_EDGE_TAKEN;
+    }
+    
+    if (!finished && _context->instruction_count >= maxInstructions) {
+        _instructionLimitHit = YES;
+        B64LogInfo(BOX64_LOG_EXEC, @"[Box64Engine] INFO: Hit instruction limit %u, stopping execution", maxInstructions);
+    }
+    
+    B64LogDebug(BOX64_LOG_EXEC, @"[Box64Engine] 🎯 执行循环结束: 共执行 %u 条指令", _context->instruction_count);
+    
+    return YES;
+}
+
+#pragma mark - 翻译缓存
+
+// 执行的代码缓冲区变化时（新程序、新测试片段），旧缓冲区和新地址范围上的块都不再可信
+// 调用方持有读锁，失效时临时换成写锁
+- (void)bindCodeSource:(const uint8_t *)code length:(size_t)length baseAddress:(uint64_t)baseAddress {
+    if (code == _boundCode && length == _boundCodeLength && baseAddress == _boundCodeBase) {
+        return;
+    }
+    box64_rwlock_read_unlock(&_shared->codeGate);
+    box64_rwlock_write_lock(&_shared->codeGate);
+    if (_boundCode) {
+        box64_tc_invalidate_range(_translationCache, _boundCodeBase, _boundCodeLength);
+    }
+    box64_tc_invalidate_range(_translationCache, baseAddress, length);
+    box64_rwlock_write_downgrade(&_shared->codeGate);
+    _boundCode = code;
+    _boundCodeLength = length;
+    _boundCodeBase = baseAddress;
+}
+
+// 翻译新块（或取已有的块）并把 previous 的静态后继链接过去；调用方持有读锁，返回时仍持有
+// 换锁期间其他线程可能已经翻译了同一地址，或淘汰了 previous，所以拿到写锁后全部重新检查
+- (nullable Box64Block *)translateBlockAt:(uint64_t)rip code:(const uint8_t *)code baseAddress:(uint64_t)baseAddress
+                                  codeEnd:(uint64_t)codeEnd previous:(nullable Box64Block *)previous
+                                     edge:(Box64BlockEdge)edge status:(X86DecodeStatus *)status {
+    const uint64_t previousStart = previous ? previous->guest_start : 0;
+    box64_rwlock_read_unlock(&_shared->codeGate);
+    box64_rwlock_write_lock(&_shared->codeGate);
+    Box64Block *block = box64_tc_lookup(_translationCache, rip);
+    if (!block) {
+        block = box64_tc_translate(_translationCache, rip, code + (rip - baseAddress), (size_t)(codeEnd - rip), status);
+    }
+    if (block) {
+        box64_interp_prepare(block);
+        if (previous && previous->valid && previous->guest_start == previousStart) {
+            box64_tc_link(previous, edge, block);
+        }
+    }
+    box64_rwlock_write_downgrade(&_shared->codeGate);
+    return block;
+}
+
+- (void)invalidateTranslationCacheInRange:(uint64_t)address size:(size_t)size {
+    box64_rwlock_write_lock(&_shared->codeGate);
+    
+    @try {
+        uint32_t invalidated = box64_tc_invalidate_range(_translationCache, address, size);
+        if (invalidated > 0) {
+            B64LogDebug(BOX64_LOG_JIT, @"[Box64Engine] Invalidated %u cached blocks in 0x%llx-0x%llx", invalidated, address, address + size);
+        }
+    } @finally {
+        box64_rwlock_write_unlock(&_shared->codeGate);
+    }
+}
+
+#pragma mark - 块JIT
+
+// 翻译缓存回收块时释放它的本机代码（在 codeGate 写锁下）
+static void box64_engine_release_native_code(Box64Block *block, void *userdata) {
+    if (block->native_code) {
+        [(__bridge IOSJITEngine *)userdata freeCodeBlock:block->native_code];
+    }
+}
+
+// 代码缓存淘汰区域时调用（分配发生在 compileBlockNatively 的写锁下，没有线程在执行本机代码）
+// 块槽可能已被别的块复用，只有本机代码指针仍指向被淘汰的代码时才清掉
+static void box64_engine_evict_native_code(void *user, void *code, uint64_t guest_rip) {
+    Box64Block *block = (Box64Block *)user;
+    if (block->native_code == code && block->guest_start == guest_rip) {
+        block->native_code = NULL;
+        block->native_insn_count = 0;
+        atomic_store_explicit(&block->exec_count, 0, memory_order_relaxed);   // 重新预热后再编译
+    }
+}
+
+// 把热块编译成ARM64函数，放进代码缓存里单独分配的块；缓存满时由代码缓存淘汰最旧的区域
+// 安装在写锁下进行（其他线程可能正在执行旧的本机代码）；
+// 调用方持有读锁，返回时仍持有，返回重新查找到的块，块已被淘汰时返回NULL
+- (nullable Box64Block *)compileBlockNatively:(Box64Block *)block {
+    Box64Engine *owner = _processEngine ?: self;
+    const uint64_t start = block->guest_start;
+    box64_rwlock_read_unlock(&_shared->codeGate);
+    box64_rwlock_write_lock(&_shared->codeGate);
+    
+    @try {
+        block = box64_tc_lookup(_translationCache, start);
+        if (!block || block->native_code || !owner->_nativeJITEnabled) {
+            return block;  // 另一个线程已经编译过，或已被淘汰
+        }
+        
+        uint32_t code[BOX64_JIT_MAX_BLOCK_WORDS];
+        Box64JITRegUsage usage;
+        size_t words = box64_jit_compile_block(block, code, BOX64_JIT_MAX_BLOCK_WORDS, &usage);
+        if (words == 0) {
+            block->native_rejected = true;
+            return block;  // 块首指令不在JIT子集内，保持解释执行
+        }
         
-        // 🔧 新增：检查RET指令，如果遇到就停止执行
-        if (decoded.opcode == 0xC3) {
-            NSLog(@"[Box64Engine] ℹ️ 遇到RET指令，正常结束执行");
-            break;
+        size_t bytes = words * sizeof(uint32_t);
+        void *native = [_jitEngine allocateCodeBlock:bytes guestRIP:start evict:box64_engine_evict_native_code user:block];
+        if (!native) {
+            B64LogInfo(BOX64_LOG_JIT, @"[Box64Engine] Code cache full, block 0x%llx stays interpreted", start);
+            block->native_rejected = true;
+            return block;
         }
+        
+        if (![_jitEngine installCode:code size:bytes atOffset:0 inMemory:native]) {
+            B64LogError(BOX64_LOG_JIT, @"[Box64Engine] ❌ Failed to install native block 0x%llx, disabling block JIT", block->guest_start);
+            [_jitEngine freeCodeBlock:native];
+            [_jitEngine flushCodeCache];
+            owner->_nativeJITEnabled = NO;
+            return block;
+        }
+        
+        block->native_code = native;
+        block->native_insn_count = usage.compiled_insns;
+        owner->_jitCompiledBlocks++;
+        return block;
+    } @finally {
+        box64_rwlock_write_downgrade(&_shared->codeGate);
     }
+}
+
+// 本机代码只维护 x86_regs，回到解释器前同步 arm64_regs 镜像
+- (void)syncHostRegisterMirror {
+    for (int reg = 0; reg < 16; reg++) {
+        _context->arm64_regs[box64_jit_guest_register_map[reg]] = _context->x86_regs[reg];
+    }
+}
+
+#pragma mark - 指令模拟
+
+// 寄存器读写、ALU运算和有效地址计算与线程化解释器共用 Box64Interp.h 中的实现
+
+- (BOOL)executeALUOperation:(uint8_t)aluOp destination:(uint8_t)reg source:(uint64_t)src instruction:(const X86DecodedInsn *)insn {
+    const uint8_t size = insn->operand_size;
+    const BOOL hasRex = insn->rex != 0;
+    uint64_t result = box64_alu_compute(_context, aluOp, box64_read_gpr(_context, reg, size, hasRex), src, size);
     
-    if (_context->instruction_count >= maxInstructions) {
-        NSLog(@"[Box64Engine] INFO: Hit instruction limit %u, stopping execution", maxInstructions);
+    if (aluOp == 7) {  // CMP只更新标志
+        return YES;
+    }
+    return [self writeGuestRegister:reg value:result size:size hasRex:hasRex];
+}
+
+// r/m 为内存时的读-改-写；CMP只读
+- (BOOL)executeALUOperation:(uint8_t)aluOp memory:(uint64_t)guestAddress source:(uint64_t)src instruction:(const X86DecodedInsn *)insn {
+    uint64_t dst;
+    if (![self loadGuestMemory:guestAddress size:insn->operand_size value:&dst]) {
+        return NO;
     }
+    uint64_t result = box64_alu_compute(_context, aluOp, dst, src, insn->operand_size);
     
-    NSLog(@"[Box64Engine] 🎯 执行循环结束: 共执行 %u 条指令", _context->instruction_count);
+    if (aluOp == 7) {
+        return YES;
+    }
+    return [self storeGuestMemory:guestAddress size:insn->operand_size value:result];
+}
+
+#pragma mark - 客户机访存
+
+// 解释器的所有数据访问都经过MMU；缺页时记录错误并停止执行
+- (BOOL)loadGuestMemory:(uint64_t)guestAddress size:(uint8_t)size value:(uint64_t *)value {
+    if (box64_mmu_load(&_context->mmu, guestAddress, size, value)) {
+        return YES;
+    }
+    [self reportPageFault:guestAddress size:size];
+    return NO;
+}
+
+- (BOOL)storeGuestMemory:(uint64_t)guestAddress size:(uint8_t)size value:(uint64_t)value {
+    if (box64_mmu_store(&_context->mmu, guestAddress, size, value)) {
+        return YES;
+    }
+    [self reportPageFault:guestAddress size:size];
+    return NO;
+}
+
+- (void)reportPageFault:(uint64_t)guestAddress size:(uint8_t)size {
+    static const char *accessNames[BOX64_ACCESS_COUNT] = { "read", "write", "exec" };
+    const Box64MMU *mmu = &_context->mmu;
+    const char *accessName = mmu->fault_access < BOX64_ACCESS_COUNT ? accessNames[mmu->fault_access] : "?";
+    box64_trace(BOX64_TRACE_FAULT, _context->rip, 0, size, (uint32_t)guestAddress);
+    B64LogWarn(BOX64_LOG_MEMORY, @"[Box64Engine] SECURITY: Page fault on %s of %u bytes at 0x%llx (faulting page 0x%llx, RIP 0x%llx)",
+          accessName, size, guestAddress, mmu->fault_address & BOX64_PAGE_MASK, _context->rip);
+    _lastError = [NSString stringWithFormat:@"访问违例: %s 0x%llx", accessName, guestAddress];
+    [_safetyWarnings addObject:[NSString stringWithFormat:@"缺页 0x%llx", guestAddress]];
+}
+
+// 运算结果写回：RSP的64位写入仍走栈范围校验，其余是数据值直接写
+- (BOOL)writeGuestRegister:(uint8_t)reg value:(uint64_t)value size:(uint8_t)size hasRex:(BOOL)hasRex {
+    if (size == 1 && !hasRex && reg >= 4 && reg < 8) {
+        uint8_t base = reg - 4;
+        uint64_t merged = (_context->x86_regs[base] & ~0xFF00ULL) | ((value & 0xFF) << 8);
+        _context->x86_regs[base] = merged;
+        _context->arm64_regs[box64_jit_guest_register_map[base]] = merged;
+        return YES;
+    }
     
+    uint64_t merged = box64_merge_gpr(_context->x86_regs[reg], value, size);
+    if (reg == X86_RSP) {
+        return [self setX86Register:X86_RSP value:merged];
+    }
+    _context->x86_regs[reg] = merged;
+    _context->arm64_regs[box64_jit_guest_register_map[reg]] = merged;
     return YES;
 }
 
-// 🔧 新增：直接模拟指令执行，避免JIT编译问题
+// 线程化解释器不支持的指令逐条执行：安全模式拦截、反汇编日志、按操作数形式分派都在这里
+- (BOOL)executeFallbackInstruction:(const X86DecodedInsn *)insn address:(uint64_t)insnAddress {
+    if ((insn->flags & X86_INSN_UNSAFE) && _isSafeMode) {
+        B64LogWarn(BOX64_LOG_EXEC, @"[Box64Engine] SECURITY: Unsafe instruction %@ blocked in safe mode",
+              [self disassembleDecodedInstruction:insn address:insnAddress]);
+        return NO;
+    }
+    
+    (_processEngine ?: self)->_interpreterFallbacks++;
+    _context->last_valid_rip = insnAddress;
+    box64_trace(BOX64_TRACE_INSN, insnAddress, (uint16_t)(insn->map << 8 | insn->opcode), insn->length, 0);
+    
+    // x86语义：执行期间RIP指向下一条指令，跳转指令再覆盖
+    _context->rip = insnAddress + insn->length;
+    if (![self executeDecodedInstruction:insn address:insnAddress]) {
+        B64LogWarn(BOX64_LOG_EXEC, @"[Box64Engine] SECURITY: Failed to simulate %@ at 0x%llx",
+              [self disassembleDecodedInstruction:insn address:insnAddress], insnAddress);
+        return NO;
+    }
+    _context->instruction_count++;
+    
+    if (![self performSafetyCheckWithRIP:_context->rip]) {
+        B64LogWarn(BOX64_LOG_EXEC, @"[Box64Engine] SECURITY: Safety check failed after instruction %u", _context->instruction_count);
+        return NO;
+    }
+    return YES;
+}
+
+// 🔧 新增：直接模拟指令执行（兼容入口）
 - (BOOL)simulateInstructionExecution:(const X86Instruction *)instruction {
     if (!instruction || !instruction->is_valid) {
         return NO;
     }
+    return [self executeDecodedInstruction:&instruction->insn address:_context->rip];
+}
+
+// 按解码器给出的操作数形式分派；address 为本条指令的客户机地址
+- (BOOL)executeDecodedInstruction:(const X86DecodedInsn *)insn address:(uint64_t)address {
+    const BOOL hasRex = insn->rex != 0;
+    const BOOL registerOperand = !(insn->flags & X86_INSN_MEMORY);
+    const uint64_t nextAddress = address + insn->length;
     
-    NSLog(@"[Box64Engine] Simulating instruction: %s (opcode 0x%02X, length=%d)",
-          instruction->mnemonic, instruction->opcode, instruction->length);
+    // FS/GS 段基址（TLS）尚未建模，带段超越的内存访问按不支持处理
+    if (!registerOperand && (insn->segment == 0x64 || insn->segment == 0x65)) {
+        return [self handleUnsupportedInstruction:insn address:address];
+    }
+    const uint64_t guestAddress = registerOperand ? 0 : box64_effective_address(_context, insn, nextAddress);
     
-    switch (instruction->opcode) {
-        case 0x90:  // NOP
-            NSLog(@"[Box64Engine] ✅ NOP instruction executed");
-            break;
-            
-        case 0x48: {  // REX.W prefix instructions
-            // 🔧 关键修复：检查是否为立即数MOV指令
-            if (strstr(instruction->mnemonic, "MOV RAX,") != NULL && instruction->has_immediate) {
-                uint64_t immediate = instruction->immediate;
+    // MOVZX/MOVSX/MOVSXD：按源宽度读取，扩展后按目的宽度写回
+    bool signExtend;
+    const uint8_t sourceSize = box64_extend_source_size(insn, &signExtend);
+    if (sourceSize) {
+        uint64_t value;
+        if (registerOperand) {
+            value = box64_read_gpr(_context, insn->rm, sourceSize, hasRex);
+        } else if (![self loadGuestMemory:guestAddress size:sourceSize value:&value]) {
+            return NO;
+        }
+        if (signExtend) {
+            value = (uint64_t)box64_sign_extend(value, sourceSize);
+        }
+        return [self writeGuestRegister:insn->reg value:value size:insn->operand_size hasRex:hasRex];
+    }
+    
+    if (insn->map == X86_MAP_PRIMARY) {
+        uint8_t op = insn->opcode;
+        
+        // D8-DF / FWAIT：x87
+        if (box64_x87_supported(insn)) {
+            return [self executeX87Instruction:insn address:address];
+        }
+        
+        // A4-AF：MOVS/CMPS/STOS/LODS/SCAS（含REP前缀）
+        if (box64_string_supported(insn)) {
+            return [self executeStringInstruction:insn address:address];
+        }
+        
+        // 00-3F: ALU r/m,reg / reg,r/m / acc,imm
+        if (op < 0x40 && (op & 7) < 6) {
+            uint8_t aluOp = op >> 3;
+            switch (insn->form) {
+                case X86_FORM_RM_REG: {
+                    uint64_t src = box64_read_gpr(_context, insn->reg, insn->operand_size, hasRex);
+                    if (!registerOperand) {
+                        return [self executeALUOperation:aluOp memory:guestAddress source:src instruction:insn];
+                    }
+                    return [self executeALUOperation:aluOp destination:insn->rm source:src instruction:insn];
+                }
+                case X86_FORM_REG_RM: {
+                    uint64_t src;
+                    if (registerOperand) {
+                        src = box64_read_gpr(_context, insn->rm, insn->operand_size, hasRex);
+                    } else if (![self loadGuestMemory:guestAddress size:insn->operand_size value:&src]) {
+                        return NO;
+                    }
+                    return [self executeALUOperation:aluOp destination:insn->reg source:src instruction:insn];
+                }
+                case X86_FORM_ACC_IMM:
+                    return [self executeALUOperation:aluOp destination:X86_RAX source:(uint64_t)insn->imm instruction:insn];
+                default:
+                    break;
+            }
+            return [self handleUnsupportedInstruction:insn address:address];
+        }
+        
+        // 70-7F: Jcc rel8
+        if (op >= 0x70 && op <= 0x7F) {
+            if (box64_flags_condition(_context, op & 0x0F)) {
+                _context->rip = nextAddress + (uint64_t)insn->imm;
+            }
+            return YES;
+        }
+        
+        switch (op) {
+            case 0x50: case 0x51: case 0x52: case 0x53:  // PUSH r
+            case 0x54: case 0x55: case 0x56: case 0x57: {
+                const uint64_t value = box64_read_gpr(_context, insn->reg, insn->operand_size, hasRex);
+                const uint64_t rsp = _context->x86_regs[X86_RSP] - insn->operand_size;
+                return [self storeGuestMemory:rsp size:insn->operand_size value:value] &&
+                       [self writeGuestRegister:X86_RSP value:rsp size:8 hasRex:YES];
+            }
+                
+            case 0x58: case 0x59: case 0x5A: case 0x5B:  // POP r（POP RSP 以弹出的值为准）
+            case 0x5C: case 0x5D: case 0x5E: case 0x5F: {
+                const uint64_t rsp = _context->x86_regs[X86_RSP];
+                uint64_t value;
+                if (![self loadGuestMemory:rsp size:insn->operand_size value:&value] ||
+                    ![self writeGuestRegister:X86_RSP value:rsp + insn->operand_size size:8 hasRex:YES]) {
+                    return NO;
+                }
+                return [self writeGuestRegister:insn->reg value:value size:insn->operand_size hasRex:hasRex];
+            }
+                
+            case 0x69: case 0x6B: {  // IMUL reg, r/m, imm
+                uint64_t src;
+                if (registerOperand) {
+                    src = box64_read_gpr(_context, insn->rm, insn->operand_size, hasRex);
+                } else if (![self loadGuestMemory:guestAddress size:insn->operand_size value:&src]) {
+                    return NO;
+                }
+                uint64_t result = box64_imul_compute(_context, src, (uint64_t)insn->imm, insn->operand_size);
+                return [self writeGuestRegister:insn->reg value:result size:insn->operand_size hasRex:hasRex];
+            }
+                
+            case 0x84: case 0x85:  // TEST r/m, reg
+            case 0xA8: case 0xA9: {  // TEST acc, imm
+                const BOOL accumulator = op >= 0xA8;
+                uint64_t dst;
+                if (accumulator || registerOperand) {
+                    dst = box64_read_gpr(_context, accumulator ? X86_RAX : insn->rm, insn->operand_size, hasRex);
+                } else if (![self loadGuestMemory:guestAddress size:insn->operand_size value:&dst]) {
+                    return NO;
+                }
+                uint64_t src = accumulator ? (uint64_t)insn->imm & box64_size_mask(insn->operand_size)
+                                           : box64_read_gpr(_context, insn->reg, insn->operand_size, hasRex);
+                box64_flags_record(_context, BOX64_FLAGS_LOGIC, dst, src, dst & src, insn->operand_size);
+                return YES;
+            }
                 
-                // 🔧 使用立即数设置方法
-                if (![self setX86RegisterImmediate:X86_RAX value:immediate]) {
-                    NSLog(@"[Box64Engine] ❌ Failed to set RAX to immediate 0x%llx", immediate);
+            case 0xC0: case 0xC1:  // 移位组 r/m, imm8 / 1 / CL
+            case 0xD0: case 0xD1: case 0xD2: case 0xD3: {
+                const uint8_t count = op >= 0xD2 ? (uint8_t)_context->x86_regs[X86_RCX]
+                                                 : (op >= 0xD0 ? 1 : (uint8_t)insn->imm);
+                uint64_t dst;
+                if (registerOperand) {
+                    dst = box64_read_gpr(_context, insn->rm, insn->operand_size, hasRex);
+                } else if (![self loadGuestMemory:guestAddress size:insn->operand_size value:&dst]) {
                     return NO;
                 }
+                uint64_t result = box64_shift_compute(_context, x86_insn_group_op(insn), dst, count, insn->operand_size);
+                if (!registerOperand) {
+                    return [self storeGuestMemory:guestAddress size:insn->operand_size value:result];
+                }
+                return [self writeGuestRegister:insn->rm value:result size:insn->operand_size hasRex:hasRex];
+            }
+                
+            case 0x90:  // NOP / XCHG r, rAX
+            case 0x91: case 0x92: case 0x93: case 0x94: case 0x95: case 0x96: case 0x97: {
+                if (insn->reg == X86_RAX) {
+                    return YES;
+                }
+                uint64_t a = box64_read_gpr(_context, X86_RAX, insn->operand_size, hasRex);
+                uint64_t b = box64_read_gpr(_context, insn->reg, insn->operand_size, hasRex);
+                return [self writeGuestRegister:X86_RAX value:b size:insn->operand_size hasRex:hasRex] &&
+                       [self writeGuestRegister:insn->reg value:a size:insn->operand_size hasRex:hasRex];
+            }
                 
-                NSLog(@"[Box64Engine] ✅ REX.W MOV RAX, 0x%llx executed successfully", immediate);
+            case 0x80: case 0x81: case 0x83:  // ALU r/m, imm
+                if (!registerOperand) {
+                    return [self executeALUOperation:x86_insn_group_op(insn) memory:guestAddress
+                                              source:(uint64_t)insn->imm instruction:insn];
+                }
+                return [self executeALUOperation:x86_insn_group_op(insn) destination:insn->rm
+                                          source:(uint64_t)insn->imm instruction:insn];
                 
-            } else if (strstr(instruction->mnemonic, "MOV RCX,") != NULL && instruction->has_immediate) {
-                uint64_t immediate = instruction->immediate;
+            case 0x88: case 0x89: {  // MOV r/m, reg
+                uint64_t value = box64_read_gpr(_context, insn->reg, insn->operand_size, hasRex);
+                if (!registerOperand) {
+                    return [self storeGuestMemory:guestAddress size:insn->operand_size value:value];
+                }
+                return [self writeGuestRegister:insn->rm value:value size:insn->operand_size hasRex:hasRex];
+            }
                 
-                // 🔧 使用立即数设置方法
-                if (![self setX86RegisterImmediate:X86_RCX value:immediate]) {
-                    NSLog(@"[Box64Engine] ❌ Failed to set RCX to immediate 0x%llx", immediate);
+            case 0x8A: case 0x8B: {  // MOV reg, r/m
+                uint64_t value;
+                if (registerOperand) {
+                    value = box64_read_gpr(_context, insn->rm, insn->operand_size, hasRex);
+                } else if (![self loadGuestMemory:guestAddress size:insn->operand_size value:&value]) {
                     return NO;
                 }
+                return [self writeGuestRegister:insn->reg value:value size:insn->operand_size hasRex:hasRex];
+            }
+                
+            case 0x8D:  // LEA reg, m（只计算地址，不访存）
+                if (registerOperand) break;
+                return [self writeGuestRegister:insn->reg value:guestAddress size:insn->operand_size hasRex:hasRex];
                 
-                NSLog(@"[Box64Engine] ✅ REX.W MOV RCX, 0x%llx executed successfully", immediate);
+            case 0xB0: case 0xB1: case 0xB2: case 0xB3:  // MOV r8, imm8
+            case 0xB4: case 0xB5: case 0xB6: case 0xB7:
+                return [self writeGuestRegister:insn->reg value:(uint64_t)insn->imm size:1 hasRex:hasRex];
+                
+            case 0xB8: case 0xB9: case 0xBA: case 0xBB:  // MOV reg, imm32/imm64
+            case 0xBC: case 0xBD: case 0xBE: case 0xBF: {
+                uint64_t value = box64_merge_gpr(_context->x86_regs[insn->reg], (uint64_t)insn->imm, insn->operand_size);
+                // 🔧 关键修复：使用立即数设置方法
+                if (![self setX86RegisterImmediate:(X86Register)insn->reg value:value]) {
+                    B64LogError(BOX64_LOG_EXEC, @"[Box64Engine] ❌ Failed to set register %u to immediate 0x%llx", insn->reg, value);
+                    return NO;
+                }
+                return YES;
+            }
                 
-            } else if (strstr(instruction->mnemonic, "SUB RSP,") != NULL && instruction->has_immediate) {
-                // SUB RSP, imm8 - 栈指针减法（非立即数，是计算结果）
-                uint64_t currentRSP = [self getX86Register:X86_RSP];
-                uint64_t newRSP = currentRSP - instruction->immediate;
+            case 0xC6:  // MOV m8, imm8
+                if (registerOperand || x86_insn_group_op(insn) != 0) break;
+                return [self storeGuestMemory:guestAddress size:1 value:(uint64_t)insn->imm];
                 
-                // 栈指针操作使用常规方法（会进行栈范围检查）
-                if (![self setX86Register:X86_RSP value:newRSP]) {
-                    NSLog(@"[Box64Engine] ❌ Failed to update RSP: 0x%llx -> 0x%llx", currentRSP, newRSP);
+            case 0xC7:  // MOV r/m, imm32（64位时符号扩展）
+                if (x86_insn_group_op(insn) != 0) break;
+                if (!registerOperand) {
+                    return [self storeGuestMemory:guestAddress size:insn->operand_size value:(uint64_t)insn->imm];
+                }
+                if (![self setX86RegisterImmediate:(X86Register)insn->rm
+                                             value:box64_merge_gpr(_context->x86_regs[insn->rm], (uint64_t)insn->imm, insn->operand_size)]) {
+                    B64LogError(BOX64_LOG_EXEC, @"[Box64Engine] ❌ Failed to set register %u to immediate 0x%llx", insn->rm, insn->imm);
                     return NO;
                 }
+                return YES;
                 
-                NSLog(@"[Box64Engine] ✅ SUB RSP, 0x%llx: 0x%llx -> 0x%llx",
-                      instruction->immediate, currentRSP, newRSP);
+            case 0xE8:  // CALL rel32
+                return [self callGuestTarget:nextAddress + (uint64_t)insn->imm returnAddress:nextAddress];
                 
-            } else {
-                NSLog(@"[Box64Engine] ✅ REX.W instruction executed (generic): %s", instruction->mnemonic);
+            case 0xFE: case 0xFF: {  // INC/DEC r/m（CF保持不变）
+                uint8_t groupOp = x86_insn_group_op(insn);
+                if (op == 0xFF && (groupOp == 2 || groupOp == 4)) {  // CALL / JMP r/m64，导入调用即 CALL [RIP+IAT]
+                    uint64_t target;
+                    if (registerOperand) {
+                        target = _context->x86_regs[insn->rm];
+                    } else if (![self loadGuestMemory:guestAddress size:8 value:&target]) {
+                        return NO;
+                    }
+                    if (groupOp == 4) {
+                        _context->rip = target;
+                        return YES;
+                    }
+                    return [self callGuestTarget:target returnAddress:nextAddress];
+                }
+                if (groupOp > 1) break;
+                uint64_t dst;
+                if (registerOperand) {
+                    dst = box64_read_gpr(_context, insn->rm, insn->operand_size, hasRex);
+                } else if (![self loadGuestMemory:guestAddress size:insn->operand_size value:&dst]) {
+                    return NO;
+                }
+                uint64_t result = (groupOp == 0 ? dst + 1 : dst - 1) & box64_size_mask(insn->operand_size);
+                box64_flags_record_incdec(_context, groupOp == 0, dst, result, insn->operand_size);
+                if (!registerOperand) {
+                    return [self storeGuestMemory:guestAddress size:insn->operand_size value:result];
+                }
+                return [self writeGuestRegister:insn->rm value:result size:insn->operand_size hasRex:hasRex];
             }
-            break;
+                
+            case 0xE0: case 0xE1: case 0xE2: {  // LOOPNE / LOOPE / LOOP
+                uint64_t count = _context->x86_regs[X86_RCX] - 1;
+                _context->x86_regs[X86_RCX] = count;
+                _context->arm64_regs[box64_jit_guest_register_map[X86_RCX]] = count;
+                // LOOPE/LOOPNE 读 ZF（条件码 E=4 / NE=5），LOOP 不读标志
+                BOOL taken = count != 0 && (op == 0xE2 || box64_flags_condition(_context, op == 0xE1 ? 0x4 : 0x5));
+                if (taken) {
+                    _context->rip = nextAddress + (uint64_t)insn->imm;
+                }
+                return YES;
+            }
+                
+            case 0xE3:  // JRCXZ
+                if (_context->x86_regs[X86_RCX] == 0) {
+                    _context->rip = nextAddress + (uint64_t)insn->imm;
+                }
+                return YES;
+                
+            case 0xE9: case 0xEB:  // JMP rel32 / rel8
+                _context->rip = nextAddress + (uint64_t)insn->imm;
+                return YES;
+                
+            case 0xC2:  // RET imm16
+                return _guestCallDepth == 0 || [self returnFromGuestCallReleasing:(uint16_t)insn->imm];
+                
+            case 0xC3:  // RET
+                return _guestCallDepth == 0 || [self returnFromGuestCallReleasing:0];
+                
+            case 0xFC:  // CLD
+                _context->rflags &= ~(uint64_t)X86_FLAG_DF;
+                return YES;
+                
+            case 0xFD:  // STD
+                _context->rflags |= X86_FLAG_DF;
+                return YES;
+                
+            default:
+                break;
         }
-        
-        case 0xB8: case 0xB9: case 0xBA: case 0xBB:  // MOV reg, imm32
-        case 0xBC: case 0xBD: case 0xBE: case 0xBF: {
-            X86Register reg = (X86Register)(instruction->opcode & 7);
-            uint64_t immediate = instruction->immediate;
-            
-            // 🔧 关键修复：使用立即数设置方法
-            if (![self setX86RegisterImmediate:reg value:immediate]) {
-                NSLog(@"[Box64Engine] ❌ Failed to set register %d to immediate 0x%llx", reg, immediate);
+    } else if (insn->map == X86_MAP_0F) {
+        if (insn->opcode >= 0x80 && insn->opcode <= 0x8F) {  // Jcc rel32
+            if (box64_flags_condition(_context, insn->opcode & 0x0F)) {
+                _context->rip = nextAddress + (uint64_t)insn->imm;
+            }
+            return YES;
+        }
+        if (insn->opcode >= 0x18 && insn->opcode <= 0x1F) {
+            return YES;  // 多字节NOP / 预取提示
+        }
+        if (insn->opcode >= 0x90 && insn->opcode <= 0x9F) {  // SETcc r/m8
+            BOOL value = box64_flags_condition(_context, insn->opcode & 0x0F);
+            if (!registerOperand) {
+                return [self storeGuestMemory:guestAddress size:1 value:value];
+            }
+            return [self writeGuestRegister:insn->rm value:value size:1 hasRex:hasRex];
+        }
+        if (insn->opcode >= 0x40 && insn->opcode <= 0x4F) {  // CMOVcc reg, r/m
+            // 内存源无论条件是否成立都会读取（可能缺页）；条件不成立时32位形式仍会清零高32位
+            uint64_t src;
+            if (registerOperand) {
+                src = box64_read_gpr(_context, insn->rm, insn->operand_size, hasRex);
+            } else if (![self loadGuestMemory:guestAddress size:insn->operand_size value:&src]) {
                 return NO;
             }
-            
-            NSLog(@"[Box64Engine] ✅ MOV r%d, 0x%llx executed successfully", reg, immediate);
-            break;
+            uint64_t value = box64_flags_condition(_context, insn->opcode & 0x0F)
+                ? src
+                : box64_read_gpr(_context, insn->reg, insn->operand_size, hasRex);
+            return [self writeGuestRegister:insn->reg value:value size:insn->operand_size hasRex:hasRex];
         }
-        
-        case 0xC3:  // RET
-            NSLog(@"[Box64Engine] ✅ RET instruction - ending execution");
-            return YES;
-            
-        default:
-            if (_isSafeMode) {
-                NSLog(@"[Box64Engine] SECURITY: Unsupported opcode 0x%02X in safe mode", instruction->opcode);
+        if (insn->opcode == 0xAF) {  // IMUL reg, r/m
+            uint64_t src;
+            if (registerOperand) {
+                src = box64_read_gpr(_context, insn->rm, insn->operand_size, hasRex);
+            } else if (![self loadGuestMemory:guestAddress size:insn->operand_size value:&src]) {
                 return NO;
-            } else {
-                NSLog(@"[Box64Engine] ⚠️ WARNING: Unsupported opcode 0x%02X, treating as NOP", instruction->opcode);
             }
+            uint64_t result = box64_imul_compute(_context, box64_read_gpr(_context, insn->reg, insn->operand_size, hasRex),
+                                                 src, insn->operand_size);
+            return [self writeGuestRegister:insn->reg value:result size:insn->operand_size hasRex:hasRex];
+        }
+        const Box64SseOp sse = box64_sse_classify(insn);
+        if (sse != BOX64_SSE_NONE) {
+            return [self executeSSEInstruction:insn operation:sse address:address];
+        }
+    }
+    
+    return [self handleUnsupportedInstruction:insn address:address];
+}
+
+// SSE/SSE2：XMM寄存器只在 _context 中，通用寄存器可能被 MOVD / CVT*2SI / PMOVMSKB 改写，成功后同步镜像
+- (BOOL)executeSSEInstruction:(const X86DecodedInsn *)insn operation:(Box64SseOp)operation address:(uint64_t)address {
+    uint64_t faultAddress = 0;
+    switch (box64_sse_execute(_context, insn, operation, address + insn->length, &faultAddress)) {
+        case BOX64_SSE_OK:
+            [self syncHostRegisterMirror];
+            return YES;
+        case BOX64_SSE_FAULT:
+            [self reportPageFault:faultAddress size:box64_sse_memory_size(operation, insn)];
+            return NO;
+        case BOX64_SSE_MISALIGNED:
+            B64LogWarn(BOX64_LOG_EXEC, @"[Box64Engine] SECURITY: #GP on misaligned 16-byte operand (%s) at RIP 0x%llx",
+                       box64_sse_op_name(operation), address);
+            _lastError = [NSString stringWithFormat:@"SSE操作数未对齐: %s", box64_sse_op_name(operation)];
+            return NO;
+        case BOX64_SSE_UNSUPPORTED:
             break;
     }
+    return [self handleUnsupportedInstruction:insn address:address];
+}
+
+// x87：寄存器栈只在 _context 中，FNSTSW AX 会改写通用寄存器，成功后同步镜像
+- (BOOL)executeX87Instruction:(const X86DecodedInsn *)insn address:(uint64_t)address {
+    uint64_t faultAddress = 0;
+    switch (box64_x87_execute(_context, insn, address + insn->length, &faultAddress)) {
+        case BOX64_X87_OK:
+            [self syncHostRegisterMirror];
+            return YES;
+        case BOX64_X87_FAULT:
+            [self reportPageFault:faultAddress size:box64_x87_memory_size(insn)];
+            return NO;
+        case BOX64_X87_UNSUPPORTED:
+            break;
+    }
+    return [self handleUnsupportedInstruction:insn address:address];
+}
+
+// 字符串指令：REP 形式整段执行，改写 RSI/RDI/RCX（LODS 改写 RAX），成功或缺页后都要同步镜像
+// 缺页时已完成的元素保留，寄存器指向出错的元素，重新执行本指令即可继续
+- (BOOL)executeStringInstruction:(const X86DecodedInsn *)insn address:(uint64_t)address {
+    uint64_t faultAddress = 0;
+    switch (box64_string_execute(_context, insn, &faultAddress)) {
+        case BOX64_STRING_OK:
+            [self syncHostRegisterMirror];
+            return YES;
+        case BOX64_STRING_FAULT:
+            [self syncHostRegisterMirror];
+            [self reportPageFault:faultAddress size:insn->operand_size];
+            return NO;
+        case BOX64_STRING_UNSUPPORTED:
+            break;
+    }
+    return [self handleUnsupportedInstruction:insn address:address];
+}
+
+// 跳过不认识的指令会让之后的寄存器和内存状态悄悄出错，无论是否安全模式都让当前块失败
+- (BOOL)handleUnsupportedInstruction:(const X86DecodedInsn *)insn address:(uint64_t)address {
+    NSString *text = [self disassembleDecodedInstruction:insn address:address];
+    B64LogWarn(BOX64_LOG_EXEC, @"[Box64Engine] SECURITY: Unsupported instruction %@ at 0x%llx", text, address);
+    _lastError = [NSString stringWithFormat:@"不支持的指令: %@", text];
+    return NO;
+}
+
+#pragma mark - 调用与导入桩
+
+// CALL：压入返回地址后跳转；RSP 的写入经过栈范围校验
+- (BOOL)callGuestTarget:(uint64_t)target returnAddress:(uint64_t)returnAddress {
+    const uint64_t rsp = _context->x86_regs[X86_RSP] - 8;
+    if (![self storeGuestMemory:rsp size:8 value:returnAddress] ||
+        ![self writeGuestRegister:X86_RSP value:rsp size:8 hasRex:YES]) {
+        return NO;
+    }
+    _guestCallDepth++;
+    _context->rip = target;
+    return YES;
+}
+
+// RET imm16 弹出返回地址后再释放 bytes 字节参数
+- (BOOL)returnFromGuestCallReleasing:(uint16_t)bytes {
+    const uint64_t rsp = _context->x86_regs[X86_RSP];
+    uint64_t target;
+    if (![self loadGuestMemory:rsp size:8 value:&target] ||
+        ![self writeGuestRegister:X86_RSP value:rsp + 8 + bytes size:8 hasRex:YES]) {
+        return NO;
+    }
+    _guestCallDepth--;
+    _context->rip = target;
+    return YES;
+}
+
+// 执行到导入桩：调用宿主实现并返回到调用者；未实现的导入停止执行并报告名称
+// 槽位在 codeGate 读锁下解析和读取（导入表只在写锁下销毁或重新绑定）；桩可能阻塞
+// （WaitForSingleObject、EnterCriticalSection、Sleep），调用期间释放读锁，此时只用注册表持有的数据
+- (BOOL)dispatchImportAt:(uint64_t)rip finished:(BOOL *)finished {
+    const Box64ImportSlot *slot = NULL;
+    const Box64Thunk *thunk = NULL;
+    Box64ThunkCall call;
+    Box64ThunkStatus status = box64_imports_prepare(_imports, _context, rip, &call, &thunk, &slot);
+    const uint32_t slotIndex = slot ? (uint32_t)(slot - _imports->slots) : UINT32_MAX;
+    if (status == BOX64_THUNK_OK) {
+        box64_rwlock_read_unlock(&_shared->codeGate);
+        status = box64_imports_call(thunk, &call);
+        box64_rwlock_read_lock(&_shared->codeGate);
+    }
+    
+    switch (status) {
+        case BOX64_THUNK_OK:
+        case BOX64_THUNK_EXIT:
+            box64_trace(BOX64_TRACE_THUNK, rip, 0, 0, slotIndex);
+            [self syncHostRegisterMirror];
+            _context->instruction_count++;
+            if (_guestCallDepth > 0) {
+                _guestCallDepth--;
+            }
+            if (status == BOX64_THUNK_EXIT) {
+                if (_threadExitRequested) {
+                    B64LogInfo(BOX64_LOG_EXEC, @"[Box64Engine] Guest called ExitThread(%u)", _threadExitCode);
+                } else {
+                    B64LogInfo(BOX64_LOG_EXEC, @"[Box64Engine] Guest called ExitProcess(%u)", (_processEngine ?: self).guestExitCode);
+                }
+                *finished = YES;
+                return YES;
+            }
+            return [self performSafetyCheckWithRIP:_context->rip];
+            
+        case BOX64_THUNK_FAULT:
+            [self reportPageFault:_context->x86_regs[X86_RSP] size:8];
+            return NO;
+            
+        case BOX64_THUNK_UNRESOLVED:
+            break;
+    }
+    
+    char name[BOX64_THUNK_NAME_MAX + 64];
+    box64_imports_describe(_imports, &_context->mmu, slot, name, sizeof(name));
+    box64_trace(BOX64_TRACE_FAULT, rip, 0, 0, slotIndex);
+    B64LogWarn(BOX64_LOG_EXEC, @"[Box64Engine] SECURITY: Call to unimplemented import %s (stub 0x%llx)", name, rip);
+    _lastError = [NSString stringWithFormat:@"未实现的导入函数: %s", name];
+    return NO;
+}
+
+- (void)registerKernel32Thunks {
+    static const struct { const char *name; Box64ThunkFn fn; uint8_t argCount; } kernel32[] = {
+        { "GetProcessHeap",   thunk_GetProcessHeap,   0 },
+        { "HeapAlloc",        thunk_HeapAlloc,        3 },
+        { "HeapFree",         thunk_HeapFree,         3 },
+        { "HeapReAlloc",      thunk_HeapReAlloc,      4 },
+        { "HeapSize",         thunk_HeapSize,         3 },
+        { "VirtualAlloc",     thunk_VirtualAlloc,     4 },
+        { "VirtualFree",      thunk_VirtualFree,      3 },
+        { "GetModuleHandleA", thunk_GetModuleHandleA, 1 },
+        { "ExitProcess",      thunk_ExitProcess,      1 },
+        { "CreateThread",                           thunk_CreateThread,                           6 },
+        { "ExitThread",                             thunk_ExitThread,                             1 },
+        { "ResumeThread",                           thunk_ResumeThread,                           1 },
+        { "GetExitCodeThread",                      thunk_GetExitCodeThread,                      2 },
+        { "WaitForSingleObject",                    thunk_WaitForSingleObject,                    2 },
+        { "CloseHandle",                            thunk_CloseHandle,                            1 },
+        { "Sleep",                                  thunk_Sleep,                                  1 },
+        { "InitializeCriticalSection",              thunk_InitializeCriticalSection,              1 },
+        { "InitializeCriticalSectionAndSpinCount",  thunk_InitializeCriticalSectionAndSpinCount,  2 },
+        { "EnterCriticalSection",                   thunk_EnterCriticalSection,                   1 },
+        { "TryEnterCriticalSection",                thunk_TryEnterCriticalSection,                1 },
+        { "LeaveCriticalSection",                   thunk_LeaveCriticalSection,                   1 },
+        { "DeleteCriticalSection",                  thunk_DeleteCriticalSection,                  1 },
+        { "CreateEventA",                           thunk_CreateEventA,                           4 },
+        { "SetEvent",                               thunk_SetEvent,                               1 },
+        { "ResetEvent",                             thunk_ResetEvent,                             1 },
+    };
+    for (size_t i = 0; i < sizeof(kernel32) / sizeof(kernel32[0]); i++) {
+        box64_thunk_register(_thunkRegistry, "kernel32.dll", kernel32[i].name, kernel32[i].fn,
+                             kernel32[i].argCount, (__bridge void *)self);
+    }
+}
+
+// 扫描导入目录，从客户机堆分配桩区并改写IAT；没有导入的镜像不分配
+// 桩只被块循环按地址识别，不会被翻译执行，写完后设为只读防止客户机改写
+// 新表在局部变量里建好，再在 codeGate 写锁下替换：执行中的线程持读锁访问导入表
+- (BOOL)bindImportsForImage:(const Box64PEImage *)image {
+    Box64ImportTable table;
+    box64_imports_init(&table, _thunkRegistry);
+    Box64ImportStatus status = box64_imports_scan(&table, &_context->mmu, image);
+    if (status == BOX64_IMPORT_OK && table.count > 0) {
+        const uint64_t stubSize = box64_imports_stub_size(&table);
+        const uint64_t stubBase = [self allocateGuestPages:(size_t)stubSize executable:NO];
+        status = stubBase ? box64_imports_bind(&table, &_context->mmu, stubBase) : BOX64_IMPORT_NO_MEMORY;
+        if (status == BOX64_IMPORT_OK) {
+            box64_mmu_protect(&_context->mmu, stubBase, stubSize, BOX64_PROT_READ);
+        } else if (stubBase) {
+            [self freeGuestHeap:stubBase];
+        }
+    }
+    if (status == BOX64_IMPORT_OK) {
+        box64_rwlock_write_lock(&_shared->codeGate);
+        box64_imports_destroy(&_importTable);
+        _importTable = table;
+        box64_rwlock_write_unlock(&_shared->codeGate);
+    } else {
+        box64_imports_destroy(&table);
+        B64LogWarn(BOX64_LOG_MEMORY, @"[Box64Engine] SECURITY: Failed to bind imports (%s)", box64_import_status_string(status));
+        _lastError = [NSString stringWithFormat:@"导入表绑定失败: %s", box64_import_status_string(status)];
+        return NO;
+    }
+    if (_importTable.count > 0) {
+        B64LogInfo(BOX64_LOG_MEMORY, @"[Box64Engine] Bound %u imports from %u DLLs to stubs at 0x%llx",
+              _importTable.count, _importTable.dll_count, _importTable.stub_base);
+    }
+    return YES;
+}
+
+// 先在 codeGate 写锁下摘掉导入表，再回收桩区（回收可能失效翻译缓存，要自己拿写锁）
+- (void)releaseImportStubs {
+    const uint64_t stubBase = _importTable.count > 0 ? _importTable.stub_base : 0;
+    const uint64_t stubSize = box64_imports_stub_size(&_importTable);
+    box64_rwlock_write_lock(&_shared->codeGate);
+    box64_imports_destroy(&_importTable);
+    box64_rwlock_write_unlock(&_shared->codeGate);
+    if (stubBase) {
+        box64_mmu_protect(&_context->mmu, stubBase, stubSize, BOX64_PROT_READ | BOX64_PROT_WRITE);
+        [self freeGuestHeap:stubBase];
+    }
+}
+
+- (NSDictionary *)getImportStatistics {
+    [self lockProcessState];
+    
+    @try {
+        uint64_t calls = 0;
+        for (uint32_t i = 0; i < _importTable.count; i++) {
+            calls += _importTable.slots[i].calls;
+        }
+        return @{
+            @"imports": @(_importTable.count),
+            @"dlls": @(_importTable.dll_count),
+            @"resolved": @(atomic_load(&_importTable.resolved)),
+            @"calls": @(calls),
+            @"registered_thunks": @(box64_thunk_registry_count(_thunkRegistry)),
+        };
+    } @finally {
+        [self unlockProcessState];
+    }
+}
+
+#pragma mark - 客户机线程
+
+// CreateThread：新线程引擎 + 从客户机堆分配的栈；返回线程句柄，失败返回0
+// 线程先以挂起状态创建，句柄分配成功后才按 suspended 决定是否放行
+- (uint64_t)createGuestThreadAt:(uint64_t)start parameter:(uint64_t)parameter stackSize:(uint64_t)stackSize
+                      suspended:(BOOL)suspended threadId:(uint32_t *)threadId {
+    if (!_boundCode || start < _boundCodeBase || start - _boundCodeBase >= _boundCodeLength) {
+        B64LogWarn(BOX64_LOG_EXEC, @"[Box64Engine] SECURITY: CreateThread start 0x%llx outside code range 0x%llx-0x%llx",
+                   start, _boundCodeBase, _boundCodeBase + _boundCodeLength);
+        return 0;
+    }
+    if (atomic_load(&_shared->exiting)) {
+        return 0;
+    }
+    
+    uint64_t size = stackSize ? stackSize : BOX64_GUEST_THREAD_STACK_SIZE;
+    size = MIN(MAX(size, BOX64_GUEST_THREAD_STACK_MIN), BOX64_GUEST_THREAD_STACK_MAX);
+    size = (size + BOX64_PAGE_OFFSET_MASK) & BOX64_PAGE_MASK;
+    const uint64_t stack = [self allocateGuestPages:(size_t)size executable:NO];
+    if (!stack) {
+        B64LogWarn(BOX64_LOG_EXEC, @"[Box64Engine] WARNING: No guest memory for %llu-byte thread stack", size);
+        return 0;
+    }
+    
+    Box64Engine *engine = [[Box64Engine alloc] initWithProcessEngine:(_processEngine ?: self)];
+    if (!engine) {
+        [self freeGuestHeap:stack];
+        return 0;
+    }
+    Box64Context *ctx = engine->_context;
+    ctx->stack_base = stack;
+    ctx->stack_size = size;
+    ctx->max_instructions = BOX64_GUEST_THREAD_MAX_INSTRUCTIONS;
+    // 入口栈帧：返回地址0加影子空间；线程函数返回时调用深度为0，执行结束，RAX 即退出码
+    const uint64_t rsp = stack + size - WIN64_ENTRY_FRAME_SIZE;
+    box64_mmu_store(&ctx->mmu, rsp, 8, 0);
+    ctx->x86_regs[X86_RSP] = rsp;
+    ctx->x86_regs[X86_RCX] = parameter;
+    [engine syncHostRegisterMirror];
+    engine->_boundCode = _boundCode;
+    engine->_boundCodeLength = _boundCodeLength;
+    engine->_boundCodeBase = _boundCodeBase;
+    engine->_threadStackBase = stack;
+    engine->_threadStart = start;
     
-    return YES;
+    // 在线程能运行之前计入，drain 不会漏掉刚创建的线程；runGuestThread 返回前减去
+    atomic_fetch_add(&_shared->liveThreads, 1);
+    Box64Thread *thread = box64_thread_create(guest_thread_main, guest_thread_destroy,
+                                              (__bridge_retained void *)engine, true, 0);
+    if (!thread) {
+        atomic_fetch_sub(&_shared->liveThreads, 1);
+        CFBridgingRelease((__bridge void *)engine);
+        [self freeGuestHeap:stack];
+        B64LogWarn(BOX64_LOG_EXEC, @"[Box64Engine] WARNING: Failed to create host thread for 0x%llx", start);
+        return 0;
+    }
+    
+    box64_lock(&_shared->handleLock);
+    const WineHandle handle = wine_handles_alloc(_shared->kernelHandles, WINE_HANDLE_THREAD, thread);
+    box64_unlock(&_shared->handleLock);
+    if (!handle) {
+        // 没有句柄就不能让客户机看到这个线程：放行后立即以失败退出，栈由线程自己释放
+        engine->_threadExitRequested = YES;
+        box64_thread_resume(thread);
+        box64_thread_release(thread);
+        return 0;
+    }
+    if (threadId) {
+        *threadId = box64_thread_id(thread);
+    }
+    if (!suspended) {
+        box64_thread_resume(thread);
+    }
+    B64LogDebug(BOX64_LOG_EXEC, @"[Box64Engine] Guest thread %u created at 0x%llx (stack 0x%llx, %llu bytes%s)",
+                box64_thread_id(thread), start, stack, size, suspended ? ", suspended" : "");
+    return handle;
+}
+
+// 在客户机线程自己的 pthread 上运行；返回线程退出码
+- (uint32_t)runGuestThread {
+    uint32_t exitCode = BOX64_THREAD_FAILURE_EXIT_CODE;
+    if (!_threadExitRequested) {
+        const BOOL success = [self executeGuestCodeAt:_threadStart codeStart:_boundCodeBase length:_boundCodeLength
+                                      maxInstructions:_context->max_instructions];
+        if (_threadExitRequested) {
+            exitCode = _threadExitCode;
+        } else if (_instructionLimitHit) {
+            // 预算用完不是正常返回，RAX 里不是退出码
+            B64LogWarn(BOX64_LOG_EXEC, @"[Box64Engine] WARNING: Guest thread %u stopped at the %u-instruction limit (rip 0x%llx)",
+                       box64_thread_current_id(), _context->max_instructions, _context->rip);
+        } else if (success) {
+            exitCode = (uint32_t)_context->x86_regs[X86_RAX];
+        }
+    }
+    // 被 ExitProcess 结束的线程以进程退出码结束
+    if (atomic_load(&_shared->exiting)) {
+        exitCode = _processEngine.guestExitCode;
+    }
+    [self freeGuestHeap:_threadStackBase];
+    _threadStackBase = 0;
+    B64LogDebug(BOX64_LOG_EXEC, @"[Box64Engine] Guest thread %u exited with %u", box64_thread_current_id(), exitCode);
+    // 之后不再访问进程内存，drain 可以放行 cleanup
+    atomic_fetch_sub(&_shared->liveThreads, 1);
+    return exitCode;
 }
 
-#pragma mark - 指令解码 - 增强版本
+#pragma mark - 指令解码 - 表驱动
 
-// 🔧 第七步：确保指令解码标记立即数指令为安全
 - (X86Instruction)decodeInstruction:(const uint8_t *)instruction maxLength:(size_t)maxLength {
-    X86Instruction decoded = {0};
+    X86Instruction decoded;
     
     if (!instruction || maxLength == 0) {
-        NSLog(@"[Box64Engine] SECURITY: decodeInstruction: invalid parameters");
+        memset(&decoded, 0, sizeof(decoded));
+        B64LogWarn(BOX64_LOG_DECODE, @"[Box64Engine] SECURITY: decodeInstruction: invalid parameters");
         decoded.is_valid = NO;
-        strcpy(decoded.mnemonic, "INVALID");
         return decoded;
     }
     
-    decoded.opcode = instruction[0];
-    decoded.length = 1;
-    decoded.is_valid = YES;
-    decoded.is_safe = YES;  // 🔧 默认为安全
+    X86DecodeStatus status = x86_decode(instruction, maxLength, &decoded.insn);
+    const X86DecodedInsn *insn = &decoded.insn;
     
-    switch (decoded.opcode) {
-        case 0x90:  // NOP
-            strcpy(decoded.mnemonic, "NOP");
-            break;
-            
-        case 0x48:  // REX.W prefix
-            if (maxLength < 2) {
-                decoded.is_valid = NO;
-                strcpy(decoded.mnemonic, "TRUNCATED_REX");
-                break;
-            }
-            
-            uint8_t next_opcode = instruction[1];
-            
-            if (next_opcode == 0xC7 && maxLength >= 7) {
-                uint8_t modrm = instruction[2];
-                if (modrm == 0xC0) {  // MOV RAX, imm32
-                    decoded.length = 7;
-                    decoded.has_immediate = YES;
-                    decoded.immediate = *(uint32_t *)(instruction + 3);
-                    sprintf(decoded.mnemonic, "MOV RAX, 0x%X", (uint32_t)decoded.immediate);
-                    // 🔧 立即数指令总是安全的
-                    decoded.is_safe = YES;
-                    NSLog(@"[Box64Engine] Decoded immediate MOV RAX, 0x%X", (uint32_t)decoded.immediate);
-                } else if (modrm == 0xC1) {  // MOV RCX, imm32
-                    decoded.length = 7;
-                    decoded.has_immediate = YES;
-                    decoded.immediate = *(uint32_t *)(instruction + 3);
-                    sprintf(decoded.mnemonic, "MOV RCX, 0x%X", (uint32_t)decoded.immediate);
-                    decoded.is_safe = YES;
-                    NSLog(@"[Box64Engine] Decoded immediate MOV RCX, 0x%X", (uint32_t)decoded.immediate);
-                } else {
-                    decoded.length = 7;
-                    sprintf(decoded.mnemonic, "REX.W+MOV_RM64");
-                }
-                
-            } else if (next_opcode == 0x83 && maxLength >= 4) {
-                uint8_t modrm = instruction[2];
-                uint8_t immediate = instruction[3];
-                decoded.length = 4;
-                decoded.has_immediate = YES;
-                decoded.immediate = immediate;
-                
-                uint8_t reg_field = (modrm >> 3) & 7;
-                uint8_t rm_field = modrm & 7;
-                
-                if (reg_field == 5 && rm_field == 4) {  // SUB RSP, imm8
-                    sprintf(decoded.mnemonic, "SUB RSP, 0x%02X", immediate);
-                    decoded.is_safe = YES;
-                } else if (reg_field == 0) {  // ADD
-                    sprintf(decoded.mnemonic, "ADD r%d, 0x%02X", rm_field, immediate);
-                    decoded.is_safe = YES;
-                } else {
-                    sprintf(decoded.mnemonic, "REX.W+ARITH r%d, 0x%02X", rm_field, immediate);
-                    decoded.is_safe = YES;
-                }
-                
-            } else {
-                decoded.length = 2;
-                sprintf(decoded.mnemonic, "REX.W+0x%02X", next_opcode);
-            }
-            break;
-            
-        case 0xB8: case 0xB9: case 0xBA: case 0xBB:  // MOV reg, imm32
-        case 0xBC: case 0xBD: case 0xBE: case 0xBF:
-            if (maxLength < 5) {
-                decoded.is_valid = NO;
-                strcpy(decoded.mnemonic, "TRUNCATED");
-                break;
-            }
-            decoded.has_immediate = YES;
-            decoded.immediate = *(uint32_t *)(instruction + 1);
-            decoded.length = 5;
-            sprintf(decoded.mnemonic, "MOV r%d, 0x%X", decoded.opcode & 7, (uint32_t)decoded.immediate);
-            
-            // 🔧 关键修复：立即数指令总是安全的，不进行地址范围检查
-            decoded.is_safe = YES;
-            NSLog(@"[Box64Engine] Decoded immediate MOV r%d, 0x%X", decoded.opcode & 7, (uint32_t)decoded.immediate);
-            break;
-            
-        case 0xC3:  // RET
-            strcpy(decoded.mnemonic, "RET");
-            break;
-            
-        default:
-            sprintf(decoded.mnemonic, "UNK_0x%02X", decoded.opcode);
-            decoded.is_safe = NO;
-            NSLog(@"[Box64Engine] WARNING: Unknown opcode: 0x%02X", decoded.opcode);
-            break;
-    }
+    decoded.opcode = insn->opcode;
+    decoded.modrm = insn->modrm;
+    decoded.sib = insn->sib;
+    decoded.displacement = insn->disp;
+    decoded.immediate = insn->imm;
+    decoded.length = insn->length;
+    decoded.has_modrm = (insn->flags & X86_INSN_HAS_MODRM) != 0;
+    decoded.has_sib = (insn->flags & X86_INSN_HAS_SIB) != 0;
+    decoded.has_displacement = insn->disp_size != 0;
+    decoded.has_immediate = insn->imm_size != 0;
+    decoded.is_valid = (status == X86_DECODE_OK);
+    decoded.is_safe = decoded.is_valid && !(insn->flags & X86_INSN_UNSAFE);
     
     return decoded;
 }
 
+- (BOOL)validateInstruction:(const X86Instruction *)instruction {
+    if (!instruction || !instruction->is_valid || instruction->length == 0) {
+        return NO;
+    }
+    return instruction->is_safe || !_isSafeMode;
+}
+
+- (NSString *)disassembleInstruction:(const X86Instruction *)instruction {
+    return [self disassembleInstruction:instruction address:0];
+}
+
+- (NSString *)disassembleInstruction:(const X86Instruction *)instruction address:(uint64_t)address {
+    if (!instruction || !instruction->is_valid) {
+        return @"INVALID";
+    }
+    return [self disassembleDecodedInstruction:&instruction->insn address:address];
+}
+
+- (NSString *)disassembleDecodedInstruction:(const X86DecodedInsn *)insn address:(uint64_t)address {
+    char text[96];
+    x86_format_insn(insn, address, text, sizeof(text));
+    return [NSString stringWithUTF8String:text];
+}
+
 #pragma mark - 寄存器操作 - 安全版本
 
 - (uint64_t)getX86Register:(X86Register)reg {
-    [_contextLock lock];
+    [self lockExecution];
     
     @try {
         if (!_context) {
-            NSLog(@"[Box64Engine] SECURITY: Cannot get register - context is NULL");
+            B64LogWarn(BOX64_LOG_REGS, @"[Box64Engine] SECURITY: Cannot get register - context is NULL");
             return 0;
         }
         
         // 🔧 修复：X86_RIP = 16 是合法的，所以应该是 > 16
         if (reg > 16) {
-            NSLog(@"[Box64Engine] SECURITY: Invalid register index %lu", (unsigned long)reg);
+            B64LogWarn(BOX64_LOG_REGS, @"[Box64Engine] SECURITY: Invalid register index %lu", (unsigned long)reg);
             return 0;
         }
         
@@ -610,7 +2156,7 @@ static const ARM64Register x86_to_arm64_mapping[16] = {
         
         // 检查可疑的寄存器值
         if (value > 0 && value < MIN_VALID_ADDRESS && _isSafeMode) {
-            NSLog(@"[Box64Engine] WARNING: Register %lu contains suspicious low address: 0x%llx",
+            B64LogWarn(BOX64_LOG_REGS, @"[Box64Engine] WARNING: Register %lu contains suspicious low address: 0x%llx",
                   (unsigned long)reg, value);
             [_safetyWarnings addObject:[NSString stringWithFormat:@"寄存器%lu包含可疑地址0x%llx", (unsigned long)reg, value]];
         }
@@ -618,22 +2164,22 @@ static const ARM64Register x86_to_arm64_mapping[16] = {
         return value;
         
     } @finally {
-        [_contextLock unlock];
+        [self unlockExecution];
     }
 }
 
 - (BOOL)setX86Register:(X86Register)reg value:(uint64_t)value {
-    [_contextLock lock];
+    [self lockExecution];
     
     @try {
         if (!_context) {
-            NSLog(@"[Box64Engine] SECURITY: Cannot set register - context is NULL");
+            B64LogWarn(BOX64_LOG_REGS, @"[Box64Engine] SECURITY: Cannot set register - context is NULL");
             return NO;
         }
         
         // 🔧 修复：X86_RIP = 16 是合法的，所以应该是 > 16
         if (reg > 16) {
-            NSLog(@"[Box64Engine] SECURITY: Invalid register index %lu", (unsigned long)reg);
+            B64LogWarn(BOX64_LOG_REGS, @"[Box64Engine] SECURITY: Invalid register index %lu", (unsigned long)reg);
             return NO;
         }
         
@@ -641,13 +2187,13 @@ static const ARM64Register x86_to_arm64_mapping[16] = {
         if (reg == X86_RIP) {
             // RIP寄存器的值可以是任何有效地址
             _context->rip = value;
-            NSLog(@"[Box64Engine] Set RIP = 0x%llx", value);
+            B64LogTrace(BOX64_LOG_REGS, @"[Box64Engine] Set RIP = 0x%llx", value);
             return YES;
         }
         
         // 验证寄存器值
         if (![self validateRegisterValue:reg value:value]) {
-            NSLog(@"[Box64Engine] SECURITY: Register validation failed for %lu = 0x%llx", (unsigned long)reg, value);
+            B64LogWarn(BOX64_LOG_REGS, @"[Box64Engine] SECURITY: Register validation failed for %lu = 0x%llx", (unsigned long)reg, value);
             return NO;
         }
         
@@ -655,29 +2201,29 @@ static const ARM64Register x86_to_arm64_mapping[16] = {
         
         // 同步到ARM64寄存器
         if (reg < 16) {
-            ARM64Register arm64reg = x86_to_arm64_mapping[reg];
+            ARM64Register arm64reg = (ARM64Register)box64_jit_guest_register_map[reg];
             _context->arm64_regs[arm64reg] = value;
         }
         
-        NSLog(@"[Box64Engine] Set register %lu = 0x%llx", (unsigned long)reg, value);
+        B64LogTrace(BOX64_LOG_REGS, @"[Box64Engine] Set register %lu = 0x%llx", (unsigned long)reg, value);
         return YES;
         
     } @finally {
-        [_contextLock unlock];
+        [self unlockExecution];
     }
 }
 
 - (BOOL)setX86RegisterImmediate:(X86Register)reg value:(uint64_t)value {
-    [_contextLock lock];
+    [self lockExecution];
     
     @try {
         if (!_context) {
-            NSLog(@"[Box64Engine] SECURITY: Cannot set register - context is NULL");
+            B64LogWarn(BOX64_LOG_REGS, @"[Box64Engine] SECURITY: Cannot set register - context is NULL");
             return NO;
         }
         
         if (reg > 16) {
-            NSLog(@"[Box64Engine] SECURITY: Invalid register index %lu", (unsigned long)reg);
+            B64LogWarn(BOX64_LOG_REGS, @"[Box64Engine] SECURITY: Invalid register index %lu", (unsigned long)reg);
             return NO;
         }
         
@@ -685,12 +2231,12 @@ static const ARM64Register x86_to_arm64_mapping[16] = {
         NSNumber *regNumber = @(reg);
         [_immediateValueRegisters addObject:regNumber];
         
-        NSLog(@"[Box64Engine] IMMEDIATE: Setting register %lu to immediate value 0x%llx", (unsigned long)reg, value);
+        B64LogTrace(BOX64_LOG_REGS, @"[Box64Engine] IMMEDIATE: Setting register %lu to immediate value 0x%llx", (unsigned long)reg, value);
         
         // RIP寄存器特殊处理
         if (reg == X86_RIP) {
             _context->rip = value;
-            NSLog(@"[Box64Engine] Set RIP = 0x%llx (immediate)", value);
+            B64LogTrace(BOX64_LOG_REGS, @"[Box64Engine] Set RIP = 0x%llx (immediate)", value);
             return YES;
         }
         
@@ -699,15 +2245,15 @@ static const ARM64Register x86_to_arm64_mapping[16] = {
         
         // 同步到ARM64寄存器
         if (reg < 16) {
-            ARM64Register arm64reg = x86_to_arm64_mapping[reg];
+            ARM64Register arm64reg = (ARM64Register)box64_jit_guest_register_map[reg];
             _context->arm64_regs[arm64reg] = value;
         }
         
-        NSLog(@"[Box64Engine] ✅ Set register %lu = 0x%llx (immediate value)", (unsigned long)reg, value);
+        B64LogTrace(BOX64_LOG_REGS, @"[Box64Engine] ✅ Set register %lu = 0x%llx (immediate value)", (unsigned long)reg, value);
         return YES;
         
     } @finally {
-        [_contextLock unlock];
+        [self unlockExecution];
     }
 }
 
@@ -719,7 +2265,7 @@ static const ARM64Register x86_to_arm64_mapping[16] = {
     // 🔧 关键修复：检查是否为立即数寄存器
     NSNumber *regNumber = @(reg);
     if ([_immediateValueRegisters containsObject:regNumber]) {
-        NSLog(@"[Box64Engine] IMMEDIATE: Allowing immediate value 0x%llx for register %lu", value, (unsigned long)reg);
+        B64LogTrace(BOX64_LOG_REGS, @"[Box64Engine] IMMEDIATE: Allowing immediate value 0x%llx for register %lu", value, (unsigned long)reg);
         return YES;
     }
     
@@ -731,20 +2277,20 @@ static const ARM64Register x86_to_arm64_mapping[16] = {
     // 栈指针特殊检查
     if (reg == X86_RSP) {
         if (value < _context->stack_base || value >= _context->stack_base + _context->stack_size) {
-            NSLog(@"[Box64Engine] SECURITY: Stack pointer 0x%llx out of stack range", value);
+            B64LogWarn(BOX64_LOG_REGS, @"[Box64Engine] SECURITY: Stack pointer 0x%llx out of stack range", value);
             return NO;
         }
     }
     
     // 🔧 修复：只对非立即数值进行地址范围检查
     if (value > 0 && value < MIN_VALID_ADDRESS) {
-        NSLog(@"[Box64Engine] SECURITY: Register value 0x%llx is in dangerous low memory range", value);
+        B64LogWarn(BOX64_LOG_REGS, @"[Box64Engine] SECURITY: Register value 0x%llx is in dangerous low memory range", value);
         return NO;
     }
     
     // 检查是否在有效内存范围内
     if (value > MIN_VALID_ADDRESS && ![self isValidMemoryAddress:value size:1]) {
-        NSLog(@"[Box64Engine] SECURITY: Register value 0x%llx points to invalid memory", value);
+        B64LogWarn(BOX64_LOG_REGS, @"[Box64Engine] SECURITY: Register value 0x%llx points to invalid memory", value);
         return NO;
     }
     
@@ -753,79 +2299,388 @@ static const ARM64Register x86_to_arm64_mapping[16] = {
 
 #pragma mark - 内存管理 - 安全版本
 
+// 客户机地址 [address, address+size) 的每一页都已映射且可读
 - (BOOL)isValidMemoryAddress:(uint64_t)address size:(size_t)size {
     if (!_context || !_context->memory_base) {
         return NO;
     }
     
-    // 检查地址范围
-    uint64_t memory_start = (uint64_t)_context->memory_base;
-    uint64_t memory_end = memory_start + _context->memory_size;
-    
-    // 防止地址溢出
-    if (address < MIN_VALID_ADDRESS || address >= memory_end) {
-        return NO;
-    }
-    
-    if (size == 0 || size > _context->memory_size) {
-        return NO;
-    }
-    
-    // 检查地址+大小是否溢出
-    if (address + size < address || address + size > memory_end) {
+    // 低地址永不映射，单独拒绝以便日志区分空指针访问
+    if (address < MIN_VALID_ADDRESS) {
         return NO;
     }
     
-    return YES;
+    return box64_mmu_check(&_context->mmu, address, size, BOX64_ACCESS_READ);
 }
 
+// 兼容入口：从客户机堆分配并返回宿主指针
 - (uint8_t *)allocateMemory:(size_t)size {
-    [_contextLock lock];
+    [self lockProcessState];
     
     @try {
         if (!_isInitialized || !_context) {
-            NSLog(@"[Box64Engine] SECURITY: Cannot allocate - engine not initialized");
+            B64LogWarn(BOX64_LOG_MEMORY, @"[Box64Engine] SECURITY: Cannot allocate - engine not initialized");
             return NULL;
         }
         
-        if (size == 0 || size > _context->memory_size / 4) {
-            NSLog(@"[Box64Engine] SECURITY: Invalid allocation size: %zu", size);
+        uint64_t guestAddress = [self allocateGuestHeap:size zeroed:YES];
+        if (guestAddress == 0) {
             return NULL;
         }
         
-        // 简单的内存分配器 - 从堆基址分配
-        static size_t allocated_offset = 0;
+        // 堆页映射到连续的后备区，整段翻译得到宿主指针
+        uint8_t *memory = box64_mmu_translate(&_context->mmu, guestAddress, size, BOX64_ACCESS_WRITE);
+        B64LogDebug(BOX64_LOG_MEMORY, @"[Box64Engine] Allocated %zu bytes at guest 0x%llx (host 0x%p)", size, guestAddress, memory);
+        return memory;
+        
+    } @finally {
+        [self unlockProcessState];
+    }
+}
+
+- (void)freeMemory:(uint8_t *)memory {
+    [self lockProcessState];
+    
+    @try {
+        if (!memory || !_context || !_context->memory_base) {
+            return;
+        }
+        // 堆页是 box64_mmu_map 建立的恒等映射：客户机地址 = 宿主指针 - 后备区基址
+        uint64_t guestAddress = (uint64_t)(memory - _context->mmu.backing);
+        if (memory < _context->mmu.backing || ![self freeGuestHeap:guestAddress]) {
+            B64LogWarn(BOX64_LOG_MEMORY, @"[Box64Engine] SECURITY: freeMemory of foreign pointer 0x%p ignored", memory);
+        }
+    } @finally {
+        [self unlockProcessState];
+    }
+}
+
+#pragma mark - 客户机堆
+
+- (uint64_t)allocateGuestHeap:(size_t)size zeroed:(BOOL)zeroed {
+    [self lockProcessState];
+    
+    @try {
+        if (!_isInitialized || !_guestHeap) {
+            B64LogWarn(BOX64_LOG_MEMORY, @"[Box64Engine] SECURITY: Cannot allocate - guest heap not initialized");
+            return 0;
+        }
+        
+        uint64_t guestAddress = box64_heap_alloc(_guestHeap, size);
+        if (guestAddress == 0) {
+            Box64HeapStats stats;
+            box64_heap_get_stats(_guestHeap, &stats);
+            B64LogWarn(BOX64_LOG_MEMORY, @"[Box64Engine] SECURITY: Out of heap memory for %zu bytes (in use %llu KB, largest free run %u pages)",
+                  size, stats.bytes_in_use / 1024, stats.largest_free_run);
+            _lastError = [NSString stringWithFormat:@"客户机堆内存不足 (%zu 字节)", size];
+            return 0;
+        }
+        
+        if (zeroed) {
+            uint64_t blockSize = box64_heap_block_size(_guestHeap, guestAddress);
+            memset(box64_mmu_translate(&_context->mmu, guestAddress, blockSize, BOX64_ACCESS_WRITE), 0, blockSize);
+        }
+        return guestAddress;
+        
+    } @finally {
+        [self unlockProcessState];
+    }
+}
+
+- (BOOL)freeGuestHeap:(uint64_t)address {
+    [self lockProcessState];
+    
+    @try {
+        uint64_t blockSize = box64_heap_block_size(_guestHeap, address);
+        if (blockSize == 0) {
+            B64LogWarn(BOX64_LOG_MEMORY, @"[Box64Engine] SECURITY: Invalid or double free of guest 0x%llx", address);
+            return NO;
+        }
         
-        // 16字节对齐
-        size_t aligned_size = (size + 15) & ~15;
+        // 整页块可能被 allocateGuestPages / protectMemory 改过权限，回收前恢复为可读写
+        if (blockSize >= BOX64_PAGE_SIZE) {
+            if (box64_mmu_query(&_context->mmu, address) & BOX64_PROT_EXEC) {
+                [self invalidateTranslationCacheInRange:address size:blockSize];
+            }
+            box64_mmu_protect(&_context->mmu, address, blockSize, BOX64_PROT_READ | BOX64_PROT_WRITE);
+        }
+        return box64_heap_free(_guestHeap, address);
         
-        if (allocated_offset + aligned_size > _context->heap_size) {
-            NSLog(@"[Box64Engine] SECURITY: Out of heap memory");
-            return NULL;
+    } @finally {
+        [self unlockProcessState];
+    }
+}
+
+- (size_t)guestHeapBlockSize:(uint64_t)address {
+    [self lockProcessState];
+    
+    @try {
+        return (size_t)box64_heap_block_size(_guestHeap, address);
+    } @finally {
+        [self unlockProcessState];
+    }
+}
+
+// 新块足够大时原地返回；否则分配新块、复制旧内容、释放旧块（失败时旧块保持不变）
+- (uint64_t)reallocateGuestHeap:(uint64_t)address size:(size_t)size zeroed:(BOOL)zeroed {
+    [self lockProcessState];
+    
+    @try {
+        uint64_t oldSize = box64_heap_block_size(_guestHeap, address);
+        if (oldSize == 0) {
+            B64LogWarn(BOX64_LOG_MEMORY, @"[Box64Engine] SECURITY: Realloc of invalid guest block 0x%llx", address);
+            return 0;
+        }
+        if (size <= oldSize && (size > BOX64_HEAP_SMALL_MAX || oldSize <= BOX64_HEAP_SMALL_MAX)) {
+            return address;
         }
         
-        uint8_t *memory = (uint8_t *)_context->heap_base + allocated_offset;
-        allocated_offset += aligned_size;
+        uint64_t newAddress = [self allocateGuestHeap:size zeroed:zeroed];
+        if (newAddress == 0) {
+            return 0;
+        }
+        uint64_t copySize = MIN(oldSize, (uint64_t)size);
+        memmove(box64_mmu_translate(&_context->mmu, newAddress, copySize, BOX64_ACCESS_WRITE),
+                box64_mmu_translate(&_context->mmu, address, copySize, BOX64_ACCESS_READ), copySize);
+        [self freeGuestHeap:address];
+        return newAddress;
         
-        // 清零内存
-        memset(memory, 0, aligned_size);
+    } @finally {
+        [self unlockProcessState];
+    }
+}
+
+// VirtualAlloc(MEM_COMMIT) 的后备：整页对齐、已清零
+- (uint64_t)allocateGuestPages:(size_t)size executable:(BOOL)executable {
+    [self lockProcessState];
+    
+    @try {
+        // 向上取整到页，保证走页分配路径
+        size_t pageSize = (size_t)((size + BOX64_PAGE_OFFSET_MASK) & BOX64_PAGE_MASK);
+        uint64_t guestAddress = [self allocateGuestHeap:MAX(pageSize, (size_t)BOX64_PAGE_SIZE) zeroed:YES];
+        if (guestAddress != 0 && executable) {
+            box64_mmu_protect(&_context->mmu, guestAddress, pageSize, BOX64_PROT_READ | BOX64_PROT_WRITE | BOX64_PROT_EXEC);
+        }
+        return guestAddress;
         
-        NSLog(@"[Box64Engine] Allocated %zu bytes at 0x%p", aligned_size, memory);
-        return memory;
+    } @finally {
+        [self unlockProcessState];
+    }
+}
+
+- (BOOL)mapMemory:(uint64_t)address size:(size_t)size data:(nullable NSData *)data {
+    [self lockProcessState];
+    
+    @try {
+        if (data.length > size) {
+            B64LogWarn(BOX64_LOG_MEMORY, @"[Box64Engine] SECURITY: Map data (%lu bytes) larger than region (%zu bytes)", (unsigned long)data.length, size);
+            return NO;
+        }
+        // 映射按页扩展，整页可读写可执行
+        if (!_isInitialized || address < MIN_VALID_ADDRESS ||
+            !box64_mmu_map(&_context->mmu, address, size, BOX64_PROT_READ | BOX64_PROT_WRITE | BOX64_PROT_EXEC)) {
+            B64LogWarn(BOX64_LOG_MEMORY, @"[Box64Engine] SECURITY: Cannot map 0x%llx (%zu bytes)", address, size);
+            _lastError = [NSString stringWithFormat:@"无法映射内存 0x%llx", address];
+            return NO;
+        }
+        
+        // box64_mmu_map 总是映射到连续的后备区，可以整段翻译
+        uint8_t *target = box64_mmu_translate(&_context->mmu, address, size, BOX64_ACCESS_WRITE);
+        memset(target, 0, size);
+        if (data.length > 0) {
+            memcpy(target, data.bytes, data.length);
+        }
+        
+        [self invalidateTranslationCacheInRange:address size:size];
+        
+        B64LogInfo(BOX64_LOG_MEMORY, @"[Box64Engine] Mapped %zu bytes at 0x%llx", size, address);
+        return YES;
+        
+    } @finally {
+        [self unlockProcessState];
+    }
+}
+
+- (BOOL)unmapMemory:(uint64_t)address size:(size_t)size {
+    [self lockProcessState];
+    
+    @try {
+        if (!_isInitialized || address < MIN_VALID_ADDRESS || !box64_mmu_unmap(&_context->mmu, address, size)) {
+            B64LogWarn(BOX64_LOG_MEMORY, @"[Box64Engine] SECURITY: Cannot unmap 0x%llx (%zu bytes)", address, size);
+            return NO;
+        }
+        
+        // 后备区内容保留，重新映射时由 mapMemory 清零
+        [self invalidateTranslationCacheInRange:address size:size];
+        
+        B64LogInfo(BOX64_LOG_MEMORY, @"[Box64Engine] Unmapped %zu bytes at 0x%llx", size, address);
+        return YES;
+        
+    } @finally {
+        [self unlockProcessState];
+    }
+}
+
+- (BOOL)protectMemory:(uint64_t)address size:(size_t)size executable:(BOOL)executable writable:(BOOL)writable {
+    [self lockProcessState];
+    
+    @try {
+        uint32_t prot = BOX64_PROT_READ | (writable ? BOX64_PROT_WRITE : 0) | (executable ? BOX64_PROT_EXEC : 0);
+        if (!_isInitialized || address < MIN_VALID_ADDRESS || !box64_mmu_protect(&_context->mmu, address, size, prot)) {
+            B64LogWarn(BOX64_LOG_MEMORY, @"[Box64Engine] SECURITY: Cannot protect 0x%llx (%zu bytes)", address, size);
+            return NO;
+        }
+        
+        // 可执行性或可写性变化后，已翻译的块不再可信
+        [self invalidateTranslationCacheInRange:address size:size];
+        
+        B64LogInfo(BOX64_LOG_MEMORY, @"[Box64Engine] Protected 0x%llx-0x%llx (%s%s)", address, address + size,
+              writable ? "W" : "-", executable ? "X" : "-");
+        return YES;
+        
+    } @finally {
+        [self unlockProcessState];
+    }
+}
+
+#pragma mark - PE镜像
+
+- (BOOL)loadPEImage:(NSData *)fileData image:(Box64PEImage *)image {
+    [self lockProcessState];
+    
+    @try {
+        if (!_isInitialized || !_context || !image) {
+            B64LogWarn(BOX64_LOG_MEMORY, @"[Box64Engine] SECURITY: Cannot load PE - engine not initialized");
+            return NO;
+        }
+        
+        Box64PEStatus status = box64_pe_parse(fileData.bytes, fileData.length, image);
+        if (status != BOX64_PE_OK) {
+            B64LogWarn(BOX64_LOG_MEMORY, @"[Box64Engine] SECURITY: Rejected PE image (%s)", box64_pe_status_string(status));
+            _lastError = [NSString stringWithFormat:@"PE解析失败: %s", box64_pe_status_string(status)];
+            return NO;
+        }
+        
+        [self unloadPEImage];
+        return [self mapParsedPEImage:image file:NULL data:fileData.bytes length:fileData.length];
+        
+    } @finally {
+        [self unlockProcessState];
+    }
+}
+
+- (BOOL)loadPEImageAtPath:(NSString *)path image:(Box64PEImage *)image {
+    [self lockProcessState];
+    
+    @try {
+        if (!_isInitialized || !_context || !image || path.length == 0) {
+            B64LogWarn(BOX64_LOG_MEMORY, @"[Box64Engine] SECURITY: Cannot load PE - engine not initialized");
+            return NO;
+        }
+        
+        Box64PEFile file;
+        if (!box64_pe_file_open(path.fileSystemRepresentation, &file)) {
+            _lastError = [NSString stringWithFormat:@"无法映射PE文件: %@", path];
+            return NO;
+        }
+        
+        Box64PEStatus status = box64_pe_parse(file.data, file.size, image);
+        if (status != BOX64_PE_OK) {
+            box64_pe_file_close(&file);
+            B64LogWarn(BOX64_LOG_MEMORY, @"[Box64Engine] SECURITY: Rejected PE image (%s)", box64_pe_status_string(status));
+            _lastError = [NSString stringWithFormat:@"PE解析失败: %s", box64_pe_status_string(status)];
+            return NO;
+        }
+        
+        // 旧镜像的页可能还指向旧文件映射，先卸载再接管新文件
+        [self unloadPEImage];
+        _peFile = file;
+        if (![self mapParsedPEImage:image file:&_peFile data:file.data length:file.size]) {
+            box64_pe_file_close(&_peFile);
+            return NO;
+        }
+        return YES;
+        
+    } @finally {
+        [self unlockProcessState];
+    }
+}
+
+// 调用方已持锁、已解析镜像并卸载旧镜像；file 非NULL时对齐的节直接映射文件页
+- (BOOL)mapParsedPEImage:(Box64PEImage *)image file:(Box64PEFile *)file data:(const uint8_t *)data length:(size_t)length {
+    // 首选基址与堆/栈重叠或超出地址空间时，从客户机堆取整页区间作为备用基址
+    uint64_t fallbackBase = 0;
+    if (!box64_pe_range_free(&_context->mmu, image->preferred_base, image->size_of_image)) {
+        fallbackBase = [self allocateGuestPages:image->size_of_image executable:NO];
+    }
+    
+    Box64PEStatus status = file ? box64_pe_map_file(&_context->mmu, file, image, fallbackBase)
+                                : box64_pe_map(&_context->mmu, data, length, image, fallbackBase);
+    if (status != BOX64_PE_OK) {
+        if (fallbackBase) {
+            // 备用区间的页可能已改指文件映射，恢复为堆后备区再回收
+            box64_mmu_map(&_context->mmu, fallbackBase, image->size_of_image, BOX64_PROT_READ | BOX64_PROT_WRITE);
+            [self freeGuestHeap:fallbackBase];
+        }
+        B64LogWarn(BOX64_LOG_MEMORY, @"[Box64Engine] SECURITY: Failed to map PE image at 0x%llx (%s)",
+              image->preferred_base, box64_pe_status_string(status));
+        _lastError = [NSString stringWithFormat:@"PE映射失败: %s", box64_pe_status_string(status)];
+        return NO;
+    }
+    
+    _loadedImageBase = image->base;
+    _loadedImageSize = image->size_of_image;
+    _loadedImageOnHeap = fallbackBase != 0;
+    [self invalidateTranslationCacheInRange:image->base size:image->size_of_image];
+    
+    if (![self bindImportsForImage:image]) {
+        [self unloadPEImage];
+        return NO;
+    }
+    
+    B64LogInfo(BOX64_LOG_MEMORY, @"[Box64Engine] Loaded PE image at 0x%llx-0x%llx (%u sections, entry 0x%llx, %u file-backed pages%@)",
+          image->base, image->base + image->size_of_image, image->section_count, image->entry_point,
+          image->file_backed_pages,
+          image->relocated ? [NSString stringWithFormat:@", relocated from 0x%llx with %u fixups",
+                              image->preferred_base, image->relocations_applied] : @"");
+    return YES;
+}
+
+- (void)unloadPEImage {
+    [self lockProcessState];
+    
+    @try {
+        if (_loadedImageSize == 0 || !_context) {
+            return;
+        }
+        [self invalidateTranslationCacheInRange:_loadedImageBase size:_loadedImageSize];
+        [self releaseImportStubs];
+        if (_loadedImageOnHeap) {
+            box64_mmu_map(&_context->mmu, _loadedImageBase, _loadedImageSize, BOX64_PROT_READ | BOX64_PROT_WRITE);
+            [self freeGuestHeap:_loadedImageBase];
+        } else {
+            box64_mmu_unmap(&_context->mmu, _loadedImageBase, _loadedImageSize);
+        }
+        // 客户机页不再引用文件映射后才能关闭
+        box64_pe_file_close(&_peFile);
+        B64LogDebug(BOX64_LOG_MEMORY, @"[Box64Engine] Unloaded PE image at 0x%llx", _loadedImageBase);
+        _loadedImageBase = 0;
+        _loadedImageSize = 0;
+        _loadedImageOnHeap = NO;
         
     } @finally {
-        [_contextLock unlock];
+        [self unlockProcessState];
     }
 }
 
 #pragma mark - 状态管理
 
 - (void)resetCPUState {
-    [_contextLock lock];
+    [self lockProcessState];
     
     @try {
         if (!_context) {
-            NSLog(@"[Box64Engine] CRITICAL: Cannot reset CPU state - context is NULL");
+            B64LogError(BOX64_LOG_CORE, @"[Box64Engine] CRITICAL: Cannot reset CPU state - context is NULL");
             return;
         }
         
@@ -835,7 +2690,7 @@ static const ARM64Register x86_to_arm64_mapping[16] = {
         
         // 🔧 新增：清空立即数跟踪
         [_immediateValueRegisters removeAllObjects];
-        NSLog(@"[Box64Engine] Cleared immediate value register tracking");
+        B64LogDebug(BOX64_LOG_CORE, @"[Box64Engine] Cleared immediate value register tracking");
         
         // 设置安全的栈指针
         if (_context->memory_base && _context->stack_base > 0) {
@@ -844,7 +2699,9 @@ static const ARM64Register x86_to_arm64_mapping[16] = {
         }
         
         // 设置默认标志和指令指针
-        _context->rflags = 0x202;
+        box64_flags_set(_context, 0x202);
+        box64_sse_reset(_context);
+        box64_x87_reset(_context);
         _context->rip = 0;
         _context->last_valid_rip = 0;
         _context->instruction_count = 0;
@@ -852,20 +2709,20 @@ static const ARM64Register x86_to_arm64_mapping[16] = {
         // 清空最后指令记录
         memset(_context->last_instruction, 0, sizeof(_context->last_instruction));
         
-        NSLog(@"[Box64Engine] CPU state reset safely - RSP: 0x%llx", _context->x86_regs[X86_RSP]);
+        B64LogDebug(BOX64_LOG_CORE, @"[Box64Engine] CPU state reset safely - RSP: 0x%llx", _context->x86_regs[X86_RSP]);
         
     } @finally {
-        [_contextLock unlock];
+        [self unlockProcessState];
     }
 }
 
 
 
 - (void)resetToSafeState {
-    [_contextLock lock];
+    [self lockProcessState];
     
     @try {
-        NSLog(@"[Box64Engine] Resetting to safe state...");
+        B64LogInfo(BOX64_LOG_CORE, @"[Box64Engine] Resetting to safe state...");
         
         [self resetCPUState];
         [_safetyWarnings removeAllObjects];
@@ -878,10 +2735,10 @@ static const ARM64Register x86_to_arm64_mapping[16] = {
         _isSafeMode = YES;
         _lastError = nil;
         
-        NSLog(@"[Box64Engine] Safe state reset completed");
+        B64LogInfo(BOX64_LOG_CORE, @"[Box64Engine] Safe state reset completed");
         
     } @finally {
-        [_contextLock unlock];
+        [self unlockProcessState];
     }
 }
 
@@ -900,27 +2757,23 @@ static const ARM64Register x86_to_arm64_mapping[16] = {
     // 检查栈指针
     uint64_t rsp = _context->x86_regs[X86_RSP];
     if (rsp < _context->stack_base || rsp >= _context->stack_base + _context->stack_size) {
-        NSLog(@"[Box64Engine] SECURITY: Stack pointer corruption detected: 0x%llx", rsp);
+        B64LogWarn(BOX64_LOG_SAFETY, @"[Box64Engine] SECURITY: Stack pointer corruption detected: 0x%llx", rsp);
         [_safetyWarnings addObject:@"栈指针损坏"];
         return NO;
     }
     
     // 🔧 修复：检查指令指针 - 应该在分配的内存范围内，而不是传统的低地址检查
     if (rip > 0 && rip < MIN_VALID_ADDRESS) {
-        NSLog(@"[Box64Engine] SECURITY: Instruction pointer in dangerous range: 0x%llx", rip);
+        B64LogWarn(BOX64_LOG_SAFETY, @"[Box64Engine] SECURITY: Instruction pointer in dangerous range: 0x%llx", rip);
         [_safetyWarnings addObject:@"指令指针在危险地址范围"];
         return NO;
     }
     
-    // 🔧 新增：检查RIP是否在有效的内存范围内
+    // 🔧 新增：检查RIP是否在客户机地址空间内
     if (rip > MIN_VALID_ADDRESS) {
-        // 检查是否在我们分配的内存范围内
-        uint64_t memory_start = (uint64_t)_context->memory_base;
-        uint64_t memory_end = memory_start + _context->memory_size;
-        
-        if (rip < memory_start || rip >= memory_end) {
+        if (rip >= _context->mmu.size) {
             // RIP 在我们管理的内存之外，可能是有效的系统内存，允许继续
-            NSLog(@"[Box64Engine] INFO: RIP 0x%llx outside managed memory range, allowing", rip);
+            B64LogTrace(BOX64_LOG_SAFETY, @"[Box64Engine] INFO: RIP 0x%llx outside managed memory range, allowing", rip);
         }
     }
     
@@ -928,7 +2781,7 @@ static const ARM64Register x86_to_arm64_mapping[16] = {
 }
 
 - (void)enableSafeMode:(BOOL)enabled {
-    [_contextLock lock];
+    [self lockProcessState];
     
     @try {
         _isSafeMode = enabled;
@@ -936,27 +2789,27 @@ static const ARM64Register x86_to_arm64_mapping[16] = {
             _context->is_in_safe_mode = enabled;
         }
         
-        NSLog(@"[Box64Engine] Safe mode %@", enabled ? @"ENABLED" : @"DISABLED");
+        B64LogInfo(BOX64_LOG_SAFETY, @"[Box64Engine] Safe mode %@", enabled ? @"ENABLED" : @"DISABLED");
         
     } @finally {
-        [_contextLock unlock];
+        [self unlockProcessState];
     }
 }
 
 - (NSArray<NSString *> *)getSafetyWarnings {
-    [_contextLock lock];
+    [self lockProcessState];
     
     @try {
         return [_safetyWarnings copy];
     } @finally {
-        [_contextLock unlock];
+        [self unlockProcessState];
     }
 }
 
 #pragma mark - 调试和状态
 
 - (NSDictionary *)getSystemState {
-    [_contextLock lock];
+    [self lockProcessState];
     
     @try {
         NSMutableDictionary *state = [NSMutableDictionary dictionary];
@@ -975,14 +2828,60 @@ static const ARM64Register x86_to_arm64_mapping[16] = {
             state[@"stack_size"] = @(_context->stack_size);
             state[@"heap_base"] = @(_context->heap_base);
             state[@"heap_size"] = @(_context->heap_size);
+            state[@"x87_status_word"] = @(box64_x87_status_word(_context));
+            state[@"x87_tag_word"] = @(box64_x87_tag_word(_context));
+            state[@"x87_extended_precision"] = @(_context->x87.extended != 0);
+            // 页表归进程引擎的MMU，线程引擎的视图只有自己的TLB统计
+            state[@"mmu_mapped_pages"] = @(_context->mmu.owner ? _context->mmu.owner->stats.mapped_pages : 0);
+            state[@"mmu_tlb_misses"] = @(_context->mmu.stats.tlb_misses);
+            state[@"mmu_tlb_flushes"] = @(_context->mmu.stats.tlb_flushes);
+            state[@"mmu_faults"] = @(_context->mmu.stats.faults);
+            state[@"pe_image_base"] = @(_loadedImageBase);
+            state[@"pe_image_size"] = @(_loadedImageSize);
+            state[@"pe_imports"] = @(_importTable.count);
+            state[@"pe_imports_resolved"] = @(atomic_load(&_importTable.resolved));
+        }
+        
+        if (_guestHeap) {
+            Box64HeapStats heapStats;
+            box64_heap_get_stats(_guestHeap, &heapStats);
+            state[@"heap_bytes_in_use"] = @(heapStats.bytes_in_use);
+            state[@"heap_peak_bytes_in_use"] = @(heapStats.peak_bytes_in_use);
+            state[@"heap_live_blocks"] = @(heapStats.live_blocks);
+            state[@"heap_failed_allocations"] = @(heapStats.failed_allocations);
+            state[@"heap_largest_free_run"] = @((uint64_t)heapStats.largest_free_run * BOX64_HEAP_PAGE_SIZE);
+            state[@"heap_internal_fragmentation"] = @(heapStats.internal_fragmentation);
+            state[@"heap_external_fragmentation"] = @(heapStats.external_fragmentation);
+        }
+        
+        if (_translationCache) {
+            Box64TCStats tcStats;
+            box64_tc_get_stats(_translationCache, &tcStats);
+            state[@"translation_cache_hits"] = @(tcStats.hits);
+            state[@"translation_cache_misses"] = @(tcStats.misses);
+            state[@"translation_cache_chained"] = @(tcStats.chained);
+            state[@"translation_cache_evictions"] = @(tcStats.evictions);
+            state[@"translation_cache_invalidations"] = @(tcStats.invalidations);
+            state[@"translation_cache_blocks"] = @(tcStats.blocks);
+            state[@"translation_cache_capacity"] = @(tcStats.capacity);
         }
+        state[@"jit_native_enabled"] = @(_nativeJITEnabled);
+        state[@"jit_compiled_blocks"] = @(_jitCompiledBlocks);
+        state[@"jit_native_executions"] = @(_jitNativeExecutions);
+        state[@"interpreter_fallbacks"] = @(_interpreterFallbacks);
+        Box64CodeCacheStats codeStats;
+        [_jitEngine getCodeCacheStats:&codeStats];
+        state[@"jit_code_live_bytes"] = @(codeStats.live_bytes);
+        state[@"jit_code_reserved_bytes"] = @(codeStats.reserved_bytes);
+        state[@"jit_code_evicted_blocks"] = @(codeStats.evicted_blocks);
+        state[@"guest_threads"] = @(atomic_load(&_shared->liveThreads));
         
         state[@"safety_warnings_count"] = @(_safetyWarnings.count);
         
         return [state copy];
         
     } @finally {
-        [_contextLock unlock];
+        [self unlockProcessState];
     }
 }
 
@@ -991,7 +2890,7 @@ static const ARM64Register x86_to_arm64_mapping[16] = {
 }
 
 - (void)dumpRegisters {
-    [_contextLock lock];
+    [self lockExecution];
     
     @try {
         if (!_context) {
@@ -1004,18 +2903,94 @@ static const ARM64Register x86_to_arm64_mapping[16] = {
         NSLog(@"[Box64Engine] RDX: 0x%016llX  RBX: 0x%016llX", _context->x86_regs[X86_RDX], _context->x86_regs[X86_RBX]);
         NSLog(@"[Box64Engine] RSP: 0x%016llX  RBP: 0x%016llX", _context->x86_regs[X86_RSP], _context->x86_regs[X86_RBP]);
         NSLog(@"[Box64Engine] RSI: 0x%016llX  RDI: 0x%016llX", _context->x86_regs[X86_RSI], _context->x86_regs[X86_RDI]);
-        NSLog(@"[Box64Engine] RIP: 0x%016llX  RFLAGS: 0x%016llX", _context->rip, _context->rflags);
+        NSLog(@"[Box64Engine] RIP: 0x%016llX  RFLAGS: 0x%016llX", _context->rip, box64_flags_materialize(_context));
         NSLog(@"[Box64Engine] Instructions: %u/%u", _context->instruction_count, _context->max_instructions);
         NSLog(@"[Box64Engine] Safe Mode: %s", _context->is_in_safe_mode ? "ON" : "OFF");
         NSLog(@"[Box64Engine] ==========================");
         
     } @finally {
-        [_contextLock unlock];
+        [self unlockExecution];
+    }
+}
+
+#pragma mark - 日志与跟踪
+
+- (void)setLogLevel:(Box64LogLevel)level categories:(uint32_t)categories {
+    box64_log_set_level(level);
+    box64_log_set_categories(categories);
+    NSLog(@"[Box64Engine] Log level %s, categories 0x%x (compiled up to %s)", box64_log_level_name(level), categories,
+          box64_log_level_name(BOX64_LOG_COMPILE_LEVEL));
+}
+
+- (void)enableTraceRing:(BOOL)enabled capacity:(uint32_t)capacity {
+    box64_rwlock_write_lock(&_shared->codeGate);
+    
+    @try {
+        // 各线程的执行循环持有读锁写入跟踪环，这里持写锁替换时没有写入者
+        box64_trace_set_active(NULL);
+        box64_trace_ring_destroy(_traceRing);
+        _traceRing = NULL;
+        if (!enabled) {
+            return;
+        }
+        _traceRing = box64_trace_ring_create(capacity);
+        if (!_traceRing) {
+            B64LogWarn(BOX64_LOG_CORE, @"[Box64Engine] WARNING: Failed to create trace ring (%u events)", capacity);
+            return;
+        }
+        box64_trace_set_active(_traceRing);
+        NSLog(@"[Box64Engine] Trace ring enabled: %llu events", _traceRing->mask + 1);
+    } @finally {
+        box64_rwlock_write_unlock(&_shared->codeGate);
+    }
+}
+
+- (BOOL)x87ExtendedPrecision {
+    return _context && _context->x87.extended;
+}
+
+- (void)setX87ExtendedPrecision:(BOOL)x87ExtendedPrecision {
+    [self lockExecution];
+    
+    @try {
+        if (!_context) {
+            return;
+        }
+        box64_x87_set_extended(_context, x87ExtendedPrecision);
+        NSLog(@"[Box64Engine] x87 precision mode: %@", x87ExtendedPrecision ? @"80-bit softfloat" : @"double");
+    } @finally {
+        [self unlockExecution];
+    }
+}
+
+- (void)dumpTraceRing:(NSUInteger)maxEvents {
+    box64_rwlock_read_lock(&_shared->codeGate);
+    
+    @try {
+        if (!_traceRing || maxEvents == 0) {
+            NSLog(@"[Box64Engine] Trace ring disabled");
+            return;
+        }
+        Box64TraceEvent *events = malloc(maxEvents * sizeof(Box64TraceEvent));
+        if (!events) {
+            return;
+        }
+        size_t count = box64_trace_ring_snapshot(_traceRing, events, maxEvents);
+        NSLog(@"[Box64Engine] ===== Last %zu trace events =====", count);
+        char line[128];
+        for (size_t i = 0; i < count; i++) {
+            box64_trace_format_event(&events[i], events[0].timestamp, line, sizeof(line));
+            NSLog(@"[Box64Engine] %s", line);
+        }
+        NSLog(@"[Box64Engine] ==================================");
+        free(events);
+    } @finally {
+        box64_rwlock_read_unlock(&_shared->codeGate);
     }
 }
 
 - (void)dumpMemoryRegions {
-    [_contextLock lock];
+    [self lockProcessState];
     
     @try {
         if (!_context) {
@@ -1030,18 +3005,30 @@ static const ARM64Register x86_to_arm64_mapping[16] = {
         NSLog(@"[Box64Engine] Heap: 0x%llx-0x%llx (%llu KB)",
               _context->heap_base, _context->heap_base + _context->heap_size, _context->heap_size / 1024);
         
-        for (uint32_t i = 0; i < _context->region_count; i++) {
-            MemoryRegion *region = &_context->memory_regions[i];
-            NSLog(@"[Box64Engine] Region %u: %s at 0x%llx-0x%llx (%s%s%s)",
-                  i, region->name, region->start_address, region->start_address + region->size,
-                  region->is_executable ? "X" : "-",
-                  region->is_writable ? "W" : "-",
-                  "R");
+        // 按页表合并权限相同的连续页输出
+        const Box64MMU *mmu = &_context->mmu;
+        uint64_t runStart = 0;
+        uint32_t runProt = box64_mmu_query(mmu, 0);
+        for (uint64_t address = BOX64_PAGE_SIZE; address <= mmu->size; address += BOX64_PAGE_SIZE) {
+            uint32_t prot = address < mmu->size ? box64_mmu_query(mmu, address) : UINT32_MAX;
+            if (prot == runProt) {
+                continue;
+            }
+            if (runProt != BOX64_PROT_NONE) {
+                NSLog(@"[Box64Engine] Pages 0x%llx-0x%llx (%s%s%s)", runStart, address,
+                      (runProt & BOX64_PROT_READ) ? "R" : "-",
+                      (runProt & BOX64_PROT_WRITE) ? "W" : "-",
+                      (runProt & BOX64_PROT_EXEC) ? "X" : "-");
+            }
+            runStart = address;
+            runProt = prot;
         }
+        NSLog(@"[Box64Engine] Mapped pages: %u, TLB misses: %llu, faults: %llu",
+              mmu->stats.mapped_pages, mmu->stats.tlb_misses, mmu->stats.faults);
         NSLog(@"[Box64Engine] ============================");
         
     } @finally {
-        [_contextLock unlock];
+        [self unlockProcessState];
     }
 }
 
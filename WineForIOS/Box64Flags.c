@@ -0,0 +1,165 @@
+// Box64Flags.c - 惰性标志求值
+#include "Box64Flags.h"
+
+static inline uint64_t size_mask(uint8_t size) {
+    return size >= 8 ? ~0ULL : ((1ULL << (size * 8)) - 1);
+}
+
+static inline int64_t sign_extend(uint64_t value, uint8_t size) {
+    if (size >= 8) {
+        return (int64_t)value;
+    }
+    const unsigned shift = 64 - size * 8;
+    return (int64_t)(value << shift) >> shift;
+}
+
+uint64_t box64_flags_compute(Box64FlagOp op, uint64_t dst, uint64_t src, uint64_t result,
+                             uint8_t size, uint64_t old_flags) {
+    if (op == BOX64_FLAGS_NONE) {
+        return old_flags;
+    }
+
+    const uint64_t mask = size_mask(size);
+    const uint64_t sign_bit = 1ULL << (size * 8 - 1);
+    dst &= mask;
+    src &= mask;
+    result &= mask;
+
+    uint64_t flags = old_flags & ~(uint64_t)X86_FLAGS_ARITH;
+    if (result == 0) flags |= X86_FLAG_ZF;
+    if (result & sign_bit) flags |= X86_FLAG_SF;
+    if (!__builtin_parity((unsigned)(result & 0xFF))) flags |= X86_FLAG_PF;
+
+    switch (op) {
+        case BOX64_FLAGS_ADD:
+        case BOX64_FLAGS_ADC:
+        case BOX64_FLAGS_INC:
+            // ADC带进位时 result == dst 说明 src 为全1且产生了进位
+            if (op == BOX64_FLAGS_INC) {
+                flags |= old_flags & X86_FLAG_CF;
+            } else if (result < dst || (op == BOX64_FLAGS_ADC && result == dst && src != 0)) {
+                flags |= X86_FLAG_CF;
+            }
+            if (((dst ^ result) & (src ^ result)) & sign_bit) flags |= X86_FLAG_OF;
+            if ((dst ^ src ^ result) & 0x10) flags |= X86_FLAG_AF;
+            break;
+        case BOX64_FLAGS_SUB:
+        case BOX64_FLAGS_SBB:
+        case BOX64_FLAGS_DEC:
+            if (op == BOX64_FLAGS_DEC) {
+                flags |= old_flags & X86_FLAG_CF;
+            } else if (dst < src || (op == BOX64_FLAGS_SBB && result == dst && src != 0)) {
+                flags |= X86_FLAG_CF;
+            }
+            if (((dst ^ src) & (dst ^ result)) & sign_bit) flags |= X86_FLAG_OF;
+            if ((dst ^ src ^ result) & 0x10) flags |= X86_FLAG_AF;
+            break;
+        default:  // LOGIC: CF=OF=0，AF未定义（按0处理）
+            break;
+    }
+    return flags;
+}
+
+uint64_t box64_flags_materialize(Box64Context *ctx) {
+    Box64LazyFlags *lazy = &ctx->lazy_flags;
+    if (lazy->op != BOX64_FLAGS_NONE) {
+        ctx->rflags = box64_flags_compute((Box64FlagOp)lazy->op, lazy->dst, lazy->src, lazy->result,
+                                          (uint8_t)lazy->size, ctx->rflags);
+        lazy->op = BOX64_FLAGS_NONE;
+    }
+    return ctx->rflags;
+}
+
+static bool condition_from_rflags(uint64_t flags, uint8_t cc) {
+    bool result;
+    switch ((cc >> 1) & 7) {
+        case 0:  result = (flags & X86_FLAG_OF) != 0; break;                           // O
+        case 1:  result = (flags & X86_FLAG_CF) != 0; break;                           // B/C
+        case 2:  result = (flags & X86_FLAG_ZF) != 0; break;                           // E/Z
+        case 3:  result = (flags & (X86_FLAG_CF | X86_FLAG_ZF)) != 0; break;           // BE
+        case 4:  result = (flags & X86_FLAG_SF) != 0; break;                           // S
+        case 5:  result = (flags & X86_FLAG_PF) != 0; break;                           // P
+        case 6:  result = ((flags >> 7) ^ (flags >> 11)) & 1; break;                   // L: SF != OF
+        default: result = (((flags >> 7) ^ (flags >> 11)) & 1) || (flags & X86_FLAG_ZF); break; // LE
+    }
+    return (cc & 1) ? !result : result;
+}
+
+bool box64_flags_condition(Box64Context *ctx, uint8_t cc) {
+    const Box64LazyFlags *lazy = &ctx->lazy_flags;
+    const uint8_t size = (uint8_t)lazy->size;
+    const uint64_t mask = size_mask(size);
+    bool result;
+
+    switch (lazy->op) {
+        case BOX64_FLAGS_NONE:
+            return condition_from_rflags(ctx->rflags, cc);
+
+        case BOX64_FLAGS_SUB: {
+            // CMP a, b 后的条件即 a 与 b 的比较
+            const uint64_t a = lazy->dst & mask, b = lazy->src & mask;
+            switch ((cc >> 1) & 7) {
+                case 1: result = a < b; break;
+                case 2: result = a == b; break;
+                case 3: result = a <= b; break;
+                case 4: result = ((lazy->result >> (size * 8 - 1)) & 1) != 0; break;
+                case 6: result = sign_extend(a, size) < sign_extend(b, size); break;
+                case 7: result = sign_extend(a, size) <= sign_extend(b, size); break;
+                default: goto slow;   // O / P
+            }
+            break;
+        }
+
+        case BOX64_FLAGS_LOGIC: {
+            const uint64_t r = lazy->result & mask;
+            const bool negative = ((r >> (size * 8 - 1)) & 1) != 0;
+            switch ((cc >> 1) & 7) {
+                case 0: result = false; break;          // OF=0
+                case 1: result = false; break;          // CF=0
+                case 2: case 3: result = r == 0; break;
+                case 4: case 6: result = negative; break;
+                case 7: result = negative || r == 0; break;
+                default: goto slow;   // P
+            }
+            break;
+        }
+
+        case BOX64_FLAGS_INC:
+        case BOX64_FLAGS_DEC: {
+            // DEC + JNZ 是最常见的循环尾，ZF/SF 直接看结果
+            const uint64_t r = lazy->result & mask;
+            switch ((cc >> 1) & 7) {
+                case 2: result = r == 0; break;
+                case 4: result = ((r >> (size * 8 - 1)) & 1) != 0; break;
+                default: goto slow;
+            }
+            break;
+        }
+
+        default:
+            goto slow;
+    }
+    return (cc & 1) ? !result : result;
+
+slow:
+    return condition_from_rflags(box64_flags_materialize(ctx), cc);
+}
+
+bool box64_flags_carry(Box64Context *ctx) {
+    const Box64LazyFlags *lazy = &ctx->lazy_flags;
+    const uint64_t mask = size_mask((uint8_t)lazy->size);
+    switch (lazy->op) {
+        case BOX64_FLAGS_ADD:
+            return (lazy->result & mask) < (lazy->dst & mask);
+        case BOX64_FLAGS_SUB:
+            return (lazy->dst & mask) < (lazy->src & mask);
+        case BOX64_FLAGS_LOGIC:
+            return false;
+        case BOX64_FLAGS_NONE:
+        case BOX64_FLAGS_INC:
+        case BOX64_FLAGS_DEC:
+            return (ctx->rflags & X86_FLAG_CF) != 0;
+        default:
+            return (box64_flags_materialize(ctx) & X86_FLAG_CF) != 0;
+    }
+}
@@ -0,0 +1,66 @@
+// Box64Flags.h - RFLAGS 的惰性求值
+// 算术指令调用 box64_flags_record 只记下运算，Jcc/SETcc/CMOVcc/LOOPcc/PUSHF 等读标志的指令
+// 通过 box64_flags_condition / box64_flags_materialize 按需计算
+#ifndef BOX64_FLAGS_H
+#define BOX64_FLAGS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "Box64Context.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// x86 RFLAGS 位
+#define X86_FLAG_CF 0x001
+#define X86_FLAG_PF 0x004
+#define X86_FLAG_AF 0x010
+#define X86_FLAG_ZF 0x040
+#define X86_FLAG_SF 0x080
+#define X86_FLAG_DF 0x400       // 方向标志，不参与惰性求值，始终在 rflags 中
+#define X86_FLAG_OF 0x800
+#define X86_FLAGS_ARITH (X86_FLAG_CF | X86_FLAG_PF | X86_FLAG_AF | X86_FLAG_ZF | X86_FLAG_SF | X86_FLAG_OF)
+
+// 立即计算一次运算的标志（惰性求值和对照测试共用），返回新的 rflags
+// INC/DEC 的 CF 取自 old_flags
+uint64_t box64_flags_compute(Box64FlagOp op, uint64_t dst, uint64_t src, uint64_t result,
+                             uint8_t size, uint64_t old_flags);
+
+// 把待计算的标志写入 ctx->rflags 并返回；JIT代码在无法直接用NZCV时也调用它
+uint64_t box64_flags_materialize(Box64Context *ctx);
+
+// 求值条件码 cc（Jcc/SETcc/CMOVcc 的低4位）；SUB/CMP、逻辑运算的常见条件直接比较操作数，不生成完整标志
+bool box64_flags_condition(Box64Context *ctx, uint8_t cc);
+
+// 只读 CF（ADC/SBB/INC/DEC 需要），不触发完整求值
+bool box64_flags_carry(Box64Context *ctx);
+
+static inline void box64_flags_record(Box64Context *ctx, Box64FlagOp op, uint64_t dst, uint64_t src,
+                                      uint64_t result, uint8_t size) {
+    ctx->lazy_flags.dst = dst;
+    ctx->lazy_flags.src = src;
+    ctx->lazy_flags.result = result;
+    ctx->lazy_flags.op = op;
+    ctx->lazy_flags.size = size;
+}
+
+// INC/DEC 不改变CF：先把当前CF落到 rflags，再记录运算
+static inline void box64_flags_record_incdec(Box64Context *ctx, bool increment, uint64_t dst,
+                                             uint64_t result, uint8_t size) {
+    bool carry = box64_flags_carry(ctx);
+    ctx->rflags = (ctx->rflags & ~(uint64_t)X86_FLAG_CF) | (carry ? X86_FLAG_CF : 0);
+    box64_flags_record(ctx, increment ? BOX64_FLAGS_INC : BOX64_FLAGS_DEC, dst, 1, result, size);
+}
+
+// 直接写入整个 rflags（POPF、上下文恢复），丢弃待计算的标志
+static inline void box64_flags_set(Box64Context *ctx, uint64_t rflags) {
+    ctx->rflags = rflags;
+    ctx->lazy_flags.op = BOX64_FLAGS_NONE;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BOX64_FLAGS_H
@@ -0,0 +1,410 @@
+// Box64Heap.c - 客户机堆分配器实现
+#include "Box64Heap.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define PAGE_NONE           UINT32_MAX
+#define RUN_BINS            32          // 第i箱存放恰好i+1页的空闲段，最后一箱存放 >= RUN_BINS 页
+#define SLAB_MAX_SLOTS      (BOX64_HEAP_PAGE_SIZE / BOX64_HEAP_ALIGNMENT)
+#define SLAB_BITMAP_WORDS   (SLAB_MAX_SLOTS / 64)
+
+enum {
+    PAGE_FREE = 0,      // 空闲段的一部分（段首/段尾的 run 有效）
+    PAGE_LARGE,         // 大块首页
+    PAGE_LARGE_TAIL,    // 大块的后续页
+    PAGE_SLAB           // 小块slab
+};
+
+// 小块大小类，均为16的倍数
+static const uint16_t size_classes[] = {
+    16, 32, 48, 64, 80, 96, 112, 128, 160, 192, 224, 256,
+    320, 384, 448, 512, 640, 768, 896, 1024, 1360, 2048
+};
+#define SIZE_CLASS_COUNT    (sizeof(size_classes) / sizeof(size_classes[0]))
+
+typedef struct HeapPage {
+    uint8_t kind;
+    uint8_t size_class;
+    uint16_t free_slots;
+    uint32_t run;           // 空闲段/大块的页数（空闲段首尾都记录）
+    uint32_t next;          // 空闲段分箱链表或部分空闲slab链表
+    uint32_t prev;
+    uint64_t free_bits[SLAB_BITMAP_WORDS];
+} HeapPage;
+
+struct Box64Heap {
+    uint64_t base;
+    uint32_t page_count;
+    HeapPage *pages;
+    uint32_t bins[RUN_BINS];
+    uint32_t bin_mask;                      // 非空箱的位图
+    uint32_t partial[SIZE_CLASS_COUNT];     // 有空槽的slab
+    uint8_t class_of[BOX64_HEAP_SMALL_MAX / BOX64_HEAP_ALIGNMENT + 1];
+    Box64HeapStats stats;
+};
+
+static inline uint32_t slab_slots(uint8_t size_class) {
+    return (uint32_t)(BOX64_HEAP_PAGE_SIZE / size_classes[size_class]);
+}
+
+static void note_allocated(Box64Heap *heap, uint64_t bytes) {
+    heap->stats.bytes_in_use += bytes;
+    if (heap->stats.bytes_in_use > heap->stats.peak_bytes_in_use) {
+        heap->stats.peak_bytes_in_use = heap->stats.bytes_in_use;
+    }
+    heap->stats.allocations++;
+    heap->stats.live_blocks++;
+}
+
+static void note_freed(Box64Heap *heap, uint64_t bytes) {
+    heap->stats.bytes_in_use -= bytes;
+    heap->stats.frees++;
+    heap->stats.live_blocks--;
+}
+
+// MARK: - 空闲页段
+
+static inline uint32_t run_bin(uint32_t pages) {
+    return pages >= RUN_BINS ? RUN_BINS - 1 : pages - 1;
+}
+
+static void bin_insert(Box64Heap *heap, uint32_t first, uint32_t pages) {
+    const uint32_t bin = run_bin(pages);
+    HeapPage *head = &heap->pages[first];
+    HeapPage *tail = &heap->pages[first + pages - 1];
+    head->kind = PAGE_FREE;
+    head->run = pages;
+    tail->kind = PAGE_FREE;
+    tail->run = pages;
+    head->prev = PAGE_NONE;
+    head->next = heap->bins[bin];
+    if (head->next != PAGE_NONE) {
+        heap->pages[head->next].prev = first;
+    }
+    heap->bins[bin] = first;
+    heap->bin_mask |= 1u << bin;
+}
+
+static void bin_remove(Box64Heap *heap, uint32_t first) {
+    HeapPage *head = &heap->pages[first];
+    const uint32_t bin = run_bin(head->run);
+    if (head->prev != PAGE_NONE) {
+        heap->pages[head->prev].next = head->next;
+    } else {
+        heap->bins[bin] = head->next;
+        if (head->next == PAGE_NONE) {
+            heap->bin_mask &= ~(1u << bin);
+        }
+    }
+    if (head->next != PAGE_NONE) {
+        heap->pages[head->next].prev = head->prev;
+    }
+}
+
+// 从最小的可用箱取段；最后一箱按最佳适配扫描，从段首切出所需页
+static uint32_t pages_alloc(Box64Heap *heap, uint32_t pages) {
+    uint32_t candidates = heap->bin_mask & ~((1u << run_bin(pages)) - 1);
+    if (!candidates) {
+        return PAGE_NONE;
+    }
+    const uint32_t bin = (uint32_t)__builtin_ctz(candidates);
+    uint32_t first = heap->bins[bin];
+    if (bin == RUN_BINS - 1) {
+        uint32_t best = PAGE_NONE;
+        for (uint32_t page = first; page != PAGE_NONE; page = heap->pages[page].next) {
+            const uint32_t run = heap->pages[page].run;
+            if (run >= pages && (best == PAGE_NONE || run < heap->pages[best].run)) {
+                best = page;
+                if (run == pages) {
+                    break;
+                }
+            }
+        }
+        if (best == PAGE_NONE) {
+            return PAGE_NONE;
+        }
+        first = best;
+    }
+
+    const uint32_t run = heap->pages[first].run;
+    bin_remove(heap, first);
+    if (run > pages) {
+        bin_insert(heap, first + pages, run - pages);
+    }
+    heap->stats.free_pages -= pages;
+    return first;
+}
+
+// 归还页段并与前后相邻的空闲段合并
+// 合并后本段首尾可能落在新段内部，bin_insert 不会再写到它们；先标记为空闲，
+// 否则首页仍是 PAGE_LARGE / PAGE_SLAB，重复释放同一指针会被接受
+static void pages_free(Box64Heap *heap, uint32_t first, uint32_t pages) {
+    heap->stats.free_pages += pages;
+    heap->pages[first].kind = PAGE_FREE;
+    heap->pages[first + pages - 1].kind = PAGE_FREE;
+    if (first > 0 && heap->pages[first - 1].kind == PAGE_FREE) {
+        const uint32_t left = first - heap->pages[first - 1].run;
+        pages += heap->pages[left].run;
+        bin_remove(heap, left);
+        first = left;
+    }
+    const uint32_t after = first + pages;
+    if (after < heap->page_count && heap->pages[after].kind == PAGE_FREE) {
+        pages += heap->pages[after].run;
+        bin_remove(heap, after);
+    }
+    bin_insert(heap, first, pages);
+}
+
+// MARK: - slab
+
+static void partial_push(Box64Heap *heap, uint32_t page) {
+    HeapPage *slab = &heap->pages[page];
+    slab->prev = PAGE_NONE;
+    slab->next = heap->partial[slab->size_class];
+    if (slab->next != PAGE_NONE) {
+        heap->pages[slab->next].prev = page;
+    }
+    heap->partial[slab->size_class] = page;
+}
+
+static void partial_remove(Box64Heap *heap, uint32_t page) {
+    HeapPage *slab = &heap->pages[page];
+    if (slab->prev != PAGE_NONE) {
+        heap->pages[slab->prev].next = slab->next;
+    } else {
+        heap->partial[slab->size_class] = slab->next;
+    }
+    if (slab->next != PAGE_NONE) {
+        heap->pages[slab->next].prev = slab->prev;
+    }
+}
+
+static uint64_t slab_alloc(Box64Heap *heap, uint8_t size_class) {
+    uint32_t page = heap->partial[size_class];
+    if (page == PAGE_NONE) {
+        page = pages_alloc(heap, 1);
+        if (page == PAGE_NONE) {
+            return 0;
+        }
+        HeapPage *slab = &heap->pages[page];
+        const uint32_t slots = slab_slots(size_class);
+        slab->kind = PAGE_SLAB;
+        slab->size_class = size_class;
+        slab->free_slots = (uint16_t)slots;
+        memset(slab->free_bits, 0, sizeof(slab->free_bits));
+        for (uint32_t word = 0; word < slots / 64; word++) {
+            slab->free_bits[word] = ~0ULL;
+        }
+        if (slots % 64) {
+            slab->free_bits[slots / 64] = (1ULL << (slots % 64)) - 1;
+        }
+        heap->stats.slab_pages++;
+        partial_push(heap, page);
+    }
+
+    HeapPage *slab = &heap->pages[page];
+    uint32_t word = 0;
+    while (slab->free_bits[word] == 0) {
+        word++;
+    }
+    const uint32_t bit = (uint32_t)__builtin_ctzll(slab->free_bits[word]);
+    slab->free_bits[word] &= ~(1ULL << bit);
+    if (--slab->free_slots == 0) {
+        partial_remove(heap, page);
+    }
+    note_allocated(heap, size_classes[size_class]);
+    return heap->base + ((uint64_t)page << BOX64_HEAP_PAGE_SHIFT) + (uint64_t)(word * 64 + bit) * size_classes[size_class];
+}
+
+static bool slab_free(Box64Heap *heap, uint32_t page, uint64_t offset) {
+    HeapPage *slab = &heap->pages[page];
+    const uint32_t size = size_classes[slab->size_class];
+    if (offset % size != 0) {
+        return false;
+    }
+    const uint32_t slot = (uint32_t)(offset / size);
+    const uint64_t bit = 1ULL << (slot % 64);
+    if (slot >= slab_slots(slab->size_class) || (slab->free_bits[slot / 64] & bit)) {
+        return false;
+    }
+    slab->free_bits[slot / 64] |= bit;
+    if (slab->free_slots++ == 0) {
+        partial_push(heap, page);
+    }
+    note_freed(heap, size);
+
+    // 全空的slab归还页分配器，但保留每个大小类唯一的一个，避免反复申请释放
+    if (slab->free_slots == slab_slots(slab->size_class) &&
+        (heap->partial[slab->size_class] != page || slab->next != PAGE_NONE)) {
+        partial_remove(heap, page);
+        heap->stats.slab_pages--;
+        pages_free(heap, page, 1);
+    }
+    return true;
+}
+
+// MARK: - 公共接口
+
+void box64_heap_reset(Box64Heap *heap) {
+    if (!heap) {
+        return;
+    }
+    const uint32_t total = heap->page_count;
+    memset(heap->pages, 0, (size_t)total * sizeof(HeapPage));
+    memset(&heap->stats, 0, sizeof(heap->stats));
+    for (uint32_t i = 0; i < RUN_BINS; i++) {
+        heap->bins[i] = PAGE_NONE;
+    }
+    for (uint32_t i = 0; i < SIZE_CLASS_COUNT; i++) {
+        heap->partial[i] = PAGE_NONE;
+    }
+    heap->bin_mask = 0;
+    heap->stats.total_pages = total;
+    heap->stats.free_pages = total;
+    bin_insert(heap, 0, total);
+}
+
+Box64Heap *box64_heap_create(uint64_t base, uint64_t size) {
+    const uint64_t page_count = size >> BOX64_HEAP_PAGE_SHIFT;
+    if ((base & (BOX64_HEAP_PAGE_SIZE - 1)) || page_count == 0 || page_count >= PAGE_NONE) {
+        return NULL;
+    }
+    Box64Heap *heap = calloc(1, sizeof(Box64Heap));
+    if (!heap) {
+        return NULL;
+    }
+    heap->pages = malloc((size_t)page_count * sizeof(HeapPage));
+    if (!heap->pages) {
+        free(heap);
+        return NULL;
+    }
+    heap->base = base;
+    heap->page_count = (uint32_t)page_count;
+
+    uint8_t size_class = 0;
+    for (uint32_t units = 0; units <= BOX64_HEAP_SMALL_MAX / BOX64_HEAP_ALIGNMENT; units++) {
+        while (size_classes[size_class] < units * BOX64_HEAP_ALIGNMENT) {
+            size_class++;
+        }
+        heap->class_of[units] = size_class;
+    }
+
+    box64_heap_reset(heap);
+    return heap;
+}
+
+void box64_heap_destroy(Box64Heap *heap) {
+    if (!heap) {
+        return;
+    }
+    free(heap->pages);
+    free(heap);
+}
+
+uint64_t box64_heap_alloc(Box64Heap *heap, uint64_t size) {
+    if (!heap) {
+        return 0;
+    }
+    if (size == 0) {
+        size = 1;
+    }
+
+    uint64_t address = 0;
+    if (size <= BOX64_HEAP_SMALL_MAX) {
+        address = slab_alloc(heap, heap->class_of[(size + BOX64_HEAP_ALIGNMENT - 1) / BOX64_HEAP_ALIGNMENT]);
+    } else if (size <= (uint64_t)heap->page_count << BOX64_HEAP_PAGE_SHIFT) {
+        const uint32_t pages = (uint32_t)((size + BOX64_HEAP_PAGE_SIZE - 1) >> BOX64_HEAP_PAGE_SHIFT);
+        const uint32_t first = pages_alloc(heap, pages);
+        if (first != PAGE_NONE) {
+            heap->pages[first].kind = PAGE_LARGE;
+            heap->pages[first].run = pages;
+            for (uint32_t page = first + 1; page < first + pages; page++) {
+                heap->pages[page].kind = PAGE_LARGE_TAIL;
+            }
+            heap->stats.large_pages += pages;
+            note_allocated(heap, (uint64_t)pages << BOX64_HEAP_PAGE_SHIFT);
+            address = heap->base + ((uint64_t)first << BOX64_HEAP_PAGE_SHIFT);
+        }
+    }
+
+    if (address == 0) {
+        heap->stats.failed_allocations++;
+    }
+    return address;
+}
+
+bool box64_heap_contains(const Box64Heap *heap, uint64_t address) {
+    return heap && address >= heap->base && address - heap->base < ((uint64_t)heap->page_count << BOX64_HEAP_PAGE_SHIFT);
+}
+
+bool box64_heap_free(Box64Heap *heap, uint64_t address) {
+    if (!box64_heap_contains(heap, address)) {
+        return false;
+    }
+    const uint64_t offset = address - heap->base;
+    const uint32_t page = (uint32_t)(offset >> BOX64_HEAP_PAGE_SHIFT);
+    HeapPage *entry = &heap->pages[page];
+
+    if (entry->kind == PAGE_SLAB) {
+        return slab_free(heap, page, offset & (BOX64_HEAP_PAGE_SIZE - 1));
+    }
+    if (entry->kind != PAGE_LARGE || (offset & (BOX64_HEAP_PAGE_SIZE - 1))) {
+        return false;
+    }
+    const uint32_t pages = entry->run;
+    heap->stats.large_pages -= pages;
+    note_freed(heap, (uint64_t)pages << BOX64_HEAP_PAGE_SHIFT);
+    pages_free(heap, page, pages);
+    return true;
+}
+
+uint64_t box64_heap_block_size(const Box64Heap *heap, uint64_t address) {
+    if (!box64_heap_contains(heap, address)) {
+        return 0;
+    }
+    const uint64_t offset = address - heap->base;
+    const HeapPage *entry = &heap->pages[offset >> BOX64_HEAP_PAGE_SHIFT];
+    const uint64_t in_page = offset & (BOX64_HEAP_PAGE_SIZE - 1);
+
+    if (entry->kind == PAGE_SLAB) {
+        const uint32_t size = size_classes[entry->size_class];
+        const uint32_t slot = (uint32_t)(in_page / size);
+        if (in_page % size || slot >= slab_slots(entry->size_class) ||
+            (entry->free_bits[slot / 64] & (1ULL << (slot % 64)))) {
+            return 0;
+        }
+        return size;
+    }
+    if (entry->kind == PAGE_LARGE && in_page == 0) {
+        return (uint64_t)entry->run << BOX64_HEAP_PAGE_SHIFT;
+    }
+    return 0;
+}
+
+void box64_heap_get_stats(const Box64Heap *heap, Box64HeapStats *stats) {
+    if (!heap || !stats) {
+        return;
+    }
+    *stats = heap->stats;
+
+    // 最长空闲段：最高的非空箱；最后一箱需扫描
+    uint32_t largest = 0;
+    if (heap->bin_mask) {
+        const uint32_t bin = 31 - (uint32_t)__builtin_clz(heap->bin_mask);
+        if (bin < RUN_BINS - 1) {
+            largest = bin + 1;
+        } else {
+            for (uint32_t page = heap->bins[bin]; page != PAGE_NONE; page = heap->pages[page].next) {
+                if (heap->pages[page].run > largest) {
+                    largest = heap->pages[page].run;
+                }
+            }
+        }
+    }
+    stats->largest_free_run = largest;
+
+    const uint64_t committed = (uint64_t)(stats->slab_pages + stats->large_pages) << BOX64_HEAP_PAGE_SHIFT;
+    stats->internal_fragmentation = committed ? 1.0 - (double)stats->bytes_in_use / (double)committed : 0.0;
+    stats->external_fragmentation = stats->free_pages ? 1.0 - (double)largest / (double)stats->free_pages : 0.0;
+}
@@ -0,0 +1,63 @@
+// Box64Heap.h - 客户机堆分配器
+// 纯C实现，管理一段客户机地址区间 [base, base+size)，只分配地址不访问内存：
+//   小块（<= BOX64_HEAP_SMALL_MAX）按大小类从单页slab分配，空闲槽位用位图记录
+//   大块按页分配，空闲页段按长度分箱，释放时与相邻空闲段合并
+// 元数据全部放在宿主侧，客户机越界写不会破坏分配器状态
+#ifndef BOX64_HEAP_H
+#define BOX64_HEAP_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BOX64_HEAP_PAGE_SHIFT   12
+#define BOX64_HEAP_PAGE_SIZE    (1ULL << BOX64_HEAP_PAGE_SHIFT)
+#define BOX64_HEAP_ALIGNMENT    16          // 所有块至少16字节对齐（与Win64 HeapAlloc一致）
+#define BOX64_HEAP_SMALL_MAX    2048        // 更大的请求走页分配，按页对齐
+
+typedef struct Box64HeapStats {
+    uint64_t bytes_in_use;        // 已分配块的实际占用（按大小类/整页取整）
+    uint64_t peak_bytes_in_use;
+    uint64_t allocations;         // 累计成功分配次数
+    uint64_t frees;
+    uint64_t failed_allocations;
+    uint32_t live_blocks;
+    uint32_t slab_pages;          // 被小块slab占用的页
+    uint32_t large_pages;         // 被大块占用的页
+    uint32_t free_pages;
+    uint32_t largest_free_run;    // 最长连续空闲页数
+    uint32_t total_pages;
+    double internal_fragmentation;  // 1 - 已分配字节 / (slab页 + 大块页)字节，即slab中的空槽
+    double external_fragmentation;  // 1 - 最长空闲段 / 全部空闲页
+} Box64HeapStats;
+
+typedef struct Box64Heap Box64Heap;
+
+// base 需页对齐；size 向下取整到页
+Box64Heap *box64_heap_create(uint64_t base, uint64_t size);
+void box64_heap_destroy(Box64Heap *heap);
+
+// 释放全部块，统计中的累计计数一并清零
+void box64_heap_reset(Box64Heap *heap);
+
+// 返回客户机地址，失败返回0；size为0时按1字节分配
+uint64_t box64_heap_alloc(Box64Heap *heap, uint64_t size);
+
+// 只接受本堆分配且尚未释放的块首地址，否则返回false（重复释放/野指针）
+bool box64_heap_free(Box64Heap *heap, uint64_t address);
+
+// 块的可用字节数（大小类或整页），非法地址返回0
+uint64_t box64_heap_block_size(const Box64Heap *heap, uint64_t address);
+
+bool box64_heap_contains(const Box64Heap *heap, uint64_t address);
+void box64_heap_get_stats(const Box64Heap *heap, Box64HeapStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BOX64_HEAP_H
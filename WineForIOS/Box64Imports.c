@@ -0,0 +1,449 @@
+// Box64Imports.c - 导入表解析与宿主函数桩实现
+#include "Box64Imports.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define IMPORT_DESCRIPTOR_SIZE  20
+#define IMPORT_MAX_DESCRIPTORS  4096
+#define DLL_NAME_MAX            64
+#define WIN64_SHADOW_SPACE      0x20        // 返回地址之上为调用方预留的4个寄存器参数位置
+
+static const uint8_t stub_signature[4] = { 0xCC, 'B', '6', '4' };
+
+// MARK: - 键与哈希
+
+// "dll!symbol"：DLL名转小写并去掉.dll后缀；返回长度，超长返回0
+static size_t normalize_key(const char *dll, const char *symbol, char *key, size_t size) {
+    size_t dll_length = strlen(dll);
+    if (dll_length >= 4 && (dll[dll_length - 4] == '.') &&
+        (dll[dll_length - 3] | 0x20) == 'd' && (dll[dll_length - 2] | 0x20) == 'l' &&
+        (dll[dll_length - 1] | 0x20) == 'l') {
+        dll_length -= 4;
+    }
+    const size_t symbol_length = strlen(symbol);
+    if (dll_length == 0 || symbol_length == 0 || dll_length + 1 + symbol_length + 1 > size) {
+        return 0;
+    }
+    for (size_t i = 0; i < dll_length; i++) {
+        const char c = dll[i];
+        key[i] = (c >= 'A' && c <= 'Z') ? (char)(c + 32) : c;
+    }
+    key[dll_length] = '!';
+    memcpy(key + dll_length + 1, symbol, symbol_length + 1);
+    return dll_length + 1 + symbol_length;
+}
+
+// FNV-1a
+static uint32_t hash_key(const char *key, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ (uint8_t)key[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// MARK: - 注册表
+
+// thunk 单独分配，槽位里缓存的指针在注册表扩容后仍然有效
+struct Box64ThunkRegistry {
+    Box64Thunk **thunks;
+    uint32_t count;
+    uint32_t capacity;
+    int32_t *buckets;               // 线性探测，-1 为空
+    uint32_t bucket_mask;
+};
+
+Box64ThunkRegistry *box64_thunk_registry_create(void) {
+    Box64ThunkRegistry *registry = calloc(1, sizeof(*registry));
+    if (!registry) {
+        return NULL;
+    }
+    registry->bucket_mask = 255;
+    registry->buckets = malloc((registry->bucket_mask + 1) * sizeof(int32_t));
+    if (!registry->buckets) {
+        free(registry);
+        return NULL;
+    }
+    memset(registry->buckets, 0xFF, (registry->bucket_mask + 1) * sizeof(int32_t));
+    return registry;
+}
+
+void box64_thunk_registry_destroy(Box64ThunkRegistry *registry) {
+    if (!registry) {
+        return;
+    }
+    for (uint32_t i = 0; i < registry->count; i++) {
+        free(registry->thunks[i]);
+    }
+    free(registry->thunks);
+    free(registry->buckets);
+    free(registry);
+}
+
+static int32_t find_bucket(const Box64ThunkRegistry *registry, const char *key, uint32_t hash) {
+    uint32_t bucket = hash & registry->bucket_mask;
+    while (registry->buckets[bucket] >= 0) {
+        const Box64Thunk *thunk = registry->thunks[registry->buckets[bucket]];
+        if (thunk->hash == hash && strcmp(thunk->key, key) == 0) {
+            return (int32_t)bucket;
+        }
+        bucket = (bucket + 1) & registry->bucket_mask;
+    }
+    return -1 - (int32_t)bucket;    // 空桶位置编码为负数
+}
+
+// 装载因子保持在1/2以下
+static bool grow_buckets(Box64ThunkRegistry *registry) {
+    const uint32_t bucket_count = (registry->bucket_mask + 1) * 2;
+    int32_t *buckets = malloc(bucket_count * sizeof(int32_t));
+    if (!buckets) {
+        return false;
+    }
+    memset(buckets, 0xFF, bucket_count * sizeof(int32_t));
+    for (uint32_t i = 0; i < registry->count; i++) {
+        uint32_t bucket = registry->thunks[i]->hash & (bucket_count - 1);
+        while (buckets[bucket] >= 0) {
+            bucket = (bucket + 1) & (bucket_count - 1);
+        }
+        buckets[bucket] = (int32_t)i;
+    }
+    free(registry->buckets);
+    registry->buckets = buckets;
+    registry->bucket_mask = bucket_count - 1;
+    return true;
+}
+
+bool box64_thunk_register(Box64ThunkRegistry *registry, const char *dll, const char *symbol,
+                          Box64ThunkFn fn, uint8_t arg_count, void *user) {
+    char key[BOX64_THUNK_NAME_MAX];
+    const size_t length = (registry && dll && symbol && fn && arg_count <= BOX64_THUNK_MAX_ARGS)
+        ? normalize_key(dll, symbol, key, sizeof(key)) : 0;
+    if (length == 0) {
+        return false;
+    }
+    const uint32_t hash = hash_key(key, length);
+
+    int32_t bucket = find_bucket(registry, key, hash);
+    if (bucket >= 0) {
+        Box64Thunk *thunk = registry->thunks[registry->buckets[bucket]];
+        thunk->fn = fn;
+        thunk->arg_count = arg_count;
+        thunk->user = user;
+        return true;
+    }
+
+    if ((registry->count + 1) * 2 > registry->bucket_mask + 1) {
+        if (!grow_buckets(registry)) {
+            return false;
+        }
+        bucket = find_bucket(registry, key, hash);
+    }
+    if (registry->count == registry->capacity) {
+        const uint32_t capacity = registry->capacity ? registry->capacity * 2 : 64;
+        Box64Thunk **thunks = realloc(registry->thunks, capacity * sizeof(Box64Thunk *));
+        if (!thunks) {
+            return false;
+        }
+        registry->thunks = thunks;
+        registry->capacity = capacity;
+    }
+
+    Box64Thunk *thunk = malloc(sizeof(Box64Thunk) + length + 1);
+    if (!thunk) {
+        return false;
+    }
+    char *stored_key = (char *)(thunk + 1);
+    memcpy(stored_key, key, length + 1);
+    thunk->key = stored_key;
+    thunk->fn = fn;
+    thunk->user = user;
+    thunk->arg_count = arg_count;
+    thunk->hash = hash;
+
+    registry->buckets[-1 - bucket] = (int32_t)registry->count;
+    registry->thunks[registry->count++] = thunk;
+    return true;
+}
+
+const Box64Thunk *box64_thunk_lookup(const Box64ThunkRegistry *registry, const char *dll, const char *symbol) {
+    char key[BOX64_THUNK_NAME_MAX];
+    const size_t length = (registry && dll && symbol) ? normalize_key(dll, symbol, key, sizeof(key)) : 0;
+    if (length == 0) {
+        return NULL;
+    }
+    const int32_t bucket = find_bucket(registry, key, hash_key(key, length));
+    return bucket >= 0 ? registry->thunks[registry->buckets[bucket]] : NULL;
+}
+
+uint32_t box64_thunk_registry_count(const Box64ThunkRegistry *registry) {
+    return registry ? registry->count : 0;
+}
+
+// MARK: - 导入表扫描
+
+void box64_imports_init(Box64ImportTable *table, const Box64ThunkRegistry *registry) {
+    memset(table, 0, sizeof(*table));
+    table->registry = registry;
+}
+
+void box64_imports_destroy(Box64ImportTable *table) {
+    free(table->slots);
+    box64_imports_init(table, table->registry);
+}
+
+static bool read_rva(Box64MMU *mmu, const Box64PEImage *image, uint32_t rva, uint8_t size, uint64_t *value) {
+    if ((uint64_t)rva + size > image->size_of_image) {
+        return false;
+    }
+    return box64_mmu_load(mmu, image->base + rva, size, value);
+}
+
+static bool append_slot(Box64ImportTable *table, const Box64ImportSlot *slot) {
+    if (table->count == table->capacity) {
+        const uint32_t capacity = table->capacity ? table->capacity * 2 : 64;
+        Box64ImportSlot *slots = realloc(table->slots, capacity * sizeof(Box64ImportSlot));
+        if (!slots) {
+            return false;
+        }
+        table->slots = slots;
+        table->capacity = capacity;
+    }
+    table->slots[table->count++] = *slot;
+    return true;
+}
+
+Box64ImportStatus box64_imports_scan(Box64ImportTable *table, Box64MMU *mmu, const Box64PEImage *image) {
+    table->count = 0;
+    table->dll_count = 0;
+    table->resolved = 0;
+    table->stub_base = 0;
+    table->image_base = image->base;
+    table->entry_size = image->pe32_plus ? 8 : 4;
+
+    if (image->directory_count <= BOX64_PE_DIR_IMPORT) {
+        return BOX64_IMPORT_OK;
+    }
+    const Box64PEDataDirectory *directory = &image->directories[BOX64_PE_DIR_IMPORT];
+    if (directory->rva == 0 || directory->size == 0) {
+        return BOX64_IMPORT_OK;
+    }
+
+    const uint8_t entry_size = table->entry_size;
+    const uint64_t ordinal_flag = image->pe32_plus ? (1ULL << 63) : (1ULL << 31);
+
+    for (uint32_t d = 0; d < IMPORT_MAX_DESCRIPTORS; d++) {
+        const uint32_t descriptor = directory->rva + d * IMPORT_DESCRIPTOR_SIZE;
+        uint64_t lookup_rva, name_rva, iat_rva;
+        if (!read_rva(mmu, image, descriptor + 0, 4, &lookup_rva) ||
+            !read_rva(mmu, image, descriptor + 12, 4, &name_rva) ||
+            !read_rva(mmu, image, descriptor + 16, 4, &iat_rva)) {
+            return BOX64_IMPORT_BAD_DIRECTORY;
+        }
+        if (lookup_rva == 0 && name_rva == 0 && iat_rva == 0) {
+            return BOX64_IMPORT_OK;     // 全零描述符结束
+        }
+        if (iat_rva == 0 || name_rva == 0 || name_rva >= image->size_of_image) {
+            return BOX64_IMPORT_BAD_DIRECTORY;
+        }
+        // 没有 OriginalFirstThunk 的旧式链接器直接从IAT读名称
+        if (lookup_rva == 0) {
+            lookup_rva = iat_rva;
+        }
+        table->dll_count++;
+
+        for (uint32_t i = 0;; i++) {
+            uint64_t entry;
+            if (!read_rva(mmu, image, (uint32_t)(lookup_rva + (uint64_t)i * entry_size), entry_size, &entry) ||
+                (uint64_t)iat_rva + (uint64_t)(i + 1) * entry_size > image->size_of_image) {
+                return BOX64_IMPORT_BAD_DIRECTORY;
+            }
+            if (entry == 0) {
+                break;
+            }
+            if (table->count >= BOX64_IMPORTS_MAX) {
+                return BOX64_IMPORT_BAD_DIRECTORY;
+            }
+
+            Box64ImportSlot slot = { 0 };
+            slot.iat_address = image->base + iat_rva + (uint64_t)i * entry_size;
+            slot.dll_rva = (uint32_t)name_rva;
+            if (entry & ordinal_flag) {
+                slot.ordinal = (uint16_t)entry;
+            } else {
+                // IMAGE_IMPORT_BY_NAME: 2字节hint + 名称
+                const uint64_t hint_rva = entry & 0x7FFFFFFF;
+                if (hint_rva + 2 >= image->size_of_image) {
+                    return BOX64_IMPORT_BAD_DIRECTORY;
+                }
+                slot.name_rva = (uint32_t)hint_rva + 2;
+            }
+            if (!append_slot(table, &slot)) {
+                return BOX64_IMPORT_NO_MEMORY;
+            }
+        }
+    }
+    return BOX64_IMPORT_BAD_DIRECTORY;
+}
+
+Box64ImportStatus box64_imports_bind(Box64ImportTable *table, Box64MMU *mmu, uint64_t stub_base) {
+    table->stub_base = stub_base;
+    for (uint32_t i = 0; i < table->count; i++) {
+        const uint64_t stub = stub_base + (uint64_t)i * BOX64_THUNK_STUB_SIZE;
+        uint8_t bytes[BOX64_THUNK_STUB_SIZE];
+        memcpy(bytes, stub_signature, sizeof(stub_signature));
+        bytes[4] = (uint8_t)i;
+        bytes[5] = (uint8_t)(i >> 8);
+        bytes[6] = (uint8_t)(i >> 16);
+        bytes[7] = (uint8_t)(i >> 24);
+        if (!box64_mmu_copy_to_guest(mmu, stub, bytes, sizeof(bytes))) {
+            return BOX64_IMPORT_STUB_FAILED;
+        }
+
+        // 按读权限取宿主指针再写：IAT常在只读的 .rdata 中
+        uint8_t *host = box64_mmu_translate(mmu, table->slots[i].iat_address, table->entry_size, BOX64_ACCESS_READ);
+        if (!host) {
+            return BOX64_IMPORT_STUB_FAILED;
+        }
+        box64_mmu_write_host(host, table->entry_size, stub);
+    }
+    return BOX64_IMPORT_OK;
+}
+
+// MARK: - 解析与分派
+
+bool box64_thunk_read_string(Box64MMU *mmu, uint64_t address, char *buffer, size_t size) {
+    if (size == 0) {
+        return false;
+    }
+    for (size_t i = 0; i + 1 < size; i++) {
+        uint64_t c;
+        if (!box64_mmu_load(mmu, address + i, 1, &c)) {
+            buffer[i] = '\0';
+            return false;
+        }
+        buffer[i] = (char)c;
+        if (c == 0) {
+            return true;
+        }
+    }
+    buffer[size - 1] = '\0';
+    return true;
+}
+
+static bool slot_names(const Box64ImportTable *table, Box64MMU *mmu, const Box64ImportSlot *slot,
+                       char *dll, char *symbol, size_t symbol_size) {
+    if (!box64_thunk_read_string(mmu, table->image_base + slot->dll_rva, dll, DLL_NAME_MAX)) {
+        return false;
+    }
+    if (slot->name_rva == 0) {
+        snprintf(symbol, symbol_size, "#%u", slot->ordinal);
+        return true;
+    }
+    return box64_thunk_read_string(mmu, table->image_base + slot->name_rva, symbol, symbol_size);
+}
+
+// 几个线程可能同时第一次调用同一个导入：各自查注册表，结果相同，只有先发布的那个计入 resolved
+static const Box64Thunk *resolve_slot(Box64ImportTable *table, Box64MMU *mmu, Box64ImportSlot *slot) {
+    char dll[DLL_NAME_MAX];
+    char symbol[BOX64_THUNK_NAME_MAX];
+    const Box64Thunk *thunk = NULL;
+    if (slot_names(table, mmu, slot, dll, symbol, sizeof(symbol))) {
+        thunk = box64_thunk_lookup(table->registry, dll, symbol);
+    }
+    if (!thunk) {
+        atomic_store_explicit(&slot->resolve_failed, true, memory_order_relaxed);
+        return NULL;
+    }
+    const Box64Thunk *expected = NULL;
+    if (atomic_compare_exchange_strong_explicit(&slot->thunk, &expected, thunk, memory_order_release,
+                                                memory_order_acquire)) {
+        atomic_fetch_add_explicit(&table->resolved, 1, memory_order_relaxed);
+        return thunk;
+    }
+    return expected;
+}
+
+Box64ThunkStatus box64_imports_prepare(Box64ImportTable *table, Box64Context *ctx, uint64_t rip,
+                                       Box64ThunkCall *call, const Box64Thunk **thunk_out,
+                                       const Box64ImportSlot **slot_out) {
+    const uint64_t offset = rip - table->stub_base;
+    Box64ImportSlot *slot = &table->slots[offset / BOX64_THUNK_STUB_SIZE];
+    if (slot_out) {
+        *slot_out = slot;
+    }
+    // 跳进桩中间不是合法的调用
+    if (offset % BOX64_THUNK_STUB_SIZE) {
+        return BOX64_THUNK_UNRESOLVED;
+    }
+    const Box64Thunk *thunk = atomic_load_explicit(&slot->thunk, memory_order_acquire);
+    if (!thunk && (atomic_load_explicit(&slot->resolve_failed, memory_order_relaxed) ||
+                   !(thunk = resolve_slot(table, &ctx->mmu, slot)))) {
+        return BOX64_THUNK_UNRESOLVED;
+    }
+
+    // Win64: 前4个参数在 RCX/RDX/R8/R9，其余从 [RSP+8+0x20] 起；[RSP] 为返回地址
+    memset(call, 0, sizeof(*call));
+    call->ctx = ctx;
+    call->user = thunk->user;
+    call->args[0] = ctx->x86_regs[1];
+    call->args[1] = ctx->x86_regs[2];
+    call->args[2] = ctx->x86_regs[8];
+    call->args[3] = ctx->x86_regs[9];
+
+    const uint64_t rsp = ctx->x86_regs[4];
+    if (!box64_mmu_load(&ctx->mmu, rsp, 8, &call->return_address)) {
+        return BOX64_THUNK_FAULT;
+    }
+    for (uint8_t i = 4; i < thunk->arg_count; i++) {
+        if (!box64_mmu_load(&ctx->mmu, rsp + 8 + WIN64_SHADOW_SPACE + (uint64_t)(i - 4) * 8, 8, &call->args[i])) {
+            return BOX64_THUNK_FAULT;
+        }
+    }
+    for (uint8_t i = thunk->arg_count; i < 4; i++) {
+        call->args[i] = 0;
+    }
+
+    // 调用前计数：桩返回时导入表可能已经卸载
+    atomic_fetch_add_explicit(&slot->calls, 1, memory_order_relaxed);
+    *thunk_out = thunk;
+    return BOX64_THUNK_OK;
+}
+
+Box64ThunkStatus box64_imports_call(const Box64Thunk *thunk, Box64ThunkCall *call) {
+    Box64Context *ctx = call->ctx;
+    const uint64_t result = thunk->fn(call);
+    ctx->x86_regs[0] = result;
+    ctx->x86_regs[4] += 8;
+    ctx->rip = call->return_address;
+    return call->exit_requested ? BOX64_THUNK_EXIT : BOX64_THUNK_OK;
+}
+
+Box64ThunkStatus box64_imports_dispatch(Box64ImportTable *table, Box64Context *ctx, uint64_t rip,
+                                        const Box64ImportSlot **slot) {
+    Box64ThunkCall call;
+    const Box64Thunk *thunk = NULL;
+    const Box64ThunkStatus status = box64_imports_prepare(table, ctx, rip, &call, &thunk, slot);
+    return status == BOX64_THUNK_OK ? box64_imports_call(thunk, &call) : status;
+}
+
+void box64_imports_describe(const Box64ImportTable *table, Box64MMU *mmu, const Box64ImportSlot *slot,
+                            char *buffer, size_t size) {
+    char dll[DLL_NAME_MAX];
+    char symbol[BOX64_THUNK_NAME_MAX];
+    if (!slot || !slot_names(table, mmu, slot, dll, symbol, sizeof(symbol))) {
+        snprintf(buffer, size, "?");
+        return;
+    }
+    snprintf(buffer, size, "%s!%s", dll, symbol);
+}
+
+const char *box64_import_status_string(Box64ImportStatus status) {
+    switch (status) {
+        case BOX64_IMPORT_OK:               return "ok";
+        case BOX64_IMPORT_BAD_DIRECTORY:    return "bad import directory";
+        case BOX64_IMPORT_NO_MEMORY:        return "out of memory";
+        case BOX64_IMPORT_STUB_FAILED:      return "cannot write import stubs";
+    }
+    return "unknown";
+}
@@ -0,0 +1,139 @@
+// Box64Imports.h - 导入表解析与宿主函数桩（thunk）
+// 纯C实现，把客户机PE的导入（dll!symbol）接到宿主实现的Win32 API上：
+//   注册表：以规范化的 "dll!symbol"（DLL名小写、去掉.dll后缀）为键的开放寻址哈希表
+//   绑定：加载时遍历导入目录，每个导入分配一个8字节的陷阱桩，IAT项改写为桩地址；
+//         此时只记录名称的RVA，不查注册表、不复制字符串，未调用的导入不产生开销
+//   分派：执行到桩地址时由调用方（Box64Engine的块循环）按地址区间识别，第一次调用才查注册表（原子发布）；
+//         之后按固定步骤转换Win64调用约定（RCX/RDX/R8/R9 + 栈上参数，返回值放RAX，弹出返回地址）
+// 桩的字节为 INT3 "B64" + 槽号，误被解码执行时直接陷入而不是跑飞
+#ifndef BOX64_IMPORTS_H
+#define BOX64_IMPORTS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "Box64Context.h"
+#include "Box64PELoader.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BOX64_THUNK_MAX_ARGS        14      // CreateWindowExA 为12个
+#define BOX64_THUNK_STUB_SIZE       8
+#define BOX64_THUNK_NAME_MAX        128     // 规范化键 "dll!symbol" 的最大长度（含NUL）
+#define BOX64_IMPORTS_MAX           65536   // 单个镜像的导入上限，超过视为损坏
+
+typedef struct Box64ThunkCall {
+    Box64Context *ctx;                      // 客户机寄存器与地址空间（指针参数经 ctx->mmu 访问）
+    void *user;                             // 注册时给出的宿主对象
+    uint64_t args[BOX64_THUNK_MAX_ARGS];    // 按Win64约定取出的参数，超出 arg_count 的为0
+    bool exit_requested;                    // ExitProcess 一类：返回后停止执行
+    uint64_t return_address;                // box64_imports_prepare 从栈顶读出
+} Box64ThunkCall;
+
+// 返回值写入客户机RAX
+typedef uint64_t (*Box64ThunkFn)(Box64ThunkCall *call);
+
+typedef struct Box64Thunk {
+    const char *key;                        // 规范化的 "dll!symbol"，由注册表持有
+    Box64ThunkFn fn;
+    void *user;
+    uint8_t arg_count;
+    uint32_t hash;
+} Box64Thunk;
+
+typedef struct Box64ThunkRegistry Box64ThunkRegistry;
+
+Box64ThunkRegistry *box64_thunk_registry_create(void);
+void box64_thunk_registry_destroy(Box64ThunkRegistry *registry);
+
+// dll 可带或不带 .dll 后缀、大小写不限；symbol 区分大小写，按序号导入的符号写作 "#序号"
+// 重复注册同一个键时覆盖旧的实现
+bool box64_thunk_register(Box64ThunkRegistry *registry, const char *dll, const char *symbol,
+                          Box64ThunkFn fn, uint8_t arg_count, void *user);
+const Box64Thunk *box64_thunk_lookup(const Box64ThunkRegistry *registry, const char *dll, const char *symbol);
+uint32_t box64_thunk_registry_count(const Box64ThunkRegistry *registry);
+
+typedef enum Box64ImportStatus {
+    BOX64_IMPORT_OK = 0,
+    BOX64_IMPORT_BAD_DIRECTORY,             // 导入描述符、名称或IAT超出镜像
+    BOX64_IMPORT_NO_MEMORY,
+    BOX64_IMPORT_STUB_FAILED                // 桩区或IAT项无法写入
+} Box64ImportStatus;
+
+typedef enum Box64ThunkStatus {
+    BOX64_THUNK_OK = 0,                     // 已调用，RIP为返回地址
+    BOX64_THUNK_EXIT,                       // 已调用且请求结束执行
+    BOX64_THUNK_UNRESOLVED,                 // 注册表中没有该导入，客户机状态未改变
+    BOX64_THUNK_FAULT                       // 读取栈上参数或返回地址缺页，客户机状态未改变
+} Box64ThunkStatus;
+
+typedef struct Box64ImportSlot {
+    uint64_t iat_address;                   // IAT项的客户机地址
+    uint32_t dll_rva;                       // DLL名
+    uint32_t name_rva;                      // IMAGE_IMPORT_BY_NAME 中名称的RVA（已跳过hint），按序号导入时为0
+    uint16_t ordinal;
+    _Atomic bool resolve_failed;            // 已经查过注册表但没有找到
+    _Atomic(const Box64Thunk *) thunk;      // 第一次调用时解析，多个线程同时解析时只有一个发布
+    _Atomic uint64_t calls;
+} Box64ImportSlot;
+
+typedef struct Box64ImportTable {
+    const Box64ThunkRegistry *registry;
+    Box64ImportSlot *slots;
+    uint32_t count;
+    uint32_t capacity;
+    uint32_t dll_count;
+    _Atomic uint32_t resolved;              // 已解析的槽数
+    uint64_t image_base;
+    uint8_t entry_size;                     // IAT项宽度：PE32+ 为8，PE32 为4
+    uint64_t stub_base;                     // box64_imports_bind 之后有效
+} Box64ImportTable;
+
+void box64_imports_init(Box64ImportTable *table, const Box64ThunkRegistry *registry);
+void box64_imports_destroy(Box64ImportTable *table);
+
+// 从已映射的镜像读取导入目录，为每个导入建立槽位；不修改客户机内存
+Box64ImportStatus box64_imports_scan(Box64ImportTable *table, Box64MMU *mmu, const Box64PEImage *image);
+
+// 桩区需要 count * BOX64_THUNK_STUB_SIZE 字节的可写映射；写入桩并把IAT项改为桩地址
+// IAT所在页通常已是只读，按Windows加载器的做法绕过页权限写入
+Box64ImportStatus box64_imports_bind(Box64ImportTable *table, Box64MMU *mmu, uint64_t stub_base);
+
+static inline uint64_t box64_imports_stub_size(const Box64ImportTable *table) {
+    return (uint64_t)table->count * BOX64_THUNK_STUB_SIZE;
+}
+
+static inline bool box64_imports_contains(const Box64ImportTable *table, uint64_t rip) {
+    return table->count != 0 && rip - table->stub_base < box64_imports_stub_size(table);
+}
+
+// 多线程分派：导入表只能在没有线程执行 prepare 时销毁、重新扫描或绑定（由调用方的锁保证，
+// Box64Engine 用 codeGate）。桩可能阻塞，所以分两步：
+//   prepare 解析槽位、计数并读取参数，返回 BOX64_THUNK_OK 时填好 call 和 thunk，客户机状态未改变
+//   call 调用桩并写回 RAX/RSP/RIP，只用注册表持有的 thunk 和 call，不再访问导入表，可以在锁外进行
+// rip 必须满足 box64_imports_contains；slot 返回对应槽位（可为NULL）
+Box64ThunkStatus box64_imports_prepare(Box64ImportTable *table, Box64Context *ctx, uint64_t rip,
+                                       Box64ThunkCall *call, const Box64Thunk **thunk, const Box64ImportSlot **slot);
+Box64ThunkStatus box64_imports_call(const Box64Thunk *thunk, Box64ThunkCall *call);
+
+// prepare + call，单线程使用
+Box64ThunkStatus box64_imports_dispatch(Box64ImportTable *table, Box64Context *ctx, uint64_t rip,
+                                        const Box64ImportSlot **slot);
+
+// "dll!symbol" 或 "dll!#序号"，用于日志；名称不可读时写入 "?"
+void box64_imports_describe(const Box64ImportTable *table, Box64MMU *mmu, const Box64ImportSlot *slot,
+                            char *buffer, size_t size);
+
+// 读取客户机NUL结尾字符串（宿主thunk转换 LPCSTR 参数用），超长截断；缺页返回false
+bool box64_thunk_read_string(Box64MMU *mmu, uint64_t address, char *buffer, size_t size);
+
+const char *box64_import_status_string(Box64ImportStatus status);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BOX64_IMPORTS_H
@@ -0,0 +1,865 @@
+// Box64Interp.c - 线程化代码解释器实现
+// 每个处理函数是 box64_interp_run 内的一个标签，末尾的 NEXT() 直接跳到下一条指令的处理函数，
+// 分支预测器按“上一个处理函数 → 下一个处理函数”分别学习，不共用一个 switch 跳转点
+// 编号与标签由同一张表生成；不支持计算跳转的编译器退化为 switch 分派
+#include "Box64Interp.h"
+#include "Box64SSE.h"
+#include "Box64String.h"
+#include "Box64X87.h"
+#include "Box64Trace.h"
+#include <string.h>
+
+// MARK: - 处理函数表
+
+// 常见的32/64位 ALU 形式单独特化：名称、ALU子操作、运算符、标志类型、是否写回
+#define BOX64_FAST_ALU(X) \
+    X(ADD, 0, +, BOX64_FLAGS_ADD,   1) \
+    X(OR,  1, |, BOX64_FLAGS_LOGIC, 1) \
+    X(AND, 4, &, BOX64_FLAGS_LOGIC, 1) \
+    X(SUB, 5, -, BOX64_FLAGS_SUB,   1) \
+    X(XOR, 6, ^, BOX64_FLAGS_LOGIC, 1) \
+    X(CMP, 7, -, BOX64_FLAGS_SUB,   0)
+
+#define BOX64_INTERP_HANDLERS(X) \
+    X(FALLBACK) X(NOP) X(RET) \
+    X(MOV_RR64) X(MOV_RR32) X(MOV_RR) X(MOV_RI) X(MOV_RI_MERGE) \
+    X(LOAD) X(STORE) X(STORE_IMM) X(LEA) \
+    X(ALU_RR) X(ALU_RI) X(ALU_RM) X(ALU_MR) X(ALU_MI) \
+    X(INCDEC_R) X(INCDEC_M) X(XCHG) X(PUSH) X(POP) \
+    X(TEST_RR) X(TEST_RI) X(TEST_MR) X(SHIFT_R) X(SHIFT_M) \
+    X(IMUL_R) X(IMUL_M) X(MOVX_R) X(MOVX_M) \
+    X(JCC) X(JMP) X(LOOP) X(JRCXZ) \
+    X(SETCC_R) X(SETCC_M) X(CMOV_R) X(CMOV_M) \
+    X(SSE) X(X87) X(STRING) X(SETDF)
+
+#define HANDLER_ID(name) OP_##name,
+#define FAST_ALU_ID(name, alu, oper, flag, write) OP_##name##_RR64, OP_##name##_RR32, OP_##name##_RI64, OP_##name##_RI32,
+
+enum {
+    BOX64_INTERP_HANDLERS(HANDLER_ID)
+    BOX64_FAST_ALU(FAST_ALU_ID)
+    OP_COUNT
+};
+
+// 特化形式的起始编号，依次为 RR64 / RR32 / RI64 / RI32；0 表示该子操作（ADC/SBB）没有特化
+#define FAST_ALU_BASE(name, alu, oper, flag, write) [alu] = OP_##name##_RR64,
+static const uint8_t fast_alu_base[8] = { BOX64_FAST_ALU(FAST_ALU_BASE) };
+
+enum {
+    FAST_RR64 = 0,
+    FAST_RR32,
+    FAST_RI64,
+    FAST_RI32
+};
+
+#define REG_RAX 0
+#define REG_RCX 1
+
+#define SHIFT_BY_CL     0x80    // SHIFT_*：aux 的低3位是组内子操作，计数取 CL 而不是 imm
+#define IMUL_BY_IMM     1       // IMUL_*：aux 为1时是三操作数形式 r, r/m, imm
+#define MOVX_SIGNED     0x80    // MOVX_*：aux 的低4位是目的宽度，size 是源宽度
+
+// MARK: - 预解码
+
+static uint8_t select_alu_reg(Box64ThreadedOp *op, uint8_t alu, uint8_t dst, uint8_t src) {
+    op->aux = alu;
+    op->dst = dst;
+    op->src = src;
+    if (fast_alu_base[alu] && op->size >= 4) {
+        return (uint8_t)(fast_alu_base[alu] + (op->size == 8 ? FAST_RR64 : FAST_RR32));
+    }
+    return OP_ALU_RR;
+}
+
+static uint8_t select_alu_imm(Box64ThreadedOp *op, uint8_t alu, uint8_t dst, int64_t imm) {
+    op->aux = alu;
+    op->dst = dst;
+    op->imm = (uint64_t)imm & box64_size_mask(op->size);
+    if (fast_alu_base[alu] && op->size >= 4) {
+        return (uint8_t)(fast_alu_base[alu] + (op->size == 8 ? FAST_RI64 : FAST_RI32));
+    }
+    return OP_ALU_RI;
+}
+
+// MOV reg, imm：32/64位是整寄存器写（预先完成零扩展），8/16位需要合并
+static uint8_t select_mov_imm(Box64ThreadedOp *op, uint8_t dst, int64_t imm) {
+    op->dst = dst;
+    if (op->size >= 4) {
+        op->imm = box64_merge_gpr(0, (uint64_t)imm, op->size);
+        return OP_MOV_RI;
+    }
+    op->imm = (uint64_t)imm;
+    return OP_MOV_RI_MERGE;
+}
+
+// 语义与 Box64Engine 的逐条执行路径一致；返回 OP_FALLBACK 的指令交给调用方
+static uint8_t select_handler(const X86DecodedInsn *insn, Box64ThreadedOp *op, uint64_t next_address) {
+    const bool memory = x86_insn_is_memory(insn);
+    const uint64_t target = next_address + (uint64_t)insn->imm;
+
+    if (insn->flags & X86_INSN_UNSAFE) {
+        return OP_FALLBACK;
+    }
+    // FS/GS 段基址（TLS）尚未建模
+    if (memory && (insn->segment == 0x64 || insn->segment == 0x65)) {
+        return OP_FALLBACK;
+    }
+
+    // MOVZX/MOVSX/MOVSXD
+    bool sign;
+    const uint8_t source_size = box64_extend_source_size(insn, &sign);
+    if (source_size) {
+        op->dst = insn->reg;
+        op->src = insn->rm;
+        op->aux = (uint8_t)((sign ? MOVX_SIGNED : 0) | op->size);
+        op->size = source_size;
+        return memory ? OP_MOVX_M : OP_MOVX_R;
+    }
+
+    if (insn->map == X86_MAP_PRIMARY) {
+        const uint8_t opcode = insn->opcode;
+
+        if (opcode < 0x40 && (opcode & 7) < 6) {
+            const uint8_t alu = opcode >> 3;
+            switch (insn->form) {
+                case X86_FORM_RM_REG:
+                    if (memory) {
+                        op->aux = alu;
+                        op->src = insn->reg;
+                        return OP_ALU_MR;
+                    }
+                    return select_alu_reg(op, alu, insn->rm, insn->reg);
+                case X86_FORM_REG_RM:
+                    if (memory) {
+                        op->aux = alu;
+                        op->dst = insn->reg;
+                        return OP_ALU_RM;
+                    }
+                    return select_alu_reg(op, alu, insn->reg, insn->rm);
+                case X86_FORM_ACC_IMM:
+                    return select_alu_imm(op, alu, REG_RAX, insn->imm);
+                default:
+                    return OP_FALLBACK;
+            }
+        }
+        if (opcode >= 0x70 && opcode <= 0x7F) {
+            op->aux = opcode & 0x0F;
+            op->imm = target;
+            return OP_JCC;
+        }
+
+        switch (opcode) {
+            case 0x50: case 0x51: case 0x52: case 0x53: case 0x54: case 0x55: case 0x56: case 0x57:
+                op->src = insn->reg;
+                return OP_PUSH;
+
+            case 0x58: case 0x59: case 0x5A: case 0x5B: case 0x5C: case 0x5D: case 0x5E: case 0x5F:
+                op->dst = insn->reg;
+                return OP_POP;
+
+            case 0x69: case 0x6B:
+                op->aux = IMUL_BY_IMM;
+                op->dst = insn->reg;
+                op->src = insn->rm;
+                op->imm = (uint64_t)insn->imm;
+                return memory ? OP_IMUL_M : OP_IMUL_R;
+
+            case 0x84: case 0x85:
+                op->src = insn->reg;
+                if (memory) {
+                    return OP_TEST_MR;
+                }
+                op->dst = insn->rm;
+                return OP_TEST_RR;
+
+            case 0xA8: case 0xA9:
+                op->dst = REG_RAX;
+                op->imm = (uint64_t)insn->imm & box64_size_mask(op->size);
+                return OP_TEST_RI;
+
+            case 0xC0: case 0xC1: case 0xD0: case 0xD1: case 0xD2: case 0xD3:
+                op->aux = x86_insn_group_op(insn);
+                if (opcode >= 0xD2) {
+                    op->aux |= SHIFT_BY_CL;
+                } else {
+                    op->imm = opcode >= 0xD0 ? 1 : (uint8_t)insn->imm;
+                }
+                op->dst = insn->rm;
+                return memory ? OP_SHIFT_M : OP_SHIFT_R;
+
+            case 0x90: case 0x91: case 0x92: case 0x93: case 0x94: case 0x95: case 0x96: case 0x97:
+                if (insn->reg == REG_RAX) {
+                    return OP_NOP;
+                }
+                op->dst = REG_RAX;
+                op->src = insn->reg;
+                return OP_XCHG;
+
+            case 0x80: case 0x81: case 0x83:
+                if (memory) {
+                    op->aux = x86_insn_group_op(insn);
+                    op->imm = (uint64_t)insn->imm;
+                    return OP_ALU_MI;
+                }
+                return select_alu_imm(op, x86_insn_group_op(insn), insn->rm, insn->imm);
+
+            case 0x88: case 0x89:
+                op->src = insn->reg;
+                if (memory) {
+                    return OP_STORE;
+                }
+                op->dst = insn->rm;
+                return op->size == 8 ? OP_MOV_RR64 : op->size == 4 ? OP_MOV_RR32 : OP_MOV_RR;
+
+            case 0x8A: case 0x8B:
+                op->dst = insn->reg;
+                if (memory) {
+                    return OP_LOAD;
+                }
+                op->src = insn->rm;
+                return op->size == 8 ? OP_MOV_RR64 : op->size == 4 ? OP_MOV_RR32 : OP_MOV_RR;
+
+            case 0x8D:
+                op->dst = insn->reg;
+                return memory ? OP_LEA : OP_FALLBACK;
+
+            case 0xB0: case 0xB1: case 0xB2: case 0xB3: case 0xB4: case 0xB5: case 0xB6: case 0xB7:
+                op->size = 1;
+                return select_mov_imm(op, insn->reg, insn->imm);
+
+            case 0xB8: case 0xB9: case 0xBA: case 0xBB: case 0xBC: case 0xBD: case 0xBE: case 0xBF:
+                return select_mov_imm(op, insn->reg, insn->imm);
+
+            case 0xC6:
+                if (!memory || x86_insn_group_op(insn) != 0) {
+                    return OP_FALLBACK;
+                }
+                op->size = 1;
+                op->imm = (uint64_t)insn->imm;
+                return OP_STORE_IMM;
+
+            case 0xC7:
+                if (x86_insn_group_op(insn) != 0) {
+                    return OP_FALLBACK;
+                }
+                if (memory) {
+                    op->imm = (uint64_t)insn->imm;
+                    return OP_STORE_IMM;
+                }
+                return select_mov_imm(op, insn->rm, insn->imm);
+
+            case 0xFE: case 0xFF:
+                if (x86_insn_group_op(insn) > 1) {
+                    return OP_FALLBACK;
+                }
+                op->aux = x86_insn_group_op(insn);
+                op->dst = insn->rm;
+                return memory ? OP_INCDEC_M : OP_INCDEC_R;
+
+            case 0xE0: case 0xE1: case 0xE2:
+                op->aux = opcode - 0xE0;
+                op->imm = target;
+                return OP_LOOP;
+
+            case 0xE3:
+                op->imm = target;
+                return OP_JRCXZ;
+
+            case 0xE9: case 0xEB:
+                op->imm = target;
+                return OP_JMP;
+
+            case 0xC2:
+                op->imm = (uint16_t)insn->imm;
+                return OP_RET;
+
+            case 0xC3:
+                return OP_RET;
+
+            case 0xFC: case 0xFD:
+                op->aux = opcode & 1;
+                return OP_SETDF;
+
+            default:
+                if (box64_string_supported(insn)) {
+                    return OP_STRING;
+                }
+                if (box64_x87_supported(insn)) {
+                    op->size = box64_x87_memory_size(insn);
+                    return OP_X87;
+                }
+                return OP_FALLBACK;
+        }
+    }
+
+    if (insn->map == X86_MAP_0F) {
+        const uint8_t opcode = insn->opcode;
+        if (opcode >= 0x80 && opcode <= 0x8F) {
+            op->aux = opcode & 0x0F;
+            op->imm = target;
+            return OP_JCC;
+        }
+        if (opcode >= 0x18 && opcode <= 0x1F) {
+            return OP_NOP;
+        }
+        if (opcode >= 0x90 && opcode <= 0x9F) {
+            op->aux = opcode & 0x0F;
+            op->dst = insn->rm;
+            op->size = 1;
+            return memory ? OP_SETCC_M : OP_SETCC_R;
+        }
+        if (opcode >= 0x40 && opcode <= 0x4F) {
+            op->aux = opcode & 0x0F;
+            op->dst = insn->reg;
+            op->src = insn->rm;
+            return memory ? OP_CMOV_M : OP_CMOV_R;
+        }
+        if (opcode == 0xAF) {
+            op->dst = insn->reg;
+            op->src = insn->rm;
+            return memory ? OP_IMUL_M : OP_IMUL_R;
+        }
+        const Box64SseOp sse = box64_sse_classify(insn);
+        if (sse != BOX64_SSE_NONE) {
+            op->aux = (uint8_t)sse;
+            op->size = box64_sse_memory_size(sse, insn);
+            return OP_SSE;
+        }
+    }
+    return OP_FALLBACK;
+}
+
+void box64_interp_prepare(Box64Block *block) {
+    if (block->threaded) {
+        return;
+    }
+    uint32_t offset = 0;
+    for (uint32_t i = 0; i < block->insn_count; i++) {
+        const X86DecodedInsn *insn = &block->insns[i];
+        Box64ThreadedOp *op = &block->ops[i];
+        memset(op, 0, sizeof(*op));
+        op->offset = (uint16_t)offset;
+        op->size = insn->operand_size;
+        op->has_rex = insn->rex != 0;
+        offset += insn->length;
+        op->handler = select_handler(insn, op, block->guest_start + offset);
+    }
+    block->threaded = true;
+}
+
+bool box64_interp_insn_supported(const X86DecodedInsn *insn) {
+    Box64ThreadedOp op;
+    memset(&op, 0, sizeof(op));
+    op.size = insn->operand_size;
+    return select_handler(insn, &op, 0) != OP_FALLBACK;
+}
+
+// MARK: - 块边界
+
+// 只沿已链接的直接后继继续：目标块必须仍有效、在允许范围内、不是本机代码块、不是马上要编译的块，
+// 且块边界的安全条件（栈指针在栈内、RIP不在低地址）成立、没有写者在等翻译缓存；否则交回调用方
+static Box64Block *chain_successor(Box64Context *ctx, const Box64InterpBounds *bounds, Box64Block *block,
+                                   uint64_t next_rip) {
+    if (!bounds->cache || next_rip < bounds->code_start || next_rip >= bounds->code_end ||
+        next_rip < MIN_VALID_ADDRESS || (bounds->safepoint && box64_rwlock_writer_pending(bounds->safepoint))) {
+        return NULL;
+    }
+    box64_mmu_sync(&ctx->mmu);
+    const uint64_t rsp = ctx->x86_regs[BOX64_INTERP_REG_RSP];
+    if (rsp < ctx->stack_base || rsp >= ctx->stack_base + ctx->stack_size) {
+        return NULL;
+    }
+    const Box64BlockEdge edge = next_rip == block->successor_rip[BOX64_EDGE_FALLTHROUGH]
+        ? BOX64_EDGE_FALLTHROUGH : BOX64_EDGE_TAKEN;
+    const Box64Block *peek = block->successor[edge];
+    if (!peek || !peek->valid || peek->guest_start != next_rip || peek->native_code ||
+        box64_block_is_hot(peek, atomic_load_explicit(&peek->exec_count, memory_order_relaxed) + 1,
+                           bounds->jit_threshold)) {
+        return NULL;
+    }
+    Box64Block *next = box64_tc_follow(bounds->cache, block, edge, next_rip);
+    if (next) {
+        box64_block_count_exec(next);
+    }
+    return next;
+}
+
+// MARK: - 执行
+
+#if defined(__GNUC__) && !defined(__clang__)
+// GCC 默认会把各处理函数末尾相同的分派序列合并成一处（crossjumping），退化为单一间接跳转
+#pragma GCC optimize("no-crossjumping", "no-gcse")
+#endif
+
+Box64InterpExit box64_interp_run(Box64Context *ctx, const Box64InterpBounds *bounds, Box64Block *block,
+                                 uint32_t first, Box64InterpResult *result) {
+#if defined(__GNUC__)
+#define HANDLER_LABEL(name) [OP_##name] = &&op_##name,
+#define FAST_ALU_LABEL(name, alu, oper, flag, write) \
+    [OP_##name##_RR64] = &&op_##name##_RR64, [OP_##name##_RR32] = &&op_##name##_RR32, \
+    [OP_##name##_RI64] = &&op_##name##_RI64, [OP_##name##_RI32] = &&op_##name##_RI32,
+    static const void *const dispatch_table[OP_COUNT] = {
+        BOX64_INTERP_HANDLERS(HANDLER_LABEL)
+        BOX64_FAST_ALU(FAST_ALU_LABEL)
+    };
+#define DISPATCH_HANDLER() goto *dispatch_table[op->handler]
+#else
+#define DISPATCH_HANDLER() goto dispatch_switch
+#endif
+
+    uint64_t *const regs = ctx->x86_regs;
+    Box64TraceRing *const ring = atomic_load_explicit(&box64_trace_active_ring, memory_order_acquire);
+    const Box64ThreadedOp *ops;
+    const Box64ThreadedOp *op = NULL;
+    uint32_t i;
+    uint32_t stop;
+    uint64_t next_rip = 0;
+    uint64_t address = 0;
+
+    memset(result, 0, sizeof(*result));
+
+// 预算检查只有一次比较；跟踪环在进入时读取一次，关闭时不再访问全局状态
+#define DISPATCH() do { \
+    if (i == stop) goto block_stop; \
+    op = &ops[i]; \
+    if (ring) { \
+        const X86DecodedInsn *traced = &block->insns[i]; \
+        box64_trace_ring_record(ring, BOX64_TRACE_INSN, block->guest_start + op->offset, \
+                                (uint16_t)(traced->map << 8 | traced->opcode), traced->length, 0); \
+    } \
+    DISPATCH_HANDLER(); \
+} while (0)
+#define NEXT() do { i++; DISPATCH(); } while (0)
+#define INSN_ADDRESS()  (block->guest_start + op->offset)
+#define NEXT_ADDRESS()  (INSN_ADDRESS() + block->insns[i].length)
+#define EA()            box64_effective_address(ctx, &block->insns[i], NEXT_ADDRESS())
+#define READ(reg)       box64_read_gpr(ctx, (reg), op->size, op->has_rex)
+#define WRITE(reg, v)   box64_write_gpr(ctx, (reg), (v), op->size, op->has_rex)
+#define LOAD(addr, out) do { address = (addr); if (!box64_mmu_load(&ctx->mmu, address, op->size, (out))) goto fault; } while (0)
+#define STORE(addr, v)  do { address = (addr); if (!box64_mmu_store(&ctx->mmu, address, op->size, (v))) goto fault; } while (0)
+// 读-改-写的内存操作数：计算（会改标志）之前先确认可写，缺页时寄存器和标志都保持指令执行前的状态
+#define LOAD_RMW(addr, out) do { \
+    LOAD(addr, out); \
+    if (!box64_mmu_translate(&ctx->mmu, address, op->size, BOX64_ACCESS_WRITE) && \
+        !(box64_mmu_crosses_page(address, op->size) && box64_mmu_check(&ctx->mmu, address, op->size, BOX64_ACCESS_WRITE))) { \
+        goto fault; \
+    } \
+} while (0)
+#define BRANCH(target)  do { next_rip = (target); i++; goto block_end; } while (0)
+
+enter_block:
+    if (!block->threaded) {
+        box64_interp_prepare(block);
+    }
+    ops = block->ops;
+    i = first;
+    {
+        const uint32_t remaining = bounds->max_instructions > ctx->instruction_count
+            ? bounds->max_instructions - ctx->instruction_count : 0;
+        stop = block->insn_count - first <= remaining ? block->insn_count : first + remaining;
+    }
+    DISPATCH();
+
+#if !defined(__GNUC__)
+dispatch_switch:
+#define HANDLER_CASE(name) case OP_##name: goto op_##name;
+#define FAST_ALU_CASE(name, alu, oper, flag, write) \
+    case OP_##name##_RR64: goto op_##name##_RR64; case OP_##name##_RR32: goto op_##name##_RR32; \
+    case OP_##name##_RI64: goto op_##name##_RI64; case OP_##name##_RI32: goto op_##name##_RI32;
+    switch (op->handler) {
+        BOX64_INTERP_HANDLERS(HANDLER_CASE)
+        BOX64_FAST_ALU(FAST_ALU_CASE)
+        default: goto op_FALLBACK;
+    }
+#endif
+
+// MARK: 特化的 ALU
+
+#define FAST_ALU_HANDLERS(name, alu, oper, flag, write) \
+op_##name##_RR64: { \
+    const uint64_t dst = regs[op->dst], src = regs[op->src]; \
+    const uint64_t value = dst oper src; \
+    box64_flags_record(ctx, flag, dst, src, value, 8); \
+    if (write) regs[op->dst] = value; \
+    NEXT(); \
+} \
+op_##name##_RR32: { \
+    const uint64_t dst = (uint32_t)regs[op->dst], src = (uint32_t)regs[op->src]; \
+    const uint64_t value = (uint32_t)(dst oper src); \
+    box64_flags_record(ctx, flag, dst, src, value, 4); \
+    if (write) regs[op->dst] = value; \
+    NEXT(); \
+} \
+op_##name##_RI64: { \
+    const uint64_t dst = regs[op->dst]; \
+    const uint64_t value = dst oper op->imm; \
+    box64_flags_record(ctx, flag, dst, op->imm, value, 8); \
+    if (write) regs[op->dst] = value; \
+    NEXT(); \
+} \
+op_##name##_RI32: { \
+    const uint64_t dst = (uint32_t)regs[op->dst]; \
+    const uint64_t value = (uint32_t)(dst oper op->imm); \
+    box64_flags_record(ctx, flag, dst, op->imm, value, 4); \
+    if (write) regs[op->dst] = value; \
+    NEXT(); \
+}
+
+    BOX64_FAST_ALU(FAST_ALU_HANDLERS)
+
+// MARK: 通用形式
+
+op_NOP:
+    NEXT();
+
+op_MOV_RR64:
+    regs[op->dst] = regs[op->src];
+    NEXT();
+
+op_MOV_RR32:
+    regs[op->dst] = (uint32_t)regs[op->src];
+    NEXT();
+
+op_MOV_RR:
+    WRITE(op->dst, READ(op->src));
+    NEXT();
+
+op_MOV_RI:
+    regs[op->dst] = op->imm;
+    NEXT();
+
+op_MOV_RI_MERGE:
+    WRITE(op->dst, op->imm);
+    NEXT();
+
+op_LOAD: {
+    uint64_t value;
+    LOAD(EA(), &value);
+    WRITE(op->dst, value);
+    NEXT();
+}
+
+op_STORE:
+    STORE(EA(), READ(op->src));
+    NEXT();
+
+op_STORE_IMM:
+    STORE(EA(), op->imm);
+    NEXT();
+
+op_LEA:
+    WRITE(op->dst, EA());
+    NEXT();
+
+op_ALU_RR: {
+    const uint64_t value = box64_alu_compute(ctx, op->aux, READ(op->dst), READ(op->src), op->size);
+    if (op->aux != 7) {
+        WRITE(op->dst, value);
+    }
+    NEXT();
+}
+
+op_ALU_RI: {
+    const uint64_t value = box64_alu_compute(ctx, op->aux, READ(op->dst), op->imm, op->size);
+    if (op->aux != 7) {
+        WRITE(op->dst, value);
+    }
+    NEXT();
+}
+
+op_ALU_RM: {
+    uint64_t src;
+    LOAD(EA(), &src);
+    const uint64_t value = box64_alu_compute(ctx, op->aux, READ(op->dst), src, op->size);
+    if (op->aux != 7) {
+        WRITE(op->dst, value);
+    }
+    NEXT();
+}
+
+op_ALU_MR:
+op_ALU_MI: {
+    uint64_t dst;
+    if (op->aux != 7) {
+        LOAD_RMW(EA(), &dst);
+    } else {
+        LOAD(EA(), &dst);
+    }
+    const uint64_t src = op->handler == OP_ALU_MR ? READ(op->src) : op->imm;
+    const uint64_t value = box64_alu_compute(ctx, op->aux, dst, src, op->size);
+    if (op->aux != 7) {
+        STORE(address, value);
+    }
+    NEXT();
+}
+
+op_INCDEC_R: {
+    const uint64_t dst = READ(op->dst);
+    const uint64_t value = (op->aux == 0 ? dst + 1 : dst - 1) & box64_size_mask(op->size);
+    box64_flags_record_incdec(ctx, op->aux == 0, dst, value, op->size);
+    WRITE(op->dst, value);
+    NEXT();
+}
+
+op_INCDEC_M: {
+    uint64_t dst;
+    LOAD_RMW(EA(), &dst);
+    const uint64_t value = (op->aux == 0 ? dst + 1 : dst - 1) & box64_size_mask(op->size);
+    box64_flags_record_incdec(ctx, op->aux == 0, dst, value, op->size);
+    STORE(address, value);
+    NEXT();
+}
+
+op_XCHG: {
+    const uint64_t a = READ(op->dst);
+    const uint64_t b = READ(op->src);
+    WRITE(op->dst, b);
+    WRITE(op->src, a);
+    NEXT();
+}
+
+// 栈指针只在块边界检查；缺页时 RSP 不变
+op_PUSH: {
+    const uint64_t rsp = regs[BOX64_INTERP_REG_RSP] - op->size;
+    STORE(rsp, READ(op->src));
+    regs[BOX64_INTERP_REG_RSP] = rsp;
+    NEXT();
+}
+
+// POP RSP 以弹出的值为准：先调整栈指针再写目的寄存器
+op_POP: {
+    uint64_t value;
+    LOAD(regs[BOX64_INTERP_REG_RSP], &value);
+    regs[BOX64_INTERP_REG_RSP] += op->size;
+    WRITE(op->dst, value);
+    NEXT();
+}
+
+op_TEST_RR:
+op_TEST_RI:
+op_TEST_MR: {
+    uint64_t dst;
+    if (op->handler == OP_TEST_MR) {
+        LOAD(EA(), &dst);
+    } else {
+        dst = READ(op->dst);
+    }
+    const uint64_t src = op->handler == OP_TEST_RI ? op->imm : READ(op->src);
+    box64_flags_record(ctx, BOX64_FLAGS_LOGIC, dst, src, dst & src, op->size);
+    NEXT();
+}
+
+op_SHIFT_R:
+op_SHIFT_M: {
+    const uint8_t count = (op->aux & SHIFT_BY_CL) ? (uint8_t)regs[REG_RCX] : (uint8_t)op->imm;
+    uint64_t dst;
+    if (op->handler == OP_SHIFT_M) {
+        LOAD_RMW(EA(), &dst);
+        STORE(address, box64_shift_compute(ctx, op->aux & 7, dst, count, op->size));
+    } else {
+        WRITE(op->dst, box64_shift_compute(ctx, op->aux & 7, READ(op->dst), count, op->size));
+    }
+    NEXT();
+}
+
+op_IMUL_R:
+op_IMUL_M: {
+    uint64_t src;
+    if (op->handler == OP_IMUL_M) {
+        LOAD(EA(), &src);
+    } else {
+        src = READ(op->src);
+    }
+    const uint64_t factor = op->aux == IMUL_BY_IMM ? op->imm : READ(op->dst);
+    WRITE(op->dst, box64_imul_compute(ctx, src, factor, op->size));
+    NEXT();
+}
+
+// size 是源宽度（读取和缺页按它），目的宽度在 aux 里
+op_MOVX_R:
+op_MOVX_M: {
+    uint64_t value;
+    if (op->handler == OP_MOVX_M) {
+        LOAD(EA(), &value);
+    } else {
+        value = READ(op->src);
+    }
+    if (op->aux & MOVX_SIGNED) {
+        value = (uint64_t)box64_sign_extend(value, op->size);
+    }
+    box64_write_gpr(ctx, op->dst, value, op->aux & 0x0F, op->has_rex);
+    NEXT();
+}
+
+op_SETCC_R:
+    WRITE(op->dst, box64_flags_condition(ctx, op->aux));
+    NEXT();
+
+op_SETCC_M:
+    STORE(EA(), box64_flags_condition(ctx, op->aux));
+    NEXT();
+
+// 内存源无论条件是否成立都会读取；条件不成立时32位形式仍会清零高32位
+op_CMOV_R:
+op_CMOV_M: {
+    uint64_t src;
+    if (op->handler == OP_CMOV_M) {
+        LOAD(EA(), &src);
+    } else {
+        src = READ(op->src);
+    }
+    WRITE(op->dst, box64_flags_condition(ctx, op->aux) ? src : READ(op->dst));
+    NEXT();
+}
+
+// MARK: SSE
+
+// 未对齐的16字节操作数交给逐条执行路径报告 #GP
+op_SSE: {
+    const Box64SseStatus status = box64_sse_execute(ctx, &block->insns[i], (Box64SseOp)op->aux,
+                                                    NEXT_ADDRESS(), &address);
+    if (status == BOX64_SSE_FAULT) {
+        goto fault;
+    }
+    if (status != BOX64_SSE_OK) {
+        goto op_FALLBACK;
+    }
+    NEXT();
+}
+
+// MARK: x87
+
+op_X87: {
+    const Box64X87Status status = box64_x87_execute(ctx, &block->insns[i], NEXT_ADDRESS(), &address);
+    if (status == BOX64_X87_FAULT) {
+        goto fault;
+    }
+    if (status != BOX64_X87_OK) {
+        goto op_FALLBACK;
+    }
+    NEXT();
+}
+
+// MARK: 字符串
+
+// REP 形式整段执行，缺页时 RSI/RDI/RCX 已反映完成的部分
+op_STRING: {
+    const Box64StringStatus status = box64_string_execute(ctx, &block->insns[i], &address);
+    if (status == BOX64_STRING_FAULT) {
+        goto fault;
+    }
+    if (status != BOX64_STRING_OK) {
+        goto op_FALLBACK;
+    }
+    NEXT();
+}
+
+op_SETDF:
+    if (op->aux) {
+        ctx->rflags |= X86_FLAG_DF;
+    } else {
+        ctx->rflags &= ~(uint64_t)X86_FLAG_DF;
+    }
+    NEXT();
+
+// MARK: 控制流（都是块的最后一条指令）
+
+op_JCC:
+    BRANCH(box64_flags_condition(ctx, op->aux) ? op->imm : NEXT_ADDRESS());
+
+op_JMP:
+    BRANCH(op->imm);
+
+op_LOOP: {
+    const uint64_t count = regs[REG_RCX] - 1;
+    regs[REG_RCX] = count;
+    // LOOPE/LOOPNE 读 ZF（条件码 E=4 / NE=5），LOOP 不读标志
+    const bool taken = count != 0 && (op->aux == 2 || box64_flags_condition(ctx, op->aux == 1 ? 0x4 : 0x5));
+    BRANCH(taken ? op->imm : NEXT_ADDRESS());
+}
+
+op_JRCXZ:
+    BRANCH(regs[REG_RCX] == 0 ? op->imm : NEXT_ADDRESS());
+
+// 返回地址由调用方弹出，RET imm16 额外释放的字节数随结果带回
+op_RET:
+    ctx->rip = NEXT_ADDRESS();
+    result->last_rip = INSN_ADDRESS();
+    result->stack_release = (uint16_t)op->imm;
+    ctx->instruction_count += i + 1 - first;
+    result->exit = BOX64_INTERP_RETURN;
+    result->index = i;
+    result->block = block;
+    return BOX64_INTERP_RETURN;
+
+// MARK: 退出
+
+op_FALLBACK:
+    ctx->rip = INSN_ADDRESS();
+    ctx->instruction_count += i - first;
+    if (i > first) {
+        result->last_rip = block->guest_start + ops[i - 1].offset;
+    }
+    result->exit = BOX64_INTERP_FALLBACK;
+    result->index = i;
+    result->block = block;
+    return BOX64_INTERP_FALLBACK;
+
+// 出错指令没有提交任何状态（REP 字符串只提交了已完成的元素），RIP 指向它以便处理缺页后重新执行
+fault:
+    ctx->rip = INSN_ADDRESS();
+    ctx->instruction_count += i - first;
+    result->last_rip = INSN_ADDRESS();
+    result->exit = BOX64_INTERP_FAULT;
+    result->index = i;
+    result->block = block;
+    result->fault_address = address;
+    result->fault_size = op->size;
+    return BOX64_INTERP_FAULT;
+
+block_stop:
+    if (stop == block->insn_count) {
+        next_rip = block->guest_end;
+        goto block_end;
+    }
+    ctx->rip = block->guest_start + ops[i].offset;
+    ctx->instruction_count += i - first;
+    if (i > first) {
+        result->last_rip = block->guest_start + ops[i - 1].offset;
+    }
+    result->exit = BOX64_INTERP_LIMIT;
+    result->index = i;
+    result->block = block;
+    return BOX64_INTERP_LIMIT;
+
+block_end: {
+    ctx->rip = next_rip;
+    ctx->instruction_count += i - first;
+    if (i > first) {
+        result->last_rip = block->guest_start + ops[i - 1].offset;
+    }
+    Box64Block *next = chain_successor(ctx, bounds, block, next_rip);
+    if (next) {
+        block = next;
+        first = 0;
+        goto enter_block;
+    }
+    result->exit = BOX64_INTERP_BLOCK_END;
+    result->index = block->insn_count;
+    result->block = block;
+    return BOX64_INTERP_BLOCK_END;
+}
+
+#undef DISPATCH
+#undef DISPATCH_HANDLER
+#undef NEXT
+#undef INSN_ADDRESS
+#undef NEXT_ADDRESS
+#undef EA
+#undef READ
+#undef WRITE
+#undef LOAD
+#undef STORE
+#undef LOAD_RMW
+#undef BRANCH
+}
@@ -0,0 +1,284 @@
+// Box64Interp.h - 线程化代码（threaded code）解释器
+// 纯C实现，是JIT之外的快速解释层：
+//   块第一次解释执行时预解码为“处理函数编号 + 已解析操作数”的数组（Box64ThreadedOp），
+//   之后按数组用计算跳转（computed goto）分派，每个处理函数末尾各自跳到下一条
+//   寄存器直接读写 Box64Context，安全检查（栈指针、RIP范围、指令预算）只在块边界做
+//   块尾沿翻译缓存中已链接的后继直接进入下一块，不回到 Box64Engine
+// 快速层不支持的指令（系统指令、FS/GS访存、未建模的操作码）以 BOX64_INTERP_FALLBACK 退出，
+// 由调用方逐条处理后从下一条继续
+// 多线程：块和翻译缓存只读；预解码在 box64_interp_prepare 中由持有翻译缓存写锁的一方完成，
+// bounds->safepoint 上有写者等待时不再链接，以 BLOCK_END 返回让调用方释放读锁
+#ifndef BOX64_INTERP_H
+#define BOX64_INTERP_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "Box64Context.h"
+#include "Box64Flags.h"
+#include "Box64TranslationCache.h"
+#include "Box64Sync.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BOX64_INTERP_REG_RSP 4
+
+// 退出原因
+typedef enum Box64InterpExit {
+    BOX64_INTERP_BLOCK_END = 0,     // 块正常结束且无法继续链接，ctx->rip 为下一块地址
+    BOX64_INTERP_FALLBACK,          // 遇到快速层不支持的指令，ctx->rip 指向该指令（未执行）
+    BOX64_INTERP_RETURN,            // 执行了RET，ctx->rip 为其后的地址
+    BOX64_INTERP_LIMIT,             // 指令预算用完，ctx->rip 指向下一条未执行的指令
+    BOX64_INTERP_FAULT              // 访存缺页，ctx->rip 指向出错指令（未提交，可重新执行）
+} Box64InterpExit;
+
+// 一次运行的边界条件；块链接只在目标块满足全部条件时发生
+typedef struct Box64InterpBounds {
+    Box64TranslationCache *cache;   // 用于沿后继链接前进，NULL表示只执行传入的块
+    uint64_t code_start;            // 允许执行的客户机代码范围 [code_start, code_end)
+    uint64_t code_end;
+    uint32_t max_instructions;      // 与 ctx->instruction_count 比较的总预算
+    uint32_t jit_threshold;         // 块即将达到或已超过该执行次数且还没编译时退出交给JIT，0表示不使用JIT
+    const Box64RWLock *safepoint;   // 调用方持有读锁的翻译缓存门，NULL表示单线程
+} Box64InterpBounds;
+
+typedef struct Box64InterpResult {
+    Box64InterpExit exit;
+    Box64Block *block;              // 退出时所在的块（可能已沿链接前进）
+    uint32_t index;                 // FALLBACK/LIMIT/FAULT：对应指令在块内的下标
+    uint64_t last_rip;              // 最后一条开始执行的指令地址，未执行任何指令时为0
+    uint64_t fault_address;         // FAULT：出错的客户机地址
+    uint8_t fault_size;
+    uint16_t stack_release;         // RETURN：RET imm16 弹出返回地址后再释放的栈字节数（返回地址由调用方弹出）
+} Box64InterpResult;
+
+// 从 block 的第 first 条指令开始执行；调用方负责 block->exec_count 和本机代码部分
+// 返回后 ctx->x86_regs、rflags/lazy_flags、instruction_count、rip 都已是最新，
+// arm64_regs 镜像不维护，由调用方在需要时同步
+Box64InterpExit box64_interp_run(Box64Context *ctx, const Box64InterpBounds *bounds, Box64Block *block,
+                                 uint32_t first, Box64InterpResult *result);
+
+// 预解码为线程化操作（幂等）；box64_interp_run 遇到未预解码的块时自己做
+void box64_interp_prepare(Box64Block *block);
+
+// 指令是否由快速层直接执行（否则以 FALLBACK 退出）
+bool box64_interp_insn_supported(const X86DecodedInsn *insn);
+
+// MARK: - 共享的指令语义辅助（Box64Engine 的逐条执行路径也使用）
+
+// 按操作数宽度读取通用寄存器（8位寄存器在无REX时4-7表示AH/CH/DH/BH）
+static inline uint64_t box64_read_gpr(const Box64Context *ctx, uint8_t reg, uint8_t size, bool has_rex) {
+    switch (size) {
+        case 1:
+            if (!has_rex && reg >= 4 && reg < 8) {
+                return (ctx->x86_regs[reg - 4] >> 8) & 0xFF;
+            }
+            return ctx->x86_regs[reg] & 0xFF;
+        case 2:
+            return ctx->x86_regs[reg] & 0xFFFF;
+        case 4:
+            return ctx->x86_regs[reg] & 0xFFFFFFFFULL;
+        default:
+            return ctx->x86_regs[reg];
+    }
+}
+
+// 按x86语义合并写回：32位写零扩展，8/16位写保留高位
+static inline uint64_t box64_merge_gpr(uint64_t old, uint64_t value, uint8_t size) {
+    switch (size) {
+        case 1:  return (old & ~0xFFULL) | (value & 0xFF);
+        case 2:  return (old & ~0xFFFFULL) | (value & 0xFFFF);
+        case 4:  return value & 0xFFFFFFFFULL;
+        default: return value;
+    }
+}
+
+// 写回通用寄存器（含AH/CH/DH/BH），不做任何校验
+static inline void box64_write_gpr(Box64Context *ctx, uint8_t reg, uint64_t value, uint8_t size, bool has_rex) {
+    if (size == 1 && !has_rex && reg >= 4 && reg < 8) {
+        ctx->x86_regs[reg - 4] = (ctx->x86_regs[reg - 4] & ~0xFF00ULL) | ((value & 0xFF) << 8);
+        return;
+    }
+    ctx->x86_regs[reg] = box64_merge_gpr(ctx->x86_regs[reg], value, size);
+}
+
+static inline uint64_t box64_size_mask(uint8_t size) {
+    return size >= 8 ? ~0ULL : ((1ULL << (size * 8)) - 1);
+}
+
+// 计算00-3F/80-83组的ALU运算并记录标志，alu_op为 ADD OR ADC SBB AND SUB XOR CMP
+static inline uint64_t box64_alu_compute(Box64Context *ctx, uint8_t alu_op, uint64_t dst, uint64_t src, uint8_t size) {
+    // ALU子操作 → 惰性标志的运算类型
+    static const uint8_t flag_ops[8] = {
+        BOX64_FLAGS_ADD, BOX64_FLAGS_LOGIC, BOX64_FLAGS_ADC, BOX64_FLAGS_SBB,
+        BOX64_FLAGS_LOGIC, BOX64_FLAGS_SUB, BOX64_FLAGS_LOGIC, BOX64_FLAGS_SUB
+    };
+    const uint64_t mask = box64_size_mask(size);
+    const uint64_t carry = (alu_op == 2 || alu_op == 3) ? box64_flags_carry(ctx) : 0;
+    uint64_t result;
+
+    src &= mask;
+    switch (alu_op & 7) {
+        case 0: result = dst + src; break;
+        case 1: result = dst | src; break;
+        case 2: result = dst + src + carry; break;
+        case 3: result = dst - src - carry; break;
+        case 4: result = dst & src; break;
+        case 5: result = dst - src; break;
+        case 6: result = dst ^ src; break;
+        default: result = dst - src; break;
+    }
+    result &= mask;
+    box64_flags_record(ctx, (Box64FlagOp)flag_ops[alu_op & 7], dst, src, result, size);
+    return result;
+}
+
+static inline int64_t box64_sign_extend(uint64_t value, uint8_t size) {
+    if (size >= 8) {
+        return (int64_t)value;
+    }
+    const unsigned shift = 64 - size * 8;
+    return (int64_t)(value << shift) >> shift;
+}
+
+// C0/C1/D0-D3组的移位，group_op为 ROL ROR RCL RCR SHL SHR SAL SAR；标志直接写入 rflags
+// 计数按x86屏蔽（64位取低6位，其余取低5位），屏蔽后为0时结果和标志都不变
+// OF 只对计数1有定义，这里统一按计数1的公式给出；移位的 AF 未定义按0处理，循环移位不改 SF/ZF/PF
+static inline uint64_t box64_shift_compute(Box64Context *ctx, uint8_t group_op, uint64_t dst, uint8_t count,
+                                           uint8_t size) {
+    const uint64_t mask = box64_size_mask(size);
+    const unsigned bits = size * 8u;
+    const uint64_t sign_bit = 1ULL << (bits - 1);
+    dst &= mask;
+    count &= size == 8 ? 0x3F : 0x1F;
+    if (count == 0) {
+        return dst;
+    }
+
+    uint64_t flags = box64_flags_materialize(ctx);
+    bool cf = (flags & X86_FLAG_CF) != 0;
+    bool of;
+    uint64_t result;
+    switch (group_op & 7) {
+        case 0: {  // ROL
+            const unsigned c = count % bits;
+            result = c ? ((dst << c) | (dst >> (bits - c))) & mask : dst;
+            cf = (result & 1) != 0;
+            of = ((result & sign_bit) != 0) != cf;
+            break;
+        }
+        case 1: {  // ROR
+            const unsigned c = count % bits;
+            result = c ? ((dst >> c) | (dst << (bits - c))) & mask : dst;
+            cf = (result & sign_bit) != 0;
+            of = cf != ((result & (sign_bit >> 1)) != 0);
+            break;
+        }
+        case 2:    // RCL / RCR：连同CF共 bits+1 位循环
+        case 3:
+            result = dst;
+            for (unsigned c = count % (bits + 1); c; c--) {
+                if ((group_op & 7) == 2) {
+                    const bool out = (result & sign_bit) != 0;
+                    result = ((result << 1) | (cf ? 1 : 0)) & mask;
+                    cf = out;
+                } else {
+                    const bool out = (result & 1) != 0;
+                    result = (result >> 1) | (cf ? sign_bit : 0);
+                    cf = out;
+                }
+            }
+            of = (group_op & 7) == 2 ? ((result & sign_bit) != 0) != cf
+                                     : ((result & sign_bit) != 0) != ((result & (sign_bit >> 1)) != 0);
+            break;
+        case 5:    // SHR
+            cf = count <= bits && ((dst >> (count - 1)) & 1);
+            result = count < bits ? dst >> count : 0;
+            of = (dst & sign_bit) != 0;
+            break;
+        case 7: {  // SAR
+            const int64_t value = box64_sign_extend(dst, size);
+            cf = ((value >> (count - 1)) & 1) != 0;
+            result = (uint64_t)(value >> count) & mask;
+            of = false;
+            break;
+        }
+        default:   // SHL / SAL
+            cf = count <= bits && ((dst >> (bits - count)) & 1);
+            result = count < bits ? (dst << count) & mask : 0;
+            of = ((result & sign_bit) != 0) != cf;
+            break;
+    }
+
+    if ((group_op & 7) >= 4) {
+        flags = box64_flags_compute(BOX64_FLAGS_LOGIC, result, 0, result, size, flags);
+    }
+    flags &= ~(uint64_t)(X86_FLAG_CF | X86_FLAG_OF);
+    flags |= (cf ? X86_FLAG_CF : 0) | (of ? X86_FLAG_OF : 0);
+    box64_flags_set(ctx, flags);
+    return result;
+}
+
+// IMUL 两/三操作数形式：乘积截断到操作数宽度，有符号溢出时 CF=OF=1；SF/ZF/PF 未定义，按截断结果给出
+static inline uint64_t box64_imul_compute(Box64Context *ctx, uint64_t a, uint64_t b, uint8_t size) {
+    int64_t product;
+    bool overflow;
+    if (size >= 8) {
+        overflow = __builtin_mul_overflow((int64_t)a, (int64_t)b, &product);
+    } else {
+        product = box64_sign_extend(a, size) * box64_sign_extend(b, size);
+        overflow = product != box64_sign_extend((uint64_t)product, size);
+    }
+    const uint64_t result = (uint64_t)product & box64_size_mask(size);
+    uint64_t flags = box64_flags_compute(BOX64_FLAGS_LOGIC, result, 0, result, size, box64_flags_materialize(ctx));
+    if (overflow) {
+        flags |= X86_FLAG_CF | X86_FLAG_OF;
+    }
+    box64_flags_set(ctx, flags);
+    return result;
+}
+
+// MOVZX/MOVSX（0F B6/B7/BE/BF）与 MOVSXD（63）的源操作数宽度，其他指令返回0
+static inline uint8_t box64_extend_source_size(const X86DecodedInsn *insn, bool *sign) {
+    *sign = false;
+    if (insn->map == X86_MAP_PRIMARY) {
+        if (insn->opcode != 0x63) {
+            return 0;
+        }
+        *sign = true;
+        return insn->operand_size < 4 ? insn->operand_size : 4;
+    }
+    if (insn->map != X86_MAP_0F) {
+        return 0;
+    }
+    switch (insn->opcode) {
+        case 0xB6: return 1;
+        case 0xB7: return 2;
+        case 0xBE: *sign = true; return 1;
+        case 0xBF: *sign = true; return 2;
+        default:   return 0;
+    }
+}
+
+// 内存操作数的客户机有效地址：base + index*scale + disp，RIP相对寻址以下一条指令为基准
+static inline uint64_t box64_effective_address(const Box64Context *ctx, const X86DecodedInsn *insn,
+                                               uint64_t next_address) {
+    uint64_t address = (uint64_t)(int64_t)insn->disp;
+    if (insn->flags & X86_INSN_RIP_REL) {
+        address += next_address;
+    } else if (insn->base != X86_REG_NONE) {
+        address += ctx->x86_regs[insn->base];
+    }
+    if (insn->index != X86_REG_NONE) {
+        address += ctx->x86_regs[insn->index] * insn->scale;
+    }
+    return insn->address_size == 4 ? (address & 0xFFFFFFFFULL) : address;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BOX64_INTERP_H
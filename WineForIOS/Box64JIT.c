@@ -0,0 +1,890 @@
+// Box64JIT.c - 基本块编译器实现
+// 栈帧布局（96字节）:
+//   [sp+0]  x29, x30     [sp+16] x19, x20     [sp+32] x21, x22
+//   [sp+48] x23, x24     [sp+64] x25, x26     [sp+80] x27, x28
+// 块内 x27 = Box64Context*，x28 = 入口处已求值的 RFLAGS，x0-x7/x16/x17 为临时寄存器
+// 标志是惰性的：块内只保留最后一条写标志指令的操作数/结果（x2/x3/x4）和它设置的NZCV，
+// 出块时写入 ctx->lazy_flags；紧跟的 Jcc 能用NZCV表示时直接 B.cond（CMP+Jcc 融合）
+// x87（快速模式）：栈槽按块入口的 TOP 编号（槽r = 物理寄存器 (TOP+r)&7），块内压栈/出栈只改编译期的深度，
+// 槽r 整块放在 D16+r，x6 = 入口TOP，x7 = &ctx->x87.st；入口检查失败时不执行任何指令，返回块首交给解释器
+#include "Box64JIT.h"
+#include "ARM64Emitter.h"
+#include "Box64Flags.h"
+
+const uint8_t box64_jit_guest_register_map[16] = {
+    A64_X19, A64_X20, A64_X21, A64_X22, A64_X23, A64_X24, A64_X25, A64_X26,
+    A64_X8,  A64_X9,  A64_X10, A64_X11, A64_X12, A64_X13, A64_X14, A64_X15
+};
+
+#define HOST(reg)       box64_jit_guest_register_map[(reg) & 15]
+#define CTX             A64_X27
+#define FLAGS           A64_X28
+#define FRAME_SIZE      96
+#define GUEST_RSP       4
+
+#define OFF_REG(reg)    ((uint32_t)(offsetof(Box64Context, x86_regs) + (reg) * sizeof(uint64_t)))
+#define OFF_RFLAGS      ((uint32_t)offsetof(Box64Context, rflags))
+#define OFF_ICOUNT      ((uint32_t)offsetof(Box64Context, instruction_count))
+#define OFF_LAZY(field) ((uint32_t)(offsetof(Box64Context, lazy_flags) + offsetof(Box64LazyFlags, field)))
+#define OFF_X87(field)  ((uint32_t)(offsetof(Box64Context, x87) + offsetof(Box64X87, field)))
+
+// x87 块内寄存器
+#define X87_TOP         A64_X6
+#define X87_BASE        A64_X7
+#define X87_VREG(slot)  ((uint8_t)(16 + ((slot) & 7)))
+#define X87_TEMP        0           // D0：FXCH 的中转
+
+// 惰性标志的块内寄存器
+#define LAZY_DST        A64_X2
+#define LAZY_SRC        A64_X3
+#define LAZY_RESULT     A64_X4
+#define LAZY_CF         A64_X5      // INC/DEC 保留的CF
+
+// op 与 size 用一条64位 STR 写入
+_Static_assert(OFF_LAZY(op) % 8 == 0 && OFF_LAZY(size) == OFF_LAZY(op) + 4, "lazy_flags.op/size layout");
+// x87 状态用 LDRB/STRB 与 ADD 立即数访问
+_Static_assert(OFF_X87(extended) <= 0xFFF && OFF_X87(st) <= 0xFFF, "x87 state offset");
+
+// ALU子操作（与 00-3F/80-83 的 /r 编号一致）
+enum { ALU_ADD = 0, ALU_OR, ALU_ADC, ALU_SBB, ALU_AND, ALU_SUB, ALU_XOR, ALU_CMP };
+
+// 单条指令的语义摘要，分析和代码生成共用
+typedef enum JITOpKind {
+    JIT_OP_UNSUPPORTED = 0,
+    JIT_OP_NOP,
+    JIT_OP_MOV_REG,         // dst <- src
+    JIT_OP_MOV_IMM,         // dst <- imm
+    JIT_OP_XCHG,            // dst <-> src
+    JIT_OP_ALU_REG,         // dst = dst op src
+    JIT_OP_ALU_IMM,         // dst = dst op imm
+    JIT_OP_INCDEC,          // dst = dst +/- 1，CF不变
+    JIT_OP_JMP,
+    JIT_OP_JCC,
+    JIT_OP_X87              // 寄存器栈形式，alu = X87_*
+} JITOpKind;
+
+// x87 子操作；dst/src 为 ST(i) 编号
+enum {
+    X87_FLD = 0,            // 压入 ST(src) 的副本
+    X87_FLDC,               // 压入常数（imm = double 位模式）
+    X87_FXCH,               // ST(0) <-> ST(src)
+    X87_FCHS,
+    X87_FABS,
+    X87_FST,                // ST(dst) = ST(0)
+    X87_ARITH               // ST(dst) = ST(dst) op ST(src)，imm = D8 /r 编号（0 ADD 1 MUL 4 SUB 5 SUBR 6 DIV 7 DIVR）
+};
+
+typedef struct JITOp {
+    JITOpKind kind;
+    uint8_t alu;            // ALU_* / INC=ALU_ADD DEC=ALU_SUB / Jcc 条件码
+    uint8_t dst;
+    uint8_t src;
+    bool is64;
+    uint64_t imm;
+    bool pop;               // x87：执行后出栈
+} JITOp;
+
+static bool alu_supported(uint8_t alu) {
+    return alu != ALU_ADC && alu != ALU_SBB;
+}
+
+// x87 寄存器栈形式：FLD/FST(P)/FXCH ST(i)、FLD1/FLDZ、FCHS/FABS 与 D8/DC/DE 的算术；
+// 比较、超越函数和内存形式留给解释器
+static void classify_x87(const X86DecodedInsn *insn, JITOp *op) {
+    const uint8_t r = (insn->modrm >> 3) & 7, i = insn->modrm & 7;
+    op->kind = JIT_OP_X87;
+    switch (insn->opcode) {
+        case 0xD8: case 0xDC: case 0xDE:
+            if (r == 2 || r == 3) {
+                break;
+            }
+            // DC/DE 以 ST(i) 为目的，SUB/SUBR、DIV/DIVR 的 /r 编号与 D8 相反
+            op->alu = X87_ARITH;
+            op->dst = insn->opcode == 0xD8 ? 0 : i;
+            op->src = insn->opcode == 0xD8 ? i : 0;
+            op->imm = (insn->opcode == 0xD8 || r < 4) ? r : (r ^ 1u);
+            op->pop = insn->opcode == 0xDE;
+            return;
+        case 0xD9:
+            switch (insn->modrm) {
+                case 0xE0: op->alu = X87_FCHS; return;
+                case 0xE1: op->alu = X87_FABS; return;
+                case 0xE8: op->alu = X87_FLDC; op->imm = 0x3FF0000000000000ULL; return;
+                case 0xEE: op->alu = X87_FLDC; op->imm = 0; return;
+                default: break;
+            }
+            if (r == 0 || r == 1) {
+                op->alu = r == 0 ? X87_FLD : X87_FXCH;
+                op->src = i;
+                return;
+            }
+            break;
+        case 0xDD:
+            if (r == 2 || r == 3) {
+                op->alu = X87_FST;
+                op->dst = i;
+                op->pop = r == 3;
+                return;
+            }
+            break;
+        default:
+            break;
+    }
+    op->kind = JIT_OP_UNSUPPORTED;
+}
+
+static JITOp classify(const X86DecodedInsn *insn) {
+    JITOp op = { JIT_OP_UNSUPPORTED, 0, 0, 0, false, 0, false };
+    const bool reg_form = !(insn->flags & X86_INSN_MEMORY);
+    const bool wide = insn->operand_size == 4 || insn->operand_size == 8;
+    op.is64 = insn->operand_size == 8;
+
+    if (insn->map == X86_MAP_0F) {
+        if (insn->opcode >= 0x80 && insn->opcode <= 0x8F) {
+            op.kind = JIT_OP_JCC;
+            op.alu = insn->opcode & 0x0F;
+        } else if (insn->opcode >= 0x18 && insn->opcode <= 0x1F) {
+            op.kind = JIT_OP_NOP;
+        }
+        return op;
+    }
+    if (insn->map != X86_MAP_PRIMARY) {
+        return op;
+    }
+
+    const uint8_t opc = insn->opcode;
+    if (opc >= 0x70 && opc <= 0x7F) {
+        op.kind = JIT_OP_JCC;
+        op.alu = opc & 0x0F;
+        return op;
+    }
+    if (opc == 0xE9 || opc == 0xEB) {
+        op.kind = JIT_OP_JMP;
+        return op;
+    }
+    if (opc >= 0xD8 && opc <= 0xDF) {
+        if (reg_form) {
+            classify_x87(insn, &op);
+        }
+        return op;
+    }
+    // 以下只处理32/64位寄存器操作数；8/16位部分写和内存操作数留给解释器
+    if (!wide || !reg_form) {
+        if (opc == 0x90 && insn->reg == 0) {
+            op.kind = JIT_OP_NOP;
+        }
+        return op;
+    }
+
+    if (opc < 0x40 && (opc & 7) < 6) {
+        op.alu = opc >> 3;
+        if (!alu_supported(op.alu)) {
+            return op;
+        }
+        switch (insn->form) {
+            case X86_FORM_RM_REG:
+                op.kind = JIT_OP_ALU_REG; op.dst = insn->rm; op.src = insn->reg;
+                break;
+            case X86_FORM_REG_RM:
+                op.kind = JIT_OP_ALU_REG; op.dst = insn->reg; op.src = insn->rm;
+                break;
+            case X86_FORM_ACC_IMM:
+                op.kind = JIT_OP_ALU_IMM; op.dst = 0; op.imm = (uint64_t)insn->imm;
+                break;
+            default:
+                break;
+        }
+    } else {
+        switch (opc) {
+            case 0x81: case 0x83:
+                op.alu = x86_insn_group_op(insn);
+                if (alu_supported(op.alu)) {
+                    op.kind = JIT_OP_ALU_IMM; op.dst = insn->rm; op.imm = (uint64_t)insn->imm;
+                }
+                break;
+            case 0x89:
+                op.kind = JIT_OP_MOV_REG; op.dst = insn->rm; op.src = insn->reg;
+                break;
+            case 0x8B:
+                op.kind = JIT_OP_MOV_REG; op.dst = insn->reg; op.src = insn->rm;
+                break;
+            case 0x90: case 0x91: case 0x92: case 0x93:
+            case 0x94: case 0x95: case 0x96: case 0x97:
+                if (insn->reg == 0) {
+                    op.kind = JIT_OP_NOP;
+                } else {
+                    op.kind = JIT_OP_XCHG; op.dst = 0; op.src = insn->reg;
+                }
+                break;
+            case 0xB8: case 0xB9: case 0xBA: case 0xBB:
+            case 0xBC: case 0xBD: case 0xBE: case 0xBF:
+                op.kind = JIT_OP_MOV_IMM; op.dst = insn->reg; op.imm = (uint64_t)insn->imm;
+                break;
+            case 0xC7:
+                if (x86_insn_group_op(insn) == 0) {
+                    op.kind = JIT_OP_MOV_IMM; op.dst = insn->rm; op.imm = (uint64_t)insn->imm;
+                }
+                break;
+            case 0xFF:
+                if (x86_insn_group_op(insn) <= 1) {
+                    op.kind = JIT_OP_INCDEC; op.dst = insn->rm;
+                    op.alu = x86_insn_group_op(insn) == 0 ? ALU_ADD : ALU_SUB;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+    if (!op.is64) {
+        op.imm &= 0xFFFFFFFFULL;
+    }
+
+    // RSP写入必须经过 Box64Engine 的栈范围校验，不进入JIT
+    bool writes_dst = op.kind == JIT_OP_MOV_REG || op.kind == JIT_OP_MOV_IMM || op.kind == JIT_OP_XCHG ||
+                      op.kind == JIT_OP_INCDEC || ((op.kind == JIT_OP_ALU_REG || op.kind == JIT_OP_ALU_IMM) && op.alu != ALU_CMP);
+    if (writes_dst && (op.dst == GUEST_RSP || (op.kind == JIT_OP_XCHG && op.src == GUEST_RSP))) {
+        op.kind = JIT_OP_UNSUPPORTED;
+    }
+    return op;
+}
+
+bool box64_jit_insn_supported(const X86DecodedInsn *insn) {
+    return insn && classify(insn).kind != JIT_OP_UNSUPPORTED;
+}
+
+// MARK: - 寄存器分配
+
+// x87 栈槽的编译期状态；槽按块入口的 TOP 编号
+typedef struct JITX87State {
+    uint8_t depth;              // 当前 TOP 相对入口的偏移（模8）
+    uint8_t known_valid;        // 块内已确定非空 / 为空的槽
+    uint8_t known_empty;
+    uint8_t written;
+    uint8_t live_in;
+    uint8_t require_valid;
+    uint8_t require_empty;
+    uint8_t touched;
+} JITX87State;
+
+#define X87_SLOT_BIT(state, i) ((uint8_t)(1u << (((state)->depth + (i)) & 7)))
+
+// 读 ST(i)：未知的槽记为入口时必须非空；已知为空（栈下溢）返回false
+static bool x87_read(JITX87State *state, uint8_t i) {
+    const uint8_t bit = X87_SLOT_BIT(state, i);
+    if (state->known_empty & bit) {
+        return false;
+    }
+    if (!(state->known_valid & bit)) {
+        state->require_valid |= bit;
+        state->known_valid |= bit;
+    }
+    if (!(state->written & bit)) {
+        state->live_in |= bit;
+    }
+    state->touched |= bit;
+    return true;
+}
+
+static void x87_write(JITX87State *state, uint8_t i) {
+    const uint8_t bit = X87_SLOT_BIT(state, i);
+    state->known_valid |= bit;
+    state->known_empty &= (uint8_t)~bit;
+    state->written |= bit;
+    state->touched |= bit;
+}
+
+// 压栈：未知的目标槽记为入口时必须为空；已知非空（栈上溢）返回false
+static bool x87_push(JITX87State *state) {
+    state->depth = (state->depth - 1) & 7;
+    const uint8_t bit = X87_SLOT_BIT(state, 0);
+    if (state->known_valid & bit) {
+        return false;
+    }
+    if (!(state->known_empty & bit)) {
+        state->require_empty |= bit;
+    }
+    x87_write(state, 0);
+    return true;
+}
+
+static void x87_pop(JITX87State *state) {
+    const uint8_t bit = X87_SLOT_BIT(state, 0);
+    state->known_valid &= (uint8_t)~bit;
+    state->known_empty |= bit;
+    state->touched |= bit;
+    state->depth = (state->depth + 1) & 7;
+}
+
+// 会产生栈错误的指令返回false，由解释器执行（它负责置 IE|SF 与不定值）
+static bool x87_step(JITX87State *state, const JITOp *op) {
+    switch (op->alu) {
+        case X87_FLD:
+            if (!x87_read(state, op->src) || !x87_push(state)) {
+                return false;
+            }
+            break;
+        case X87_FLDC:
+            if (!x87_push(state)) {
+                return false;
+            }
+            break;
+        case X87_FXCH:
+            if (!x87_read(state, 0) || !x87_read(state, op->src)) {
+                return false;
+            }
+            x87_write(state, 0);
+            x87_write(state, op->src);
+            break;
+        case X87_FCHS:
+        case X87_FABS:
+            if (!x87_read(state, 0)) {
+                return false;
+            }
+            x87_write(state, 0);
+            break;
+        case X87_FST:
+            if (!x87_read(state, 0)) {
+                return false;
+            }
+            x87_write(state, op->dst);
+            break;
+        default:    // X87_ARITH
+            if (!x87_read(state, op->dst) || !x87_read(state, op->src)) {
+                return false;
+            }
+            x87_write(state, op->dst);
+            break;
+    }
+    if (op->pop) {
+        x87_pop(state);
+    }
+    return true;
+}
+
+uint32_t box64_jit_analyze(const Box64Block *block, Box64JITRegUsage *usage) {
+    Box64JITRegUsage result = { 0 };
+    uint16_t written = 0;
+    bool flags_defined = false;     // 块内已有写标志的指令
+    JITX87State x87 = { 0 };
+
+    for (uint32_t i = 0; block && i < block->insn_count; i++) {
+        JITOp op = classify(&block->insns[i]);
+        if (op.kind == JIT_OP_UNSUPPORTED) {
+            break;
+        }
+        if (op.kind == JIT_OP_X87) {
+            JITX87State next = x87;
+            if (!x87_step(&next, &op)) {
+                break;
+            }
+            x87 = next;
+        }
+
+        uint16_t reads = 0, writes = 0;
+        switch (op.kind) {
+            case JIT_OP_MOV_REG:
+                reads = 1u << op.src; writes = 1u << op.dst;
+                break;
+            case JIT_OP_MOV_IMM:
+                writes = 1u << op.dst;
+                break;
+            case JIT_OP_XCHG:
+                reads = writes = (uint16_t)((1u << op.src) | (1u << op.dst));
+                break;
+            case JIT_OP_ALU_REG:
+                reads = (uint16_t)((1u << op.src) | (1u << op.dst));
+                writes = op.alu == ALU_CMP ? 0 : (uint16_t)(1u << op.dst);
+                result.writes_flags = flags_defined = true;
+                break;
+            case JIT_OP_INCDEC:
+                // CF来自之前的标志
+                result.needs_entry_flags |= !flags_defined;
+                // fallthrough
+            case JIT_OP_ALU_IMM:
+                reads = 1u << op.dst;
+                writes = op.alu == ALU_CMP ? 0 : (uint16_t)(1u << op.dst);
+                result.writes_flags = flags_defined = true;
+                break;
+            case JIT_OP_JCC:
+                result.reads_flags = true;
+                result.needs_entry_flags |= !flags_defined;
+                break;
+            default:
+                break;
+        }
+        // 32/64位写入都会定义整个64位寄存器，写在读之前的寄存器无需装入
+        result.live_in |= reads & ~written;
+        written |= writes;
+        result.compiled_insns++;
+    }
+
+    result.dirty = written;
+    // 块内压入后又弹出的槽不必写回值；出块时 touched 中的槽按 final_valid 重写非空位
+    result.x87_live_in = x87.live_in;
+    result.x87_dirty = x87.written & x87.known_valid;
+    result.x87_require_valid = x87.require_valid;
+    result.x87_require_empty = x87.require_empty;
+    result.x87_touched = x87.touched;
+    result.x87_final_valid = x87.known_valid & x87.touched;
+    result.x87_top_delta = x87.depth;
+    if (usage) {
+        *usage = result;
+    }
+    return result.compiled_insns;
+}
+
+// MARK: - 代码生成
+
+// 块内惰性标志的编译期状态
+typedef struct JITFlagState {
+    Box64FlagOp pending;    // 最后一条写标志指令的运算，NONE = 标志仍在 x28/上下文中
+    uint8_t size;
+} JITFlagState;
+
+// box64_flags_materialize(ctx)，结果在 x0；调用破坏 x0-x18 和NZCV
+static void emit_materialize_call(ARM64CodeBuffer *buf) {
+    arm64_mov_reg(buf, true, A64_X0, CTX);
+    arm64_mov_imm(buf, true, A64_X16, (uint64_t)(uintptr_t)&box64_flags_materialize);
+    arm64_blr(buf, A64_X16);
+}
+
+// rd = 槽掩码换算成的物理寄存器掩码（按 top 循环左移8位）：((mask * 0x101) << top) >> 8
+static void emit_rotate_slots(ARM64CodeBuffer *buf, uint8_t rd, uint8_t mask, uint8_t top) {
+    arm64_mov_imm(buf, false, rd, (uint32_t)mask * 0x101u);
+    arm64_lslv(buf, false, rd, rd, top);
+    arm64_ubfx(buf, false, rd, rd, 8, 8);
+}
+
+// x16 = 槽 slot 的物理寄存器编号
+static void emit_x87_slot_index(ARM64CodeBuffer *buf, uint8_t slot) {
+    arm64_add_imm(buf, false, false, A64_X16, X87_TOP, slot);
+    arm64_and_imm(buf, false, false, A64_X16, A64_X16, 7);
+}
+
+// x87 入口检查：扩展精度模式，或需要非空/为空的槽与上下文不符；返回待回填为“返回块首”的分支个数
+static size_t emit_x87_guard(ARM64CodeBuffer *buf, const Box64JITRegUsage *usage, size_t *sites) {
+    size_t count = 0;
+    arm64_ldrb_imm(buf, A64_X16, CTX, OFF_X87(extended));
+    sites[count++] = buf->count;
+    arm64_cbnz(buf, false, A64_X16, buf->count);
+
+    arm64_ldrb_imm(buf, A64_X16, CTX, OFF_X87(top));
+    arm64_ldrb_imm(buf, A64_X17, CTX, OFF_X87(valid));
+    if (usage->x87_require_valid) {
+        emit_rotate_slots(buf, A64_X0, usage->x87_require_valid, A64_X16);
+        arm64_bic_reg(buf, false, A64_X0, A64_X0, A64_X17);
+        sites[count++] = buf->count;
+        arm64_cbnz(buf, false, A64_X0, buf->count);
+    }
+    if (usage->x87_require_empty) {
+        emit_rotate_slots(buf, A64_X0, usage->x87_require_empty, A64_X16);
+        arm64_and_reg(buf, false, false, A64_X0, A64_X0, A64_X17);
+        sites[count++] = buf->count;
+        arm64_cbnz(buf, false, A64_X0, buf->count);
+    }
+    return count;
+}
+
+static size_t emit_prologue(ARM64CodeBuffer *buf, const Box64JITRegUsage *usage, size_t *bail_sites) {
+    arm64_stp_pre(buf, A64_FP, A64_LR, A64_SP, -FRAME_SIZE);
+    arm64_mov_sp(buf, A64_FP, A64_SP);
+    arm64_stp_off(buf, A64_X19, A64_X20, A64_SP, 16);
+    arm64_stp_off(buf, A64_X21, A64_X22, A64_SP, 32);
+    arm64_stp_off(buf, A64_X23, A64_X24, A64_SP, 48);
+    arm64_stp_off(buf, A64_X25, A64_X26, A64_SP, 64);
+    arm64_stp_off(buf, A64_X27, A64_X28, A64_SP, 80);
+    arm64_mov_reg(buf, true, CTX, A64_X0);
+
+    // x87 检查放在一切有副作用的代码之前
+    const size_t bail_count = usage->x87_touched ? emit_x87_guard(buf, usage, bail_sites) : 0;
+
+    // 块在写标志之前就读标志：先求值上下文中待计算的标志（调用会破坏X8-X15，放在装入寄存器之前）
+    if (usage->needs_entry_flags) {
+        arm64_ldr_imm(buf, false, A64_X16, CTX, OFF_LAZY(op));
+        size_t skip = buf->count;
+        arm64_cbz(buf, false, A64_X16, skip);
+        emit_materialize_call(buf);
+        arm64_patch_branch(buf, skip, buf->count);
+        arm64_ldr_imm(buf, true, FLAGS, CTX, OFF_RFLAGS);
+    }
+
+    if (usage->x87_touched) {
+        arm64_ldrb_imm(buf, X87_TOP, CTX, OFF_X87(top));
+        arm64_add_imm(buf, true, false, X87_BASE, CTX, OFF_X87(st));
+        for (uint8_t slot = 0; slot < 8; slot++) {
+            if (usage->x87_live_in & (1u << slot)) {
+                emit_x87_slot_index(buf, slot);
+                arm64_ldr_d_reg(buf, X87_VREG(slot), X87_BASE, A64_X16);
+            }
+        }
+    }
+
+    for (uint8_t reg = 0; reg < 16; reg++) {
+        if (usage->live_in & (1u << reg)) {
+            arm64_ldr_imm(buf, true, HOST(reg), CTX, OFF_REG(reg));
+        }
+    }
+    return bail_count;
+}
+
+// 写回改过的栈槽、非空位和 TOP；不改变NZCV
+static void emit_x87_writeback(ARM64CodeBuffer *buf, const Box64JITRegUsage *usage) {
+    for (uint8_t slot = 0; slot < 8; slot++) {
+        if (usage->x87_dirty & (1u << slot)) {
+            emit_x87_slot_index(buf, slot);
+            arm64_str_d_reg(buf, X87_VREG(slot), X87_BASE, A64_X16);
+        }
+    }
+    arm64_ldrb_imm(buf, A64_X16, CTX, OFF_X87(valid));
+    emit_rotate_slots(buf, A64_X17, usage->x87_touched, X87_TOP);
+    arm64_bic_reg(buf, false, A64_X16, A64_X16, A64_X17);
+    if (usage->x87_final_valid) {
+        emit_rotate_slots(buf, A64_X17, usage->x87_final_valid, X87_TOP);
+        arm64_orr_reg(buf, false, A64_X16, A64_X16, A64_X17, A64_LSL, 0);
+    }
+    arm64_strb_imm(buf, A64_X16, CTX, OFF_X87(valid));
+    if (usage->x87_top_delta) {
+        emit_x87_slot_index(buf, usage->x87_top_delta);
+        arm64_strb_imm(buf, A64_X16, CTX, OFF_X87(top));
+    }
+}
+
+// 写回改过的寄存器和待计算的标志；不改变NZCV，可放在融合的 B.cond 之前
+static void emit_writeback(ARM64CodeBuffer *buf, const Box64JITRegUsage *usage, const JITFlagState *flags) {
+    if (usage->x87_touched) {
+        emit_x87_writeback(buf, usage);
+    }
+    for (uint8_t reg = 0; reg < 16; reg++) {
+        if (usage->dirty & (1u << reg)) {
+            arm64_str_imm(buf, true, HOST(reg), CTX, OFF_REG(reg));
+        }
+    }
+    if (flags->pending == BOX64_FLAGS_NONE) {
+        return;
+    }
+
+    if (flags->pending != BOX64_FLAGS_LOGIC) {
+        arm64_str_imm(buf, true, LAZY_DST, CTX, OFF_LAZY(dst));
+        arm64_str_imm(buf, true, LAZY_SRC, CTX, OFF_LAZY(src));
+    }
+    arm64_str_imm(buf, true, LAZY_RESULT, CTX, OFF_LAZY(result));
+    arm64_mov_imm(buf, true, A64_X16, (uint64_t)flags->pending | ((uint64_t)flags->size << 32));
+    arm64_str_imm(buf, true, A64_X16, CTX, OFF_LAZY(op));
+
+    // INC/DEC 的CF由 rflags 提供（与 box64_flags_record_incdec 一致）
+    if (flags->pending == BOX64_FLAGS_INC || flags->pending == BOX64_FLAGS_DEC) {
+        arm64_ldr_imm(buf, true, A64_X16, CTX, OFF_RFLAGS);
+        arm64_and_imm(buf, true, false, A64_X16, A64_X16, ~(uint64_t)X86_FLAG_CF);
+        arm64_orr_reg(buf, true, A64_X16, A64_X16, LAZY_CF, A64_LSL, 0);
+        arm64_str_imm(buf, true, A64_X16, CTX, OFF_RFLAGS);
+    }
+}
+
+// x0 已是下一条RIP；返回恢复栈帧部分的下标（x87 入口检查失败时跳过指令计数从这里返回）
+static size_t emit_epilogue(ARM64CodeBuffer *buf, const Box64JITRegUsage *usage) {
+    arm64_ldr_imm(buf, false, A64_X16, CTX, OFF_ICOUNT);
+    arm64_add_imm(buf, false, false, A64_X16, A64_X16, usage->compiled_insns);
+    arm64_str_imm(buf, false, A64_X16, CTX, OFF_ICOUNT);
+
+    const size_t restore = buf->count;
+    arm64_ldp_off(buf, A64_X27, A64_X28, A64_SP, 80);
+    arm64_ldp_off(buf, A64_X25, A64_X26, A64_SP, 64);
+    arm64_ldp_off(buf, A64_X23, A64_X24, A64_SP, 48);
+    arm64_ldp_off(buf, A64_X21, A64_X22, A64_SP, 32);
+    arm64_ldp_off(buf, A64_X19, A64_X20, A64_SP, 16);
+    arm64_ldp_post(buf, A64_FP, A64_LR, A64_SP, FRAME_SIZE);
+    arm64_ret(buf);
+    return restore;
+}
+
+// INC/DEC 之前把当前CF放入 x5：按上一条写标志的运算从NZCV/操作数推出，不做完整求值
+static void emit_carry_for_incdec(ARM64CodeBuffer *buf, const JITFlagState *flags) {
+    const bool is64 = flags->size == 8;
+    switch (flags->pending) {
+        case BOX64_FLAGS_NONE:
+            arm64_ubfx(buf, true, LAZY_CF, FLAGS, 0, 1);
+            break;
+        case BOX64_FLAGS_ADD:       // CF = result < dst
+            arm64_sub_reg(buf, is64, true, A64_XZR, LAZY_RESULT, LAZY_DST);
+            arm64_cset(buf, true, LAZY_CF, A64_COND_LO);
+            break;
+        case BOX64_FLAGS_SUB:       // CF = dst < src
+            arm64_sub_reg(buf, is64, true, A64_XZR, LAZY_DST, LAZY_SRC);
+            arm64_cset(buf, true, LAZY_CF, A64_COND_LO);
+            break;
+        case BOX64_FLAGS_LOGIC:
+            arm64_mov_reg(buf, true, LAZY_CF, A64_XZR);
+            break;
+        default:                    // 连续的INC/DEC：x5 不变
+            break;
+    }
+}
+
+static void emit_alu(ARM64CodeBuffer *buf, const JITOp *op, JITFlagState *flags) {
+    const uint8_t rn = HOST(op->dst);
+    const bool incdec = op->kind == JIT_OP_INCDEC;
+    if (incdec) {
+        emit_carry_for_incdec(buf, flags);
+    }
+
+    // 保留运算前的操作数，出块时写入 lazy_flags
+    arm64_mov_reg(buf, op->is64, LAZY_DST, rn);
+    if (op->kind == JIT_OP_ALU_REG) {
+        arm64_mov_reg(buf, op->is64, LAZY_SRC, HOST(op->src));
+    } else {
+        arm64_mov_imm(buf, op->is64, LAZY_SRC, incdec ? 1 : op->imm);
+    }
+
+    Box64FlagOp kind;
+    switch (op->alu) {
+        case ALU_ADD:
+            arm64_add_reg(buf, op->is64, true, LAZY_RESULT, LAZY_DST, LAZY_SRC);
+            kind = incdec ? BOX64_FLAGS_INC : BOX64_FLAGS_ADD;
+            break;
+        case ALU_SUB:
+        case ALU_CMP:
+            arm64_sub_reg(buf, op->is64, true, LAZY_RESULT, LAZY_DST, LAZY_SRC);
+            kind = incdec ? BOX64_FLAGS_DEC : BOX64_FLAGS_SUB;
+            break;
+        case ALU_AND:
+            arm64_and_reg(buf, op->is64, true, LAZY_RESULT, LAZY_DST, LAZY_SRC);
+            kind = BOX64_FLAGS_LOGIC;
+            break;
+        case ALU_OR:
+            arm64_orr_reg(buf, op->is64, LAZY_RESULT, LAZY_DST, LAZY_SRC, A64_LSL, 0);
+            arm64_and_reg(buf, op->is64, true, A64_XZR, LAZY_RESULT, LAZY_RESULT);   // TST设置N/Z，清C/V
+            kind = BOX64_FLAGS_LOGIC;
+            break;
+        default:  // ALU_XOR
+            arm64_eor_reg(buf, op->is64, LAZY_RESULT, LAZY_DST, LAZY_SRC, A64_LSL, 0);
+            arm64_and_reg(buf, op->is64, true, A64_XZR, LAZY_RESULT, LAZY_RESULT);
+            kind = BOX64_FLAGS_LOGIC;
+            break;
+    }
+    flags->pending = kind;
+    flags->size = op->is64 ? 8 : 4;
+
+    if (op->alu != ALU_CMP) {
+        arm64_mov_reg(buf, op->is64, rn, LAZY_RESULT);   // 32位写零扩展，与x86语义一致
+    }
+}
+
+// 快速模式：栈槽的值是 double，运算与解释器的宿主 double 运算逐位一致
+static void emit_x87(ARM64CodeBuffer *buf, const JITOp *op, uint8_t *depth) {
+#define ST(i) X87_VREG(*depth + (i))
+    switch (op->alu) {
+        case X87_FLD: {
+            const uint8_t src = ST(op->src);
+            *depth = (*depth - 1) & 7;
+            arm64_fmov_d(buf, ST(0), src);
+            break;
+        }
+        case X87_FLDC:
+            *depth = (*depth - 1) & 7;
+            if (op->imm) {
+                arm64_mov_imm(buf, true, A64_X16, op->imm);
+                arm64_fmov_d_from_x(buf, ST(0), A64_X16);
+            } else {
+                arm64_fmov_d_from_x(buf, ST(0), A64_XZR);
+            }
+            break;
+        case X87_FXCH:
+            arm64_fmov_d(buf, X87_TEMP, ST(0));
+            arm64_fmov_d(buf, ST(0), ST(op->src));
+            arm64_fmov_d(buf, ST(op->src), X87_TEMP);
+            break;
+        case X87_FCHS:
+            arm64_fneg_d(buf, ST(0), ST(0));
+            break;
+        case X87_FABS:
+            arm64_fabs_d(buf, ST(0), ST(0));
+            break;
+        case X87_FST:
+            if (op->dst != 0) {
+                arm64_fmov_d(buf, ST(op->dst), ST(0));
+            }
+            break;
+        default: {  // X87_ARITH
+            const uint8_t a = ST(op->dst), b = ST(op->src);
+            switch (op->imm) {
+                case 0:  arm64_fadd_d(buf, a, a, b); break;
+                case 1:  arm64_fmul_d(buf, a, a, b); break;
+                case 4:  arm64_fsub_d(buf, a, a, b); break;
+                case 5:  arm64_fsub_d(buf, a, b, a); break;
+                case 6:  arm64_fdiv_d(buf, a, a, b); break;
+                default: arm64_fdiv_d(buf, a, b, a); break;
+            }
+            break;
+        }
+    }
+    if (op->pop) {
+        *depth = (*depth + 1) & 7;
+    }
+#undef ST
+}
+
+// x86条件码（cc>>1）在 pending 运算设置的NZCV上的等价ARM条件，-1 = 不能直接表示
+// SUBS的C表示“无借位”，故 B→LO；ANDS/TST 清C和V，与逻辑运算 CF=OF=0 相符
+static const int8_t fused_conditions[][8] = {
+    //                    O             B             E             BE            S             P   L             LE
+    [BOX64_FLAGS_ADD]   = { A64_COND_VS, A64_COND_HS, A64_COND_EQ, -1,          A64_COND_MI, -1, A64_COND_LT, A64_COND_LE },
+    [BOX64_FLAGS_SUB]   = { A64_COND_VS, A64_COND_LO, A64_COND_EQ, A64_COND_LS, A64_COND_MI, -1, A64_COND_LT, A64_COND_LE },
+    [BOX64_FLAGS_LOGIC] = { A64_COND_VS, A64_COND_HS, A64_COND_EQ, A64_COND_EQ, A64_COND_MI, -1, A64_COND_LT, A64_COND_LE },
+    [BOX64_FLAGS_INC]   = { A64_COND_VS, -1,          A64_COND_EQ, -1,          A64_COND_MI, -1, A64_COND_LT, A64_COND_LE },
+    [BOX64_FLAGS_DEC]   = { A64_COND_VS, -1,          A64_COND_EQ, -1,          A64_COND_MI, -1, A64_COND_LT, A64_COND_LE },
+};
+
+static int fused_condition(Box64FlagOp pending, uint8_t cc) {
+    if (pending == BOX64_FLAGS_NONE || pending == BOX64_FLAGS_ADC || pending == BOX64_FLAGS_SBB) {
+        return -1;
+    }
+    int cond = fused_conditions[pending][(cc >> 1) & 7];
+    return cond < 0 ? -1 : (cond ^ (cc & 1));   // ARM条件码最低位同样表示取反
+}
+
+// 对 flags_reg 中的x86标志求值条件码 cc，跳到 target 的分支指令下标返回给调用方回填
+static size_t emit_condition_branch(ARM64CodeBuffer *buf, uint8_t flags_reg, uint8_t cc) {
+    const bool negate = cc & 1;
+    int bit = -1;
+
+    switch ((cc >> 1) & 7) {
+        case 0: bit = 11; break;    // O
+        case 1: bit = 0;  break;    // B
+        case 2: bit = 6;  break;    // Z
+        case 4: bit = 7;  break;    // S
+        case 5: bit = 2;  break;    // P
+        case 3:                     // BE: CF | ZF
+            arm64_mov_imm(buf, true, A64_X17, X86_FLAG_CF | X86_FLAG_ZF);
+            arm64_and_reg(buf, true, false, A64_X16, flags_reg, A64_X17);
+            break;
+        case 6:                     // L: SF != OF
+        case 7:                     // LE: (SF != OF) | ZF
+            arm64_ubfx(buf, true, A64_X16, flags_reg, 7, 1);
+            arm64_ubfx(buf, true, A64_X17, flags_reg, 11, 1);
+            arm64_eor_reg(buf, true, A64_X16, A64_X16, A64_X17, A64_LSL, 0);
+            if (((cc >> 1) & 7) == 7) {
+                arm64_ubfx(buf, true, A64_X17, flags_reg, 6, 1);
+                arm64_orr_reg(buf, true, A64_X16, A64_X16, A64_X17, A64_LSL, 0);
+            }
+            break;
+    }
+
+    size_t at = buf->count;
+    if (bit >= 0) {
+        if (negate) {
+            arm64_tbz(buf, flags_reg, (uint8_t)bit, at);
+        } else {
+            arm64_tbnz(buf, flags_reg, (uint8_t)bit, at);
+        }
+    } else if (negate) {
+        arm64_cbz(buf, true, A64_X16, at);
+    } else {
+        arm64_cbnz(buf, true, A64_X16, at);
+    }
+    return at;
+}
+
+size_t box64_jit_compile_block(const Box64Block *block, uint32_t *code, size_t capacity, Box64JITRegUsage *usage) {
+    Box64JITRegUsage regs;
+    if (!block || !code || box64_jit_analyze(block, &regs) == 0) {
+        return 0;
+    }
+
+    ARM64CodeBuffer buf;
+    arm64_buffer_init(&buf, code, capacity);
+    size_t bail_sites[3];
+    const size_t bail_count = emit_prologue(&buf, &regs, bail_sites);
+
+    JITFlagState flags = { BOX64_FLAGS_NONE, 0 };
+    uint8_t x87_depth = 0;
+    uint64_t rip = block->guest_start;
+    size_t pending_exit = SIZE_MAX;     // 条件跳转不成立路径上待回填的 B epilogue
+    bool written_back = false;
+
+    for (uint32_t i = 0; i < regs.compiled_insns; i++) {
+        const X86DecodedInsn *insn = &block->insns[i];
+        const JITOp op = classify(insn);
+        rip += insn->length;
+
+        switch (op.kind) {
+            case JIT_OP_NOP:
+                break;
+            case JIT_OP_MOV_REG:
+                arm64_mov_reg(&buf, op.is64, HOST(op.dst), HOST(op.src));
+                break;
+            case JIT_OP_MOV_IMM:
+                arm64_mov_imm(&buf, op.is64, HOST(op.dst), op.imm);
+                break;
+            case JIT_OP_XCHG:
+                arm64_mov_reg(&buf, op.is64, A64_X16, HOST(op.dst));
+                arm64_mov_reg(&buf, op.is64, HOST(op.dst), HOST(op.src));
+                arm64_mov_reg(&buf, op.is64, HOST(op.src), A64_X16);
+                break;
+            case JIT_OP_ALU_REG:
+            case JIT_OP_ALU_IMM:
+            case JIT_OP_INCDEC:
+                emit_alu(&buf, &op, &flags);
+                break;
+            case JIT_OP_X87:
+                emit_x87(&buf, &op, &x87_depth);
+                break;
+            case JIT_OP_JMP:
+                arm64_mov_imm(&buf, true, A64_X0, rip + (uint64_t)insn->imm);
+                break;
+            case JIT_OP_JCC: {
+                // Jcc 是块的最后一条指令：先写回，两条出口共用尾声
+                const int cond = fused_condition(flags.pending, op.alu);
+                emit_writeback(&buf, &regs, &flags);
+                written_back = true;
+
+                size_t taken;
+                if (cond >= 0) {
+                    taken = buf.count;      // CMP+Jcc 融合
+                    arm64_b_cond(&buf, (ARM64Cond)cond, taken);
+                } else if (flags.pending != BOX64_FLAGS_NONE) {
+                    emit_materialize_call(&buf);
+                    taken = emit_condition_branch(&buf, A64_X0, op.alu);
+                } else {
+                    taken = emit_condition_branch(&buf, FLAGS, op.alu);
+                }
+                arm64_mov_imm(&buf, true, A64_X0, rip);
+                pending_exit = buf.count;
+                arm64_b(&buf, pending_exit);
+                arm64_patch_branch(&buf, taken, buf.count);
+                arm64_mov_imm(&buf, true, A64_X0, rip + (uint64_t)insn->imm);
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+    // 没有以跳转结束：从第一条未编译的指令（或块尾）继续
+    const X86DecodedInsn *last = &block->insns[regs.compiled_insns - 1];
+    if (!x86_insn_is_branch(last)) {
+        arm64_mov_imm(&buf, true, A64_X0, rip);
+    }
+    if (!written_back) {
+        emit_writeback(&buf, &regs, &flags);
+    }
+    if (pending_exit != SIZE_MAX) {
+        arm64_patch_branch(&buf, pending_exit, buf.count);
+    }
+    const size_t restore = emit_epilogue(&buf, &regs);
+    if (bail_count) {
+        const size_t bail = buf.count;
+        arm64_mov_imm(&buf, true, A64_X0, block->guest_start);
+        arm64_b(&buf, restore);
+        for (size_t k = 0; k < bail_count; k++) {
+            arm64_patch_branch(&buf, bail_sites[k], bail);
+        }
+    }
+
+    if (buf.overflow) {
+        return 0;
+    }
+    if (usage) {
+        *usage = regs;
+    }
+    return buf.count;
+}
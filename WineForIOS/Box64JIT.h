@@ -0,0 +1,62 @@
+// Box64JIT.h - 基本块到ARM64本机代码的编译器
+// 纯C实现：输入翻译缓存中的预解码块，输出一个完整的ARM64函数
+//     uint64_t block(Box64Context *ctx)   // 返回下一条要执行的客户机RIP
+// 生成的代码只是指令字数组，装入可执行内存（W^X切换、icache失效）由调用方完成
+#ifndef BOX64_JIT_H
+#define BOX64_JIT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "Box64Context.h"
+#include "Box64TranslationCache.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BOX64_JIT_HOT_THRESHOLD     2       // 块第N次执行时编译
+#define BOX64_JIT_MAX_BLOCK_WORDS   2048    // 单块生成代码上限（指令字）
+
+// 生成函数的签名
+typedef uint64_t (*Box64JITBlockFn)(Box64Context *ctx);
+
+// 客户机寄存器 → 宿主寄存器的固定分配
+// RAX..RDI 放在被调用者保存的 X19-X26，R8..R15 放在 X8-X15；
+// X18（平台保留）、X27（上下文指针）、X28（入口RFLAGS）不参与分配
+extern const uint8_t box64_jit_guest_register_map[16];
+
+// 寄存器分配结果：序言只装入块内先读后写的寄存器，尾声只写回改过的寄存器
+typedef struct Box64JITRegUsage {
+    uint16_t live_in;           // 位i = 客户机寄存器i需要从上下文装入
+    uint16_t dirty;             // 位i = 客户机寄存器i需要写回上下文
+    bool reads_flags;
+    bool writes_flags;
+    bool needs_entry_flags;     // 块在写标志前读标志（Jcc 或 INC/DEC 的CF），序言需先求值上下文中的惰性标志
+    uint32_t compiled_insns;    // 从块首起可编译的指令数（遇到第一条不支持的指令为止）
+    // x87 栈槽（快速模式）：槽r = 块入口时的物理寄存器 (TOP + r) & 7，块内固定缓存在 D16+r
+    uint8_t x87_live_in;        // 需要从上下文装入的槽
+    uint8_t x87_dirty;          // 需要写回的槽
+    uint8_t x87_require_valid;  // 入口检查：这些槽必须非空
+    uint8_t x87_require_empty;  // 入口检查：这些槽必须为空（块内压栈的目标）
+    uint8_t x87_touched;        // 出块时按 x87_final_valid 重写这些槽的非空位
+    uint8_t x87_final_valid;
+    uint8_t x87_top_delta;      // 出块时 TOP 的增量（模8）
+} Box64JITRegUsage;
+
+// 指令是否在JIT支持的子集内（32/64位寄存器形式的MOV/ALU/INC/DEC/NOP、相对跳转及x87寄存器栈形式）
+bool box64_jit_insn_supported(const X86DecodedInsn *insn);
+
+// 寄存器分配：分析块前缀的读写集合，返回可编译的指令数
+uint32_t box64_jit_analyze(const Box64Block *block, Box64JITRegUsage *usage);
+
+// 编译块前缀，返回生成的指令字数；块首即不可编译或缓冲区不足时返回0
+// 生成的函数在遇到不支持的指令处返回该指令的RIP，由解释器接着执行；
+// 含x87指令的块在扩展精度模式或栈状态不符时不执行任何指令（instruction_count 不变），返回块首
+size_t box64_jit_compile_block(const Box64Block *block, uint32_t *code, size_t capacity, Box64JITRegUsage *usage);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BOX64_JIT_H
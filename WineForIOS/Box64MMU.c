@@ -0,0 +1,269 @@
+// Box64MMU.c - 软件MMU实现
+#include "Box64MMU.h"
+#include <stdlib.h>
+
+#define ENTRY_PROT_MASK     ((uintptr_t)(BOX64_PROT_READ | BOX64_PROT_WRITE | BOX64_PROT_EXEC))
+#define ENTRY_HOST(entry)   ((uint8_t *)((entry) & ~(uintptr_t)BOX64_PAGE_OFFSET_MASK))
+#define ENTRY_PROT(entry)   ((uint32_t)((entry) & ENTRY_PROT_MASK))
+
+// 页表中的 BOX64_PROT_NONE 映射仍需与“未映射”区分
+#define ENTRY_MAPPED        ((uintptr_t)1 << 11)
+
+bool box64_mmu_init(Box64MMU *mmu, uint8_t *backing, uint64_t size) {
+    if (!mmu || !backing || ((uintptr_t)backing & BOX64_PAGE_OFFSET_MASK)) {
+        return false;
+    }
+    memset(mmu, 0, sizeof(*mmu));
+    mmu->size = size & BOX64_PAGE_MASK;
+    mmu->page_count = mmu->size >> BOX64_PAGE_SHIFT;
+    if (mmu->page_count == 0) {
+        return false;
+    }
+    mmu->pages = calloc((size_t)mmu->page_count, sizeof(Box64PageEntry));
+    if (!mmu->pages) {
+        return false;
+    }
+    mmu->backing = backing;
+    mmu->owner = mmu;
+    atomic_init(&mmu->map_epoch, 0);
+    box64_mmu_flush_tlb(mmu);
+    mmu->stats.tlb_flushes = 0;
+    return true;
+}
+
+bool box64_mmu_attach(Box64MMU *view, Box64MMU *owner) {
+    if (!view || !owner || !owner->pages || view == owner) {
+        return false;
+    }
+    owner = owner->owner;
+    memset(view, 0, sizeof(*view));
+    view->backing = owner->backing;
+    view->size = owner->size;
+    view->page_count = owner->page_count;
+    view->pages = owner->pages;
+    view->owner = owner;
+    atomic_init(&view->map_epoch, 0);
+    view->seen_epoch = atomic_load_explicit(&owner->map_epoch, memory_order_acquire);
+    box64_mmu_flush_tlb(view);
+    view->stats.tlb_flushes = 0;
+    return true;
+}
+
+void box64_mmu_destroy(Box64MMU *mmu) {
+    if (!mmu) {
+        return;
+    }
+    if (mmu->owner == mmu) {
+        free(mmu->pages);
+    }
+    memset(mmu, 0, sizeof(*mmu));
+}
+
+void box64_mmu_flush_tlb(Box64MMU *mmu) {
+    for (uint32_t i = 0; i < BOX64_TLB_ENTRIES; i++) {
+        for (uint32_t a = 0; a < BOX64_ACCESS_COUNT; a++) {
+            mmu->tlb[i].tag[a] = BOX64_TLB_INVALID;
+        }
+        mmu->tlb[i].addend = 0;
+    }
+    mmu->stats.tlb_flushes++;
+}
+
+// MARK: - 页表
+
+// 把 [address, address+size) 扩展为页号区间 [*first, *end)；越界返回false
+static bool page_range(const Box64MMU *mmu, uint64_t address, uint64_t size, uint64_t *first, uint64_t *end) {
+    if (size == 0 || address >= mmu->size || size > mmu->size - address) {
+        return false;
+    }
+    *first = address >> BOX64_PAGE_SHIFT;
+    *end = (address + size + BOX64_PAGE_OFFSET_MASK) >> BOX64_PAGE_SHIFT;
+    return true;
+}
+
+// 页表变化后只作废修改方受影响的TLB项（范围覆盖整个TLB时整体清空），其他视图经映射代数整体清空
+static void flush_tlb_range(Box64MMU *mmu, uint64_t first, uint64_t end) {
+    atomic_fetch_add_explicit(&mmu->owner->map_epoch, 1, memory_order_release);
+    if (end - first >= BOX64_TLB_ENTRIES) {
+        box64_mmu_flush_tlb(mmu);
+        return;
+    }
+    for (uint64_t page = first; page < end; page++) {
+        Box64TLBEntry *entry = &mmu->tlb[page & (BOX64_TLB_ENTRIES - 1)];
+        for (uint32_t a = 0; a < BOX64_ACCESS_COUNT; a++) {
+            if (entry->tag[a] == page << BOX64_PAGE_SHIFT) {
+                entry->tag[a] = BOX64_TLB_INVALID;
+            }
+        }
+    }
+}
+
+static void set_pages(Box64MMU *mmu, uint64_t first, uint64_t end, uint8_t *host, uint32_t prot) {
+    for (uint64_t page = first; page < end; page++) {
+        if (!mmu->pages[page]) {
+            mmu->owner->stats.mapped_pages++;
+        }
+        mmu->pages[page] = (uintptr_t)(host + ((page - first) << BOX64_PAGE_SHIFT)) | ENTRY_MAPPED | (prot & ENTRY_PROT_MASK);
+    }
+    flush_tlb_range(mmu, first, end);
+}
+
+bool box64_mmu_map(Box64MMU *mmu, uint64_t address, uint64_t size, uint32_t prot) {
+    uint64_t first, end;
+    if (!mmu || !page_range(mmu, address, size, &first, &end)) {
+        return false;
+    }
+    set_pages(mmu, first, end, mmu->backing + (first << BOX64_PAGE_SHIFT), prot);
+    return true;
+}
+
+bool box64_mmu_map_host(Box64MMU *mmu, uint64_t address, uint64_t size, void *host, uint32_t prot) {
+    uint64_t first, end;
+    if (!mmu || !host || ((uintptr_t)host & BOX64_PAGE_OFFSET_MASK) || (address & BOX64_PAGE_OFFSET_MASK) ||
+        !page_range(mmu, address, size, &first, &end)) {
+        return false;
+    }
+    set_pages(mmu, first, end, host, prot);
+    return true;
+}
+
+bool box64_mmu_protect(Box64MMU *mmu, uint64_t address, uint64_t size, uint32_t prot) {
+    uint64_t first, end;
+    if (!mmu || !page_range(mmu, address, size, &first, &end)) {
+        return false;
+    }
+    for (uint64_t page = first; page < end; page++) {
+        if (!mmu->pages[page]) {
+            return false;
+        }
+    }
+    for (uint64_t page = first; page < end; page++) {
+        mmu->pages[page] = (mmu->pages[page] & ~ENTRY_PROT_MASK) | (prot & ENTRY_PROT_MASK);
+    }
+    flush_tlb_range(mmu, first, end);
+    return true;
+}
+
+bool box64_mmu_unmap(Box64MMU *mmu, uint64_t address, uint64_t size) {
+    uint64_t first, end;
+    if (!mmu || !page_range(mmu, address, size, &first, &end)) {
+        return false;
+    }
+    for (uint64_t page = first; page < end; page++) {
+        if (mmu->pages[page]) {
+            mmu->owner->stats.mapped_pages--;
+            mmu->pages[page] = 0;
+        }
+    }
+    flush_tlb_range(mmu, first, end);
+    return true;
+}
+
+uint32_t box64_mmu_query(const Box64MMU *mmu, uint64_t address) {
+    if (!mmu || address >= mmu->size) {
+        return BOX64_PROT_NONE;
+    }
+    return ENTRY_PROT(mmu->pages[address >> BOX64_PAGE_SHIFT]);
+}
+
+bool box64_mmu_check(const Box64MMU *mmu, uint64_t address, uint64_t size, Box64Access access) {
+    uint64_t first, end;
+    if (!mmu || !page_range(mmu, address, size, &first, &end)) {
+        return false;
+    }
+    const uint32_t needed = 1u << access;
+    for (uint64_t page = first; page < end; page++) {
+        if (!(ENTRY_PROT(mmu->pages[page]) & needed)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// MARK: - 翻译
+
+static void record_fault(Box64MMU *mmu, uint64_t address, Box64Access access) {
+    mmu->fault_address = address;
+    mmu->fault_access = access;
+    mmu->stats.faults++;
+}
+
+uint8_t *box64_mmu_translate_slow(Box64MMU *mmu, uint64_t address, uint64_t size, Box64Access access) {
+    const uint32_t needed = 1u << access;
+    mmu->stats.tlb_misses++;
+
+    if (!box64_mmu_crosses_page(address, size)) {
+        if (size == 0 || address >= mmu->size) {
+            record_fault(mmu, address, access);
+            return NULL;
+        }
+        const uint64_t page = address >> BOX64_PAGE_SHIFT;
+        const Box64PageEntry pte = mmu->pages[page];
+        if (!(ENTRY_PROT(pte) & needed)) {
+            record_fault(mmu, address, access);
+            return NULL;
+        }
+
+        // 一次填入该页允许的全部访问类型，同页的后续读写都能命中
+        Box64TLBEntry *entry = &mmu->tlb[page & (BOX64_TLB_ENTRIES - 1)];
+        const uint64_t tag = address & BOX64_PAGE_MASK;
+        for (uint32_t a = 0; a < BOX64_ACCESS_COUNT; a++) {
+            entry->tag[a] = (ENTRY_PROT(pte) & (1u << a)) ? tag : BOX64_TLB_INVALID;
+        }
+        entry->addend = (uintptr_t)ENTRY_HOST(pte) - (uintptr_t)tag;
+        return (uint8_t *)(address + entry->addend);
+    }
+
+    // 跨页：各页都允许且宿主页首尾相接时可直接给出指针
+    uint64_t first, end;
+    if (!page_range(mmu, address, size, &first, &end)) {
+        return NULL;
+    }
+    uint8_t *expected = NULL;
+    for (uint64_t page = first; page < end; page++) {
+        const Box64PageEntry pte = mmu->pages[page];
+        if (!(ENTRY_PROT(pte) & needed) || (expected && ENTRY_HOST(pte) != expected)) {
+            return NULL;
+        }
+        expected = ENTRY_HOST(pte) + BOX64_PAGE_SIZE;
+    }
+    return ENTRY_HOST(mmu->pages[first]) + (address & BOX64_PAGE_OFFSET_MASK);
+}
+
+// 逐页复制；权限先整段检查，缺页地址取第一个不允许访问的字节
+static bool copy_guest(Box64MMU *mmu, uint64_t address, uint8_t *buffer, uint64_t size, Box64Access access) {
+    if (size == 0) {
+        return true;
+    }
+    if (!box64_mmu_check(mmu, address, size, access)) {
+        uint64_t bad = address;
+        while (bad - address < size && bad < mmu->size && (ENTRY_PROT(mmu->pages[bad >> BOX64_PAGE_SHIFT]) & (1u << access))) {
+            bad = (bad & BOX64_PAGE_MASK) + BOX64_PAGE_SIZE;
+        }
+        record_fault(mmu, bad, access);
+        return false;
+    }
+
+    while (size > 0) {
+        const uint64_t chunk = BOX64_PAGE_SIZE - (address & BOX64_PAGE_OFFSET_MASK);
+        const uint64_t length = chunk < size ? chunk : size;
+        uint8_t *host = ENTRY_HOST(mmu->pages[address >> BOX64_PAGE_SHIFT]) + (address & BOX64_PAGE_OFFSET_MASK);
+        if (access == BOX64_ACCESS_WRITE) {
+            memcpy(host, buffer, (size_t)length);
+        } else {
+            memcpy(buffer, host, (size_t)length);
+        }
+        address += length;
+        buffer += length;
+        size -= length;
+    }
+    return true;
+}
+
+bool box64_mmu_copy_from_guest(Box64MMU *mmu, void *dst, uint64_t address, uint64_t size) {
+    return mmu && dst && copy_guest(mmu, address, (uint8_t *)dst, size, BOX64_ACCESS_READ);
+}
+
+bool box64_mmu_copy_to_guest(Box64MMU *mmu, uint64_t address, const void *src, uint64_t size) {
+    return mmu && src && copy_guest(mmu, address, (uint8_t *)(uintptr_t)src, size, BOX64_ACCESS_WRITE);
+}
@@ -0,0 +1,180 @@
+// Box64MMU.h - 客户机地址空间（软件MMU）
+// 纯C实现：4KiB页表 + 直接映射TLB，每次客户机访存都经过 box64_mmu_translate
+//   客户机地址 [0, size) 按页映射到宿主内存；页表项记录宿主页地址和 R/W/X 权限
+//   TLB 按访问类型分别缓存“页地址 → 宿主偏移”，命中时一次比较即可得到宿主指针
+// 客户机地址与宿主指针无关，所有检查都以客户机地址为准
+// 多个客户机线程共享一张页表：每个线程一个视图（box64_mmu_attach），各自持有TLB和缺页记录；
+//   页表修改作废修改方自己的TLB并推进所有者的映射代数，其他视图在块边界 box64_mmu_sync 时发现代数变化整体清空TLB
+//   页表修改需由调用方串行化（Box64Engine 的进程内存锁），翻译和修改可以并发
+#ifndef BOX64_MMU_H
+#define BOX64_MMU_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BOX64_PAGE_SHIFT        12
+#define BOX64_PAGE_SIZE         (1ULL << BOX64_PAGE_SHIFT)
+#define BOX64_PAGE_OFFSET_MASK  (BOX64_PAGE_SIZE - 1)
+#define BOX64_PAGE_MASK         (~BOX64_PAGE_OFFSET_MASK)
+#define BOX64_TLB_ENTRIES       256         // 直接映射，需为2的幂
+#define BOX64_TLB_INVALID       (~0ULL)     // 非页对齐，不会与任何页地址相等
+
+// 页权限
+enum {
+    BOX64_PROT_NONE  = 0,
+    BOX64_PROT_READ  = 1 << 0,
+    BOX64_PROT_WRITE = 1 << 1,
+    BOX64_PROT_EXEC  = 1 << 2
+};
+
+// 访问类型；对应的权限位为 1 << access
+typedef enum Box64Access {
+    BOX64_ACCESS_READ = 0,
+    BOX64_ACCESS_WRITE,
+    BOX64_ACCESS_EXEC,
+    BOX64_ACCESS_COUNT
+} Box64Access;
+
+// 页表项：宿主页地址（4KiB对齐）低位存放权限，0 表示未映射
+typedef uintptr_t Box64PageEntry;
+
+typedef struct Box64TLBEntry {
+    uint64_t tag[BOX64_ACCESS_COUNT];   // 允许该类访问的客户机页地址，否则为 BOX64_TLB_INVALID
+    uintptr_t addend;                   // 宿主地址 = 客户机地址 + addend
+} Box64TLBEntry;
+
+typedef struct Box64MMUStats {
+    uint64_t tlb_misses;
+    uint64_t tlb_flushes;
+    uint64_t faults;
+    uint32_t mapped_pages;
+} Box64MMUStats;
+
+typedef struct Box64MMU {
+    uint8_t *backing;                   // 默认映射的宿主内存：客户机地址 a 对应 backing + a
+    uint64_t size;                      // 客户机地址空间大小（页对齐）
+    uint64_t page_count;
+    Box64PageEntry *pages;
+    Box64TLBEntry tlb[BOX64_TLB_ENTRIES];
+
+    // 最近一次缺页（权限不足或未映射）
+    uint64_t fault_address;
+    uint32_t fault_access;
+
+    Box64MMUStats stats;                // mapped_pages 只在所有者中维护
+
+    struct Box64MMU *owner;             // 页表所有者，box64_mmu_init 初始化的MMU指向自己
+    _Atomic uint64_t map_epoch;         // 只在所有者中使用：每次页表修改加一
+    uint64_t seen_epoch;                // 本视图TLB对应的代数
+} Box64MMU;
+
+// 地址空间覆盖整个 backing（size向下取整到页），初始时全部未映射
+bool box64_mmu_init(Box64MMU *mmu, uint8_t *backing, uint64_t size);
+void box64_mmu_destroy(Box64MMU *mmu);
+
+// 共享 owner 的页表（owner 本身也可以是视图，最终指向同一个所有者）；视图的 destroy 不释放页表，
+// 所有者须比全部视图活得久
+bool box64_mmu_attach(Box64MMU *view, Box64MMU *owner);
+
+// 映射/修改权限/解除映射，范围按页扩展；越界或（protect时）含未映射页返回false且不做修改
+bool box64_mmu_map(Box64MMU *mmu, uint64_t address, uint64_t size, uint32_t prot);
+bool box64_mmu_map_host(Box64MMU *mmu, uint64_t address, uint64_t size, void *host, uint32_t prot);
+bool box64_mmu_protect(Box64MMU *mmu, uint64_t address, uint64_t size, uint32_t prot);
+bool box64_mmu_unmap(Box64MMU *mmu, uint64_t address, uint64_t size);
+
+// 页权限，未映射或越界返回 BOX64_PROT_NONE
+uint32_t box64_mmu_query(const Box64MMU *mmu, uint64_t address);
+
+// [address, address+size) 的每一页都允许 access；不填TLB、不记缺页
+bool box64_mmu_check(const Box64MMU *mmu, uint64_t address, uint64_t size, Box64Access access);
+
+void box64_mmu_flush_tlb(Box64MMU *mmu);
+
+// 其他视图修改过页表时整体清空本视图的TLB；未变化时只是一次原子读
+static inline void box64_mmu_sync(Box64MMU *mmu) {
+    if (!mmu->owner) {
+        return;     // 未初始化
+    }
+    const uint64_t epoch = atomic_load_explicit(&mmu->owner->map_epoch, memory_order_acquire);
+    if (epoch != mmu->seen_epoch) {
+        mmu->seen_epoch = epoch;
+        box64_mmu_flush_tlb(mmu);
+    }
+}
+
+// TLB未命中路径：查页表、检查权限、填TLB
+// 跨页访问只在各页都允许且宿主页连续时返回指针，否则返回NULL但不记缺页，由 copy 路径逐页处理并记录
+uint8_t *box64_mmu_translate_slow(Box64MMU *mmu, uint64_t address, uint64_t size, Box64Access access);
+
+// 整段复制，逐页翻译（可跨不连续的宿主页）；先检查整段权限，缺页时不做任何复制
+bool box64_mmu_copy_from_guest(Box64MMU *mmu, void *dst, uint64_t address, uint64_t size);
+bool box64_mmu_copy_to_guest(Box64MMU *mmu, uint64_t address, const void *src, uint64_t size);
+
+// 客户机地址 → 可访问 size 字节的宿主指针；单页访问缺页时返回NULL并记录 fault_address
+static inline uint8_t *box64_mmu_translate(Box64MMU *mmu, uint64_t address, uint64_t size, Box64Access access) {
+    const Box64TLBEntry *entry = &mmu->tlb[(address >> BOX64_PAGE_SHIFT) & (BOX64_TLB_ENTRIES - 1)];
+    if (entry->tag[access] == (address & BOX64_PAGE_MASK) && (address & BOX64_PAGE_OFFSET_MASK) + size <= BOX64_PAGE_SIZE) {
+        return (uint8_t *)(address + entry->addend);
+    }
+    return box64_mmu_translate_slow(mmu, address, size, access);
+}
+
+static inline bool box64_mmu_crosses_page(uint64_t address, uint64_t size) {
+    return (address & BOX64_PAGE_OFFSET_MASK) + size > BOX64_PAGE_SIZE;
+}
+
+// 按常量宽度复制，编译为单条load/store而不是调用memcpy
+static inline void box64_mmu_read_host(const uint8_t *host, uint8_t size, uint64_t *value) {
+    switch (size) {
+        case 1: *value = *host; break;
+        case 2: { uint16_t v; memcpy(&v, host, 2); *value = v; break; }
+        case 4: { uint32_t v; memcpy(&v, host, 4); *value = v; break; }
+        case 8: memcpy(value, host, 8); break;
+        default: memcpy(value, host, size); break;
+    }
+}
+
+static inline void box64_mmu_write_host(uint8_t *host, uint8_t size, uint64_t value) {
+    switch (size) {
+        case 1: *host = (uint8_t)value; break;
+        case 2: { uint16_t v = (uint16_t)value; memcpy(host, &v, 2); break; }
+        case 4: { uint32_t v = (uint32_t)value; memcpy(host, &v, 4); break; }
+        case 8: memcpy(host, &value, 8); break;
+        default: memcpy(host, &value, size); break;
+    }
+}
+
+// 1/2/4/8字节小端读写（宿主为小端的arm64/x86-64）
+static inline bool box64_mmu_load(Box64MMU *mmu, uint64_t address, uint8_t size, uint64_t *value) {
+    uint64_t result = 0;
+    const uint8_t *host = box64_mmu_translate(mmu, address, size, BOX64_ACCESS_READ);
+    if (host) {
+        box64_mmu_read_host(host, size, &result);
+    } else if (!box64_mmu_crosses_page(address, size) || !box64_mmu_copy_from_guest(mmu, &result, address, size)) {
+        return false;
+    }
+    *value = result;
+    return true;
+}
+
+static inline bool box64_mmu_store(Box64MMU *mmu, uint64_t address, uint8_t size, uint64_t value) {
+    uint8_t *host = box64_mmu_translate(mmu, address, size, BOX64_ACCESS_WRITE);
+    if (host) {
+        box64_mmu_write_host(host, size, value);
+        return true;
+    }
+    return box64_mmu_crosses_page(address, size) && box64_mmu_copy_to_guest(mmu, address, &value, size);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BOX64_MMU_H
@@ -0,0 +1,528 @@
+// Box64PELoader.c - PE32/PE32+ 镜像加载器实现
+#include "Box64PELoader.h"
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define PE_DOS_MAGIC            0x5A4D          // "MZ"
+#define PE_NT_SIGNATURE         0x00004550      // "PE\0\0"
+#define PE_OPTIONAL_MAGIC_PE32  0x010B
+#define PE_OPTIONAL_MAGIC_PE32P 0x020B
+#define PE_COFF_HEADER_SIZE     20
+#define PE_SECTION_HEADER_SIZE  40
+#define PE_OPTIONAL_MIN_PE32    96              // 到数据目录之前的固定部分
+#define PE_OPTIONAL_MIN_PE32P   112
+
+// MARK: - 字段读取
+
+static inline uint16_t read16(const uint8_t *p) {
+    return (uint16_t)(p[0] | p[1] << 8);
+}
+
+static inline uint32_t read32(const uint8_t *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static inline uint64_t read64(const uint8_t *p) {
+    return (uint64_t)read32(p) | (uint64_t)read32(p + 4) << 32;
+}
+
+static inline bool is_power_of_two(uint32_t value) {
+    return value != 0 && (value & (value - 1)) == 0;
+}
+
+static inline uint64_t align_up(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// x86页没有“只写”或“只执行”，可写/可执行都隐含可读
+static uint32_t section_prot(uint32_t characteristics) {
+    uint32_t prot = BOX64_PROT_NONE;
+    if (characteristics & (BOX64_PE_SCN_MEM_READ | BOX64_PE_SCN_MEM_WRITE | BOX64_PE_SCN_MEM_EXECUTE)) {
+        prot |= BOX64_PROT_READ;
+    }
+    if (characteristics & BOX64_PE_SCN_MEM_WRITE) {
+        prot |= BOX64_PROT_WRITE;
+    }
+    if (characteristics & BOX64_PE_SCN_MEM_EXECUTE) {
+        prot |= BOX64_PROT_EXEC;
+    }
+    return prot;
+}
+
+uint32_t box64_pe_section_data_size(const Box64PESection *section) {
+    if (section->virtual_size != 0 && section->virtual_size < section->raw_size) {
+        return section->virtual_size;
+    }
+    return section->raw_size;
+}
+
+uint32_t box64_pe_section_span(const Box64PEImage *image, const Box64PESection *section) {
+    const uint32_t size = section->virtual_size ? section->virtual_size : section->raw_size;
+    return (uint32_t)align_up(size, image->section_alignment);
+}
+
+const Box64PESection *box64_pe_section_for_rva(const Box64PEImage *image, uint32_t rva) {
+    for (uint16_t i = 0; i < image->section_count; i++) {
+        const Box64PESection *section = &image->sections[i];
+        if (rva >= section->virtual_address && rva - section->virtual_address < box64_pe_section_span(image, section)) {
+            return section;
+        }
+    }
+    return NULL;
+}
+
+// MARK: - 解析
+
+static Box64PEStatus parse_optional_header(const uint8_t *optional, uint16_t optional_size, Box64PEImage *image) {
+    if (optional_size < 2) {
+        return BOX64_PE_BAD_OPTIONAL_HEADER;
+    }
+    const uint16_t magic = read16(optional);
+    uint32_t directory_offset, directory_count;
+    if (magic == PE_OPTIONAL_MAGIC_PE32P) {
+        if (optional_size < PE_OPTIONAL_MIN_PE32P) {
+            return BOX64_PE_BAD_OPTIONAL_HEADER;
+        }
+        image->pe32_plus = true;
+        image->preferred_base = read64(optional + 24);
+        image->stack_reserve = read64(optional + 72);
+        image->stack_commit = read64(optional + 80);
+        directory_count = read32(optional + 108);
+        directory_offset = PE_OPTIONAL_MIN_PE32P;
+    } else if (magic == PE_OPTIONAL_MAGIC_PE32) {
+        if (optional_size < PE_OPTIONAL_MIN_PE32) {
+            return BOX64_PE_BAD_OPTIONAL_HEADER;
+        }
+        image->pe32_plus = false;
+        image->preferred_base = read32(optional + 28);
+        image->stack_reserve = read32(optional + 72);
+        image->stack_commit = read32(optional + 76);
+        directory_count = read32(optional + 92);
+        directory_offset = PE_OPTIONAL_MIN_PE32;
+    } else {
+        return BOX64_PE_BAD_OPTIONAL_HEADER;
+    }
+
+    image->entry_rva = read32(optional + 16);
+    image->section_alignment = read32(optional + 32);
+    image->file_alignment = read32(optional + 36);
+    image->size_of_image = read32(optional + 56);
+    image->size_of_headers = read32(optional + 60);
+    image->subsystem = read16(optional + 68);
+    image->dll_characteristics = read16(optional + 70);
+
+    // 数据目录数量以可选头实际容纳的为准
+    const uint32_t room = (uint32_t)(optional_size - directory_offset) / 8;
+    if (directory_count > room) {
+        directory_count = room;
+    }
+    if (directory_count > BOX64_PE_MAX_DIRECTORIES) {
+        directory_count = BOX64_PE_MAX_DIRECTORIES;
+    }
+    image->directory_count = directory_count;
+    for (uint32_t i = 0; i < directory_count; i++) {
+        image->directories[i].rva = read32(optional + directory_offset + i * 8);
+        image->directories[i].size = read32(optional + directory_offset + i * 8 + 4);
+    }
+
+    if (!is_power_of_two(image->section_alignment) || !is_power_of_two(image->file_alignment) ||
+        image->file_alignment > image->section_alignment) {
+        return BOX64_PE_BAD_OPTIONAL_HEADER;
+    }
+    if (image->size_of_image == 0 || image->size_of_headers == 0 || image->size_of_headers > image->size_of_image ||
+        image->entry_rva >= image->size_of_image) {
+        return BOX64_PE_BAD_OPTIONAL_HEADER;
+    }
+    // 基址按页对齐；PE32 镜像必须整体落在4GB以内
+    const uint64_t limit = image->pe32_plus ? UINT64_MAX : 0x100000000ULL;
+    if ((image->preferred_base & BOX64_PAGE_OFFSET_MASK) || image->preferred_base > limit - image->size_of_image) {
+        return BOX64_PE_BAD_OPTIONAL_HEADER;
+    }
+    return BOX64_PE_OK;
+}
+
+// 节必须按地址递增、互不重叠、整体落在 SizeOfImage 内，需要复制的原始数据必须在文件内
+static Box64PEStatus validate_sections(const Box64PEImage *image, size_t file_size) {
+    uint64_t previous_end = align_up(image->size_of_headers, image->section_alignment);
+    const uint64_t image_end = align_up(image->size_of_image, image->section_alignment);
+    for (uint16_t i = 0; i < image->section_count; i++) {
+        const Box64PESection *section = &image->sections[i];
+        const uint64_t start = section->virtual_address;
+        const uint64_t end = start + box64_pe_section_span(image, section);
+        if ((start & (image->section_alignment - 1)) || start < previous_end || end > image_end) {
+            return BOX64_PE_BAD_SECTION;
+        }
+        const uint32_t copy = box64_pe_section_data_size(section);
+        if (copy && ((uint64_t)section->raw_offset + copy > file_size)) {
+            return BOX64_PE_BAD_SECTION;
+        }
+        previous_end = end;
+    }
+    return BOX64_PE_OK;
+}
+
+Box64PEStatus box64_pe_parse(const uint8_t *file, size_t size, Box64PEImage *image) {
+    if (!file || !image) {
+        return BOX64_PE_TRUNCATED;
+    }
+    memset(image, 0, sizeof(*image));
+    if (size < 0x40) {
+        return BOX64_PE_TRUNCATED;
+    }
+    if (read16(file) != PE_DOS_MAGIC) {
+        return BOX64_PE_BAD_DOS_HEADER;
+    }
+
+    const uint32_t nt_offset = read32(file + 0x3C);
+    if (nt_offset < 0x40 || (uint64_t)nt_offset + 4 + PE_COFF_HEADER_SIZE > size) {
+        return nt_offset < 0x40 ? BOX64_PE_BAD_DOS_HEADER : BOX64_PE_TRUNCATED;
+    }
+    if (read32(file + nt_offset) != PE_NT_SIGNATURE) {
+        return BOX64_PE_BAD_SIGNATURE;
+    }
+
+    const uint8_t *coff = file + nt_offset + 4;
+    image->machine = read16(coff);
+    const uint16_t section_count = read16(coff + 2);
+    const uint16_t optional_size = read16(coff + 16);
+    image->characteristics = read16(coff + 18);
+
+    const uint64_t optional_offset = (uint64_t)nt_offset + 4 + PE_COFF_HEADER_SIZE;
+    const uint64_t section_table = optional_offset + optional_size;
+    if (optional_offset + optional_size > size) {
+        return BOX64_PE_TRUNCATED;
+    }
+    Box64PEStatus status = parse_optional_header(file + optional_offset, optional_size, image);
+    if (status != BOX64_PE_OK) {
+        return status;
+    }
+
+    if (section_count > BOX64_PE_MAX_SECTIONS) {
+        return BOX64_PE_BAD_SECTION;
+    }
+    if (section_table + (uint64_t)section_count * PE_SECTION_HEADER_SIZE > size) {
+        return BOX64_PE_TRUNCATED;
+    }
+    image->section_count = section_count;
+    for (uint16_t i = 0; i < section_count; i++) {
+        const uint8_t *header = file + section_table + (size_t)i * PE_SECTION_HEADER_SIZE;
+        Box64PESection *section = &image->sections[i];
+        memcpy(section->name, header, 8);
+        section->name[8] = '\0';
+        section->virtual_size = read32(header + 8);
+        section->virtual_address = read32(header + 12);
+        section->raw_size = read32(header + 16);
+        section->raw_offset = read32(header + 20);
+        section->characteristics = read32(header + 36);
+        section->prot = section_prot(section->characteristics);
+        // 未初始化数据节没有文件内容
+        if (section->characteristics & BOX64_PE_SCN_CNT_UNINITIALIZED_DATA) {
+            section->raw_size = 0;
+        }
+    }
+    return validate_sections(image, size);
+}
+
+// MARK: - 映射
+
+bool box64_pe_range_free(const Box64MMU *mmu, uint64_t base, uint64_t size) {
+    if (!mmu || size == 0 || base < BOX64_PAGE_SIZE || base >= mmu->size || size > mmu->size - base) {
+        return false;
+    }
+    const uint64_t first = base >> BOX64_PAGE_SHIFT;
+    const uint64_t end = (base + size + BOX64_PAGE_OFFSET_MASK) >> BOX64_PAGE_SHIFT;
+    for (uint64_t page = first; page < end; page++) {
+        if (mmu->pages[page]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// 新映射的后备区页可能残留旧内容（后备区复用），清零；由文件映射提供的页不动
+static void zero_image(Box64MMU *mmu, uint64_t base, uint64_t size) {
+    for (uint64_t offset = 0; offset < size; offset += BOX64_PAGE_SIZE) {
+        const uint64_t address = base + offset;
+        uint8_t *host = box64_mmu_translate(mmu, address, BOX64_PAGE_SIZE, BOX64_ACCESS_WRITE);
+        if (host && host == mmu->backing + address) {
+            memset(host, 0, BOX64_PAGE_SIZE);
+        }
+    }
+}
+
+// 节能否直接映射文件页：客户机地址和文件偏移都按页对齐，且文件页不与之前直接映射的节共用
+// （同一私有映射上两个节共用文件页时，一个节的写入会出现在另一个节里）
+static uint32_t file_backed_pages(const Box64PESection *section, uint64_t *file_end) {
+    const uint32_t data = box64_pe_section_data_size(section);
+    if (data == 0 || (section->virtual_address & BOX64_PAGE_OFFSET_MASK) ||
+        (section->raw_offset & BOX64_PAGE_OFFSET_MASK) || section->raw_offset < *file_end) {
+        return 0;
+    }
+    const uint32_t pages = (uint32_t)(align_up(data, BOX64_PAGE_SIZE) >> BOX64_PAGE_SHIFT);
+    *file_end = (uint64_t)section->raw_offset + ((uint64_t)pages << BOX64_PAGE_SHIFT);
+    return pages;
+}
+
+// 应用一个宽度的修正；目标必须整体落在镜像内
+static bool apply_fixup(Box64MMU *mmu, const Box64PEImage *image, uint32_t rva, uint8_t type, uint64_t delta) {
+    const uint8_t width = type == BOX64_PE_REL_DIR64 ? 8 : (type == BOX64_PE_REL_HIGHLOW ? 4 : 2);
+    if ((uint64_t)rva + width > image->size_of_image) {
+        return false;
+    }
+    const uint64_t address = image->base + rva;
+    uint64_t value;
+    if (!box64_mmu_load(mmu, address, width, &value)) {
+        return false;
+    }
+    switch (type) {
+        case BOX64_PE_REL_HIGH:     value = (uint16_t)((((uint32_t)value << 16) + (uint32_t)delta) >> 16); break;
+        case BOX64_PE_REL_LOW:      value = (uint16_t)(value + delta); break;
+        case BOX64_PE_REL_HIGHLOW:  value = (uint32_t)(value + delta); break;
+        default:                    value += delta; break;
+    }
+    return box64_mmu_store(mmu, address, width, value);
+}
+
+// 重定位表是一串块：PageRVA(4) BlockSize(4) 后跟 (BlockSize-8)/2 个 类型(4位)|页内偏移(12位)
+static Box64PEStatus apply_relocations(Box64MMU *mmu, Box64PEImage *image) {
+    const uint64_t delta = image->base - image->preferred_base;
+    if (image->directory_count <= BOX64_PE_DIR_BASERELOC) {
+        return BOX64_PE_OK;
+    }
+    const Box64PEDataDirectory *directory = &image->directories[BOX64_PE_DIR_BASERELOC];
+    if (directory->rva == 0 || directory->size == 0) {
+        return BOX64_PE_OK;
+    }
+    if ((uint64_t)directory->rva + directory->size > image->size_of_image) {
+        return BOX64_PE_BAD_RELOCATION;
+    }
+
+    uint32_t offset = 0;
+    while (directory->size - offset >= 8) {
+        const uint64_t block = image->base + directory->rva + offset;
+        uint64_t page_rva, block_size;
+        if (!box64_mmu_load(mmu, block, 4, &page_rva) || !box64_mmu_load(mmu, block + 4, 4, &block_size)) {
+            return BOX64_PE_BAD_RELOCATION;
+        }
+        if (block_size < 8 || block_size > directory->size - offset) {
+            return BOX64_PE_BAD_RELOCATION;
+        }
+        for (uint64_t entry = 8; entry + 2 <= block_size; entry += 2) {
+            uint64_t value;
+            if (!box64_mmu_load(mmu, block + entry, 2, &value)) {
+                return BOX64_PE_BAD_RELOCATION;
+            }
+            const uint8_t type = (uint8_t)(value >> 12);
+            if (type == BOX64_PE_REL_ABSOLUTE) {
+                continue;   // 块尾对齐用的填充项
+            }
+            if (type != BOX64_PE_REL_HIGH && type != BOX64_PE_REL_LOW && type != BOX64_PE_REL_HIGHLOW &&
+                type != BOX64_PE_REL_DIR64) {
+                return BOX64_PE_BAD_RELOCATION;
+            }
+            if (!apply_fixup(mmu, image, (uint32_t)(page_rva + (value & 0xFFF)), type, delta)) {
+                return BOX64_PE_BAD_RELOCATION;
+            }
+            image->relocations_applied++;
+        }
+        offset += (uint32_t)block_size;
+    }
+    return BOX64_PE_OK;
+}
+
+// 头部只读，各节按属性；节之间未覆盖的页不可访问。SectionAlignment 小于页时同一页上的权限取并集
+static bool apply_protections(Box64MMU *mmu, const Box64PEImage *image) {
+    const uint64_t page_count = align_up(image->size_of_image, BOX64_PAGE_SIZE) >> BOX64_PAGE_SHIFT;
+    uint8_t *prots = calloc((size_t)page_count, 1);
+    if (!prots) {
+        return false;
+    }
+    const uint64_t header_pages = align_up(image->size_of_headers, BOX64_PAGE_SIZE) >> BOX64_PAGE_SHIFT;
+    for (uint64_t page = 0; page < header_pages && page < page_count; page++) {
+        prots[page] |= BOX64_PROT_READ;
+    }
+    for (uint16_t i = 0; i < image->section_count; i++) {
+        const Box64PESection *section = &image->sections[i];
+        const uint64_t first = section->virtual_address >> BOX64_PAGE_SHIFT;
+        const uint64_t end = align_up((uint64_t)section->virtual_address + box64_pe_section_span(image, section),
+                                      BOX64_PAGE_SIZE) >> BOX64_PAGE_SHIFT;
+        for (uint64_t page = first; page < end && page < page_count; page++) {
+            prots[page] |= (uint8_t)section->prot;
+        }
+    }
+
+    bool ok = true;
+    uint64_t run = 0;
+    for (uint64_t page = 1; page <= page_count && ok; page++) {
+        if (page == page_count || prots[page] != prots[run]) {
+            ok = box64_mmu_protect(mmu, image->base + (run << BOX64_PAGE_SHIFT), (page - run) << BOX64_PAGE_SHIFT,
+                                   prots[run]);
+            run = page;
+        }
+    }
+    free(prots);
+    return ok;
+}
+
+// mapping 非NULL时是整个文件的私有映射（file 指向它），对齐的节直接映射其中的页：
+// 只读的页始终与页缓存共享，写入（包括重定位）时才由内核按页复制
+static Box64PEStatus map_at_base(Box64MMU *mmu, const uint8_t *file, size_t size, Box64PEImage *image,
+                                 uint8_t *mapping) {
+    if (!box64_mmu_map(mmu, image->base, image->size_of_image, BOX64_PROT_READ | BOX64_PROT_WRITE)) {
+        return BOX64_PE_MAP_FAILED;
+    }
+
+    uint32_t backed[BOX64_PE_MAX_SECTIONS] = {0};
+    if (mapping) {
+        uint64_t file_end = align_up(image->size_of_headers, BOX64_PAGE_SIZE);
+        for (uint16_t i = 0; i < image->section_count; i++) {
+            const Box64PESection *section = &image->sections[i];
+            backed[i] = file_backed_pages(section, &file_end);
+            if (backed[i] && !box64_mmu_map_host(mmu, image->base + section->virtual_address,
+                                                 (uint64_t)backed[i] << BOX64_PAGE_SHIFT,
+                                                 mapping + section->raw_offset, BOX64_PROT_READ | BOX64_PROT_WRITE)) {
+                return BOX64_PE_MAP_FAILED;
+            }
+            image->file_backed_pages += backed[i];
+        }
+    }
+    zero_image(mmu, image->base, align_up(image->size_of_image, BOX64_PAGE_SIZE));
+
+    const uint64_t header_bytes = image->size_of_headers < size ? image->size_of_headers : size;
+    if (!box64_mmu_copy_to_guest(mmu, image->base, file, header_bytes)) {
+        return BOX64_PE_MAP_FAILED;
+    }
+    for (uint16_t i = 0; i < image->section_count; i++) {
+        const Box64PESection *section = &image->sections[i];
+        const uint32_t data = box64_pe_section_data_size(section);
+        if (data && !backed[i] && !box64_mmu_copy_to_guest(mmu, image->base + section->virtual_address,
+                                                           file + section->raw_offset, data)) {
+            return BOX64_PE_MAP_FAILED;
+        }
+    }
+
+    // 直接映射的节最后一页中超出节数据的部分必须读到0；放在所有复制之后，
+    // 因为复制的节可能正好取自这些文件字节。已经全为0的页不写，避免无谓的写时复制
+    for (uint16_t i = 0; i < image->section_count; i++) {
+        const Box64PESection *section = &image->sections[i];
+        const uint32_t data = box64_pe_section_data_size(section);
+        const uint32_t used = data & BOX64_PAGE_OFFSET_MASK;
+        if (!backed[i] || used == 0) {
+            continue;
+        }
+        uint8_t *tail = mapping + section->raw_offset + ((uint64_t)(backed[i] - 1) << BOX64_PAGE_SHIFT) + used;
+        const size_t length = BOX64_PAGE_SIZE - used;
+        for (size_t j = 0; j < length; j++) {
+            if (tail[j]) {
+                memset(tail, 0, length);
+                break;
+            }
+        }
+    }
+
+    if (image->relocated) {
+        Box64PEStatus status = apply_relocations(mmu, image);
+        if (status != BOX64_PE_OK) {
+            return status;
+        }
+    }
+    return apply_protections(mmu, image) ? BOX64_PE_OK : BOX64_PE_MAP_FAILED;
+}
+
+static Box64PEStatus map_image(Box64MMU *mmu, const uint8_t *file, size_t size, Box64PEImage *image,
+                               uint64_t fallback_base, uint8_t *mapping) {
+    if (!mmu || !file || !image || image->size_of_image == 0) {
+        return BOX64_PE_MAP_FAILED;
+    }
+
+    image->base = image->preferred_base;
+    image->relocated = false;
+    image->relocations_applied = 0;
+    image->file_backed_pages = 0;
+    const bool preferred_free = box64_pe_range_free(mmu, image->preferred_base, image->size_of_image);
+    if (!preferred_free) {
+        const uint64_t limit = image->pe32_plus ? UINT64_MAX : 0x100000000ULL;
+        if (fallback_base == 0 || (image->characteristics & BOX64_PE_FILE_RELOCS_STRIPPED) ||
+            fallback_base > limit - image->size_of_image) {
+            return BOX64_PE_BASE_UNAVAILABLE;
+        }
+        image->base = fallback_base;
+        image->relocated = fallback_base != image->preferred_base;
+    }
+
+    Box64PEStatus status = map_at_base(mmu, file, size, image, mapping);
+    if (status != BOX64_PE_OK) {
+        if (preferred_free) {
+            box64_mmu_unmap(mmu, image->base, image->size_of_image);
+        }
+        return status;
+    }
+    image->entry_point = image->entry_rva ? image->base + image->entry_rva : 0;
+    return BOX64_PE_OK;
+}
+
+Box64PEStatus box64_pe_map(Box64MMU *mmu, const uint8_t *file, size_t size, Box64PEImage *image,
+                           uint64_t fallback_base) {
+    return map_image(mmu, file, size, image, fallback_base, NULL);
+}
+
+// MARK: - 文件映射
+
+bool box64_pe_file_open(const char *path, Box64PEFile *file) {
+    if (!path || !file) {
+        return false;
+    }
+    memset(file, 0, sizeof(*file));
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size <= 0 || (uint64_t)info.st_size > SIZE_MAX) {
+        close(fd);
+        return false;
+    }
+    // 私有可写映射：文件以只读打开，写入只产生进程内的副本，不会回写磁盘
+    void *data = mmap(NULL, (size_t)info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+    file->data = data;
+    file->size = (size_t)info.st_size;
+    return true;
+}
+
+void box64_pe_file_close(Box64PEFile *file) {
+    if (!file || !file->data) {
+        return;
+    }
+    munmap(file->data, file->size);
+    memset(file, 0, sizeof(*file));
+}
+
+Box64PEStatus box64_pe_map_file(Box64MMU *mmu, Box64PEFile *file, Box64PEImage *image, uint64_t fallback_base) {
+    if (!file || !file->data) {
+        return BOX64_PE_MAP_FAILED;
+    }
+    return map_image(mmu, file->data, file->size, image, fallback_base, file->data);
+}
+
+const char *box64_pe_status_string(Box64PEStatus status) {
+    switch (status) {
+        case BOX64_PE_OK:                   return "ok";
+        case BOX64_PE_TRUNCATED:            return "truncated headers";
+        case BOX64_PE_BAD_DOS_HEADER:       return "bad DOS header";
+        case BOX64_PE_BAD_SIGNATURE:        return "bad PE signature";
+        case BOX64_PE_BAD_OPTIONAL_HEADER:  return "bad optional header";
+        case BOX64_PE_BAD_SECTION:          return "bad section table";
+        case BOX64_PE_BASE_UNAVAILABLE:     return "image base unavailable";
+        case BOX64_PE_BAD_RELOCATION:       return "bad base relocation";
+        case BOX64_PE_MAP_FAILED:           return "guest mapping failed";
+    }
+    return "unknown";
+}
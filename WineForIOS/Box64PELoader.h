@@ -0,0 +1,155 @@
+// Box64PELoader.h - PE32/PE32+ 镜像加载器
+// 纯C实现，把PE文件按节映射到客户机地址空间（Box64MMU）：
+//   解析DOS头、COFF头、可选头和节表，所有字段都先做边界检查
+//   头部和每个节复制到 base + VirtualAddress，文件中没有的部分（BSS、节尾）清零
+//   首选基址 [ImageBase, ImageBase+SizeOfImage) 已被占用时改用调用方给出的备用基址并应用基址重定位
+//   最后按节属性设置页权限（头部只读），入口点为 base + AddressOfEntryPoint
+// 从文件加载时整个文件以私有（写时复制）方式 mmap，客户机地址和文件偏移都按页对齐的节
+// 直接映射文件页而不复制：加载只花费实际访问到的页，写入（含重定位）时由内核按页复制
+// 导入表不在这里处理，镜像的数据目录原样保留给上层
+#ifndef BOX64_PE_LOADER_H
+#define BOX64_PE_LOADER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "Box64MMU.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BOX64_PE_MAX_SECTIONS       96      // Windows加载器允许的上限
+#define BOX64_PE_MAX_DIRECTORIES    16
+
+#define BOX64_PE_MACHINE_I386       0x014C
+#define BOX64_PE_MACHINE_AMD64      0x8664
+
+// COFF Characteristics
+#define BOX64_PE_FILE_RELOCS_STRIPPED   0x0001
+#define BOX64_PE_FILE_EXECUTABLE        0x0002
+#define BOX64_PE_FILE_DLL               0x2000
+
+// 节 Characteristics
+#define BOX64_PE_SCN_CNT_CODE               0x00000020
+#define BOX64_PE_SCN_CNT_UNINITIALIZED_DATA 0x00000080
+#define BOX64_PE_SCN_MEM_EXECUTE            0x20000000
+#define BOX64_PE_SCN_MEM_READ               0x40000000
+#define BOX64_PE_SCN_MEM_WRITE              0x80000000
+
+// 数据目录下标
+enum {
+    BOX64_PE_DIR_EXPORT = 0,
+    BOX64_PE_DIR_IMPORT = 1,
+    BOX64_PE_DIR_RESOURCE = 2,
+    BOX64_PE_DIR_EXCEPTION = 3,
+    BOX64_PE_DIR_BASERELOC = 5,
+    BOX64_PE_DIR_TLS = 9,
+    BOX64_PE_DIR_IAT = 12
+};
+
+// 基址重定位类型
+enum {
+    BOX64_PE_REL_ABSOLUTE = 0,
+    BOX64_PE_REL_HIGH = 1,
+    BOX64_PE_REL_LOW = 2,
+    BOX64_PE_REL_HIGHLOW = 3,
+    BOX64_PE_REL_DIR64 = 10
+};
+
+typedef enum Box64PEStatus {
+    BOX64_PE_OK = 0,
+    BOX64_PE_TRUNCATED,             // 头部或节表超出文件
+    BOX64_PE_BAD_DOS_HEADER,
+    BOX64_PE_BAD_SIGNATURE,
+    BOX64_PE_BAD_OPTIONAL_HEADER,   // Magic、对齐、SizeOfImage/SizeOfHeaders 不合理
+    BOX64_PE_BAD_SECTION,           // 节超出镜像、未按地址递增排列/重叠，或要复制的原始数据超出文件
+    BOX64_PE_BASE_UNAVAILABLE,      // 首选基址被占用且无法重定位（无备用基址或 RELOCS_STRIPPED）
+    BOX64_PE_BAD_RELOCATION,        // 重定位块越界或类型不支持
+    BOX64_PE_MAP_FAILED             // MMU拒绝映射（超出客户机地址空间）
+} Box64PEStatus;
+
+typedef struct Box64PEDataDirectory {
+    uint32_t rva;
+    uint32_t size;
+} Box64PEDataDirectory;
+
+typedef struct Box64PESection {
+    char name[9];                   // 以NUL结尾
+    uint32_t virtual_address;
+    uint32_t virtual_size;          // 为0时按 raw_size 处理
+    uint32_t raw_offset;
+    uint32_t raw_size;
+    uint32_t characteristics;
+    uint32_t prot;                  // 由 characteristics 换算的 BOX64_PROT_*
+} Box64PESection;
+
+typedef struct Box64PEImage {
+    uint16_t machine;
+    uint16_t characteristics;
+    uint16_t subsystem;
+    uint16_t dll_characteristics;
+    bool pe32_plus;
+
+    uint64_t preferred_base;        // 可选头中的 ImageBase
+    uint64_t base;                  // 实际加载基址（box64_pe_map 之后有效）
+    uint32_t size_of_image;
+    uint32_t size_of_headers;
+    uint32_t section_alignment;
+    uint32_t file_alignment;
+    uint32_t entry_rva;
+    uint64_t entry_point;           // base + entry_rva，entry_rva 为0时为0
+    uint64_t stack_reserve;
+    uint64_t stack_commit;
+
+    uint32_t directory_count;
+    Box64PEDataDirectory directories[BOX64_PE_MAX_DIRECTORIES];
+
+    uint16_t section_count;
+    Box64PESection sections[BOX64_PE_MAX_SECTIONS];
+
+    bool relocated;
+    uint32_t relocations_applied;
+    uint32_t file_backed_pages;     // 直接映射文件页（未复制）的客户机页数
+} Box64PEImage;
+
+// 整个PE文件的私有映射；映射了其中页的镜像卸载（解除客户机映射）之前不能关闭
+typedef struct Box64PEFile {
+    uint8_t *data;
+    size_t size;
+} Box64PEFile;
+
+// 只解析和校验，不访问MMU；失败时 image 内容未定义
+Box64PEStatus box64_pe_parse(const uint8_t *file, size_t size, Box64PEImage *image);
+
+// [base, base+size) 在地址空间内、不含零页且每一页都未映射
+bool box64_pe_range_free(const Box64MMU *mmu, uint64_t base, uint64_t size);
+
+// 映射已解析的镜像：首选基址空闲时直接使用，否则使用 fallback_base（0表示没有备用基址）
+// 备用区间由调用方保留，可以已被映射（例如从客户机堆分配），其内容会被覆盖
+// 失败时首选基址上建立的映射会被解除；备用区间仍归调用方回收
+Box64PEStatus box64_pe_map(Box64MMU *mmu, const uint8_t *file, size_t size, Box64PEImage *image,
+                           uint64_t fallback_base);
+
+bool box64_pe_file_open(const char *path, Box64PEFile *file);
+void box64_pe_file_close(Box64PEFile *file);
+
+// 与 box64_pe_map 相同，但对齐的节直接映射 file 中的页（先用 file->data/size 调用 box64_pe_parse）
+Box64PEStatus box64_pe_map_file(Box64MMU *mmu, Box64PEFile *file, Box64PEImage *image, uint64_t fallback_base);
+
+// 按RVA查找所在的节，不在任何节内返回NULL
+const Box64PESection *box64_pe_section_for_rva(const Box64PEImage *image, uint32_t rva);
+
+// 节从文件取得的字节数：SizeOfRawData 超过 VirtualSize 的部分不映射
+uint32_t box64_pe_section_data_size(const Box64PESection *section);
+
+// 节在镜像中占用的字节数：VirtualSize（为0时用 SizeOfRawData）按 SectionAlignment 取整
+uint32_t box64_pe_section_span(const Box64PEImage *image, const Box64PESection *section);
+
+const char *box64_pe_status_string(Box64PEStatus status);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BOX64_PE_LOADER_H
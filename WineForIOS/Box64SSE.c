@@ -0,0 +1,625 @@
+// Box64SSE.c - SSE/SSE2 分类表与执行
+// 打包运算的内核按宿主架构二选一：arm64 用 NEON，x86-64 用 SSE2，两套内核的函数名与语义相同；
+// 洗牌类指令（PSHUFD/SHUFPS/SHUFPD）的立即数到运行时才知道，两边都按通道复制
+#include "Box64SSE.h"
+#include "Box64Flags.h"
+#include "Box64Interp.h"
+#include <math.h>
+#include <string.h>
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#define BOX64_SSE_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define BOX64_SSE_X86 1
+#else
+#error "Box64SSE 需要 arm64 NEON 或 x86-64 SSE2"
+#endif
+
+// MARK: - 分类
+
+#define OP_NAME(name) #name,
+static const char *const op_names[BOX64_SSE_OP_COUNT] = { BOX64_SSE_OPS(OP_NAME) };
+#undef OP_NAME
+
+#define S(name) BOX64_SSE_##name
+#define ROW(none, p66, pf3, pf2) { S(none), S(p66), S(pf3), S(pf2) }
+
+// [操作码][强制前缀：无 / 66 / F3 / F2]；整数形式（66前缀）的位运算与 ANDPS 等共用同一内核
+static const uint8_t classify_table[256][4] = {
+    [0x10] = ROW(MOVUPS_LOAD, MOVUPS_LOAD, MOVSS_LOAD, MOVSD_LOAD),
+    [0x11] = ROW(MOVUPS_STORE, MOVUPS_STORE, MOVSS_STORE, MOVSD_STORE),
+    [0x28] = ROW(MOVAPS_LOAD, MOVAPS_LOAD, NONE, NONE),
+    [0x29] = ROW(MOVAPS_STORE, MOVAPS_STORE, NONE, NONE),
+    [0x2A] = ROW(NONE, NONE, CVTSI2SS, CVTSI2SD),
+    [0x2B] = ROW(MOVNT_STORE, MOVNT_STORE, NONE, NONE),
+    [0x2C] = ROW(NONE, NONE, CVTTSS2SI, CVTTSD2SI),
+    [0x2D] = ROW(NONE, NONE, CVTSS2SI, CVTSD2SI),
+    [0x2E] = ROW(COMISS, COMISD, NONE, NONE),
+    [0x2F] = ROW(COMISS, COMISD, NONE, NONE),
+    [0x51] = ROW(SQRTPS, SQRTPD, SQRTSS, SQRTSD),
+    [0x54] = ROW(ANDPS, ANDPS, NONE, NONE),
+    [0x55] = ROW(ANDNPS, ANDNPS, NONE, NONE),
+    [0x56] = ROW(ORPS, ORPS, NONE, NONE),
+    [0x57] = ROW(XORPS, XORPS, NONE, NONE),
+    [0x58] = ROW(ADDPS, ADDPD, ADDSS, ADDSD),
+    [0x59] = ROW(MULPS, MULPD, MULSS, MULSD),
+    [0x5A] = ROW(CVTPS2PD, CVTPD2PS, CVTSS2SD, CVTSD2SS),
+    [0x5B] = ROW(CVTDQ2PS, CVTPS2DQ, CVTTPS2DQ, NONE),
+    [0x5C] = ROW(SUBPS, SUBPD, SUBSS, SUBSD),
+    [0x5D] = ROW(MINPS, MINPD, MINSS, MINSD),
+    [0x5E] = ROW(DIVPS, DIVPD, DIVSS, DIVSD),
+    [0x5F] = ROW(MAXPS, MAXPD, MAXSS, MAXSD),
+    [0x6E] = ROW(NONE, MOVD_TO_XMM, NONE, NONE),
+    [0x6F] = ROW(NONE, MOVAPS_LOAD, MOVUPS_LOAD, NONE),         // MOVDQA / MOVDQU
+    [0x70] = ROW(NONE, PSHUFD, NONE, NONE),
+    [0x74] = ROW(NONE, PCMPEQB, NONE, NONE),
+    [0x75] = ROW(NONE, PCMPEQW, NONE, NONE),
+    [0x76] = ROW(NONE, PCMPEQD, NONE, NONE),
+    [0x7E] = ROW(NONE, MOVD_FROM_XMM, MOVQ_LOAD, NONE),
+    [0x7F] = ROW(NONE, MOVAPS_STORE, MOVUPS_STORE, NONE),       // MOVDQA / MOVDQU
+    [0xC6] = ROW(SHUFPS, SHUFPD, NONE, NONE),
+    [0xD4] = ROW(NONE, PADDQ, NONE, NONE),
+    [0xD6] = ROW(NONE, MOVQ_STORE, NONE, NONE),
+    [0xD7] = ROW(NONE, PMOVMSKB, NONE, NONE),
+    [0xDB] = ROW(NONE, ANDPS, NONE, NONE),                      // PAND
+    [0xDF] = ROW(NONE, ANDNPS, NONE, NONE),                     // PANDN
+    [0xE7] = ROW(NONE, MOVNT_STORE, NONE, NONE),                // MOVNTDQ
+    [0xEB] = ROW(NONE, ORPS, NONE, NONE),                       // POR
+    [0xEF] = ROW(NONE, XORPS, NONE, NONE),                      // PXOR
+    [0xF8] = ROW(NONE, PSUBB, NONE, NONE),
+    [0xF9] = ROW(NONE, PSUBW, NONE, NONE),
+    [0xFA] = ROW(NONE, PSUBD, NONE, NONE),
+    [0xFB] = ROW(NONE, PSUBQ, NONE, NONE),
+    [0xFC] = ROW(NONE, PADDB, NONE, NONE),
+    [0xFD] = ROW(NONE, PADDW, NONE, NONE),
+    [0xFE] = ROW(NONE, PADDD, NONE, NONE),
+};
+
+#undef ROW
+#undef S
+
+Box64SseOp box64_sse_classify(const X86DecodedInsn *insn) {
+    if (insn->map != X86_MAP_0F || (insn->prefixes & X86_PREFIX_LOCK)) {
+        return BOX64_SSE_NONE;
+    }
+    unsigned column;
+    switch (insn->mandatory_prefix) {
+        case 0x66: column = 1; break;
+        case 0xF3: column = 2; break;
+        case 0xF2: column = 3; break;
+        default:   column = 0; break;
+    }
+    const Box64SseOp op = (Box64SseOp)classify_table[insn->opcode][column];
+    const bool memory = x86_insn_is_memory(insn);
+    // 只有内存形式的非临时存储；PMOVMSKB 只有寄存器形式
+    if ((op == BOX64_SSE_MOVNT_STORE && !memory) || (op == BOX64_SSE_PMOVMSKB && memory)) {
+        return BOX64_SSE_NONE;
+    }
+    return op;
+}
+
+uint8_t box64_sse_memory_size(Box64SseOp op, const X86DecodedInsn *insn) {
+    if (!x86_insn_is_memory(insn)) {
+        return 0;
+    }
+    switch (op) {
+        case BOX64_SSE_MOVSS_LOAD: case BOX64_SSE_MOVSS_STORE:
+        case BOX64_SSE_ADDSS: case BOX64_SSE_SUBSS: case BOX64_SSE_MULSS: case BOX64_SSE_DIVSS:
+        case BOX64_SSE_MINSS: case BOX64_SSE_MAXSS: case BOX64_SSE_SQRTSS:
+        case BOX64_SSE_COMISS: case BOX64_SSE_CVTSS2SD: case BOX64_SSE_CVTTSS2SI: case BOX64_SSE_CVTSS2SI:
+            return 4;
+        case BOX64_SSE_MOVSD_LOAD: case BOX64_SSE_MOVSD_STORE: case BOX64_SSE_MOVQ_LOAD: case BOX64_SSE_MOVQ_STORE:
+        case BOX64_SSE_ADDSD: case BOX64_SSE_SUBSD: case BOX64_SSE_MULSD: case BOX64_SSE_DIVSD:
+        case BOX64_SSE_MINSD: case BOX64_SSE_MAXSD: case BOX64_SSE_SQRTSD:
+        case BOX64_SSE_COMISD: case BOX64_SSE_CVTSD2SS: case BOX64_SSE_CVTTSD2SI: case BOX64_SSE_CVTSD2SI:
+        case BOX64_SSE_CVTPS2PD:
+            return 8;
+        case BOX64_SSE_MOVD_TO_XMM: case BOX64_SSE_MOVD_FROM_XMM:
+        case BOX64_SSE_CVTSI2SS: case BOX64_SSE_CVTSI2SD:
+            return X86_REX_W(insn->rex) ? 8 : 4;
+        case BOX64_SSE_NONE: case BOX64_SSE_PMOVMSKB: case BOX64_SSE_OP_COUNT:
+            return 0;
+        default:
+            return 16;
+    }
+}
+
+const char *box64_sse_op_name(Box64SseOp op) {
+    return op < BOX64_SSE_OP_COUNT ? op_names[op] : "?";
+}
+
+void box64_sse_reset(Box64Context *ctx) {
+    memset(ctx->xmm, 0, sizeof(ctx->xmm));
+    ctx->mxcsr = BOX64_MXCSR_DEFAULT;
+}
+
+// MARK: - 打包内核
+
+#if BOX64_SSE_NEON
+
+#define BIN(name, field, sfx, expr) \
+static inline void name(Box64Xmm *d, const Box64Xmm *s) { \
+    const __typeof__(vld1q_##sfx(d->field)) a = vld1q_##sfx(d->field), b = vld1q_##sfx(s->field); \
+    vst1q_##sfx(d->field, expr); \
+}
+
+BIN(k_and,    u8,  u8,  vandq_u8(a, b))
+BIN(k_andn,   u8,  u8,  vbicq_u8(b, a))
+BIN(k_or,     u8,  u8,  vorrq_u8(a, b))
+BIN(k_xor,    u8,  u8,  veorq_u8(a, b))
+BIN(k_add8,   u8,  u8,  vaddq_u8(a, b))
+BIN(k_add16,  u16, u16, vaddq_u16(a, b))
+BIN(k_add32,  u32, u32, vaddq_u32(a, b))
+BIN(k_add64,  u64, u64, vaddq_u64(a, b))
+BIN(k_sub8,   u8,  u8,  vsubq_u8(a, b))
+BIN(k_sub16,  u16, u16, vsubq_u16(a, b))
+BIN(k_sub32,  u32, u32, vsubq_u32(a, b))
+BIN(k_sub64,  u64, u64, vsubq_u64(a, b))
+BIN(k_cmpeq8,  u8,  u8,  vceqq_u8(a, b))
+BIN(k_cmpeq16, u16, u16, vceqq_u16(a, b))
+BIN(k_cmpeq32, u32, u32, vceqq_u32(a, b))
+BIN(k_addps,  f32, f32, vaddq_f32(a, b))
+BIN(k_subps,  f32, f32, vsubq_f32(a, b))
+BIN(k_mulps,  f32, f32, vmulq_f32(a, b))
+BIN(k_divps,  f32, f32, vdivq_f32(a, b))
+// x86 MIN/MAX：比较不成立（含NaN、±0相等）时取第二个操作数；FMIN/FMAX 的NaN传播不同，用比较+选择
+BIN(k_minps,  f32, f32, vbslq_f32(vcltq_f32(a, b), a, b))
+BIN(k_maxps,  f32, f32, vbslq_f32(vcgtq_f32(a, b), a, b))
+BIN(k_addpd,  f64, f64, vaddq_f64(a, b))
+BIN(k_subpd,  f64, f64, vsubq_f64(a, b))
+BIN(k_mulpd,  f64, f64, vmulq_f64(a, b))
+BIN(k_divpd,  f64, f64, vdivq_f64(a, b))
+BIN(k_minpd,  f64, f64, vbslq_f64(vcltq_f64(a, b), a, b))
+BIN(k_maxpd,  f64, f64, vbslq_f64(vcgtq_f64(a, b), a, b))
+
+static inline void k_sqrtps(Box64Xmm *d, const Box64Xmm *s) {
+    vst1q_f32(d->f32, vsqrtq_f32(vld1q_f32(s->f32)));
+}
+
+static inline void k_sqrtpd(Box64Xmm *d, const Box64Xmm *s) {
+    vst1q_f64(d->f64, vsqrtq_f64(vld1q_f64(s->f64)));
+}
+
+static inline uint32_t k_pmovmskb(const Box64Xmm *s) {
+    static const int8_t shifts[16] = { 0, 1, 2, 3, 4, 5, 6, 7, 0, 1, 2, 3, 4, 5, 6, 7 };
+    const uint8x16_t bits = vshlq_u8(vshrq_n_u8(vld1q_u8(s->u8), 7), vld1q_s8(shifts));
+    return (uint32_t)vaddv_u8(vget_low_u8(bits)) | ((uint32_t)vaddv_u8(vget_high_u8(bits)) << 8);
+}
+
+static inline void k_cvtdq2ps(Box64Xmm *d, const Box64Xmm *s) {
+    vst1q_f32(d->f32, vcvtq_f32_s32(vld1q_s32(s->i32)));
+}
+
+// FCVT* 越界时饱和，x86 返回整数不定值 0x80000000（NaN 同样）
+static inline int32x4_t fix_indefinite(float32x4_t value, int32x4_t converted) {
+    const uint32x4_t in_range = vandq_u32(vcgeq_f32(value, vdupq_n_f32(-2147483648.0f)),
+                                          vcltq_f32(value, vdupq_n_f32(2147483648.0f)));
+    return vbslq_s32(in_range, converted, vdupq_n_s32(INT32_MIN));
+}
+
+static inline void k_cvttps2dq(Box64Xmm *d, const Box64Xmm *s) {
+    const float32x4_t value = vld1q_f32(s->f32);
+    vst1q_s32(d->i32, fix_indefinite(value, vcvtq_s32_f32(value)));
+}
+
+static inline void k_cvtps2dq(Box64Xmm *d, const Box64Xmm *s, uint32_t rc) {
+    const float32x4_t value = vld1q_f32(s->f32);
+    int32x4_t converted;
+    switch (rc) {
+        case 0:  converted = vcvtnq_s32_f32(value); break;
+        case 1:  converted = vcvtmq_s32_f32(value); break;
+        case 2:  converted = vcvtpq_s32_f32(value); break;
+        default: converted = vcvtq_s32_f32(value); break;
+    }
+    vst1q_s32(d->i32, fix_indefinite(value, converted));
+}
+
+static inline void k_cvtps2pd(Box64Xmm *d, const Box64Xmm *s) {
+    vst1q_f64(d->f64, vcvt_f64_f32(vld1_f32(s->f32)));
+}
+
+static inline void k_cvtpd2ps(Box64Xmm *d, const Box64Xmm *s) {
+    vst1q_f32(d->f32, vcombine_f32(vcvt_f32_f64(vld1q_f64(s->f64)), vdup_n_f32(0.0f)));
+}
+
+static inline void k_copy(Box64Xmm *d, const Box64Xmm *s) {
+    vst1q_u8(d->u8, vld1q_u8(s->u8));
+}
+
+#undef BIN
+
+#else // BOX64_SSE_X86
+
+#define LOADI(x)  _mm_load_si128((const __m128i *)(x)->u8)
+#define STOREI(x, v) _mm_store_si128((__m128i *)(x)->u8, (v))
+
+#define BIN_I(name, fn) \
+static inline void name(Box64Xmm *d, const Box64Xmm *s) { STOREI(d, fn(LOADI(d), LOADI(s))); }
+#define BIN_PS(name, fn) \
+static inline void name(Box64Xmm *d, const Box64Xmm *s) { _mm_store_ps(d->f32, fn(_mm_load_ps(d->f32), _mm_load_ps(s->f32))); }
+#define BIN_PD(name, fn) \
+static inline void name(Box64Xmm *d, const Box64Xmm *s) { _mm_store_pd(d->f64, fn(_mm_load_pd(d->f64), _mm_load_pd(s->f64))); }
+
+// _mm_andnot_si128(a, b) = ~a & b，与 ANDNPS/PANDN 的操作数顺序相同
+BIN_I(k_and,     _mm_and_si128)
+BIN_I(k_andn,    _mm_andnot_si128)
+BIN_I(k_or,      _mm_or_si128)
+BIN_I(k_xor,     _mm_xor_si128)
+BIN_I(k_add8,    _mm_add_epi8)
+BIN_I(k_add16,   _mm_add_epi16)
+BIN_I(k_add32,   _mm_add_epi32)
+BIN_I(k_add64,   _mm_add_epi64)
+BIN_I(k_sub8,    _mm_sub_epi8)
+BIN_I(k_sub16,   _mm_sub_epi16)
+BIN_I(k_sub32,   _mm_sub_epi32)
+BIN_I(k_sub64,   _mm_sub_epi64)
+BIN_I(k_cmpeq8,  _mm_cmpeq_epi8)
+BIN_I(k_cmpeq16, _mm_cmpeq_epi16)
+BIN_I(k_cmpeq32, _mm_cmpeq_epi32)
+BIN_PS(k_addps,  _mm_add_ps)
+BIN_PS(k_subps,  _mm_sub_ps)
+BIN_PS(k_mulps,  _mm_mul_ps)
+BIN_PS(k_divps,  _mm_div_ps)
+BIN_PS(k_minps,  _mm_min_ps)
+BIN_PS(k_maxps,  _mm_max_ps)
+BIN_PD(k_addpd,  _mm_add_pd)
+BIN_PD(k_subpd,  _mm_sub_pd)
+BIN_PD(k_mulpd,  _mm_mul_pd)
+BIN_PD(k_divpd,  _mm_div_pd)
+BIN_PD(k_minpd,  _mm_min_pd)
+BIN_PD(k_maxpd,  _mm_max_pd)
+
+static inline void k_sqrtps(Box64Xmm *d, const Box64Xmm *s) {
+    _mm_store_ps(d->f32, _mm_sqrt_ps(_mm_load_ps(s->f32)));
+}
+
+static inline void k_sqrtpd(Box64Xmm *d, const Box64Xmm *s) {
+    _mm_store_pd(d->f64, _mm_sqrt_pd(_mm_load_pd(s->f64)));
+}
+
+static inline uint32_t k_pmovmskb(const Box64Xmm *s) {
+    return (uint32_t)_mm_movemask_epi8(LOADI(s));
+}
+
+static inline void k_cvtdq2ps(Box64Xmm *d, const Box64Xmm *s) {
+    _mm_store_ps(d->f32, _mm_cvtepi32_ps(LOADI(s)));
+}
+
+static inline void k_cvttps2dq(Box64Xmm *d, const Box64Xmm *s) {
+    STOREI(d, _mm_cvttps_epi32(_mm_load_ps(s->f32)));
+}
+
+// 宿主 MXCSR 保持就近舍入；客户机选了其他舍入模式时逐通道转换
+static inline void k_cvtps2dq(Box64Xmm *d, const Box64Xmm *s, uint32_t rc) {
+    if (rc == 0) {
+        STOREI(d, _mm_cvtps_epi32(_mm_load_ps(s->f32)));
+        return;
+    }
+    for (int lane = 0; lane < 4; lane++) {
+        const float value = s->f32[lane];
+        const float rounded = rc == 1 ? floorf(value) : (rc == 2 ? ceilf(value) : truncf(value));
+        d->i32[lane] = (rounded >= -2147483648.0f && rounded < 2147483648.0f) ? (int32_t)rounded : INT32_MIN;
+    }
+}
+
+static inline void k_cvtps2pd(Box64Xmm *d, const Box64Xmm *s) {
+    _mm_store_pd(d->f64, _mm_cvtps_pd(_mm_load_ps(s->f32)));
+}
+
+static inline void k_cvtpd2ps(Box64Xmm *d, const Box64Xmm *s) {
+    _mm_store_ps(d->f32, _mm_cvtpd_ps(_mm_load_pd(s->f64)));
+}
+
+static inline void k_copy(Box64Xmm *d, const Box64Xmm *s) {
+    STOREI(d, LOADI(s));
+}
+
+#undef BIN_I
+#undef BIN_PS
+#undef BIN_PD
+
+#endif
+
+// 洗牌：按立即数逐通道选择，先读出两个源再写，dst 与 src 可以是同一寄存器
+static inline void k_pshufd(Box64Xmm *d, const Box64Xmm *s, uint8_t imm) {
+    const Box64Xmm in = *s;
+    for (int lane = 0; lane < 4; lane++) {
+        d->u32[lane] = in.u32[(imm >> (lane * 2)) & 3];
+    }
+}
+
+static inline void k_shufps(Box64Xmm *d, const Box64Xmm *s, uint8_t imm) {
+    const Box64Xmm a = *d, b = *s;
+    d->u32[0] = a.u32[imm & 3];
+    d->u32[1] = a.u32[(imm >> 2) & 3];
+    d->u32[2] = b.u32[(imm >> 4) & 3];
+    d->u32[3] = b.u32[(imm >> 6) & 3];
+}
+
+static inline void k_shufpd(Box64Xmm *d, const Box64Xmm *s, uint8_t imm) {
+    const Box64Xmm a = *d, b = *s;
+    d->u64[0] = a.u64[imm & 1];
+    d->u64[1] = b.u64[(imm >> 1) & 1];
+}
+
+// MARK: - 标量辅助
+
+static inline float min_f32(float a, float b) { return a < b ? a : b; }
+static inline float max_f32(float a, float b) { return a > b ? a : b; }
+static inline double min_f64(double a, double b) { return a < b ? a : b; }
+static inline double max_f64(double a, double b) { return a > b ? a : b; }
+
+// 浮点 → 32/64位整数；rc 为 MXCSR 舍入模式，截断形式传3；越界与NaN得到整数不定值
+static uint64_t convert_to_integer(double value, uint8_t size, uint32_t rc) {
+    double rounded;
+    switch (rc) {
+        case 0:  rounded = nearbyint(value); break;
+        case 1:  rounded = floor(value); break;
+        case 2:  rounded = ceil(value); break;
+        default: rounded = trunc(value); break;
+    }
+    if (size == 8) {
+        if (!(rounded >= -9223372036854775808.0 && rounded < 9223372036854775808.0)) {
+            return 0x8000000000000000ULL;
+        }
+        return (uint64_t)(int64_t)rounded;
+    }
+    if (!(rounded >= -2147483648.0 && rounded < 2147483648.0)) {
+        return 0x80000000ULL;
+    }
+    return (uint32_t)(int32_t)rounded;
+}
+
+// COMISS/UCOMISS：无序 ZF=PF=CF=1，小于 CF=1，等于 ZF=1，OF/SF/AF 清零
+static inline void set_compare_flags(Box64Context *ctx, bool unordered, bool less, bool equal) {
+    uint64_t flags = 0;
+    if (unordered) {
+        flags = X86_FLAG_ZF | X86_FLAG_PF | X86_FLAG_CF;
+    } else if (less) {
+        flags = X86_FLAG_CF;
+    } else if (equal) {
+        flags = X86_FLAG_ZF;
+    }
+    box64_flags_set(ctx, (ctx->rflags & ~(uint64_t)X86_FLAGS_ARITH) | flags);
+}
+
+// MARK: - 访存
+
+static inline bool guest_read(Box64Context *ctx, uint64_t address, uint8_t size, Box64Xmm *out) {
+    const uint8_t *host = box64_mmu_translate(&ctx->mmu, address, size, BOX64_ACCESS_READ);
+    if (host) {
+        memcpy(out->u8, host, size);
+        return true;
+    }
+    return box64_mmu_crosses_page(address, size) && box64_mmu_copy_from_guest(&ctx->mmu, out->u8, address, size);
+}
+
+static inline bool guest_write(Box64Context *ctx, uint64_t address, uint8_t size, const void *data) {
+    uint8_t *host = box64_mmu_translate(&ctx->mmu, address, size, BOX64_ACCESS_WRITE);
+    if (host) {
+        memcpy(host, data, size);
+        return true;
+    }
+    return box64_mmu_crosses_page(address, size) && box64_mmu_copy_to_guest(&ctx->mmu, address, data, size);
+}
+
+// 传统SSE编码下，除 MOVUPS/MOVUPD/MOVDQU 外的16字节内存操作数都要求对齐
+static inline bool requires_alignment(Box64SseOp op) {
+    return op != BOX64_SSE_MOVUPS_LOAD && op != BOX64_SSE_MOVUPS_STORE;
+}
+
+// MARK: - 执行
+
+Box64SseStatus box64_sse_execute(Box64Context *ctx, const X86DecodedInsn *insn, Box64SseOp op,
+                                 uint64_t next_address, uint64_t *fault_address) {
+    const bool memory = x86_insn_is_memory(insn);
+    const uint8_t size = box64_sse_memory_size(op, insn);
+    const uint64_t address = memory ? box64_effective_address(ctx, insn, next_address) : 0;
+    const uint8_t imm = (uint8_t)insn->imm;
+    const uint32_t rc = (ctx->mxcsr & BOX64_MXCSR_RC_MASK) >> BOX64_MXCSR_RC_SHIFT;
+    const bool has_rex = insn->rex != 0;
+    Box64Xmm *const reg = &ctx->xmm[insn->reg & 15];
+
+    if (op == BOX64_SSE_NONE || op >= BOX64_SSE_OP_COUNT) {
+        return BOX64_SSE_UNSUPPORTED;
+    }
+    if (size == 16 && (address & 15) && requires_alignment(op)) {
+        return BOX64_SSE_MISALIGNED;
+    }
+
+#define FAULT() do { if (fault_address) *fault_address = address; return BOX64_SSE_FAULT; } while (0)
+
+    // 1. 以 r/m 为目的的形式（存储、向通用寄存器或标志输出）
+    switch (op) {
+        case BOX64_SSE_MOVUPS_STORE:
+        case BOX64_SSE_MOVAPS_STORE:
+        case BOX64_SSE_MOVNT_STORE:
+            if (memory) {
+                if (!guest_write(ctx, address, 16, reg->u8)) FAULT();
+            } else {
+                k_copy(&ctx->xmm[insn->rm], reg);
+            }
+            return BOX64_SSE_OK;
+        case BOX64_SSE_MOVSS_STORE:
+            if (memory) {
+                if (!guest_write(ctx, address, 4, reg->u8)) FAULT();
+            } else {
+                ctx->xmm[insn->rm].u32[0] = reg->u32[0];
+            }
+            return BOX64_SSE_OK;
+        case BOX64_SSE_MOVSD_STORE:
+            if (memory) {
+                if (!guest_write(ctx, address, 8, reg->u8)) FAULT();
+            } else {
+                ctx->xmm[insn->rm].u64[0] = reg->u64[0];
+            }
+            return BOX64_SSE_OK;
+        case BOX64_SSE_MOVQ_STORE:
+            // 寄存器目的清零高64位
+            if (memory) {
+                if (!guest_write(ctx, address, 8, reg->u8)) FAULT();
+            } else {
+                ctx->xmm[insn->rm].u64[0] = reg->u64[0];
+                ctx->xmm[insn->rm].u64[1] = 0;
+            }
+            return BOX64_SSE_OK;
+        case BOX64_SSE_MOVD_FROM_XMM: {
+            const uint8_t width = X86_REX_W(insn->rex) ? 8 : 4;
+            if (memory) {
+                if (!guest_write(ctx, address, width, reg->u8)) FAULT();
+            } else {
+                box64_write_gpr(ctx, insn->rm, reg->u64[0], width, has_rex);
+            }
+            return BOX64_SSE_OK;
+        }
+        case BOX64_SSE_PMOVMSKB:
+            box64_write_gpr(ctx, insn->reg, k_pmovmskb(&ctx->xmm[insn->rm]), 4, has_rex);
+            return BOX64_SSE_OK;
+        default:
+            break;
+    }
+
+    // 2. 读源操作数：内存按指令宽度读入并清零其余字节；MOVD/CVTSI2* 的寄存器源是通用寄存器
+    Box64Xmm src;
+    if (memory) {
+        memset(&src, 0, sizeof(src));
+        if (!guest_read(ctx, address, size, &src)) FAULT();
+    } else if (op == BOX64_SSE_MOVD_TO_XMM || op == BOX64_SSE_CVTSI2SS || op == BOX64_SSE_CVTSI2SD) {
+        memset(&src, 0, sizeof(src));
+        src.u64[0] = box64_read_gpr(ctx, insn->rm, X86_REX_W(insn->rex) ? 8 : 4, has_rex);
+    } else {
+        src = ctx->xmm[insn->rm];
+    }
+
+#undef FAULT
+
+    // 3. 运算
+    switch (op) {
+        // 传送：MOVSS/MOVSD 从内存读时清零高位，寄存器之间只替换低位
+        case BOX64_SSE_MOVUPS_LOAD:
+        case BOX64_SSE_MOVAPS_LOAD:
+            k_copy(reg, &src);
+            break;
+        case BOX64_SSE_MOVSS_LOAD:
+            if (memory) {
+                k_copy(reg, &src);
+            } else {
+                reg->u32[0] = src.u32[0];
+            }
+            break;
+        case BOX64_SSE_MOVSD_LOAD:
+            if (memory) {
+                k_copy(reg, &src);
+            } else {
+                reg->u64[0] = src.u64[0];
+            }
+            break;
+        case BOX64_SSE_MOVQ_LOAD:
+            reg->u64[0] = src.u64[0];
+            reg->u64[1] = 0;
+            break;
+        case BOX64_SSE_MOVD_TO_XMM:
+            reg->u64[0] = X86_REX_W(insn->rex) ? src.u64[0] : src.u32[0];
+            reg->u64[1] = 0;
+            break;
+
+        // 位运算与整数
+        case BOX64_SSE_ANDPS:   k_and(reg, &src); break;
+        case BOX64_SSE_ANDNPS:  k_andn(reg, &src); break;
+        case BOX64_SSE_ORPS:    k_or(reg, &src); break;
+        case BOX64_SSE_XORPS:   k_xor(reg, &src); break;
+        case BOX64_SSE_PADDB:   k_add8(reg, &src); break;
+        case BOX64_SSE_PADDW:   k_add16(reg, &src); break;
+        case BOX64_SSE_PADDD:   k_add32(reg, &src); break;
+        case BOX64_SSE_PADDQ:   k_add64(reg, &src); break;
+        case BOX64_SSE_PSUBB:   k_sub8(reg, &src); break;
+        case BOX64_SSE_PSUBW:   k_sub16(reg, &src); break;
+        case BOX64_SSE_PSUBD:   k_sub32(reg, &src); break;
+        case BOX64_SSE_PSUBQ:   k_sub64(reg, &src); break;
+        case BOX64_SSE_PCMPEQB: k_cmpeq8(reg, &src); break;
+        case BOX64_SSE_PCMPEQW: k_cmpeq16(reg, &src); break;
+        case BOX64_SSE_PCMPEQD: k_cmpeq32(reg, &src); break;
+
+        // 打包浮点
+        case BOX64_SSE_ADDPS:   k_addps(reg, &src); break;
+        case BOX64_SSE_SUBPS:   k_subps(reg, &src); break;
+        case BOX64_SSE_MULPS:   k_mulps(reg, &src); break;
+        case BOX64_SSE_DIVPS:   k_divps(reg, &src); break;
+        case BOX64_SSE_MINPS:   k_minps(reg, &src); break;
+        case BOX64_SSE_MAXPS:   k_maxps(reg, &src); break;
+        case BOX64_SSE_SQRTPS:  k_sqrtps(reg, &src); break;
+        case BOX64_SSE_ADDPD:   k_addpd(reg, &src); break;
+        case BOX64_SSE_SUBPD:   k_subpd(reg, &src); break;
+        case BOX64_SSE_MULPD:   k_mulpd(reg, &src); break;
+        case BOX64_SSE_DIVPD:   k_divpd(reg, &src); break;
+        case BOX64_SSE_MINPD:   k_minpd(reg, &src); break;
+        case BOX64_SSE_MAXPD:   k_maxpd(reg, &src); break;
+        case BOX64_SSE_SQRTPD:  k_sqrtpd(reg, &src); break;
+
+        // 标量浮点：只改 lane 0
+        case BOX64_SSE_ADDSS:   reg->f32[0] += src.f32[0]; break;
+        case BOX64_SSE_SUBSS:   reg->f32[0] -= src.f32[0]; break;
+        case BOX64_SSE_MULSS:   reg->f32[0] *= src.f32[0]; break;
+        case BOX64_SSE_DIVSS:   reg->f32[0] /= src.f32[0]; break;
+        case BOX64_SSE_MINSS:   reg->f32[0] = min_f32(reg->f32[0], src.f32[0]); break;
+        case BOX64_SSE_MAXSS:   reg->f32[0] = max_f32(reg->f32[0], src.f32[0]); break;
+        case BOX64_SSE_SQRTSS:  reg->f32[0] = sqrtf(src.f32[0]); break;
+        case BOX64_SSE_ADDSD:   reg->f64[0] += src.f64[0]; break;
+        case BOX64_SSE_SUBSD:   reg->f64[0] -= src.f64[0]; break;
+        case BOX64_SSE_MULSD:   reg->f64[0] *= src.f64[0]; break;
+        case BOX64_SSE_DIVSD:   reg->f64[0] /= src.f64[0]; break;
+        case BOX64_SSE_MINSD:   reg->f64[0] = min_f64(reg->f64[0], src.f64[0]); break;
+        case BOX64_SSE_MAXSD:   reg->f64[0] = max_f64(reg->f64[0], src.f64[0]); break;
+        case BOX64_SSE_SQRTSD:  reg->f64[0] = sqrt(src.f64[0]); break;
+
+        // 洗牌
+        case BOX64_SSE_SHUFPS:  k_shufps(reg, &src, imm); break;
+        case BOX64_SSE_SHUFPD:  k_shufpd(reg, &src, imm); break;
+        case BOX64_SSE_PSHUFD:  k_pshufd(reg, &src, imm); break;
+
+        // 比较（COMIS* 与 UCOMIS* 只在QNaN是否报告异常上不同，异常状态不模拟）
+        case BOX64_SSE_COMISS: {
+            const float a = reg->f32[0], b = src.f32[0];
+            set_compare_flags(ctx, a != a || b != b, a < b, a == b);
+            break;
+        }
+        case BOX64_SSE_COMISD: {
+            const double a = reg->f64[0], b = src.f64[0];
+            set_compare_flags(ctx, a != a || b != b, a < b, a == b);
+            break;
+        }
+
+        // 转换
+        case BOX64_SSE_CVTSI2SS:
+            reg->f32[0] = X86_REX_W(insn->rex) ? (float)src.i64[0] : (float)src.i32[0];
+            break;
+        case BOX64_SSE_CVTSI2SD:
+            reg->f64[0] = X86_REX_W(insn->rex) ? (double)src.i64[0] : (double)src.i32[0];
+            break;
+        case BOX64_SSE_CVTTSS2SI:
+        case BOX64_SSE_CVTSS2SI:
+        case BOX64_SSE_CVTTSD2SI:
+        case BOX64_SSE_CVTSD2SI: {
+            const bool single = op == BOX64_SSE_CVTTSS2SI || op == BOX64_SSE_CVTSS2SI;
+            const bool truncate = op == BOX64_SSE_CVTTSS2SI || op == BOX64_SSE_CVTTSD2SI;
+            const uint8_t width = X86_REX_W(insn->rex) ? 8 : 4;
+            const uint64_t value = convert_to_integer(single ? (double)src.f32[0] : src.f64[0], width,
+                                                      truncate ? 3 : rc);
+            box64_write_gpr(ctx, insn->reg, value, width, has_rex);
+            break;
+        }
+        case BOX64_SSE_CVTSS2SD:  reg->f64[0] = (double)src.f32[0]; break;
+        case BOX64_SSE_CVTSD2SS:  reg->f32[0] = (float)src.f64[0]; break;
+        case BOX64_SSE_CVTPS2PD:  k_cvtps2pd(reg, &src); break;
+        case BOX64_SSE_CVTPD2PS:  k_cvtpd2ps(reg, &src); break;
+        case BOX64_SSE_CVTDQ2PS:  k_cvtdq2ps(reg, &src); break;
+        case BOX64_SSE_CVTPS2DQ:  k_cvtps2dq(reg, &src, rc); break;
+        case BOX64_SSE_CVTTPS2DQ: k_cvttps2dq(reg, &src); break;
+
+        default:
+            return BOX64_SSE_UNSUPPORTED;
+    }
+    return BOX64_SSE_OK;
+}
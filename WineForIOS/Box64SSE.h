@@ -0,0 +1,72 @@
+// Box64SSE.h - SSE/SSE2 指令的解码分类与执行
+// 纯C实现，解释器和 Box64Engine 的逐条执行路径共用：
+//   分类：按 0F 映射下的强制前缀（无 / 66 / F3 / F2）+ 操作码确定具体指令，
+//         同一操作码的四种前缀是四条不同的指令（ADDPS / ADDPD / ADDSS / ADDSD）；
+//         前缀组合没有对应SSE指令的（MMX形式等）返回 BOX64_SSE_NONE
+//   执行：XMM寄存器与 MXCSR 在 Box64Context 中；打包运算在 arm64 上用 NEON intrinsics，
+//         在 x86-64 主机上用对应的 SSE2 intrinsics，结果逐位一致（见 PortableTests/bench_box64_sse.c）
+//   浮点：结果按IEEE计算；MIN/MAX、浮点→整数转换的越界值（0x80000000）按x86语义修正；
+//         MXCSR 的舍入模式用于 CVTPS2DQ / CVTSS2SI / CVTSD2SI，异常状态位不更新，FTZ/DAZ 不模拟
+#ifndef BOX64_SSE_H
+#define BOX64_SSE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "Box64Context.h"
+#include "X86Decoder.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BOX64_SSE_OPS(X) \
+    X(NONE) \
+    X(MOVUPS_LOAD) X(MOVUPS_STORE) X(MOVAPS_LOAD) X(MOVAPS_STORE) X(MOVNT_STORE) \
+    X(MOVSS_LOAD) X(MOVSS_STORE) X(MOVSD_LOAD) X(MOVSD_STORE) \
+    X(MOVD_TO_XMM) X(MOVD_FROM_XMM) X(MOVQ_LOAD) X(MOVQ_STORE) \
+    X(ANDPS) X(ANDNPS) X(ORPS) X(XORPS) \
+    X(PADDB) X(PADDW) X(PADDD) X(PADDQ) X(PSUBB) X(PSUBW) X(PSUBD) X(PSUBQ) \
+    X(PCMPEQB) X(PCMPEQW) X(PCMPEQD) X(PMOVMSKB) \
+    X(ADDPS) X(SUBPS) X(MULPS) X(DIVPS) X(MINPS) X(MAXPS) X(SQRTPS) \
+    X(ADDPD) X(SUBPD) X(MULPD) X(DIVPD) X(MINPD) X(MAXPD) X(SQRTPD) \
+    X(ADDSS) X(SUBSS) X(MULSS) X(DIVSS) X(MINSS) X(MAXSS) X(SQRTSS) \
+    X(ADDSD) X(SUBSD) X(MULSD) X(DIVSD) X(MINSD) X(MAXSD) X(SQRTSD) \
+    X(SHUFPS) X(SHUFPD) X(PSHUFD) \
+    X(COMISS) X(COMISD) \
+    X(CVTSI2SS) X(CVTSI2SD) X(CVTTSS2SI) X(CVTTSD2SI) X(CVTSS2SI) X(CVTSD2SI) \
+    X(CVTSS2SD) X(CVTSD2SS) X(CVTPS2PD) X(CVTPD2PS) X(CVTDQ2PS) X(CVTPS2DQ) X(CVTTPS2DQ)
+
+#define BOX64_SSE_OP_ID(name) BOX64_SSE_##name,
+typedef enum Box64SseOp {
+    BOX64_SSE_OPS(BOX64_SSE_OP_ID)
+    BOX64_SSE_OP_COUNT
+} Box64SseOp;
+#undef BOX64_SSE_OP_ID
+
+typedef enum Box64SseStatus {
+    BOX64_SSE_OK = 0,
+    BOX64_SSE_UNSUPPORTED,      // 不是已建模的SSE指令
+    BOX64_SSE_FAULT,            // 访存缺页，*fault_address 为出错地址，未修改任何状态
+    BOX64_SSE_MISALIGNED        // 要求16字节对齐的内存操作数未对齐（x86上为 #GP）
+} Box64SseStatus;
+
+// 指令对应的SSE操作，不是SSE指令时返回 BOX64_SSE_NONE
+Box64SseOp box64_sse_classify(const X86DecodedInsn *insn);
+
+// 内存操作数的访问宽度（字节），不访存的操作返回0
+uint8_t box64_sse_memory_size(Box64SseOp op, const X86DecodedInsn *insn);
+
+const char *box64_sse_op_name(Box64SseOp op);
+
+// 执行一条已分类的指令；next_address 用于 RIP 相对寻址
+Box64SseStatus box64_sse_execute(Box64Context *ctx, const X86DecodedInsn *insn, Box64SseOp op,
+                                 uint64_t next_address, uint64_t *fault_address);
+
+// XMM清零，MXCSR置复位值
+void box64_sse_reset(Box64Context *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BOX64_SSE_H
@@ -0,0 +1,326 @@
+// Box64String.c - 字符串指令的整段执行
+// 每轮取 n 个元素：源/目的各自映射成一段宿主指针（先试整段，宿主不连续或越界时缩到当前页内），
+// 交给按元素宽度与方向选择的内核，再一次性更新 RSI/RDI/RCX；元素本身跨页时退回逐元素的MMU读写
+#include "Box64String.h"
+#include "Box64Flags.h"
+#include "Box64Interp.h"
+#include "Box64MMU.h"
+#include <string.h>
+
+#define REG_RAX 0
+#define REG_RCX 1
+#define REG_RSI 6
+#define REG_RDI 7
+
+// 单轮最多处理的字节数，避免 n * size 溢出
+#define MAX_RUN_BYTES   (1ULL << 30)
+
+typedef enum StringKind {
+    STRING_MOVS,
+    STRING_CMPS,
+    STRING_STOS,
+    STRING_LODS,
+    STRING_SCAS
+} StringKind;
+
+// 一条指令执行期间不变的参数
+typedef struct StringOp {
+    StringKind kind;
+    uint8_t size;               // 元素宽度 1/2/4/8
+    bool down;                  // DF=1
+    bool rep;
+    bool repne;                 // CMPS/SCAS：F2 = 不相等时继续
+    uint64_t mask;              // 地址/计数的有效位（32位寻址时为低32位）
+    uint64_t acc;               // STOS/SCAS 的 AL/AX/EAX/RAX
+} StringOp;
+
+bool box64_string_supported(const X86DecodedInsn *insn) {
+    return insn->map == X86_MAP_PRIMARY && insn->opcode >= 0xA4 && insn->opcode <= 0xAF &&
+           insn->opcode != 0xA8 && insn->opcode != 0xA9 && insn->segment != 0x64 && insn->segment != 0x65;
+}
+
+static StringKind string_kind(uint8_t opcode) {
+    switch (opcode & ~1u) {
+        case 0xA4: return STRING_MOVS;
+        case 0xA6: return STRING_CMPS;
+        case 0xAA: return STRING_STOS;
+        case 0xAC: return STRING_LODS;
+        default:   return STRING_SCAS;
+    }
+}
+
+// MARK: - 映射
+
+// 第 k 个元素相对第一个元素的字节偏移（按方向）
+static inline int64_t element_offset(const StringOp *op, uint64_t k) {
+    return op->down ? -(int64_t)(k * op->size) : (int64_t)(k * op->size);
+}
+
+// 从 address 起、按方向不出所在页的元素个数；元素本身跨页时为0
+static inline uint64_t page_limit(const StringOp *op, uint64_t address) {
+    const uint64_t offset = address & BOX64_PAGE_OFFSET_MASK;
+    if (offset + op->size > BOX64_PAGE_SIZE) {
+        return 0;
+    }
+    return op->down ? offset / op->size + 1 : (BOX64_PAGE_SIZE - offset) / op->size;
+}
+
+// 映射一条流上从 address 起的 *count 个元素，返回第一个元素的宿主指针（缩短 *count 后仍然有效）
+// 跨页的整段在各页都允许且宿主连续时一次完成；否则把 *count 缩到当前页内；
+// 元素跨页或当前页不允许访问时返回NULL
+static uint8_t *map_stream(Box64MMU *mmu, const StringOp *op, uint64_t address, uint64_t *count, Box64Access access) {
+    const uint64_t n = *count;
+    const uint64_t limit = page_limit(op, address);
+    if (limit == 0) {
+        return NULL;
+    }
+    if (n > limit) {
+        const uint64_t span = n * op->size;
+        const uint64_t low = op->down ? address - (span - op->size) : address;
+        // 在地址宽度内不回绕时才整段翻译
+        const bool contiguous = op->down ? span - op->size <= address : span - 1 <= op->mask - address;
+        uint8_t *host = contiguous ? box64_mmu_translate(mmu, low, span, access) : NULL;
+        if (host) {
+            return host + (address - low);
+        }
+    }
+
+    *count = n < limit ? n : limit;
+    const uint64_t page_span = *count * op->size;
+    const uint64_t page_low = op->down ? address - (page_span - op->size) : address;
+    uint8_t *host = box64_mmu_translate(mmu, page_low, page_span, access);
+    return host ? host + (address - page_low) : NULL;
+}
+
+// MARK: - 内核
+
+// 按x86逐元素的顺序复制 count 个元素；dst/src 为最低地址端
+// 后面的元素会读到前面元素刚写入的数据时（前向且目的在源之后、或反向且目的在源之前，距离小于长度），
+// 按距离分段：每段内源与目的不重叠，段间按执行顺序进行，结果与逐元素复制一致
+static void copy_elements(uint8_t *dst, const uint8_t *src, uint64_t count, uint8_t size, bool down) {
+    const uint64_t bytes = count * size;
+    const uint64_t distance = down ? (uint64_t)((uintptr_t)src - (uintptr_t)dst)
+                                   : (uint64_t)((uintptr_t)dst - (uintptr_t)src);
+    if (distance == 0 || distance >= bytes) {
+        memmove(dst, src, (size_t)bytes);
+        return;
+    }
+    if (distance < size) {
+        for (uint64_t k = 0; k < count; k++) {
+            const uint64_t index = down ? count - 1 - k : k;
+            memmove(dst + index * size, src + index * size, size);
+        }
+        return;
+    }
+    const uint64_t piece = distance / size * size;
+    if (!down) {
+        for (uint64_t offset = 0; offset < bytes; offset += piece) {
+            const uint64_t length = bytes - offset < piece ? bytes - offset : piece;
+            memcpy(dst + offset, src + offset, (size_t)length);
+        }
+    } else {
+        for (uint64_t end = bytes; end > 0; ) {
+            const uint64_t length = end < piece ? end : piece;
+            end -= length;
+            memcpy(dst + end, src + end, (size_t)length);
+        }
+    }
+}
+
+// 用 value 的低 size 字节填满 count 个元素：先写一个，再按倍增复制
+static void fill_elements(uint8_t *dst, uint64_t count, uint64_t value, uint8_t size) {
+    const uint64_t bytes = count * size;
+    if (size == 1) {
+        memset(dst, (int)(value & 0xFF), (size_t)bytes);
+        return;
+    }
+    box64_mmu_write_host(dst, size, value);
+    for (uint64_t filled = size; filled < bytes; ) {
+        const uint64_t length = bytes - filled < filled ? bytes - filled : filled;
+        memcpy(dst + filled, dst, (size_t)length);
+        filled += length;
+    }
+}
+
+// REPE 在不相等处停，REPNE 在相等处停；不带前缀时只比较一个元素
+static inline bool compare_stops(const StringOp *op, uint64_t a, uint64_t b) {
+    return op->rep && ((a == b) == op->repne);
+}
+
+// SCAS：返回处理的元素数（含停下的那个），*last 为最后比较的元素
+static uint64_t scan_elements(const StringOp *op, const uint8_t *first, uint64_t count, uint64_t *last, bool *stopped) {
+    if (op->size == 1 && op->rep && op->repne && !op->down) {
+        const uint8_t *hit = memchr(first, (int)(op->acc & 0xFF), (size_t)count);
+        const uint64_t done = hit ? (uint64_t)(hit - first) + 1 : count;
+        *last = first[done - 1];
+        *stopped = hit != NULL;
+        return done;
+    }
+    for (uint64_t k = 0; k < count; k++) {
+        box64_mmu_read_host(first + element_offset(op, k), op->size, last);
+        if (compare_stops(op, op->acc, *last)) {
+            *stopped = true;
+            return k + 1;
+        }
+    }
+    *stopped = false;
+    return count;
+}
+
+// CMPS：比较 [RSI] 与 [RDI]；REPE 的前向情形先整段 memcmp，相同时不必逐个比较
+static uint64_t compare_elements(const StringOp *op, const uint8_t *src, const uint8_t *dst, uint64_t count,
+                                 uint64_t *last_src, uint64_t *last_dst, bool *stopped) {
+    if (op->rep && !op->repne && !op->down && memcmp(src, dst, (size_t)(count * op->size)) == 0) {
+        const uint64_t offset = (count - 1) * op->size;
+        box64_mmu_read_host(src + offset, op->size, last_src);
+        box64_mmu_read_host(dst + offset, op->size, last_dst);
+        *stopped = false;
+        return count;
+    }
+    for (uint64_t k = 0; k < count; k++) {
+        box64_mmu_read_host(src + element_offset(op, k), op->size, last_src);
+        box64_mmu_read_host(dst + element_offset(op, k), op->size, last_dst);
+        if (compare_stops(op, *last_src, *last_dst)) {
+            *stopped = true;
+            return k + 1;
+        }
+    }
+    *stopped = false;
+    return count;
+}
+
+// MARK: - 执行
+
+// 一轮：映射并处理最多 count 个元素，返回实际处理的个数（0 表示缺页）
+static uint64_t run_chunk(Box64Context *ctx, const StringOp *op, uint64_t si, uint64_t di, uint64_t count,
+                          bool *stopped, uint64_t *fault_address) {
+    Box64MMU *mmu = &ctx->mmu;
+    const bool reads_src = op->kind == STRING_MOVS || op->kind == STRING_CMPS || op->kind == STRING_LODS;
+    const bool uses_dst = op->kind != STRING_LODS;
+    const Box64Access dst_access = (op->kind == STRING_MOVS || op->kind == STRING_STOS) ? BOX64_ACCESS_WRITE
+                                                                                        : BOX64_ACCESS_READ;
+    uint8_t *src = NULL, *dst = NULL;
+    uint64_t n = count;
+
+    if (reads_src) {
+        src = map_stream(mmu, op, si, &n, BOX64_ACCESS_READ);
+    }
+    if (uses_dst && (src || !reads_src)) {
+        dst = map_stream(mmu, op, di, &n, dst_access);
+    }
+
+    uint64_t last_src = 0, last_dst = 0;
+    *stopped = false;
+    if ((reads_src && !src) || (uses_dst && !dst)) {
+        // 元素跨页或当前页缺页：只处理一个元素，读写都经MMU
+        n = 1;
+        if (reads_src && !box64_mmu_load(mmu, si, op->size, &last_src)) {
+            *fault_address = si;
+            return 0;
+        }
+        switch (op->kind) {
+            case STRING_MOVS:
+            case STRING_STOS:
+                if (!box64_mmu_store(mmu, di, op->size, op->kind == STRING_MOVS ? last_src : op->acc)) {
+                    *fault_address = di;
+                    return 0;
+                }
+                break;
+            case STRING_CMPS:
+            case STRING_SCAS:
+                if (!box64_mmu_load(mmu, di, op->size, &last_dst)) {
+                    *fault_address = di;
+                    return 0;
+                }
+                *stopped = compare_stops(op, op->kind == STRING_CMPS ? last_src : op->acc, last_dst);
+                break;
+            case STRING_LODS:
+                break;
+        }
+    } else {
+        const uint64_t back = (n - 1) * op->size;
+        switch (op->kind) {
+            case STRING_MOVS:
+                copy_elements(op->down ? dst - back : dst, op->down ? src - back : src, n, op->size, op->down);
+                break;
+            case STRING_STOS:
+                fill_elements(op->down ? dst - back : dst, n, op->acc, op->size);
+                break;
+            case STRING_LODS:
+                box64_mmu_read_host(src + element_offset(op, n - 1), op->size, &last_src);
+                break;
+            case STRING_SCAS:
+                n = scan_elements(op, dst, n, &last_dst, stopped);
+                break;
+            case STRING_CMPS:
+                n = compare_elements(op, src, dst, n, &last_src, &last_dst, stopped);
+                break;
+        }
+    }
+
+    const uint64_t size_mask = box64_size_mask(op->size);
+    switch (op->kind) {
+        case STRING_LODS:
+            box64_write_gpr(ctx, REG_RAX, last_src, op->size, true);
+            break;
+        case STRING_SCAS:
+            box64_flags_record(ctx, BOX64_FLAGS_SUB, op->acc, last_dst, (op->acc - last_dst) & size_mask, op->size);
+            break;
+        case STRING_CMPS:
+            box64_flags_record(ctx, BOX64_FLAGS_SUB, last_src, last_dst, (last_src - last_dst) & size_mask, op->size);
+            break;
+        default:
+            break;
+    }
+    return n;
+}
+
+Box64StringStatus box64_string_execute(Box64Context *ctx, const X86DecodedInsn *insn, uint64_t *fault_address) {
+    if (!box64_string_supported(insn)) {
+        return BOX64_STRING_UNSUPPORTED;
+    }
+    uint64_t *regs = ctx->x86_regs;
+    StringOp op;
+    op.kind = string_kind(insn->opcode);
+    op.size = insn->operand_size;
+    op.down = (ctx->rflags & X86_FLAG_DF) != 0;
+    op.rep = (insn->prefixes & (X86_PREFIX_REP | X86_PREFIX_REPNE)) != 0;
+    op.repne = (insn->prefixes & X86_PREFIX_REPNE) && !(insn->prefixes & X86_PREFIX_REP);
+    op.mask = insn->address_size == 4 ? 0xFFFFFFFFULL : ~0ULL;
+    op.acc = box64_read_gpr(ctx, REG_RAX, op.size, true);
+
+    const bool uses_si = op.kind == STRING_MOVS || op.kind == STRING_CMPS || op.kind == STRING_LODS;
+    const bool uses_di = op.kind != STRING_LODS;
+    uint64_t remaining = op.rep ? regs[REG_RCX] & op.mask : 1;
+
+    while (remaining > 0) {
+        const uint64_t si = regs[REG_RSI] & op.mask, di = regs[REG_RDI] & op.mask;
+        const uint64_t wanted = remaining < MAX_RUN_BYTES / op.size ? remaining : MAX_RUN_BYTES / op.size;
+        bool stopped = false;
+        uint64_t fault = 0;
+        const uint64_t done = run_chunk(ctx, &op, si, di, wanted, &stopped, &fault);
+        if (done == 0) {
+            if (fault_address) {
+                *fault_address = fault;
+            }
+            return BOX64_STRING_FAULT;
+        }
+
+        // 每轮之后寄存器都是一致的中间状态，缺页后可从本指令重新执行
+        const uint64_t delta = done * op.size;
+        if (uses_si) {
+            regs[REG_RSI] = (op.down ? si - delta : si + delta) & op.mask;
+        }
+        if (uses_di) {
+            regs[REG_RDI] = (op.down ? di - delta : di + delta) & op.mask;
+        }
+        remaining -= done;
+        if (op.rep) {
+            regs[REG_RCX] = remaining;
+        }
+        if (stopped) {
+            break;
+        }
+    }
+    return BOX64_STRING_OK;
+}
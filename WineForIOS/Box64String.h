@@ -0,0 +1,37 @@
+// Box64String.h - 字符串指令 MOVS/CMPS/STOS/LODS/SCAS（含 REP/REPE/REPNE 前缀）
+// 纯C实现，解释器和 Box64Engine 的逐条执行路径共用：
+//   带REP前缀时整段执行：源/目的各取一段宿主连续的客户机范围，只做一次MMU翻译和权限检查，
+//         再用 memmove/memset/memchr/memcmp 处理；整段不连续时按页分段
+//   DF=1 时地址递减；重叠的 MOVS 保持逐元素顺序复制的结果（如 dst = src + 1 的前向复制会重复首字节）
+//   32位寻址（67前缀）使用 ESI/EDI/ECX，写回时零扩展
+//   缺页时 RSI/RDI/RCX 反映已完成的元素，从该指令重新执行即可接着做完剩余部分
+// 带 FS/GS 段超越的形式不支持，box64_string_supported 返回false
+#ifndef BOX64_STRING_H
+#define BOX64_STRING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "Box64Context.h"
+#include "X86Decoder.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum Box64StringStatus {
+    BOX64_STRING_OK = 0,
+    BOX64_STRING_UNSUPPORTED,       // 不是字符串指令
+    BOX64_STRING_FAULT              // 访存缺页，*fault_address 为出错元素的地址；已完成的元素保留
+} Box64StringStatus;
+
+// A4-A7、AA-AF 且没有 FS/GS 段超越
+bool box64_string_supported(const X86DecodedInsn *insn);
+
+// 执行一条字符串指令（REP 形式执行完整个循环，计为一条指令）
+Box64StringStatus box64_string_execute(Box64Context *ctx, const X86DecodedInsn *insn, uint64_t *fault_address);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BOX64_STRING_H
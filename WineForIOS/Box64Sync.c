@@ -0,0 +1,378 @@
+// Box64Sync.c - futex 风格等待队列与同步原语
+#include "Box64Sync.h"
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <errno.h>
+
+#define PARK_BUCKETS        64              // 需为2的幂
+#define LOCK_SPIN           64
+
+// MARK: - 等待队列
+
+// 等待者节点在等待线程的栈上；只在持有桶互斥量时入队/出队
+typedef struct ParkWaiter {
+    struct ParkWaiter *next;
+    const void *address;
+    pthread_cond_t cond;
+    bool woken;
+} ParkWaiter;
+
+typedef struct ParkBucket {
+    pthread_mutex_t mutex;
+    ParkWaiter *head;
+    ParkWaiter *tail;
+    _Atomic uint32_t waiters;               // 已登记（可能尚未入队）的等待者数，wake 据此跳过空桶
+} ParkBucket;
+
+static ParkBucket park_buckets[PARK_BUCKETS];
+static pthread_once_t park_once = PTHREAD_ONCE_INIT;
+
+static _Atomic uint64_t sync_parks;
+static _Atomic uint64_t sync_wakes;
+static _Atomic uint64_t sync_timeouts;
+
+static void park_init(void) {
+    for (uint32_t i = 0; i < PARK_BUCKETS; i++) {
+        pthread_mutex_init(&park_buckets[i].mutex, NULL);
+        park_buckets[i].head = NULL;
+        park_buckets[i].tail = NULL;
+        atomic_init(&park_buckets[i].waiters, 0);
+    }
+}
+
+static ParkBucket *park_bucket(const void *address) {
+    pthread_once(&park_once, park_init);
+    uintptr_t hash = (uintptr_t)address >> 2;
+    hash ^= hash >> 7;
+    hash ^= hash >> 13;
+    return &park_buckets[hash & (PARK_BUCKETS - 1)];
+}
+
+static void park_unlink(ParkBucket *bucket, ParkWaiter *waiter) {
+    ParkWaiter *previous = NULL;
+    for (ParkWaiter *node = bucket->head; node; previous = node, node = node->next) {
+        if (node != waiter) {
+            continue;
+        }
+        if (previous) {
+            previous->next = node->next;
+        } else {
+            bucket->head = node->next;
+        }
+        if (bucket->tail == node) {
+            bucket->tail = previous;
+        }
+        return;
+    }
+}
+
+static void deadline_after(struct timespec *deadline, uint32_t timeout_ms) {
+    clock_gettime(CLOCK_REALTIME, deadline);
+    deadline->tv_sec += timeout_ms / 1000;
+    deadline->tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+    if (deadline->tv_nsec >= 1000000000L) {
+        deadline->tv_sec++;
+        deadline->tv_nsec -= 1000000000L;
+    }
+}
+
+// 先登记再检查字：与 wake 一侧“先写字再读等待者数”配对（都是顺序一致），两者至少有一方看到对方
+bool box64_futex_wait(_Atomic uint32_t *word, uint32_t expected, uint32_t timeout_ms) {
+    if (timeout_ms == 0) {
+        return atomic_load(word) != expected;
+    }
+    ParkBucket *bucket = park_bucket(word);
+    pthread_mutex_lock(&bucket->mutex);
+    atomic_fetch_add(&bucket->waiters, 1);
+    if (atomic_load(word) != expected) {
+        atomic_fetch_sub(&bucket->waiters, 1);
+        pthread_mutex_unlock(&bucket->mutex);
+        return true;
+    }
+
+    ParkWaiter waiter = { NULL, word, PTHREAD_COND_INITIALIZER, false };
+    if (bucket->tail) {
+        bucket->tail->next = &waiter;
+    } else {
+        bucket->head = &waiter;
+    }
+    bucket->tail = &waiter;
+    atomic_fetch_add_explicit(&sync_parks, 1, memory_order_relaxed);
+
+    struct timespec deadline;
+    if (timeout_ms != BOX64_INFINITE) {
+        deadline_after(&deadline, timeout_ms);
+    }
+    bool timed_out = false;
+    while (!waiter.woken) {
+        if (timeout_ms == BOX64_INFINITE) {
+            pthread_cond_wait(&waiter.cond, &bucket->mutex);
+        } else if (pthread_cond_timedwait(&waiter.cond, &bucket->mutex, &deadline) == ETIMEDOUT && !waiter.woken) {
+            // 超时的等待者自己出队；已被 wake 摘下的节点不会再出现在队列里
+            park_unlink(bucket, &waiter);
+            atomic_fetch_sub(&bucket->waiters, 1);
+            atomic_fetch_add_explicit(&sync_timeouts, 1, memory_order_relaxed);
+            timed_out = true;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&bucket->mutex);
+    pthread_cond_destroy(&waiter.cond);
+    return !timed_out;
+}
+
+uint32_t box64_futex_wake(_Atomic uint32_t *word, uint32_t count) {
+    ParkBucket *bucket = park_bucket(word);
+    if (atomic_load(&bucket->waiters) == 0) {
+        return 0;
+    }
+    uint32_t woken = 0;
+    pthread_mutex_lock(&bucket->mutex);
+    ParkWaiter *previous = NULL;
+    ParkWaiter *node = bucket->head;
+    while (node && woken < count) {
+        ParkWaiter *next = node->next;
+        if (node->address != word) {
+            previous = node;
+            node = next;
+            continue;
+        }
+        if (previous) {
+            previous->next = next;
+        } else {
+            bucket->head = next;
+        }
+        if (bucket->tail == node) {
+            bucket->tail = previous;
+        }
+        // 节点在等待者栈上；等待者要重新拿到桶互斥量才能返回，所以解锁前访问它是安全的
+        node->woken = true;
+        pthread_cond_signal(&node->cond);
+        woken++;
+        node = next;
+    }
+    if (woken) {
+        atomic_fetch_sub(&bucket->waiters, woken);
+        atomic_fetch_add_explicit(&sync_wakes, woken, memory_order_relaxed);
+    }
+    pthread_mutex_unlock(&bucket->mutex);
+    return woken;
+}
+
+void box64_sync_get_stats(Box64SyncStats *stats) {
+    if (!stats) {
+        return;
+    }
+    stats->parks = atomic_load_explicit(&sync_parks, memory_order_relaxed);
+    stats->wakes = atomic_load_explicit(&sync_wakes, memory_order_relaxed);
+    stats->timeouts = atomic_load_explicit(&sync_timeouts, memory_order_relaxed);
+}
+
+// MARK: - 锁
+
+static inline void cpu_relax(void) {
+#if defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#elif defined(__x86_64__) || defined(__i386__)
+    __asm__ __volatile__("pause");
+#endif
+}
+
+static uint64_t monotonic_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000 + (uint64_t)now.tv_nsec / 1000000;
+}
+
+// 三态锁的慢路径：先短暂自旋等持有者释放，再把状态置2后睡眠；置2保证解锁方会唤醒
+// 超时返回false；状态可能留在2，只会让持有者解锁时多一次唤醒
+static bool lock_word_slow_timed(_Atomic uint32_t *state, uint32_t spin, uint32_t timeout_ms) {
+    for (uint32_t i = 0; i < spin; i++) {
+        uint32_t expected = 0;
+        if (atomic_load_explicit(state, memory_order_relaxed) == 0 &&
+            atomic_compare_exchange_weak_explicit(state, &expected, 1, memory_order_acquire, memory_order_relaxed)) {
+            return true;
+        }
+        cpu_relax();
+    }
+    const uint64_t deadline = timeout_ms == BOX64_INFINITE ? 0 : monotonic_ms() + timeout_ms;
+    while (atomic_exchange_explicit(state, 2, memory_order_acquire) != 0) {
+        uint32_t remaining = BOX64_INFINITE;
+        if (timeout_ms != BOX64_INFINITE) {
+            const uint64_t now = monotonic_ms();
+            if (now >= deadline) {
+                return false;
+            }
+            remaining = (uint32_t)(deadline - now);
+        }
+        box64_futex_wait(state, 2, remaining);
+    }
+    return true;
+}
+
+static void lock_word_slow(_Atomic uint32_t *state, uint32_t spin) {
+    lock_word_slow_timed(state, spin, BOX64_INFINITE);
+}
+
+void box64_lock_slow(Box64Lock *lock) {
+    lock_word_slow(&lock->state, LOCK_SPIN);
+}
+
+void box64_mutex_init(Box64Mutex *mutex, uint32_t spin_count) {
+    atomic_init(&mutex->state, 0);
+    atomic_init(&mutex->owner, 0);
+    mutex->recursion = 0;
+    mutex->spin_count = spin_count;
+}
+
+void box64_mutex_lock(Box64Mutex *mutex, uint32_t thread_id) {
+    if (atomic_load_explicit(&mutex->owner, memory_order_relaxed) == thread_id) {
+        mutex->recursion++;
+        return;
+    }
+    uint32_t expected = 0;
+    if (!atomic_compare_exchange_strong_explicit(&mutex->state, &expected, 1, memory_order_acquire, memory_order_relaxed)) {
+        lock_word_slow(&mutex->state, mutex->spin_count);
+    }
+    atomic_store_explicit(&mutex->owner, thread_id, memory_order_relaxed);
+    mutex->recursion = 1;
+}
+
+bool box64_mutex_lock_timed(Box64Mutex *mutex, uint32_t thread_id, uint32_t timeout_ms) {
+    if (atomic_load_explicit(&mutex->owner, memory_order_relaxed) == thread_id) {
+        mutex->recursion++;
+        return true;
+    }
+    uint32_t expected = 0;
+    if (!atomic_compare_exchange_strong_explicit(&mutex->state, &expected, 1, memory_order_acquire, memory_order_relaxed) &&
+        !lock_word_slow_timed(&mutex->state, timeout_ms ? mutex->spin_count : 0, timeout_ms)) {
+        return false;
+    }
+    atomic_store_explicit(&mutex->owner, thread_id, memory_order_relaxed);
+    mutex->recursion = 1;
+    return true;
+}
+
+bool box64_mutex_trylock(Box64Mutex *mutex, uint32_t thread_id) {
+    if (atomic_load_explicit(&mutex->owner, memory_order_relaxed) == thread_id) {
+        mutex->recursion++;
+        return true;
+    }
+    uint32_t expected = 0;
+    if (!atomic_compare_exchange_strong_explicit(&mutex->state, &expected, 1, memory_order_acquire, memory_order_relaxed)) {
+        return false;
+    }
+    atomic_store_explicit(&mutex->owner, thread_id, memory_order_relaxed);
+    mutex->recursion = 1;
+    return true;
+}
+
+bool box64_mutex_unlock(Box64Mutex *mutex, uint32_t thread_id) {
+    if (thread_id == 0 || atomic_load_explicit(&mutex->owner, memory_order_relaxed) != thread_id) {
+        return false;
+    }
+    if (--mutex->recursion > 0) {
+        return true;
+    }
+    atomic_store_explicit(&mutex->owner, 0, memory_order_relaxed);
+    if (atomic_exchange_explicit(&mutex->state, 0, memory_order_release) == 2) {
+        box64_futex_wake(&mutex->state, 1);
+    }
+    return true;
+}
+
+// MARK: - 事件
+
+void box64_event_init(Box64Event *event, bool manual_reset, bool initial_state) {
+    atomic_init(&event->signaled, initial_state ? 1 : 0);
+    event->manual_reset = manual_reset ? 1 : 0;
+}
+
+// 自动复位事件只唤醒一个等待者，它消耗信号；抢先消耗信号的线程会让被唤醒者重新等待
+void box64_event_set(Box64Event *event) {
+    atomic_store(&event->signaled, 1);
+    box64_futex_wake(&event->signaled, event->manual_reset ? UINT32_MAX : 1);
+}
+
+void box64_event_reset(Box64Event *event) {
+    atomic_store_explicit(&event->signaled, 0, memory_order_release);
+}
+
+static bool event_try_consume(Box64Event *event) {
+    if (event->manual_reset) {
+        return atomic_load_explicit(&event->signaled, memory_order_acquire) != 0;
+    }
+    uint32_t expected = 1;
+    return atomic_compare_exchange_strong_explicit(&event->signaled, &expected, 0, memory_order_acquire, memory_order_relaxed);
+}
+
+uint32_t box64_event_wait(Box64Event *event, uint32_t timeout_ms) {
+    const uint64_t deadline = timeout_ms == BOX64_INFINITE ? 0 : monotonic_ms() + timeout_ms;
+    for (;;) {
+        if (event_try_consume(event)) {
+            return BOX64_WAIT_OBJECT_0;
+        }
+        uint32_t remaining = BOX64_INFINITE;
+        if (timeout_ms != BOX64_INFINITE) {
+            const uint64_t now = monotonic_ms();
+            if (now >= deadline) {
+                return BOX64_WAIT_TIMEOUT;
+            }
+            remaining = (uint32_t)(deadline - now);
+        }
+        box64_futex_wait(&event->signaled, 0, remaining);
+    }
+}
+
+// MARK: - 读写锁
+
+void box64_rwlock_read_lock(Box64RWLock *lock) {
+    uint32_t state = atomic_load_explicit(&lock->state, memory_order_relaxed);
+    for (;;) {
+        if (state & (BOX64_RWLOCK_WRITER_HELD | BOX64_RWLOCK_WRITERS_MASK)) {
+            box64_futex_wait(&lock->state, state, BOX64_INFINITE);
+            state = atomic_load_explicit(&lock->state, memory_order_relaxed);
+            continue;
+        }
+        if (atomic_compare_exchange_weak_explicit(&lock->state, &state, state + 1, memory_order_acquire, memory_order_relaxed)) {
+            return;
+        }
+    }
+}
+
+// 最后一个读者离开且有写者等待时才需要唤醒
+void box64_rwlock_read_unlock(Box64RWLock *lock) {
+    const uint32_t state = atomic_fetch_sub_explicit(&lock->state, 1, memory_order_release) - 1;
+    if ((state & BOX64_RWLOCK_READER_MASK) == 0 && (state & BOX64_RWLOCK_WRITERS_MASK)) {
+        box64_futex_wake(&lock->state, UINT32_MAX);
+    }
+}
+
+// 先登记为等待中的写者（挡住新读者），再等现有读者和写者离开
+void box64_rwlock_write_lock(Box64RWLock *lock) {
+    uint32_t state = atomic_fetch_add_explicit(&lock->state, BOX64_RWLOCK_WRITER_ONE, memory_order_relaxed) + BOX64_RWLOCK_WRITER_ONE;
+    for (;;) {
+        if ((state & BOX64_RWLOCK_READER_MASK) || (state & BOX64_RWLOCK_WRITER_HELD)) {
+            box64_futex_wait(&lock->state, state, BOX64_INFINITE);
+            state = atomic_load_explicit(&lock->state, memory_order_relaxed);
+            continue;
+        }
+        if (atomic_compare_exchange_weak_explicit(&lock->state, &state, state | BOX64_RWLOCK_WRITER_HELD,
+                                                  memory_order_acquire, memory_order_relaxed)) {
+            return;
+        }
+    }
+}
+
+// 写锁释放后唤醒全部等待者：其余写者和读者重新竞争，写者仍然优先
+void box64_rwlock_write_unlock(Box64RWLock *lock) {
+    atomic_fetch_sub_explicit(&lock->state, BOX64_RWLOCK_WRITER_HELD + BOX64_RWLOCK_WRITER_ONE, memory_order_release);
+    box64_futex_wake(&lock->state, UINT32_MAX);
+}
+
+void box64_rwlock_write_downgrade(Box64RWLock *lock) {
+    // 一次原子加法：读者数+1，清除持有位，写者计数-1；期间没有其他写者能插进来
+    atomic_fetch_add_explicit(&lock->state, 1u - BOX64_RWLOCK_WRITER_HELD - BOX64_RWLOCK_WRITER_ONE, memory_order_release);
+    box64_futex_wake(&lock->state, UINT32_MAX);
+}
@@ -0,0 +1,140 @@
+// Box64Sync.h - 客户机线程的同步原语（futex 风格）
+// 纯C实现，替代 Box64Engine 上一把 NSRecursiveLock 串行化全部客户机执行的做法：
+//   等待队列：按地址散列到固定数量的桶，box64_futex_wait 在字仍等于期望值时睡眠，box64_futex_wake 唤醒；
+//            桶里没有等待者时 wake 只读一个原子计数就返回，无竞争时不进内核、不碰互斥量
+//   Box64Lock：0/1/2 三态的非递归锁，无竞争时加锁/解锁各一次原子操作
+//   Box64Mutex：CRITICAL_SECTION 语义（按线程ID递归、可自旋、非持有者解锁失败），可以直接放在客户机内存里
+//   Box64Event：手动/自动复位事件，WaitForSingleObject 的超时语义
+//   Box64RWLock：写者优先的读写锁；有写者等待时新读者阻塞，读者在安全点看到 writer_pending 后让出
+// 所有对象零初始化即可用（box64_event_init 设置复位方式），不需要销毁；等待中的对象不能释放
+#ifndef BOX64_SYNC_H
+#define BOX64_SYNC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Win32 等待相关常量
+#define BOX64_INFINITE          0xFFFFFFFFu
+#define BOX64_WAIT_OBJECT_0     0x00000000u
+#define BOX64_WAIT_TIMEOUT      0x00000102u
+#define BOX64_WAIT_FAILED       0xFFFFFFFFu
+
+#define BOX64_MUTEX_DEFAULT_SPIN 1000
+
+typedef struct Box64SyncStats {
+    uint64_t parks;                     // 真正睡眠的等待次数
+    uint64_t wakes;                     // 被唤醒的等待者数
+    uint64_t timeouts;
+} Box64SyncStats;
+
+// MARK: - 等待队列
+
+// *word == expected 时睡眠直到被唤醒或超时（毫秒，BOX64_INFINITE 不超时）；可能虚假返回，调用方需重新检查
+// 超时返回false，其余返回true
+bool box64_futex_wait(_Atomic uint32_t *word, uint32_t expected, uint32_t timeout_ms);
+
+// 最多唤醒 count 个在 word 上等待的线程（UINT32_MAX 为全部），返回唤醒数
+uint32_t box64_futex_wake(_Atomic uint32_t *word, uint32_t count);
+
+void box64_sync_get_stats(Box64SyncStats *stats);
+
+// MARK: - 锁
+
+typedef struct Box64Lock {
+    _Atomic uint32_t state;             // 0 空闲，1 持有，2 持有且可能有等待者
+} Box64Lock;
+
+void box64_lock_slow(Box64Lock *lock);
+
+static inline void box64_lock(Box64Lock *lock) {
+    uint32_t expected = 0;
+    if (!atomic_compare_exchange_strong_explicit(&lock->state, &expected, 1, memory_order_acquire, memory_order_relaxed)) {
+        box64_lock_slow(lock);
+    }
+}
+
+static inline bool box64_trylock(Box64Lock *lock) {
+    uint32_t expected = 0;
+    return atomic_compare_exchange_strong_explicit(&lock->state, &expected, 1, memory_order_acquire, memory_order_relaxed);
+}
+
+static inline void box64_unlock(Box64Lock *lock) {
+    if (atomic_exchange_explicit(&lock->state, 0, memory_order_release) == 2) {
+        box64_futex_wake(&lock->state, 1);
+    }
+}
+
+// CRITICAL_SECTION：thread_id 为调用线程的非0 ID
+typedef struct Box64Mutex {
+    _Atomic uint32_t state;             // 同 Box64Lock
+    uint32_t recursion;                 // 持有者的重入次数，只由持有者读写
+    _Atomic uint32_t owner;             // 持有者线程ID，0 表示无人持有
+    uint32_t spin_count;                // 睡眠前的自旋次数，0 表示直接睡眠
+} Box64Mutex;
+
+void box64_mutex_init(Box64Mutex *mutex, uint32_t spin_count);
+void box64_mutex_lock(Box64Mutex *mutex, uint32_t thread_id);
+// 超时（毫秒，BOX64_INFINITE 不超时）返回false，不持有锁
+bool box64_mutex_lock_timed(Box64Mutex *mutex, uint32_t thread_id, uint32_t timeout_ms);
+bool box64_mutex_trylock(Box64Mutex *mutex, uint32_t thread_id);
+// 调用线程不是持有者时返回false且不做修改
+bool box64_mutex_unlock(Box64Mutex *mutex, uint32_t thread_id);
+
+// MARK: - 事件
+
+typedef struct Box64Event {
+    _Atomic uint32_t signaled;
+    uint32_t manual_reset;              // 0 为自动复位：一次成功的等待消耗掉信号
+} Box64Event;
+
+void box64_event_init(Box64Event *event, bool manual_reset, bool initial_state);
+void box64_event_set(Box64Event *event);
+void box64_event_reset(Box64Event *event);
+// 返回 BOX64_WAIT_OBJECT_0 或 BOX64_WAIT_TIMEOUT；timeout_ms 为0时只检查不等待
+uint32_t box64_event_wait(Box64Event *event, uint32_t timeout_ms);
+
+// MARK: - 读写锁
+
+// state：[15..0] 读者数  [30..16] 等待或持有中的写者数  [31] 写者持有
+#define BOX64_RWLOCK_READER_MASK    0x0000FFFFu
+#define BOX64_RWLOCK_WRITER_ONE     0x00010000u
+#define BOX64_RWLOCK_WRITERS_MASK   0x7FFF0000u
+#define BOX64_RWLOCK_WRITER_HELD    0x80000000u
+
+// 读锁不可重入：持有读锁时再加读锁，遇到等待中的写者会死锁
+typedef struct Box64RWLock {
+    _Atomic uint32_t state;
+} Box64RWLock;
+
+void box64_rwlock_read_lock(Box64RWLock *lock);
+void box64_rwlock_read_unlock(Box64RWLock *lock);
+void box64_rwlock_write_lock(Box64RWLock *lock);
+void box64_rwlock_write_unlock(Box64RWLock *lock);
+// 把持有的写锁换成读锁，中间不会让其他写者进入
+void box64_rwlock_write_downgrade(Box64RWLock *lock);
+
+// 有写者在等待（或持有）；读者的安全点只读这一个字
+static inline bool box64_rwlock_writer_pending(const Box64RWLock *lock) {
+    return (atomic_load_explicit(&((Box64RWLock *)lock)->state, memory_order_relaxed) & BOX64_RWLOCK_WRITERS_MASK) != 0;
+}
+
+// 安全点：有写者等待时释放读锁让它先完成，再重新加读锁；返回是否让出过
+static inline bool box64_rwlock_read_yield(Box64RWLock *lock) {
+    if (!box64_rwlock_writer_pending(lock)) {
+        return false;
+    }
+    box64_rwlock_read_unlock(lock);
+    box64_rwlock_read_lock(lock);
+    return true;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BOX64_SYNC_H
@@ -0,0 +1,139 @@
+// Box64Thread.c - 客户机线程实现
+#include "Box64Thread.h"
+#include <stdlib.h>
+#include <pthread.h>
+
+#define THREAD_ID_FIRST     0x100
+#define THREAD_ID_STEP      4
+
+struct Box64Thread {
+    uint32_t id;
+    _Atomic uint32_t refcount;
+    _Atomic uint32_t suspend_count;
+    _Atomic uint32_t exit_code;
+    Box64Event start_gate;                  // 手动复位，挂起计数归零时置位
+    Box64Event exited;                      // 手动复位，main 返回后置位
+    Box64ThreadMain main;
+    Box64ThreadDestroy destroy;
+    void *user;
+    pthread_t handle;
+};
+
+static _Atomic uint32_t next_thread_id = THREAD_ID_FIRST;
+static _Atomic uint32_t live_threads;
+
+static _Thread_local Box64Thread *current_thread;
+static _Thread_local uint32_t current_thread_id;
+
+static uint32_t allocate_thread_id(void) {
+    return atomic_fetch_add_explicit(&next_thread_id, THREAD_ID_STEP, memory_order_relaxed);
+}
+
+static void *thread_start(void *argument) {
+    Box64Thread *thread = (Box64Thread *)argument;
+    current_thread = thread;
+    current_thread_id = thread->id;
+
+    box64_event_wait(&thread->start_gate, BOX64_INFINITE);
+    const uint32_t exit_code = thread->main(thread, thread->user);
+
+    atomic_store_explicit(&thread->exit_code, exit_code, memory_order_release);
+    atomic_fetch_sub_explicit(&live_threads, 1, memory_order_relaxed);
+    box64_event_set(&thread->exited);
+    current_thread = NULL;
+    box64_thread_release(thread);
+    return NULL;
+}
+
+Box64Thread *box64_thread_create(Box64ThreadMain main, Box64ThreadDestroy destroy, void *user,
+                                 bool suspended, size_t host_stack_size) {
+    if (!main) {
+        return NULL;
+    }
+    Box64Thread *thread = calloc(1, sizeof(Box64Thread));
+    if (!thread) {
+        return NULL;
+    }
+    thread->id = allocate_thread_id();
+    atomic_init(&thread->refcount, 2);
+    atomic_init(&thread->suspend_count, suspended ? 1 : 0);
+    atomic_init(&thread->exit_code, BOX64_STILL_ACTIVE);
+    box64_event_init(&thread->start_gate, true, !suspended);
+    box64_event_init(&thread->exited, true, false);
+    thread->main = main;
+    thread->destroy = destroy;
+    thread->user = user;
+
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+    pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED);
+    pthread_attr_setstacksize(&attributes, host_stack_size ? host_stack_size : BOX64_THREAD_DEFAULT_HOST_STACK);
+    atomic_fetch_add_explicit(&live_threads, 1, memory_order_relaxed);
+    const int status = pthread_create(&thread->handle, &attributes, thread_start, thread);
+    pthread_attr_destroy(&attributes);
+    if (status != 0) {
+        atomic_fetch_sub_explicit(&live_threads, 1, memory_order_relaxed);
+        free(thread);
+        return NULL;
+    }
+    return thread;
+}
+
+void box64_thread_retain(Box64Thread *thread) {
+    if (thread) {
+        atomic_fetch_add_explicit(&thread->refcount, 1, memory_order_relaxed);
+    }
+}
+
+void box64_thread_release(Box64Thread *thread) {
+    if (!thread || atomic_fetch_sub_explicit(&thread->refcount, 1, memory_order_acq_rel) != 1) {
+        return;
+    }
+    if (thread->destroy) {
+        thread->destroy(thread, thread->user);
+    }
+    free(thread);
+}
+
+uint32_t box64_thread_id(const Box64Thread *thread) {
+    return thread ? thread->id : 0;
+}
+
+void *box64_thread_user(const Box64Thread *thread) {
+    return thread ? thread->user : NULL;
+}
+
+uint32_t box64_thread_resume(Box64Thread *thread) {
+    uint32_t count = atomic_load_explicit(&thread->suspend_count, memory_order_relaxed);
+    while (count > 0 &&
+           !atomic_compare_exchange_weak_explicit(&thread->suspend_count, &count, count - 1,
+                                                  memory_order_acq_rel, memory_order_relaxed)) {
+    }
+    if (count == 1) {
+        box64_event_set(&thread->start_gate);
+    }
+    return count;
+}
+
+uint32_t box64_thread_wait(Box64Thread *thread, uint32_t timeout_ms) {
+    return box64_event_wait(&thread->exited, timeout_ms);
+}
+
+uint32_t box64_thread_exit_code(const Box64Thread *thread) {
+    return atomic_load_explicit(&((Box64Thread *)thread)->exit_code, memory_order_acquire);
+}
+
+Box64Thread *box64_thread_current(void) {
+    return current_thread;
+}
+
+uint32_t box64_thread_current_id(void) {
+    if (current_thread_id == 0) {
+        current_thread_id = allocate_thread_id();
+    }
+    return current_thread_id;
+}
+
+uint32_t box64_thread_live_count(void) {
+    return atomic_load_explicit(&live_threads, memory_order_relaxed);
+}
@@ -0,0 +1,62 @@
+// Box64Thread.h - 客户机线程（CreateThread）的宿主线程与生命周期
+// 纯C实现，每个客户机线程对应一个 pthread：
+//   线程ID 与 Windows 一样是4的倍数；不是由这里创建的宿主线程（主线程、UI线程）第一次询问ID时分配一个
+//   CREATE_SUSPENDED：pthread 立即创建，但在启动门上等待，ResumeThread 把挂起计数减到0时开门
+//   main 回调在新线程上执行客户机代码并返回退出码；返回后退出码可读，exited 事件（手动复位）置位，
+//   WaitForSingleObject(线程句柄) 就是等这个事件
+//   引用计数：运行中的线程自己持有一个，create 返回给调用方一个（对应句柄）；归零时调用 destroy 回调并释放
+// 客户机CPU上下文和栈不在这里管理，由 main/destroy 回调的使用者（Box64Engine）负责
+#ifndef BOX64_THREAD_H
+#define BOX64_THREAD_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "Box64Sync.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BOX64_STILL_ACTIVE              259         // GetExitCodeThread 对运行中线程返回的值
+#define BOX64_THREAD_DEFAULT_HOST_STACK (1024 * 1024)
+
+typedef struct Box64Thread Box64Thread;
+
+typedef uint32_t (*Box64ThreadMain)(Box64Thread *thread, void *user);
+typedef void (*Box64ThreadDestroy)(Box64Thread *thread, void *user);
+
+// 创建并启动（suspended 时等待 resume）；失败返回NULL，回调都不会被调用
+// host_stack_size 为0时使用默认值
+Box64Thread *box64_thread_create(Box64ThreadMain main, Box64ThreadDestroy destroy, void *user,
+                                 bool suspended, size_t host_stack_size);
+
+void box64_thread_retain(Box64Thread *thread);
+void box64_thread_release(Box64Thread *thread);
+
+uint32_t box64_thread_id(const Box64Thread *thread);
+void *box64_thread_user(const Box64Thread *thread);
+
+// 返回之前的挂起计数（已在运行时为0）
+uint32_t box64_thread_resume(Box64Thread *thread);
+
+// 等线程的 main 返回；返回 BOX64_WAIT_OBJECT_0 或 BOX64_WAIT_TIMEOUT
+uint32_t box64_thread_wait(Box64Thread *thread, uint32_t timeout_ms);
+
+// main 返回前为 BOX64_STILL_ACTIVE
+uint32_t box64_thread_exit_code(const Box64Thread *thread);
+
+// 当前宿主线程对应的客户机线程，不是由 box64_thread_create 创建的线程返回NULL
+Box64Thread *box64_thread_current(void);
+
+// 当前线程的ID（非0），宿主线程第一次调用时分配
+uint32_t box64_thread_current_id(void);
+
+// main 尚未返回的客户机线程数
+uint32_t box64_thread_live_count(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BOX64_THREAD_H
@@ -0,0 +1,155 @@
+// Box64Trace.c - 日志门控与跟踪环实现
+#include "Box64Trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+
+_Atomic int box64_log_level = BOX64_LOG_DEFAULT_LEVEL;
+_Atomic uint32_t box64_log_categories = BOX64_LOG_ALL;
+_Atomic(Box64TraceRing *) box64_trace_active_ring = NULL;
+
+static _Atomic(Box64LogSink) log_sink = NULL;
+
+void box64_log_set_level(Box64LogLevel level) {
+    atomic_store_explicit(&box64_log_level, (int)level, memory_order_relaxed);
+}
+
+void box64_log_set_categories(uint32_t categories) {
+    atomic_store_explicit(&box64_log_categories, categories, memory_order_relaxed);
+}
+
+const char *box64_log_level_name(Box64LogLevel level) {
+    switch (level) {
+        case BOX64_LOG_LEVEL_ERROR: return "ERROR";
+        case BOX64_LOG_LEVEL_WARN:  return "WARN";
+        case BOX64_LOG_LEVEL_INFO:  return "INFO";
+        case BOX64_LOG_LEVEL_DEBUG: return "DEBUG";
+        case BOX64_LOG_LEVEL_TRACE: return "TRACE";
+        default:                    return "OFF";
+    }
+}
+
+void box64_log_set_sink(Box64LogSink sink) {
+    atomic_store_explicit(&log_sink, sink, memory_order_release);
+}
+
+void box64_log_write(Box64LogLevel level, uint32_t category, const char *format, ...) {
+    char message[512];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+
+    Box64LogSink sink = atomic_load_explicit(&log_sink, memory_order_acquire);
+    if (sink) {
+        sink(level, category, message);
+    } else {
+        fprintf(stderr, "[Box64][%s] %s\n", box64_log_level_name(level), message);
+    }
+}
+
+// MARK: - 跟踪环
+
+uint64_t box64_trace_fallback_timestamp(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+Box64TraceRing *box64_trace_ring_create(uint32_t capacity) {
+    if (capacity == 0 || capacity > (1u << 24)) {
+        return NULL;
+    }
+    uint64_t size = 1;
+    while (size < capacity) {
+        size <<= 1;
+    }
+    Box64TraceRing *ring = calloc(1, sizeof(Box64TraceRing));
+    if (!ring) {
+        return NULL;
+    }
+    ring->slots = calloc((size_t)size, sizeof(Box64TraceSlot));
+    if (!ring->slots) {
+        free(ring);
+        return NULL;
+    }
+    ring->mask = size - 1;
+    atomic_init(&ring->head, 0);
+    return ring;
+}
+
+// 调用前需先 box64_trace_set_active(NULL) 并确保没有线程仍在写入
+void box64_trace_ring_destroy(Box64TraceRing *ring) {
+    if (!ring) {
+        return;
+    }
+    free(ring->slots);
+    free(ring);
+}
+
+void box64_trace_ring_clear(Box64TraceRing *ring) {
+    if (!ring) {
+        return;
+    }
+    for (uint64_t i = 0; i <= ring->mask; i++) {
+        atomic_store_explicit(&ring->slots[i].sequence, 0, memory_order_relaxed);
+    }
+    atomic_store_explicit(&ring->lost, 0, memory_order_relaxed);
+    atomic_store_explicit(&ring->head, 0, memory_order_release);
+}
+
+void box64_trace_set_active(Box64TraceRing *ring) {
+    atomic_store_explicit(&box64_trace_active_ring, ring, memory_order_release);
+}
+
+size_t box64_trace_ring_snapshot(const Box64TraceRing *ring, Box64TraceEvent *events, size_t max_events) {
+    if (!ring || !events || max_events == 0) {
+        return 0;
+    }
+    const uint64_t head = atomic_load_explicit(&((Box64TraceRing *)ring)->head, memory_order_acquire);
+    const uint64_t capacity = ring->mask + 1;
+    uint64_t count = head < capacity ? head : capacity;
+    if (count > max_events) {
+        count = max_events;
+    }
+
+    // 序号在复制前后一致才说明读到的是完整事件
+    size_t copied = 0;
+    for (uint64_t index = head - count; index < head; index++) {
+        Box64TraceSlot *slot = &((Box64TraceRing *)ring)->slots[index & ring->mask];
+        const uint64_t before = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        if (before != index + 1) {
+            continue;
+        }
+        Box64TraceEvent event = slot->event;
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&slot->sequence, memory_order_relaxed) != before) {
+            continue;
+        }
+        events[copied++] = event;
+    }
+    return copied;
+}
+
+size_t box64_trace_format_event(const Box64TraceEvent *event, uint64_t base_timestamp, char *buffer, size_t size) {
+    static const char *kind_names[] = { "insn", "native", "fault", "thunk", "user" };
+    static const char *map_prefixes[] = { "", "0F ", "0F 38 ", "0F 3A " };
+    const char *kind = event->kind < sizeof(kind_names) / sizeof(kind_names[0]) ? kind_names[event->kind] : "?";
+    int written;
+    if (event->kind == BOX64_TRACE_FAULT || event->kind == BOX64_TRACE_NATIVE_BLOCK || event->kind == BOX64_TRACE_THUNK) {
+        written = snprintf(buffer, size, "+%-10llu %-6s rip=0x%llx aux=0x%x",
+                           (unsigned long long)(event->timestamp - base_timestamp), kind,
+                           (unsigned long long)event->rip, event->aux);
+    } else {
+        written = snprintf(buffer, size, "+%-10llu %-6s rip=0x%llx op=%s%02X len=%u",
+                           (unsigned long long)(event->timestamp - base_timestamp), kind,
+                           (unsigned long long)event->rip, map_prefixes[(event->opcode >> 8) & 3],
+                           event->opcode & 0xFF, event->length);
+    }
+    if (written < 0) {
+        return 0;
+    }
+    return (size_t)written < size ? (size_t)written : size - 1;
+}
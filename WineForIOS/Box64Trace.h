@@ -0,0 +1,221 @@
+// Box64Trace.h - 分级、分类的日志与二进制跟踪环
+// 日志：
+//   BOX64_LOG_COMPILE_LEVEL 以下（更详细）的语句在编译期整体删除，参数也不会求值；
+//   其余语句按运行时级别和类别掩码过滤，过滤掉时只有一次原子读和比较
+//   默认编译级别为 DEBUG（TRACE 语句不进入发布代码），定义 BOX64_TRACE_ENABLED=1 保留 TRACE
+// 跟踪环：
+//   热路径只写定长二进制事件（RIP、操作码、时间戳），不格式化字符串；
+//   多个线程可并发写入，写满后覆盖最旧事件，出错后再导出最近的事件用于事后分析
+#ifndef BOX64_TRACE_H
+#define BOX64_TRACE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// MARK: - 日志级别与类别
+
+typedef enum Box64LogLevel {
+    BOX64_LOG_LEVEL_OFF = -1,
+    BOX64_LOG_LEVEL_ERROR = 0,
+    BOX64_LOG_LEVEL_WARN,
+    BOX64_LOG_LEVEL_INFO,
+    BOX64_LOG_LEVEL_DEBUG,
+    BOX64_LOG_LEVEL_TRACE
+} Box64LogLevel;
+
+enum {
+    BOX64_LOG_CORE   = 1u << 0,   // 初始化、状态管理
+    BOX64_LOG_EXEC   = 1u << 1,   // 执行循环、指令模拟
+    BOX64_LOG_DECODE = 1u << 2,   // 解码、反汇编
+    BOX64_LOG_REGS   = 1u << 3,   // 寄存器读写
+    BOX64_LOG_MEMORY = 1u << 4,   // MMU、堆、映射
+    BOX64_LOG_JIT    = 1u << 5,   // 翻译缓存、本机代码
+    BOX64_LOG_SAFETY = 1u << 6,   // 安全检查
+    BOX64_LOG_ALL    = 0xFFFFFFFFu
+};
+
+#ifndef BOX64_LOG_COMPILE_LEVEL
+#if defined(BOX64_TRACE_ENABLED) && BOX64_TRACE_ENABLED
+#define BOX64_LOG_COMPILE_LEVEL BOX64_LOG_LEVEL_TRACE
+#else
+#define BOX64_LOG_COMPILE_LEVEL BOX64_LOG_LEVEL_DEBUG
+#endif
+#endif
+
+#define BOX64_LOG_DEFAULT_LEVEL BOX64_LOG_LEVEL_INFO
+
+extern _Atomic int box64_log_level;
+extern _Atomic uint32_t box64_log_categories;
+
+void box64_log_set_level(Box64LogLevel level);
+void box64_log_set_categories(uint32_t categories);
+const char *box64_log_level_name(Box64LogLevel level);
+
+static inline bool box64_log_enabled(Box64LogLevel level, uint32_t category) {
+    return (int)level <= atomic_load_explicit(&box64_log_level, memory_order_relaxed) &&
+           (atomic_load_explicit(&box64_log_categories, memory_order_relaxed) & category) != 0;
+}
+
+// 纯C模块的输出；默认写到stderr，应用可替换为NSLog等
+typedef void (*Box64LogSink)(Box64LogLevel level, uint32_t category, const char *message);
+void box64_log_set_sink(Box64LogSink sink);
+void box64_log_write(Box64LogLevel level, uint32_t category, const char *format, ...)
+    __attribute__((format(printf, 3, 4)));
+
+// 统一的“编译期级别 + 运行时过滤”门控，emit 为实际输出语句
+#define BOX64_LOG_GATE(level, category, emit) do { \
+    if ((level) <= BOX64_LOG_COMPILE_LEVEL && box64_log_enabled((level), (category))) { emit; } \
+} while (0)
+
+#define BOX64_LOG(level, category, ...) \
+    BOX64_LOG_GATE(level, category, box64_log_write((level), (category), __VA_ARGS__))
+
+#define BOX64_LOG_ERROR(category, ...) BOX64_LOG(BOX64_LOG_LEVEL_ERROR, category, __VA_ARGS__)
+#define BOX64_LOG_WARN(category, ...)  BOX64_LOG(BOX64_LOG_LEVEL_WARN, category, __VA_ARGS__)
+#define BOX64_LOG_INFO(category, ...)  BOX64_LOG(BOX64_LOG_LEVEL_INFO, category, __VA_ARGS__)
+
+#if BOX64_LOG_COMPILE_LEVEL >= BOX64_LOG_LEVEL_DEBUG
+#define BOX64_LOG_DEBUG(category, ...) BOX64_LOG(BOX64_LOG_LEVEL_DEBUG, category, __VA_ARGS__)
+#else
+#define BOX64_LOG_DEBUG(category, ...) do { } while (0)
+#endif
+
+#if BOX64_LOG_COMPILE_LEVEL >= BOX64_LOG_LEVEL_TRACE
+#define BOX64_LOG_TRACE(category, ...) BOX64_LOG(BOX64_LOG_LEVEL_TRACE, category, __VA_ARGS__)
+#else
+#define BOX64_LOG_TRACE(category, ...) do { } while (0)
+#endif
+
+// Objective-C 代码沿用 NSLog 与 %@ 格式，只替换门控
+#ifdef __OBJC__
+#define B64LogError(category, ...) BOX64_LOG_GATE(BOX64_LOG_LEVEL_ERROR, category, NSLog(__VA_ARGS__))
+#define B64LogWarn(category, ...)  BOX64_LOG_GATE(BOX64_LOG_LEVEL_WARN, category, NSLog(__VA_ARGS__))
+#define B64LogInfo(category, ...)  BOX64_LOG_GATE(BOX64_LOG_LEVEL_INFO, category, NSLog(__VA_ARGS__))
+#if BOX64_LOG_COMPILE_LEVEL >= BOX64_LOG_LEVEL_DEBUG
+#define B64LogDebug(category, ...) BOX64_LOG_GATE(BOX64_LOG_LEVEL_DEBUG, category, NSLog(__VA_ARGS__))
+#else
+#define B64LogDebug(category, ...) do { } while (0)
+#endif
+#if BOX64_LOG_COMPILE_LEVEL >= BOX64_LOG_LEVEL_TRACE
+#define B64LogTrace(category, ...) BOX64_LOG_GATE(BOX64_LOG_LEVEL_TRACE, category, NSLog(__VA_ARGS__))
+#else
+#define B64LogTrace(category, ...) do { } while (0)
+#endif
+#endif
+
+// MARK: - 二进制跟踪环
+
+typedef enum Box64TraceKind {
+    BOX64_TRACE_INSN = 0,       // 解释执行一条指令
+    BOX64_TRACE_NATIVE_BLOCK,   // 进入JIT本机块（aux = 覆盖的指令数）
+    BOX64_TRACE_FAULT,          // 缺页/执行失败（aux = 出错地址低32位）
+    BOX64_TRACE_THUNK,          // 调用宿主API桩（aux = 导入槽号）
+    BOX64_TRACE_USER            // 调用者自定义
+} Box64TraceKind;
+
+typedef struct Box64TraceEvent {
+    uint64_t rip;
+    uint64_t timestamp;         // box64_trace_timestamp() 的计数
+    uint32_t aux;
+    uint16_t opcode;            // 高8位为操作码映射（X86OpcodeMap），低8位为操作码
+    uint8_t kind;               // Box64TraceKind
+    uint8_t length;             // 指令长度
+} Box64TraceEvent;
+
+typedef struct Box64TraceSlot {
+    _Atomic uint64_t sequence;  // 写完后为 序号+1；写入中为 BUSY|序号；不匹配表示正在写/已被覆盖
+    Box64TraceEvent event;
+} Box64TraceSlot;
+
+typedef struct Box64TraceRing {
+    _Atomic uint64_t head;      // 已分配的事件总数
+    _Atomic uint64_t lost;      // 绕圈时槽位仍被较旧的写入者占用而丢弃的事件数
+    uint64_t mask;
+    Box64TraceSlot *slots;
+} Box64TraceRing;
+
+// capacity 向上取整到2的幂
+Box64TraceRing *box64_trace_ring_create(uint32_t capacity);
+void box64_trace_ring_destroy(Box64TraceRing *ring);
+void box64_trace_ring_clear(Box64TraceRing *ring);
+
+// 全局环，NULL表示关闭；热路径只读取这一个指针
+extern _Atomic(Box64TraceRing *) box64_trace_active_ring;
+void box64_trace_set_active(Box64TraceRing *ring);
+
+uint64_t box64_trace_fallback_timestamp(void);
+
+// 单调递增的周期计数：arm64为虚拟计数器，x86-64为TSC，其余平台为纳秒
+static inline uint64_t box64_trace_timestamp(void) {
+#if defined(__aarch64__)
+    uint64_t value;
+    __asm__ volatile("mrs %0, cntvct_el0" : "=r"(value));
+    return value;
+#elif defined(__x86_64__)
+    return __builtin_ia32_rdtsc();
+#else
+    return box64_trace_fallback_timestamp();
+#endif
+}
+
+#define BOX64_TRACE_SLOT_BUSY   (1ULL << 63)
+
+// 无锁写入：一次原子加取得槽位，写完后发布序号，任何情况下都不等待
+// 环被绕过一圈时两个写入者会落在同一槽位：先占住槽位再写，较旧的事件让给较新的；
+// 较新的写入者遇到较旧的还没写完时直接丢弃自己的事件并计入 lost（只在绕圈时发生）
+static inline void box64_trace_ring_record(Box64TraceRing *ring, uint8_t kind, uint64_t rip, uint16_t opcode,
+                                           uint8_t length, uint32_t aux) {
+    const uint64_t index = atomic_fetch_add_explicit(&ring->head, 1, memory_order_relaxed);
+    Box64TraceSlot *slot = &ring->slots[index & ring->mask];
+    uint64_t seen = atomic_load_explicit(&slot->sequence, memory_order_relaxed);
+    for (;;) {
+        if (seen & BOX64_TRACE_SLOT_BUSY) {
+            if ((seen & ~BOX64_TRACE_SLOT_BUSY) < index) {
+                atomic_fetch_add_explicit(&ring->lost, 1, memory_order_relaxed);
+            }
+            return;                                     // 另一个写入者正在写这个槽位
+        }
+        if (seen > index) {
+            return;                                     // 较新的事件已经写完，这个事件已被覆盖
+        }
+        if (atomic_compare_exchange_weak_explicit(&slot->sequence, &seen, BOX64_TRACE_SLOT_BUSY | index,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+            break;
+        }
+    }
+    atomic_thread_fence(memory_order_release);
+    slot->event.rip = rip;
+    slot->event.timestamp = box64_trace_timestamp();
+    slot->event.aux = aux;
+    slot->event.opcode = opcode;
+    slot->event.kind = kind;
+    slot->event.length = length;
+    atomic_store_explicit(&slot->sequence, index + 1, memory_order_release);
+}
+
+// 写入全局环；未启用时只有一次指针读
+static inline void box64_trace(uint8_t kind, uint64_t rip, uint16_t opcode, uint8_t length, uint32_t aux) {
+    Box64TraceRing *ring = atomic_load_explicit(&box64_trace_active_ring, memory_order_acquire);
+    if (ring) {
+        box64_trace_ring_record(ring, kind, rip, opcode, length, aux);
+    }
+}
+
+// 按时间顺序（旧→新）复制最近最多 max_events 个完整写入的事件，返回复制数量
+// 与写入并发时，正在写或已被覆盖的槽位会被跳过
+size_t box64_trace_ring_snapshot(const Box64TraceRing *ring, Box64TraceEvent *events, size_t max_events);
+
+// 把事件格式化为一行文本，返回写入的字符数
+size_t box64_trace_format_event(const Box64TraceEvent *event, uint64_t base_timestamp, char *buffer, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BOX64_TRACE_H
@@ -0,0 +1,304 @@
+// Box64TranslationCache.c - 基本块翻译缓存实现
+// 块存放在固定槽位数组中（槽位不释放，后继指针始终可安全解引用），
+// 哈希桶链按RIP索引，满时按FIFO顺序淘汰
+#include "Box64TranslationCache.h"
+#include <stdlib.h>
+#include <string.h>
+
+struct Box64TranslationCache {
+    Box64Block *blocks;           // 槽位数组
+    uint32_t capacity;
+    int32_t *buckets;             // 哈希桶头（槽位下标，-1为空）
+    uint32_t bucket_mask;
+    uint32_t next_victim;         // FIFO淘汰游标
+    uint32_t live_blocks;
+    uint64_t code_low;            // 已缓存代码的地址范围，用于快速跳过无关失效
+    uint64_t code_high;
+    Box64BlockReleaseCallback release_callback;
+    void *release_userdata;
+    _Atomic uint64_t hits;        // 查找在读锁下并发进行，三个计数用宽松原子加
+    _Atomic uint64_t misses;
+    _Atomic uint64_t chained;
+    uint64_t evictions;           // 只在写锁下更新
+    uint64_t invalidations;
+};
+
+static inline uint32_t hash_rip(uint64_t rip) {
+    // 指令地址低位分布不均，先做一次乘法混合
+    return (uint32_t)((rip * 0x9E3779B97F4A7C15ULL) >> 32);
+}
+
+Box64TranslationCache *box64_tc_create(uint32_t capacity) {
+    if (capacity == 0) {
+        capacity = BOX64_TC_DEFAULT_CAPACITY;
+    }
+
+    Box64TranslationCache *cache = calloc(1, sizeof(Box64TranslationCache));
+    if (!cache) {
+        return NULL;
+    }
+
+    uint32_t bucket_count = 1;
+    while (bucket_count < capacity * 2) {
+        bucket_count <<= 1;
+    }
+
+    cache->blocks = calloc(capacity, sizeof(Box64Block));
+    cache->buckets = malloc(bucket_count * sizeof(int32_t));
+    if (!cache->blocks || !cache->buckets) {
+        free(cache->blocks);
+        free(cache->buckets);
+        free(cache);
+        return NULL;
+    }
+
+    memset(cache->buckets, 0xFF, bucket_count * sizeof(int32_t));
+    cache->capacity = capacity;
+    cache->bucket_mask = bucket_count - 1;
+    cache->code_low = UINT64_MAX;
+    cache->code_high = 0;
+    return cache;
+}
+
+void box64_tc_destroy(Box64TranslationCache *cache) {
+    if (!cache) {
+        return;
+    }
+    box64_tc_flush(cache);
+    free(cache->blocks);
+    free(cache->buckets);
+    free(cache);
+}
+
+void box64_tc_set_release_callback(Box64TranslationCache *cache, Box64BlockReleaseCallback callback, void *userdata) {
+    if (!cache) {
+        return;
+    }
+    cache->release_callback = callback;
+    cache->release_userdata = userdata;
+}
+
+static void unlink_from_bucket(Box64TranslationCache *cache, Box64Block *block) {
+    int32_t slot = (int32_t)(block - cache->blocks);
+    int32_t *link = &cache->buckets[hash_rip(block->guest_start) & cache->bucket_mask];
+    while (*link != -1) {
+        if (*link == slot) {
+            *link = block->hash_next;
+            break;
+        }
+        link = &cache->blocks[*link].hash_next;
+    }
+    block->hash_next = -1;
+}
+
+// 移出缓存；指向它的后继指针在 box64_tc_follow 中通过 valid/guest_start 校验自然失效
+static void retire_block(Box64TranslationCache *cache, Box64Block *block) {
+    if (!block->valid) {
+        return;
+    }
+    if (cache->release_callback) {
+        cache->release_callback(block, cache->release_userdata);
+    }
+    unlink_from_bucket(cache, block);
+    block->valid = false;
+    block->native_code = NULL;
+    block->native_insn_count = 0;
+    block->successor[0] = NULL;
+    block->successor[1] = NULL;
+    cache->live_blocks--;
+}
+
+Box64Block *box64_tc_lookup(Box64TranslationCache *cache, uint64_t rip) {
+    if (!cache) {
+        return NULL;
+    }
+    int32_t slot = cache->buckets[hash_rip(rip) & cache->bucket_mask];
+    while (slot != -1) {
+        Box64Block *block = &cache->blocks[slot];
+        if (block->guest_start == rip) {
+            atomic_fetch_add_explicit(&cache->hits, 1, memory_order_relaxed);
+            return block;
+        }
+        slot = block->hash_next;
+    }
+    atomic_fetch_add_explicit(&cache->misses, 1, memory_order_relaxed);
+    return NULL;
+}
+
+static Box64Block *allocate_slot(Box64TranslationCache *cache) {
+    // 优先使用空闲槽位，否则淘汰FIFO游标处的块
+    for (uint32_t probe = 0; probe < cache->capacity; probe++) {
+        uint32_t index = (cache->next_victim + probe) % cache->capacity;
+        if (!cache->blocks[index].valid) {
+            cache->next_victim = (index + 1) % cache->capacity;
+            return &cache->blocks[index];
+        }
+    }
+    Box64Block *victim = &cache->blocks[cache->next_victim];
+    cache->next_victim = (cache->next_victim + 1) % cache->capacity;
+    retire_block(cache, victim);
+    cache->evictions++;
+    return victim;
+}
+
+Box64Block *box64_tc_translate(Box64TranslationCache *cache, uint64_t rip,
+                               const uint8_t *code, size_t available, X86DecodeStatus *status) {
+    if (status) {
+        *status = X86_DECODE_OK;
+    }
+    if (!cache || !code || available == 0) {
+        if (status) {
+            *status = X86_DECODE_TRUNCATED;
+        }
+        return NULL;
+    }
+
+    // 先把第一条解码到临时变量，失败时不占用槽位
+    X86DecodedInsn first;
+    X86DecodeStatus first_status = x86_decode(code, available, &first);
+    if (first_status != X86_DECODE_OK) {
+        if (status) {
+            *status = first_status;
+        }
+        return NULL;
+    }
+
+    Box64Block *block = allocate_slot(cache);
+    memset(block, 0, offsetof(Box64Block, insns));
+    block->hash_next = -1;
+    block->guest_start = rip;
+    block->insns[0] = first;
+
+    size_t offset = first.length;
+    uint32_t count = 1;
+    const X86DecodedInsn *last = &block->insns[0];
+
+    while (!x86_insn_is_branch(last) && count < BOX64_TC_MAX_BLOCK_INSNS && offset < available) {
+        X86DecodedInsn *next = &block->insns[count];
+        if (x86_decode(code + offset, available - offset, next) != X86_DECODE_OK) {
+            // 无法解码的指令留给下一个块在执行到时报告
+            break;
+        }
+        offset += next->length;
+        last = next;
+        count++;
+    }
+
+    block->insn_count = count;
+    block->guest_end = rip + offset;
+
+    // 静态后继：相对跳转的目标 + 顺序后继
+    if (x86_insn_is_branch(last)) {
+        if (last->form == X86_FORM_REL) {
+            block->successor_rip[BOX64_EDGE_TAKEN] = block->guest_end + (uint64_t)last->imm;
+            bool unconditional = (last->map == X86_MAP_PRIMARY && (last->opcode == 0xE9 || last->opcode == 0xEB));
+            if (!unconditional) {
+                block->successor_rip[BOX64_EDGE_FALLTHROUGH] = block->guest_end;
+            }
+        }
+    } else {
+        block->successor_rip[BOX64_EDGE_FALLTHROUGH] = block->guest_end;
+    }
+
+    uint32_t bucket = hash_rip(rip) & cache->bucket_mask;
+    block->hash_next = cache->buckets[bucket];
+    cache->buckets[bucket] = (int32_t)(block - cache->blocks);
+    block->valid = true;
+    cache->live_blocks++;
+
+    if (rip < cache->code_low) {
+        cache->code_low = rip;
+    }
+    if (block->guest_end > cache->code_high) {
+        cache->code_high = block->guest_end;
+    }
+    return block;
+}
+
+Box64Block *box64_tc_follow(Box64TranslationCache *cache, Box64Block *from, Box64BlockEdge edge, uint64_t next_rip) {
+    if (!cache || !from || edge >= BOX64_EDGE_COUNT) {
+        return NULL;
+    }
+    Box64Block *to = from->successor[edge];
+    if (to && to->valid && to->guest_start == next_rip) {
+        atomic_fetch_add_explicit(&cache->hits, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&cache->chained, 1, memory_order_relaxed);
+        return to;
+    }
+    from->successor[edge] = NULL;
+    return NULL;
+}
+
+void box64_tc_link(Box64Block *from, Box64BlockEdge edge, Box64Block *to) {
+    if (!from || !to || edge >= BOX64_EDGE_COUNT) {
+        return;
+    }
+    // 只链接静态已知的后继，间接跳转每次都走查找
+    if (from->successor_rip[edge] == to->guest_start) {
+        from->successor[edge] = to;
+    }
+}
+
+uint32_t box64_tc_invalidate_range(Box64TranslationCache *cache, uint64_t address, uint64_t size) {
+    if (!cache || size == 0 || cache->live_blocks == 0) {
+        return 0;
+    }
+    uint64_t end = address + size;
+    if (end < address) {
+        end = UINT64_MAX;
+    }
+    if (end <= cache->code_low || address >= cache->code_high) {
+        return 0;
+    }
+
+    uint32_t invalidated = 0;
+    for (uint32_t i = 0; i < cache->capacity; i++) {
+        Box64Block *block = &cache->blocks[i];
+        if (block->valid && block->guest_start < end && address < block->guest_end) {
+            retire_block(cache, block);
+            invalidated++;
+        }
+    }
+    cache->invalidations += invalidated;
+    if (cache->live_blocks == 0) {
+        cache->code_low = UINT64_MAX;
+        cache->code_high = 0;
+    }
+    return invalidated;
+}
+
+void box64_tc_flush(Box64TranslationCache *cache) {
+    if (!cache) {
+        return;
+    }
+    for (uint32_t i = 0; i < cache->capacity; i++) {
+        retire_block(cache, &cache->blocks[i]);
+    }
+    cache->next_victim = 0;
+    cache->code_low = UINT64_MAX;
+    cache->code_high = 0;
+}
+
+void box64_tc_drop_native_code(Box64TranslationCache *cache) {
+    if (!cache) {
+        return;
+    }
+    for (uint32_t i = 0; i < cache->capacity; i++) {
+        cache->blocks[i].native_code = NULL;
+        cache->blocks[i].native_insn_count = 0;
+        atomic_store_explicit(&cache->blocks[i].exec_count, 0, memory_order_relaxed);   // 重新预热后再编译
+    }
+}
+
+void box64_tc_get_stats(const Box64TranslationCache *cache, Box64TCStats *stats) {
+    if (!cache || !stats) {
+        return;
+    }
+    stats->hits = atomic_load_explicit(&cache->hits, memory_order_relaxed);
+    stats->misses = atomic_load_explicit(&cache->misses, memory_order_relaxed);
+    stats->chained = atomic_load_explicit(&cache->chained, memory_order_relaxed);
+    stats->evictions = cache->evictions;
+    stats->invalidations = cache->invalidations;
+    stats->blocks = cache->live_blocks;
+    stats->capacity = cache->capacity;
+}
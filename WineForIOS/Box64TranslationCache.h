@@ -0,0 +1,109 @@
+// Box64TranslationCache.h - 以客户机RIP为键的基本块翻译缓存
+// 纯C实现：块内保存预解码的指令，块之间通过直接后继指针链接
+#ifndef BOX64_TRANSLATION_CACHE_H
+#define BOX64_TRANSLATION_CACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "X86Decoder.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BOX64_TC_DEFAULT_CAPACITY   512     // 默认最多缓存的块数
+#define BOX64_TC_MAX_BLOCK_INSNS    32      // 单块最大指令数
+
+// 后继边
+typedef enum Box64BlockEdge {
+    BOX64_EDGE_FALLTHROUGH = 0,   // 顺序执行/条件不成立
+    BOX64_EDGE_TAKEN = 1,         // 跳转成立
+    BOX64_EDGE_COUNT = 2
+} Box64BlockEdge;
+
+// 解释器的预解码形式：每条指令一个处理函数编号和已解析的操作数（由 Box64Interp 填写和解释）
+typedef struct Box64ThreadedOp {
+    uint8_t handler;            // 处理函数编号
+    uint8_t dst;                // 目的寄存器 / ALU子操作等，含义随处理函数而定
+    uint8_t src;
+    uint8_t size;               // 操作数字节数
+    uint8_t aux;
+    uint8_t has_rex;
+    uint16_t offset;            // 指令相对块首的偏移
+    uint64_t imm;               // 立即数，或跳转指令的绝对目标
+} Box64ThreadedOp;
+
+typedef struct Box64Block {
+    uint64_t guest_start;                       // 块首RIP
+    uint64_t guest_end;                         // 块尾（不含）
+    uint64_t successor_rip[BOX64_EDGE_COUNT];   // 静态可知的后继地址，0表示无
+    struct Box64Block *successor[BOX64_EDGE_COUNT]; // 已链接的后继块（使用前校验guest_start）
+    _Atomic uint64_t exec_count;                // 执行次数（供JIT分层使用），读锁下多线程并发累加
+    void *native_code;                          // JIT生成的本机代码入口，NULL表示仅解释执行
+    int32_t hash_next;                          // 哈希桶链
+    uint32_t insn_count;
+    uint32_t native_insn_count;                 // native_code 覆盖的指令数（从块首起）
+    bool valid;
+    bool threaded;                              // ops 已预解码（重新翻译时清除）
+    bool native_rejected;                       // 编译失败（块首不在JIT子集内等），不再尝试（重新翻译时清除）
+    X86DecodedInsn insns[BOX64_TC_MAX_BLOCK_INSNS];
+    Box64ThreadedOp ops[BOX64_TC_MAX_BLOCK_INSNS];
+} Box64Block;
+
+// 累加执行计数并返回累加后的值；计数只用于分层，宽松顺序即可
+static inline uint64_t box64_block_count_exec(Box64Block *block) {
+    return atomic_fetch_add_explicit(&block->exec_count, 1, memory_order_relaxed) + 1;
+}
+
+// 是否该交给JIT编译：用 >= 而不是 ==，并发累加时跳过阈值的块之后仍会被编译
+static inline bool box64_block_is_hot(const Box64Block *block, uint64_t exec_count, uint64_t threshold) {
+    return threshold && exec_count >= threshold && !block->native_code && !block->native_rejected;
+}
+
+typedef struct Box64TCStats {
+    uint64_t hits;                // 查找命中（含链接命中）
+    uint64_t misses;              // 查找未命中，需要翻译
+    uint64_t chained;             // 通过后继指针直接跳转的次数
+    uint64_t evictions;           // 因容量不足被淘汰的块
+    uint64_t invalidations;       // 因内存映射/保护变化失效的块
+    uint32_t blocks;              // 当前有效块数
+    uint32_t capacity;
+} Box64TCStats;
+
+typedef struct Box64TranslationCache Box64TranslationCache;
+
+// 块失效回调（JIT用来回收本机代码），在块被淘汰或失效时调用
+typedef void (*Box64BlockReleaseCallback)(Box64Block *block, void *userdata);
+
+Box64TranslationCache *box64_tc_create(uint32_t capacity);
+void box64_tc_destroy(Box64TranslationCache *cache);
+void box64_tc_set_release_callback(Box64TranslationCache *cache, Box64BlockReleaseCallback callback, void *userdata);
+
+// 查找已缓存的块，更新命中/未命中计数
+Box64Block *box64_tc_lookup(Box64TranslationCache *cache, uint64_t rip);
+
+// 从 code 开始解码一个基本块并插入缓存（满时淘汰最旧的块）
+// 第一条指令无法解码时返回NULL，status 给出原因
+Box64Block *box64_tc_translate(Box64TranslationCache *cache, uint64_t rip,
+                               const uint8_t *code, size_t available, X86DecodeStatus *status);
+
+// 沿已链接的后继边前进；链接失效时返回NULL并由调用方查找/翻译后调用 box64_tc_link
+Box64Block *box64_tc_follow(Box64TranslationCache *cache, Box64Block *from, Box64BlockEdge edge, uint64_t next_rip);
+void box64_tc_link(Box64Block *from, Box64BlockEdge edge, Box64Block *to);
+
+// 使与 [address, address + size) 重叠的块失效，返回失效块数
+uint32_t box64_tc_invalidate_range(Box64TranslationCache *cache, uint64_t address, uint64_t size);
+void box64_tc_flush(Box64TranslationCache *cache);
+
+// 丢弃所有块的本机代码（JIT代码区回收时调用），块本身和链接保留，之后重新解释执行
+void box64_tc_drop_native_code(Box64TranslationCache *cache);
+
+void box64_tc_get_stats(const Box64TranslationCache *cache, Box64TCStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BOX64_TRANSLATION_CACHE_H
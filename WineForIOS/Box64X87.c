@@ -0,0 +1,1409 @@
+// Box64X87.c - x87 寄存器栈、80位软件浮点与指令执行
+// 快速模式的算术直接用宿主 double 运算，不累积算术异常位（JIT 生成的代码与之一致）；
+// 扩展精度模式的算术全部经过下面的软件浮点：值先拆成 (符号, 指数, 规格化尾数)，
+// 用128位整数做运算，再按控制字的精度（24/53/64位）和舍入方式统一舍入、打包
+#include "Box64X87.h"
+#include "Box64Flags.h"
+#include "Box64Interp.h"
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+typedef unsigned __int128 u128;
+
+#define SW_COND_MASK    (BOX64_X87_SW_C0 | BOX64_X87_SW_C2 | BOX64_X87_SW_C3)
+#define ST_INDEX(x87, i) (((x87)->top + (i)) & 7)
+
+// MARK: - 80位软件浮点
+
+#define F80_BIAS    16383
+#define F80_EMIN    (1 - F80_BIAS)
+#define F80_EMAX    F80_BIAS
+#define F80_INTEGER_BIT 0x8000000000000000ULL
+#define F80_QUIET_BIT   0x4000000000000000ULL
+
+enum { F80_ZERO, F80_NORMAL, F80_INF, F80_NAN };
+enum { CMP_LESS, CMP_EQUAL, CMP_GREATER, CMP_UNORDERED };
+
+typedef struct F80Parts {
+    bool sign;
+    uint8_t kind;
+    int32_t exp;                // NORMAL：值 = mant * 2^(exp - 63)
+    uint64_t mant;              // NORMAL 时最高位为1
+} F80Parts;
+
+static const Box64F80 f80_indefinite = { F80_INTEGER_BIT | F80_QUIET_BIT, 0xFFFF };
+
+// FLD1 / FLDL2T / FLDL2E / FLDPI / FLDLG2 / FLDLN2 / FLDZ（硬件按就近舍入给出的值）
+static const Box64F80 f80_constants[7] = {
+    { 0x8000000000000000ULL, 0x3FFF },
+    { 0xD49A784BCD1B8AFEULL, 0x4000 },
+    { 0xB8AA3B295C17F0BCULL, 0x3FFF },
+    { 0xC90FDAA22168C235ULL, 0x4000 },
+    { 0x9A209A84FBCFF799ULL, 0x3FFD },
+    { 0xB17217F7D1CF79ACULL, 0x3FFE },
+    { 0, 0 },
+};
+
+static inline int clz128(u128 value) {
+    const uint64_t high = (uint64_t)(value >> 64);
+    return high ? __builtin_clzll(high) : 64 + __builtin_clzll((uint64_t)value);
+}
+
+static inline Box64F80 f80_make(bool sign, uint16_t exponent, uint64_t mantissa) {
+    Box64F80 value = { mantissa, (uint16_t)((sign ? 0x8000 : 0) | exponent) };
+    return value;
+}
+
+static inline Box64F80 f80_zero(bool sign) {
+    return f80_make(sign, 0, 0);
+}
+
+static inline Box64F80 f80_inf(bool sign) {
+    return f80_make(sign, 0x7FFF, F80_INTEGER_BIT);
+}
+
+// 非规格化数与非正规数（整数位为0）都规格化；伪零按零处理
+static F80Parts f80_unpack(Box64F80 value) {
+    F80Parts parts = { (value.sign_exponent >> 15) & 1, F80_ZERO, 0, value.mantissa };
+    const int32_t exponent = value.sign_exponent & 0x7FFF;
+    if (exponent == 0x7FFF) {
+        parts.kind = (value.mantissa << 1) == 0 ? F80_INF : F80_NAN;
+        return parts;
+    }
+    if (value.mantissa == 0) {
+        return parts;
+    }
+    const int shift = __builtin_clzll(value.mantissa);
+    parts.kind = F80_NORMAL;
+    parts.mant = value.mantissa << shift;
+    parts.exp = (exponent == 0 ? F80_EMIN : exponent - F80_BIAS) - shift;
+    return parts;
+}
+
+static inline bool f80_is_signaling(Box64F80 value) {
+    return (value.sign_exponent & 0x7FFF) == 0x7FFF && (value.mantissa << 1) != 0 && !(value.mantissa & F80_QUIET_BIT);
+}
+
+// 两个操作数中有NaN：返回静默化的第一个NaN，SNaN 报告无效操作
+static Box64F80 f80_propagate_nan(Box64F80 a, Box64F80 b, const F80Parts *pa, uint16_t *flags) {
+    if (f80_is_signaling(a) || f80_is_signaling(b)) {
+        *flags |= BOX64_X87_SW_IE;
+    }
+    Box64F80 nan = pa->kind == F80_NAN ? a : b;
+    nan.mantissa |= F80_INTEGER_BIT | F80_QUIET_BIT;
+    return nan;
+}
+
+// 把 sig（最高有效位在 bit 127）舍入到高 p 位，p ≤ 0 时整个 sig 都是舍去部分；返回舍入后的整数
+static u128 round_bits(u128 sig, int p, bool sign, unsigned rc, uint16_t *flags) {
+    u128 kept, rest, half;
+    if (p > 0) {
+        const int drop = 128 - p;
+        kept = sig >> drop;
+        rest = sig & (((u128)1 << drop) - 1);
+        half = (u128)1 << (drop - 1);
+    } else {
+        kept = 0;
+        rest = p == 0 ? sig : (sig != 0);
+        half = (u128)1 << 127;
+    }
+    if (rest == 0) {
+        return kept;
+    }
+    *flags |= BOX64_X87_SW_PE;
+    bool up;
+    switch (rc) {
+        case 0:  up = rest > half || (rest == half && (kept & 1)); break;
+        case 1:  up = sign; break;
+        case 2:  up = !sign; break;
+        default: up = false; break;
+    }
+    return kept + up;
+}
+
+// 值 = sig * 2^(exp - 127)（sig 最高位为1），舍入到 prec 位尾数、最小规格化指数 emin；
+// 结果 = k * 2^*scale，k 至多 prec + 1 位（进位时）
+static u128 round_value(bool sign, int32_t exp, u128 sig, int prec, int32_t emin, unsigned rc,
+                        uint16_t *flags, int32_t *scale) {
+    int p = prec;
+    if (exp < emin) {
+        const int64_t deficit = (int64_t)emin - exp;
+        p = deficit > prec + 1 ? -1 : prec - (int)deficit;
+        *scale = emin - prec + 1;
+    } else {
+        *scale = exp - prec + 1;
+    }
+    const uint16_t before = *flags;
+    const u128 k = round_bits(sig, p, sign, rc, flags);
+    if (exp < emin && (*flags & ~before & BOX64_X87_SW_PE)) {
+        *flags |= BOX64_X87_SW_UE;
+    }
+    return k;
+}
+
+// 上溢：就近舍入和朝上溢方向舍入得到无穷，否则得到最大有限值
+static Box64F80 f80_overflow(bool sign, unsigned rc, uint16_t *flags) {
+    *flags |= BOX64_X87_SW_OE | BOX64_X87_SW_PE;
+    if (rc == 0 || (rc == 1 && sign) || (rc == 2 && !sign)) {
+        return f80_inf(sign);
+    }
+    return f80_make(sign, 0x7FFE, ~0ULL);
+}
+
+static Box64F80 f80_round_pack(bool sign, int32_t exp, u128 sig, int prec, unsigned rc, uint16_t *flags) {
+    int32_t scale;
+    u128 k = round_value(sign, exp, sig, prec, F80_EMIN, rc, flags, &scale);
+    if (k == 0) {
+        return f80_zero(sign);
+    }
+    int lead = 127 - clz128(k);
+    if (lead > 63) {
+        k >>= lead - 63;            // 进位得到的 1000…0，移位无损
+        scale += lead - 63;
+        lead = 63;
+    }
+    const int32_t e = scale + lead;
+    if (e > F80_EMAX) {
+        return f80_overflow(sign, rc, flags);
+    }
+    uint64_t mantissa = (uint64_t)k << (63 - lead);
+    if (e < F80_EMIN) {
+        return f80_make(sign, 0, mantissa >> (F80_EMIN - e));
+    }
+    return f80_make(sign, (uint16_t)(e + F80_BIAS), mantissa);
+}
+
+// 值 = s * 2^q
+static Box64F80 f80_normalize_round(bool sign, int32_t q, u128 s, int prec, unsigned rc, uint16_t *flags) {
+    if (s == 0) {
+        return f80_zero(sign);
+    }
+    const int lz = clz128(s);
+    return f80_round_pack(sign, q + 127 - lz, s << lz, prec, rc, flags);
+}
+
+static Box64F80 f80_add(Box64F80 a, Box64F80 b, bool subtract, int prec, unsigned rc, uint16_t *flags) {
+    F80Parts pa = f80_unpack(a), pb = f80_unpack(b);
+    pb.sign ^= subtract;
+    if (pa.kind == F80_NAN || pb.kind == F80_NAN) {
+        return f80_propagate_nan(a, b, &pa, flags);
+    }
+    if (pa.kind == F80_INF || pb.kind == F80_INF) {
+        if (pa.kind == F80_INF && pb.kind == F80_INF && pa.sign != pb.sign) {
+            *flags |= BOX64_X87_SW_IE;
+            return f80_indefinite;
+        }
+        return f80_inf(pa.kind == F80_INF ? pa.sign : pb.sign);
+    }
+    if (pa.kind == F80_ZERO && pb.kind == F80_ZERO) {
+        return f80_zero(pa.sign == pb.sign ? pa.sign : rc == 1);
+    }
+    if (pa.kind == F80_ZERO) {
+        return f80_normalize_round(pb.sign, pb.exp - 63, pb.mant, prec, rc, flags);
+    }
+    if (pb.kind == F80_ZERO) {
+        return f80_normalize_round(pa.sign, pa.exp - 63, pa.mant, prec, rc, flags);
+    }
+
+    // |a| ≥ |b|；尾数放在 bit 125，上方留进位、下方留62位保护位
+    if (pa.exp < pb.exp || (pa.exp == pb.exp && pa.mant < pb.mant)) {
+        const F80Parts t = pa;
+        pa = pb;
+        pb = t;
+    }
+    const u128 big = (u128)pa.mant << 62;
+    u128 small = (u128)pb.mant << 62;
+    const int64_t diff = (int64_t)pa.exp - pb.exp;
+    if (diff >= 126) {
+        small = 1;
+    } else if (diff > 0) {
+        const bool sticky = (small & (((u128)1 << diff) - 1)) != 0;
+        small = (small >> diff) | sticky;
+    }
+    const u128 sum = pa.sign == pb.sign ? big + small : big - small;
+    if (sum == 0) {
+        return f80_zero(rc == 1);
+    }
+    return f80_normalize_round(pa.sign, pa.exp - 125, sum, prec, rc, flags);
+}
+
+static Box64F80 f80_mul(Box64F80 a, Box64F80 b, int prec, unsigned rc, uint16_t *flags) {
+    const F80Parts pa = f80_unpack(a), pb = f80_unpack(b);
+    const bool sign = pa.sign ^ pb.sign;
+    if (pa.kind == F80_NAN || pb.kind == F80_NAN) {
+        return f80_propagate_nan(a, b, &pa, flags);
+    }
+    if ((pa.kind == F80_INF && pb.kind == F80_ZERO) || (pa.kind == F80_ZERO && pb.kind == F80_INF)) {
+        *flags |= BOX64_X87_SW_IE;
+        return f80_indefinite;
+    }
+    if (pa.kind == F80_INF || pb.kind == F80_INF) {
+        return f80_inf(sign);
+    }
+    if (pa.kind == F80_ZERO || pb.kind == F80_ZERO) {
+        return f80_zero(sign);
+    }
+    return f80_normalize_round(sign, pa.exp + pb.exp - 126, (u128)pa.mant * pb.mant, prec, rc, flags);
+}
+
+static Box64F80 f80_div(Box64F80 a, Box64F80 b, int prec, unsigned rc, uint16_t *flags) {
+    const F80Parts pa = f80_unpack(a), pb = f80_unpack(b);
+    const bool sign = pa.sign ^ pb.sign;
+    if (pa.kind == F80_NAN || pb.kind == F80_NAN) {
+        return f80_propagate_nan(a, b, &pa, flags);
+    }
+    if ((pa.kind == F80_INF && pb.kind == F80_INF) || (pa.kind == F80_ZERO && pb.kind == F80_ZERO)) {
+        *flags |= BOX64_X87_SW_IE;
+        return f80_indefinite;
+    }
+    if (pb.kind == F80_ZERO) {
+        if (pa.kind != F80_INF) {
+            *flags |= BOX64_X87_SW_ZE;
+        }
+        return f80_inf(sign);
+    }
+    if (pa.kind == F80_INF) {
+        return f80_inf(sign);
+    }
+    if (pa.kind == F80_ZERO || pb.kind == F80_INF) {
+        return f80_zero(sign);
+    }
+    // 64到65位的商，再求两位，最后一位是粘滞位
+    const u128 numerator = (u128)pa.mant << 64;
+    u128 quotient = numerator / pb.mant;
+    u128 remainder = numerator % pb.mant;
+    for (int bit = 0; bit < 2; bit++) {
+        remainder <<= 1;
+        quotient <<= 1;
+        if (remainder >= pb.mant) {
+            remainder -= pb.mant;
+            quotient |= 1;
+        }
+    }
+    quotient = (quotient << 1) | (remainder != 0);
+    return f80_normalize_round(sign, pa.exp - pb.exp - 67, quotient, prec, rc, flags);
+}
+
+static uint64_t isqrt128(u128 value, u128 *remainder) {
+    u128 result = 0, bit = (u128)1 << 126;
+    while (bit > value) {
+        bit >>= 2;
+    }
+    while (bit) {
+        if (value >= result + bit) {
+            value -= result + bit;
+            result = (result >> 1) + bit;
+        } else {
+            result >>= 1;
+        }
+        bit >>= 2;
+    }
+    *remainder = value;
+    return (uint64_t)result;
+}
+
+static Box64F80 f80_sqrt(Box64F80 a, int prec, unsigned rc, uint16_t *flags) {
+    const F80Parts pa = f80_unpack(a);
+    if (pa.kind == F80_NAN) {
+        return f80_propagate_nan(a, a, &pa, flags);
+    }
+    if (pa.kind == F80_ZERO) {
+        return a;
+    }
+    if (pa.sign) {
+        *flags |= BOX64_X87_SW_IE;
+        return f80_indefinite;
+    }
+    if (pa.kind == F80_INF) {
+        return a;
+    }
+    // 值 = mant * 2^E；被开方数左移 63 或 64 位使剩余指数为偶数，整数平方根得到64位根
+    const int32_t e = pa.exp - 63;
+    const int shift = ((e - 63) & 1) ? 64 : 63;
+    u128 remainder;
+    const uint64_t root = isqrt128((u128)pa.mant << shift, &remainder);
+    // 余数 > 根 等价于真值超过 root + 0.5
+    const u128 s = ((u128)root << 2) | (remainder > root ? 3 : (remainder != 0));
+    return f80_normalize_round(false, (e - shift) / 2 - 2, s, prec, rc, flags);
+}
+
+static int f80_compare(Box64F80 a, Box64F80 b) {
+    const F80Parts pa = f80_unpack(a), pb = f80_unpack(b);
+    if (pa.kind == F80_NAN || pb.kind == F80_NAN) {
+        return CMP_UNORDERED;
+    }
+    if (pa.kind == F80_ZERO && pb.kind == F80_ZERO) {
+        return CMP_EQUAL;
+    }
+    if (pa.sign != pb.sign) {
+        return pa.sign ? CMP_LESS : CMP_GREATER;
+    }
+    int magnitude;
+    if (pa.kind != pb.kind) {
+        magnitude = pa.kind < pb.kind ? -1 : 1;     // ZERO < NORMAL < INF
+    } else if (pa.kind != F80_NORMAL || (pa.exp == pb.exp && pa.mant == pb.mant)) {
+        magnitude = 0;
+    } else if (pa.exp != pb.exp) {
+        magnitude = pa.exp < pb.exp ? -1 : 1;
+    } else {
+        magnitude = pa.mant < pb.mant ? -1 : 1;
+    }
+    if (pa.sign) {
+        magnitude = -magnitude;
+    }
+    return magnitude < 0 ? CMP_LESS : (magnitude > 0 ? CMP_GREATER : CMP_EQUAL);
+}
+
+static Box64F80 f80_from_int(int64_t value) {
+    if (value == 0) {
+        return f80_zero(false);
+    }
+    const bool sign = value < 0;
+    const uint64_t magnitude = sign ? 0 - (uint64_t)value : (uint64_t)value;
+    const int shift = __builtin_clzll(magnitude);
+    return f80_make(sign, (uint16_t)(63 - shift + F80_BIAS), magnitude << shift);
+}
+
+// 按 rc 舍入到整数；NaN、无穷或超出 bits 位有符号范围时返回false
+static bool f80_to_int(Box64F80 value, unsigned rc, int bits, int64_t *out, uint16_t *flags) {
+    const F80Parts parts = f80_unpack(value);
+    if (parts.kind == F80_NAN || parts.kind == F80_INF) {
+        return false;
+    }
+    if (parts.kind == F80_ZERO) {
+        *out = 0;
+        return true;
+    }
+    if (parts.exp >= 64) {
+        return false;
+    }
+    const u128 magnitude = parts.exp >= 63
+        ? (u128)parts.mant
+        : round_bits((u128)parts.mant << 64, parts.exp + 1, parts.sign, rc, flags);
+    const u128 limit = (u128)1 << (bits - 1);
+    if (parts.sign ? magnitude > limit : magnitude >= limit) {
+        return false;
+    }
+    *out = parts.sign ? (int64_t)(0 - (uint64_t)magnitude) : (int64_t)(uint64_t)magnitude;
+    return true;
+}
+
+static Box64F80 f80_round_int(Box64F80 value, unsigned rc, uint16_t *flags) {
+    const F80Parts parts = f80_unpack(value);
+    if (parts.kind != F80_NORMAL || parts.exp >= 63) {
+        return value;
+    }
+    const u128 magnitude = round_bits((u128)parts.mant << 64, parts.exp + 1, parts.sign, rc, flags);
+    return f80_normalize_round(parts.sign, 0, magnitude, 64, rc, flags);
+}
+
+// 舍入到 prec 位二进制浮点（53位 double / 24位 float），返回在目标格式中精确可表示的 double
+static double f80_to_binary(Box64F80 value, int prec, int32_t emin, unsigned rc, uint16_t *flags) {
+    const F80Parts parts = f80_unpack(value);
+    switch (parts.kind) {
+        case F80_ZERO:
+            return parts.sign ? -0.0 : 0.0;
+        case F80_INF:
+            return parts.sign ? -INFINITY : INFINITY;
+        case F80_NAN: {
+            if (f80_is_signaling(value)) {
+                *flags |= BOX64_X87_SW_IE;
+            }
+            const uint64_t bits = ((uint64_t)parts.sign << 63) | 0x7FF8000000000000ULL | ((parts.mant << 1) >> 12);
+            double nan;
+            memcpy(&nan, &bits, sizeof(nan));
+            return nan;
+        }
+        default:
+            break;
+    }
+    int32_t scale;
+    const u128 k = round_value(parts.sign, parts.exp, (u128)parts.mant << 64, prec, emin, rc, flags, &scale);
+    double result = ldexp((double)(uint64_t)k, scale);
+    const double largest = prec == 24 ? (double)FLT_MAX : DBL_MAX;
+    if (result > largest) {
+        *flags |= BOX64_X87_SW_OE | BOX64_X87_SW_PE;
+        if (!(rc == 0 || (rc == 1 && parts.sign) || (rc == 2 && !parts.sign))) {
+            result = largest;
+        } else {
+            result = INFINITY;
+        }
+    }
+    return parts.sign ? -result : result;
+}
+
+Box64F80 box64_f80_from_double(double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    const bool sign = bits >> 63;
+    const uint32_t exponent = (bits >> 52) & 0x7FF;
+    const uint64_t fraction = bits & 0xFFFFFFFFFFFFFULL;
+    if (exponent == 0x7FF) {
+        return f80_make(sign, 0x7FFF, F80_INTEGER_BIT | (fraction << 11));
+    }
+    if (exponent == 0) {
+        if (fraction == 0) {
+            return f80_zero(sign);
+        }
+        const int shift = __builtin_clzll(fraction);
+        return f80_make(sign, (uint16_t)(-1074 + 63 - shift + F80_BIAS), fraction << shift);
+    }
+    return f80_make(sign, (uint16_t)(exponent - 1023 + F80_BIAS), F80_INTEGER_BIT | (fraction << 11));
+}
+
+double box64_f80_to_double(Box64F80 value) {
+    uint16_t flags = 0;
+    return f80_to_binary(value, 53, -1022, 0, &flags);
+}
+
+// MARK: - 寄存器值（两种模式）
+
+typedef union X87Value {
+    double d;
+    Box64F80 x;
+} X87Value;
+
+static inline unsigned rounding_control(const Box64X87 *x87) {
+    return (x87->control >> BOX64_X87_RC_SHIFT) & 3;
+}
+
+static inline int precision_bits(const Box64X87 *x87) {
+    switch ((x87->control >> BOX64_X87_PC_SHIFT) & 3) {
+        case 0:  return 24;
+        case 2:  return 53;
+        default: return 64;
+    }
+}
+
+static inline X87Value value_indefinite(const Box64X87 *x87) {
+    X87Value value;
+    if (x87->extended) {
+        value.x = f80_indefinite;
+    } else {
+        const uint64_t bits = 0xFFF8000000000000ULL;
+        memcpy(&value.d, &bits, sizeof(value.d));
+    }
+    return value;
+}
+
+static inline X87Value value_from_double(const Box64X87 *x87, double d) {
+    X87Value value;
+    if (x87->extended) {
+        value.x = box64_f80_from_double(d);
+    } else {
+        value.d = d;
+    }
+    return value;
+}
+
+static inline X87Value value_from_f80(const Box64X87 *x87, Box64F80 x) {
+    X87Value value;
+    if (x87->extended) {
+        value.x = x;
+    } else {
+        value.d = box64_f80_to_double(x);
+    }
+    return value;
+}
+
+// FILD：扩展精度模式精确，快速模式超过53位的整数按就近舍入
+static inline X87Value value_from_int(const Box64X87 *x87, int64_t i) {
+    X87Value value;
+    if (x87->extended) {
+        value.x = f80_from_int(i);
+    } else {
+        value.d = (double)i;
+    }
+    return value;
+}
+
+static inline double value_to_double(Box64X87 *x87, X87Value value) {
+    return x87->extended ? f80_to_binary(value.x, 53, -1022, rounding_control(x87), &x87->status) : value.d;
+}
+
+static inline float value_to_float(Box64X87 *x87, X87Value value) {
+    return x87->extended ? (float)f80_to_binary(value.x, 24, -126, rounding_control(x87), &x87->status)
+                         : (float)value.d;
+}
+
+static inline Box64F80 value_to_f80(const Box64X87 *x87, X87Value value) {
+    return x87->extended ? value.x : box64_f80_from_double(value.d);
+}
+
+static inline bool value_is_nan(const Box64X87 *x87, X87Value value) {
+    return x87->extended ? f80_unpack(value.x).kind == F80_NAN : value.d != value.d;
+}
+
+static inline bool value_sign(const Box64X87 *x87, X87Value value) {
+    return x87->extended ? (value.x.sign_exponent >> 15) & 1 : signbit(value.d) != 0;
+}
+
+static double round_double(double value, unsigned rc) {
+    switch (rc) {
+        case 0:  return nearbyint(value);
+        case 1:  return floor(value);
+        case 2:  return ceil(value);
+        default: return trunc(value);
+    }
+}
+
+// 算术子操作与 D8 /r 编号一致：0 ADD, 1 MUL, 4 SUB (a-b), 5 SUBR (b-a), 6 DIV (a/b), 7 DIVR (b/a)
+static X87Value value_arith(Box64X87 *x87, unsigned op, X87Value a, X87Value b) {
+    X87Value result;
+    if (!x87->extended) {
+        switch (op) {
+            case 0:  result.d = a.d + b.d; break;
+            case 1:  result.d = a.d * b.d; break;
+            case 4:  result.d = a.d - b.d; break;
+            case 5:  result.d = b.d - a.d; break;
+            case 6:  result.d = a.d / b.d; break;
+            default: result.d = b.d / a.d; break;
+        }
+        return result;
+    }
+    const int prec = precision_bits(x87);
+    const unsigned rc = rounding_control(x87);
+    switch (op) {
+        case 0:  result.x = f80_add(a.x, b.x, false, prec, rc, &x87->status); break;
+        case 1:  result.x = f80_mul(a.x, b.x, prec, rc, &x87->status); break;
+        case 4:  result.x = f80_add(a.x, b.x, true, prec, rc, &x87->status); break;
+        case 5:  result.x = f80_add(b.x, a.x, true, prec, rc, &x87->status); break;
+        case 6:  result.x = f80_div(a.x, b.x, prec, rc, &x87->status); break;
+        default: result.x = f80_div(b.x, a.x, prec, rc, &x87->status); break;
+    }
+    return result;
+}
+
+static int value_compare(const Box64X87 *x87, X87Value a, X87Value b) {
+    if (x87->extended) {
+        return f80_compare(a.x, b.x);
+    }
+    if (a.d < b.d) return CMP_LESS;
+    if (a.d > b.d) return CMP_GREATER;
+    if (a.d == b.d) return CMP_EQUAL;
+    return CMP_UNORDERED;
+}
+
+static bool value_to_int(Box64X87 *x87, X87Value value, unsigned rc, int bits, int64_t *out) {
+    if (x87->extended) {
+        return f80_to_int(value.x, rc, bits, out, &x87->status);
+    }
+    const double rounded = round_double(value.d, rc);
+    const double limit = ldexp(1.0, bits - 1);
+    if (!(rounded >= -limit && rounded < limit)) {
+        return false;
+    }
+    if (rounded != value.d) {
+        x87->status |= BOX64_X87_SW_PE;
+    }
+    *out = (int64_t)rounded;
+    return true;
+}
+
+// MARK: - 寄存器栈
+
+static inline X87Value st_get(const Box64X87 *x87, unsigned i) {
+    X87Value value;
+    const unsigned p = ST_INDEX(x87, i);
+    if (x87->extended) {
+        value.x = x87->st80[p];
+    } else {
+        value.d = x87->st[p];
+    }
+    return value;
+}
+
+static inline void st_set(Box64X87 *x87, unsigned i, X87Value value) {
+    const unsigned p = ST_INDEX(x87, i);
+    if (x87->extended) {
+        x87->st80[p] = value.x;
+    } else {
+        x87->st[p] = value.d;
+    }
+    x87->valid |= 1u << p;
+}
+
+static inline bool st_valid(const Box64X87 *x87, unsigned i) {
+    return (x87->valid >> ST_INDEX(x87, i)) & 1;
+}
+
+// 栈下溢（读空寄存器）：IE|SF，C1=0；异常被屏蔽，调用方写入不定值
+static inline void stack_underflow(Box64X87 *x87) {
+    x87->status = (x87->status & ~BOX64_X87_SW_C1) | BOX64_X87_SW_IE | BOX64_X87_SW_SF;
+}
+
+// 读 ST(i)，空寄存器得到不定值
+static inline X87Value st_read(Box64X87 *x87, unsigned i) {
+    if (!st_valid(x87, i)) {
+        stack_underflow(x87);
+        return value_indefinite(x87);
+    }
+    return st_get(x87, i);
+}
+
+// 入栈：新的 ST(0) 非空时为栈上溢（IE|SF，C1=1），写入不定值
+static void st_push(Box64X87 *x87, X87Value value) {
+    x87->top = (x87->top - 1) & 7;
+    if (x87->valid & (1u << x87->top)) {
+        x87->status |= BOX64_X87_SW_IE | BOX64_X87_SW_SF | BOX64_X87_SW_C1;
+        value = value_indefinite(x87);
+    }
+    st_set(x87, 0, value);
+}
+
+static inline void st_pop(Box64X87 *x87) {
+    x87->valid &= ~(1u << x87->top);
+    x87->top = (x87->top + 1) & 7;
+}
+
+static inline void set_condition(Box64X87 *x87, uint16_t bits) {
+    x87->status = (x87->status & ~(SW_COND_MASK | BOX64_X87_SW_C1)) | bits;
+}
+
+// FCOM 系列：C3/C2/C0；无序时 FCOM 报告无效操作，FUCOM 只对 SNaN 报告
+static void compare_to_status(Box64X87 *x87, X87Value a, X87Value b, bool unordered_ok) {
+    static const uint16_t codes[4] = {
+        [CMP_LESS] = BOX64_X87_SW_C0, [CMP_EQUAL] = BOX64_X87_SW_C3, [CMP_GREATER] = 0,
+        [CMP_UNORDERED] = BOX64_X87_SW_C0 | BOX64_X87_SW_C2 | BOX64_X87_SW_C3,
+    };
+    const int result = value_compare(x87, a, b);
+    if (result == CMP_UNORDERED &&
+        (!unordered_ok || (x87->extended && (f80_is_signaling(a.x) || f80_is_signaling(b.x))))) {
+        x87->status |= BOX64_X87_SW_IE;
+    }
+    set_condition(x87, codes[result]);
+}
+
+// FCOMI 系列：ZF/PF/CF，与 COMISS 相同
+static void compare_to_rflags(Box64Context *ctx, X87Value a, X87Value b, bool unordered_ok) {
+    static const uint64_t codes[4] = {
+        [CMP_LESS] = X86_FLAG_CF, [CMP_EQUAL] = X86_FLAG_ZF, [CMP_GREATER] = 0,
+        [CMP_UNORDERED] = X86_FLAG_ZF | X86_FLAG_PF | X86_FLAG_CF,
+    };
+    Box64X87 *x87 = &ctx->x87;
+    const int result = value_compare(x87, a, b);
+    if (result == CMP_UNORDERED && !unordered_ok) {
+        x87->status |= BOX64_X87_SW_IE;
+    }
+    x87->status &= ~BOX64_X87_SW_C1;
+    box64_flags_set(ctx, (ctx->rflags & ~(uint64_t)X86_FLAGS_ARITH) | codes[result]);
+}
+
+// MARK: - 公共接口
+
+void box64_x87_reset(Box64Context *ctx) {
+    Box64X87 *x87 = &ctx->x87;
+    const uint8_t extended = x87->extended;
+    memset(x87, 0, sizeof(*x87));
+    x87->control = BOX64_X87_CONTROL_DEFAULT;
+    x87->extended = extended;
+}
+
+void box64_x87_set_extended(Box64Context *ctx, bool extended) {
+    Box64X87 *x87 = &ctx->x87;
+    if ((x87->extended != 0) == extended) {
+        return;
+    }
+    for (unsigned p = 0; p < 8; p++) {
+        if (extended) {
+            x87->st80[p] = box64_f80_from_double(x87->st[p]);
+        } else {
+            x87->st[p] = box64_f80_to_double(x87->st80[p]);
+        }
+    }
+    x87->extended = extended;
+}
+
+uint16_t box64_x87_status_word(const Box64Context *ctx) {
+    return (uint16_t)((ctx->x87.status & ~BOX64_X87_SW_TOP) | ((ctx->x87.top & 7) << 11));
+}
+
+uint16_t box64_x87_tag_word(const Box64Context *ctx) {
+    const Box64X87 *x87 = &ctx->x87;
+    uint16_t tags = 0;
+    for (unsigned p = 0; p < 8; p++) {
+        unsigned tag;
+        if (!(x87->valid & (1u << p))) {
+            tag = 3;
+        } else {
+            const Box64F80 value = x87->extended ? x87->st80[p] : box64_f80_from_double(x87->st[p]);
+            const uint16_t exponent = value.sign_exponent & 0x7FFF;
+            if (exponent == 0 && value.mantissa == 0) {
+                tag = 1;
+            } else if (exponent == 0 || exponent == 0x7FFF || !(value.mantissa & F80_INTEGER_BIT)) {
+                tag = 2;
+            } else {
+                tag = 0;
+            }
+        }
+        tags |= (uint16_t)(tag << (p * 2));
+    }
+    return tags;
+}
+
+double box64_x87_read_st(const Box64Context *ctx, unsigned index) {
+    const Box64X87 *x87 = &ctx->x87;
+    if (!st_valid(x87, index & 7)) {
+        return NAN;
+    }
+    const unsigned p = ST_INDEX(x87, index & 7);
+    return x87->extended ? box64_f80_to_double(x87->st80[p]) : x87->st[p];
+}
+
+// MARK: - 编码表
+
+// 各操作码 /r 内存形式的访问宽度，0 = 不支持（FLDENV/FNSTENV/FRSTOR/FNSAVE/FBLD/FBSTP 及未定义形式）
+static const uint8_t memory_sizes[8][8] = {
+    { 4, 4, 4, 4, 4, 4, 4, 4 },         // D8 m32fp
+    { 4, 0, 4, 4, 0, 2, 0, 2 },         // D9 FLD/FST/FSTP m32，FLDCW/FNSTCW
+    { 4, 4, 4, 4, 4, 4, 4, 4 },         // DA m32int
+    { 4, 4, 4, 4, 0, 10, 0, 10 },       // DB FILD/FISTTP/FIST/FISTP m32，FLD/FSTP m80
+    { 8, 8, 8, 8, 8, 8, 8, 8 },         // DC m64fp
+    { 8, 8, 8, 8, 0, 0, 0, 2 },         // DD FLD/FISTTP/FST/FSTP m64，FNSTSW
+    { 2, 2, 2, 2, 2, 2, 2, 2 },         // DE m16int
+    { 2, 2, 2, 2, 0, 8, 0, 8 },         // DF FILD/FISTTP/FIST/FISTP m16，FILD/FISTP m64
+};
+
+// 寄存器形式中未定义（或需要未建模状态）的编码：[操作码][/r] 的位 i 对应 ST(i)
+static const uint8_t register_invalid[8][8] = {
+    { 0 },
+    { 0, 0, 0xFE, 0, 0xCC, 0x80, 0, 0 },            // D9: D1-D7, E2/E3/E6/E7, EF
+    { 0, 0, 0, 0, 0xFF, 0xFD, 0xFF, 0xFF },         // DA: 只有 FCMOVcc 与 FUCOMPP
+    { 0, 0, 0, 0, 0xE0, 0, 0, 0xFF },               // DB: E5-E7, F8-FF
+    { 0 },
+    { 0, 0, 0, 0, 0, 0, 0xFF, 0xFF },               // DD: F0-FF
+    { 0, 0, 0, 0xFD, 0, 0, 0, 0 },                  // DE: 只有 FCOMPP（D9）
+    { 0, 0, 0, 0, 0xFE, 0, 0, 0xFF },               // DF: 只有 FNSTSW AX（E0），F8-FF
+};
+
+bool box64_x87_supported(const X86DecodedInsn *insn) {
+    if (insn->map != X86_MAP_PRIMARY) {
+        return false;
+    }
+    if (insn->opcode == 0x9B) {
+        return true;
+    }
+    if (insn->opcode < 0xD8 || insn->opcode > 0xDF) {
+        return false;
+    }
+    const unsigned row = insn->opcode - 0xD8, r = (insn->modrm >> 3) & 7;
+    if (x86_insn_is_memory(insn)) {
+        return memory_sizes[row][r] != 0;
+    }
+    return !((register_invalid[row][r] >> (insn->modrm & 7)) & 1);
+}
+
+uint8_t box64_x87_memory_size(const X86DecodedInsn *insn) {
+    if (insn->map != X86_MAP_PRIMARY || insn->opcode < 0xD8 || insn->opcode > 0xDF || !x86_insn_is_memory(insn)) {
+        return 0;
+    }
+    return memory_sizes[insn->opcode - 0xD8][(insn->modrm >> 3) & 7];
+}
+
+// MARK: - 访存
+
+static inline bool guest_read(Box64Context *ctx, uint64_t address, uint8_t size, void *out) {
+    const uint8_t *host = box64_mmu_translate(&ctx->mmu, address, size, BOX64_ACCESS_READ);
+    if (host) {
+        memcpy(out, host, size);
+        return true;
+    }
+    return box64_mmu_crosses_page(address, size) && box64_mmu_copy_from_guest(&ctx->mmu, out, address, size);
+}
+
+static inline bool guest_write(Box64Context *ctx, uint64_t address, uint8_t size, const void *data) {
+    uint8_t *host = box64_mmu_translate(&ctx->mmu, address, size, BOX64_ACCESS_WRITE);
+    if (host) {
+        memcpy(host, data, size);
+        return true;
+    }
+    return box64_mmu_crosses_page(address, size) && box64_mmu_copy_to_guest(&ctx->mmu, address, data, size);
+}
+
+// 内存源操作数按指令转换为寄存器值：D8/DC 浮点，DA/DE 整数
+static X87Value load_arith_operand(const Box64X87 *x87, unsigned row, const uint8_t *bytes) {
+    switch (row) {
+        case 0: { float f; memcpy(&f, bytes, 4); return value_from_double(x87, f); }
+        case 4: { double d; memcpy(&d, bytes, 8); return value_from_double(x87, d); }
+        case 2: { int32_t i; memcpy(&i, bytes, 4); return value_from_int(x87, i); }
+        default: { int16_t i; memcpy(&i, bytes, 2); return value_from_int(x87, i); }
+    }
+}
+
+// FIST/FISTP/FISTTP：越界或NaN时写入整数不定值并报告无效操作
+static void store_integer(Box64X87 *x87, X87Value value, bool valid, unsigned rc, uint8_t size, uint8_t *bytes) {
+    int64_t result = 0;
+    if (!valid || !value_to_int(x87, value, rc, size * 8, &result)) {
+        x87->status |= BOX64_X87_SW_IE;
+        result = INT64_MIN >> (64 - size * 8);
+    }
+    memcpy(bytes, &result, size);   // 小端：低 size 字节
+}
+
+// MARK: - 执行
+
+static Box64X87Status execute_memory(Box64Context *ctx, const X86DecodedInsn *insn, uint64_t address,
+                                     uint64_t *fault_address) {
+    Box64X87 *x87 = &ctx->x87;
+    const unsigned row = insn->opcode - 0xD8, r = (insn->modrm >> 3) & 7;
+    const uint8_t size = memory_sizes[row][r];
+    const uint16_t saved_status = x87->status;
+    uint8_t bytes[10];
+
+#define READ_OPERAND() do { \
+    if (!guest_read(ctx, address, size, bytes)) { if (fault_address) *fault_address = address; return BOX64_X87_FAULT; } \
+} while (0)
+#define WRITE_OPERAND() do { \
+    if (!guest_write(ctx, address, size, bytes)) { \
+        x87->status = saved_status; \
+        if (fault_address) *fault_address = address; \
+        return BOX64_X87_FAULT; \
+    } \
+} while (0)
+
+    if (size == 0) {
+        return BOX64_X87_UNSUPPORTED;
+    }
+
+    // D8/DA/DC/DE：ST(0) op m
+    if (!(row & 1)) {
+        READ_OPERAND();
+        const X87Value operand = load_arith_operand(x87, row, bytes);
+        const bool valid = st_valid(x87, 0);
+        if (!valid) {
+            stack_underflow(x87);
+        }
+        const X87Value st0 = valid ? st_get(x87, 0) : value_indefinite(x87);
+        if (r == 2 || r == 3) {
+            if (!valid) {
+                set_condition(x87, SW_COND_MASK);
+            } else {
+                compare_to_status(x87, st0, operand, false);
+            }
+            if (r == 3) {
+                st_pop(x87);
+            }
+        } else {
+            st_set(x87, 0, valid ? value_arith(x87, r, st0, operand) : st0);
+        }
+        return BOX64_X87_OK;
+    }
+
+    const bool st0_valid = st_valid(x87, 0);
+    switch (row) {
+        case 1:     // D9
+            switch (r) {
+                case 0: {
+                    READ_OPERAND();
+                    float f;
+                    memcpy(&f, bytes, 4);
+                    st_push(x87, value_from_double(x87, f));
+                    return BOX64_X87_OK;
+                }
+                case 2:
+                case 3: {
+                    const float f = value_to_float(x87, st_read(x87, 0));
+                    memcpy(bytes, &f, 4);
+                    WRITE_OPERAND();
+                    if (r == 3) {
+                        st_pop(x87);
+                    }
+                    return BOX64_X87_OK;
+                }
+                case 5: {
+                    READ_OPERAND();
+                    uint16_t control;
+                    memcpy(&control, bytes, 2);
+                    x87->control = control | 0x0040;
+                    return BOX64_X87_OK;
+                }
+                default: {  // FNSTCW
+                    memcpy(bytes, &x87->control, 2);
+                    WRITE_OPERAND();
+                    return BOX64_X87_OK;
+                }
+            }
+        case 3:     // DB
+            switch (r) {
+                case 0: {
+                    READ_OPERAND();
+                    int32_t i;
+                    memcpy(&i, bytes, 4);
+                    st_push(x87, value_from_int(x87, i));
+                    return BOX64_X87_OK;
+                }
+                case 5: {
+                    READ_OPERAND();
+                    Box64F80 x;
+                    memcpy(&x.mantissa, bytes, 8);
+                    memcpy(&x.sign_exponent, bytes + 8, 2);
+                    st_push(x87, value_from_f80(x87, x));
+                    return BOX64_X87_OK;
+                }
+                case 7: {
+                    const Box64F80 x = value_to_f80(x87, st_read(x87, 0));
+                    memcpy(bytes, &x.mantissa, 8);
+                    memcpy(bytes + 8, &x.sign_exponent, 2);
+                    WRITE_OPERAND();
+                    st_pop(x87);
+                    return BOX64_X87_OK;
+                }
+                default:
+                    break;      // 1-3：整数存储，与 DD/DF 共用
+            }
+            break;
+        case 5:     // DD
+            switch (r) {
+                case 0: {
+                    READ_OPERAND();
+                    double d;
+                    memcpy(&d, bytes, 8);
+                    st_push(x87, value_from_double(x87, d));
+                    return BOX64_X87_OK;
+                }
+                case 2:
+                case 3: {
+                    const double d = value_to_double(x87, st_read(x87, 0));
+                    memcpy(bytes, &d, 8);
+                    WRITE_OPERAND();
+                    if (r == 3) {
+                        st_pop(x87);
+                    }
+                    return BOX64_X87_OK;
+                }
+                case 7: {   // FNSTSW m16
+                    const uint16_t status = box64_x87_status_word(ctx);
+                    memcpy(bytes, &status, 2);
+                    WRITE_OPERAND();
+                    return BOX64_X87_OK;
+                }
+                default:
+                    break;      // 1：FISTTP m64
+            }
+            break;
+        default:    // DF
+            if (r == 0 || r == 5) {
+                READ_OPERAND();
+                int64_t i = 0;
+                if (r == 0) {
+                    int16_t i16;
+                    memcpy(&i16, bytes, 2);
+                    i = i16;
+                } else {
+                    memcpy(&i, bytes, 8);
+                }
+                st_push(x87, value_from_int(x87, i));
+                return BOX64_X87_OK;
+            }
+            break;      // 1-3、7：整数存储
+    }
+
+    // 整数存储：/1 FISTTP（截断）、/2 FIST、/3 FISTP、DF /7 FISTP m64
+    if (!st0_valid) {
+        stack_underflow(x87);
+    }
+    const unsigned rc = r == 1 ? 3 : rounding_control(x87);
+    store_integer(x87, st0_valid ? st_get(x87, 0) : value_indefinite(x87), st0_valid, rc, size, bytes);
+    WRITE_OPERAND();
+    if (r != 2) {
+        st_pop(x87);
+    }
+    return BOX64_X87_OK;
+
+#undef READ_OPERAND
+#undef WRITE_OPERAND
+}
+
+// 超越函数的参数超出 ±2^63 时硬件置 C2 并保持操作数不变
+static inline bool trig_in_range(Box64X87 *x87, double x) {
+    if (fabs(x) >= 9223372036854775808.0) {
+        x87->status |= BOX64_X87_SW_C2;
+        return false;
+    }
+    x87->status &= ~BOX64_X87_SW_C2;
+    return true;
+}
+
+// FXAM：C3/C2/C0 给出类别，C1 为符号
+static void examine(Box64X87 *x87) {
+    uint16_t code;
+    const X87Value value = st_get(x87, 0);
+    const Box64F80 x = value_to_f80(x87, value);
+    const uint16_t exponent = x.sign_exponent & 0x7FFF;
+    if (!st_valid(x87, 0)) {
+        code = BOX64_X87_SW_C3 | BOX64_X87_SW_C0;
+    } else if (exponent == 0x7FFF) {
+        code = (x.mantissa << 1) == 0 ? (BOX64_X87_SW_C2 | BOX64_X87_SW_C0) : BOX64_X87_SW_C0;
+    } else if (exponent == 0) {
+        code = x.mantissa == 0 ? BOX64_X87_SW_C3 : (BOX64_X87_SW_C3 | BOX64_X87_SW_C2);
+    } else {
+        code = (x.mantissa & F80_INTEGER_BIT) ? BOX64_X87_SW_C2 : 0;
+    }
+    set_condition(x87, code | ((x.sign_exponent & 0x8000) ? BOX64_X87_SW_C1 : 0));
+}
+
+// D9 E0-FF：ST(0) 上的一元运算、常数与超越函数
+static void execute_d9_special(Box64Context *ctx, unsigned r, unsigned i) {
+    Box64X87 *x87 = &ctx->x87;
+
+    if (r == 5) {   // FLD1 / FLDL2T / FLDL2E / FLDPI / FLDLG2 / FLDLN2 / FLDZ
+        st_push(x87, value_from_f80(x87, f80_constants[i]));
+        return;
+    }
+    if (r == 6 && (i == 6 || i == 7)) {   // FDECSTP / FINCSTP
+        x87->top = (x87->top + (i == 6 ? 7 : 1)) & 7;
+        x87->status &= ~BOX64_X87_SW_C1;
+        return;
+    }
+    if (r == 4 && i == 5) {
+        examine(x87);
+        return;
+    }
+
+    // 其余都读 ST(0)；需要 ST(1) 的再检查 ST(1)
+    const bool needs_st1 = (r == 6 && (i == 1 || i == 3 || i == 5)) || (r == 7 && (i == 0 || i == 1 || i == 5));
+    if (!st_valid(x87, 0) || (needs_st1 && !st_valid(x87, 1))) {
+        stack_underflow(x87);
+        // FYL2X/FPATAN/FYL2XP1 写 ST(1) 后出栈，其余写 ST(0)
+        const bool pops = (r == 6 && (i == 1 || i == 3)) || (r == 7 && i == 1);
+        if (r == 4 && i == 4) {
+            set_condition(x87, SW_COND_MASK);
+        } else {
+            st_set(x87, pops ? 1 : 0, value_indefinite(x87));
+            if (pops) {
+                st_pop(x87);
+            }
+        }
+        return;
+    }
+
+    const X87Value st0 = st_get(x87, 0);
+    const unsigned rc = rounding_control(x87);
+    switch (r * 8 + i) {
+        case 4 * 8 + 0: {   // FCHS
+            X87Value value = st0;
+            if (x87->extended) {
+                value.x.sign_exponent ^= 0x8000;
+            } else {
+                value.d = -value.d;
+            }
+            st_set(x87, 0, value);
+            return;
+        }
+        case 4 * 8 + 1: {   // FABS
+            X87Value value = st0;
+            if (x87->extended) {
+                value.x.sign_exponent &= 0x7FFF;
+            } else {
+                value.d = fabs(value.d);
+            }
+            st_set(x87, 0, value);
+            return;
+        }
+        case 4 * 8 + 4:     // FTST
+            compare_to_status(x87, st0, value_from_double(x87, 0.0), false);
+            return;
+        case 7 * 8 + 2:     // FSQRT
+            if (x87->extended) {
+                X87Value value;
+                value.x = f80_sqrt(st0.x, precision_bits(x87), rc, &x87->status);
+                st_set(x87, 0, value);
+            } else {
+                st_set(x87, 0, value_from_double(x87, sqrt(st0.d)));
+            }
+            return;
+        case 7 * 8 + 4:     // FRNDINT
+            if (x87->extended) {
+                X87Value value;
+                value.x = f80_round_int(st0.x, rc, &x87->status);
+                st_set(x87, 0, value);
+            } else {
+                st_set(x87, 0, value_from_double(x87, round_double(st0.d, rc)));
+            }
+            return;
+        case 7 * 8 + 5: {   // FSCALE：ST(0) * 2^trunc(ST(1))
+            const double n = trunc(value_to_double(x87, st_get(x87, 1)));
+            const int scale = n > 65536 ? 65536 : (n < -65536 ? -65536 : (int)n);
+            if (!x87->extended) {
+                st_set(x87, 0, value_from_double(x87, ldexp(st0.d, scale)));
+                return;
+            }
+            const F80Parts parts = f80_unpack(st0.x);
+            if (parts.kind == F80_NORMAL) {
+                X87Value value;
+                value.x = f80_round_pack(parts.sign, parts.exp + scale, (u128)parts.mant << 64, 64, rc, &x87->status);
+                st_set(x87, 0, value);
+            }
+            return;
+        }
+        case 6 * 8 + 4: {   // FXTRACT：ST(0) = 指数，再压入有效数
+            if (x87->extended) {
+                const F80Parts parts = f80_unpack(st0.x);
+                if (parts.kind == F80_NORMAL) {
+                    X87Value exponent, significand;
+                    exponent.x = f80_from_int(parts.exp);
+                    significand.x = f80_make(parts.sign, F80_BIAS, parts.mant);
+                    st_set(x87, 0, exponent);
+                    st_push(x87, significand);
+                    return;
+                }
+            }
+            const double x = value_to_double(x87, st0);
+            if (x == 0.0) {
+                x87->status |= BOX64_X87_SW_ZE;
+                st_set(x87, 0, value_from_double(x87, -INFINITY));
+                st_push(x87, st0);
+                return;
+            }
+            const double exponent = logb(x);
+            st_set(x87, 0, value_from_double(x87, exponent));
+            st_push(x87, value_from_double(x87, isfinite(x) ? scalbn(x, -(int)exponent) : x));
+            return;
+        }
+        default:
+            break;
+    }
+
+    // 超越函数与部分余数：两种模式都经 double 计算
+    const double x = value_to_double(x87, st0);
+    switch (r * 8 + i) {
+        case 6 * 8 + 0:     // F2XM1
+            st_set(x87, 0, value_from_double(x87, expm1(x * M_LN2)));
+            return;
+        case 6 * 8 + 1:     // FYL2X：ST(1) = ST(1) * log2(ST(0))，出栈
+            st_set(x87, 1, value_from_double(x87, value_to_double(x87, st_get(x87, 1)) * log2(x)));
+            st_pop(x87);
+            return;
+        case 7 * 8 + 1:     // FYL2XP1
+            st_set(x87, 1, value_from_double(x87, value_to_double(x87, st_get(x87, 1)) * log1p(x) / M_LN2));
+            st_pop(x87);
+            return;
+        case 6 * 8 + 2:     // FPTAN：ST(0) = tan，再压入 1.0
+            if (trig_in_range(x87, x)) {
+                st_set(x87, 0, value_from_double(x87, tan(x)));
+                st_push(x87, value_from_f80(x87, f80_constants[0]));
+            }
+            return;
+        case 6 * 8 + 3:     // FPATAN：ST(1) = atan2(ST(1), ST(0))，出栈
+            st_set(x87, 1, value_from_double(x87, atan2(value_to_double(x87, st_get(x87, 1)), x)));
+            st_pop(x87);
+            return;
+        case 7 * 8 + 3:     // FSINCOS：ST(0) = sin，再压入 cos
+            if (trig_in_range(x87, x)) {
+                st_set(x87, 0, value_from_double(x87, sin(x)));
+                st_push(x87, value_from_double(x87, cos(x)));
+            }
+            return;
+        case 7 * 8 + 6:     // FSIN
+            if (trig_in_range(x87, x)) {
+                st_set(x87, 0, value_from_double(x87, sin(x)));
+            }
+            return;
+        case 7 * 8 + 7:     // FCOS
+            if (trig_in_range(x87, x)) {
+                st_set(x87, 0, value_from_double(x87, cos(x)));
+            }
+            return;
+        case 6 * 8 + 5:     // FPREM1（IEEE 余数）
+        case 7 * 8 + 0: {   // FPREM（截断余数）；一次完成归约，C2 恒为0，商的低3位放入 C0/C3/C1
+            const double y = value_to_double(x87, st_get(x87, 1));
+            const double remainder_value = (r == 7) ? fmod(x, y) : remainder(x, y);
+            uint16_t code = 0;
+            if (remainder_value == remainder_value && y != 0.0 && isfinite(x)) {
+                const double quotient = fabs(nearbyint((x - remainder_value) / y));
+                const unsigned bits = (unsigned)fmod(quotient, 8.0);
+                code = (uint16_t)(((bits & 4) ? BOX64_X87_SW_C0 : 0) | ((bits & 2) ? BOX64_X87_SW_C3 : 0) |
+                                  ((bits & 1) ? BOX64_X87_SW_C1 : 0));
+            } else {
+                x87->status |= BOX64_X87_SW_IE;
+            }
+            set_condition(x87, code);
+            st_set(x87, 0, value_from_double(x87, remainder_value));
+            return;
+        }
+        default:
+            return;
+    }
+}
+
+static void execute_register(Box64Context *ctx, const X86DecodedInsn *insn) {
+    Box64X87 *x87 = &ctx->x87;
+    const unsigned row = insn->opcode - 0xD8, r = (insn->modrm >> 3) & 7, i = insn->modrm & 7;
+
+    switch (row) {
+        case 0:     // D8：ST(0) = ST(0) op ST(i)
+        case 4:     // DC：ST(i) = ST(i) op ST(0)
+        case 6: {   // DE：同 DC 后出栈
+            if (r == 2 || r == 3 || (row == 6 && r == 3)) {     // FCOM / FCOMP / FCOMPP
+                const bool valid = st_valid(x87, 0) && st_valid(x87, i);
+                if (valid) {
+                    compare_to_status(x87, st_get(x87, 0), st_get(x87, i), false);
+                } else {
+                    stack_underflow(x87);
+                    set_condition(x87, SW_COND_MASK);
+                }
+                if (r == 3 || row == 6) {
+                    st_pop(x87);
+                }
+                if (row == 6 && r == 3) {
+                    st_pop(x87);
+                }
+                return;
+            }
+            const unsigned dst = row == 0 ? 0 : i;
+            // DC/DE 以 ST(i) 为目的，SUB/SUBR、DIV/DIVR 的 /r 编号与 D8 相反
+            const unsigned op = (row == 0 || r < 4) ? r : (r ^ 1);
+            if (!st_valid(x87, 0) || !st_valid(x87, i)) {
+                stack_underflow(x87);
+                st_set(x87, dst, value_indefinite(x87));
+            } else {
+                st_set(x87, dst, value_arith(x87, op, st_get(x87, dst), st_get(x87, dst == 0 ? i : 0)));
+            }
+            if (row == 6) {
+                st_pop(x87);
+            }
+            return;
+        }
+        case 1:     // D9
+            switch (r) {
+                case 0:     // FLD ST(i)
+                    st_push(x87, st_read(x87, i));
+                    return;
+                case 1: {   // FXCH
+                    const X87Value a = st_read(x87, 0), b = st_read(x87, i);
+                    st_set(x87, 0, b);
+                    st_set(x87, i, a);
+                    // 快速模式与JIT一致，不维护 C1
+                    if (x87->extended) {
+                        x87->status &= ~BOX64_X87_SW_C1;
+                    }
+                    return;
+                }
+                case 2:     // FNOP
+                    return;
+                case 3:     // FSTP1（别名）
+                    st_set(x87, i, st_read(x87, 0));
+                    st_pop(x87);
+                    return;
+                default:
+                    execute_d9_special(ctx, r, i);
+                    return;
+            }
+        case 2:     // DA：FCMOVB/E/BE/U，FUCOMPP
+        case 3:     // DB：FCMOVNB/NE/NBE/NU，FNCLEX/FNINIT，FUCOMI/FCOMI
+            if (r < 4) {
+                static const uint8_t conditions[4] = { 0x2, 0x4, 0x6, 0xA };     // B / E / BE / P
+                const uint8_t cc = (uint8_t)(conditions[r] | (row == 3));
+                if (!st_valid(x87, 0) || !st_valid(x87, i)) {
+                    stack_underflow(x87);
+                    st_set(x87, 0, value_indefinite(x87));
+                } else if (box64_flags_condition(ctx, cc)) {
+                    st_set(x87, 0, st_get(x87, i));
+                }
+                return;
+            }
+            if (row == 2) {     // FUCOMPP
+                if (st_valid(x87, 0) && st_valid(x87, 1)) {
+                    compare_to_status(x87, st_get(x87, 0), st_get(x87, 1), true);
+                } else {
+                    stack_underflow(x87);
+                    set_condition(x87, SW_COND_MASK);
+                }
+                st_pop(x87);
+                st_pop(x87);
+                return;
+            }
+            if (r == 4) {
+                if (i == 2) {           // FNCLEX
+                    x87->status &= (uint16_t)~0x80FF;
+                } else if (i == 3) {    // FNINIT
+                    box64_x87_reset(ctx);
+                }
+                return;                 // FENI/FDISI/FSETPM 在新处理器上是空操作
+            }
+            // FUCOMI / FCOMI
+            if (st_valid(x87, 0) && st_valid(x87, i)) {
+                compare_to_rflags(ctx, st_get(x87, 0), st_get(x87, i), r == 5);
+            } else {
+                stack_underflow(x87);
+                box64_flags_set(ctx, (ctx->rflags & ~(uint64_t)X86_FLAGS_ARITH) | X86_FLAG_ZF | X86_FLAG_PF | X86_FLAG_CF);
+            }
+            return;
+        case 5:     // DD
+            switch (r) {
+                case 0:     // FFREE
+                    x87->valid &= ~(1u << ST_INDEX(x87, i));
+                    return;
+                case 1: {   // FXCH4（别名）
+                    const X87Value a = st_read(x87, 0), b = st_read(x87, i);
+                    st_set(x87, 0, b);
+                    st_set(x87, i, a);
+                    return;
+                }
+                case 2:     // FST ST(i)
+                case 3:     // FSTP ST(i)
+                    st_set(x87, i, st_read(x87, 0));
+                    if (r == 3) {
+                        st_pop(x87);
+                    }
+                    return;
+                default:    // FUCOM / FUCOMP
+                    if (st_valid(x87, 0) && st_valid(x87, i)) {
+                        compare_to_status(x87, st_get(x87, 0), st_get(x87, i), true);
+                    } else {
+                        stack_underflow(x87);
+                        set_condition(x87, SW_COND_MASK);
+                    }
+                    if (r == 5) {
+                        st_pop(x87);
+                    }
+                    return;
+            }
+        default:    // DF
+            switch (r) {
+                case 0:     // FFREEP
+                    x87->valid &= ~(1u << ST_INDEX(x87, i));
+                    st_pop(x87);
+                    return;
+                case 1: {   // FXCH7（别名）
+                    const X87Value a = st_read(x87, 0), b = st_read(x87, i);
+                    st_set(x87, 0, b);
+                    st_set(x87, i, a);
+                    return;
+                }
+                case 2:
+                case 3:     // FSTP8/FSTP9（别名）
+                    st_set(x87, i, st_read(x87, 0));
+                    st_pop(x87);
+                    return;
+                case 4:     // FNSTSW AX
+                    box64_write_gpr(ctx, 0, box64_x87_status_word(ctx), 2, false);
+                    return;
+                default:    // FUCOMIP / FCOMIP
+                    if (st_valid(x87, 0) && st_valid(x87, i)) {
+                        compare_to_rflags(ctx, st_get(x87, 0), st_get(x87, i), r == 5);
+                    } else {
+                        stack_underflow(x87);
+                        box64_flags_set(ctx, (ctx->rflags & ~(uint64_t)X86_FLAGS_ARITH) | X86_FLAG_ZF | X86_FLAG_PF | X86_FLAG_CF);
+                    }
+                    st_pop(x87);
+                    return;
+            }
+    }
+}
+
+Box64X87Status box64_x87_execute(Box64Context *ctx, const X86DecodedInsn *insn,
+                                 uint64_t next_address, uint64_t *fault_address) {
+    if (!box64_x87_supported(insn)) {
+        return BOX64_X87_UNSUPPORTED;
+    }
+    if (insn->opcode == 0x9B) {
+        return BOX64_X87_OK;    // FWAIT：未屏蔽异常不投递
+    }
+    if (x86_insn_is_memory(insn)) {
+        return execute_memory(ctx, insn, box64_effective_address(ctx, insn, next_address), fault_address);
+    }
+    execute_register(ctx, insn);
+    return BOX64_X87_OK;
+}
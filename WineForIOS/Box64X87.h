@@ -0,0 +1,79 @@
+// Box64X87.h - x87 FPU 的寄存器栈与指令执行
+// 纯C实现，解释器和 Box64Engine 的逐条执行路径共用：
+//   状态：8个物理寄存器 + TOP、非空位（标记字）、控制字、状态字，都在 Box64Context.x87 中
+//   快速模式（默认）：ST(i) 用宿主 double 表示，算术直接用宿主浮点运算；精度控制字段被忽略，
+//         m80 的读写在 double 与80位格式之间转换
+//   扩展精度模式：ST(i) 是80位值，算术由软件浮点完成（64位尾数、按控制字的舍入与精度控制），
+//         给依赖扩展精度的程序使用；超越函数（FSIN/FPATAN/FYL2X 等）两种模式都经 double 计算
+//   栈溢出/下溢按异常被屏蔽时的硬件行为：置 IE|SF（C1 区分上溢/下溢），结果为不定值 QNaN；
+//         状态字的异常位会累积，但不模拟未屏蔽异常的投递
+// FLDENV/FNSTENV/FRSTOR/FNSAVE 与 BCD（FBLD/FBSTP）不支持，box64_x87_supported 返回false
+#ifndef BOX64_X87_H
+#define BOX64_X87_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "Box64Context.h"
+#include "X86Decoder.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 控制字：复位值屏蔽全部异常、64位精度、就近舍入
+#define BOX64_X87_CONTROL_DEFAULT   0x037F
+#define BOX64_X87_RC_SHIFT          10
+#define BOX64_X87_PC_SHIFT          8
+
+// 状态字位
+#define BOX64_X87_SW_IE     0x0001      // 无效操作
+#define BOX64_X87_SW_DE     0x0002      // 非规格化操作数
+#define BOX64_X87_SW_ZE     0x0004      // 除以零
+#define BOX64_X87_SW_OE     0x0008      // 上溢
+#define BOX64_X87_SW_UE     0x0010      // 下溢
+#define BOX64_X87_SW_PE     0x0020      // 不精确
+#define BOX64_X87_SW_SF     0x0040      // 栈错误
+#define BOX64_X87_SW_C0     0x0100
+#define BOX64_X87_SW_C1     0x0200
+#define BOX64_X87_SW_C2     0x0400
+#define BOX64_X87_SW_TOP    0x3800
+#define BOX64_X87_SW_C3     0x4000
+
+typedef enum Box64X87Status {
+    BOX64_X87_OK = 0,
+    BOX64_X87_UNSUPPORTED,      // 不是已建模的x87指令
+    BOX64_X87_FAULT             // 访存缺页，*fault_address 为出错地址，未修改任何状态
+} Box64X87Status;
+
+// D8-DF 或 FWAIT（9B）且属于已建模的形式
+bool box64_x87_supported(const X86DecodedInsn *insn);
+
+// 内存操作数的访问宽度（字节），寄存器形式返回0
+uint8_t box64_x87_memory_size(const X86DecodedInsn *insn);
+
+// 执行一条x87指令；next_address 用于 RIP 相对寻址
+Box64X87Status box64_x87_execute(Box64Context *ctx, const X86DecodedInsn *insn,
+                                 uint64_t next_address, uint64_t *fault_address);
+
+// FNINIT：清空寄存器栈，控制字/状态字复位；不改变当前的精度模式
+void box64_x87_reset(Box64Context *ctx);
+
+// 切换快速/扩展精度模式，已有的寄存器值随之转换（80位 → double 按就近舍入）
+void box64_x87_set_extended(Box64Context *ctx, bool extended);
+
+// 含 TOP 的状态字（FNSTSW 的结果）与完整的2位标记字
+uint16_t box64_x87_status_word(const Box64Context *ctx);
+uint16_t box64_x87_tag_word(const Box64Context *ctx);
+
+// ST(i) 的值（调试与测试用），空寄存器返回NaN
+double box64_x87_read_st(const Box64Context *ctx, unsigned index);
+
+// 80位值与 double 的转换（就近舍入）
+Box64F80 box64_f80_from_double(double value);
+double box64_f80_to_double(Box64F80 value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BOX64_X87_H
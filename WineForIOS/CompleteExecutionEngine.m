@@ -36,11 +36,13 @@
 @property (nonatomic, assign) uint64_t peImageBase;
 @property (nonatomic, assign) uint32_t peEntryPointRVA;
 @property (nonatomic, assign) uint64_t peActualEntryPoint;
-@property (nonatomic, strong) NSData *peCodeSection;
-@property (nonatomic, assign) uint64_t peCodeSectionVA;
+@property (nonatomic, assign) uint64_t peCodeStart;      // 入口点所在节的客户机地址区间
+@property (nonatomic, assign) uint64_t peCodeSize;
 @end
 
-@implementation CompleteExecutionEngine
+@implementation CompleteExecutionEngine {
+    Box64PEImage _peImage;      // 最近一次解析/加载的镜像（节表、数据目录、实际基址）
+}
 
 + (instancetype)sharedEngine {
     static CompleteExecutionEngine *sharedInstance = nil;
@@ -63,8 +65,8 @@
         _peImageBase = 0;
         _peEntryPointRVA = 0;
         _peActualEntryPoint = 0;
-        _peCodeSection = nil;
-        _peCodeSectionVA = 0;
+        _peCodeStart = 0;
+        _peCodeSize = 0;
     }
     return self;
 }
@@ -86,16 +88,8 @@
         
         NSLog(@"[CompleteExecutionEngine] Initializing execution engines...");
         
-        // 初始化JIT引擎
-        _jitEngine = [[IOSJITEngine alloc] init];
-        if (![_jitEngine initializeJIT]) {
-            NSLog(@"[CompleteExecutionEngine] ❌ Failed to initialize JIT engine");
-            return NO;
-        }
-        
         // 初始化Box64引擎
         _box64Engine = [[Box64Engine alloc] init];
-        _box64Engine.jitEngine = _jitEngine;
         
         // 🔧 修复：使用合理的内存大小初始化Box64引擎
         size_t memorySize = 64 * 1024 * 1024; // 64MB
@@ -104,12 +98,16 @@
             return NO;
         }
         
+        // JIT引擎就是Box64引擎自己的代码缓存（已由上面的初始化完成），不另建一个
+        _jitEngine = _box64Engine.jitEngine;
+        
         // 初始化Wine API
         _wineAPI = [[WineAPI alloc] init];
         if (![_wineAPI initializeWineAPI]) {
             NSLog(@"[CompleteExecutionEngine] ❌ Failed to initialize Wine API");
             return NO;
         }
+        [_wineAPI registerThunksWithRegistry:_box64Engine.thunkRegistry];
         
         // 执行初始化安全检查
         if (![self performInitializationSafetyCheck]) {
@@ -218,8 +216,9 @@
         
         // Phase 3: 读取和验证PE文件
         [self notifyProgress:0.3 status:@"读取PE文件..."];
-        NSData *peFileData = [NSData dataWithContentsOfFile:programPath];
-        if (!peFileData || peFileData.length < 1024) {
+        // 只读映射即可：分析阶段只访问头部和节表，不把整个文件读进内存
+        NSData *peFileData = [NSData dataWithContentsOfFile:programPath options:NSDataReadingMappedIfSafe error:nil];
+        if (peFileData.length == 0) {
             NSLog(@"[CompleteExecutionEngine] ❌ Invalid PE file data");
             [self finishExecution:ExecutionResultInvalidFile];
             return ExecutionResultInvalidFile;
@@ -236,7 +235,7 @@
         
         // Phase 5: 映射PE文件到内存
         [self notifyProgress:0.7 status:@"映射PE到内存..."];
-        if (![self mapPEToMemory:peFileData]) {
+        if (![self mapPEToMemory:programPath]) {
             NSLog(@"[CompleteExecutionEngine] ❌ Failed to map PE to memory");
             [_executionLog addObject:@"❌ PE内存映射失败"];
             [self finishExecution:ExecutionResultMemoryError];
@@ -305,94 +304,82 @@
 - (ExecutionResult)analyzePEFile:(NSData *)fileData {
     NSLog(@"[CompleteExecutionEngine] 🔧 PE文件分析开始...");
     
-    const uint8_t *bytes = fileData.bytes;
-    if (fileData.length < 1024) {
-        NSLog(@"[CompleteExecutionEngine] ❌ PE文件太小: %lu字节", (unsigned long)fileData.length);
-        return ExecutionResultInvalidFile;
-    }
-    
-    // 检查DOS头
-    if (bytes[0] != 'M' || bytes[1] != 'Z') {
-        NSLog(@"[CompleteExecutionEngine] ❌ 无效的DOS头");
+    // 头部、节表的边界检查都在 box64_pe_parse 中完成
+    Box64PEStatus status = box64_pe_parse(fileData.bytes, fileData.length, &_peImage);
+    if (status != BOX64_PE_OK) {
+        NSLog(@"[CompleteExecutionEngine] ❌ 无效的PE文件: %s", box64_pe_status_string(status));
+        [_executionLog addObject:[NSString stringWithFormat:@"❌ PE解析失败: %s", box64_pe_status_string(status)]];
         return ExecutionResultInvalidFile;
     }
     
-    // 获取PE头偏移
-    uint32_t peOffset = *(uint32_t *)(bytes + 0x3C);
-    if (peOffset >= fileData.length - 4) {
-        NSLog(@"[CompleteExecutionEngine] ❌ 无效的PE头偏移: 0x%X", peOffset);
+    // 执行引擎只实现了64位模式
+    if (_peImage.machine != BOX64_PE_MACHINE_AMD64 || !_peImage.pe32_plus) {
+        NSLog(@"[CompleteExecutionEngine] ❌ 不支持的架构: machine=0x%04X (仅支持x64 PE32+)", _peImage.machine);
+        [_executionLog addObject:@"❌ 仅支持x64 (PE32+) 程序"];
         return ExecutionResultInvalidFile;
     }
     
-    // 检查PE签名
-    if (*(uint32_t *)(bytes + peOffset) != 0x00004550) {
-        NSLog(@"[CompleteExecutionEngine] ❌ 无效的PE签名");
-        return ExecutionResultInvalidFile;
-    }
+    NSString *architecture = @"x64 (64-bit)";
     
-    // 获取架构信息
-    uint16_t machine = *(uint16_t *)(bytes + peOffset + 4);
-    NSString *architecture = (machine == 0x8664) ? @"x64 (64-bit)" : @"x86 (32-bit)";
-    
-    // 获取镜像基址和入口点
-    _peImageBase = *(uint64_t *)(bytes + peOffset + 24 + 24);
-    _peEntryPointRVA = *(uint32_t *)(bytes + peOffset + 24 + 16);
+    // 入口点在映射后才能确定（可能被重定位），这里先按首选基址计算
+    _peImageBase = _peImage.preferred_base;
+    _peEntryPointRVA = _peImage.entry_rva;
     _peActualEntryPoint = _peImageBase + _peEntryPointRVA;
     
     NSLog(@"[CompleteExecutionEngine] 🔧 PE分析完成:");
     NSLog(@"[CompleteExecutionEngine]   架构: %@", architecture);
-    NSLog(@"[CompleteExecutionEngine]   镜像基址: 0x%llX", _peImageBase);
+    NSLog(@"[CompleteExecutionEngine]   镜像基址: 0x%llX (大小 0x%X)", _peImageBase, _peImage.size_of_image);
     NSLog(@"[CompleteExecutionEngine]   入口点RVA: 0x%X", _peEntryPointRVA);
     NSLog(@"[CompleteExecutionEngine]   实际入口点: 0x%llX", _peActualEntryPoint);
+    for (uint16_t i = 0; i < _peImage.section_count; i++) {
+        const Box64PESection *section = &_peImage.sections[i];
+        NSLog(@"[CompleteExecutionEngine]   节 %-8s RVA=0x%X 虚拟大小=0x%X 文件=0x%X+0x%X %c%c%c", section->name,
+              section->virtual_address, section->virtual_size, section->raw_offset, section->raw_size,
+              (section->prot & BOX64_PROT_READ) ? 'R' : '-', (section->prot & BOX64_PROT_WRITE) ? 'W' : '-',
+              (section->prot & BOX64_PROT_EXEC) ? 'X' : '-');
+    }
     
     [self notifyOutputSync:[NSString stringWithFormat:@"PE文件分析完成: %@", architecture]];
-    [_executionLog addObject:[NSString stringWithFormat:@"✅ PE分析: %@ 入口点=0x%llX", architecture, _peActualEntryPoint]];
+    [_executionLog addObject:[NSString stringWithFormat:@"✅ PE分析: %@ %u个节 入口点=0x%llX", architecture,
+                              _peImage.section_count, _peActualEntryPoint]];
     
     return ExecutionResultSuccess;
 }
 
-- (BOOL)mapPEToMemory:(NSData *)fileData {
+// 全部节映射到 ImageBase + VirtualAddress（或重定位后的基址），页权限按节属性设置
+// 文件以写时复制方式映射，页对齐的节直接使用文件页，不复制
+- (BOOL)mapPEToMemory:(NSString *)programPath {
     NSLog(@"[CompleteExecutionEngine] 🔧 映射PE到内存...");
     
-    // 找到代码段（通常在文件偏移0x400）
-    const uint8_t *bytes = fileData.bytes;
-    
-    size_t codeOffset = 0x400;
-    if (fileData.length <= codeOffset) {
-        NSLog(@"[CompleteExecutionEngine] ❌ PE文件太小，无法包含代码段");
+    if (![_box64Engine loadPEImageAtPath:programPath image:&_peImage]) {
+        NSLog(@"[CompleteExecutionEngine] ❌ PE镜像加载失败: %@", [_box64Engine getLastError]);
         return NO;
     }
     
-    // 提取代码段数据
-    size_t codeSize = MIN(0x200, fileData.length - codeOffset);  // 最多512字节
-    _peCodeSection = [fileData subdataWithRange:NSMakeRange(codeOffset, codeSize)];
-    
-    // 🔧 修复：使用Box64Engine内存管理器分配内存
-    uint8_t *codeMemory = [_box64Engine allocateMemory:codeSize];
-    if (!codeMemory) {
-        NSLog(@"[CompleteExecutionEngine] ❌ 无法分配代码段内存");
+    const Box64PESection *codeSection = box64_pe_section_for_rva(&_peImage, _peImage.entry_rva);
+    if (_peImage.entry_point == 0 || !codeSection || !(codeSection->prot & BOX64_PROT_EXEC)) {
+        NSLog(@"[CompleteExecutionEngine] ❌ 入口点RVA 0x%X 不在可执行节内", _peImage.entry_rva);
+        [_box64Engine unloadPEImage];
         return NO;
     }
     
-    // 复制代码到分配的内存
-    memcpy(codeMemory, _peCodeSection.bytes, codeSize);
-    _peCodeSectionVA = (uint64_t)codeMemory;
+    _peImageBase = _peImage.base;
+    _peActualEntryPoint = _peImage.entry_point;
+    _peCodeStart = _peImage.base + codeSection->virtual_address;
+    // 只取有文件内容的部分：直接映射的节在这个范围内宿主地址连续
+    _peCodeSize = box64_pe_section_data_size(codeSection);
     
-    NSLog(@"[CompleteExecutionEngine] 🔧 代码段信息:");
-    NSLog(@"[CompleteExecutionEngine]   文件偏移: 0x%zX", codeOffset);
-    NSLog(@"[CompleteExecutionEngine]   虚拟地址: 0x%llX", _peCodeSectionVA);
-    NSLog(@"[CompleteExecutionEngine]   代码大小: %zu字节", codeSize);
-    
-    // 显示前几个字节用于调试
-    if (codeSize >= 8) {
-        const uint8_t *codeBytes = _peCodeSection.bytes;
-        NSLog(@"[CompleteExecutionEngine]   前8字节: %02X %02X %02X %02X %02X %02X %02X %02X",
-              codeBytes[0], codeBytes[1], codeBytes[2], codeBytes[3],
-              codeBytes[4], codeBytes[5], codeBytes[6], codeBytes[7]);
-    }
+    NSLog(@"[CompleteExecutionEngine] 🔧 镜像信息:");
+    NSLog(@"[CompleteExecutionEngine]   文件页直接映射: %u页", _peImage.file_backed_pages);
+    NSLog(@"[CompleteExecutionEngine]   加载基址: 0x%llX%@", _peImageBase,
+          _peImage.relocated ? [NSString stringWithFormat:@" (首选 0x%llX 被占用，已应用 %u 处重定位)",
+                                _peImage.preferred_base, _peImage.relocations_applied] : @"");
+    NSLog(@"[CompleteExecutionEngine]   代码节: %s 0x%llX (%llu字节)", codeSection->name, _peCodeStart, _peCodeSize);
+    NSLog(@"[CompleteExecutionEngine]   入口点: 0x%llX", _peActualEntryPoint);
     
-    NSLog(@"[CompleteExecutionEngine] ✅ PE代码段已映射到内存 0x%llX", _peCodeSectionVA);
-    [_executionLog addObject:[NSString stringWithFormat:@"✅ PE内存映射: 0x%llX (%zu字节)", _peCodeSectionVA, codeSize]];
+    NSLog(@"[CompleteExecutionEngine] ✅ PE镜像已映射到内存 0x%llX-0x%llX", _peImageBase, _peImageBase + _peImage.size_of_image);
+    [_executionLog addObject:[NSString stringWithFormat:@"✅ PE内存映射: 0x%llX (%u个节, 0x%X字节)", _peImageBase,
+                              _peImage.section_count, _peImage.size_of_image]];
     
     return YES;
 }
@@ -400,17 +387,16 @@
 - (BOOL)setupExecutionEntryPoint {
     NSLog(@"[CompleteExecutionEngine] 🔧 设置执行入口点...");
     
-    if (_peCodeSectionVA == 0) {
-        NSLog(@"[CompleteExecutionEngine] ❌ 无效的代码段虚拟地址");
+    if (_peActualEntryPoint == 0) {
+        NSLog(@"[CompleteExecutionEngine] ❌ 无效的入口点地址");
         return NO;
     }
     
-    // 🔧 修复：使用代码段的实际内存地址作为入口点
-    uint64_t entryPoint = _peCodeSectionVA;
+    uint64_t entryPoint = _peActualEntryPoint;
     
-    NSLog(@"[CompleteExecutionEngine] 🔧 设置RIP到代码段开始地址: 0x%llX", entryPoint);
+    NSLog(@"[CompleteExecutionEngine] 🔧 设置RIP到入口点: 0x%llX", entryPoint);
     
-    // 设置RIP寄存器到代码段开始位置
+    // 设置RIP寄存器到 ImageBase + AddressOfEntryPoint
     if (![_box64Engine setX86Register:X86_RIP value:entryPoint]) {
         NSLog(@"[CompleteExecutionEngine] ❌ 设置RIP寄存器失败");
         return NO;
@@ -434,7 +420,7 @@
     }
     
     NSLog(@"[CompleteExecutionEngine] ✅ 入口点设置完成:");
-    NSLog(@"[CompleteExecutionEngine]   RIP: 0x%llX (代码段开始)", entryPoint);
+    NSLog(@"[CompleteExecutionEngine]   RIP: 0x%llX (入口点)", entryPoint);
     NSLog(@"[CompleteExecutionEngine]   RSP: 0x%llX (栈基址: 0x%llX, 大小: %llu)",
           safeStackPointer, stackBase, stackSize);
     
@@ -446,22 +432,21 @@
 - (BOOL)executeAtEntryPoint {
     NSLog(@"[CompleteExecutionEngine] 🔧 在入口点执行代码...");
     
-    if (!_peCodeSection || _peCodeSection.length == 0) {
+    if (_peCodeSize == 0) {
         NSLog(@"[CompleteExecutionEngine] ❌ 没有代码段可执行");
         return NO;
     }
     
-    // 🔧 修复：传递正确的基地址给Box64引擎
     NSLog(@"[CompleteExecutionEngine] 📍 执行参数:");
-    NSLog(@"[CompleteExecutionEngine]   代码段地址: 0x%llX", _peCodeSectionVA);
-    NSLog(@"[CompleteExecutionEngine]   代码段大小: %zu字节", _peCodeSection.length);
-    NSLog(@"[CompleteExecutionEngine]   当前RIP: 0x%llX", [_box64Engine getX86Register:X86_RIP]);
+    NSLog(@"[CompleteExecutionEngine]   代码节地址: 0x%llX", _peCodeStart);
+    NSLog(@"[CompleteExecutionEngine]   代码节大小: %llu字节", _peCodeSize);
+    NSLog(@"[CompleteExecutionEngine]   入口点: 0x%llX", _peActualEntryPoint);
     
-    // 执行PE代码段 - 传递基地址用于正确的RIP计算
-    BOOL success = [_box64Engine executeWithSafetyCheck:_peCodeSection.bytes
-                                                 length:_peCodeSection.length
-                                         maxInstructions:100
-                                             baseAddress:_peCodeSectionVA];
+    // 代码直接从映射好的镜像中取，RIP从真实入口点开始
+    BOOL success = [_box64Engine executeGuestCodeAt:_peActualEntryPoint
+                                          codeStart:_peCodeStart
+                                             length:(size_t)_peCodeSize
+                                    maxInstructions:100];
     
     if (success) {
         NSDictionary *finalState = [_box64Engine getSystemState];
@@ -664,8 +649,9 @@
         _peImageBase = 0;
         _peEntryPointRVA = 0;
         _peActualEntryPoint = 0;
-        _peCodeSection = nil;
-        _peCodeSectionVA = 0;
+        _peCodeStart = 0;
+        _peCodeSize = 0;
+        memset(&_peImage, 0, sizeof(_peImage));
         
     } @finally {
         [_executionLock unlock];
@@ -689,7 +675,8 @@
     [self notifyOutputSync:[NSString stringWithFormat:@"镜像基址: 0x%llX", _peImageBase]];
     [self notifyOutputSync:[NSString stringWithFormat:@"入口点RVA: 0x%X", _peEntryPointRVA]];
     [self notifyOutputSync:[NSString stringWithFormat:@"实际入口点: 0x%llX", _peActualEntryPoint]];
-    [self notifyOutputSync:[NSString stringWithFormat:@"代码段大小: %lu字节", (unsigned long)_peCodeSection.length]];
+    [self notifyOutputSync:[NSString stringWithFormat:@"节数量: %u", _peImage.section_count]];
+    [self notifyOutputSync:[NSString stringWithFormat:@"代码节: 0x%llX (%llu字节)", _peCodeStart, _peCodeSize]];
     
     // 输出安全警告
     NSArray<NSString *> *warnings = [_box64Engine getSafetyWarnings];
@@ -0,0 +1,717 @@
+// D3DCommandStream.c - D3D命令流录制、拆分与并行编码实现
+#include "D3DCommandStream.h"
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+struct D3DStreamChunk {
+    D3DStreamChunk *next;
+    uint32_t used;
+    uint32_t capacity;
+    uint64_t data[];                        // 按8字节对齐存放包
+};
+
+// 各操作码打包结构体的大小（按8字节取整），0 表示只有原始参数
+static const uint8_t payloadSize[D3D_OP_COUNT] = {
+    [D3D_OP_CLEAR_RENDER_TARGET_VIEW]      = 24,
+    [D3D_OP_CLEAR_DEPTH_STENCIL_VIEW]      = 24,
+    [D3D_OP_IA_SET_VERTEX_BUFFERS]         = 16,
+    [D3D_OP_IA_SET_INDEX_BUFFER]           = 16,
+    [D3D_OP_IA_SET_PRIMITIVE_TOPOLOGY]     = 8,
+    [D3D_OP_RS_SET_VIEWPORTS]              = 16,
+    [D3D_OP_OM_SET_RENDER_TARGETS]         = 16,
+    [D3D_OP_PRESENT]                       = 8,
+    [D3D_OP_DRAW]                          = 8,
+    [D3D_OP_DRAW_INDEXED]                  = 16,
+    [D3D_OP_DRAW_INSTANCED]                = 16,
+    [D3D_OP_DRAW_INDEXED_INSTANCED]        = 24,
+    [D3D_OP_CREATE_BUFFER]                 = 16,
+    [D3D_OP_CREATE_TEXTURE_2D]             = 24,
+    [D3D_OP_CREATE_VERTEX_SHADER]          = 8,
+    [D3D_OP_CREATE_PIXEL_SHADER]           = 8,
+    [D3D_OP_VS_SET_SHADER]                 = 8,
+    [D3D_OP_PS_SET_SHADER]                 = 8,
+    [D3D_OP_SET_RENDER_STATE]              = 8,
+    [D3D_OP_SET_SAMPLER_STATE]             = 16,   // (slot, state) 之后是取值
+    [D3D_OP_OM_SET_BLEND_STATE]            = 8,
+    [D3D_OP_OM_SET_DEPTH_STENCIL_STATE]    = 8,
+    [D3D_OP_RS_SET_STATE]                  = 8,
+};
+
+// MARK: - 包
+
+uint32_t d3d_call_payload_size(const D3DCall *call) {
+    uint32_t size = call->opcode < D3D_OP_COUNT ? payloadSize[call->opcode] : 0;
+    const uint32_t arg_count = call->arg_count < D3D_CALL_MAX_ARGS ? call->arg_count : D3D_CALL_MAX_ARGS;
+    if (arg_count * 8 > size) {
+        size = arg_count * 8;
+    }
+    return size;
+}
+
+int32_t d3d_call_state_slot(const D3DCall *call) {
+    switch (call->opcode) {
+        case D3D_OP_IA_SET_INDEX_BUFFER:
+        case D3D_OP_IA_SET_PRIMITIVE_TOPOLOGY:
+        case D3D_OP_RS_SET_VIEWPORTS:
+        case D3D_OP_OM_SET_RENDER_TARGETS:
+        case D3D_OP_VS_SET_SHADER:
+        case D3D_OP_PS_SET_SHADER:
+        case D3D_OP_OM_SET_BLEND_STATE:
+        case D3D_OP_OM_SET_DEPTH_STENCIL_STATE:
+        case D3D_OP_RS_SET_STATE:
+            return call->opcode;
+        case D3D_OP_SET_RENDER_STATE:
+            return D3D_OP_COUNT + (int32_t)(call->args.state.state & (D3D_STREAM_RENDER_STATE_SLOTS - 1));
+        case D3D_OP_SET_SAMPLER_STATE:
+            return D3D_OP_COUNT + D3D_STREAM_RENDER_STATE_SLOTS +
+                   (int32_t)(((call->args.state.state & 15) << 4) | (call->args.state.value & 15));
+        case D3D_OP_IA_SET_VERTEX_BUFFERS:
+            return D3D_OP_COUNT + D3D_STREAM_RENDER_STATE_SLOTS + D3D_STREAM_SAMPLER_STATE_SLOTS +
+                   (int32_t)(call->args.bind.start_slot & (D3D_STREAM_VERTEX_BUFFER_SLOTS - 1));
+        default:
+            return -1;
+    }
+}
+
+bool d3d_opcode_recordable(D3DOpcode opcode) {
+    if (opcode <= D3D_OP_INVALID || opcode >= D3D_OP_COUNT) {
+        return false;
+    }
+    const D3DCategory category = d3d_opcode_category(opcode);
+    return category != D3D_CATEGORY_DEVICE && category != D3D_CATEGORY_RESOURCE;
+}
+
+void d3d_packet_decode(const D3DPacket *packet, D3DCall *call) {
+    memset(call, 0, sizeof(*call));
+    call->opcode = packet->opcode;
+    call->arg_count = packet->arg_count;
+    memcpy(&call->args, packet + 1, packet->size - sizeof(D3DPacket));
+}
+
+static int32_t packet_state_slot(const D3DPacket *packet) {
+    D3DCall call;
+    d3d_packet_decode(packet, &call);
+    return d3d_call_state_slot(&call);
+}
+
+static inline const D3DPacket *chunk_packet(const D3DStreamChunk *chunk, uint32_t offset) {
+    return (const D3DPacket *)((const uint8_t *)chunk->data + offset);
+}
+
+// MARK: - 录制器
+
+void d3d_recorder_init(D3DCommandRecorder *recorder) {
+    memset(recorder, 0, sizeof(*recorder));
+}
+
+void d3d_recorder_destroy(D3DCommandRecorder *recorder) {
+    D3DStreamChunk *chunk = recorder->first;
+    while (chunk) {
+        D3DStreamChunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    memset(recorder, 0, sizeof(*recorder));
+}
+
+void d3d_recorder_reset(D3DCommandRecorder *recorder) {
+    for (D3DStreamChunk *chunk = recorder->first; chunk; chunk = chunk->next) {
+        chunk->used = 0;
+    }
+    recorder->current = recorder->first;
+    recorder->packets = 0;
+    recorder->bytes = 0;
+}
+
+// 当前块写满：先用清空后留下的块，没有了再分配
+static D3DStreamChunk *recorder_next_chunk(D3DCommandRecorder *recorder) {
+    D3DStreamChunk *current = recorder->current;
+    if (current && current->next) {
+        recorder->current = current->next;
+        return recorder->current;
+    }
+    const uint32_t capacity = D3D_STREAM_CHUNK_SIZE - (uint32_t)sizeof(D3DStreamChunk);
+    D3DStreamChunk *chunk = malloc(sizeof(D3DStreamChunk) + capacity);
+    if (!chunk) {
+        return NULL;
+    }
+    chunk->next = NULL;
+    chunk->used = 0;
+    chunk->capacity = capacity;
+    if (current) {
+        current->next = chunk;
+    } else {
+        recorder->first = chunk;
+    }
+    recorder->current = chunk;
+    recorder->chunks++;
+    return chunk;
+}
+
+static bool recorder_append(D3DCommandRecorder *recorder, const D3DPacket *header, const void *payload) {
+    D3DStreamChunk *chunk = recorder->current;
+    if (!chunk || chunk->capacity - chunk->used < header->size) {
+        chunk = recorder_next_chunk(recorder);
+        if (!chunk) {
+            return false;
+        }
+    }
+    D3DPacket *packet = (D3DPacket *)((uint8_t *)chunk->data + chunk->used);
+    *packet = *header;
+    memcpy(packet + 1, payload, header->size - sizeof(D3DPacket));
+    chunk->used += header->size;
+    recorder->packets++;
+    recorder->bytes += header->size;
+    return true;
+}
+
+bool d3d_recorder_record(D3DCommandRecorder *recorder, const D3DCall *call) {
+    if (call->opcode == D3D_OP_INVALID || call->opcode >= D3D_OP_COUNT) {
+        return false;
+    }
+    const D3DPacket header = {
+        .opcode = call->opcode,
+        .arg_count = call->arg_count,
+        .size = (uint32_t)sizeof(D3DPacket) + d3d_call_payload_size(call),
+    };
+    return recorder_append(recorder, &header, &call->args);
+}
+
+// MARK: - 命令流
+
+void d3d_stream_init(D3DCommandStream *stream) {
+    memset(stream, 0, sizeof(*stream));
+    d3d_recorder_init(&stream->baseline[0]);
+    d3d_recorder_init(&stream->baseline[1]);
+}
+
+void d3d_stream_destroy(D3DCommandStream *stream) {
+    free(stream->packets);
+    free(stream->inherited);
+    free(stream->parts);
+    d3d_recorder_destroy(&stream->baseline[0]);
+    d3d_recorder_destroy(&stream->baseline[1]);
+    memset(stream, 0, sizeof(*stream));
+}
+
+static bool grow_array(void **array, uint32_t *capacity, uint32_t needed, size_t element) {
+    if (needed <= *capacity) {
+        return true;
+    }
+    uint32_t new_capacity = *capacity ? *capacity : 256;
+    while (new_capacity < needed) {
+        new_capacity *= 2;
+    }
+    void *grown = realloc(*array, (size_t)new_capacity * element);
+    if (!grown) {
+        return false;
+    }
+    *array = grown;
+    *capacity = new_capacity;
+    return true;
+}
+
+bool d3d_stream_build(D3DCommandStream *stream, D3DCommandRecorder *const *recorders, uint32_t count) {
+    stream->count = 0;
+    stream->inherited_count = 0;
+    stream->part_count = 0;
+    stream->pass_count = 0;
+
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        total += recorders[i]->packets;
+    }
+    if (total > UINT32_MAX ||
+        !grow_array((void **)&stream->packets, &stream->capacity, (uint32_t)total, sizeof(*stream->packets))) {
+        return false;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        for (const D3DStreamChunk *chunk = recorders[i]->first; chunk; chunk = chunk->next) {
+            for (uint32_t offset = 0; offset < chunk->used; ) {
+                const D3DPacket *packet = chunk_packet(chunk, offset);
+                stream->packets[stream->count++] = packet;
+                offset += packet->size;
+            }
+        }
+    }
+    return true;
+}
+
+// 从基线开始：上一帧结束时各状态槽的取值
+static void stream_seed_state(D3DCommandStream *stream) {
+    memset(stream->last_state, 0, sizeof(stream->last_state));
+    const D3DCommandRecorder *baseline = &stream->baseline[stream->current_baseline];
+    for (const D3DStreamChunk *chunk = baseline->first; chunk; chunk = chunk->next) {
+        for (uint32_t offset = 0; offset < chunk->used; ) {
+            const D3DPacket *packet = chunk_packet(chunk, offset);
+            const int32_t slot = packet_state_slot(packet);
+            if (slot >= 0) {
+                stream->last_state[slot] = packet;
+            }
+            offset += packet->size;
+        }
+    }
+}
+
+// 开始一个新部分，记下此刻生效的全部状态
+static bool stream_open_part(D3DCommandStream *stream, uint32_t first, uint32_t pass) {
+    if (!grow_array((void **)&stream->parts, &stream->part_capacity, stream->part_count + 1,
+                    sizeof(*stream->parts)) ||
+        !grow_array((void **)&stream->inherited, &stream->inherited_capacity,
+                    stream->inherited_count + D3D_STREAM_STATE_SLOTS, sizeof(*stream->inherited))) {
+        return false;
+    }
+    D3DStreamPart *part = &stream->parts[stream->part_count++];
+    part->first = first;
+    part->end = first;
+    part->inherited_first = stream->inherited_count;
+    part->pass = pass;
+    for (uint32_t slot = 0; slot < D3D_STREAM_STATE_SLOTS; slot++) {
+        if (stream->last_state[slot]) {
+            stream->inherited[stream->inherited_count++] = stream->last_state[slot];
+        }
+    }
+    part->inherited_count = stream->inherited_count - part->inherited_first;
+    return true;
+}
+
+// 通道从 first 开始到下一个 OMSetRenderTargets（不含）为止
+static uint32_t stream_pass_end(const D3DCommandStream *stream, uint32_t first) {
+    uint32_t end = first + 1;
+    while (end < stream->count && stream->packets[end]->opcode != D3D_OP_OM_SET_RENDER_TARGETS) {
+        end++;
+    }
+    return end;
+}
+
+uint32_t d3d_stream_split(D3DCommandStream *stream, uint32_t max_parts, uint32_t min_packets) {
+    stream->inherited_count = 0;
+    stream->part_count = 0;
+    stream->pass_count = 0;
+    if (stream->count == 0) {
+        return 0;
+    }
+    if (max_parts == 0) {
+        max_parts = 1;
+    }
+
+    // 通道按顺序逐个编码，每个通道各自切成 max_parts 份
+    stream_seed_state(stream);
+    uint32_t pass = 0;
+    uint32_t pass_end = 0;
+    uint32_t target = 0;
+    bool after_action = false;
+    for (uint32_t i = 0; i < stream->count; i++) {
+        const D3DPacket *packet = stream->packets[i];
+        bool cut = false;
+        if (i == pass_end) {
+            pass = stream->part_count ? pass + 1 : 0;
+            pass_end = stream_pass_end(stream, i);
+            target = (pass_end - i + max_parts - 1) / max_parts;
+            if (target < min_packets) {
+                target = min_packets;
+            }
+            cut = true;
+        } else {
+            // 只在动作之后切，紧跟在后面的状态设置和它们服务的绘制留在同一部分
+            cut = after_action && i - stream->parts[stream->part_count - 1].first >= target;
+        }
+        if (cut) {
+            if (stream->part_count) {
+                stream->parts[stream->part_count - 1].end = i;
+            }
+            if (!stream_open_part(stream, i, pass)) {
+                stream->part_count = 0;
+                return 0;
+            }
+        }
+        const int32_t slot = packet_state_slot(packet);
+        if (slot >= 0) {
+            stream->last_state[slot] = packet;
+        }
+        after_action = slot < 0;
+    }
+    stream->parts[stream->part_count - 1].end = stream->count;
+    stream->pass_count = pass + 1;
+    return stream->part_count;
+}
+
+bool d3d_stream_end_frame(D3DCommandStream *stream) {
+    stream_seed_state(stream);
+    for (uint32_t i = 0; i < stream->count; i++) {
+        const int32_t slot = packet_state_slot(stream->packets[i]);
+        if (slot >= 0) {
+            stream->last_state[slot] = stream->packets[i];
+        }
+    }
+    // 写进另一份基线：本帧第一个部分继承的状态还指向当前这份
+    D3DCommandRecorder *next = &stream->baseline[stream->current_baseline ^ 1];
+    d3d_recorder_reset(next);
+    for (uint32_t slot = 0; slot < D3D_STREAM_STATE_SLOTS; slot++) {
+        const D3DPacket *packet = stream->last_state[slot];
+        if (packet && !recorder_append(next, packet, packet + 1)) {
+            return false;
+        }
+    }
+    stream->current_baseline ^= 1;
+    stream->count = 0;
+    stream->inherited_count = 0;
+    stream->part_count = 0;
+    stream->pass_count = 0;
+    return true;
+}
+
+// MARK: - 编码线程池
+
+struct D3DEncodePool {
+    pthread_t *threads;
+    uint32_t workers;
+    pthread_mutex_t mutex;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    uint64_t generation;                    // 每发布一个任务加一
+    uint32_t active;                        // 还在编码当前任务的工作线程数
+    bool shutdown;
+
+    // 当前任务：stream->parts[first_part, end_part)，contexts 按 index - first_part 存放
+    const D3DCommandStream *stream;
+    const D3DStreamBackend *backend;
+    void **contexts;
+    uint32_t context_capacity;
+    uint32_t first_part;
+    uint32_t end_part;
+    _Atomic uint32_t next_part;
+    _Atomic uint64_t encoded;
+    _Atomic uint64_t failed;
+};
+
+static void encode_part(const D3DCommandStream *stream, const D3DStreamBackend *backend, const D3DStreamPart *part,
+                        void *context, uint64_t *encoded, uint64_t *failed) {
+    if (!context) {
+        *failed += part->inherited_count + (part->end - part->first);
+        return;
+    }
+    D3DCall call;
+    for (uint32_t i = 0; i < part->inherited_count; i++) {
+        d3d_packet_decode(stream->inherited[part->inherited_first + i], &call);
+        if (backend->encode(context, &call, true)) {
+            (*encoded)++;
+        } else {
+            (*failed)++;
+        }
+    }
+    for (uint32_t i = part->first; i < part->end; i++) {
+        d3d_packet_decode(stream->packets[i], &call);
+        if (backend->encode(context, &call, false)) {
+            (*encoded)++;
+        } else {
+            (*failed)++;
+        }
+    }
+    if (backend->end_part) {
+        backend->end_part(context);
+    }
+}
+
+// 工作线程和调用线程都从同一个计数器领取部分，先做完的多领
+static void pool_run_parts(D3DEncodePool *pool) {
+    uint64_t encoded = 0;
+    uint64_t failed = 0;
+    for (;;) {
+        const uint32_t index = atomic_fetch_add_explicit(&pool->next_part, 1, memory_order_relaxed);
+        if (index >= pool->end_part) {
+            break;
+        }
+        encode_part(pool->stream, pool->backend, &pool->stream->parts[index],
+                    pool->contexts[index - pool->first_part], &encoded, &failed);
+    }
+    atomic_fetch_add_explicit(&pool->encoded, encoded, memory_order_relaxed);
+    atomic_fetch_add_explicit(&pool->failed, failed, memory_order_relaxed);
+}
+
+static void *encode_worker(void *arg) {
+    D3DEncodePool *pool = arg;
+    uint64_t seen = 0;
+    pthread_mutex_lock(&pool->mutex);
+    for (;;) {
+        while (!pool->shutdown && pool->generation == seen) {
+            pthread_cond_wait(&pool->start, &pool->mutex);
+        }
+        if (pool->shutdown) {
+            break;
+        }
+        seen = pool->generation;
+        pthread_mutex_unlock(&pool->mutex);
+
+        pool_run_parts(pool);
+
+        pthread_mutex_lock(&pool->mutex);
+        if (--pool->active == 0) {
+            pthread_cond_signal(&pool->done);
+        }
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    return NULL;
+}
+
+D3DEncodePool *d3d_encode_pool_create(uint32_t workers) {
+    D3DEncodePool *pool = calloc(1, sizeof(D3DEncodePool));
+    if (!pool) {
+        return NULL;
+    }
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    atomic_init(&pool->next_part, 0);
+    atomic_init(&pool->encoded, 0);
+    atomic_init(&pool->failed, 0);
+    if (workers) {
+        pool->threads = calloc(workers, sizeof(pthread_t));
+        if (!pool->threads) {
+            d3d_encode_pool_destroy(pool);
+            return NULL;
+        }
+        for (uint32_t i = 0; i < workers; i++) {
+            if (pthread_create(&pool->threads[i], NULL, encode_worker, pool) != 0) {
+                break;
+            }
+            pool->workers++;
+        }
+    }
+    return pool;
+}
+
+void d3d_encode_pool_destroy(D3DEncodePool *pool) {
+    if (!pool) {
+        return;
+    }
+    pthread_mutex_lock(&pool->mutex);
+    pool->shutdown = true;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->mutex);
+    for (uint32_t i = 0; i < pool->workers; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->start);
+    pthread_mutex_destroy(&pool->mutex);
+    free(pool->contexts);
+    free(pool->threads);
+    free(pool);
+}
+
+uint32_t d3d_encode_pool_workers(const D3DEncodePool *pool) {
+    return pool ? pool->workers : 0;
+}
+
+// MARK: - 编码
+
+// 子编码器按部分顺序在调用线程上创建，然后交给线程池
+static void encode_pass_parallel(const D3DCommandStream *stream, D3DEncodePool *pool, const D3DStreamBackend *backend,
+                                 uint32_t first, uint32_t end, D3DEncodeResult *result) {
+    for (uint32_t i = first; i < end; i++) {
+        pool->contexts[i - first] = backend->begin_part(backend->user, &stream->parts[i], i);
+    }
+    pthread_mutex_lock(&pool->mutex);
+    pool->stream = stream;
+    pool->backend = backend;
+    pool->first_part = first;
+    pool->end_part = end;
+    atomic_store_explicit(&pool->next_part, first, memory_order_relaxed);
+    atomic_store_explicit(&pool->encoded, 0, memory_order_relaxed);
+    atomic_store_explicit(&pool->failed, 0, memory_order_relaxed);
+    pool->active = pool->workers;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->mutex);
+
+    pool_run_parts(pool);
+
+    pthread_mutex_lock(&pool->mutex);
+    while (pool->active) {
+        pthread_cond_wait(&pool->done, &pool->mutex);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    result->encoded += atomic_load_explicit(&pool->encoded, memory_order_relaxed);
+    result->failed += atomic_load_explicit(&pool->failed, memory_order_relaxed);
+}
+
+static void encode_pass_serial(const D3DCommandStream *stream, const D3DStreamBackend *backend,
+                               uint32_t first, uint32_t end, D3DEncodeResult *result) {
+    for (uint32_t i = first; i < end; i++) {
+        void *context = backend->begin_part(backend->user, &stream->parts[i], i);
+        encode_part(stream, backend, &stream->parts[i], context, &result->encoded, &result->failed);
+    }
+}
+
+D3DEncodeResult d3d_stream_encode(const D3DCommandStream *stream, D3DEncodePool *pool, const D3DStreamBackend *backend) {
+    D3DEncodeResult result = { 0, 0, stream->part_count, 0 };
+    uint32_t first = 0;
+    while (first < stream->part_count) {
+        const uint32_t pass = stream->parts[first].pass;
+        uint32_t end = first + 1;
+        while (end < stream->part_count && stream->parts[end].pass == pass) {
+            end++;
+        }
+        if (backend->begin_pass && !backend->begin_pass(backend->user, pass)) {
+            for (uint32_t i = first; i < end; i++) {
+                result.failed += stream->parts[i].inherited_count + (stream->parts[i].end - stream->parts[i].first);
+            }
+            first = end;
+            continue;
+        }
+        if (pool && pool->workers && end - first > 1 &&
+            grow_array((void **)&pool->contexts, &pool->context_capacity, end - first, sizeof(void *))) {
+            encode_pass_parallel(stream, pool, backend, first, end, &result);
+        } else {
+            encode_pass_serial(stream, backend, first, end, &result);
+        }
+        if (backend->end_pass) {
+            backend->end_pass(backend->user, pass);
+        }
+        result.passes++;
+        first = end;
+    }
+    if (backend->submit) {
+        backend->submit(backend->user, stream->part_count);
+    }
+    return result;
+}
+
+// MARK: - 空后端
+
+#define NULL_SEQUENCE_BASE  0x100000001B3ULL
+
+struct D3DNullEncoder {
+    uint64_t state[D3D_STREAM_STATE_SLOTS]; // 各槽当前取值的散列，0 表示未设置
+    uint64_t digest;                        // 全部已设置状态的异或摘要，增量维护
+    uint64_t sequence;                      // 本部分动作的多项式散列
+    uint64_t scale;                         // NULL_SEQUENCE_BASE ^ 动作数
+    uint64_t calls;
+    uint64_t inherited_calls;
+    uint64_t draws;
+    uint64_t sink;
+    uint32_t work;
+};
+
+static inline uint64_t mix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xFF51AFD7ED558CCDULL;
+    x ^= x >> 33;
+    x *= 0xC4CEB9FE1A85EC53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+static uint64_t call_hash(const D3DCall *call) {
+    uint64_t hash = mix64(call->opcode + 1);
+    const uint32_t words = d3d_call_payload_size(call) / 8;
+    for (uint32_t i = 0; i < words; i++) {
+        hash = mix64(hash ^ call->args.raw[i]);
+    }
+    return hash | 1;
+}
+
+static void *null_begin_part(void *user, const D3DStreamPart *part, uint32_t index) {
+    (void)part;
+    D3DNullBackend *backend = user;
+    if (index >= backend->encoder_count) {
+        D3DNullEncoder **encoders = realloc(backend->encoders, (size_t)(index + 1) * sizeof(*encoders));
+        if (!encoders) {
+            return NULL;
+        }
+        for (uint32_t i = backend->encoder_count; i <= index; i++) {
+            encoders[i] = NULL;
+        }
+        backend->encoders = encoders;
+        backend->encoder_count = index + 1;
+    }
+    if (!backend->encoders[index]) {
+        backend->encoders[index] = malloc(sizeof(D3DNullEncoder));
+        if (!backend->encoders[index]) {
+            return NULL;
+        }
+    }
+    D3DNullEncoder *encoder = backend->encoders[index];
+    memset(encoder, 0, sizeof(*encoder));
+    encoder->scale = 1;
+    encoder->work = backend->work_per_call;
+    return encoder;
+}
+
+static bool null_encode(void *context, const D3DCall *call, bool inherited) {
+    D3DNullEncoder *encoder = context;
+    const uint64_t hash = call_hash(call);
+    uint64_t sink = encoder->sink;
+    for (uint32_t i = 0; i < encoder->work; i++) {
+        sink = mix64(sink + hash);
+    }
+    encoder->sink = sink;
+    encoder->calls++;
+    if (inherited) {
+        encoder->inherited_calls++;
+    }
+
+    const int32_t slot = d3d_call_state_slot(call);
+    if (slot >= 0) {
+        const uint64_t old = encoder->state[slot];
+        if (old) {
+            encoder->digest ^= mix64(old + (uint64_t)slot);
+        }
+        encoder->digest ^= mix64(hash + (uint64_t)slot);
+        encoder->state[slot] = hash;
+    } else {
+        encoder->sequence = encoder->sequence * NULL_SEQUENCE_BASE + mix64(encoder->digest ^ hash);
+        encoder->scale *= NULL_SEQUENCE_BASE;
+        if (d3d_opcode_category((D3DOpcode)call->opcode) == D3D_CATEGORY_DRAW) {
+            encoder->draws++;
+        }
+    }
+    return true;
+}
+
+// 按部分顺序拼接：seq(A+B) = seq(A) * scale(B) + seq(B)
+static void null_submit(void *user, uint32_t part_count) {
+    D3DNullBackend *backend = user;
+    backend->sequence = 0;
+    backend->scale = 1;
+    for (uint32_t i = 0; i < part_count && i < backend->encoder_count; i++) {
+        const D3DNullEncoder *encoder = backend->encoders[i];
+        if (!encoder) {
+            continue;
+        }
+        backend->sequence = backend->sequence * encoder->scale + encoder->sequence;
+        backend->scale *= encoder->scale;
+        backend->calls += encoder->calls;
+        backend->inherited_calls += encoder->inherited_calls;
+        backend->draws += encoder->draws;
+        backend->sink ^= encoder->sink;
+    }
+}
+
+void d3d_null_backend_init(D3DNullBackend *backend, uint32_t work_per_call) {
+    memset(backend, 0, sizeof(*backend));
+    backend->work_per_call = work_per_call;
+    backend->scale = 1;
+}
+
+void d3d_null_backend_destroy(D3DNullBackend *backend) {
+    for (uint32_t i = 0; i < backend->encoder_count; i++) {
+        free(backend->encoders[i]);
+    }
+    free(backend->encoders);
+    memset(backend, 0, sizeof(*backend));
+}
+
+D3DStreamBackend d3d_null_backend(D3DNullBackend *backend) {
+    return (D3DStreamBackend){
+        .begin_pass = NULL,
+        .begin_part = null_begin_part,
+        .encode = null_encode,
+        .end_part = NULL,
+        .end_pass = NULL,
+        .submit = null_submit,
+        .user = backend,
+    };
+}
@@ -0,0 +1,171 @@
+// D3DCommandStream.h - D3D调用的延迟命令流与多线程编码
+// 纯C实现，替代所有调用都在 _bridgeLock 下由一个线程翻译、编码进唯一渲染编码器的做法：
+//   录制：翻译好的 D3DCall 按操作码压缩成变长包，追加进录制线程自己的线性内存块，
+//         不加锁；帧结束后块被清空复用，稳定运行时录制不分配内存
+//   拆分：帧结束时把各录制器的包按顺序排成一条流，在绘制之后切成若干连续的部分，
+//         每个部分带上切点之前生效的状态（每个状态槽最后一次设置的包），可以独立编码；
+//         OMSetRenderTargets 开始新的渲染通道，部分不跨通道
+//   编码：各部分由编码线程池并行编码进各自的子编码器，按部分顺序创建、按顺序提交
+//   后端：编码目标由回调表决定，Metal 后端在 MoltenVKBridge 里，这里自带一个空后端，
+//         可以在Linux上不开窗口地测吞吐
+// 状态跨帧保留：帧结束时各状态槽的最后取值拷贝进流自己的基线，下一帧的第一个部分继承它
+#ifndef D3D_COMMAND_STREAM_H
+#define D3D_COMMAND_STREAM_H
+
+#include "D3DDispatch.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define D3D_STREAM_CHUNK_SIZE       (64 * 1024)
+
+// 状态槽：每个会被后续调用继承的状态一个槽，后写覆盖先写
+//   [0, D3D_OP_COUNT)                       按操作码（着色器、拓扑、视口、渲染目标、各状态对象……）
+//   D3D_OP_COUNT + 渲染状态号               SetRenderState，状态号取低8位
+//   之后256个                               SetSamplerState，(采样器号 & 15, 状态号 & 15)
+//   之后16个                                IASetVertexBuffers，按起始槽
+#define D3D_STREAM_RENDER_STATE_SLOTS   256
+#define D3D_STREAM_SAMPLER_STATE_SLOTS  256
+#define D3D_STREAM_VERTEX_BUFFER_SLOTS  16
+#define D3D_STREAM_STATE_SLOTS  (D3D_OP_COUNT + D3D_STREAM_RENDER_STATE_SLOTS + \
+                                 D3D_STREAM_SAMPLER_STATE_SLOTS + D3D_STREAM_VERTEX_BUFFER_SLOTS)
+
+// 包头之后紧跟参数，整个包按8字节对齐
+typedef struct D3DPacket {
+    uint16_t opcode;
+    uint16_t arg_count;
+    uint32_t size;                          // 含包头的字节数
+} D3DPacket;
+
+// 操作码对应的参数字节数（按打包结构体，按字符串名调用时至少覆盖 arg_count 个原始参数）
+uint32_t d3d_call_payload_size(const D3DCall *call);
+
+// 调用设置的状态槽；绘制、清除、Present 等动作和设备/资源创建返回 -1
+int32_t d3d_call_state_slot(const D3DCall *call);
+
+// 可以延迟到帧结束再编码的调用：上下文、绘制、着色器绑定和状态；设备与资源创建需要立即返回结果
+bool d3d_opcode_recordable(D3DOpcode opcode);
+
+// 把包还原成调用（未覆盖的参数清零）
+void d3d_packet_decode(const D3DPacket *packet, D3DCall *call);
+
+// MARK: - 录制器
+
+typedef struct D3DStreamChunk D3DStreamChunk;
+
+// 每个录制线程一个，录制本身不加锁；与 d3d_stream_build / d3d_recorder_reset 的互斥由调用方负责
+typedef struct D3DCommandRecorder {
+    D3DStreamChunk *first;
+    D3DStreamChunk *current;
+    uint32_t chunks;                        // 已分配的块数（清空后保留）
+    uint32_t packets;
+    uint64_t bytes;
+} D3DCommandRecorder;
+
+void d3d_recorder_init(D3DCommandRecorder *recorder);
+void d3d_recorder_destroy(D3DCommandRecorder *recorder);
+
+// 清空但保留已分配的块
+void d3d_recorder_reset(D3DCommandRecorder *recorder);
+
+// 无效操作码或内存不足返回false（调用被丢弃）
+bool d3d_recorder_record(D3DCommandRecorder *recorder, const D3DCall *call);
+
+// MARK: - 命令流
+
+typedef struct D3DStreamPart {
+    uint32_t first;                         // packets 中的范围 [first, end)
+    uint32_t end;
+    uint32_t inherited_first;               // inherited 中继承状态的范围
+    uint32_t inherited_count;
+    uint32_t pass;                          // 渲染通道序号，从0开始
+} D3DStreamPart;
+
+typedef struct D3DCommandStream {
+    const D3DPacket **packets;              // 本帧所有包，按录制器顺序
+    uint32_t count;
+    uint32_t capacity;
+    const D3DPacket **inherited;            // 各部分开头需要先设置的状态包
+    uint32_t inherited_count;
+    uint32_t inherited_capacity;
+    D3DStreamPart *parts;
+    uint32_t part_count;
+    uint32_t part_capacity;
+    uint32_t pass_count;
+    const D3DPacket *last_state[D3D_STREAM_STATE_SLOTS];
+    D3DCommandRecorder baseline[2];         // 跨帧保留的状态，上一帧的部分可能仍引用另一份
+    uint32_t current_baseline;
+} D3DCommandStream;
+
+void d3d_stream_init(D3DCommandStream *stream);
+void d3d_stream_destroy(D3DCommandStream *stream);
+
+// 按顺序收集各录制器的包，录制器在流使用期间不能再录制；内存不足返回false
+bool d3d_stream_build(D3DCommandStream *stream, D3DCommandRecorder *const *recorders, uint32_t count);
+
+// 每个渲染通道切成大约 max_parts 个部分（每部分至少 min_packets 个包），返回部分总数；
+// 可以对同一帧以不同参数重复调用。内存不足返回0
+uint32_t d3d_stream_split(D3DCommandStream *stream, uint32_t max_parts, uint32_t min_packets);
+
+// 本帧结束：把各状态槽的最终取值存为基线，供下一帧继承。之后才能重置录制器
+bool d3d_stream_end_frame(D3DCommandStream *stream);
+
+// MARK: - 编码
+
+// 回调表：begin_pass/begin_part/end_pass/submit 在调用线程上按顺序调用，encode/end_part 在编码线程上调用
+typedef struct D3DStreamBackend {
+    bool (*begin_pass)(void *user, uint32_t pass);
+    void *(*begin_part)(void *user, const D3DStreamPart *part, uint32_t index);    // 返回NULL时跳过该部分
+    bool (*encode)(void *context, const D3DCall *call, bool inherited);            // inherited: 继承来的状态
+    void (*end_part)(void *context);
+    void (*end_pass)(void *user, uint32_t pass);
+    void (*submit)(void *user, uint32_t part_count);
+    void *user;
+} D3DStreamBackend;
+
+typedef struct D3DEncodeResult {
+    uint64_t encoded;                       // encode 返回 true 的调用数（含继承的状态）
+    uint64_t failed;                        // encode 失败或所在部分被跳过的调用数
+    uint32_t parts;
+    uint32_t passes;
+} D3DEncodeResult;
+
+typedef struct D3DEncodePool D3DEncodePool;
+
+// workers 个常驻编码线程，调用线程也参与编码；workers 为0时只在调用线程编码
+D3DEncodePool *d3d_encode_pool_create(uint32_t workers);
+void d3d_encode_pool_destroy(D3DEncodePool *pool);
+uint32_t d3d_encode_pool_workers(const D3DEncodePool *pool);
+
+// 逐个通道并行编码 d3d_stream_split 切好的部分；pool 为NULL时在调用线程上依次编码
+// 同一个线程池同时只能编码一条流
+D3DEncodeResult d3d_stream_encode(const D3DCommandStream *stream, D3DEncodePool *pool, const D3DStreamBackend *backend);
+
+// MARK: - 空后端
+
+typedef struct D3DNullEncoder D3DNullEncoder;
+
+// 不产生任何GPU命令，只跟踪状态并对每次绘制及其生效的状态求一个按提交顺序的散列：
+// 不论怎么切分，只要继承的状态和提交顺序正确，结果都和单线程编码相同
+typedef struct D3DNullBackend {
+    uint32_t work_per_call;                 // 每个调用额外的整数混合轮数，模拟翻译开销
+    D3DNullEncoder **encoders;              // 按部分序号复用
+    uint32_t encoder_count;
+    uint64_t calls;                         // 以下在 submit 时累计
+    uint64_t inherited_calls;
+    uint64_t draws;
+    uint64_t sequence;                      // 最近一次提交的动作（绘制、清除……）散列
+    uint64_t scale;                         // 最近一次提交的散列基数幂，用于拼接多帧
+    uint64_t sink;
+} D3DNullBackend;
+
+void d3d_null_backend_init(D3DNullBackend *backend, uint32_t work_per_call);
+void d3d_null_backend_destroy(D3DNullBackend *backend);
+D3DStreamBackend d3d_null_backend(D3DNullBackend *backend);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // D3D_COMMAND_STREAM_H
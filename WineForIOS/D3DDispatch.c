@@ -0,0 +1,176 @@
+// D3DDispatch.c - Direct3D 操作码表与分派实现
+#include "D3DDispatch.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct OpcodeInfo {
+    const char *name;
+    D3DCategory category;
+} OpcodeInfo;
+
+static const OpcodeInfo opcodeInfo[D3D_OP_COUNT] = {
+    [D3D_OP_INVALID]                       = { "Invalid",                   D3D_CATEGORY_CONTEXT },
+    [D3D_OP_CREATE_DEVICE]                 = { "D3D11CreateDevice",         D3D_CATEGORY_DEVICE },
+    [D3D_OP_CREATE_DEVICE_AND_SWAP_CHAIN]  = { "D3D11CreateDeviceAndSwapChain", D3D_CATEGORY_DEVICE },
+    [D3D_OP_GET_DEVICE]                    = { "GetDevice",                 D3D_CATEGORY_DEVICE },
+    [D3D_OP_CLEAR_RENDER_TARGET_VIEW]      = { "ClearRenderTargetView",     D3D_CATEGORY_CONTEXT },
+    [D3D_OP_CLEAR_DEPTH_STENCIL_VIEW]      = { "ClearDepthStencilView",     D3D_CATEGORY_CONTEXT },
+    [D3D_OP_IA_SET_VERTEX_BUFFERS]         = { "IASetVertexBuffers",        D3D_CATEGORY_CONTEXT },
+    [D3D_OP_IA_SET_INDEX_BUFFER]           = { "IASetIndexBuffer",          D3D_CATEGORY_CONTEXT },
+    [D3D_OP_IA_SET_PRIMITIVE_TOPOLOGY]     = { "IASetPrimitiveTopology",    D3D_CATEGORY_CONTEXT },
+    [D3D_OP_RS_SET_VIEWPORTS]              = { "RSSetViewports",            D3D_CATEGORY_CONTEXT },
+    [D3D_OP_OM_SET_RENDER_TARGETS]         = { "OMSetRenderTargets",        D3D_CATEGORY_CONTEXT },
+    [D3D_OP_PRESENT]                       = { "Present",                   D3D_CATEGORY_CONTEXT },
+    [D3D_OP_DRAW]                          = { "Draw",                      D3D_CATEGORY_DRAW },
+    [D3D_OP_DRAW_INDEXED]                  = { "DrawIndexed",               D3D_CATEGORY_DRAW },
+    [D3D_OP_DRAW_INSTANCED]                = { "DrawInstanced",             D3D_CATEGORY_DRAW },
+    [D3D_OP_DRAW_INDEXED_INSTANCED]        = { "DrawIndexedInstanced",      D3D_CATEGORY_DRAW },
+    [D3D_OP_CREATE_BUFFER]                 = { "CreateBuffer",              D3D_CATEGORY_RESOURCE },
+    [D3D_OP_CREATE_TEXTURE_2D]             = { "CreateTexture2D",           D3D_CATEGORY_RESOURCE },
+    [D3D_OP_CREATE_VERTEX_SHADER]          = { "CreateVertexShader",        D3D_CATEGORY_RESOURCE },
+    [D3D_OP_CREATE_PIXEL_SHADER]           = { "CreatePixelShader",         D3D_CATEGORY_RESOURCE },
+    [D3D_OP_VS_SET_SHADER]                 = { "VSSetShader",               D3D_CATEGORY_SHADER },
+    [D3D_OP_PS_SET_SHADER]                 = { "PSSetShader",               D3D_CATEGORY_SHADER },
+    [D3D_OP_SET_RENDER_STATE]              = { "SetRenderState",            D3D_CATEGORY_STATE },
+    [D3D_OP_SET_SAMPLER_STATE]             = { "SetSamplerState",           D3D_CATEGORY_STATE },
+    [D3D_OP_OM_SET_BLEND_STATE]            = { "OMSetBlendState",           D3D_CATEGORY_STATE },
+    [D3D_OP_OM_SET_DEPTH_STENCIL_STATE]    = { "OMSetDepthStencilState",    D3D_CATEGORY_STATE },
+    [D3D_OP_RS_SET_STATE]                  = { "RSSetState",                D3D_CATEGORY_STATE },
+};
+
+// 其他名字：D3D9 的同义入口和 D3D11 的 Create* 变体
+static const struct {
+    const char *name;
+    D3DOpcode opcode;
+} aliases[] = {
+    { "CreateDevice",           D3D_OP_CREATE_DEVICE },
+    { "Clear",                  D3D_OP_CLEAR_RENDER_TARGET_VIEW },
+    { "DrawPrimitive",          D3D_OP_DRAW },
+    { "DrawIndexedPrimitive",   D3D_OP_DRAW_INDEXED },
+    { "CreateVertexBuffer",     D3D_OP_CREATE_BUFFER },
+    { "CreateIndexBuffer",      D3D_OP_CREATE_BUFFER },
+    { "CreateTexture",          D3D_OP_CREATE_TEXTURE_2D },
+    { "SetVertexShader",        D3D_OP_VS_SET_SHADER },
+    { "SetPixelShader",         D3D_OP_PS_SET_SHADER },
+    { "SetStreamSource",        D3D_OP_IA_SET_VERTEX_BUFFERS },
+    { "SetIndices",             D3D_OP_IA_SET_INDEX_BUFFER },
+    { "SetViewport",            D3D_OP_RS_SET_VIEWPORTS },
+    { "SetRenderTarget",        D3D_OP_OM_SET_RENDER_TARGETS },
+};
+
+// MARK: - 操作码
+
+// 只在绑定时调用，表很小，顺序比较即可
+D3DOpcode d3d_opcode_lookup(const char *name) {
+    if (!name) {
+        return D3D_OP_INVALID;
+    }
+    for (int op = D3D_OP_INVALID + 1; op < D3D_OP_COUNT; op++) {
+        if (strcmp(opcodeInfo[op].name, name) == 0) {
+            return (D3DOpcode)op;
+        }
+    }
+    for (size_t i = 0; i < sizeof(aliases) / sizeof(aliases[0]); i++) {
+        if (strcmp(aliases[i].name, name) == 0) {
+            return aliases[i].opcode;
+        }
+    }
+    return D3D_OP_INVALID;
+}
+
+const char *d3d_opcode_name(D3DOpcode opcode) {
+    return (unsigned)opcode < D3D_OP_COUNT ? opcodeInfo[opcode].name : opcodeInfo[D3D_OP_INVALID].name;
+}
+
+D3DCategory d3d_opcode_category(D3DOpcode opcode) {
+    return (unsigned)opcode < D3D_OP_COUNT ? opcodeInfo[opcode].category : D3D_CATEGORY_CONTEXT;
+}
+
+// MARK: - 分派表
+
+void d3d_dispatch_init(D3DDispatchTable *table, D3DHandler fallback, void *user) {
+    memset(table->handlers, 0, sizeof(table->handlers));
+    table->fallback = fallback;
+    table->user = user;
+    for (int op = 0; op < D3D_OP_COUNT; op++) {
+        atomic_init(&table->calls[op], 0);
+    }
+    atomic_init(&table->failures, 0);
+    table->log.records = NULL;
+    table->log.allocated = 0;
+    atomic_init(&table->log.capacity, 0);
+    atomic_init(&table->log.written, 0);
+}
+
+void d3d_dispatch_destroy(D3DDispatchTable *table) {
+    atomic_store_explicit(&table->log.capacity, 0, memory_order_relaxed);
+    free(table->log.records);
+    table->log.records = NULL;
+    table->log.allocated = 0;
+}
+
+bool d3d_dispatch_set_handler(D3DDispatchTable *table, D3DOpcode opcode, D3DHandler handler) {
+    if (opcode <= D3D_OP_INVALID || opcode >= D3D_OP_COUNT) {
+        return false;
+    }
+    table->handlers[opcode] = handler;
+    return true;
+}
+
+// 正在分派的线程可能还拿着旧的 capacity 写一条记录：缓冲区从不重新分配，capacity 不超过 allocated，写入总在界内
+bool d3d_dispatch_enable_log(D3DDispatchTable *table, uint32_t capacity) {
+    atomic_store_explicit(&table->log.capacity, 0, memory_order_relaxed);
+    if (capacity == 0) {
+        return true;
+    }
+    if (!table->log.records) {
+        D3DCallRecord *records = calloc(capacity, sizeof(D3DCallRecord));
+        if (!records) {
+            return false;
+        }
+        table->log.records = records;
+        table->log.allocated = capacity;
+    }
+    atomic_store_explicit(&table->log.written, 0, memory_order_relaxed);
+    atomic_store_explicit(&table->log.capacity, capacity < table->log.allocated ? capacity : table->log.allocated,
+                          memory_order_release);
+    return true;
+}
+
+void d3d_dispatch_record(D3DDispatchTable *table, uint16_t opcode, bool result) {
+    const uint32_t capacity = atomic_load_explicit(&table->log.capacity, memory_order_acquire);   // 可能刚被关闭
+    if (capacity == 0) {
+        return;
+    }
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    const uint64_t written = atomic_load_explicit(&table->log.written, memory_order_relaxed);
+    D3DCallRecord *record = &table->log.records[written % capacity];
+    record->timestamp_ns = (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+    record->opcode = opcode;
+    record->result = result;
+    atomic_store_explicit(&table->log.written, written + 1, memory_order_release);
+}
+
+uint32_t d3d_dispatch_copy_log(const D3DDispatchTable *table, D3DCallRecord *records, uint32_t max) {
+    const D3DCallLog *log = &table->log;
+    const uint32_t capacity = atomic_load_explicit(&log->capacity, memory_order_acquire);
+    if (capacity == 0) {
+        return 0;
+    }
+    const uint64_t written = atomic_load_explicit(&log->written, memory_order_acquire);
+    uint64_t available = written < capacity ? written : capacity;
+    if (available > max) {
+        available = max;
+    }
+    const uint64_t first = written - available;
+    for (uint64_t i = 0; i < available; i++) {
+        records[i] = log->records[(first + i) % capacity];
+    }
+    return (uint32_t)available;
+}
+
+void d3d_dispatch_clear_log(D3DDispatchTable *table) {
+    atomic_store_explicit(&table->log.written, 0, memory_order_relaxed);
+}
@@ -0,0 +1,161 @@
+// D3DDispatch.h - Direct3D 入口的整数操作码与函数指针分派表
+// 纯C实现，替代按函数名字符串逐条 containsString:/hasPrefix: 分类的做法：
+//   绑定：函数名只在绑定时（导入解析、第一次调用）换成操作码，之后每次调用只传操作码
+//   参数：按操作码打包成定长结构体，不装箱成 NSNumber/NSArray
+//   分派：操作码直接索引处理函数表，没有注册处理函数的操作码走后备函数
+//   日志：默认关闭；打开后写进定长环形缓冲区，不格式化字符串、不分配
+// 处理函数表在初始化后只读；调用计数为原子计数，日志环只支持一个写入线程（与D3D11立即上下文的单线程约定一致），
+// 开关日志可以与分派并发：缓冲区在第一次打开时分配，之后到 destroy 都不再移动
+#ifndef D3D_DISPATCH_H
+#define D3D_DISPATCH_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum D3DOpcode {
+    D3D_OP_INVALID = 0,
+    // 设备
+    D3D_OP_CREATE_DEVICE,
+    D3D_OP_CREATE_DEVICE_AND_SWAP_CHAIN,
+    D3D_OP_GET_DEVICE,
+    // 上下文
+    D3D_OP_CLEAR_RENDER_TARGET_VIEW,
+    D3D_OP_CLEAR_DEPTH_STENCIL_VIEW,
+    D3D_OP_IA_SET_VERTEX_BUFFERS,
+    D3D_OP_IA_SET_INDEX_BUFFER,
+    D3D_OP_IA_SET_PRIMITIVE_TOPOLOGY,
+    D3D_OP_RS_SET_VIEWPORTS,
+    D3D_OP_OM_SET_RENDER_TARGETS,
+    D3D_OP_PRESENT,
+    // 绘制
+    D3D_OP_DRAW,
+    D3D_OP_DRAW_INDEXED,
+    D3D_OP_DRAW_INSTANCED,
+    D3D_OP_DRAW_INDEXED_INSTANCED,
+    // 资源
+    D3D_OP_CREATE_BUFFER,
+    D3D_OP_CREATE_TEXTURE_2D,
+    D3D_OP_CREATE_VERTEX_SHADER,
+    D3D_OP_CREATE_PIXEL_SHADER,
+    // 着色器绑定
+    D3D_OP_VS_SET_SHADER,
+    D3D_OP_PS_SET_SHADER,
+    // 状态
+    D3D_OP_SET_RENDER_STATE,
+    D3D_OP_SET_SAMPLER_STATE,
+    D3D_OP_OM_SET_BLEND_STATE,
+    D3D_OP_OM_SET_DEPTH_STENCIL_STATE,
+    D3D_OP_RS_SET_STATE,
+    D3D_OP_COUNT
+} D3DOpcode;
+
+// 与 DirectXFunctionType 的取值一一对应
+typedef enum D3DCategory {
+    D3D_CATEGORY_DEVICE = 0,
+    D3D_CATEGORY_CONTEXT,
+    D3D_CATEGORY_DRAW,
+    D3D_CATEGORY_RESOURCE,
+    D3D_CATEGORY_SHADER,
+    D3D_CATEGORY_STATE
+} D3DCategory;
+
+#define D3D_CALL_MAX_ARGS   6
+
+// 一次调用：操作码 + 按操作码解释的参数
+typedef struct D3DCall {
+    uint16_t opcode;                        // D3DOpcode
+    uint16_t arg_count;                     // raw 中有效的个数（按字符串名调用时的原始参数）
+    uint32_t reserved;
+    union {
+        struct { uint32_t vertex_count, start_vertex; } draw;
+        struct { uint32_t index_count, start_index; int32_t base_vertex; } draw_indexed;
+        struct { uint32_t vertex_count, instance_count, start_vertex, start_instance; } draw_instanced;
+        struct {
+            uint32_t index_count, instance_count, start_index;
+            int32_t base_vertex;
+            uint32_t start_instance;
+        } draw_indexed_instanced;
+        struct { uint32_t byte_width, usage, bind_flags, cpu_access_flags; } buffer;
+        struct { uint32_t width, height, mip_levels, array_size, format, bind_flags; } texture;
+        struct { uint64_t handle; } shader;
+        struct { uint32_t state, value; } state;        // 采样器状态时为 (slot, state)
+        struct { uint32_t start_slot, count; uint64_t first; } bind;
+        struct { float rgba[4]; uint64_t view; } clear;
+        uint64_t raw[D3D_CALL_MAX_ARGS];
+    } args;
+} D3DCall;
+
+// 绑定时用：函数名（大小写敏感，包含D3D9/D3D11的常见别名）换操作码，未知名字返回 D3D_OP_INVALID
+D3DOpcode d3d_opcode_lookup(const char *name);
+const char *d3d_opcode_name(D3DOpcode opcode);
+D3DCategory d3d_opcode_category(D3DOpcode opcode);
+
+// MARK: - 分派表
+
+typedef bool (*D3DHandler)(const D3DCall *call, void *user);
+
+typedef struct D3DCallRecord {
+    uint64_t timestamp_ns;                  // CLOCK_MONOTONIC
+    uint16_t opcode;
+    bool result;
+} D3DCallRecord;
+
+typedef struct D3DCallLog {
+    D3DCallRecord *records;                 // 第一次打开时分配，先于 capacity 发布
+    uint32_t allocated;
+    _Atomic uint32_t capacity;              // 0 表示关闭；关闭时不释放 records
+    _Atomic uint64_t written;               // 累计写入数，环满后覆盖最旧的记录
+} D3DCallLog;
+
+typedef struct D3DDispatchTable {
+    D3DHandler handlers[D3D_OP_COUNT];
+    D3DHandler fallback;                    // 没有注册处理函数的操作码，可为NULL（调用失败）
+    void *user;
+    _Atomic uint64_t calls[D3D_OP_COUNT];   // calls[D3D_OP_INVALID] 为越界/无效操作码
+    _Atomic uint64_t failures;
+    D3DCallLog log;
+} D3DDispatchTable;
+
+void d3d_dispatch_init(D3DDispatchTable *table, D3DHandler fallback, void *user);
+void d3d_dispatch_destroy(D3DDispatchTable *table);
+bool d3d_dispatch_set_handler(D3DDispatchTable *table, D3DOpcode opcode, D3DHandler handler);
+
+// capacity 为0时关闭日志，可以与分派并发调用（开关之间需要调用方自己串行）；
+// 打开时清空记录。缓冲区只在第一次打开时按 capacity 分配，之后更大的 capacity 截到已分配的大小。
+// 内存不足返回false（日志保持关闭）
+bool d3d_dispatch_enable_log(D3DDispatchTable *table, uint32_t capacity);
+
+// 按时间顺序复制最近至多 max 条记录，返回条数
+uint32_t d3d_dispatch_copy_log(const D3DDispatchTable *table, D3DCallRecord *records, uint32_t max);
+void d3d_dispatch_clear_log(D3DDispatchTable *table);
+
+void d3d_dispatch_record(D3DDispatchTable *table, uint16_t opcode, bool result);
+
+static inline bool d3d_dispatch(D3DDispatchTable *table, const D3DCall *call) {
+    const uint16_t opcode = call->opcode < D3D_OP_COUNT ? call->opcode : D3D_OP_INVALID;
+    D3DHandler handler = opcode != D3D_OP_INVALID ? table->handlers[opcode] : NULL;
+    if (!handler && opcode != D3D_OP_INVALID) {
+        handler = table->fallback;
+    }
+    const bool result = handler && handler(call, table->user);
+    atomic_fetch_add_explicit(&table->calls[opcode], 1, memory_order_relaxed);
+    if (!result) {
+        atomic_fetch_add_explicit(&table->failures, 1, memory_order_relaxed);
+    }
+    if (atomic_load_explicit(&table->log.capacity, memory_order_relaxed)) {
+        d3d_dispatch_record(table, opcode, result);
+    }
+    return result;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // D3D_DISPATCH_H
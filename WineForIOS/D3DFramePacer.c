@@ -0,0 +1,193 @@
+// D3DFramePacer.c - 帧节奏控制实现
+#include "D3DFramePacer.h"
+#include <string.h>
+#include <time.h>
+
+uint64_t d3d_pacer_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+bool d3d_pacer_init(D3DFramePacer *pacer, uint32_t max_in_flight, uint64_t refresh_interval_ns,
+                    uint64_t upload_region_size) {
+    memset(pacer, 0, sizeof(*pacer));
+    if (max_in_flight == 0 || max_in_flight > D3D_PACER_MAX_FRAMES_IN_FLIGHT) {
+        return false;
+    }
+    // Darwin 没有 pthread_condattr_setclock，超时按 CLOCK_REALTIME 计算
+    if (pthread_mutex_init(&pacer->mutex, NULL) != 0) {
+        return false;
+    }
+    if (pthread_cond_init(&pacer->slot_freed, NULL) != 0) {
+        pthread_mutex_destroy(&pacer->mutex);
+        return false;
+    }
+    pacer->max_in_flight = max_in_flight;
+    pacer->next_frame = 1;
+    pacer->refresh_interval_ns = refresh_interval_ns;
+    pacer->upload_region_size = upload_region_size;
+    return true;
+}
+
+void d3d_pacer_destroy(D3DFramePacer *pacer) {
+    if (pacer->max_in_flight == 0) {
+        return;
+    }
+    pthread_cond_destroy(&pacer->slot_freed);
+    pthread_mutex_destroy(&pacer->mutex);
+    pacer->max_in_flight = 0;
+}
+
+void d3d_pacer_set_refresh_interval(D3DFramePacer *pacer, uint64_t refresh_interval_ns) {
+    pthread_mutex_lock(&pacer->mutex);
+    pacer->refresh_interval_ns = refresh_interval_ns;
+    pthread_mutex_unlock(&pacer->mutex);
+}
+
+// 下一帧要用的槽位空闲且并行帧数未满
+static inline bool pacer_slot_available(const D3DFramePacer *pacer) {
+    return pacer->in_flight < pacer->max_in_flight &&
+           pacer->slot_frame[pacer->next_frame % pacer->max_in_flight] == 0;
+}
+
+static void realtime_deadline(uint64_t timeout_ns, struct timespec *deadline) {
+    clock_gettime(CLOCK_REALTIME, deadline);
+    const uint64_t nsec = (uint64_t)deadline->tv_nsec + timeout_ns % 1000000000ULL;
+    deadline->tv_sec += (time_t)(timeout_ns / 1000000000ULL + nsec / 1000000000ULL);
+    deadline->tv_nsec = (long)(nsec % 1000000000ULL);
+}
+
+bool d3d_pacer_begin_frame(D3DFramePacer *pacer, uint64_t timeout_ns, D3DFrameTicket *ticket) {
+    const uint64_t start = d3d_pacer_now_ns();
+    pthread_mutex_lock(&pacer->mutex);
+    if (!pacer_slot_available(pacer) && timeout_ns != 0) {
+        struct timespec deadline;
+        if (timeout_ns != D3D_PACER_WAIT_FOREVER) {
+            realtime_deadline(timeout_ns, &deadline);
+        }
+        while (!pacer_slot_available(pacer)) {
+            if (timeout_ns == D3D_PACER_WAIT_FOREVER) {
+                pthread_cond_wait(&pacer->slot_freed, &pacer->mutex);
+            } else if (pthread_cond_timedwait(&pacer->slot_freed, &pacer->mutex, &deadline) != 0) {
+                break;
+            }
+        }
+    }
+    if (!pacer_slot_available(pacer)) {
+        pacer->stats.timeouts++;
+        pthread_mutex_unlock(&pacer->mutex);
+        return false;
+    }
+
+    const uint64_t now = d3d_pacer_now_ns();
+    const uint32_t slot = (uint32_t)(pacer->next_frame % pacer->max_in_flight);
+    ticket->frame = pacer->next_frame++;
+    ticket->slot = slot;
+    ticket->begin_ns = now;
+    ticket->deadline_ns = now + pacer->refresh_interval_ns * pacer->max_in_flight;
+    pacer->slot_frame[slot] = ticket->frame;
+    pacer->upload_used[slot] = 0;
+    pacer->in_flight++;
+
+    const uint64_t waited = now - start;
+    pacer->stats.frames_begun++;
+    pacer->stats.wait_ns_total += waited;
+    if (waited > pacer->stats.wait_ns_max) {
+        pacer->stats.wait_ns_max = waited;
+    }
+    pthread_mutex_unlock(&pacer->mutex);
+    return true;
+}
+
+void d3d_pacer_frame_completed(D3DFramePacer *pacer, const D3DFrameTicket *ticket) {
+    const uint64_t now = d3d_pacer_now_ns();
+    pthread_mutex_lock(&pacer->mutex);
+    if (ticket->slot >= pacer->max_in_flight || pacer->slot_frame[ticket->slot] != ticket->frame) {
+        pthread_mutex_unlock(&pacer->mutex);        // 重复完成或凭据不属于这个节奏器
+        return;
+    }
+    pacer->slot_frame[ticket->slot] = 0;
+    pacer->in_flight--;
+
+    const uint64_t latency = now - ticket->begin_ns;
+    pacer->stats.frames_completed++;
+    pacer->stats.latency_ns_total += latency;
+    if (latency > pacer->stats.latency_ns_max) {
+        pacer->stats.latency_ns_max = latency;
+    }
+    if (now > ticket->deadline_ns) {
+        pacer->stats.late_frames++;
+    }
+    if (pacer->upload_used[ticket->slot] > pacer->stats.upload_peak) {
+        pacer->stats.upload_peak = pacer->upload_used[ticket->slot];
+    }
+    pthread_cond_broadcast(&pacer->slot_freed);
+    pthread_mutex_unlock(&pacer->mutex);
+}
+
+bool d3d_pacer_should_render(D3DFramePacer *pacer) {
+    pthread_mutex_lock(&pacer->mutex);
+    const bool available = pacer_slot_available(pacer);
+    if (!available) {
+        pacer->stats.skipped_refreshes++;
+    }
+    pthread_mutex_unlock(&pacer->mutex);
+    return available;
+}
+
+uint32_t d3d_pacer_in_flight(D3DFramePacer *pacer) {
+    pthread_mutex_lock(&pacer->mutex);
+    const uint32_t in_flight = pacer->in_flight;
+    pthread_mutex_unlock(&pacer->mutex);
+    return in_flight;
+}
+
+bool d3d_pacer_wait_in_flight(D3DFramePacer *pacer, uint32_t at_most, uint64_t timeout_ns) {
+    pthread_mutex_lock(&pacer->mutex);
+    if (pacer->in_flight > at_most && timeout_ns != 0) {
+        struct timespec deadline;
+        if (timeout_ns != D3D_PACER_WAIT_FOREVER) {
+            realtime_deadline(timeout_ns, &deadline);
+        }
+        while (pacer->in_flight > at_most) {
+            if (timeout_ns == D3D_PACER_WAIT_FOREVER) {
+                pthread_cond_wait(&pacer->slot_freed, &pacer->mutex);
+            } else if (pthread_cond_timedwait(&pacer->slot_freed, &pacer->mutex, &deadline) != 0) {
+                break;
+            }
+        }
+    }
+    const bool drained = pacer->in_flight <= at_most;
+    pthread_mutex_unlock(&pacer->mutex);
+    return drained;
+}
+
+bool d3d_pacer_upload(D3DFramePacer *pacer, const D3DFrameTicket *ticket, uint64_t size, uint64_t alignment,
+                      uint64_t *offset) {
+    if (alignment == 0 || (alignment & (alignment - 1)) != 0) {
+        return false;
+    }
+    pthread_mutex_lock(&pacer->mutex);
+    bool ok = false;
+    if (ticket->slot < pacer->max_in_flight && pacer->slot_frame[ticket->slot] == ticket->frame) {
+        const uint64_t aligned = (pacer->upload_used[ticket->slot] + alignment - 1) & ~(alignment - 1);
+        if (aligned <= pacer->upload_region_size && size <= pacer->upload_region_size - aligned) {
+            *offset = (uint64_t)ticket->slot * pacer->upload_region_size + aligned;
+            pacer->upload_used[ticket->slot] = aligned + size;
+            ok = true;
+        }
+    }
+    if (!ok) {
+        pacer->stats.upload_failures++;
+    }
+    pthread_mutex_unlock(&pacer->mutex);
+    return ok;
+}
+
+D3DFramePacerStats d3d_pacer_stats(D3DFramePacer *pacer) {
+    pthread_mutex_lock(&pacer->mutex);
+    const D3DFramePacerStats stats = pacer->stats;
+    pthread_mutex_unlock(&pacer->mutex);
+    return stats;
+}
@@ -0,0 +1,96 @@
+// D3DFramePacer.h - 多帧并行（frames in flight）的帧节奏控制与每帧上传内存
+// 纯C实现，替代 presentFrame 每帧 waitUntilCompleted、CPU整帧等GPU的做法：
+//   并行帧：最多 max_in_flight 帧同时在GPU上，开始新帧前在互斥锁+条件变量上等空槽位，
+//           GPU完成回调（任意线程）释放槽位并广播；CPU录制第 N+1 帧时GPU还在执行第 N 帧
+//   上传内存：一块共享缓冲区按槽位等分，每帧在自己槽位的区域内线性分配；
+//             槽位被重新分配时上一次占用它的帧一定已经完成，CPU写入不会覆盖GPU正在读的数据
+//   节奏：由显示刷新（CADisplayLink）驱动，没有空槽位时跳过这次刷新而不是阻塞主线程；
+//         帧从开始到GPU完成超过 max_in_flight 个刷新周期记为迟到（会错过显示时机）
+// 所有函数都是线程安全的
+#ifndef D3D_FRAME_PACER_H
+#define D3D_FRAME_PACER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define D3D_PACER_MAX_FRAMES_IN_FLIGHT  4
+#define D3D_PACER_WAIT_FOREVER          UINT64_MAX
+
+// 一帧的凭据：begin 时发放，完成回调时交回
+typedef struct D3DFrameTicket {
+    uint64_t frame;                         // 从1开始的帧序号
+    uint32_t slot;                          // 上传区域和槽位序号
+    uint64_t begin_ns;
+    uint64_t deadline_ns;                   // 超过即为迟到
+} D3DFrameTicket;
+
+typedef struct D3DFramePacerStats {
+    uint64_t frames_begun;
+    uint64_t frames_completed;
+    uint64_t late_frames;
+    uint64_t skipped_refreshes;             // 显示刷新时没有空槽位
+    uint64_t timeouts;                      // 等空槽位超时
+    uint64_t wait_ns_total;                 // CPU在 begin 中阻塞的时间
+    uint64_t wait_ns_max;
+    uint64_t latency_ns_total;              // 从 begin 到GPU完成
+    uint64_t latency_ns_max;
+    uint64_t upload_peak;                   // 单帧最多用掉的上传字节数
+    uint64_t upload_failures;
+} D3DFramePacerStats;
+
+typedef struct D3DFramePacer {
+    pthread_mutex_t mutex;
+    pthread_cond_t slot_freed;
+    uint32_t max_in_flight;
+    uint32_t in_flight;
+    uint64_t next_frame;
+    uint64_t slot_frame[D3D_PACER_MAX_FRAMES_IN_FLIGHT];    // 占用槽位的帧，0 表示空闲
+    uint64_t refresh_interval_ns;
+    uint64_t upload_region_size;            // 每个槽位的上传区域字节数
+    uint64_t upload_used[D3D_PACER_MAX_FRAMES_IN_FLIGHT];
+    D3DFramePacerStats stats;
+} D3DFramePacer;
+
+// max_in_flight 取 1..D3D_PACER_MAX_FRAMES_IN_FLIGHT，1 等同于每帧等GPU完成
+// 上传缓冲区总大小为 upload_region_size * max_in_flight（由调用方分配）
+bool d3d_pacer_init(D3DFramePacer *pacer, uint32_t max_in_flight, uint64_t refresh_interval_ns,
+                    uint64_t upload_region_size);
+void d3d_pacer_destroy(D3DFramePacer *pacer);
+
+// 显示刷新周期变化时（ProMotion、外接屏幕）更新，只影响之后开始的帧
+void d3d_pacer_set_refresh_interval(D3DFramePacer *pacer, uint64_t refresh_interval_ns);
+
+// 等一个空槽位开始新帧：timeout_ns 为0时不等待，D3D_PACER_WAIT_FOREVER 一直等；超时返回false
+bool d3d_pacer_begin_frame(D3DFramePacer *pacer, uint64_t timeout_ns, D3DFrameTicket *ticket);
+
+// GPU完成（或提交失败、放弃这一帧）时调用一次，释放槽位并唤醒等待者
+void d3d_pacer_frame_completed(D3DFramePacer *pacer, const D3DFrameTicket *ticket);
+
+// 显示刷新回调里调用：有空槽位返回true；没有时记一次跳过的刷新
+bool d3d_pacer_should_render(D3DFramePacer *pacer);
+
+uint32_t d3d_pacer_in_flight(D3DFramePacer *pacer);
+
+// 等到并行帧数不超过 at_most（即对应的完成回调都已调用）；timeout_ns 的含义同 begin_frame，超时返回false
+bool d3d_pacer_wait_in_flight(D3DFramePacer *pacer, uint32_t at_most, uint64_t timeout_ns);
+
+// 在本帧的上传区域内分配 size 字节（alignment 为2的幂），返回在整个上传缓冲区中的偏移
+// 区域用完返回false，调用方另外分配
+bool d3d_pacer_upload(D3DFramePacer *pacer, const D3DFrameTicket *ticket, uint64_t size, uint64_t alignment,
+                      uint64_t *offset);
+
+D3DFramePacerStats d3d_pacer_stats(D3DFramePacer *pacer);
+
+// CLOCK_MONOTONIC 纳秒
+uint64_t d3d_pacer_now_ns(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // D3D_FRAME_PACER_H
@@ -0,0 +1,386 @@
+// D3DPipelineCache.c - 管线状态对象缓存实现
+// 描述符先压成规范化的键字（未使用的部分不写入、关闭混合时忽略混合因子），哈希和比较都基于键字；
+// 条目放在固定槽位数组中，哈希桶链按64位哈希索引，LRU为按槽位下标链接的双向链表
+#include "D3DPipelineCache.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+// 着色器2 + 计数1 + 属性 + 缓冲区 + 每个颜色附件2 + 深度/光栅化2
+#define PSO_KEY_WORDS   (3 + D3D_PSO_MAX_VERTEX_ATTRIBUTES + D3D_PSO_MAX_VERTEX_BUFFERS + \
+                         D3D_PSO_MAX_COLOR_ATTACHMENTS * 2 + 2)
+
+typedef struct PipelineEntry {
+    uint64_t hash;
+    uint64_t key[PSO_KEY_WORDS];
+    uint32_t key_words;
+    void *pipeline;
+    int32_t hash_next;                      // 哈希桶链；空闲槽位时为空闲链
+    int32_t lru_prev;                       // 靠近最近使用端
+    int32_t lru_next;
+    uint8_t state;                          // D3DPipelineState，空闲槽位为 D3D_PSO_MISS
+    bool used;
+} PipelineEntry;
+
+struct D3DPipelineCache {
+    pthread_mutex_t mutex;
+    PipelineEntry *entries;
+    uint32_t capacity;
+    int32_t *buckets;
+    uint32_t bucket_mask;
+    int32_t free_head;
+    int32_t lru_head;                       // 最近使用
+    int32_t lru_tail;                       // 最久未用，淘汰从这里开始
+    D3DPipelineReleaseCallback release_callback;
+    void *release_userdata;
+    D3DPipelineCacheStats stats;
+};
+
+// MARK: - 描述符键
+
+static inline uint64_t mix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xFF51AFD7ED558CCDULL;
+    x ^= x >> 33;
+    x *= 0xC4CEB9FE1A85EC53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+static uint32_t pack_desc(const D3DPipelineDesc *desc, uint64_t *words) {
+    const uint32_t attributes = desc->attribute_count < D3D_PSO_MAX_VERTEX_ATTRIBUTES ?
+                                desc->attribute_count : D3D_PSO_MAX_VERTEX_ATTRIBUTES;
+    const uint32_t buffers = desc->buffer_count < D3D_PSO_MAX_VERTEX_BUFFERS ?
+                             desc->buffer_count : D3D_PSO_MAX_VERTEX_BUFFERS;
+    uint32_t n = 0;
+
+    words[n++] = desc->vertex_shader;
+    words[n++] = desc->fragment_shader;
+    words[n++] = (uint64_t)attributes | (uint64_t)buffers << 32;
+    for (uint32_t i = 0; i < attributes; i++) {
+        const D3DVertexAttribute *attribute = &desc->attributes[i];
+        words[n++] = (uint64_t)attribute->format | (uint64_t)attribute->buffer << 8 |
+                     (uint64_t)attribute->offset << 16;
+    }
+    for (uint32_t i = 0; i < buffers; i++) {
+        words[n++] = (uint64_t)desc->buffer_strides[i] | (uint64_t)(desc->buffer_per_instance[i] != 0) << 32;
+    }
+    for (uint32_t i = 0; i < D3D_PSO_MAX_COLOR_ATTACHMENTS; i++) {
+        if (desc->color_formats[i] == 0) {
+            continue;
+        }
+        const D3DBlendState *blend = &desc->blend[i];
+        words[n++] = (uint64_t)i | (uint64_t)desc->color_formats[i] << 32;
+        uint64_t packed = (uint64_t)blend->write_mask;
+        if (blend->enabled) {
+            packed |= 1ULL << 8 |
+                      (uint64_t)blend->src_rgb << 16 | (uint64_t)blend->dst_rgb << 24 |
+                      (uint64_t)blend->op_rgb << 32 | (uint64_t)blend->src_alpha << 40 |
+                      (uint64_t)blend->dst_alpha << 48 | (uint64_t)blend->op_alpha << 56;
+        }
+        words[n++] = packed;
+    }
+    // 深度测试关闭时比较函数和写入无意义
+    uint64_t depth = (uint64_t)desc->depth_stencil_format | (uint64_t)(desc->stencil_enabled != 0) << 32;
+    if (desc->depth_test) {
+        depth |= 1ULL << 40 | (uint64_t)(desc->depth_write != 0) << 41 | (uint64_t)desc->depth_compare << 48;
+    }
+    words[n++] = depth;
+    words[n++] = (uint64_t)desc->cull_mode | (uint64_t)desc->fill_mode << 8 |
+                 (uint64_t)(desc->front_counter_clockwise != 0) << 16 | (uint64_t)desc->topology_class << 24 |
+                 (uint64_t)desc->sample_count << 32 | (uint64_t)(desc->alpha_to_coverage != 0) << 40;
+    return n;
+}
+
+static uint64_t hash_words(const uint64_t *words, uint32_t count) {
+    uint64_t hash = 0x9E3779B97F4A7C15ULL;
+    for (uint32_t i = 0; i < count; i++) {
+        hash = mix64(hash ^ words[i]) + i;
+    }
+    return hash ? hash : 1;
+}
+
+uint64_t d3d_pipeline_desc_hash(const D3DPipelineDesc *desc) {
+    uint64_t words[PSO_KEY_WORDS];
+    const uint32_t count = pack_desc(desc, words);
+    return hash_words(words, count);
+}
+
+bool d3d_pipeline_desc_equal(const D3DPipelineDesc *a, const D3DPipelineDesc *b) {
+    uint64_t words_a[PSO_KEY_WORDS];
+    uint64_t words_b[PSO_KEY_WORDS];
+    const uint32_t count_a = pack_desc(a, words_a);
+    const uint32_t count_b = pack_desc(b, words_b);
+    return count_a == count_b && memcmp(words_a, words_b, count_a * sizeof(uint64_t)) == 0;
+}
+
+// MARK: - 创建与销毁
+
+D3DPipelineCache *d3d_pso_cache_create(uint32_t capacity) {
+    if (capacity == 0) {
+        capacity = D3D_PSO_DEFAULT_CAPACITY;
+    }
+
+    D3DPipelineCache *cache = calloc(1, sizeof(D3DPipelineCache));
+    if (!cache) {
+        return NULL;
+    }
+
+    uint32_t bucket_count = 1;
+    while (bucket_count < capacity * 2) {
+        bucket_count <<= 1;
+    }
+
+    cache->entries = calloc(capacity, sizeof(PipelineEntry));
+    cache->buckets = malloc(bucket_count * sizeof(int32_t));
+    if (!cache->entries || !cache->buckets || pthread_mutex_init(&cache->mutex, NULL) != 0) {
+        free(cache->entries);
+        free(cache->buckets);
+        free(cache);
+        return NULL;
+    }
+
+    memset(cache->buckets, 0xFF, bucket_count * sizeof(int32_t));
+    for (uint32_t i = 0; i < capacity; i++) {
+        cache->entries[i].hash_next = i + 1 < capacity ? (int32_t)(i + 1) : -1;
+    }
+    cache->capacity = capacity;
+    cache->bucket_mask = bucket_count - 1;
+    cache->free_head = 0;
+    cache->lru_head = -1;
+    cache->lru_tail = -1;
+    cache->stats.capacity = capacity;
+    return cache;
+}
+
+void d3d_pso_cache_destroy(D3DPipelineCache *cache) {
+    if (!cache) {
+        return;
+    }
+    // 编译中的条目还没有管线对象，调用方应先等后台编译结束
+    d3d_pso_cache_flush(cache);
+    pthread_mutex_destroy(&cache->mutex);
+    free(cache->entries);
+    free(cache->buckets);
+    free(cache);
+}
+
+void d3d_pso_cache_set_release_callback(D3DPipelineCache *cache, D3DPipelineReleaseCallback callback,
+                                        void *userdata) {
+    if (!cache) {
+        return;
+    }
+    pthread_mutex_lock(&cache->mutex);
+    cache->release_callback = callback;
+    cache->release_userdata = userdata;
+    pthread_mutex_unlock(&cache->mutex);
+}
+
+// MARK: - 链表维护（持有 mutex）
+
+static void lru_unlink(D3DPipelineCache *cache, int32_t index) {
+    PipelineEntry *entry = &cache->entries[index];
+    if (entry->lru_prev != -1) {
+        cache->entries[entry->lru_prev].lru_next = entry->lru_next;
+    } else {
+        cache->lru_head = entry->lru_next;
+    }
+    if (entry->lru_next != -1) {
+        cache->entries[entry->lru_next].lru_prev = entry->lru_prev;
+    } else {
+        cache->lru_tail = entry->lru_prev;
+    }
+    entry->lru_prev = -1;
+    entry->lru_next = -1;
+}
+
+static void lru_push_front(D3DPipelineCache *cache, int32_t index) {
+    PipelineEntry *entry = &cache->entries[index];
+    entry->lru_prev = -1;
+    entry->lru_next = cache->lru_head;
+    if (cache->lru_head != -1) {
+        cache->entries[cache->lru_head].lru_prev = index;
+    } else {
+        cache->lru_tail = index;
+    }
+    cache->lru_head = index;
+}
+
+static void unlink_from_bucket(D3DPipelineCache *cache, int32_t index) {
+    PipelineEntry *entry = &cache->entries[index];
+    int32_t *link = &cache->buckets[entry->hash & cache->bucket_mask];
+    while (*link != -1) {
+        if (*link == index) {
+            *link = entry->hash_next;
+            break;
+        }
+        link = &cache->entries[*link].hash_next;
+    }
+    entry->hash_next = -1;
+}
+
+// 释放条目的管线对象并把槽位放回空闲链
+static void retire_entry(D3DPipelineCache *cache, int32_t index) {
+    PipelineEntry *entry = &cache->entries[index];
+    if (entry->pipeline && cache->release_callback) {
+        cache->release_callback(entry->pipeline, cache->release_userdata);
+    }
+    unlink_from_bucket(cache, index);
+    lru_unlink(cache, index);
+    entry->pipeline = NULL;
+    entry->state = D3D_PSO_MISS;
+    entry->used = false;
+    entry->hash_next = cache->free_head;
+    cache->free_head = index;
+    cache->stats.entries--;
+}
+
+static int32_t find_entry(D3DPipelineCache *cache, uint64_t hash, const uint64_t *key, uint32_t key_words,
+                          bool count_collisions) {
+    int32_t index = cache->buckets[hash & cache->bucket_mask];
+    while (index != -1) {
+        const PipelineEntry *entry = &cache->entries[index];
+        if (entry->hash == hash) {
+            if (entry->key_words == key_words && memcmp(entry->key, key, key_words * sizeof(uint64_t)) == 0) {
+                return index;
+            }
+            if (count_collisions) {
+                cache->stats.collisions++;
+            }
+        }
+        index = entry->hash_next;
+    }
+    return -1;
+}
+
+// 取一个空闲槽位，没有时淘汰最久未用的已完成条目
+static int32_t allocate_entry(D3DPipelineCache *cache) {
+    if (cache->free_head == -1) {
+        int32_t victim = cache->lru_tail;
+        while (victim != -1 && cache->entries[victim].state == D3D_PSO_COMPILING) {
+            victim = cache->entries[victim].lru_prev;
+        }
+        if (victim == -1) {
+            return -1;
+        }
+        retire_entry(cache, victim);
+        cache->stats.evictions++;
+    }
+    const int32_t index = cache->free_head;
+    cache->free_head = cache->entries[index].hash_next;
+    return index;
+}
+
+// MARK: - 查找与登记
+
+D3DPipelineState d3d_pso_cache_acquire(D3DPipelineCache *cache, const D3DPipelineDesc *desc, uint64_t hash,
+                                       void **pipeline) {
+    uint64_t key[PSO_KEY_WORDS];
+    const uint32_t key_words = pack_desc(desc, key);
+    *pipeline = NULL;
+
+    pthread_mutex_lock(&cache->mutex);
+    int32_t index = find_entry(cache, hash, key, key_words, true);
+    if (index != -1) {
+        PipelineEntry *entry = &cache->entries[index];
+        const D3DPipelineState state = (D3DPipelineState)entry->state;
+        if (state == D3D_PSO_READY) {
+            cache->stats.hits++;
+            *pipeline = entry->pipeline;
+        } else if (state == D3D_PSO_COMPILING) {
+            cache->stats.compiling_hits++;
+        } else {
+            cache->stats.failed_hits++;
+        }
+        if (cache->lru_head != index) {
+            lru_unlink(cache, index);
+            lru_push_front(cache, index);
+        }
+        pthread_mutex_unlock(&cache->mutex);
+        return state;
+    }
+
+    cache->stats.misses++;
+    index = allocate_entry(cache);
+    if (index == -1) {
+        // 全部槽位都在编译：这次不登记，调用方按编译中处理，稍后重试
+        cache->stats.compiling_hits++;
+        pthread_mutex_unlock(&cache->mutex);
+        return D3D_PSO_COMPILING;
+    }
+
+    PipelineEntry *entry = &cache->entries[index];
+    entry->hash = hash;
+    memcpy(entry->key, key, key_words * sizeof(uint64_t));
+    entry->key_words = key_words;
+    entry->pipeline = NULL;
+    entry->state = D3D_PSO_COMPILING;
+    entry->used = true;
+    const uint32_t bucket = (uint32_t)(hash & cache->bucket_mask);
+    entry->hash_next = cache->buckets[bucket];
+    cache->buckets[bucket] = index;
+    lru_push_front(cache, index);
+    cache->stats.entries++;
+    cache->stats.compiling++;
+    pthread_mutex_unlock(&cache->mutex);
+    return D3D_PSO_MISS;
+}
+
+bool d3d_pso_cache_complete(D3DPipelineCache *cache, const D3DPipelineDesc *desc, uint64_t hash, void *pipeline) {
+    uint64_t key[PSO_KEY_WORDS];
+    const uint32_t key_words = pack_desc(desc, key);
+
+    pthread_mutex_lock(&cache->mutex);
+    const int32_t index = find_entry(cache, hash, key, key_words, false);
+    if (index == -1 || cache->entries[index].state != D3D_PSO_COMPILING) {
+        pthread_mutex_unlock(&cache->mutex);
+        return false;
+    }
+    PipelineEntry *entry = &cache->entries[index];
+    entry->pipeline = pipeline;
+    entry->state = pipeline ? D3D_PSO_READY : D3D_PSO_FAILED;
+    if (pipeline) {
+        cache->stats.compiled++;
+    } else {
+        cache->stats.compile_failures++;
+    }
+    cache->stats.compiling--;
+    pthread_mutex_unlock(&cache->mutex);
+    return true;
+}
+
+bool d3d_pso_cache_retry(D3DPipelineCache *cache, const D3DPipelineDesc *desc, uint64_t hash) {
+    uint64_t key[PSO_KEY_WORDS];
+    const uint32_t key_words = pack_desc(desc, key);
+
+    pthread_mutex_lock(&cache->mutex);
+    const int32_t index = find_entry(cache, hash, key, key_words, false);
+    if (index == -1 || cache->entries[index].state != D3D_PSO_FAILED) {
+        pthread_mutex_unlock(&cache->mutex);
+        return false;
+    }
+    cache->entries[index].state = D3D_PSO_COMPILING;
+    cache->stats.compiling++;
+    cache->stats.retries++;
+    pthread_mutex_unlock(&cache->mutex);
+    return true;
+}
+
+void d3d_pso_cache_flush(D3DPipelineCache *cache) {
+    if (!cache) {
+        return;
+    }
+    pthread_mutex_lock(&cache->mutex);
+    for (uint32_t i = 0; i < cache->capacity; i++) {
+        if (cache->entries[i].used && cache->entries[i].state != D3D_PSO_COMPILING) {
+            retire_entry(cache, (int32_t)i);
+        }
+    }
+    pthread_mutex_unlock(&cache->mutex);
+}
+
+void d3d_pso_cache_get_stats(D3DPipelineCache *cache, D3DPipelineCacheStats *stats) {
+    pthread_mutex_lock(&cache->mutex);
+    *stats = cache->stats;
+    pthread_mutex_unlock(&cache->mutex);
+}
@@ -0,0 +1,121 @@
+// D3DPipelineCache.h - 以渲染状态描述符哈希为键的管线状态对象（PSO）缓存
+// 纯C实现，与后端无关：描述符里的格式、混合因子等都是后端枚举值（Metal 下即 MTLPixelFormat 等），这里只做比较和哈希
+//   键：着色器ID + 顶点布局 + 混合/深度/光栅化状态 + 附件格式，64位哈希定位，完整描述符比较消除碰撞
+//   生命周期：未命中时登记为“编译中”并交给调用方在后台编译，完成后变为可用（或失败）；
+//             编译期间的查找返回“编译中”，绘制可以跳过或改用后备管线，不在渲染线程上等编译
+//   容量：超出后按LRU淘汰可用/失败条目，编译中的条目不淘汰
+// 所有函数都是线程安全的（编译完成回调在任意线程）
+#ifndef D3D_PIPELINE_CACHE_H
+#define D3D_PIPELINE_CACHE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define D3D_PSO_DEFAULT_CAPACITY        256
+#define D3D_PSO_MAX_COLOR_ATTACHMENTS   4
+#define D3D_PSO_MAX_VERTEX_ATTRIBUTES   16
+#define D3D_PSO_MAX_VERTEX_BUFFERS      8
+
+typedef struct D3DVertexAttribute {
+    uint8_t format;                         // 后端顶点格式
+    uint8_t buffer;                         // 顶点缓冲区序号
+    uint16_t offset;
+} D3DVertexAttribute;
+
+typedef struct D3DBlendState {
+    uint8_t enabled;
+    uint8_t src_rgb;
+    uint8_t dst_rgb;
+    uint8_t op_rgb;
+    uint8_t src_alpha;
+    uint8_t dst_alpha;
+    uint8_t op_alpha;
+    uint8_t write_mask;
+} D3DBlendState;
+
+// 只有前 attribute_count 个属性、前 buffer_count 个缓冲区、格式非0的颜色附件参与哈希和比较
+typedef struct D3DPipelineDesc {
+    uint64_t vertex_shader;                 // 着色器ID（源码或字节码的哈希）
+    uint64_t fragment_shader;
+    uint32_t attribute_count;
+    uint32_t buffer_count;
+    D3DVertexAttribute attributes[D3D_PSO_MAX_VERTEX_ATTRIBUTES];
+    uint32_t buffer_strides[D3D_PSO_MAX_VERTEX_BUFFERS];
+    uint8_t buffer_per_instance[D3D_PSO_MAX_VERTEX_BUFFERS];
+    uint32_t color_formats[D3D_PSO_MAX_COLOR_ATTACHMENTS];  // 0 表示未使用
+    D3DBlendState blend[D3D_PSO_MAX_COLOR_ATTACHMENTS];
+    uint32_t depth_stencil_format;
+    uint8_t depth_test;
+    uint8_t depth_write;
+    uint8_t depth_compare;
+    uint8_t stencil_enabled;
+    uint8_t cull_mode;
+    uint8_t fill_mode;
+    uint8_t front_counter_clockwise;
+    uint8_t topology_class;                 // 点/线/三角形
+    uint8_t sample_count;
+    uint8_t alpha_to_coverage;
+} D3DPipelineDesc;
+
+typedef enum D3DPipelineState {
+    D3D_PSO_MISS = 0,           // 刚登记为编译中：调用方负责编译并调用 d3d_pso_cache_complete
+    D3D_PSO_COMPILING = 1,      // 已有编译在进行（或缓存满且全部在编译），本次绘制跳过或用后备管线
+    D3D_PSO_READY = 2,
+    D3D_PSO_FAILED = 3          // 编译失败，查找不会自动重试；d3d_pso_cache_retry 显式重新编译
+} D3DPipelineState;
+
+typedef struct D3DPipelineCacheStats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t compiling_hits;    // 查找时管线仍在编译（被跳过或用了后备管线的绘制）
+    uint64_t failed_hits;
+    uint64_t compiled;
+    uint64_t compile_failures;
+    uint64_t retries;           // 失败条目被重新登记为编译中的次数
+    uint64_t evictions;
+    uint64_t collisions;        // 哈希相同但描述符不同
+    uint32_t entries;
+    uint32_t compiling;
+    uint32_t capacity;
+} D3DPipelineCacheStats;
+
+typedef struct D3DPipelineCache D3DPipelineCache;
+
+// 管线对象被淘汰或清空时调用（ObjC 后端在这里释放 __bridge_retained 的对象）
+typedef void (*D3DPipelineReleaseCallback)(void *pipeline, void *userdata);
+
+// 描述符哈希，结果非0；未使用的属性、缓冲区、附件中的残留值不影响结果
+uint64_t d3d_pipeline_desc_hash(const D3DPipelineDesc *desc);
+bool d3d_pipeline_desc_equal(const D3DPipelineDesc *a, const D3DPipelineDesc *b);
+
+D3DPipelineCache *d3d_pso_cache_create(uint32_t capacity);
+void d3d_pso_cache_destroy(D3DPipelineCache *cache);
+void d3d_pso_cache_set_release_callback(D3DPipelineCache *cache, D3DPipelineReleaseCallback callback,
+                                        void *userdata);
+
+// 按描述符查找，hash 为 d3d_pipeline_desc_hash 的结果（调用方在状态变化时算一次）
+// READY 时 *pipeline 为缓存的管线对象，使用期间不会被释放的保证由调用方负责（例如编码器持有引用）
+D3DPipelineState d3d_pso_cache_acquire(D3DPipelineCache *cache, const D3DPipelineDesc *desc, uint64_t hash,
+                                       void **pipeline);
+
+// 编译结束：pipeline 为NULL表示失败。找不到对应的编译中条目（重复完成）时返回false，pipeline 由调用方释放
+bool d3d_pso_cache_complete(D3DPipelineCache *cache, const D3DPipelineDesc *desc, uint64_t hash, void *pipeline);
+
+// 失败条目重新登记为编译中：返回true时调用方负责编译并调用 d3d_pso_cache_complete；
+// 条目不存在或不是失败状态（已被别人重试、已淘汰）时返回false
+bool d3d_pso_cache_retry(D3DPipelineCache *cache, const D3DPipelineDesc *desc, uint64_t hash);
+
+// 释放所有已完成的条目；编译中的条目保留，完成后照常登记
+void d3d_pso_cache_flush(D3DPipelineCache *cache);
+
+void d3d_pso_cache_get_stats(D3DPipelineCache *cache, D3DPipelineCacheStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // D3D_PIPELINE_CACHE_H
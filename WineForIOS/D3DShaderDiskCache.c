@@ -0,0 +1,530 @@
+// D3DShaderDiskCache.c - 着色器磁盘缓存实现
+// 文件布局：文件头 | 记录 | 记录 | ...，每条记录 = 记录头 + 源码 + 元数据，补齐到8字节
+// 内存索引为条目数组 + 线性探测哈希表（下标），压缩时整体重建
+#include "D3DShaderDiskCache.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define CACHE_FILE_MAGIC    0x3143444853443344ULL   // "D3DSHDC1"
+#define CACHE_FILE_FORMAT   1
+#define RECORD_MAGIC        0x43455253u             // "SREC"
+#define INITIAL_BUCKETS     64
+
+typedef struct CacheFileHeader {
+    uint64_t magic;
+    uint32_t format;
+    uint32_t reserved;
+} CacheFileHeader;
+
+typedef struct CacheRecordHeader {
+    uint32_t magic;
+    uint32_t checksum;                      // 覆盖键、长度和全部载荷
+    uint64_t key_lo;
+    uint64_t key_hi;
+    uint32_t source_size;
+    uint32_t reflection_size;
+} CacheRecordHeader;
+
+typedef struct CacheEntry {
+    D3DShaderKey key;
+    uint64_t offset;                        // 记录头在文件中的偏移
+    uint32_t source_size;
+    uint32_t reflection_size;
+    uint64_t last_used;
+} CacheEntry;
+
+struct D3DShaderDiskCache {
+    pthread_mutex_t mutex;
+    char *directory;
+    char *path;
+    char *temp_path;
+    int fd;
+    const uint8_t *map;
+    uint64_t map_size;
+    uint64_t file_size;
+    uint64_t max_bytes;
+    CacheEntry *entries;
+    uint32_t entry_capacity;
+    int32_t *buckets;
+    uint32_t bucket_mask;
+    uint64_t clock;                         // 最近使用计数
+    D3DShaderCacheStats stats;
+};
+
+// MARK: - 哈希
+
+static inline uint64_t mix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xFF51AFD7ED558CCDULL;
+    x ^= x >> 33;
+    x *= 0xC4CEB9FE1A85EC53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+static uint64_t hash_bytes(const void *data, size_t size, uint64_t seed) {
+    const uint8_t *bytes = data;
+    uint64_t hash = mix64(seed ^ (uint64_t)size * 0x9E3779B97F4A7C15ULL);
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, bytes + i, 8);
+        hash = mix64(hash ^ word) + 0x9E3779B97F4A7C15ULL;
+    }
+    uint64_t tail = 0;
+    if (size > i) {
+        memcpy(&tail, bytes + i, size - i);
+    }
+    return mix64(hash ^ tail ^ (uint64_t)(size - i) << 56);
+}
+
+D3DShaderKey d3d_shader_key(const void *bytecode, size_t size, uint32_t translator_version) {
+    D3DShaderKey key;
+    key.lo = hash_bytes(bytecode, size, 0x243F6A8885A308D3ULL ^ translator_version);
+    key.hi = hash_bytes(bytecode, size, 0x13198A2E03707344ULL + ((uint64_t)translator_version << 32));
+    return key;
+}
+
+static inline uint64_t record_size(uint32_t source_size, uint32_t reflection_size) {
+    return (sizeof(CacheRecordHeader) + (uint64_t)source_size + reflection_size + 7) & ~7ULL;
+}
+
+static uint32_t record_checksum(const CacheRecordHeader *header, const uint8_t *payload) {
+    const uint64_t seed = header->key_lo ^ mix64(header->key_hi) ^
+                          ((uint64_t)header->source_size << 32 | header->reflection_size);
+    const uint64_t hash = hash_bytes(payload, (size_t)header->source_size + header->reflection_size, seed);
+    return (uint32_t)(hash ^ hash >> 32);
+}
+
+// MARK: - 索引
+
+static int32_t index_find(const D3DShaderDiskCache *cache, D3DShaderKey key) {
+    uint32_t bucket = (uint32_t)key.lo & cache->bucket_mask;
+    for (;;) {
+        const int32_t index = cache->buckets[bucket];
+        if (index == -1) {
+            return -1;
+        }
+        const CacheEntry *entry = &cache->entries[index];
+        if (entry->key.lo == key.lo && entry->key.hi == key.hi) {
+            return index;
+        }
+        bucket = (bucket + 1) & cache->bucket_mask;
+    }
+}
+
+static bool index_rehash(D3DShaderDiskCache *cache, uint32_t bucket_count) {
+    int32_t *buckets = malloc(bucket_count * sizeof(int32_t));
+    if (!buckets) {
+        return false;
+    }
+    memset(buckets, 0xFF, bucket_count * sizeof(int32_t));
+    free(cache->buckets);
+    cache->buckets = buckets;
+    cache->bucket_mask = bucket_count - 1;
+    for (uint32_t i = 0; i < cache->stats.entries; i++) {
+        uint32_t bucket = (uint32_t)cache->entries[i].key.lo & cache->bucket_mask;
+        while (cache->buckets[bucket] != -1) {
+            bucket = (bucket + 1) & cache->bucket_mask;
+        }
+        cache->buckets[bucket] = (int32_t)i;
+    }
+    return true;
+}
+
+static void index_reset(D3DShaderDiskCache *cache) {
+    cache->stats.entries = 0;
+    cache->stats.live_bytes = 0;
+    memset(cache->buckets, 0xFF, (cache->bucket_mask + 1) * sizeof(int32_t));
+}
+
+// 同键的旧记录变成死数据，由下一次压缩回收
+static bool index_insert(D3DShaderDiskCache *cache, const CacheEntry *entry) {
+    const int32_t existing = index_find(cache, entry->key);
+    if (existing != -1) {
+        CacheEntry *old = &cache->entries[existing];
+        cache->stats.live_bytes -= record_size(old->source_size, old->reflection_size);
+        *old = *entry;
+        cache->stats.live_bytes += record_size(entry->source_size, entry->reflection_size);
+        return true;
+    }
+    if (cache->stats.entries == cache->entry_capacity) {
+        const uint32_t capacity = cache->entry_capacity ? cache->entry_capacity * 2 : INITIAL_BUCKETS / 2;
+        CacheEntry *entries = realloc(cache->entries, capacity * sizeof(CacheEntry));
+        if (!entries) {
+            return false;
+        }
+        cache->entries = entries;
+        cache->entry_capacity = capacity;
+    }
+    if ((cache->stats.entries + 1) * 2 > cache->bucket_mask + 1 &&
+        !index_rehash(cache, (cache->bucket_mask + 1) * 2)) {
+        return false;
+    }
+    const uint32_t index = cache->stats.entries++;
+    cache->entries[index] = *entry;
+    uint32_t bucket = (uint32_t)entry->key.lo & cache->bucket_mask;
+    while (cache->buckets[bucket] != -1) {
+        bucket = (bucket + 1) & cache->bucket_mask;
+    }
+    cache->buckets[bucket] = (int32_t)index;
+    cache->stats.live_bytes += record_size(entry->source_size, entry->reflection_size);
+    return true;
+}
+
+// MARK: - 文件
+
+static bool write_all(int fd, const void *data, size_t size, off_t offset) {
+    const uint8_t *bytes = data;
+    while (size > 0) {
+        const ssize_t written = pwrite(fd, bytes, size, offset);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        bytes += written;
+        offset += written;
+        size -= (size_t)written;
+    }
+    return true;
+}
+
+static void unmap_file(D3DShaderDiskCache *cache) {
+    if (cache->map) {
+        munmap((void *)cache->map, cache->map_size);
+        cache->map = NULL;
+        cache->map_size = 0;
+    }
+}
+
+static bool remap_file(D3DShaderDiskCache *cache) {
+    unmap_file(cache);
+    if (cache->file_size == 0) {
+        return true;
+    }
+    void *map = mmap(NULL, cache->file_size, PROT_READ, MAP_SHARED, cache->fd, 0);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+    cache->map = map;
+    cache->map_size = cache->file_size;
+    return true;
+}
+
+static bool reset_file(D3DShaderDiskCache *cache) {
+    const CacheFileHeader header = { .magic = CACHE_FILE_MAGIC, .format = CACHE_FILE_FORMAT };
+    if (ftruncate(cache->fd, 0) != 0 || !write_all(cache->fd, &header, sizeof(header), 0)) {
+        return false;
+    }
+    cache->file_size = sizeof(header);
+    return true;
+}
+
+// 扫描文件建立索引，截掉第一条无效记录及之后的内容
+static bool load_file(D3DShaderDiskCache *cache) {
+    unmap_file(cache);
+    index_reset(cache);
+
+    struct stat st;
+    if (fstat(cache->fd, &st) != 0) {
+        return false;
+    }
+    cache->file_size = (uint64_t)st.st_size;
+    if (!remap_file(cache)) {
+        return false;
+    }
+
+    CacheFileHeader header = { 0 };
+    if (cache->file_size >= sizeof(header)) {
+        memcpy(&header, cache->map, sizeof(header));
+    }
+    if (header.magic != CACHE_FILE_MAGIC || header.format != CACHE_FILE_FORMAT) {
+        // 空文件、格式版本不同或文件头损坏：整个重建
+        if (cache->file_size != 0) {
+            cache->stats.recovered_bytes += cache->file_size;
+        }
+        unmap_file(cache);
+        return reset_file(cache) && remap_file(cache);
+    }
+
+    uint64_t offset = sizeof(CacheFileHeader);
+    while (offset + sizeof(CacheRecordHeader) <= cache->file_size) {
+        CacheRecordHeader record;
+        memcpy(&record, cache->map + offset, sizeof(record));
+        if (record.magic != RECORD_MAGIC ||
+            (uint64_t)record.source_size + record.reflection_size > D3D_SHADER_CACHE_MAX_ENTRY) {
+            break;
+        }
+        const uint64_t size = record_size(record.source_size, record.reflection_size);
+        if (offset + size > cache->file_size ||
+            record_checksum(&record, cache->map + offset + sizeof(record)) != record.checksum) {
+            break;
+        }
+        const CacheEntry entry = {
+            .key = { record.key_lo, record.key_hi },
+            .offset = offset,
+            .source_size = record.source_size,
+            .reflection_size = record.reflection_size,
+            .last_used = ++cache->clock,
+        };
+        if (!index_insert(cache, &entry)) {
+            return false;
+        }
+        offset += size;
+    }
+
+    if (offset < cache->file_size) {
+        // 崩溃时写了一半的尾部（或损坏的记录）：丢掉，之后从这里继续追加
+        cache->stats.recovered_bytes += cache->file_size - offset;
+        unmap_file(cache);
+        if (ftruncate(cache->fd, (off_t)offset) != 0) {
+            return false;
+        }
+        cache->file_size = offset;
+        return remap_file(cache);
+    }
+    return true;
+}
+
+// MARK: - 打开与关闭
+
+static char *join_path(const char *directory, const char *name) {
+    const size_t length = strlen(directory) + strlen(name) + 2;
+    char *path = malloc(length);
+    if (path) {
+        snprintf(path, length, "%s/%s", directory, name);
+    }
+    return path;
+}
+
+D3DShaderDiskCache *d3d_shader_cache_open(const char *directory, uint64_t max_bytes) {
+    D3DShaderDiskCache *cache = calloc(1, sizeof(D3DShaderDiskCache));
+    if (!cache) {
+        return NULL;
+    }
+    cache->fd = -1;
+    cache->max_bytes = max_bytes ? max_bytes : D3D_SHADER_CACHE_DEFAULT_LIMIT;
+    cache->directory = strdup(directory);
+    cache->path = join_path(directory, D3D_SHADER_CACHE_FILE);
+    cache->temp_path = join_path(directory, D3D_SHADER_CACHE_FILE ".tmp");
+    cache->buckets = malloc(INITIAL_BUCKETS * sizeof(int32_t));
+    cache->bucket_mask = INITIAL_BUCKETS - 1;
+    if (!cache->directory || !cache->path || !cache->temp_path || !cache->buckets ||
+        pthread_mutex_init(&cache->mutex, NULL) != 0) {
+        free(cache->directory);
+        free(cache->path);
+        free(cache->temp_path);
+        free(cache->buckets);
+        free(cache);
+        return NULL;
+    }
+
+    cache->fd = open(cache->path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (cache->fd < 0 || !load_file(cache)) {
+        d3d_shader_cache_close(cache);
+        return NULL;
+    }
+    return cache;
+}
+
+void d3d_shader_cache_close(D3DShaderDiskCache *cache) {
+    if (!cache) {
+        return;
+    }
+    unmap_file(cache);
+    if (cache->fd >= 0) {
+        close(cache->fd);
+    }
+    pthread_mutex_destroy(&cache->mutex);
+    free(cache->entries);
+    free(cache->buckets);
+    free(cache->directory);
+    free(cache->path);
+    free(cache->temp_path);
+    free(cache);
+}
+
+// MARK: - 查找与写入
+
+bool d3d_shader_cache_lookup(D3DShaderDiskCache *cache, D3DShaderKey key, D3DShaderBlob *blob) {
+    pthread_mutex_lock(&cache->mutex);
+    const int32_t index = index_find(cache, key);
+    if (index == -1) {
+        cache->stats.misses++;
+        pthread_mutex_unlock(&cache->mutex);
+        return false;
+    }
+    CacheEntry *entry = &cache->entries[index];
+    if (entry->offset + record_size(entry->source_size, entry->reflection_size) > cache->map_size) {
+        cache->stats.misses++;                      // 重新映射失败过，按未命中处理
+        pthread_mutex_unlock(&cache->mutex);
+        return false;
+    }
+    const uint8_t *payload = cache->map + entry->offset + sizeof(CacheRecordHeader);
+    blob->source = (const char *)payload;
+    blob->source_size = entry->source_size;
+    blob->reflection = payload + entry->source_size;
+    blob->reflection_size = entry->reflection_size;
+    entry->last_used = ++cache->clock;
+    cache->stats.hits++;
+    pthread_mutex_unlock(&cache->mutex);
+    return true;
+}
+
+static int compare_last_used(const void *a, const void *b) {
+    const uint64_t left = ((const CacheEntry *)a)->last_used;
+    const uint64_t right = ((const CacheEntry *)b)->last_used;
+    return left < right ? -1 : left > right;
+}
+
+static void sync_directory(const char *directory) {
+    const int fd = open(directory, O_RDONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+}
+
+// 持有 mutex：把最近使用的条目按使用先后写入临时文件，fsync 后替换原文件，再重新加载索引
+static bool compact_locked(D3DShaderDiskCache *cache, uint64_t target_bytes) {
+    const uint32_t count = cache->stats.entries;
+    CacheEntry *order = malloc((count ? count : 1) * sizeof(CacheEntry));
+    if (!order) {
+        return false;
+    }
+    memcpy(order, cache->entries, count * sizeof(CacheEntry));
+    qsort(order, count, sizeof(CacheEntry), compare_last_used);
+
+    // 从最近使用的一端往回累计，放不下的更旧条目全部淘汰
+    uint64_t kept_bytes = sizeof(CacheFileHeader);
+    uint32_t first_kept = count;
+    while (first_kept > 0) {
+        const CacheEntry *entry = &order[first_kept - 1];
+        const uint64_t size = record_size(entry->source_size, entry->reflection_size);
+        if (kept_bytes + size > target_bytes) {
+            break;
+        }
+        kept_bytes += size;
+        first_kept--;
+    }
+
+    const int fd = open(cache->temp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    bool ok = fd >= 0;
+    const CacheFileHeader header = { .magic = CACHE_FILE_MAGIC, .format = CACHE_FILE_FORMAT };
+    uint64_t offset = sizeof(header);
+    ok = ok && write_all(fd, &header, sizeof(header), 0);
+    for (uint32_t i = first_kept; ok && i < count; i++) {
+        const uint64_t size = record_size(order[i].source_size, order[i].reflection_size);
+        ok = write_all(fd, cache->map + order[i].offset, (size_t)size, (off_t)offset);
+        offset += size;
+    }
+    ok = ok && fsync(fd) == 0;
+    if (fd >= 0) {
+        close(fd);
+    }
+    free(order);
+    if (!ok || rename(cache->temp_path, cache->path) != 0) {
+        unlink(cache->temp_path);
+        return false;
+    }
+    sync_directory(cache->directory);
+
+    // 旧文件已被替换，换到新文件上重建索引（文件顺序即使用先后）
+    const int new_fd = open(cache->path, O_RDWR | O_CLOEXEC);
+    if (new_fd < 0) {
+        return false;
+    }
+    unmap_file(cache);
+    close(cache->fd);
+    cache->fd = new_fd;
+    cache->stats.evictions += first_kept;
+    cache->stats.compactions++;
+    return load_file(cache);
+}
+
+bool d3d_shader_cache_store(D3DShaderDiskCache *cache, D3DShaderKey key, const char *source, uint32_t source_size,
+                            const void *reflection, uint32_t reflection_size) {
+    if ((uint64_t)source_size + reflection_size > D3D_SHADER_CACHE_MAX_ENTRY) {
+        return false;
+    }
+
+    pthread_mutex_lock(&cache->mutex);
+    if (index_find(cache, key) != -1) {
+        pthread_mutex_unlock(&cache->mutex);
+        return true;
+    }
+
+    const uint64_t size = record_size(source_size, reflection_size);
+    uint8_t *record = calloc(1, (size_t)size);
+    bool ok = record != NULL;
+    if (ok) {
+        CacheRecordHeader header = {
+            .magic = RECORD_MAGIC,
+            .key_lo = key.lo,
+            .key_hi = key.hi,
+            .source_size = source_size,
+            .reflection_size = reflection_size,
+        };
+        uint8_t *payload = record + sizeof(header);
+        if (source_size) {
+            memcpy(payload, source, source_size);
+        }
+        if (reflection_size) {
+            memcpy(payload + source_size, reflection, reflection_size);
+        }
+        header.checksum = record_checksum(&header, payload);
+        memcpy(record, &header, sizeof(header));
+
+        // 只在文件末尾追加；写失败时截回原长度，已有记录不受影响
+        const uint64_t offset = cache->file_size;
+        ok = write_all(cache->fd, record, (size_t)size, (off_t)offset);
+        if (ok) {
+            cache->file_size += size;
+            const CacheEntry entry = {
+                .key = key,
+                .offset = offset,
+                .source_size = source_size,
+                .reflection_size = reflection_size,
+                .last_used = ++cache->clock,
+            };
+            ok = remap_file(cache) && index_insert(cache, &entry);
+        } else if (ftruncate(cache->fd, (off_t)offset) == 0) {
+            cache->file_size = offset;
+        }
+        free(record);
+    }
+
+    if (ok) {
+        cache->stats.stores++;
+        if (cache->file_size > cache->max_bytes) {
+            compact_locked(cache, cache->max_bytes / 4 * 3);
+        }
+    } else {
+        cache->stats.store_failures++;
+    }
+    pthread_mutex_unlock(&cache->mutex);
+    return ok;
+}
+
+bool d3d_shader_cache_compact(D3DShaderDiskCache *cache, uint64_t target_bytes) {
+    pthread_mutex_lock(&cache->mutex);
+    const bool ok = compact_locked(cache, target_bytes);
+    pthread_mutex_unlock(&cache->mutex);
+    return ok;
+}
+
+void d3d_shader_cache_get_stats(D3DShaderDiskCache *cache, D3DShaderCacheStats *stats) {
+    pthread_mutex_lock(&cache->mutex);
+    *stats = cache->stats;
+    stats->file_bytes = cache->file_size;
+    pthread_mutex_unlock(&cache->mutex);
+}
@@ -0,0 +1,74 @@
+// D3DShaderDiskCache.h - 跨启动的着色器翻译结果磁盘缓存（DXBC → MSL）
+// 纯C实现，以内容寻址：键是着色器字节码 + 翻译器版本的128位哈希，值是翻译出的源码和反射元数据
+//   存储：目录下一个只追加的记录文件，每条记录带校验和；打开时顺序扫描建立内存索引，
+//         遇到第一条不完整或校验失败的记录就截断（崩溃时最多丢掉最后写了一半的记录）
+//   读取：整个文件 mmap 只读映射，查找直接返回映射内的指针，不复制
+//   容量：文件超过上限时压缩——按最近使用顺序保留条目直到上限的3/4，写入临时文件后原子 rename；
+//         压缩后的文件按使用先后排列，下次启动以文件顺序作为初始的LRU顺序
+// 所有函数都是线程安全的
+#ifndef D3D_SHADER_DISK_CACHE_H
+#define D3D_SHADER_DISK_CACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define D3D_SHADER_CACHE_FILE           "shaders.cache"
+#define D3D_SHADER_CACHE_DEFAULT_LIMIT  (64ULL * 1024 * 1024)
+#define D3D_SHADER_CACHE_MAX_ENTRY      (16u * 1024 * 1024)     // 单条记录的源码 + 元数据上限
+
+typedef struct D3DShaderKey {
+    uint64_t lo;
+    uint64_t hi;
+} D3DShaderKey;
+
+// 查找结果指向映射内的数据，在同一缓存的下一次 store / compact / close 之前有效
+typedef struct D3DShaderBlob {
+    const char *source;                     // 不保证以 '\0' 结尾
+    uint32_t source_size;
+    const void *reflection;
+    uint32_t reflection_size;
+} D3DShaderBlob;
+
+typedef struct D3DShaderCacheStats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t stores;
+    uint64_t store_failures;
+    uint64_t evictions;                     // 压缩时丢弃的条目
+    uint64_t compactions;
+    uint64_t recovered_bytes;               // 打开时截掉的不完整尾部
+    uint64_t file_bytes;
+    uint64_t live_bytes;                    // 仍被索引引用的记录字节数
+    uint32_t entries;
+} D3DShaderCacheStats;
+
+typedef struct D3DShaderDiskCache D3DShaderDiskCache;
+
+// 翻译器输出格式变化时调高 translator_version，旧条目自然不再命中，随LRU淘汰
+D3DShaderKey d3d_shader_key(const void *bytecode, size_t size, uint32_t translator_version);
+
+// 打开（不存在时创建）directory 下的缓存文件，directory 本身必须已存在；max_bytes 为0时用默认上限
+D3DShaderDiskCache *d3d_shader_cache_open(const char *directory, uint64_t max_bytes);
+void d3d_shader_cache_close(D3DShaderDiskCache *cache);
+
+bool d3d_shader_cache_lookup(D3DShaderDiskCache *cache, D3DShaderKey key, D3DShaderBlob *blob);
+
+// 追加一条记录；键已存在时直接返回true（内容寻址，同键同内容）
+bool d3d_shader_cache_store(D3DShaderDiskCache *cache, D3DShaderKey key, const char *source, uint32_t source_size,
+                            const void *reflection, uint32_t reflection_size);
+
+// 按LRU压缩到 target_bytes 以内（store 超过上限时自动调用）
+bool d3d_shader_cache_compact(D3DShaderDiskCache *cache, uint64_t target_bytes);
+
+void d3d_shader_cache_get_stats(D3DShaderDiskCache *cache, D3DShaderCacheStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // D3D_SHADER_DISK_CACHE_H
@@ -1,5 +1,7 @@
 // EnhancedBox64Instructions.m - 实现
 #import "EnhancedBox64Instructions.h"
+#import "Box64Flags.h"
+#import "Box64Trace.h"
 
 @implementation EnhancedBox64Instructions
 
@@ -267,7 +269,7 @@
             return [self generateARM64Interrupt:x86Instruction];
             
         default:
-            NSLog(@"[EnhancedBox64Instructions] Unsupported instruction type: %lu", (unsigned long)x86Instruction.type);
+            B64LogWarn(BOX64_LOG_EXEC, @"[EnhancedBox64Instructions] Unsupported instruction type: %lu", (unsigned long)x86Instruction.type);
             return @[@(0xD503201F)];  // NOP as fallback
     }
 }
@@ -393,25 +395,16 @@
     return ARM64_X0;  // 默认值
 }
 
+// 兼容旧接口：只记录惰性标志，读取时再计算（见 Box64Flags.h）
+// 旧实现按32位结果判断SF，加法的CF以RAX为被加数，这里保持相同的解释
 + (void)updateFlags:(Box64Context *)context result:(uint64_t)result operation:(NSString *)operation {
     if (!context) return;
     
-    // 更新RFLAGS
-    context->rflags &= ~0x8D5;  // 清除相关标志位
-    
-    // Zero Flag (ZF)
-    if (result == 0) {
-        context->rflags |= 0x40;
-    }
-    
-    // Sign Flag (SF)
-    if (result & 0x80000000) {
-        context->rflags |= 0x80;
-    }
-    
-    // Carry Flag (CF) - 简化实现
-    if ([operation isEqualToString:@"add"] && result < context->x86_regs[X86_RAX]) {
-        context->rflags |= 0x01;
+    if ([operation isEqualToString:@"add"]) {
+        uint64_t dst = context->x86_regs[X86_RAX];
+        box64_flags_record(context, BOX64_FLAGS_ADD, dst, result - dst, result, 4);
+    } else {
+        box64_flags_record(context, BOX64_FLAGS_LOGIC, 0, 0, result, 4);
     }
 }
 
@@ -437,7 +430,8 @@
         return NO;
     }
     
-    return (address + size) <= context->memory_size;
+    // 与引擎共用页表：每一页都已映射且可读
+    return box64_mmu_check(&context->mmu, address, size, BOX64_ACCESS_READ);
 }
 
 @end
@@ -3,6 +3,7 @@
 #import <Metal/Metal.h>
 #import <QuartzCore/QuartzCore.h>
 #import "MoltenVKBridge.h"
+#import "D3DPipelineCache.h"
 
 NS_ASSUME_NONNULL_BEGIN
 
@@ -41,9 +42,21 @@ typedef struct DXVKCommandMapping {
 - (void)setViewport:(CGRect)viewport;
 - (void)clearRenderTarget:(UIColor *)color;
 
-// 着色器管理
-- (id<MTLRenderPipelineState>)createPipelineWithVertexShader:(NSString *)vertexSource
-                                              fragmentShader:(NSString *)fragmentSource;
+// 着色器管理（入口函数名为 vertex_main / fragment_main）
+// 管线按描述符哈希缓存（LRU），同一组着色器和状态只编译一次
+// 同步接口：未命中时在调用线程编译，用于启动时预热，不要在绘制路径上调用；
+// 同一管线正在别处编译时等它完成，之前编译失败的管线在这里重新编译一次
+- (nullable id<MTLRenderPipelineState>)createPipelineWithVertexShader:(NSString *)vertexSource
+                                                       fragmentShader:(NSString *)fragmentSource;
+// 绘制路径：未命中时在后台队列编译，编译完成前返回 fallback（nil 表示调用方跳过这次绘制），不阻塞渲染线程
+// 描述符中的着色器ID由源码计算后覆盖
+- (nullable id<MTLRenderPipelineState>)pipelineForDescriptor:(const D3DPipelineDesc *)descriptor
+                                                vertexShader:(NSString *)vertexSource
+                                              fragmentShader:(NSString *)fragmentSource
+                                                    fallback:(nullable id<MTLRenderPipelineState>)fallback;
++ (uint64_t)shaderIdentifierForSource:(NSString *)source;
+- (void)flushPipelineCache;
+- (NSDictionary *)getPipelineCacheStatistics;
 
 
 NS_ASSUME_NONNULL_END
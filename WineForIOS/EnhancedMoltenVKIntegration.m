@@ -1,7 +1,26 @@
 // EnhancedMoltenVKIntegration.m - 实现
 #import "EnhancedMoltenVKIntegration.h"
 
-@implementation EnhancedMoltenVKIntegration
+#define PIPELINE_CACHE_CAPACITY     512
+#define PIPELINE_SYNC_WAIT_SECONDS  5       // 同步接口等编译中条目的上限
+
+// 缓存淘汰或清空时释放 __bridge_retained 的管线对象
+static void EnhancedPipelineRelease(void *pipeline, void *userdata) {
+    (void)userdata;
+    (void)CFBridgingRelease(pipeline);
+}
+
+@implementation EnhancedMoltenVKIntegration {
+    // 管线缓存：查找与取得引用都在 _pipelineLock 内，淘汰只会发生在查找中，取到的对象不会被提前释放
+    // 每次编译完成（内联或后台）都在 _pipelineLock 上广播，同步接口在它上面等编译中的条目
+    D3DPipelineCache *_pipelineCache;
+    NSCondition *_pipelineLock;
+    dispatch_queue_t _pipelineCompileQueue;
+    dispatch_group_t _pipelineCompileGroup;
+    NSMutableDictionary<NSNumber *, id<MTLFunction>> *_shaderFunctions;    // 着色器ID → 已编译函数
+    uint64_t _fallbackDraws;
+    uint64_t _skippedDraws;
+}
 
 + (instancetype)sharedIntegration {
     static EnhancedMoltenVKIntegration *shared = nil;
@@ -20,11 +39,25 @@
         _commandQueue = [_metalDevice newCommandQueue];
         _isRenderingActive = NO;
         
+        _pipelineCache = d3d_pso_cache_create(PIPELINE_CACHE_CAPACITY);
+        d3d_pso_cache_set_release_callback(_pipelineCache, EnhancedPipelineRelease, NULL);
+        _pipelineLock = [[NSCondition alloc] init];
+        _pipelineCompileQueue = dispatch_queue_create("com.wineforios.graphics.pipeline-compile",
+                                                      dispatch_queue_attr_make_with_qos_class(DISPATCH_QUEUE_CONCURRENT,
+                                                                                              QOS_CLASS_USER_INITIATED, 0));
+        _pipelineCompileGroup = dispatch_group_create();
+        _shaderFunctions = [NSMutableDictionary dictionary];
+        
         [self setupDirectXMappings];
     }
     return self;
 }
 
+- (void)dealloc {
+    dispatch_group_wait(_pipelineCompileGroup, DISPATCH_TIME_FOREVER);
+    d3d_pso_cache_destroy(_pipelineCache);
+}
+
 - (BOOL)initializeWithOutputView:(UIView *)outputView {
     NSLog(@"[EnhancedMoltenVK] Initializing complete graphics pipeline...");
     
@@ -94,28 +127,256 @@
     }
 }
 
-- (id<MTLRenderPipelineState>)createPipelineWithVertexShader:(NSString *)vertexSource
-                                              fragmentShader:(NSString *)fragmentSource {
-    NSError *error = nil;
+#pragma mark - 管线缓存
+
++ (uint64_t)shaderIdentifierForSource:(NSString *)source {
+    // FNV-1a 64
+    const char *bytes = source.UTF8String;
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for (const char *p = bytes; p && *p; p++) {
+        hash = (hash ^ (uint8_t)*p) * 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+// 着色器按ID缓存，多个管线共用同一份已编译函数
+- (nullable id<MTLFunction>)shaderFunction:(NSString *)name source:(NSString *)source identifier:(uint64_t)identifier {
+    NSNumber *key = @(identifier);
     
-    id<MTLLibrary> library = [_metalDevice newLibraryWithSource:vertexSource options:nil error:&error];
+    [_pipelineLock lock];
+    id<MTLFunction> function = _shaderFunctions[key];
+    [_pipelineLock unlock];
+    if (function) {
+        return function;
+    }
+    
+    NSError *error = nil;
+    id<MTLLibrary> library = [_metalDevice newLibraryWithSource:source options:nil error:&error];
     if (!library) {
-        NSLog(@"[EnhancedMoltenVK] Failed to create vertex library: %@", error);
+        NSLog(@"[EnhancedMoltenVK] Failed to create %@ library: %@", name, error);
+        return nil;
+    }
+    function = [library newFunctionWithName:name];
+    if (!function) {
+        NSLog(@"[EnhancedMoltenVK] Shader has no function named %@", name);
         return nil;
     }
     
-    id<MTLLibrary> fragmentLibrary = [_metalDevice newLibraryWithSource:fragmentSource options:nil error:&error];
-    if (!fragmentLibrary) {
-        NSLog(@"[EnhancedMoltenVK] Failed to create fragment library: %@", error);
+    [_pipelineLock lock];
+    _shaderFunctions[key] = function;
+    [_pipelineLock unlock];
+    return function;
+}
+
+// 编译一个管线，可在任意线程调用
+- (nullable id<MTLRenderPipelineState>)compilePipeline:(const D3DPipelineDesc *)desc
+                                          vertexSource:(NSString *)vertexSource
+                                        fragmentSource:(NSString *)fragmentSource {
+    id<MTLFunction> vertexFunction = [self shaderFunction:@"vertex_main" source:vertexSource identifier:desc->vertex_shader];
+    id<MTLFunction> fragmentFunction = [self shaderFunction:@"fragment_main" source:fragmentSource
+                                                 identifier:desc->fragment_shader];
+    if (!vertexFunction || !fragmentFunction) {
         return nil;
     }
     
     MTLRenderPipelineDescriptor *pipelineDesc = [[MTLRenderPipelineDescriptor alloc] init];
-    pipelineDesc.vertexFunction = [library newFunctionWithName:@"vertex_main"];
-    pipelineDesc.fragmentFunction = [fragmentLibrary newFunctionWithName:@"fragment_main"];
-    pipelineDesc.colorAttachments[0].pixelFormat = MTLPixelFormatBGRA8Unorm;
+    pipelineDesc.vertexFunction = vertexFunction;
+    pipelineDesc.fragmentFunction = fragmentFunction;
     
-    return [_metalDevice newRenderPipelineStateWithDescriptor:pipelineDesc error:&error];
+    for (uint32_t i = 0; i < D3D_PSO_MAX_COLOR_ATTACHMENTS; i++) {
+        if (desc->color_formats[i] == 0) continue;
+        
+        const D3DBlendState *blend = &desc->blend[i];
+        MTLRenderPipelineColorAttachmentDescriptor *attachment = pipelineDesc.colorAttachments[i];
+        attachment.pixelFormat = (MTLPixelFormat)desc->color_formats[i];
+        attachment.writeMask = (MTLColorWriteMask)blend->write_mask;
+        attachment.blendingEnabled = blend->enabled != 0;
+        if (blend->enabled) {
+            attachment.sourceRGBBlendFactor = (MTLBlendFactor)blend->src_rgb;
+            attachment.destinationRGBBlendFactor = (MTLBlendFactor)blend->dst_rgb;
+            attachment.rgbBlendOperation = (MTLBlendOperation)blend->op_rgb;
+            attachment.sourceAlphaBlendFactor = (MTLBlendFactor)blend->src_alpha;
+            attachment.destinationAlphaBlendFactor = (MTLBlendFactor)blend->dst_alpha;
+            attachment.alphaBlendOperation = (MTLBlendOperation)blend->op_alpha;
+        }
+    }
+    
+    pipelineDesc.depthAttachmentPixelFormat = (MTLPixelFormat)desc->depth_stencil_format;
+    if (desc->stencil_enabled) {
+        pipelineDesc.stencilAttachmentPixelFormat = (MTLPixelFormat)desc->depth_stencil_format;
+    }
+    pipelineDesc.rasterSampleCount = desc->sample_count ? desc->sample_count : 1;
+    pipelineDesc.alphaToCoverageEnabled = desc->alpha_to_coverage != 0;
+    pipelineDesc.inputPrimitiveTopology = (MTLPrimitiveTopologyClass)desc->topology_class;
+    
+    if (desc->attribute_count > 0) {
+        MTLVertexDescriptor *vertexDesc = [MTLVertexDescriptor vertexDescriptor];
+        for (uint32_t i = 0; i < desc->attribute_count && i < D3D_PSO_MAX_VERTEX_ATTRIBUTES; i++) {
+            vertexDesc.attributes[i].format = (MTLVertexFormat)desc->attributes[i].format;
+            vertexDesc.attributes[i].offset = desc->attributes[i].offset;
+            vertexDesc.attributes[i].bufferIndex = desc->attributes[i].buffer;
+        }
+        for (uint32_t i = 0; i < desc->buffer_count && i < D3D_PSO_MAX_VERTEX_BUFFERS; i++) {
+            vertexDesc.layouts[i].stride = desc->buffer_strides[i];
+            vertexDesc.layouts[i].stepFunction = desc->buffer_per_instance[i] ? MTLVertexStepFunctionPerInstance
+                                                                               : MTLVertexStepFunctionPerVertex;
+        }
+        pipelineDesc.vertexDescriptor = vertexDesc;
+    }
+    
+    NSError *error = nil;
+    id<MTLRenderPipelineState> pipeline = [_metalDevice newRenderPipelineStateWithDescriptor:pipelineDesc error:&error];
+    if (!pipeline) {
+        NSLog(@"[EnhancedMoltenVK] Failed to create render pipeline: %@", error);
+    }
+    return pipeline;
+}
+
+// 填入着色器ID，并清掉Metal中属于编码器动态状态的字段（深度比较、剔除、填充），
+// 否则只差这些状态的描述符会各编译一份相同的PSO
+- (void)prepareDescriptor:(D3DPipelineDesc *)desc vertexSource:(NSString *)vertexSource
+           fragmentSource:(NSString *)fragmentSource {
+    desc->vertex_shader = [EnhancedMoltenVKIntegration shaderIdentifierForSource:vertexSource];
+    desc->fragment_shader = [EnhancedMoltenVKIntegration shaderIdentifierForSource:fragmentSource];
+    desc->depth_test = 0;
+    desc->depth_write = 0;
+    desc->depth_compare = 0;
+    desc->cull_mode = 0;
+    desc->fill_mode = 0;
+    desc->front_counter_clockwise = 0;
+}
+
+// 编译结果登记进缓存，缓存持有一个引用；唤醒等这个条目的同步调用
+- (void)finishPipeline:(nullable id<MTLRenderPipelineState>)pipeline descriptor:(const D3DPipelineDesc *)desc
+                  hash:(uint64_t)hash {
+    void *retained = pipeline ? (__bridge_retained void *)pipeline : NULL;
+    [_pipelineLock lock];
+    const bool registered = d3d_pso_cache_complete(_pipelineCache, desc, hash, retained);
+    [_pipelineLock broadcast];
+    [_pipelineLock unlock];
+    if (!registered && retained) {
+        (void)CFBridgingRelease(retained);
+    }
+}
+
+- (nullable id<MTLRenderPipelineState>)createPipelineWithVertexShader:(NSString *)vertexSource
+                                                       fragmentShader:(NSString *)fragmentSource {
+    D3DPipelineDesc desc;
+    memset(&desc, 0, sizeof(desc));
+    desc.color_formats[0] = MTLPixelFormatBGRA8Unorm;
+    desc.blend[0].write_mask = MTLColorWriteMaskAll;
+    desc.sample_count = 1;
+    desc.topology_class = MTLPrimitiveTopologyClassTriangle;
+    [self prepareDescriptor:&desc vertexSource:vertexSource fragmentSource:fragmentSource];
+    const uint64_t hash = d3d_pipeline_desc_hash(&desc);
+    
+    NSDate *deadline = [NSDate dateWithTimeIntervalSinceNow:PIPELINE_SYNC_WAIT_SECONDS];
+    void *cached = NULL;
+    id<MTLRenderPipelineState> pipeline = nil;
+    
+    [_pipelineLock lock];
+    D3DPipelineState state = d3d_pso_cache_acquire(_pipelineCache, &desc, hash, &cached);
+    // 同一管线正在编译（另一个同步调用的内联编译或后台编译）：每次有编译完成就重新查一次，直到它不再是编译中
+    while (state == D3D_PSO_COMPILING && [_pipelineLock waitUntilDate:deadline]) {
+        state = d3d_pso_cache_acquire(_pipelineCache, &desc, hash, &cached);
+    }
+    // 同步接口是显式请求：之前失败的管线重新编译一次（绘制路径不重试，避免每帧重编失败的管线）
+    if (state == D3D_PSO_FAILED && d3d_pso_cache_retry(_pipelineCache, &desc, hash)) {
+        state = D3D_PSO_MISS;
+    }
+    if (state == D3D_PSO_READY) {
+        pipeline = (__bridge id<MTLRenderPipelineState>)cached;
+    }
+    [_pipelineLock unlock];
+    
+    switch (state) {
+        case D3D_PSO_READY:
+            return pipeline;
+        case D3D_PSO_FAILED:
+            return nil;
+        case D3D_PSO_MISS:
+            pipeline = [self compilePipeline:&desc vertexSource:vertexSource fragmentSource:fragmentSource];
+            [self finishPipeline:pipeline descriptor:&desc hash:hash];
+            return pipeline;
+        case D3D_PSO_COMPILING:
+            break;
+    }
+    
+    NSLog(@"[EnhancedMoltenVK] Timed out waiting for pipeline compilation");
+    return nil;
+}
+
+- (nullable id<MTLRenderPipelineState>)pipelineForDescriptor:(const D3DPipelineDesc *)descriptor
+                                                vertexShader:(NSString *)vertexSource
+                                              fragmentShader:(NSString *)fragmentSource
+                                                    fallback:(nullable id<MTLRenderPipelineState>)fallback {
+    D3DPipelineDesc desc = *descriptor;
+    [self prepareDescriptor:&desc vertexSource:vertexSource fragmentSource:fragmentSource];
+    const uint64_t hash = d3d_pipeline_desc_hash(&desc);
+    
+    void *cached = NULL;
+    id<MTLRenderPipelineState> pipeline = nil;
+    
+    [_pipelineLock lock];
+    const D3DPipelineState state = d3d_pso_cache_acquire(_pipelineCache, &desc, hash, &cached);
+    if (state == D3D_PSO_READY) {
+        pipeline = (__bridge id<MTLRenderPipelineState>)cached;
+    } else if (fallback) {
+        _fallbackDraws++;
+    } else {
+        _skippedDraws++;
+    }
+    [_pipelineLock unlock];
+    
+    if (state == D3D_PSO_MISS) {
+        // 后台编译，渲染线程这一帧先用后备管线或跳过
+        NSString *vertexCopy = [vertexSource copy];
+        NSString *fragmentCopy = [fragmentSource copy];
+        dispatch_group_async(_pipelineCompileGroup, _pipelineCompileQueue, ^{
+            @autoreleasepool {
+                id<MTLRenderPipelineState> compiled = [self compilePipeline:&desc vertexSource:vertexCopy
+                                                             fragmentSource:fragmentCopy];
+                [self finishPipeline:compiled descriptor:&desc hash:hash];
+            }
+        });
+    }
+    
+    return pipeline ?: fallback;
+}
+
+- (void)flushPipelineCache {
+    [_pipelineLock lock];
+    d3d_pso_cache_flush(_pipelineCache);
+    [_shaderFunctions removeAllObjects];
+    [_pipelineLock unlock];
+    
+    NSLog(@"[EnhancedMoltenVK] Pipeline cache flushed");
+}
+
+- (NSDictionary *)getPipelineCacheStatistics {
+    D3DPipelineCacheStats stats;
+    d3d_pso_cache_get_stats(_pipelineCache, &stats);
+    
+    [_pipelineLock lock];
+    NSDictionary *result = @{
+        @"entries": @(stats.entries),
+        @"capacity": @(stats.capacity),
+        @"compiling": @(stats.compiling),
+        @"hits": @(stats.hits),
+        @"misses": @(stats.misses),
+        @"compiling_hits": @(stats.compiling_hits),
+        @"failed_hits": @(stats.failed_hits),
+        @"compiled": @(stats.compiled),
+        @"compile_failures": @(stats.compile_failures),
+        @"retries": @(stats.retries),
+        @"evictions": @(stats.evictions),
+        @"collisions": @(stats.collisions),
+        @"shader_functions": @(_shaderFunctions.count),
+        @"fallback_draws": @(_fallbackDraws),
+        @"skipped_draws": @(_skippedDraws)
+    };
+    [_pipelineLock unlock];
+    return result;
 }
 
 - (void)setupDirectXInterception {
@@ -204,6 +465,11 @@
 - (void)shutdown {
     NSLog(@"[EnhancedMoltenVK] Shutting down graphics pipeline...");
     _isRenderingActive = NO;
+    
+    // 等后台编译结束再释放缓存中的管线
+    dispatch_group_wait(_pipelineCompileGroup, DISPATCH_TIME_FOREVER);
+    [self flushPipelineCache];
+    
     [_bridge cleanup];
 }
 
@@ -1,6 +1,7 @@
 // ExecutionEngine.m - 修复版本，移除NSTask (iOS不支持)
 #import "ExecutionEngine.h"
 #import "WineLibraryManager.h"
+#import "MoltenVKBridge.h"
 
 @interface ExecutionEngine()
 @property (nonatomic, strong) WineContainer *container;
@@ -204,6 +205,9 @@
         return NO;
     }
     
+    // 着色器翻译缓存放在前缀目录下，随容器保存；打不开只是每次都重新翻译
+    [[MoltenVKBridge sharedBridge].translator openShaderCacheInPrefix:self.container.winePrefixPath];
+    
     // 设置额外的环境变量
     setenv("WINEARCH", "win64", 1);
     setenv("WINELOADER", "/usr/bin/wine", 1);
@@ -1,6 +1,9 @@
 // ExtendedInstructionProcessor.h - 扩展指令处理器
 #import <Foundation/Foundation.h>
 #import "EnhancedBox64Instructions.h"
+#import "Box64SSE.h"
+#import "Box64String.h"
+#import "Box64X87.h"
 
 NS_ASSUME_NONNULL_BEGIN
 
@@ -67,14 +70,14 @@ typedef NS_ENUM(NSUInteger, ExtendedX86InstructionType) {
                             length:(size_t)length
                            context:(Box64Context *)context;
 
-// 浮点运算处理
-- (BOOL)processFloatingPointInstruction:(X86ExtendedInstruction)instr context:(Box64Context *)context;
+// x87浮点指令处理（由 Box64X87 执行；insn 的 RIP 相对寻址以 context->rip 为指令地址）
+- (BOOL)processFloatingPointInstruction:(const X86DecodedInsn *)insn context:(Box64Context *)context;
 
-// SIMD指令处理
-- (BOOL)processSIMDInstruction:(X86ExtendedInstruction)instr context:(Box64Context *)context;
+// SIMD指令处理（SSE/SSE2，由 Box64SSE 执行；insn 的 RIP 相对寻址以 context->rip 为指令地址）
+- (BOOL)processSIMDInstruction:(const X86DecodedInsn *)insn context:(Box64Context *)context;
 
-// 字符串操作处理
-- (BOOL)processStringInstruction:(X86ExtendedInstruction)instr context:(Box64Context *)context;
+// 字符串操作处理（MOVS/CMPS/STOS/LODS/SCAS 及 REP 形式，由 Box64String 整段执行）
+- (BOOL)processStringInstruction:(const X86DecodedInsn *)insn context:(Box64Context *)context;
 
 // 位操作处理
 - (BOOL)processBitInstruction:(X86ExtendedInstruction)instr context:(Box64Context *)context;
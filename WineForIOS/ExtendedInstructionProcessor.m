@@ -1,4 +1,6 @@
 #import "ExtendedInstructionProcessor.h"
+#import "Box64Flags.h"
+#import "Box64Trace.h"
 
 @implementation ExtendedInstructionProcessor
 
@@ -15,43 +17,31 @@
                             length:(size_t)length
                            context:(Box64Context *)context {
     
+    // SSE/SSE2 先按强制前缀分类，交给 Box64SSE；D8-DF / FWAIT 交给 Box64X87；字符串指令交给 Box64String
+    X86DecodedInsn insn;
+    if (x86_decode(instruction, length, &insn) == X86_DECODE_OK) {
+        if (box64_sse_classify(&insn) != BOX64_SSE_NONE) {
+            return [self processSIMDInstruction:&insn context:context];
+        }
+        if (box64_x87_supported(&insn)) {
+            return [self processFloatingPointInstruction:&insn context:context];
+        }
+        if (box64_string_supported(&insn)) {
+            return [self processStringInstruction:&insn context:context];
+        }
+    }
+    
     X86ExtendedInstruction decoded = [EnhancedBox64Instructions decodeInstruction:instruction maxLength:length];
     
     if (decoded.length == 0) {
-        NSLog(@"[ExtendedProcessor] Failed to decode instruction");
+        B64LogWarn(BOX64_LOG_EXEC, @"[ExtendedProcessor] Failed to decode instruction");
         return NO;
     }
     
-    NSLog(@"[ExtendedProcessor] Processing instruction type: 0x%X", decoded.opcode);
+    B64LogTrace(BOX64_LOG_EXEC, @"[ExtendedProcessor] Processing instruction type: 0x%X", decoded.opcode);
     
     // 根据指令类型分发处理
     switch (decoded.type) {
-        // 浮点指令
-        case X86_INSTR_FADD:
-        case X86_INSTR_FSUB:
-        case X86_INSTR_FMUL:
-        case X86_INSTR_FDIV:
-        case X86_INSTR_FLD:
-        case X86_INSTR_FST:
-            return [self processFloatingPointInstruction:decoded context:context];
-            
-        // SIMD指令
-        case X86_INSTR_MOVSS:
-        case X86_INSTR_ADDSS:
-        case X86_INSTR_MULSS:
-        case X86_INSTR_MOVAPS:
-        case X86_INSTR_PADDB:
-            return [self processSIMDInstruction:decoded context:context];
-            
-        // 字符串操作
-        case X86_INSTR_MOVSB:
-        case X86_INSTR_MOVSW:
-        case X86_INSTR_STOSB:
-        case X86_INSTR_LODSB:
-        case X86_INSTR_CMPSB:
-        case X86_INSTR_SCASB:
-            return [self processStringInstruction:decoded context:context];
-            
         // 位操作
         case X86_INSTR_BSF:
         case X86_INSTR_BSR:
@@ -62,126 +52,69 @@
             return [self processBitInstruction:decoded context:context];
             
         default:
-            NSLog(@"[ExtendedProcessor] Unsupported instruction type: 0x%X", decoded.type);
+            B64LogWarn(BOX64_LOG_EXEC, @"[ExtendedProcessor] Unsupported instruction type: 0x%X", decoded.type);
             return NO;
     }
 }
 
-- (BOOL)processFloatingPointInstruction:(X86ExtendedInstruction)instr context:(Box64Context *)context {
-    NSLog(@"[ExtendedProcessor] Processing floating point instruction");
+- (BOOL)processFloatingPointInstruction:(const X86DecodedInsn *)insn context:(Box64Context *)context {
+    B64LogTrace(BOX64_LOG_EXEC, @"[ExtendedProcessor] Processing x87 instruction 0x%02X /%u", insn->opcode, (insn->modrm >> 3) & 7);
     
-    // 简化的浮点运算实现
-    switch (instr.type) {
-        case X86_INSTR_FADD: {
-            // 浮点加法 - 使用ARM64 NEON指令
-            NSArray *arm64Code = @[
-                @(0x4E20D400), // FADD V0.4S, V0.4S, V0.4S
-                @(0xD65F03C0)  // RET
-            ];
-            [self executeARM64Code:arm64Code context:context];
-            return YES;
-        }
-        
-        case X86_INSTR_FMUL: {
-            // 浮点乘法
-            NSArray *arm64Code = @[
-                @(0x6E20DC00), // FMUL V0.4S, V0.4S, V0.4S
-                @(0xD65F03C0)  // RET
-            ];
-            [self executeARM64Code:arm64Code context:context];
+    uint64_t faultAddress = 0;
+    switch (box64_x87_execute(context, insn, context->rip + insn->length, &faultAddress)) {
+        case BOX64_X87_OK:
             return YES;
-        }
-        
-        default:
+        case BOX64_X87_FAULT:
+            B64LogWarn(BOX64_LOG_MEMORY, @"[ExtendedProcessor] Page fault at 0x%llx in x87 instruction", faultAddress);
             return NO;
+        case BOX64_X87_UNSUPPORTED:
+            break;
     }
+    B64LogWarn(BOX64_LOG_EXEC, @"[ExtendedProcessor] Unsupported x87 instruction");
+    return NO;
 }
 
-- (BOOL)processSIMDInstruction:(X86ExtendedInstruction)instr context:(Box64Context *)context {
-    NSLog(@"[ExtendedProcessor] Processing SIMD instruction");
+- (BOOL)processSIMDInstruction:(const X86DecodedInsn *)insn context:(Box64Context *)context {
+    const Box64SseOp operation = box64_sse_classify(insn);
+    B64LogTrace(BOX64_LOG_EXEC, @"[ExtendedProcessor] Processing SIMD instruction %s", box64_sse_op_name(operation));
     
-    switch (instr.type) {
-        case X86_INSTR_MOVSS: {
-            // 移动单精度浮点数
-            NSArray *arm64Code = @[
-                @(0x0E040400), // MOV V0.S[0], V0.S[0]
-                @(0xD65F03C0)  // RET
-            ];
-            [self executeARM64Code:arm64Code context:context];
+    uint64_t faultAddress = 0;
+    switch (box64_sse_execute(context, insn, operation, context->rip + insn->length, &faultAddress)) {
+        case BOX64_SSE_OK:
             return YES;
-        }
-        
-        case X86_INSTR_ADDSS: {
-            // 单精度浮点加法
-            NSArray *arm64Code = @[
-                @(0x7E22D400), // FADD S0, S0, S2
-                @(0xD65F03C0)  // RET
-            ];
-            [self executeARM64Code:arm64Code context:context];
-            return YES;
-        }
-        
-        case X86_INSTR_PADDB: {
-            // 字节并行加法
-            NSArray *arm64Code = @[
-                @(0x4E228400), // ADD V0.16B, V0.16B, V2.16B
-                @(0xD65F03C0)  // RET
-            ];
-            [self executeARM64Code:arm64Code context:context];
-            return YES;
-        }
-        
-        default:
+        case BOX64_SSE_FAULT:
+            B64LogWarn(BOX64_LOG_MEMORY, @"[ExtendedProcessor] Page fault at 0x%llx in %s", faultAddress, box64_sse_op_name(operation));
             return NO;
+        case BOX64_SSE_MISALIGNED:
+            B64LogWarn(BOX64_LOG_EXEC, @"[ExtendedProcessor] Misaligned 16-byte operand in %s", box64_sse_op_name(operation));
+            return NO;
+        case BOX64_SSE_UNSUPPORTED:
+            break;
     }
+    B64LogWarn(BOX64_LOG_EXEC, @"[ExtendedProcessor] Unsupported SIMD instruction");
+    return NO;
 }
 
-- (BOOL)processStringInstruction:(X86ExtendedInstruction)instr context:(Box64Context *)context {
-    NSLog(@"[ExtendedProcessor] Processing string instruction");
+- (BOOL)processStringInstruction:(const X86DecodedInsn *)insn context:(Box64Context *)context {
+    B64LogTrace(BOX64_LOG_EXEC, @"[ExtendedProcessor] Processing string instruction 0x%02X", insn->opcode);
     
-    switch (instr.type) {
-        case X86_INSTR_MOVSB: {
-            // 字节移动
-            uint64_t srcAddr = context->x86_regs[X86_RSI];
-            uint64_t dstAddr = context->x86_regs[X86_RDI];
-            
-            if ([self validateMemoryAccess:srcAddr size:1 context:context] &&
-                [self validateMemoryAccess:dstAddr size:1 context:context]) {
-                
-                uint8_t *src = context->memory_base + srcAddr;
-                uint8_t *dst = context->memory_base + dstAddr;
-                *dst = *src;
-                
-                // 更新指针
-                context->x86_regs[X86_RSI]++;
-                context->x86_regs[X86_RDI]++;
-                
-                return YES;
-            }
-            return NO;
-        }
-        
-        case X86_INSTR_STOSB: {
-            // 存储字节
-            uint64_t dstAddr = context->x86_regs[X86_RDI];
-            uint8_t value = (uint8_t)context->x86_regs[X86_RAX];
-            
-            if ([self validateMemoryAccess:dstAddr size:1 context:context]) {
-                uint8_t *dst = context->memory_base + dstAddr;
-                *dst = value;
-                context->x86_regs[X86_RDI]++;
-                return YES;
-            }
-            return NO;
-        }
-        
-        default:
+    uint64_t faultAddress = 0;
+    switch (box64_string_execute(context, insn, &faultAddress)) {
+        case BOX64_STRING_OK:
+            return YES;
+        case BOX64_STRING_FAULT:
+            // RSI/RDI/RCX 已反映完成的元素，重新执行本指令即可继续
+            B64LogWarn(BOX64_LOG_MEMORY, @"[ExtendedProcessor] Page fault at 0x%llx in string instruction", faultAddress);
             return NO;
+        case BOX64_STRING_UNSUPPORTED:
+            break;
     }
+    B64LogWarn(BOX64_LOG_EXEC, @"[ExtendedProcessor] Unsupported string instruction");
+    return NO;
 }
 
 - (BOOL)processBitInstruction:(X86ExtendedInstruction)instr context:(Box64Context *)context {
-    NSLog(@"[ExtendedProcessor] Processing bit instruction");
+    B64LogTrace(BOX64_LOG_EXEC, @"[ExtendedProcessor] Processing bit instruction");
     
     uint64_t sourceValue = context->x86_regs[instr.sourceReg];
     
@@ -217,7 +150,8 @@
             int bitIndex = (int)(instr.immediate & 0x3F);
             uint64_t bitValue = (sourceValue >> bitIndex) & 1;
             
-            // 设置进位标志
+            // 设置进位标志（先求值惰性标志，否则之后的求值会覆盖CF）
+            box64_flags_materialize(context);
             if (bitValue) {
                 context->rflags |= 0x01; // CF = 1
             } else {
@@ -232,7 +166,7 @@
 }
 
 - (BOOL)validateMemoryAccess:(uint64_t)address size:(size_t)size context:(Box64Context *)context {
-    return (address + size) <= context->memory_size && context->memory_base != NULL;
+    return context->memory_base != NULL && box64_mmu_check(&context->mmu, address, size, BOX64_ACCESS_READ);
 }
 
 - (void)executeARM64Code:(NSArray<NSNumber *> *)codeArray context:(Box64Context *)context {
@@ -245,7 +179,7 @@
     }
     
     // 这里应该调用JIT引擎执行生成的代码
-    NSLog(@"[ExtendedProcessor] Generated %lu bytes of ARM64 code", (unsigned long)codeData.length);
+    B64LogDebug(BOX64_LOG_JIT, @"[ExtendedProcessor] Generated %lu bytes of ARM64 code", (unsigned long)codeData.length);
 }
 
 - (NSArray<NSNumber *> *)generateARM64ForExtendedInstruction:(X86ExtendedInstruction)instr {
@@ -23,11 +23,12 @@
 @property (nonatomic, assign) BOOL isInitialized;
 @property (nonatomic, assign) BOOL isExecuting;
 @property (nonatomic, assign) BOOL graphicsEnabled;
-@property (nonatomic, strong) NSTimer *renderTimer;
+@property (nonatomic, strong) CADisplayLink *displayLink;           // 🔧 显示刷新驱动渲染，替代30 FPS定时器
 @property (nonatomic, strong) NSString *currentProgramPath;
 @property (nonatomic, strong) UIImageView *frameImageView;
 @property (nonatomic, strong) dispatch_queue_t renderQueue;  // 🔧 新增：专用渲染队列
 @property (nonatomic, assign) BOOL shouldStopRendering;      // 🔧 新增：停止渲染标志
+@property (nonatomic, assign) BOOL renderPending;            // 渲染队列里已有一帧没画完
 @end
 
 @implementation GraphicsEnhancedExecutionEngine
@@ -47,7 +48,8 @@
         _isInitialized = NO;
         _isExecuting = NO;
         _graphicsEnabled = NO;
-        _renderTimer = nil;
+        _displayLink = nil;
+        _renderPending = NO;
         _currentProgramPath = nil;
         _shouldStopRendering = NO;
         
@@ -164,10 +166,10 @@
     
     // 停止渲染定时器
     ENSURE_MAIN_THREAD(^{
-        if (self->_renderTimer) {
-            [self->_renderTimer invalidate];
-            self->_renderTimer = nil;
-            NSLog(@"[GraphicsEnhancedExecutionEngine] Render timer invalidated");
+        if (self->_displayLink) {
+            [self->_displayLink invalidate];
+            self->_displayLink = nil;
+            NSLog(@"[GraphicsEnhancedExecutionEngine] Display link invalidated");
         }
     });
     
@@ -259,10 +261,10 @@
     
     // 停止渲染循环
     ENSURE_MAIN_THREAD(^{
-        if (self->_renderTimer) {
-            [self->_renderTimer invalidate];
-            self->_renderTimer = nil;
-            NSLog(@"[GraphicsEnhancedExecutionEngine] Render timer stopped");
+        if (self->_displayLink) {
+            [self->_displayLink invalidate];
+            self->_displayLink = nil;
+            NSLog(@"[GraphicsEnhancedExecutionEngine] Display link stopped");
         }
     });
     
@@ -291,9 +293,9 @@
     } else if (!enabled) {
         _shouldStopRendering = YES;
         ENSURE_MAIN_THREAD(^{
-            if (self->_renderTimer) {
-                [self->_renderTimer invalidate];
-                self->_renderTimer = nil;
+            if (self->_displayLink) {
+                [self->_displayLink invalidate];
+                self->_displayLink = nil;
             }
         });
     }
@@ -331,33 +333,42 @@
     }
     
     ENSURE_MAIN_THREAD(^{
-        if (self->_renderTimer) {
-            [self->_renderTimer invalidate];
-            self->_renderTimer = nil;
+        if (self->_displayLink) {
+            [self->_displayLink invalidate];
+            self->_displayLink = nil;
         }
         
-        // 🔧 修复：使用更低的频率开始，减少CPU负载
-        self->_renderTimer = [NSTimer scheduledTimerWithTimeInterval:1.0/30.0  // 30 FPS instead of 60
-                                                              target:self
-                                                            selector:@selector(renderFrameSafely)
-                                                            userInfo:nil
-                                                             repeats:YES];
+        // 🔧 跟随显示刷新（ProMotion下可达120Hz）；GPU跟不上时由帧槽位决定跳过哪些刷新
+        self->_displayLink = [CADisplayLink displayLinkWithTarget:self selector:@selector(renderFrameSafely:)];
+        [self->_displayLink addToRunLoop:[NSRunLoop mainRunLoop] forMode:NSRunLoopCommonModes];
         
-        NSLog(@"[GraphicsEnhancedExecutionEngine] Started render loop (30 FPS) on main thread");
+        NSLog(@"[GraphicsEnhancedExecutionEngine] Started display-link render loop on main thread");
     });
 }
 
-- (void)renderFrameSafely {
+- (void)renderFrameSafely:(CADisplayLink *)link {
     // 🔧 修复：添加多重安全检查
     if (_shouldStopRendering || !_isExecuting || !_graphicsEnabled || !_isInitialized) {
         return;
     }
     
+    MoltenVKBridge *bridge = self.graphicsBridge;
+    [bridge setDisplayRefreshInterval:link.targetTimestamp - link.timestamp];
+    
+    // 上一帧还在渲染队列里，或者GPU上的帧已满：跳过这次刷新，不排队也不阻塞主线程
+    if (_renderPending || ![bridge shouldRenderFrame]) {
+        return;
+    }
+    _renderPending = YES;
+    
     // 在专用队列中执行渲染逻辑，避免阻塞主线程
     dispatch_async(_renderQueue, ^{
         @autoreleasepool {
             [self performRenderFrame];
         }
+        dispatch_async(dispatch_get_main_queue(), ^{
+            self->_renderPending = NO;
+        });
     });
 }
 
@@ -373,15 +384,20 @@
     }
     
     @try {
-        // 🔧 修复：简化渲染调用，避免复杂操作
-        // 暂时注释掉presentFrame调用，避免崩溃
-        // [self.graphicsBridge presentFrame];
+        // 提交后不等GPU完成，帧槽位由桥接的完成回调释放
+        MoltenVKBridge *bridge = self.graphicsBridge;
+        if (bridge.metalLayer && [bridge beginFrame]) {
+            [bridge endFrame];
+            [bridge presentFrame];
+        }
         
         // 简单的日志输出，确认渲染循环在运行
         static int frameCount = 0;
         frameCount++;
-        if (frameCount % 180 == 0) {  // 每6秒输出一次 (30 FPS * 6s = 180 frames)
-            NSLog(@"[GraphicsEnhancedExecutionEngine] Render loop active - frame %d", frameCount);
+        if (frameCount % 360 == 0) {  // 60Hz下每6秒输出一次
+            NSDictionary *pacing = [bridge getFramePacingStatistics];
+            NSLog(@"[GraphicsEnhancedExecutionEngine] Render loop active - frame %d, late %@, skipped %@",
+                  frameCount, pacing[@"late_frames"], pacing[@"skipped_refreshes"]);
         }
         
     } @catch (NSException *exception) {
@@ -451,7 +467,7 @@
     info[@"graphics_enabled"] = @(_graphicsEnabled);
     info[@"should_stop_rendering"] = @(_shouldStopRendering);
     info[@"current_program"] = _currentProgramPath ?: @"none";
-    info[@"render_timer_active"] = @(_renderTimer != nil);
+    info[@"display_link_active"] = @(_displayLink != nil);
     
     // 核心引擎信息
     if (_coreEngine) {
@@ -489,7 +505,7 @@
     [status appendFormat:@"  Graphics Enabled: %@\n", _graphicsEnabled ? @"YES" : @"NO"];
     [status appendFormat:@"  Should Stop Rendering: %@\n", _shouldStopRendering ? @"YES" : @"NO"];
     [status appendFormat:@"  Current Program: %@\n", _currentProgramPath ?: @"none"];
-    [status appendFormat:@"  Render Timer: %@\n", _renderTimer ? @"ACTIVE" : @"INACTIVE"];
+    [status appendFormat:@"  Display Link: %@\n", _displayLink ? @"ACTIVE" : @"INACTIVE"];
     
     if (_coreEngine) {
         @try {
@@ -1,30 +1,17 @@
 #import <Foundation/Foundation.h>
 #import <sys/mman.h>
 #import <sys/types.h>
+#import "Box64CodeCache.h"
 
 NS_ASSUME_NONNULL_BEGIN
 
-// JIT页面管理结构
-typedef struct JITPage {
-    void *memory;           // 内存地址
-    size_t size;           // 页面大小
-    BOOL isExecutable;     // 当前是否可执行
-    BOOL isWritable;       // 当前是否可写
-} JITPage;
-
-// JIT编译上下文
-typedef struct JITContext {
-    JITPage *pages;        // 页面数组
-    int pageCount;         // 页面数量
-    int maxPages;          // 最大页面数
-    BOOL isEnabled;        // JIT是否启用
-} JITContext;
-
 @interface IOSJITEngine : NSObject
 
 @property (nonatomic, readonly) BOOL isJITEnabled;
 @property (nonatomic, readonly) size_t totalJITMemory;
+@property (nonatomic, readonly) BOOL canExecuteNativeCode;   // 真实JIT模式且宿主为arm64时才可直接调用生成的代码
 
+// 不依附某个客户机进程的独立用途；Box64Engine 的每个进程引擎各自创建实例，不共用这一个
 + (instancetype)sharedEngine;
 
 // JIT初始化和清理
@@ -32,16 +19,37 @@ typedef struct JITContext {
 - (void)cleanupJIT;
 - (void)cleanup;  // 新增：为了兼容CompleteExecutionEngine的调用
 
-// 内存管理
+// 内存管理：都从预留的代码区域中顺序分配（见 Box64CodeCache.h），不再每次 mmap
+// allocateJITMemory 分配的内存被钉住，不会被淘汰；按整页分配，不与其他块共用页面
 - (void *)allocateJITMemory:(size_t)size;
 - (void)freeJITMemory:(void *)memory;
 
-// 权限切换 (W^X实现)
+// 为一个客户机块分配本机代码；区域满时按分代淘汰最旧的区域，被淘汰的块先调用 evict 回调
+// 回调在本引擎持锁时执行，调用方需保证此时没有线程正在执行被淘汰的代码
+- (nullable void *)allocateCodeBlock:(size_t)size
+                            guestRIP:(uint64_t)guestRIP
+                               evict:(nullable Box64CodeEvictCallback)evict
+                                user:(nullable void *)user;
+- (void)freeCodeBlock:(void *)code;
+// 淘汰全部可淘汰的块，返回淘汰数
+- (NSUInteger)flushCodeCache;
+
+// 本机代码地址反查：落在存活块内时返回YES（崩溃/缺页归因）
+- (BOOL)lookupCodeAddress:(const void *)address block:(Box64CodeBlockInfo *)info;
+- (void)getCodeCacheStats:(Box64CodeCacheStats *)stats;
+
+// 权限切换 (W^X实现)：有 MAP_JIT 时按线程切换写保护，否则按页 mprotect
+// 范围必须落在一个已分配块内；mprotect 模式下只接受整页独占的块（allocateJITMemory 分配的）
 - (BOOL)makeMemoryWritable:(void *)memory size:(size_t)size;
 - (BOOL)makeMemoryExecutable:(void *)memory size:(size_t)size;
 
 // 代码编译和执行
 - (BOOL)writeCode:(const void *)code size:(size_t)size toMemory:(void *)memory;
+// 向已分配的JIT内存的指定偏移追加代码（不清零其余部分），完成后切回可执行并失效icache
+// memory 必须是一个已分配块的起始地址，offset + size 不能超出该块
+// mprotect 模式下同页的其他块在安装期间不可执行，调用方需保证此时没有线程执行同一缓存里的代码
+// （Box64Engine 在 codeGate 写锁下安装）
+- (BOOL)installCode:(const void *)code size:(size_t)size atOffset:(size_t)offset inMemory:(void *)memory;
 - (int)executeCode:(void *)memory withArgc:(int)argc argv:(char **)argv;
 
 // 调试支持
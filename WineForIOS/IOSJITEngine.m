@@ -20,10 +20,16 @@ int ptrace(int request, pid_t pid, caddr_t addr, int data) {
 
 // 页面大小常量
 #define JIT_PAGE_SIZE (16 * 1024)
-#define MAX_JIT_PAGES 64
 
-@interface IOSJITEngine()
-@property (nonatomic, assign) JITContext *jitContext;
+// 按线程切换 MAP_JIT 区域的写保护（运行时查找，SDK 不一定声明）
+typedef void (*JITWriteProtectFn)(int enabled);
+typedef int (*JITWriteProtectSupportedFn)(void);
+
+@interface IOSJITEngine() {
+    Box64CodeCache *_codeCache;     // 所有JIT内存都从这里的预留区域分配
+    NSLock *_cacheLock;
+    JITWriteProtectFn _jitWriteProtect;   // 非NULL时区域为 MAP_JIT，写入只对当前线程打开，不用 mprotect
+}
 @property (nonatomic, assign) BOOL jitInitialized;
 @property (nonatomic, assign) BOOL simulationMode; // 🔧 新增：模拟模式标志
 @end
@@ -44,23 +50,13 @@ int ptrace(int request, pid_t pid, caddr_t addr, int data) {
     if (self) {
         _jitInitialized = NO;
         _simulationMode = NO; // 默认尝试真实JIT
-        _jitContext = malloc(sizeof(JITContext));
-        memset(_jitContext, 0, sizeof(JITContext));
-        _jitContext->maxPages = MAX_JIT_PAGES;
-        _jitContext->pages = malloc(sizeof(JITPage) * MAX_JIT_PAGES);
-        memset(_jitContext->pages, 0, sizeof(JITPage) * MAX_JIT_PAGES);
+        _cacheLock = [[NSLock alloc] init];
     }
     return self;
 }
 
 - (void)dealloc {
     [self cleanupJIT];
-    if (_jitContext) {
-        if (_jitContext->pages) {
-            free(_jitContext->pages);
-        }
-        free(_jitContext);
-    }
 }
 
 #pragma mark - JIT初始化 - 修复版
@@ -83,10 +79,19 @@ int ptrace(int request, pid_t pid, caddr_t addr, int data) {
     }
     
     if (jitSuccess) {
-        _jitContext->isEnabled = YES;
+        _jitWriteProtect = _simulationMode ? NULL : [self perThreadWriteToggle];
+        _codeCache = box64_code_cache_create(BOX64_CODE_CACHE_DEFAULT_REGION, BOX64_CODE_CACHE_DEFAULT_REGIONS,
+                                             BOX64_CODE_FLUSH_GENERATIONAL,
+                                             _jitWriteProtect ? BOX64_CODE_CACHE_MAP_JIT : 0);
+        if (!_codeCache) {
+            NSLog(@"[IOSJITEngine] Failed to create code cache");
+            _simulationMode = NO;
+            return NO;
+        }
         _jitInitialized = YES;
-        NSLog(@"[IOSJITEngine] JIT initialization successful (%@)!",
-              _simulationMode ? @"Simulation Mode" : @"Real JIT Mode");
+        NSLog(@"[IOSJITEngine] JIT initialization successful (%@, W^X via %@)!",
+              _simulationMode ? @"Simulation Mode" : @"Real JIT Mode",
+              _jitWriteProtect ? @"per-thread MAP_JIT toggle" : @"mprotect");
     }
     
     return jitSuccess;
@@ -175,6 +180,27 @@ int ptrace(int request, pid_t pid, caddr_t addr, int data) {
     return YES;
 }
 
+// MAP_JIT + pthread_jit_write_protect_np：写保护按线程切换，一个线程写入时其他线程照常执行同一页上的代码
+// 需要 MAP_JIT 权限，映射失败时退回按页 mprotect
+- (JITWriteProtectFn)perThreadWriteToggle {
+#if defined(MAP_JIT) && (defined(__arm64__) || defined(__aarch64__))
+    JITWriteProtectSupportedFn supported = (JITWriteProtectSupportedFn)dlsym(RTLD_DEFAULT, "pthread_jit_write_protect_supported_np");
+    JITWriteProtectFn toggle = (JITWriteProtectFn)dlsym(RTLD_DEFAULT, "pthread_jit_write_protect_np");
+    if (!supported || !toggle || !supported()) {
+        return NULL;
+    }
+    void *probe = mmap(NULL, JIT_PAGE_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS | MAP_JIT, -1, 0);
+    if (probe == MAP_FAILED) {
+        NSLog(@"[IOSJITEngine] MAP_JIT unavailable (%s), using mprotect", strerror(errno));
+        return NULL;
+    }
+    munmap(probe, JIT_PAGE_SIZE);
+    return toggle;
+#else
+    return NULL;
+#endif
+}
+
 #pragma mark - 内存管理 - 修复版
 
 - (void *)allocateJITMemory:(size_t)size {
@@ -183,92 +209,181 @@ int ptrace(int request, pid_t pid, caddr_t addr, int data) {
         return NULL;
     }
     
-    size_t alignedSize = (size + JIT_PAGE_SIZE - 1) & ~(JIT_PAGE_SIZE - 1);
-    
-    void *memory = mmap(NULL, alignedSize, PROT_READ | PROT_WRITE,
-                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-    
-    if (memory == MAP_FAILED) {
-        NSLog(@"[IOSJITEngine] Failed to allocate JIT memory: %s", strerror(errno));
-        return NULL;
+    // 钉住的内存按整页分配，不与其他块共用页面：writeCode/executeCode 按页切换权限时不会波及正在执行的其他块
+    const size_t pageSize = (size_t)getpagesize();
+    const size_t pages = (size + pageSize - 1) & ~(pageSize - 1);
+    void *memory = NULL;
+    [_cacheLock lock];
+    @try {
+        memory = box64_code_cache_alloc_aligned(_codeCache, pages, pageSize, 0, NULL, NULL);
+    } @finally {
+        [_cacheLock unlock];
     }
     
-    if (_jitContext->pageCount < _jitContext->maxPages) {
-        JITPage *page = &_jitContext->pages[_jitContext->pageCount++];
-        page->memory = memory;
-        page->size = alignedSize;
-        page->isWritable = YES;
-        page->isExecutable = NO;
+    if (!memory) {
+        NSLog(@"[IOSJITEngine] Failed to allocate %zu bytes JIT memory (code cache full or request too large)", size);
+        return NULL;
     }
     
-    NSLog(@"[IOSJITEngine] Allocated %zu bytes JIT memory at %p", alignedSize, memory);
+    NSLog(@"[IOSJITEngine] Allocated %zu bytes JIT memory at %p", size, memory);
     return memory;
 }
 
 - (void)freeJITMemory:(void *)memory {
     if (!memory) return;
     
-    for (int i = 0; i < _jitContext->pageCount; i++) {
-        JITPage *page = &_jitContext->pages[i];
-        if (page->memory == memory) {
-            munmap(memory, page->size);
-            
-            for (int j = i; j < _jitContext->pageCount - 1; j++) {
-                _jitContext->pages[j] = _jitContext->pages[j + 1];
-            }
-            _jitContext->pageCount--;
-            
-            NSLog(@"[IOSJITEngine] Freed JIT memory at %p", memory);
-            return;
-        }
+    BOOL freed = NO;
+    [_cacheLock lock];
+    @try {
+        freed = box64_code_cache_free(_codeCache, memory);
+    } @finally {
+        [_cacheLock unlock];
     }
     
-    NSLog(@"[IOSJITEngine] Warning: Attempted to free unknown JIT memory %p", memory);
+    if (freed) {
+        NSLog(@"[IOSJITEngine] Freed JIT memory at %p", memory);
+    } else {
+        NSLog(@"[IOSJITEngine] Warning: Attempted to free unknown JIT memory %p", memory);
+    }
+}
+
+#pragma mark - 代码缓存
+
+// 热块的本机代码：数量多、生命周期短，不逐个打日志
+- (void *)allocateCodeBlock:(size_t)size
+                   guestRIP:(uint64_t)guestRIP
+                      evict:(Box64CodeEvictCallback)evict
+                       user:(void *)user {
+    if (!_jitInitialized) {
+        return NULL;
+    }
+    [_cacheLock lock];
+    @try {
+        return box64_code_cache_alloc(_codeCache, size, guestRIP, evict, user);
+    } @finally {
+        [_cacheLock unlock];
+    }
+}
+
+- (void)freeCodeBlock:(void *)code {
+    if (!code || !_codeCache) return;  // cleanupJIT 之后整个缓存已解除映射
+    [_cacheLock lock];
+    @try {
+        if (!box64_code_cache_free(_codeCache, code)) {
+            NSLog(@"[IOSJITEngine] Warning: Attempted to free unknown code block %p", code);
+        }
+    } @finally {
+        [_cacheLock unlock];
+    }
+}
+
+- (NSUInteger)flushCodeCache {
+    [_cacheLock lock];
+    @try {
+        uint32_t evicted = box64_code_cache_flush(_codeCache);
+        NSLog(@"[IOSJITEngine] Code cache flushed, %u blocks evicted", evicted);
+        return evicted;
+    } @finally {
+        [_cacheLock unlock];
+    }
+}
+
+- (BOOL)lookupCodeAddress:(const void *)address block:(Box64CodeBlockInfo *)info {
+    [_cacheLock lock];
+    @try {
+        return box64_code_cache_find(_codeCache, address, info);
+    } @finally {
+        [_cacheLock unlock];
+    }
+}
+
+- (void)getCodeCacheStats:(Box64CodeCacheStats *)stats {
+    [_cacheLock lock];
+    @try {
+        box64_code_cache_get_stats(_codeCache, stats);
+    } @finally {
+        [_cacheLock unlock];
+    }
 }
 
 #pragma mark - 权限管理 - 修复版
 
+// 公开的切换只接受落在一个已分配块内的范围；mprotect 模式下还必须是整页独占的钉住块，
+// 共用页面的代码块只能经 installCode 安装（调用方保证安装期间没有线程执行同一缓存里的代码）
+- (BOOL)checkProtectableRange:(void *)memory size:(size_t)size {
+    Box64CodeBlockInfo block;
+    if (![self lookupCodeAddress:memory block:&block] ||
+        (uint8_t *)memory + size > (uint8_t *)block.start + block.size) {
+        NSLog(@"[IOSJITEngine] %zu bytes at %p are not inside one JIT block", size, memory);
+        return NO;
+    }
+    if (!_jitWriteProtect && !block.pinned) {
+        NSLog(@"[IOSJITEngine] %p shares pages with other code blocks, use installCode", memory);
+        return NO;
+    }
+    return YES;
+}
+
 - (BOOL)makeMemoryWritable:(void *)memory size:(size_t)size {
     if (_simulationMode) {
         // 在模拟模式下总是返回成功
         NSLog(@"[IOSJITEngine] makeMemoryWritable: simulation mode, returning YES");
-        [self updatePagePermissions:memory writable:YES executable:NO];
         return YES;
     }
-    
-    size_t alignedSize = (size + JIT_PAGE_SIZE - 1) & ~(JIT_PAGE_SIZE - 1);
-    
-    if (mprotect(memory, alignedSize, PROT_READ | PROT_WRITE) != 0) {
+    return [self checkProtectableRange:memory size:size] && [self beginWrite:memory size:size];
+}
+
+- (BOOL)makeMemoryExecutable:(void *)memory size:(size_t)size {
+    if (_simulationMode) {
+        // 在模拟模式下总是返回成功
+        NSLog(@"[IOSJITEngine] makeMemoryExecutable: simulation mode, returning YES");
+        return YES;
+    }
+    return [self checkProtectableRange:memory size:size] && [self endWrite:memory size:size];
+}
+
+// 打开写权限：MAP_JIT 时只对当前线程；否则按页 mprotect（同页的块一起变为不可执行）
+- (BOOL)beginWrite:(void *)memory size:(size_t)size {
+    if (_simulationMode) {
+        return YES;
+    }
+    if (_jitWriteProtect) {
+        _jitWriteProtect(0);
+        return YES;
+    }
+    if (![self protectRange:memory size:size protection:PROT_READ | PROT_WRITE]) {
         NSLog(@"[IOSJITEngine] Failed to make memory writable: %s", strerror(errno));
         return NO;
     }
-    
-    [self updatePagePermissions:memory writable:YES executable:NO];
     return YES;
 }
 
-- (BOOL)makeMemoryExecutable:(void *)memory size:(size_t)size {
+// 写完后恢复执行权限并失效icache
+- (BOOL)endWrite:(void *)memory size:(size_t)size {
     if (_simulationMode) {
-        // 在模拟模式下总是返回成功
-        NSLog(@"[IOSJITEngine] makeMemoryExecutable: simulation mode, returning YES");
-        [self updatePagePermissions:memory writable:NO executable:YES];
         return YES;
     }
-    
-    size_t alignedSize = (size + JIT_PAGE_SIZE - 1) & ~(JIT_PAGE_SIZE - 1);
-    
-    // 清除指令缓存
-    [self clearInstructionCache:memory size:alignedSize];
-    
-    if (mprotect(memory, alignedSize, PROT_READ | PROT_EXEC) != 0) {
+    if (_jitWriteProtect) {
+        _jitWriteProtect(1);
+        [self clearInstructionCache:memory size:size];
+        return YES;
+    }
+    [self clearInstructionCache:memory size:size];
+    if (![self protectRange:memory size:size protection:PROT_READ | PROT_EXEC]) {
         NSLog(@"[IOSJITEngine] Failed to make memory executable: %s", strerror(errno));
         return NO;
     }
-    
-    [self updatePagePermissions:memory writable:NO executable:YES];
     return YES;
 }
 
+// 块在区域内只按16字节对齐，mprotect 的范围扩到覆盖它的整页（同页的其他块一起切换）
+- (BOOL)protectRange:(void *)memory size:(size_t)size protection:(int)protection {
+    const uintptr_t pageSize = (uintptr_t)getpagesize();
+    const uintptr_t start = (uintptr_t)memory & ~(pageSize - 1);
+    const uintptr_t end = ((uintptr_t)memory + size + pageSize - 1) & ~(pageSize - 1);
+    return mprotect((void *)start, end - start, protection) == 0;
+}
+
 // 🔧 修复：iOS兼容的指令缓存清除方法
 - (void)clearInstructionCache:(void *)memory size:(size_t)size {
     @try {
@@ -293,17 +408,6 @@ int ptrace(int request, pid_t pid, caddr_t addr, int data) {
     }
 }
 
-- (void)updatePagePermissions:(void *)memory writable:(BOOL)writable executable:(BOOL)executable {
-    for (int i = 0; i < _jitContext->pageCount; i++) {
-        JITPage *page = &_jitContext->pages[i];
-        if (page->memory == memory) {
-            page->isWritable = writable;
-            page->isExecutable = executable;
-            break;
-        }
-    }
-}
-
 #pragma mark - 代码编译和执行 - 修复版
 
 - (BOOL)writeCode:(const void *)code size:(size_t)size toMemory:(void *)memory {
@@ -312,16 +416,45 @@ int ptrace(int request, pid_t pid, caddr_t addr, int data) {
         return NO;
     }
     
-    if (![self makeMemoryWritable:memory size:size]) {
+    // 先检查范围再改权限，之后没有失败返回的路径，权限总会切回可执行
+    Box64CodeBlockInfo block;
+    if (![self lookupCodeAddress:memory block:&block] || block.start != memory || size > block.size) {
+        NSLog(@"[IOSJITEngine] writeCode out of range: %zu bytes at %p", size, memory);
+        return NO;
+    }
+    if (![self checkProtectableRange:memory size:block.size] || ![self beginWrite:memory size:block.size]) {
         return NO;
     }
     
-    // 清零内存后再写入
-    memset(memory, 0, ((size + JIT_PAGE_SIZE - 1) & ~(JIT_PAGE_SIZE - 1)));
+    // 清零整个块后再写入（只清本块，同一区域里还有别的块）
+    memset(memory, 0, block.size);
     memcpy(memory, code, size);
     
     NSLog(@"[IOSJITEngine] Wrote %zu bytes of code to %p", size, memory);
-    return YES;
+    return [self endWrite:memory size:block.size];
+}
+
+- (BOOL)installCode:(const void *)code size:(size_t)size atOffset:(size_t)offset inMemory:(void *)memory {
+    if (!code || !memory || size == 0) {
+        NSLog(@"[IOSJITEngine] Invalid parameters for installCode");
+        return NO;
+    }
+    
+    size_t end = offset + size;
+    Box64CodeBlockInfo block;
+    BOOL found = [self lookupCodeAddress:memory block:&block];
+    if (!found || block.start != memory || end > block.size) {
+        NSLog(@"[IOSJITEngine] installCode out of range: %zu+%zu in %p (%zu bytes)", offset, size, memory, found ? block.size : 0);
+        return NO;
+    }
+    
+    // W^X: 写入范围切为可写 → 写入 → 切回可执行（endWrite 负责失效icache）
+    uint8_t *target = (uint8_t *)memory + offset;
+    if (![self beginWrite:target size:size]) {
+        return NO;
+    }
+    memcpy(target, code, size);
+    return [self endWrite:target size:size];
 }
 
 - (int)executeCode:(void *)memory withArgc:(int)argc argv:(char **)argv {
@@ -336,9 +469,14 @@ int ptrace(int request, pid_t pid, caddr_t addr, int data) {
         return 0; // 模拟成功执行
     }
     
-    if (![self makeMemoryExecutable:memory size:JIT_PAGE_SIZE]) {
+    Box64CodeBlockInfo block;
+    if (![self lookupCodeAddress:memory block:&block]) {
+        NSLog(@"[IOSJITEngine] %p is not inside an allocated JIT block", memory);
         return -1;
     }
+    if (![self makeMemoryExecutable:block.start size:block.size]) {
+        return -1;  // 共用页面的代码块不能从这里切换权限
+    }
     
     NSLog(@"[IOSJITEngine] Executing JIT code at %p", memory);
     
@@ -445,15 +583,14 @@ int ptrace(int request, pid_t pid, caddr_t addr, int data) {
     
     NSLog(@"[IOSJITEngine] Cleaning up JIT engine...");
     
-    for (int i = 0; i < _jitContext->pageCount; i++) {
-        JITPage *page = &_jitContext->pages[i];
-        if (page->memory) {
-            munmap(page->memory, page->size);
-        }
+    [_cacheLock lock];
+    @try {
+        box64_code_cache_destroy(_codeCache);
+        _codeCache = NULL;
+    } @finally {
+        [_cacheLock unlock];
     }
     
-    _jitContext->pageCount = 0;
-    _jitContext->isEnabled = NO;
     _jitInitialized = NO;
     _simulationMode = NO;
     
@@ -466,42 +603,66 @@ int ptrace(int request, pid_t pid, caddr_t addr, int data) {
 }
 
 - (void)dumpJITStats {
+    Box64CodeCacheStats stats;
+    [self getCodeCacheStats:&stats];
+    // 碎片率：已释放但所在区域还没整体回收、暂时不能复用的字节占已用字节的比例
+    double fragmentation = stats.used_bytes ? 100.0 * stats.freed_bytes / stats.used_bytes : 0.0;
+    
     NSLog(@"[IOSJITEngine] ===== JIT Statistics =====");
     NSLog(@"[IOSJITEngine] Initialized: %@", _jitInitialized ? @"YES" : @"NO");
     NSLog(@"[IOSJITEngine] Mode: %@", _simulationMode ? @"Simulation" : @"Real JIT");
-    NSLog(@"[IOSJITEngine] Enabled: %@", _jitContext->isEnabled ? @"YES" : @"NO");
-    NSLog(@"[IOSJITEngine] Active pages: %d/%d", _jitContext->pageCount, _jitContext->maxPages);
-    NSLog(@"[IOSJITEngine] Total memory: %zu KB", [self totalJITMemory] / 1024);
-    
-    for (int i = 0; i < _jitContext->pageCount; i++) {
-        JITPage *page = &_jitContext->pages[i];
-        NSLog(@"[IOSJITEngine] Page %d: %p (%zu bytes) W:%@ X:%@",
-              i, page->memory, page->size,
-              page->isWritable ? @"Y" : @"N",
-              page->isExecutable ? @"Y" : @"N");
+    NSLog(@"[IOSJITEngine] Regions: %u/%u x %zu KB (%zu KB reserved)",
+          stats.regions, stats.max_regions, stats.region_size / 1024, stats.reserved_bytes / 1024);
+    NSLog(@"[IOSJITEngine] Used: %zu KB, live: %zu KB in %u blocks, freed: %zu KB (fragmentation %.1f%%)",
+          stats.used_bytes / 1024, stats.live_bytes / 1024, stats.live_blocks, stats.freed_bytes / 1024, fragmentation);
+    NSLog(@"[IOSJITEngine] Allocations: %llu, frees: %llu, failures: %llu, mmaps: %llu",
+          stats.allocations, stats.frees, stats.failures, stats.region_maps);
+    NSLog(@"[IOSJITEngine] Evicted: %llu regions / %llu blocks, flushes: %llu, region resets: %llu",
+          stats.evicted_regions, stats.evicted_blocks, stats.flushes, stats.region_resets);
+    
+    [_cacheLock lock];
+    @try {
+        uint32_t count = box64_code_cache_region_count(_codeCache);
+        for (uint32_t i = 0; i < count; i++) {
+            Box64CodeRegionInfo region;
+            box64_code_cache_region_info(_codeCache, i, &region);
+            NSLog(@"[IOSJITEngine] Region %u: %p gen %llu used %zu/%zu live %zu (%u blocks, %u pinned) freed %zu",
+                  i, region.base, region.generation, region.used, region.size,
+                  region.live_bytes, region.live_blocks, region.pinned_blocks, region.freed_bytes);
+        }
+    } @finally {
+        [_cacheLock unlock];
     }
     NSLog(@"[IOSJITEngine] =============================");
 }
 
 - (NSString *)getJITStatus {
-    return [NSString stringWithFormat:@"JIT %@ (%@), %d pages allocated",
+    Box64CodeCacheStats stats;
+    [self getCodeCacheStats:&stats];
+    return [NSString stringWithFormat:@"JIT %@ (%@), %u blocks in %u regions (%zu/%zu KB used)",
             _jitInitialized ? @"Initialized" : @"Not Initialized",
             _simulationMode ? @"Simulation" : @"Real",
-            _jitContext->pageCount];
+            stats.live_blocks, stats.regions, stats.used_bytes / 1024, stats.reserved_bytes / 1024];
 }
 
 #pragma mark - 属性
 
 - (BOOL)isJITEnabled {
-    return _jitInitialized && _jitContext->isEnabled;
+    return _jitInitialized;
+}
+
+- (BOOL)canExecuteNativeCode {
+#if defined(__arm64__) || defined(__aarch64__)
+    return _jitInitialized && !_simulationMode;
+#else
+    return NO;  // x86_64模拟器上生成的ARM64代码无法执行
+#endif
 }
 
 - (size_t)totalJITMemory {
-    size_t total = 0;
-    for (int i = 0; i < _jitContext->pageCount; i++) {
-        total += _jitContext->pages[i].size;
-    }
-    return total;
+    Box64CodeCacheStats stats;
+    [self getCodeCacheStats:&stats];
+    return stats.reserved_bytes;
 }
 
 @end
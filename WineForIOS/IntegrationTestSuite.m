@@ -244,41 +244,56 @@
 }
 
 - (BOOL)runFloatingPointTest:(IntegrationTestCase *)testCase {
-    // 测试浮点运算指令
-    uint8_t floatInstructions[] = {
-        0xD8, 0xC0,  // FADD ST(0), ST(0) - 简化的浮点加法
-        0xD8, 0xC8,  // FMUL ST(0), ST(0) - 简化的浮点乘法
-        0xC3         // RET
-    };
-    
-    BOOL success = [_instructionProcessor processExtendedInstruction:floatInstructions
-                                                              length:sizeof(floatInstructions)
-                                                             context:[[Box64Engine sharedEngine] context]];
+    // 测试x87寄存器栈：FLD1; FLD1; FADDP; FLD1; FDIVP → ST(0) = 0.5，栈深度1
+    Box64Context *context = [[Box64Engine sharedEngine] context];
+    const uint8_t fld1[] = { 0xD9, 0xE8 };        // FLD1
+    const uint8_t faddp[] = { 0xDE, 0xC1 };       // FADDP ST(1), ST(0)
+    const uint8_t fdivrp[] = { 0xDE, 0xF1 };      // FDIVRP ST(1), ST(0)：ST(1) = ST(0) / ST(1)
+    
+    box64_x87_reset(context);
+    BOOL success = [_instructionProcessor processExtendedInstruction:fld1 length:sizeof(fld1) context:context] &&
+                   [_instructionProcessor processExtendedInstruction:fld1 length:sizeof(fld1) context:context] &&
+                   [_instructionProcessor processExtendedInstruction:faddp length:sizeof(faddp) context:context] &&
+                   [_instructionProcessor processExtendedInstruction:fld1 length:sizeof(fld1) context:context] &&
+                   [_instructionProcessor processExtendedInstruction:fdivrp length:sizeof(fdivrp) context:context];
     
     if (!success) {
         testCase.errorMessage = @"Failed to execute floating point instructions";
         return NO;
     }
+    if (box64_x87_read_st(context, 0) != 0.5 || context->x87.valid != (1u << context->x87.top)) {
+        testCase.errorMessage = @"x87 result mismatch";
+        return NO;
+    }
+    box64_x87_reset(context);
     
     return YES;
 }
 
 - (BOOL)runSIMDTest:(IntegrationTestCase *)testCase {
-    // 测试SIMD指令
-    uint8_t simdInstructions[] = {
-        0xF3, 0x0F, 0x10, 0x00,  // MOVSS XMM0, [EAX] - 简化版本
-        0xF3, 0x0F, 0x58, 0x08,  // ADDSS XMM1, [EAX] - 简化版本
-        0xC3                      // RET
-    };
+    // 测试SIMD指令：寄存器形式，不依赖客户机内存布局
+    Box64Context *context = [[Box64Engine sharedEngine] context];
+    const uint8_t addps[] = { 0x0F, 0x58, 0xC1 };          // ADDPS XMM0, XMM1
+    const uint8_t paddb[] = { 0x66, 0x0F, 0xFC, 0xD3 };    // PADDB XMM2, XMM3
+    
+    for (int lane = 0; lane < 4; lane++) {
+        context->xmm[0].f32[lane] = 1.5f * lane;
+        context->xmm[1].f32[lane] = 0.25f;
+    }
+    memset(context->xmm[2].u8, 0xFF, 16);
+    memset(context->xmm[3].u8, 0x02, 16);
     
-    BOOL success = [_instructionProcessor processExtendedInstruction:simdInstructions
-                                                              length:sizeof(simdInstructions)
-                                                             context:[[Box64Engine sharedEngine] context]];
+    BOOL success = [_instructionProcessor processExtendedInstruction:addps length:sizeof(addps) context:context] &&
+                   [_instructionProcessor processExtendedInstruction:paddb length:sizeof(paddb) context:context];
     
     if (!success) {
         testCase.errorMessage = @"Failed to execute SIMD instructions";
         return NO;
     }
+    if (context->xmm[0].f32[3] != 4.75f || context->xmm[2].u8[15] != 0x01) {
+        testCase.errorMessage = @"SIMD result mismatch";
+        return NO;
+    }
     
     return YES;
 }
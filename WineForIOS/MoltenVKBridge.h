@@ -2,6 +2,11 @@
 #import <Metal/Metal.h>
 #import <MetalKit/MetalKit.h>
 #import <QuartzCore/CAMetalLayer.h>
+#import "D3DDispatch.h"
+#import "D3DCommandStream.h"
+#import "D3DFramePacer.h"
+#import "D3DShaderDiskCache.h"
+#import "WineProfiler.h"
 
 NS_ASSUME_NONNULL_BEGIN
 
@@ -18,7 +23,7 @@ typedef struct VkPipeline_T* VkPipeline;
 typedef uint32_t VkBool32;
 typedef uint64_t VkDeviceAddress;
 
-// DirectX函数类型定义
+// DirectX函数类型定义（取值与 D3DCategory 相同）
 typedef enum DirectXFunctionType {
     DirectXFunctionTypeDevice,
     DirectXFunctionTypeContext,
@@ -28,18 +33,19 @@ typedef enum DirectXFunctionType {
     DirectXFunctionTypeState
 } DirectXFunctionType;
 
-// 性能标记结构
-typedef struct PerformanceMarker {
-    double startTime;
-    double endTime;
-    BOOL isActive;
-    char name[64];
-} PerformanceMarker;
-
 // 错误回调类型
 typedef void(^MoltenVKErrorHandler)(NSError *error);
 typedef void(^MoltenVKWarningHandler)(NSString *warning);
 
+typedef NS_ENUM(NSInteger, D3DShaderStage) {
+    D3DShaderStageVertex = 0,
+    D3DShaderStagePixel = 1
+};
+
+// 着色器字节码（DXBC）→ MSL 源码，reflection 输出反射元数据（输入输出签名、资源绑定等）
+typedef NSString * _Nullable (^D3DShaderTranslationHandler)(NSData *bytecode, D3DShaderStage stage,
+                                                            NSData * _Nullable * _Nonnull reflection);
+
 #pragma mark - 委托协议
 
 @protocol MoltenVKBridgeDelegate <NSObject>
@@ -100,18 +106,47 @@ typedef void(^MoltenVKWarningHandler)(NSString *warning);
 - (VkCommandBuffer)createCommandBuffer;
 
 // 渲染控制
-- (BOOL)beginFrame;
+- (BOOL)beginFrame;                     // 已有进行中的帧时直接返回YES
 - (BOOL)endFrame;
 - (BOOL)presentFrame;
 
 // DirectX转换支持
 - (BOOL)interceptDirectXCall:(NSString *)functionName parameters:(NSArray *)parameters;
 - (BOOL)translateAndExecuteDirectXCall:(NSString *)functionName parameters:(NSArray *)parameters;
-
-// 性能监控
+// 快速路径：操作码已在绑定时解析好，不加桥接锁、不记日志
+- (BOOL)executeDirectXCall:(const D3DCall *)call;
+
+// 延迟命令流：打开后可延迟的调用（上下文、绘制、着色器绑定、状态）只追加进调用线程自己的录制器，
+// endFrame 时拆分给编码线程，并行编码进 MTLParallelRenderCommandEncoder 的子编码器后按顺序提交；
+// 设备与资源创建仍立即执行。endFrame 等正在录制的线程追加完再拆分，之后的录制进入下一帧
+// 只能在没有进行中的帧时切换
+@property (nonatomic, assign) BOOL commandStreamEnabled;
+- (NSDictionary *)getCommandStreamStatistics;
+
+// 多帧并行：presentFrame 只提交不等待，GPU完成回调释放帧槽位；beginFrame 在没有空槽位时阻塞（有超时）
+// 只能在没有进行中的帧、GPU空闲时修改，取值 1..D3D_PACER_MAX_FRAMES_IN_FLIGHT，默认3
+@property (nonatomic, assign) NSUInteger maxFramesInFlight;
+// 每帧的上传内存（常量、动态顶点等）：按帧槽位分区的共享缓冲区，只在 beginFrame 与 presentFrame 之间有效
+@property (nonatomic, readonly, nullable) id<MTLBuffer> uploadBuffer;
+- (nullable void *)allocateUploadMemory:(NSUInteger)length alignment:(NSUInteger)alignment offset:(NSUInteger *)offset;
+// 显示刷新回调里调用：有空槽位返回YES，否则这次刷新应跳过而不是阻塞
+- (BOOL)shouldRenderFrame;
+- (void)setDisplayRefreshInterval:(NSTimeInterval)interval;
+// 等待已提交的帧全部完成且完成回调都已交回槽位（清理、修改并行帧数前）
+- (void)waitForGPUIdle;
+- (NSDictionary *)getFramePacingStatistics;
+
+// 性能监控（任意线程；同一线程内可嵌套，end 匹配最近的同名 begin）
+@property (nonatomic, assign) BOOL performanceMarkersEnabled;
 - (void)beginPerformanceMarker:(NSString *)name;
 - (void)endPerformanceMarker:(NSString *)name;
+- (WineProfMarker)performanceMarkerWithName:(NSString *)name;
+- (void)beginPerformanceMarkerWithID:(WineProfMarker)marker;
+- (void)endPerformanceMarkerWithID:(WineProfMarker)marker;
+- (void)resetPerformanceMetrics;
 - (NSDictionary *)getPerformanceMetrics;
+// Chrome trace JSON（chrome://tracing、Perfetto 可直接打开）
+- (BOOL)exportPerformanceTraceToPath:(NSString *)path;
 
 // 调试支持
 - (NSString *)getSystemInfo;
@@ -131,7 +166,14 @@ typedef void(^MoltenVKWarningHandler)(NSString *warning);
 // 初始化方法
 + (instancetype)translatorWithBridge:(MoltenVKBridge *)bridge;
 
-// 主要翻译方法 - 修复方法签名
+// 操作码接口：函数名在绑定时换成操作码（未知名字返回 D3D_OP_INVALID），之后按操作码和打包参数分派
+- (D3DOpcode)bindFunction:(NSString *)functionName;
+- (BOOL)executeCall:(const D3DCall *)call;
+
+// 调用日志默认关闭；打开后记录最近的调用（操作码、结果、时间），getTranslationLog 时才格式化
+@property (nonatomic, assign) BOOL loggingEnabled;
+
+// 按字符串名调用的兼容接口：每次都查名字、拆 NSNumber 参数，热路径请用 bindFunction: + executeCall:
 - (BOOL)translateDirectXCall:(NSString *)functionName parameters:(NSArray *)parameters;
 
 // 特定函数类型处理
@@ -150,6 +192,18 @@ typedef void(^MoltenVKWarningHandler)(NSString *warning);
 // 调试支持
 - (NSString *)getTranslationLog;
 - (void)clearTranslationLog;
+// 各操作码的调用次数与失败次数
+- (NSDictionary *)getDispatchStatistics;
+
+// 着色器翻译：结果按字节码内容 + 翻译器版本缓存在容器前缀目录（shader_cache/）下，热启动时不再翻译
+// 未设置 shaderTranslationHandler 时生成占位着色器
+@property (nonatomic, copy, nullable) D3DShaderTranslationHandler shaderTranslationHandler;
+- (BOOL)openShaderCacheInPrefix:(NSString *)prefixPath;
+- (void)closeShaderCache;
+- (nullable NSString *)translateShaderBytecode:(NSData *)bytecode
+                                         stage:(D3DShaderStage)stage
+                                    reflection:(NSData * _Nullable * _Nullable)reflection;
+- (NSDictionary *)getShaderCacheStatistics;
 
 @end
 
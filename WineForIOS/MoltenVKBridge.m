@@ -1,4 +1,6 @@
 #import "MoltenVKBridge.h"
+#import <pthread.h>
+#import <errno.h>
 
 // 错误域常量定义
 NSString * const MoltenVKBridgeErrorDomainInitialization = @"MoltenVKBridgeErrorInitialization";
@@ -24,7 +26,6 @@ NSError *MoltenVKBridgeError(NSString *domain, NSInteger code, NSString *descrip
 
 // 内部状态
 @property (nonatomic, strong) DirectXToVulkanTranslator *translator;
-@property (nonatomic, strong) NSMutableArray<NSValue *> *performanceMarkers;
 @property (nonatomic, strong) NSMutableString *debugLog;
 @property (nonatomic, assign) BOOL debugModeEnabled;
 @property (nonatomic, strong) NSRecursiveLock *bridgeLock;
@@ -36,7 +37,149 @@ NSError *MoltenVKBridgeError(NSString *domain, NSInteger code, NSString *descrip
 @property (nonatomic, assign) BOOL frameInProgress;
 @end
 
-@implementation MoltenVKBridge
+#pragma mark - 命令流Metal后端
+
+#define STREAM_MAX_RECORDERS        32      // 录制线程数上限，超出的线程录制失败
+#define STREAM_MAX_ENCODE_WORKERS   4
+#define STREAM_MIN_PACKETS_PER_PART 256     // 更短的通道不值得拆给多个线程
+
+#define FRAME_DEFAULT_IN_FLIGHT     3       // 三缓冲：CPU录制、GPU执行、显示各占一帧
+#define FRAME_DEFAULT_REFRESH_NS    16666667ULL
+#define FRAME_UPLOAD_REGION_SIZE    (4u * 1024 * 1024)  // 每个帧槽位的上传区域
+#define FRAME_BEGIN_TIMEOUT_NS      1000000000ULL       // GPU挂起时 beginFrame 最多等1秒
+
+typedef struct MetalStreamPart {
+    void *encoder;                          // id<MTLRenderCommandEncoder>，__bridge_retained，end_part 时释放
+    bool hasPipeline;
+} MetalStreamPart;
+
+// 一帧的编码目标，只在 endFrame 期间存在
+typedef struct MetalStreamFrame {
+    __unsafe_unretained id<MTLCommandBuffer> commandBuffer;
+    __unsafe_unretained MTLRenderPassDescriptor *descriptor;
+    __unsafe_unretained id<MTLRenderPipelineState> pipelineState;
+    void *parallelEncoder;                  // 当前通道的 id<MTLParallelRenderCommandEncoder>，__bridge_retained
+    MetalStreamPart *parts;
+} MetalStreamFrame;
+
+// 渲染目标句柄目前都映射到 drawable：第一个通道按 beginFrame 的设置清屏，之后的通道保留已有内容
+static bool MetalStreamBeginPass(void *user, uint32_t pass) {
+    MetalStreamFrame *frame = user;
+    if (!frame->descriptor) {
+        return false;
+    }
+    if (pass > 0) {
+        frame->descriptor.colorAttachments[0].loadAction = MTLLoadActionLoad;
+    }
+    id<MTLParallelRenderCommandEncoder> encoder =
+        [frame->commandBuffer parallelRenderCommandEncoderWithDescriptor:frame->descriptor];
+    if (!encoder) {
+        NSLog(@"[MoltenVKBridge] Failed to create parallel render encoder for pass %u", pass);
+        return false;
+    }
+    encoder.label = [NSString stringWithFormat:@"MoltenVKBridge Pass %u", pass];
+    frame->parallelEncoder = (__bridge_retained void *)encoder;
+    return true;
+}
+
+// 子编码器的创建顺序就是GPU上的执行顺序，所以在调用线程上按部分顺序创建
+static void *MetalStreamBeginPart(void *user, const D3DStreamPart *streamPart, uint32_t index) {
+    MetalStreamFrame *frame = user;
+    id<MTLParallelRenderCommandEncoder> parallelEncoder = (__bridge id<MTLParallelRenderCommandEncoder>)frame->parallelEncoder;
+    id<MTLRenderCommandEncoder> encoder = [parallelEncoder renderCommandEncoder];
+    if (!encoder) {
+        return NULL;
+    }
+    encoder.label = [NSString stringWithFormat:@"MoltenVKBridge Part %u", index];
+    MetalStreamPart *part = &frame->parts[index];
+    part->hasPipeline = frame->pipelineState != nil;
+    if (part->hasPipeline) {
+        [encoder setRenderPipelineState:frame->pipelineState];
+    }
+    part->encoder = (__bridge_retained void *)encoder;
+    return part;
+}
+
+// 在编码线程上调用；拓扑目前固定为三角形列表
+static bool MetalStreamEncode(void *context, const D3DCall *call, bool inherited) {
+    MetalStreamPart *part = context;
+    id<MTLRenderCommandEncoder> encoder = (__bridge id<MTLRenderCommandEncoder>)part->encoder;
+    switch (call->opcode) {
+        case D3D_OP_DRAW:
+            if (part->hasPipeline) {
+                [encoder drawPrimitives:MTLPrimitiveTypeTriangle
+                            vertexStart:call->args.draw.start_vertex
+                            vertexCount:call->args.draw.vertex_count];
+            }
+            return true;
+        case D3D_OP_DRAW_INSTANCED:
+            if (part->hasPipeline) {
+                [encoder drawPrimitives:MTLPrimitiveTypeTriangle
+                            vertexStart:call->args.draw_instanced.start_vertex
+                            vertexCount:call->args.draw_instanced.vertex_count
+                          instanceCount:call->args.draw_instanced.instance_count
+                           baseInstance:call->args.draw_instanced.start_instance];
+            }
+            return true;
+        default:
+            // 索引绘制需要索引缓冲；着色器绑定、状态和清除目前与立即路径一样只做模拟
+            return true;
+    }
+}
+
+static void MetalStreamEndPart(void *context) {
+    MetalStreamPart *part = context;
+    id<MTLRenderCommandEncoder> encoder = CFBridgingRelease(part->encoder);
+    part->encoder = NULL;
+    [encoder endEncoding];
+}
+
+static void MetalStreamEndPass(void *user, uint32_t pass) {
+    MetalStreamFrame *frame = user;
+    id<MTLParallelRenderCommandEncoder> encoder = CFBridgingRelease(frame->parallelEncoder);
+    frame->parallelEncoder = NULL;
+    [encoder endEncoding];
+}
+
+@implementation MoltenVKBridge {
+    // 延迟命令流：录制器按线程第一次录制的顺序登记，之后一直归桥接所有
+    pthread_key_t _recorderKey;
+    NSLock *_recorderLock;
+    // 录制线程持读锁追加；endFrame 持写锁拆分、编码、清空录制器并关闭本帧。
+    // _frameInProgress 只在持写锁时修改，录制线程持读锁时读到的值在追加期间不会变
+    pthread_rwlock_t _recordLock;
+    D3DCommandRecorder *_recorders[STREAM_MAX_RECORDERS];
+    uint32_t _recorderCount;
+    D3DCommandStream _commandStream;
+    D3DEncodePool *_encodePool;
+    MTLRenderPassDescriptor *_passDescriptor;   // 命令流模式下 beginFrame 只准备通道描述符
+    MetalStreamPart *_streamParts;
+    uint32_t _streamPartCapacity;
+    
+    // 命令流统计
+    uint64_t _streamFrames;
+    uint64_t _streamPackets;
+    uint64_t _streamBytes;
+    uint64_t _streamPartsEncoded;
+    uint64_t _streamPasses;
+    uint64_t _streamFailedCalls;
+    double _streamEncodeTime;
+    
+    // 多帧并行：帧凭据在 beginFrame 取得，由提交后的GPU完成回调交回
+    D3DFramePacer _framePacer;
+    D3DFrameTicket _frameTicket;
+    BOOL _hasFrameTicket;
+    NSUInteger _maxFramesInFlight;
+    id<CAMetalDrawable> _currentDrawable;       // beginFrame 取得，presentFrame 呈现同一个
+    id<MTLBuffer> _uploadBuffer;
+    
+    // 帧内各阶段的性能标记（init 时登记一次，之后按ID记录）
+    WineProfMarker _frameMarker;
+    WineProfMarker _frameWaitMarker;
+    WineProfMarker _drawableMarker;
+    WineProfMarker _encodeMarker;
+    WineProfMarker _presentMarker;
+}
 
 + (instancetype)sharedBridge {
     static MoltenVKBridge *sharedInstance = nil;
@@ -54,9 +197,24 @@ NSError *MoltenVKBridgeError(NSString *domain, NSInteger code, NSString *descrip
         _debugModeEnabled = NO;
         _frameInProgress = NO;
         _bridgeLock = [[NSRecursiveLock alloc] init];
-        _performanceMarkers = [NSMutableArray array];
+        _frameMarker = wine_prof_intern("Frame");
+        _frameWaitMarker = wine_prof_intern("Frame.WaitSlot");
+        _drawableMarker = wine_prof_intern("Frame.NextDrawable");
+        _encodeMarker = wine_prof_intern("Frame.EncodeStream");
+        _presentMarker = wine_prof_intern("Present");
         _debugLog = [NSMutableString string];
         
+        // 延迟命令流，默认关闭
+        _commandStreamEnabled = NO;
+        _recorderLock = [[NSLock alloc] init];
+        pthread_key_create(&_recorderKey, NULL);
+        pthread_rwlock_init(&_recordLock, NULL);
+        d3d_stream_init(&_commandStream);
+        
+        // 多帧并行，上传缓冲区在初始化Metal设备后创建
+        _maxFramesInFlight = FRAME_DEFAULT_IN_FLIGHT;
+        d3d_pacer_init(&_framePacer, FRAME_DEFAULT_IN_FLIGHT, FRAME_DEFAULT_REFRESH_NS, FRAME_UPLOAD_REGION_SIZE);
+        
         // 创建翻译器
         _translator = [DirectXToVulkanTranslator translatorWithBridge:self];
         
@@ -67,6 +225,17 @@ NSError *MoltenVKBridgeError(NSString *domain, NSInteger code, NSString *descrip
 
 - (void)dealloc {
     [self cleanup];
+    
+    d3d_encode_pool_destroy(_encodePool);
+    for (uint32_t i = 0; i < _recorderCount; i++) {
+        d3d_recorder_destroy(_recorders[i]);
+        free(_recorders[i]);
+    }
+    d3d_stream_destroy(&_commandStream);
+    free(_streamParts);
+    pthread_key_delete(_recorderKey);
+    pthread_rwlock_destroy(&_recordLock);
+    d3d_pacer_destroy(&_framePacer);
 }
 
 #pragma mark - 初始化方法
@@ -116,6 +285,15 @@ NSError *MoltenVKBridgeError(NSString *domain, NSInteger code, NSString *descrip
         _commandQueue.label = @"MoltenVKBridge Command Queue";
         NSLog(@"[MoltenVKBridge] Command queue created");
         
+        // 每帧上传内存：CPU写、GPU读的共享缓冲区，按帧槽位分区
+        _uploadBuffer = [_metalDevice newBufferWithLength:FRAME_UPLOAD_REGION_SIZE * _maxFramesInFlight
+                                                  options:MTLResourceStorageModeShared];
+        if (!_uploadBuffer) {
+            NSLog(@"[MoltenVKBridge] CRITICAL: Failed to create upload buffer");
+            return NO;
+        }
+        _uploadBuffer.label = @"MoltenVKBridge Frame Upload Buffer";
+        
         // 3. 创建模拟的Vulkan实例和设备
         _vulkanInstance = [self createVulkanInstance];
         _vulkanDevice = [self createVulkanDevice];
@@ -131,7 +309,8 @@ NSError *MoltenVKBridgeError(NSString *domain, NSInteger code, NSString *descrip
         NSLog(@"[MoltenVKBridge] Vulkan objects created");
         
         // 4. 初始化性能监控
-        [_performanceMarkers removeAllObjects];
+        wine_prof_set_thread_name(pthread_main_np() ? "main" : "bridge");
+        wine_prof_reset();
         [_debugLog setString:@""];
         
         _isInitialized = YES;
@@ -174,6 +353,12 @@ NSError *MoltenVKBridgeError(NSString *domain, NSInteger code, NSString *descrip
             [self endFrame];
         }
         
+        // 没提交的帧交回凭据，已提交的等GPU完成，避免完成回调访问已释放的资源
+        if (_hasFrameTicket) {
+            [self abandonFrame];
+        }
+        [self waitForGPUIdle];
+        
         // 清理Vulkan对象
         if (_vulkanDevice) {
             [self destroyVulkanDevice:_vulkanDevice];
@@ -189,14 +374,14 @@ NSError *MoltenVKBridgeError(NSString *domain, NSInteger code, NSString *descrip
         _currentRenderEncoder = nil;
         _currentCommandBuffer = nil;
         _currentPipelineState = nil;
+        _currentDrawable = nil;
+        _uploadBuffer = nil;
         _commandQueue = nil;
         _metalDevice = nil;
         _metalLayer = nil;
         
-        // 清理状态
-        [_performanceMarkers removeAllObjects];
+        // 清理状态（性能统计保留到下次初始化，清理后仍可读取和导出）
         [_debugLog setString:@""];
-        _frameInProgress = NO;
         _isInitialized = NO;
         
         NSLog(@"[MoltenVKBridge] Cleanup completed");
@@ -321,6 +506,7 @@ NSError *MoltenVKBridgeError(NSString *domain, NSInteger code, NSString *descrip
 
 #pragma mark - 渲染控制
 
+// 确保有一帧正在进行：已经开始（可能是别的线程开始的）时直接返回YES，只在真正出错时返回NO
 - (BOOL)beginFrame {
     [_bridgeLock lock];
     
@@ -331,18 +517,34 @@ NSError *MoltenVKBridgeError(NSString *domain, NSInteger code, NSString *descrip
         }
         
         if (_frameInProgress) {
-            NSLog(@"[MoltenVKBridge] Frame already in progress");
+            return YES;
+        }
+        
+        if (_hasFrameTicket) {
+            NSLog(@"[MoltenVKBridge] Previous frame not presented yet");
+            return NO;
+        }
+        
+        // 等一个空的帧槽位：最多 maxFramesInFlight 帧同时在GPU上
+        wine_prof_begin(_frameWaitMarker);
+        BOOL gotSlot = d3d_pacer_begin_frame(&_framePacer, FRAME_BEGIN_TIMEOUT_NS, &_frameTicket);
+        wine_prof_end(_frameWaitMarker);
+        if (!gotSlot) {
+            NSLog(@"[MoltenVKBridge] Timed out waiting for a free frame slot (%u in flight)",
+                  d3d_pacer_in_flight(&_framePacer));
             return NO;
         }
+        _hasFrameTicket = YES;
         
         // 开始性能标记
-        [self beginPerformanceMarker:@"Frame"];
+        wine_prof_begin(_frameMarker);
         
         // 创建命令缓冲区
         _currentCommandBuffer = [_commandQueue commandBuffer];
         if (!_currentCommandBuffer) {
             NSLog(@"[MoltenVKBridge] Failed to create command buffer");
-            [self endPerformanceMarker:@"Frame"];
+            [self abandonFrame];
+            wine_prof_end(_frameMarker);
             return NO;
         }
         
@@ -350,12 +552,16 @@ NSError *MoltenVKBridgeError(NSString *domain, NSInteger code, NSString *descrip
         
         // 如果有Metal层，获取drawable
         if (_metalLayer) {
+            wine_prof_begin(_drawableMarker);
             id<CAMetalDrawable> drawable = [_metalLayer nextDrawable];
+            wine_prof_end(_drawableMarker);
             if (!drawable) {
                 NSLog(@"[MoltenVKBridge] Failed to get drawable");
-                [self endPerformanceMarker:@"Frame"];
+                [self abandonFrame];
+                wine_prof_end(_frameMarker);
                 return NO;
             }
+            _currentDrawable = drawable;
             
             // 创建渲染通道描述符
             MTLRenderPassDescriptor *renderPassDescriptor = [MTLRenderPassDescriptor renderPassDescriptor];
@@ -364,18 +570,26 @@ NSError *MoltenVKBridgeError(NSString *domain, NSInteger code, NSString *descrip
             renderPassDescriptor.colorAttachments[0].storeAction = MTLStoreActionStore;
             renderPassDescriptor.colorAttachments[0].clearColor = MTLClearColorMake(0.0, 0.0, 0.0, 1.0);
             
-            // 创建渲染编码器
-            _currentRenderEncoder = [_currentCommandBuffer renderCommandEncoderWithDescriptor:renderPassDescriptor];
-            if (!_currentRenderEncoder) {
-                NSLog(@"[MoltenVKBridge] Failed to create render encoder");
-                [self endPerformanceMarker:@"Frame"];
-                return NO;
+            if (_commandStreamEnabled) {
+                // 命令流模式：编码推迟到 endFrame，按渲染通道创建并行编码器
+                _passDescriptor = renderPassDescriptor;
+            } else {
+                // 创建渲染编码器
+                _currentRenderEncoder = [_currentCommandBuffer renderCommandEncoderWithDescriptor:renderPassDescriptor];
+                if (!_currentRenderEncoder) {
+                    NSLog(@"[MoltenVKBridge] Failed to create render encoder");
+                    [self abandonFrame];
+                    wine_prof_end(_frameMarker);
+                    return NO;
+                }
+                
+                _currentRenderEncoder.label = @"MoltenVKBridge Render Encoder";
             }
-            
-            _currentRenderEncoder.label = @"MoltenVKBridge Render Encoder";
         }
         
+        pthread_rwlock_wrlock(&_recordLock);
         _frameInProgress = YES;
+        pthread_rwlock_unlock(&_recordLock);
         NSLog(@"[MoltenVKBridge] Frame begun successfully");
         
         return YES;
@@ -394,16 +608,30 @@ NSError *MoltenVKBridgeError(NSString *domain, NSInteger code, NSString *descrip
             return NO;
         }
         
-        // 结束渲染编码器
-        if (_currentRenderEncoder) {
-            [_currentRenderEncoder endEncoding];
-            _currentRenderEncoder = nil;
+        // 等正在追加的录制线程退出；之后到来的录制会等本帧关闭，再开始下一帧
+        pthread_rwlock_wrlock(&_recordLock);
+        @try {
+            // 命令流模式：本帧录制的调用在这里拆分、并行编码
+            if (_commandStreamEnabled) {
+                wine_prof_begin(_encodeMarker);
+                [self encodeRecordedCommands];
+                wine_prof_end(_encodeMarker);
+                _passDescriptor = nil;
+            }
+            
+            // 结束渲染编码器
+            if (_currentRenderEncoder) {
+                [_currentRenderEncoder endEncoding];
+                _currentRenderEncoder = nil;
+            }
+            
+            _frameInProgress = NO;
+        } @finally {
+            pthread_rwlock_unlock(&_recordLock);
         }
         
-        _frameInProgress = NO;
-        
         // 结束性能标记
-        [self endPerformanceMarker:@"Frame"];
+        wine_prof_end(_frameMarker);
         
         NSLog(@"[MoltenVKBridge] Frame ended successfully");
         return YES;
@@ -427,27 +655,44 @@ NSError *MoltenVKBridgeError(NSString *domain, NSInteger code, NSString *descrip
             return NO;
         }
         
-        // 如果有Metal层，呈现drawable
-        if (_metalLayer) {
-            id<CAMetalDrawable> drawable = _metalLayer.nextDrawable;
-            if (drawable) {
-                [_currentCommandBuffer presentDrawable:drawable];
-            }
+        wine_prof_begin(_presentMarker);
+        
+        // 呈现 beginFrame 时渲染的那个drawable（再取 nextDrawable 会呈现一张没画过的纹理）
+        if (_currentDrawable) {
+            [_currentCommandBuffer presentDrawable:_currentDrawable];
+            _currentDrawable = nil;
         }
         
+        // 提交后不等GPU：完成回调（Metal内部线程）交回帧凭据，CPU直接开始录制下一帧
+        // 回调持有桥接直到GPU完成，凭据按值捕获
+        MoltenVKBridge *bridge = self;
+        const D3DFrameTicket ticket = _frameTicket;
+        [_currentCommandBuffer addCompletedHandler:^(id<MTLCommandBuffer> buffer) {
+            d3d_pacer_frame_completed(&bridge->_framePacer, &ticket);
+            
+            if (buffer.status == MTLCommandBufferStatusError) {
+                NSLog(@"[MoltenVKBridge] Frame %llu failed on GPU: %@", ticket.frame, buffer.error);
+            }
+            
+            // 通知委托
+            id<MoltenVKBridgeDelegate> delegate = bridge.delegate;
+            if ([delegate respondsToSelector:@selector(moltenVKBridge:didCompleteFrame:)]) {
+                NSTimeInterval frameTime = [NSDate timeIntervalSinceReferenceDate];
+                dispatch_async(dispatch_get_main_queue(), ^{
+                    [delegate moltenVKBridge:bridge didCompleteFrame:frameTime];
+                });
+            }
+        }];
+        
         // 提交命令缓冲区
         [_currentCommandBuffer commit];
-        [_currentCommandBuffer waitUntilCompleted];
         
         _currentCommandBuffer = nil;
+        _hasFrameTicket = NO;
+        wine_prof_end(_presentMarker);
         
-        NSLog(@"[MoltenVKBridge] Frame presented successfully");
-        
-        // 通知委托
-        if ([_delegate respondsToSelector:@selector(moltenVKBridge:didCompleteFrame:)]) {
-            NSTimeInterval frameTime = [NSDate timeIntervalSinceReferenceDate];
-            [_delegate moltenVKBridge:self didCompleteFrame:frameTime];
-        }
+        NSLog(@"[MoltenVKBridge] Frame %llu submitted (%u in flight)",
+              ticket.frame, d3d_pacer_in_flight(&_framePacer));
         
         return YES;
         
@@ -488,104 +733,434 @@ NSError *MoltenVKBridgeError(NSString *domain, NSInteger code, NSString *descrip
     return [self interceptDirectXCall:functionName parameters:parameters];
 }
 
-#pragma mark - 性能监控
+- (BOOL)executeDirectXCall:(const D3DCall *)call {
+    if (!_isInitialized && call->opcode != D3D_OP_CREATE_DEVICE && call->opcode != D3D_OP_CREATE_DEVICE_AND_SWAP_CHAIN) {
+        return NO;
+    }
+    if (_commandStreamEnabled && d3d_opcode_recordable((D3DOpcode)call->opcode)) {
+        D3DCommandRecorder *recorder = [self currentThreadRecorder];
+        if (!recorder) {
+            return NO;
+        }
+        // 开帧要取 _bridgeLock，不能在持读锁时做；持读锁后帧已被 endFrame 关闭就重新开一帧
+        for (;;) {
+            if (![self beginFrame]) {
+                return NO;
+            }
+            pthread_rwlock_rdlock(&_recordLock);
+            if (_frameInProgress) {
+                // 录制失败时不退回立即执行，否则会越过已录制的调用改变顺序
+                const bool recorded = d3d_recorder_record(recorder, call);
+                pthread_rwlock_unlock(&_recordLock);
+                return recorded;
+            }
+            pthread_rwlock_unlock(&_recordLock);
+        }
+    }
+    return [_translator executeCall:call];
+}
 
-- (void)beginPerformanceMarker:(NSString *)name {
+#pragma mark - 延迟命令流
+
+- (void)setCommandStreamEnabled:(BOOL)commandStreamEnabled {
     [_bridgeLock lock];
     
     @try {
-        PerformanceMarker marker;
-        marker.startTime = [NSDate timeIntervalSinceReferenceDate];
-        marker.endTime = 0;
-        marker.isActive = YES;
-        strncpy(marker.name, name.UTF8String, sizeof(marker.name) - 1);
-        marker.name[sizeof(marker.name) - 1] = '\0';
+        if (commandStreamEnabled == _commandStreamEnabled) {
+            return;
+        }
+        if (_frameInProgress) {
+            NSLog(@"[MoltenVKBridge] Cannot switch command stream mode while a frame is in progress");
+            return;
+        }
         
-        NSValue *markerValue = [NSValue value:&marker withObjCType:@encode(PerformanceMarker)];
-        [_performanceMarkers addObject:markerValue];
+        // 调用线程也参与编码，只需要CPU数减一个编码线程
+        if (commandStreamEnabled && !_encodePool) {
+            NSUInteger processors = [NSProcessInfo processInfo].activeProcessorCount;
+            uint32_t workers = processors > 1 ? (uint32_t)MIN(processors - 1, STREAM_MAX_ENCODE_WORKERS) : 0;
+            _encodePool = d3d_encode_pool_create(workers);
+            if (!_encodePool) {
+                NSLog(@"[MoltenVKBridge] ❌ Failed to create encode pool");
+                return;
+            }
+            NSLog(@"[MoltenVKBridge] Command stream encode pool: %u workers", d3d_encode_pool_workers(_encodePool));
+        }
         
-        if (_debugModeEnabled) {
-            NSLog(@"[MoltenVKBridge] Performance marker started: %@", name);
+        _commandStreamEnabled = commandStreamEnabled;
+        NSLog(@"[MoltenVKBridge] Command stream %@", commandStreamEnabled ? @"enabled" : @"disabled");
+        
+    } @finally {
+        [_bridgeLock unlock];
+    }
+}
+
+// 每个线程第一次录制时登记一个录制器，之后不加锁直接取
+- (nullable D3DCommandRecorder *)currentThreadRecorder {
+    D3DCommandRecorder *recorder = pthread_getspecific(_recorderKey);
+    if (recorder) {
+        return recorder;
+    }
+    
+    [_recorderLock lock];
+    
+    @try {
+        if (_recorderCount >= STREAM_MAX_RECORDERS) {
+            NSLog(@"[MoltenVKBridge] ❌ Too many recording threads (max %d)", STREAM_MAX_RECORDERS);
+            return NULL;
+        }
+        recorder = malloc(sizeof(D3DCommandRecorder));
+        if (!recorder) {
+            return NULL;
         }
+        d3d_recorder_init(recorder);
+        _recorders[_recorderCount++] = recorder;
+        pthread_setspecific(_recorderKey, recorder);
+        return recorder;
+        
+    } @finally {
+        [_recorderLock unlock];
+    }
+}
+
+// 在 endFrame 中、持有 _bridgeLock 和 _recordLock 写锁时调用
+- (void)encodeRecordedCommands {
+    D3DCommandRecorder *recorders[STREAM_MAX_RECORDERS];
+    uint32_t recorderCount;
+    [_recorderLock lock];
+    @try {
+        recorderCount = _recorderCount;
+        memcpy(recorders, _recorders, recorderCount * sizeof(recorders[0]));
+    } @finally {
+        [_recorderLock unlock];
+    }
+    
+    double startTime = [NSDate timeIntervalSinceReferenceDate];
+    
+    if (!d3d_stream_build(&_commandStream, recorders, recorderCount)) {
+        NSLog(@"[MoltenVKBridge] ❌ Out of memory building command stream, frame dropped");
+    } else {
+        const uint32_t partCount = d3d_stream_split(&_commandStream, d3d_encode_pool_workers(_encodePool) + 1,
+                                                    STREAM_MIN_PACKETS_PER_PART);
+        if (partCount > _streamPartCapacity) {
+            MetalStreamPart *parts = realloc(_streamParts, partCount * sizeof(MetalStreamPart));
+            if (parts) {
+                _streamParts = parts;
+                _streamPartCapacity = partCount;
+            }
+        }
+        
+        if (partCount == 0 && _commandStream.count > 0) {
+            NSLog(@"[MoltenVKBridge] ❌ Out of memory splitting command stream, frame dropped");
+            _streamFailedCalls += _commandStream.count;
+        } else if (partCount > _streamPartCapacity) {
+            NSLog(@"[MoltenVKBridge] ❌ Out of memory allocating encoder parts, frame dropped");
+            _streamFailedCalls += _commandStream.count;
+        } else if (partCount > 0) {
+            MetalStreamFrame frame = {
+                .commandBuffer = _currentCommandBuffer,
+                .descriptor = _passDescriptor,
+                .pipelineState = _currentPipelineState,
+                .parallelEncoder = NULL,
+                .parts = _streamParts,
+            };
+            const D3DStreamBackend backend = {
+                .begin_pass = MetalStreamBeginPass,
+                .begin_part = MetalStreamBeginPart,
+                .encode = MetalStreamEncode,
+                .end_part = MetalStreamEndPart,
+                .end_pass = MetalStreamEndPass,
+                .submit = NULL,             // 子编码器按创建顺序执行，由 presentFrame 提交命令缓冲区
+                .user = &frame,
+            };
+            D3DEncodeResult result = d3d_stream_encode(&_commandStream, _encodePool, &backend);
+            _streamPartsEncoded += result.parts;
+            _streamPasses += result.passes;
+            _streamFailedCalls += result.failed;
+            if (result.failed && _debugModeEnabled) {
+                NSLog(@"[MoltenVKBridge] %llu recorded calls failed to encode", (unsigned long long)result.failed);
+            }
+        }
+        
+        _streamPackets += _commandStream.count;
+        for (uint32_t i = 0; i < recorderCount; i++) {
+            _streamBytes += recorders[i]->bytes;
+        }
+        // 状态跨帧保留：下一帧的第一个部分继承本帧最后的状态
+        if (!d3d_stream_end_frame(&_commandStream)) {
+            NSLog(@"[MoltenVKBridge] ❌ Out of memory saving command stream state");
+        }
+    }
+    
+    for (uint32_t i = 0; i < recorderCount; i++) {
+        d3d_recorder_reset(recorders[i]);
+    }
+    _streamFrames++;
+    _streamEncodeTime += [NSDate timeIntervalSinceReferenceDate] - startTime;
+}
+
+- (NSDictionary *)getCommandStreamStatistics {
+    [_bridgeLock lock];
+    
+    @try {
+        return @{
+            @"enabled": @(_commandStreamEnabled),
+            @"encode_workers": @(d3d_encode_pool_workers(_encodePool)),
+            @"recorders": @(_recorderCount),
+            @"frames": @(_streamFrames),
+            @"packets": @(_streamPackets),
+            @"bytes": @(_streamBytes),
+            @"parts": @(_streamPartsEncoded),
+            @"passes": @(_streamPasses),
+            @"failed_calls": @(_streamFailedCalls),
+            @"average_encode_time": @(_streamFrames ? _streamEncodeTime / _streamFrames : 0.0)
+        };
         
     } @finally {
         [_bridgeLock unlock];
     }
 }
 
-- (void)endPerformanceMarker:(NSString *)name {
+#pragma mark - 多帧并行
+
+// 本帧不会提交：交回凭据，丢掉未提交的命令缓冲区（持有 _bridgeLock 时调用）
+- (void)abandonFrame {
+    if (_hasFrameTicket) {
+        d3d_pacer_frame_completed(&_framePacer, &_frameTicket);
+        _hasFrameTicket = NO;
+    }
+    _currentRenderEncoder = nil;
+    _currentCommandBuffer = nil;
+    _currentDrawable = nil;
+    _passDescriptor = nil;
+}
+
+- (NSUInteger)maxFramesInFlight {
     [_bridgeLock lock];
     
     @try {
-        double endTime = [NSDate timeIntervalSinceReferenceDate];
+        return _maxFramesInFlight;
+    } @finally {
+        [_bridgeLock unlock];
+    }
+}
+
+- (void)setMaxFramesInFlight:(NSUInteger)maxFramesInFlight {
+    [_bridgeLock lock];
+    
+    @try {
+        if (maxFramesInFlight == _maxFramesInFlight) return;
         
-        for (NSValue *markerValue in _performanceMarkers) {
-            PerformanceMarker marker;
-            [markerValue getValue:&marker];
-            
-            if (marker.isActive && strcmp(marker.name, name.UTF8String) == 0) {
-                marker.endTime = endTime;
-                marker.isActive = NO;
-                
-                // 更新数组中的值
-                NSValue *updatedValue = [NSValue value:&marker withObjCType:@encode(PerformanceMarker)];
-                NSUInteger index = [_performanceMarkers indexOfObject:markerValue];
-                [_performanceMarkers replaceObjectAtIndex:index withObject:updatedValue];
-                
-                if (_debugModeEnabled) {
-                    double duration = marker.endTime - marker.startTime;
-                    NSLog(@"[MoltenVKBridge] Performance marker ended: %@ (%.3fms)", name, duration * 1000);
-                }
-                
-                break;
-            }
+        if (maxFramesInFlight == 0 || maxFramesInFlight > D3D_PACER_MAX_FRAMES_IN_FLIGHT) {
+            NSLog(@"[MoltenVKBridge] Invalid frames in flight: %lu", (unsigned long)maxFramesInFlight);
+            return;
+        }
+        
+        if (_frameInProgress || _hasFrameTicket) {
+            NSLog(@"[MoltenVKBridge] Cannot change frames in flight while a frame is in progress");
+            return;
+        }
+        
+        // 槽位和上传分区都跟着变，先等已提交的帧完成
+        [self waitForGPUIdle];
+        if (d3d_pacer_in_flight(&_framePacer) != 0) {
+            NSLog(@"[MoltenVKBridge] Cannot change frames in flight - GPU still busy");
+            return;
         }
         
+        const D3DFramePacerStats stats = d3d_pacer_stats(&_framePacer);
+        const uint64_t refresh = _framePacer.refresh_interval_ns;
+        d3d_pacer_destroy(&_framePacer);
+        d3d_pacer_init(&_framePacer, (uint32_t)maxFramesInFlight, refresh, FRAME_UPLOAD_REGION_SIZE);
+        _framePacer.stats = stats;
+        _maxFramesInFlight = maxFramesInFlight;
+        
+        if (_metalDevice) {
+            _uploadBuffer = [_metalDevice newBufferWithLength:FRAME_UPLOAD_REGION_SIZE * _maxFramesInFlight
+                                                      options:MTLResourceStorageModeShared];
+            _uploadBuffer.label = @"MoltenVKBridge Frame Upload Buffer";
+        }
+        
+        NSLog(@"[MoltenVKBridge] Frames in flight set to %lu", (unsigned long)maxFramesInFlight);
+        
     } @finally {
         [_bridgeLock unlock];
     }
 }
 
-- (NSDictionary *)getPerformanceMetrics {
+- (nullable id<MTLBuffer>)uploadBuffer {
+    return _uploadBuffer;
+}
+
+- (nullable void *)allocateUploadMemory:(NSUInteger)length alignment:(NSUInteger)alignment offset:(NSUInteger *)offset {
     [_bridgeLock lock];
     
     @try {
-        NSMutableArray *metrics = [NSMutableArray array];
-        double totalTime = 0;
+        if (!_hasFrameTicket || !_uploadBuffer) {
+            NSLog(@"[MoltenVKBridge] Cannot allocate upload memory outside a frame");
+            return NULL;
+        }
         
-        for (NSValue *markerValue in _performanceMarkers) {
-            PerformanceMarker marker;
-            [markerValue getValue:&marker];
-            
-            if (!marker.isActive && marker.endTime > 0) {
-                double duration = marker.endTime - marker.startTime;
-                totalTime += duration;
-                
-                [metrics addObject:@{
-                    @"name": [NSString stringWithUTF8String:marker.name],
-                    @"duration": @(duration),
-                    @"start_time": @(marker.startTime),
-                    @"end_time": @(marker.endTime)
-                }];
-            }
+        uint64_t uploadOffset = 0;
+        if (!d3d_pacer_upload(&_framePacer, &_frameTicket, length, alignment, &uploadOffset)) {
+            NSLog(@"[MoltenVKBridge] Upload region exhausted (%lu bytes requested)", (unsigned long)length);
+            return NULL;
         }
         
-        return @{
-            @"markers": metrics,
-            @"total_time": @(totalTime),
-            @"marker_count": @(metrics.count),
-            @"active_markers": @([_performanceMarkers filteredArrayUsingPredicate:[NSPredicate predicateWithBlock:^BOOL(NSValue *value, NSDictionary *bindings) {
-                PerformanceMarker marker;
-                [value getValue:&marker];
-                return marker.isActive;
-            }]].count)
-        };
+        if (offset) {
+            *offset = (NSUInteger)uploadOffset;
+        }
+        return (uint8_t *)_uploadBuffer.contents + uploadOffset;
         
     } @finally {
         [_bridgeLock unlock];
     }
 }
 
+- (BOOL)shouldRenderFrame {
+    return d3d_pacer_should_render(&_framePacer);
+}
+
+- (void)setDisplayRefreshInterval:(NSTimeInterval)interval {
+    if (interval > 0) {
+        d3d_pacer_set_refresh_interval(&_framePacer, (uint64_t)(interval * 1e9));
+    }
+}
+
+- (void)waitForGPUIdle {
+    const uint32_t recording = _hasFrameTicket ? 1 : 0;
+    if (!_commandQueue || d3d_pacer_in_flight(&_framePacer) == recording) {
+        return;
+    }
+    
+    // 同一队列按提交顺序完成，空命令缓冲区完成时之前的帧都已完成
+    id<MTLCommandBuffer> fence = [_commandQueue commandBuffer];
+    fence.label = @"MoltenVKBridge Idle Fence";
+    [fence commit];
+    [fence waitUntilCompleted];
+    
+    // waitUntilCompleted 只等GPU，不等完成回调：回调在 Metal 的线程上稍后交回凭据，之后槽位才空出来
+    if (!d3d_pacer_wait_in_flight(&_framePacer, recording, FRAME_BEGIN_TIMEOUT_NS)) {
+        NSLog(@"[MoltenVKBridge] ⚠️ GPU idle but %u frame completion handlers still pending",
+              d3d_pacer_in_flight(&_framePacer) - recording);
+    }
+}
+
+- (NSDictionary *)getFramePacingStatistics {
+    const D3DFramePacerStats stats = d3d_pacer_stats(&_framePacer);
+    
+    return @{
+        @"max_frames_in_flight": @(_maxFramesInFlight),
+        @"frames_in_flight": @(d3d_pacer_in_flight(&_framePacer)),
+        @"frames_begun": @(stats.frames_begun),
+        @"frames_completed": @(stats.frames_completed),
+        @"late_frames": @(stats.late_frames),
+        @"skipped_refreshes": @(stats.skipped_refreshes),
+        @"timeouts": @(stats.timeouts),
+        @"average_wait_time": @(stats.frames_begun ? stats.wait_ns_total / 1e9 / stats.frames_begun : 0.0),
+        @"max_wait_time": @(stats.wait_ns_max / 1e9),
+        @"average_latency": @(stats.frames_completed ? stats.latency_ns_total / 1e9 / stats.frames_completed : 0.0),
+        @"max_latency": @(stats.latency_ns_max / 1e9),
+        @"upload_peak": @(stats.upload_peak),
+        @"upload_failures": @(stats.upload_failures)
+    };
+}
+
+#pragma mark - 性能监控
+
+// 名字每次都查无锁登记表；热路径用 performanceMarkerWithName: 取一次ID再按ID记录
+// 不取 _bridgeLock：标记在任意线程记录，各线程写自己的环
+- (void)beginPerformanceMarker:(NSString *)name {
+    wine_prof_begin(wine_prof_intern(name.UTF8String));
+}
+
+- (void)endPerformanceMarker:(NSString *)name {
+    wine_prof_end(wine_prof_intern(name.UTF8String));
+}
+
+- (WineProfMarker)performanceMarkerWithName:(NSString *)name {
+    return wine_prof_intern(name.UTF8String);
+}
+
+- (void)beginPerformanceMarkerWithID:(WineProfMarker)marker {
+    wine_prof_begin(marker);
+}
+
+- (void)endPerformanceMarkerWithID:(WineProfMarker)marker {
+    wine_prof_end(marker);
+}
+
+- (void)setPerformanceMarkersEnabled:(BOOL)enabled {
+    wine_prof_set_enabled(enabled);
+}
+
+- (BOOL)performanceMarkersEnabled {
+    return wine_prof_is_enabled();
+}
+
+- (void)resetPerformanceMetrics {
+    wine_prof_reset();
+}
+
+// 每个标记一项：次数、总耗时/自身耗时和分位数（秒）；自身耗时扣除了嵌套的子标记，帧内各阶段之和即整帧
+- (NSDictionary *)getPerformanceMetrics {
+    NSMutableArray *metrics = [NSMutableArray array];
+    uint32_t markerCount = wine_prof_marker_count();
+    
+    for (uint32_t marker = 0; marker < markerCount; marker++) {
+        WineProfMarkerStats stats;
+        if (!wine_prof_get_marker_stats((WineProfMarker)marker, &stats)) {
+            continue;
+        }
+        [metrics addObject:@{
+            @"name": [NSString stringWithUTF8String:wine_prof_marker_name((WineProfMarker)marker)],
+            @"count": @(stats.count),
+            @"total_time": @(stats.total_ns / 1e9),
+            @"self_time": @(stats.self_ns / 1e9),
+            @"average": @(stats.total_ns / 1e9 / stats.count),
+            @"min": @(stats.min_ns / 1e9),
+            @"max": @(stats.max_ns / 1e9),
+            @"p50": @(stats.p50_ns / 1e9),
+            @"p95": @(stats.p95_ns / 1e9),
+            @"p99": @(stats.p99_ns / 1e9)
+        }];
+    }
+    
+    WineProfCounters counters;
+    wine_prof_get_counters(&counters);
+    WineProfMarkerStats frameStats;
+    BOOL hasFrames = wine_prof_get_marker_stats(_frameMarker, &frameStats);
+    
+    return @{
+        @"markers": metrics,
+        @"marker_count": @(metrics.count),
+        @"frame_count": @(hasFrames ? frameStats.count : 0),
+        @"frame_p50": @(hasFrames ? frameStats.p50_ns / 1e9 : 0),
+        @"frame_p99": @(hasFrames ? frameStats.p99_ns / 1e9 : 0),
+        @"events": @(counters.events),
+        @"threads": @(counters.threads),
+        @"unmatched_ends": @(counters.unmatched_ends),
+        @"implicit_ends": @(counters.implicit_ends),
+        @"depth_overflows": @(counters.depth_overflows),
+        @"dropped_threads": @(counters.dropped_threads)
+    };
+}
+
+- (BOOL)exportPerformanceTraceToPath:(NSString *)path {
+    FILE *file = fopen(path.fileSystemRepresentation, "w");
+    if (!file) {
+        NSLog(@"[MoltenVKBridge] Cannot open trace file %@: %s", path, strerror(errno));
+        return NO;
+    }
+    uint64_t events = wine_prof_export_chrome_trace(file);
+    BOOL success = (fclose(file) == 0);
+    if (success) {
+        NSLog(@"[MoltenVKBridge] Exported %llu trace events to %@", events, path);
+    } else {
+        NSLog(@"[MoltenVKBridge] Failed to write trace file %@", path);
+    }
+    return success;
+}
+
 #pragma mark - 调试支持
 
 - (NSString *)getSystemInfo {
@@ -609,7 +1184,7 @@ NSError *MoltenVKBridgeError(NSString *domain, NSInteger code, NSString *descrip
             [info appendFormat:@"Metal Layer Pixel Format: %lu\n", (unsigned long)_metalLayer.pixelFormat];
         }
         
-        [info appendFormat:@"Performance Markers: %lu\n", (unsigned long)_performanceMarkers.count];
+        [info appendFormat:@"Performance Markers: %u\n", wine_prof_marker_count()];
         [info appendFormat:@"Vulkan Instance: %p\n", _vulkanInstance];
         [info appendFormat:@"Vulkan Device: %p\n", _vulkanDevice];
         
@@ -780,9 +1355,71 @@ NSError *MoltenVKBridgeError(NSString *domain, NSInteger code, NSString *descrip
 
 #pragma mark - DirectXToVulkanTranslator实现
 
+// 打开日志时保留的最近调用数
+#define TRANSLATION_LOG_CAPACITY    4096
+
+#define SHADER_TRANSLATOR_VERSION   1                       // 翻译输出变化时加1，旧缓存条目自然失效
+#define SHADER_CACHE_DIRECTORY      @"shader_cache"
+#define SHADER_CACHE_LIMIT          (128ULL * 1024 * 1024)
+
 @implementation DirectXToVulkanTranslator {
-    NSMutableString *_translationLog;
-    NSRecursiveLock *_translatorLock;
+    D3DDispatchTable _dispatch;
+    NSRecursiveLock *_translatorLock;       // 只保护日志开关和日志读取，分派本身不加锁
+    _Atomic uint64_t _warnedOpcodes;        // 每个没有处理函数的操作码只警告一次
+    
+    // 着色器磁盘缓存：查找结果指向映射内存，写入会重新映射，所以复制出来之前一直持有 _shaderCacheLock
+    D3DShaderDiskCache *_shaderCache;
+    NSLock *_shaderCacheLock;
+    uint64_t _shadersTranslated;
+    double _shaderTranslateTime;
+}
+
+#pragma mark - 操作码处理函数
+
+// 处理函数在分派表里按操作码索引，user 为翻译器本身（不持有）
+static inline DirectXToVulkanTranslator *TranslatorFromUser(void *user) {
+    return (__bridge DirectXToVulkanTranslator *)user;
+}
+
+static bool HandleCreateDevice(const D3DCall *call, void *user) {
+    MoltenVKBridge *bridge = TranslatorFromUser(user)->_bridge;
+    if (!bridge.isInitialized) {
+        NSLog(@"[DirectXToVulkanTranslator] Bridge not initialized, initializing now...");
+        if (![bridge initializeBridge]) {
+            NSLog(@"[DirectXToVulkanTranslator] Failed to initialize bridge");
+            return false;
+        }
+    }
+    return true;
+}
+
+// 所有绘制都需要进行中的帧和渲染编码器
+static bool HandleDraw(const D3DCall *call, void *user) {
+    MoltenVKBridge *bridge = TranslatorFromUser(user)->_bridge;
+    if (![bridge beginFrame]) {
+        return false;
+    }
+    // 在真实实现中，这里按 call->args 转换索引/顶点范围并执行Metal绘制调用
+    return bridge.currentRenderEncoder != nil;
+}
+
+// 资源创建、着色器绑定和状态设置目前只做模拟
+static bool HandleAccepted(const D3DCall *call, void *user) {
+    return true;
+}
+
+// 认识但还没有实现的操作码：第一次时警告，之后直接视为成功，避免阻断执行
+static bool HandleUnimplemented(const D3DCall *call, void *user) {
+    DirectXToVulkanTranslator *translator = TranslatorFromUser(user);
+    const uint64_t bit = 1ULL << (call->opcode & 63);
+    if (!(atomic_fetch_or_explicit(&translator->_warnedOpcodes, bit, memory_order_relaxed) & bit)) {
+        NSString *name = @(d3d_opcode_name((D3DOpcode)call->opcode));
+        NSLog(@"[DirectXToVulkanTranslator] No handler for %@, treating as success", name);
+        if (translator->_bridge.warningHandler) {
+            translator->_bridge.warningHandler([NSString stringWithFormat:@"未支持的DirectX函数: %@", name]);
+        }
+    }
+    return true;
 }
 
 + (instancetype)translatorWithBridge:(MoltenVKBridge *)bridge {
@@ -794,226 +1431,113 @@ NSError *MoltenVKBridgeError(NSString *domain, NSInteger code, NSString *descrip
 - (instancetype)init {
     self = [super init];
     if (self) {
-        _translationLog = [NSMutableString string];
         _translatorLock = [[NSRecursiveLock alloc] init];
+        _shaderCacheLock = [[NSLock alloc] init];
+        atomic_init(&_warnedOpcodes, 0);
+        d3d_dispatch_init(&_dispatch, HandleUnimplemented, (__bridge void *)self);
+        
+        d3d_dispatch_set_handler(&_dispatch, D3D_OP_CREATE_DEVICE, HandleCreateDevice);
+        d3d_dispatch_set_handler(&_dispatch, D3D_OP_CREATE_DEVICE_AND_SWAP_CHAIN, HandleCreateDevice);
+        for (int op = D3D_OP_DRAW; op <= D3D_OP_DRAW_INDEXED_INSTANCED; op++) {
+            d3d_dispatch_set_handler(&_dispatch, (D3DOpcode)op, HandleDraw);
+        }
+        for (int op = D3D_OP_CREATE_BUFFER; op <= D3D_OP_RS_SET_STATE; op++) {
+            d3d_dispatch_set_handler(&_dispatch, (D3DOpcode)op, HandleAccepted);
+        }
         NSLog(@"[DirectXToVulkanTranslator] Translator initialized");
     }
     return self;
 }
 
-#pragma mark - 主要翻译方法
+- (void)dealloc {
+    d3d_dispatch_destroy(&_dispatch);
+    d3d_shader_cache_close(_shaderCache);
+}
 
-- (BOOL)translateDirectXCall:(NSString *)functionName parameters:(NSArray *)parameters {
-    [_translatorLock lock];
-    
-    @try {
-        NSLog(@"[DirectXToVulkanTranslator] Translating DirectX call: %@ with %lu parameters",
-              functionName, (unsigned long)parameters.count);
-        
-        // 记录翻译日志
-        [_translationLog appendFormat:@"[%@] Translating: %@(%@)\n",
-         [NSDate date], functionName, [parameters componentsJoinedByString:@", "]];
-        
-        // 检测函数类型并分发处理
-        DirectXFunctionType functionType = [self detectFunctionType:functionName];
-        
-        BOOL result = NO;
-        
-        switch (functionType) {
-            case DirectXFunctionTypeDevice:
-                result = [self handleDeviceCreation:functionName parameters:parameters];
-                break;
-                
-            case DirectXFunctionTypeDraw:
-                result = [self handleDrawCall:functionName parameters:parameters];
-                break;
-                
-            case DirectXFunctionTypeResource:
-                result = [self handleResourceCreation:functionName parameters:parameters];
-                break;
-                
-            case DirectXFunctionTypeShader:
-                result = [self handleShaderOperation:functionName parameters:parameters];
-                break;
-                
-            case DirectXFunctionTypeState:
-                result = [self handleStateChange:functionName parameters:parameters];
-                break;
-                
-            case DirectXFunctionTypeContext:
-            default:
-                NSLog(@"[DirectXToVulkanTranslator] Unsupported function type for: %@", functionName);
-                result = [self handleGenericFunction:functionName parameters:parameters];
-                break;
-        }
-        
-        // 记录结果
-        [_translationLog appendFormat:@"[%@] Result: %@\n", [NSDate date], result ? @"SUCCESS" : @"FAILED"];
-        
-        return result;
-        
-    } @finally {
-        [_translatorLock unlock];
+#pragma mark - 操作码接口
+
+- (D3DOpcode)bindFunction:(NSString *)functionName {
+    D3DOpcode opcode = d3d_opcode_lookup(functionName.UTF8String);
+    if (opcode == D3D_OP_INVALID) {
+        NSLog(@"[DirectXToVulkanTranslator] Unknown DirectX function: %@", functionName);
     }
+    return opcode;
 }
 
-#pragma mark - 特定函数类型处理
+- (BOOL)executeCall:(const D3DCall *)call {
+    return d3d_dispatch(&_dispatch, call);
+}
 
-- (BOOL)handleDeviceCreation:(NSString *)functionName parameters:(NSArray *)parameters {
-    NSLog(@"[DirectXToVulkanTranslator] Handling device creation: %@", functionName);
-    
-    if ([functionName isEqualToString:@"D3D11CreateDevice"] ||
-        [functionName isEqualToString:@"D3D11CreateDeviceAndSwapChain"]) {
-        
-        // 模拟设备创建
-        NSLog(@"[DirectXToVulkanTranslator] Creating D3D11 device -> Vulkan device mapping");
-        
-        // 确保MoltenVK桥接已初始化
-        if (!_bridge.isInitialized) {
-            NSLog(@"[DirectXToVulkanTranslator] Bridge not initialized, initializing now...");
-            if (![_bridge initializeBridge]) {
-                NSLog(@"[DirectXToVulkanTranslator] Failed to initialize bridge");
-                return NO;
-            }
-        }
-        
-        return YES;
-    }
-    
-    NSLog(@"[DirectXToVulkanTranslator] Unknown device function: %@", functionName);
-    return NO;
+- (BOOL)loggingEnabled {
+    return atomic_load_explicit(&_dispatch.log.capacity, memory_order_relaxed) != 0;
 }
 
-- (BOOL)handleDrawCall:(NSString *)functionName parameters:(NSArray *)parameters {
-    NSLog(@"[DirectXToVulkanTranslator] Handling draw call: %@", functionName);
-    
-    // 确保帧在进行中
-    if (!_bridge.frameInProgress) {
-        NSLog(@"[DirectXToVulkanTranslator] Starting frame for draw call");
-        if (![_bridge beginFrame]) {
-            NSLog(@"[DirectXToVulkanTranslator] Failed to begin frame");
-            return NO;
-        }
-    }
-    
-    if ([functionName hasPrefix:@"Draw"]) {
-        // 处理各种绘制调用
-        if ([functionName isEqualToString:@"DrawIndexed"]) {
-            return [self handleDrawIndexed:parameters];
-        } else if ([functionName isEqualToString:@"Draw"]) {
-            return [self handleDraw:parameters];
-        } else if ([functionName isEqualToString:@"DrawInstanced"]) {
-            return [self handleDrawInstanced:parameters];
+- (void)setLoggingEnabled:(BOOL)loggingEnabled {
+    [_translatorLock lock];
+    @try {
+        if (!d3d_dispatch_enable_log(&_dispatch, loggingEnabled ? TRANSLATION_LOG_CAPACITY : 0)) {
+            NSLog(@"[DirectXToVulkanTranslator] ❌ Failed to allocate translation log");
         }
+    } @finally {
+        [_translatorLock unlock];
     }
-    
-    NSLog(@"[DirectXToVulkanTranslator] Unknown draw function: %@", functionName);
-    return NO;
 }
 
-- (BOOL)handleDrawIndexed:(NSArray *)parameters {
-    NSLog(@"[DirectXToVulkanTranslator] Translating DrawIndexed");
-    
-    // 在真实实现中，这里会：
-    // 1. 转换索引缓冲区
-    // 2. 设置渲染状态
-    // 3. 执行Metal绘制调用
-    
-    // 模拟实现
-    if (_bridge.currentRenderEncoder) {
-        // 这里应该执行实际的Metal绘制调用
-        NSLog(@"[DirectXToVulkanTranslator] Executing Metal draw call");
-        return YES;
-    }
-    
-    return NO;
-}
+#pragma mark - 主要翻译方法
 
-- (BOOL)handleDraw:(NSArray *)parameters {
-    NSLog(@"[DirectXToVulkanTranslator] Translating Draw");
-    
-    // 模拟简单绘制
-    if (_bridge.currentRenderEncoder) {
-        NSLog(@"[DirectXToVulkanTranslator] Executing Metal draw primitives");
-        return YES;
+- (BOOL)translateDirectXCall:(NSString *)functionName parameters:(NSArray *)parameters {
+    D3DOpcode opcode = d3d_opcode_lookup(functionName.UTF8String);
+    if (opcode == D3D_OP_INVALID) {
+        return [self handleGenericFunction:functionName parameters:parameters];
     }
-    
-    return NO;
+    D3DCall call = { .opcode = (uint16_t)opcode };
+    [self packParameters:parameters intoCall:&call];
+    return [self executeCall:&call];
 }
 
-- (BOOL)handleDrawInstanced:(NSArray *)parameters {
-    NSLog(@"[DirectXToVulkanTranslator] Translating DrawInstanced");
-    
-    // 模拟实例化绘制
-    if (_bridge.currentRenderEncoder) {
-        NSLog(@"[DirectXToVulkanTranslator] Executing Metal instanced draw");
-        return YES;
+// NSNumber 参数按顺序放进 raw，其他类型的参数按0处理
+- (void)packParameters:(NSArray *)parameters intoCall:(D3DCall *)call {
+    const NSUInteger count = MIN(parameters.count, (NSUInteger)D3D_CALL_MAX_ARGS);
+    for (NSUInteger i = 0; i < count; i++) {
+        id parameter = parameters[i];
+        call->args.raw[i] = [parameter isKindOfClass:[NSNumber class]] ? [parameter unsignedLongLongValue] : 0;
     }
-    
-    return NO;
+    call->arg_count = (uint16_t)count;
 }
 
-- (BOOL)handleResourceCreation:(NSString *)functionName parameters:(NSArray *)parameters {
-    NSLog(@"[DirectXToVulkanTranslator] Handling resource creation: %@", functionName);
-    
-    if ([functionName containsString:@"CreateBuffer"]) {
-        return [self handleCreateBuffer:parameters];
-    } else if ([functionName containsString:@"CreateTexture"]) {
-        return [self handleCreateTexture:parameters];
-    } else if ([functionName containsString:@"CreateShader"]) {
-        return [self handleCreateShader:parameters];
+#pragma mark - 特定函数类型处理
+
+// 名字必须是该类别下已知的函数，否则与原来一样返回NO
+- (BOOL)dispatchFunction:(NSString *)functionName parameters:(NSArray *)parameters
+                category:(DirectXFunctionType)category {
+    D3DOpcode opcode = d3d_opcode_lookup(functionName.UTF8String);
+    if (opcode == D3D_OP_INVALID || (DirectXFunctionType)d3d_opcode_category(opcode) != category) {
+        NSLog(@"[DirectXToVulkanTranslator] Unknown function for category %d: %@", (int)category, functionName);
+        return NO;
     }
-    
-    NSLog(@"[DirectXToVulkanTranslator] Unknown resource function: %@", functionName);
-    return NO;
+    D3DCall call = { .opcode = (uint16_t)opcode };
+    [self packParameters:parameters intoCall:&call];
+    return [self executeCall:&call];
 }
 
-- (BOOL)handleCreateBuffer:(NSArray *)parameters {
-    NSLog(@"[DirectXToVulkanTranslator] Creating buffer resource");
-    // 模拟缓冲区创建
-    return YES;
+- (BOOL)handleDeviceCreation:(NSString *)functionName parameters:(NSArray *)parameters {
+    return [self dispatchFunction:functionName parameters:parameters category:DirectXFunctionTypeDevice];
 }
 
-- (BOOL)handleCreateTexture:(NSArray *)parameters {
-    NSLog(@"[DirectXToVulkanTranslator] Creating texture resource");
-    // 模拟纹理创建
-    return YES;
+- (BOOL)handleDrawCall:(NSString *)functionName parameters:(NSArray *)parameters {
+    return [self dispatchFunction:functionName parameters:parameters category:DirectXFunctionTypeDraw];
 }
 
-- (BOOL)handleCreateShader:(NSArray *)parameters {
-    NSLog(@"[DirectXToVulkanTranslator] Creating shader resource");
-    // 模拟着色器创建
-    return YES;
+- (BOOL)handleResourceCreation:(NSString *)functionName parameters:(NSArray *)parameters {
+    return [self dispatchFunction:functionName parameters:parameters category:DirectXFunctionTypeResource];
 }
 
 - (BOOL)handleShaderOperation:(NSString *)functionName parameters:(NSArray *)parameters {
-    NSLog(@"[DirectXToVulkanTranslator] Handling shader operation: %@", functionName);
-    
-    // 处理着色器相关操作
-    if ([functionName containsString:@"SetVertexShader"]) {
-        NSLog(@"[DirectXToVulkanTranslator] Setting vertex shader");
-        return YES;
-    } else if ([functionName containsString:@"SetPixelShader"]) {
-        NSLog(@"[DirectXToVulkanTranslator] Setting pixel shader");
-        return YES;
-    }
-    
-    return NO;
+    return [self dispatchFunction:functionName parameters:parameters category:DirectXFunctionTypeShader];
 }
 
 - (BOOL)handleStateChange:(NSString *)functionName parameters:(NSArray *)parameters {
-    NSLog(@"[DirectXToVulkanTranslator] Handling state change: %@", functionName);
-    
-    // 处理状态变更
-    if ([functionName containsString:@"SetRenderState"]) {
-        NSLog(@"[DirectXToVulkanTranslator] Setting render state");
-        return YES;
-    } else if ([functionName containsString:@"SetSamplerState"]) {
-        NSLog(@"[DirectXToVulkanTranslator] Setting sampler state");
-        return YES;
-    }
-    
-    return NO;
+    return [self dispatchFunction:functionName parameters:parameters category:DirectXFunctionTypeState];
 }
 
 - (BOOL)handleGenericFunction:(NSString *)functionName parameters:(NSArray *)parameters {
@@ -1029,35 +1553,9 @@ NSError *MoltenVKBridgeError(NSString *domain, NSInteger code, NSString *descrip
 
 #pragma mark - 函数类型检测
 
+// 已知函数按操作码表分类，未知函数归为上下文调用
 - (DirectXFunctionType)detectFunctionType:(NSString *)functionName {
-    if ([functionName containsString:@"CreateDevice"] ||
-        [functionName containsString:@"GetDevice"]) {
-        return DirectXFunctionTypeDevice;
-    }
-    
-    if ([functionName hasPrefix:@"Draw"] || [functionName hasSuffix:@"Draw"]) {
-        return DirectXFunctionTypeDraw;
-    }
-    
-    if ([functionName containsString:@"Create"] &&
-        ([functionName containsString:@"Buffer"] ||
-         [functionName containsString:@"Texture"] ||
-         [functionName containsString:@"Shader"])) {
-        return DirectXFunctionTypeResource;
-    }
-    
-    if ([functionName containsString:@"Shader"] ||
-        [functionName containsString:@"SetVertexShader"] ||
-        [functionName containsString:@"SetPixelShader"]) {
-        return DirectXFunctionTypeShader;
-    }
-    
-    if ([functionName containsString:@"SetState"] ||
-        [functionName containsString:@"State"]) {
-        return DirectXFunctionTypeState;
-    }
-    
-    return DirectXFunctionTypeContext;
+    return (DirectXFunctionType)d3d_opcode_category(d3d_opcode_lookup(functionName.UTF8String));
 }
 
 #pragma mark - 参数转换
@@ -1079,11 +1577,27 @@ NSError *MoltenVKBridgeError(NSString *domain, NSInteger code, NSString *descrip
 
 #pragma mark - 调试支持
 
+// 日志环里的记录到这里才格式化，时间为相对第一条记录的毫秒数
 - (NSString *)getTranslationLog {
     [_translatorLock lock];
     
     @try {
-        return [_translationLog copy];
+        const uint32_t capacity = atomic_load_explicit(&_dispatch.log.capacity, memory_order_relaxed);
+        if (capacity == 0) {
+            return @"";
+        }
+        D3DCallRecord *records = malloc(capacity * sizeof(D3DCallRecord));
+        if (!records) {
+            return @"";
+        }
+        const uint32_t count = d3d_dispatch_copy_log(&_dispatch, records, capacity);
+        NSMutableString *log = [NSMutableString string];
+        for (uint32_t i = 0; i < count; i++) {
+            [log appendFormat:@"[+%.3f ms] %s: %@\n", (records[i].timestamp_ns - records[0].timestamp_ns) / 1e6,
+             d3d_opcode_name((D3DOpcode)records[i].opcode), records[i].result ? @"SUCCESS" : @"FAILED"];
+        }
+        free(records);
+        return [log copy];
     } @finally {
         [_translatorLock unlock];
     }
@@ -1093,11 +1607,156 @@ NSError *MoltenVKBridgeError(NSString *domain, NSInteger code, NSString *descrip
     [_translatorLock lock];
     
     @try {
-        [_translationLog setString:@""];
+        d3d_dispatch_clear_log(&_dispatch);
         NSLog(@"[DirectXToVulkanTranslator] Translation log cleared");
     } @finally {
         [_translatorLock unlock];
     }
 }
 
+- (NSDictionary *)getDispatchStatistics {
+    NSMutableDictionary *calls = [NSMutableDictionary dictionary];
+    uint64_t total = 0;
+    for (int op = D3D_OP_INVALID; op < D3D_OP_COUNT; op++) {
+        const uint64_t count = atomic_load_explicit(&_dispatch.calls[op], memory_order_relaxed);
+        if (count) {
+            calls[@(d3d_opcode_name((D3DOpcode)op))] = @(count);
+            total += count;
+        }
+    }
+    return @{
+        @"calls": calls,
+        @"total_calls": @(total),
+        @"failures": @(atomic_load_explicit(&_dispatch.failures, memory_order_relaxed)),
+        @"logging_enabled": @(self.loggingEnabled),
+    };
+}
+
+#pragma mark - 着色器翻译缓存
+
+- (BOOL)openShaderCacheInPrefix:(NSString *)prefixPath {
+    NSString *directory = [prefixPath stringByAppendingPathComponent:SHADER_CACHE_DIRECTORY];
+    NSError *error = nil;
+    if (![[NSFileManager defaultManager] createDirectoryAtPath:directory
+                                   withIntermediateDirectories:YES
+                                                    attributes:nil
+                                                         error:&error]) {
+        NSLog(@"[DirectXToVulkanTranslator] ❌ Failed to create shader cache directory: %@", error);
+        return NO;
+    }
+    
+    D3DShaderDiskCache *cache = d3d_shader_cache_open(directory.fileSystemRepresentation, SHADER_CACHE_LIMIT);
+    if (!cache) {
+        NSLog(@"[DirectXToVulkanTranslator] ❌ Failed to open shader cache at %@", directory);
+        return NO;
+    }
+    
+    // 统计在锁内读取：解锁后另一个线程可能已经关闭或替换了这个缓存
+    D3DShaderCacheStats stats;
+    [_shaderCacheLock lock];
+    d3d_shader_cache_close(_shaderCache);
+    _shaderCache = cache;
+    d3d_shader_cache_get_stats(cache, &stats);
+    [_shaderCacheLock unlock];
+    
+    NSLog(@"[DirectXToVulkanTranslator] Shader cache opened: %u shaders, %.1f KB%@", stats.entries,
+          stats.file_bytes / 1024.0,
+          stats.recovered_bytes ? [NSString stringWithFormat:@" (discarded %llu bytes of torn records)",
+                                   stats.recovered_bytes] : @"");
+    return YES;
+}
+
+- (void)closeShaderCache {
+    [_shaderCacheLock lock];
+    d3d_shader_cache_close(_shaderCache);
+    _shaderCache = NULL;
+    [_shaderCacheLock unlock];
+}
+
+// 还没有DXBC翻译器时的占位着色器：顶点退化到原点，像素输出品红色，便于发现未翻译的绘制
+- (NSString *)placeholderShaderForStage:(D3DShaderStage)stage {
+    if (stage == D3DShaderStageVertex) {
+        return @"#include <metal_stdlib>\n"
+               "using namespace metal;\n"
+               "vertex float4 vertex_main(uint vertexID [[vertex_id]]) { return float4(0.0, 0.0, 0.0, 1.0); }\n";
+    }
+    return @"#include <metal_stdlib>\n"
+           "using namespace metal;\n"
+           "fragment float4 fragment_main() { return float4(1.0, 0.0, 1.0, 1.0); }\n";
+}
+
+- (nullable NSString *)translateShaderBytecode:(NSData *)bytecode
+                                         stage:(D3DShaderStage)stage
+                                    reflection:(NSData * _Nullable * _Nullable)reflection {
+    // 阶段并进版本号：同一段字节码按不同阶段翻译的结果分开缓存
+    const D3DShaderKey key = d3d_shader_key(bytecode.bytes, bytecode.length,
+                                            SHADER_TRANSLATOR_VERSION << 8 | (uint32_t)stage);
+    
+    [_shaderCacheLock lock];
+    D3DShaderBlob blob;
+    if (_shaderCache && d3d_shader_cache_lookup(_shaderCache, key, &blob)) {
+        NSString *source = [[NSString alloc] initWithBytes:blob.source length:blob.source_size
+                                                  encoding:NSUTF8StringEncoding];
+        if (reflection) {
+            *reflection = blob.reflection_size ? [NSData dataWithBytes:blob.reflection length:blob.reflection_size] : nil;
+        }
+        [_shaderCacheLock unlock];
+        if (source) {
+            return source;
+        }
+    } else {
+        [_shaderCacheLock unlock];
+    }
+    
+    // 未命中：在调用线程翻译（不持锁），结果追加进缓存
+    const NSTimeInterval startTime = [NSDate timeIntervalSinceReferenceDate];
+    NSData *translatedReflection = nil;
+    NSString *source = _shaderTranslationHandler ? _shaderTranslationHandler(bytecode, stage, &translatedReflection)
+                                                 : [self placeholderShaderForStage:stage];
+    if (!source) {
+        NSLog(@"[DirectXToVulkanTranslator] ❌ Shader translation failed (%lu bytes)", (unsigned long)bytecode.length);
+        return nil;
+    }
+    
+    NSData *sourceData = [source dataUsingEncoding:NSUTF8StringEncoding];
+    [_shaderCacheLock lock];
+    _shadersTranslated++;
+    _shaderTranslateTime += [NSDate timeIntervalSinceReferenceDate] - startTime;
+    if (_shaderCache && !d3d_shader_cache_store(_shaderCache, key, sourceData.bytes, (uint32_t)sourceData.length,
+                                                translatedReflection.bytes, (uint32_t)translatedReflection.length)) {
+        NSLog(@"[DirectXToVulkanTranslator] Failed to persist translated shader");
+    }
+    [_shaderCacheLock unlock];
+    
+    if (reflection) {
+        *reflection = translatedReflection;
+    }
+    return source;
+}
+
+- (NSDictionary *)getShaderCacheStatistics {
+    [_shaderCacheLock lock];
+    D3DShaderCacheStats stats = { 0 };
+    if (_shaderCache) {
+        d3d_shader_cache_get_stats(_shaderCache, &stats);
+    }
+    NSDictionary *result = @{
+        @"open": @(_shaderCache != NULL),
+        @"entries": @(stats.entries),
+        @"file_bytes": @(stats.file_bytes),
+        @"live_bytes": @(stats.live_bytes),
+        @"hits": @(stats.hits),
+        @"misses": @(stats.misses),
+        @"stores": @(stats.stores),
+        @"store_failures": @(stats.store_failures),
+        @"evictions": @(stats.evictions),
+        @"compactions": @(stats.compactions),
+        @"recovered_bytes": @(stats.recovered_bytes),
+        @"translated": @(_shadersTranslated),
+        @"average_translate_time": @(_shadersTranslated ? _shaderTranslateTime / _shadersTranslated : 0.0)
+    };
+    [_shaderCacheLock unlock];
+    return result;
+}
+
 @end
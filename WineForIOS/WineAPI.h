@@ -5,12 +5,19 @@
 
 NS_ASSUME_NONNULL_BEGIN
 
+struct Box64ThunkRegistry;
+struct WineMsgQueue;
+struct WineSurface;
+struct WineGDIState;
+struct WineGDICommandList;
+
 // Windows基础类型定义
 typedef void* HWND;
 typedef void* HDC;
 typedef void* HBITMAP;
 typedef void* HBRUSH;
 typedef void* HPEN;
+typedef void* HGDIOBJ;
 typedef void* HFONT;
 typedef void* HICON;
 typedef void* HCURSOR;
@@ -46,6 +53,10 @@ typedef LONG LPARAM;
 #define WM_KEYUP        0x0101
 #define WM_COMMAND      0x0111
 
+// PeekMessage 标志
+#define PM_NOREMOVE     0x0000
+#define PM_REMOVE       0x0001
+
 // 窗口样式
 #define WS_OVERLAPPED    0x00000000
 #define WS_POPUP         0x80000000
@@ -79,9 +90,26 @@ typedef LONG LPARAM;
 #define MB_ICONINFO      0x00000040
 
 // 绘图常量
-#define BLACK_BRUSH      4
 #define WHITE_BRUSH      0
+#define LTGRAY_BRUSH     1
 #define GRAY_BRUSH       2
+#define DKGRAY_BRUSH     3
+#define BLACK_BRUSH      4
+#define NULL_BRUSH       5
+#define WHITE_PEN        6
+#define BLACK_PEN        7
+#define NULL_PEN         8
+#define STOCK_OBJECT_COUNT 9
+
+// 画笔样式
+#define PS_SOLID         0
+#define PS_NULL          5
+
+// 背景模式
+#define TRANSPARENT      1
+#define OPAQUE           2
+
+#define CLR_INVALID      0xFFFFFFFF
 
 // Windows结构体定义
 typedef struct tagPOINT {
@@ -138,24 +166,39 @@ typedef struct tagPAINTSTRUCT {
 @property (nonatomic, assign) DWORD style;
 @property (nonatomic, assign) BOOL isVisible;
 @property (nonatomic, strong) NSMutableArray<NSDictionary *> *children;
+@property (nonatomic, assign, nullable) struct WineMsgQueue *messageQueue;  // 创建窗口的线程的消息队列（持有引用）
+@property (nonatomic, assign, nullable) struct WineSurface *surface;        // 常驻后备表面（窗口持有，dealloc 时销毁）
+@property (nonatomic, strong, readonly) NSLock *surfaceLock;                 // 渲染队列写表面 / 视图读表面
 @end
 
-// Windows设备上下文
+// 显示窗口后备表面的视图：渲染队列执行完命令后只把脏矩形标记为需要重绘
+@interface WineSurfaceView : UIView
+@property (nonatomic, weak, nullable) WineWindow *wineWindow;
+@end
+
+// Windows设备上下文：绘图调用只记录命令，ReleaseDC/EndPaint 时整批交给渲染队列
 @interface WineDC : NSObject
-@property (nonatomic, assign) CGContextRef cgContext;
 @property (nonatomic, assign) HWND hwnd;
-@property (nonatomic, strong) UIColor *currentColor;
-@property (nonatomic, strong) UIFont *currentFont;
-@property (nonatomic, assign) CGRect clipRect;
+@property (nonatomic, assign) HGDIOBJ selectedPen;
+@property (nonatomic, assign) HGDIOBJ selectedBrush;
+@property (nonatomic, assign, readonly) struct WineGDIState *state;
+@property (nonatomic, assign, nullable) struct WineGDICommandList *commands;  // 来自 WineAPI 的命令表池
+@end
+
+// GDI对象（画刷、画笔），句柄指向它而不是一个计数值
+@interface WineGDIObject : NSObject
+@property (nonatomic, assign) DWORD color;              // COLORREF 0x00BBGGRR
+@property (nonatomic, assign) int penStyle;             // 仅画笔
+@property (nonatomic, assign) int width;                // 仅画笔
+@property (nonatomic, assign) BOOL isStock;             // GetStockObject 的对象，DeleteObject 不释放
+@property (nonatomic, assign) BOOL isNull;              // NULL_BRUSH / NULL_PEN
+@property (nonatomic, assign) BOOL isPen;
 @end
 
 // Wine API管理器
 @interface WineAPI : NSObject
 
-@property (nonatomic, strong) NSMutableDictionary<NSNumber *, WineWindow *> *windows;
-@property (nonatomic, strong) NSMutableDictionary<NSNumber *, WineDC *> *deviceContexts;
 @property (nonatomic, strong) NSMutableDictionary<NSString *, NSDictionary *> *windowClasses;
-@property (nonatomic, strong) NSMutableArray<NSDictionary *> *messageQueue;
 @property (nonatomic, weak) UIViewController *rootViewController;
 
 + (instancetype)sharedAPI;
@@ -166,16 +209,37 @@ typedef struct tagPAINTSTRUCT {
 // 修复：添加线程安全的UI辅助方法
 + (void)showAlertWithTitle:(NSString *)title message:(NSString *)message type:(DWORD)uType;
 
-// 窗口和设备上下文管理的内部方法
-- (HWND)generateWindowHandle;
-- (HDC)generateDCHandle;
-- (WineWindow *)getWindow:(HWND)hwnd;
-- (WineDC *)getDC:(HDC)hdc;
-- (void)postMessage:(HWND)hwnd message:(DWORD)message wParam:(WPARAM)wParam lParam:(LPARAM)lParam;
+// 窗口、设备上下文和GDI对象放在同一张分代句柄表里：句柄编码槽位和代数，查找不装箱、不哈希
+// 表持有对象，release 后旧句柄查找返回nil
+- (HWND)registerWindow:(WineWindow *)window;
+- (BOOL)releaseWindow:(HWND)hwnd;
+- (HDC)registerDC:(WineDC *)dc;
+- (BOOL)releaseDC:(HDC)hdc;
+- (HGDIOBJ)registerGDIObject:(WineGDIObject *)object pen:(BOOL)isPen;
+- (BOOL)releaseGDIObject:(HGDIOBJ)handle;
+- (nullable WineWindow *)getWindow:(HWND)hwnd;
+- (nullable WineDC *)getDC:(HDC)hdc;
+- (nullable WineGDIObject *)getGDIObject:(HGDIOBJ)handle;
+- (HGDIOBJ)stockObject:(int)index;
+
+// 各类句柄的存活数/峰值，用于排查泄漏
+- (NSDictionary *)getHandleStatistics;
+
+// 把DC上记录的命令交给串行渲染队列，DC换上池中的空命令表继续记录
+- (void)submitDrawing:(WineDC *)dc;
+// 主线程调用：窗口后备表面的视图（第一次调用时创建），由宿主加入视图层级
+- (nullable WineSurfaceView *)surfaceViewForWindow:(HWND)hwnd;
+// 提交批次数、执行命令数、上传的脏矩形数
+- (NSDictionary *)getRenderStatistics;
+// 投递到窗口所属线程的队列，hwnd 为0时投递到当前线程；队列已满返回NO
+- (BOOL)postMessage:(HWND)hwnd message:(DWORD)message wParam:(WPARAM)wParam lParam:(LPARAM)lParam;
 
 // 🔧 新增：注册基础窗口类
 - (void)registerBasicWindowClasses;
 
+// 把下面的 KERNEL32/USER32/GDI32 实现注册为客户机导入的宿主桩（参数按Win64约定从客户机取出）
+- (void)registerThunksWithRegistry:(struct Box64ThunkRegistry *)registry;
+
 // KERNEL32 API
 DWORD GetLastError(void);
 void SetLastError(DWORD error);
@@ -210,10 +274,17 @@ BOOL Rectangle(HDC hdc, int left, int top, int right, int bottom);
 BOOL Ellipse(HDC hdc, int left, int top, int right, int bottom);
 BOOL TextOut(HDC hdc, int x, int y, LPCSTR lpString, int c);
 BOOL LineTo(HDC hdc, int x, int y);
-BOOL MoveToEx(HDC hdc, int x, int y, LPPOINT lppt);
+BOOL MoveToEx(HDC hdc, int x, int y, LPPOINT _Nullable lppt);
+int FillRect(HDC hdc, const RECT *lprc, HBRUSH hbr);
+DWORD SetPixel(HDC hdc, int x, int y, DWORD color);
+HGDIOBJ SelectObject(HDC hdc, HGDIOBJ h);
+DWORD SetTextColor(HDC hdc, DWORD color);
+DWORD SetBkColor(HDC hdc, DWORD color);
+int SetBkMode(HDC hdc, int mode);
 HBRUSH CreateSolidBrush(DWORD color);
 HPEN CreatePen(int style, int width, DWORD color);
 HBRUSH GetStockObject(int object);
+BOOL DeleteObject(HGDIOBJ ho);
 
 // 消息框
 int MessageBox(HWND hWnd, LPCSTR lpText, LPCSTR lpCaption, DWORD uType);
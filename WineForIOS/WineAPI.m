@@ -1,4 +1,10 @@
 #import "WineAPI.h"
+#import "Box64Imports.h"
+#import "Box64Thread.h"
+#import "WineMessageQueue.h"
+#import "WineHandleTable.h"
+#import "WineGDIRaster.h"
+#import <CoreText/CoreText.h>
 #import <pthread.h>
 #import <unistd.h>
 
@@ -17,6 +23,104 @@
         dispatch_sync(dispatch_get_main_queue(), block); \
     }
 
+// GetMessage 最长阻塞时间，超时按没有消息返回，避免执行线程永久挂起
+#define GETMESSAGE_TIMEOUT_MS   100
+
+// 一个DC记录的命令超过这个数就先提交一批，避免不调用 ReleaseDC 的程序无限堆积
+#define GDI_FLUSH_COMMANDS      4096
+// 命令表池上限，多出来的直接释放
+#define GDI_LIST_POOL_SIZE      16
+// CreateWindow 宽高无效（如 CW_USEDEFAULT）时表面使用的尺寸
+#define DEFAULT_SURFACE_WIDTH   640
+#define DEFAULT_SURFACE_HEIGHT  480
+
+// block 不能捕获C数组，脏矩形包一层结构体再交给主线程
+typedef struct WineDamageSet {
+    WineGDIRect rects[WINE_SURFACE_MAX_DAMAGE];
+    uint32_t count;
+} WineDamageSet;
+
+#pragma mark - 线程消息队列
+
+static pthread_key_t threadQueueKey;
+
+static void releaseThreadQueue(void *queue) {
+    wine_msgq_release(queue);
+}
+
+// 每个线程第一次用到消息队列时创建，线程退出时释放线程持有的引用
+static WineMsgQueue *WineCurrentThreadQueue(void) {
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        pthread_key_create(&threadQueueKey, releaseThreadQueue);
+    });
+    
+    WineMsgQueue *queue = pthread_getspecific(threadQueueKey);
+    if (!queue) {
+        queue = wine_msgq_create(0);
+        pthread_setspecific(threadQueueKey, queue);
+    }
+    return queue;
+}
+
+static void WineCopyQueuedMessage(const WineQueuedMsg *queued, LPMSG lpMsg) {
+    lpMsg->hwnd = (HWND)(uintptr_t)queued->hwnd;
+    lpMsg->message = queued->message;
+    lpMsg->wParam = (WPARAM)queued->wParam;
+    lpMsg->lParam = (LPARAM)queued->lParam;
+    lpMsg->time = queued->time;
+    lpMsg->pt = (POINT){queued->pt_x, queued->pt_y};
+}
+
+#pragma mark - 文字渲染
+
+// 后备表面的像素布局：BGRA little-endian，预乘 alpha（表面上的像素都是不透明的）
+static CGContextRef WineCreateSurfaceContext(WineSurface *surface) {
+    CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
+    CGContextRef context = CGBitmapContextCreate(surface->pixels, surface->width, surface->height, 8,
+                                                 (size_t)surface->stride * sizeof(uint32_t), colorSpace,
+                                                 kCGImageAlphaPremultipliedFirst | kCGBitmapByteOrder32Little);
+    CGColorSpaceRelease(colorSpace);
+    return context;
+}
+
+// WineGDITextRenderer：用CoreText在渲染队列上直接把字形画进表面（字体高度按GDI的单元高度换算）
+static int32_t WineCoreTextRenderer(WineSurface *surface, int32_t x, int32_t y, const char *text, uint32_t length,
+                                    uint32_t color, int32_t font_height, WineGDIRect *bounds, void *user) {
+    CFStringRef string = CFStringCreateWithBytes(NULL, (const UInt8 *)text, length, kCFStringEncodingWindowsLatin1, false);
+    if (!string) {
+        return 0;
+    }
+    CTFontRef font = CTFontCreateUIFontForLanguage(kCTFontUIFontSystem, font_height * 0.8, NULL);
+    const void *keys[] = { kCTFontAttributeName, kCTForegroundColorFromContextAttributeName };
+    const void *values[] = { font, kCFBooleanTrue };
+    CFDictionaryRef attributes = CFDictionaryCreate(NULL, keys, values, 2, &kCFTypeDictionaryKeyCallBacks,
+                                                    &kCFTypeDictionaryValueCallBacks);
+    CFAttributedStringRef attributed = CFAttributedStringCreate(NULL, string, attributes);
+    CTLineRef line = CTLineCreateWithAttributedString(attributed);
+    CGFloat ascent = 0;
+    const int32_t width = (int32_t)ceil(CTLineGetTypographicBounds(line, &ascent, NULL, NULL));
+    
+    CGContextRef context = surface ? WineCreateSurfaceContext(surface) : NULL;
+    if (context) {
+        // CG原点在左下角，GDI的 (x, y) 是文字单元的左上角
+        CGContextClipToRect(context, CGRectMake(x, surface->height - y - font_height, width, font_height));
+        CGContextSetRGBFillColor(context, ((color >> 16) & 0xFF) / 255.0, ((color >> 8) & 0xFF) / 255.0,
+                                 (color & 0xFF) / 255.0, 1.0);
+        CGContextSetTextPosition(context, x, surface->height - y - ascent);
+        CTLineDraw(line, context);
+        CGContextRelease(context);
+        *bounds = (WineGDIRect){ x, y, x + width, y + font_height };
+    }
+    
+    CFRelease(line);
+    CFRelease(attributed);
+    CFRelease(attributes);
+    CFRelease(font);
+    CFRelease(string);
+    return width;
+}
+
 @implementation WineWindow
 - (instancetype)init {
     self = [super init];
@@ -24,30 +128,371 @@
         _children = [NSMutableArray array];
         _isVisible = NO;
         _rect = (RECT){0, 0, 0, 0};
+        _surfaceLock = [[NSLock alloc] init];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    wine_msgq_release(_messageQueue);
+    wine_surface_destroy(_surface);
+}
+@end
+
+@implementation WineSurfaceView
+
+- (instancetype)initWithFrame:(CGRect)frame {
+    self = [super initWithFrame:frame];
+    if (self) {
+        self.opaque = YES;
+        self.contentScaleFactor = 1.0;     // 表面一个像素对应一个点，与不感知DPI的Win32程序一致
     }
     return self;
 }
+
+// 只在脏矩形范围内从表面取图，表面锁只在复制期间持有
+- (void)drawRect:(CGRect)rect {
+    WineWindow *window = self.wineWindow;
+    if (!window) {
+        return;
+    }
+    CGImageRef image = NULL;
+    [window.surfaceLock lock];
+    @try {
+        if (window.surface) {
+            CGContextRef context = WineCreateSurfaceContext(window.surface);
+            CGImageRef full = context ? CGBitmapContextCreateImage(context) : NULL;
+            image = full ? CGImageCreateWithImageInRect(full, rect) : NULL;
+            CGImageRelease(full);
+            CGContextRelease(context);
+        }
+    } @finally {
+        [window.surfaceLock unlock];
+    }
+    if (image) {
+        [[UIImage imageWithCGImage:image] drawInRect:CGRectIntersection(rect, self.bounds)];
+        CGImageRelease(image);
+    }
+}
+
 @end
 
-@implementation WineDC
+@implementation WineDC {
+    WineGDIState _stateStorage;
+}
+
 - (instancetype)init {
     self = [super init];
     if (self) {
-        _currentColor = [UIColor blackColor];
-        _currentFont = [UIFont systemFontOfSize:12];
-        _clipRect = CGRectZero;
+        wine_gdi_state_init(&_stateStorage);
     }
     return self;
 }
+
+- (WineGDIState *)state {
+    return &_stateStorage;
+}
+@end
+
+@implementation WineGDIObject
 @end
 
-@interface WineAPI()
+@interface WineAPI() {
+    HGDIOBJ _stockObjects[STOCK_OBJECT_COUNT];
+    WineGDICommandList *_listPool[GDI_LIST_POOL_SIZE];
+    NSUInteger _listPoolCount;
+    NSLock *_listPoolLock;
+    NSLock *_handleLock;                    // 保护 _handles：客户机线程、消息循环和渲染队列都会查表，grow 时表会重新分配
+    dispatch_queue_t _renderQueue;
+    uint64_t _submittedBatches;             // 三个计数都只在渲染队列上更新
+    uint64_t _executedCommands;
+    uint64_t _uploadedRects;
+}
 @property (nonatomic, assign) DWORD lastError;
-@property (nonatomic, assign) NSUInteger nextWindowHandle;
-@property (nonatomic, assign) NSUInteger nextDCHandle;
-@property (nonatomic, assign) BOOL quitMessagePosted;
+@property (nonatomic, assign) WineHandleTable *handles;
+- (nullable WineGDICommandList *)acquireCommandList;
+- (void)recycleCommandList:(nullable WineGDICommandList *)list;
 @end
 
+// 句柄表持有对象的 +1 引用，销毁时交还给ARC
+static void releaseHandleObject(void *object, WineHandleType type, void *context) {
+    CFBridgingRelease(object);
+}
+
+#pragma mark - 客户机导入桩
+
+// 客户机指针参数经 call->ctx->mmu 访问；句柄是宿主分配的小整数，原样传递
+#define GUEST_STRING_MAX    1024
+#define GUEST_MSG_SIZE      48      // x64 MSG：hwnd@0 message@8 wParam@16 lParam@24 time@32 pt@36
+
+static inline void *thunk_handle(uint64_t value) {
+    return (void *)(uintptr_t)value;
+}
+
+// 返回NULL表示地址为0；不可读时写入空串并返回缓冲区
+static const char *thunk_string(Box64ThunkCall *call, uint64_t address, char *buffer, size_t size) {
+    if (address == 0) {
+        return NULL;
+    }
+    if (!box64_thunk_read_string(&call->ctx->mmu, address, buffer, size)) {
+        buffer[0] = '\0';
+    }
+    return buffer;
+}
+
+static BOOL thunk_store_msg(Box64ThunkCall *call, uint64_t address, const MSG *msg) {
+    uint8_t guest[GUEST_MSG_SIZE] = {0};
+    uint64_t hwnd = (uintptr_t)msg->hwnd;
+    uint64_t wParam = msg->wParam;
+    int64_t lParam = msg->lParam;
+    memcpy(guest + 0, &hwnd, 8);
+    memcpy(guest + 8, &msg->message, 4);
+    memcpy(guest + 16, &wParam, 8);
+    memcpy(guest + 24, &lParam, 8);
+    memcpy(guest + 32, &msg->time, 4);
+    memcpy(guest + 36, &msg->pt, 8);
+    return box64_mmu_copy_to_guest(&call->ctx->mmu, address, guest, sizeof(guest));
+}
+
+static BOOL thunk_load_msg(Box64ThunkCall *call, uint64_t address, MSG *msg) {
+    uint8_t guest[GUEST_MSG_SIZE];
+    if (!box64_mmu_copy_from_guest(&call->ctx->mmu, guest, address, sizeof(guest))) {
+        return FALSE;
+    }
+    uint64_t hwnd, wParam;
+    int64_t lParam;
+    memcpy(&hwnd, guest + 0, 8);
+    memcpy(&msg->message, guest + 8, 4);
+    memcpy(&wParam, guest + 16, 8);
+    memcpy(&lParam, guest + 24, 8);
+    memcpy(&msg->time, guest + 32, 4);
+    memcpy(&msg->pt, guest + 36, 8);
+    msg->hwnd = thunk_handle(hwnd);
+    msg->wParam = (WPARAM)wParam;
+    msg->lParam = (LPARAM)lParam;
+    return TRUE;
+}
+
+static uint64_t thunk_GetLastError(Box64ThunkCall *call) {
+    return GetLastError();
+}
+
+static uint64_t thunk_SetLastError(Box64ThunkCall *call) {
+    SetLastError((DWORD)call->args[0]);
+    return 0;
+}
+
+static uint64_t thunk_GetCurrentThreadId(Box64ThunkCall *call) {
+    return GetCurrentThreadId();
+}
+
+static uint64_t thunk_GetCurrentProcessId(Box64ThunkCall *call) {
+    return GetCurrentProcessId();
+}
+
+// MessageBoxA(hWnd, lpText, lpCaption, uType)
+static uint64_t thunk_MessageBoxA(Box64ThunkCall *call) {
+    char text[GUEST_STRING_MAX], caption[GUEST_STRING_MAX];
+    return (uint32_t)MessageBox(thunk_handle(call->args[0]),
+                                thunk_string(call, call->args[1], text, sizeof(text)),
+                                thunk_string(call, call->args[2], caption, sizeof(caption)),
+                                (DWORD)call->args[3]);
+}
+
+// CreateWindowExA(dwExStyle, lpClassName, lpWindowName, dwStyle, X, Y, nWidth, nHeight,
+//                 hWndParent, hMenu, hInstance, lpParam)；不支持以类原子代替类名
+static uint64_t thunk_CreateWindowExA(Box64ThunkCall *call) {
+    if (call->args[1] < 0x10000) {
+        SetLastError(1407); // ERROR_CLASS_DOES_NOT_EXIST
+        return 0;
+    }
+    char className[GUEST_STRING_MAX], windowName[GUEST_STRING_MAX];
+    HWND hwnd = CreateWindow(thunk_string(call, call->args[1], className, sizeof(className)),
+                             thunk_string(call, call->args[2], windowName, sizeof(windowName)),
+                             (DWORD)call->args[3],
+                             (int)call->args[4], (int)call->args[5], (int)call->args[6], (int)call->args[7],
+                             thunk_handle(call->args[8]), thunk_handle(call->args[9]),
+                             thunk_handle(call->args[10]), thunk_handle(call->args[11]));
+    return (uintptr_t)hwnd;
+}
+
+static uint64_t thunk_ShowWindow(Box64ThunkCall *call) {
+    return ShowWindow(thunk_handle(call->args[0]), (int)call->args[1]);
+}
+
+static uint64_t thunk_UpdateWindow(Box64ThunkCall *call) {
+    return UpdateWindow(thunk_handle(call->args[0]));
+}
+
+static uint64_t thunk_DestroyWindow(Box64ThunkCall *call) {
+    return DestroyWindow(thunk_handle(call->args[0]));
+}
+
+static uint64_t thunk_PostQuitMessage(Box64ThunkCall *call) {
+    PostQuitMessage((int)call->args[0]);
+    return 0;
+}
+
+// GetMessageA(lpMsg, hWnd, wMsgFilterMin, wMsgFilterMax)
+static uint64_t thunk_GetMessageA(Box64ThunkCall *call) {
+    MSG msg = {0};
+    BOOL result = GetMessage(&msg, thunk_handle(call->args[1]), (DWORD)call->args[2], (DWORD)call->args[3]);
+    if (result && !thunk_store_msg(call, call->args[0], &msg)) {
+        SetLastError(998); // ERROR_NOACCESS
+        return (uint32_t)-1;
+    }
+    return result;
+}
+
+// PeekMessageA(lpMsg, hWnd, wMsgFilterMin, wMsgFilterMax, wRemoveMsg)
+static uint64_t thunk_PeekMessageA(Box64ThunkCall *call) {
+    MSG msg = {0};
+    BOOL result = PeekMessage(&msg, thunk_handle(call->args[1]), (DWORD)call->args[2], (DWORD)call->args[3],
+                              (DWORD)call->args[4]);
+    if (result && !thunk_store_msg(call, call->args[0], &msg)) {
+        SetLastError(998); // ERROR_NOACCESS
+        return FALSE;
+    }
+    return result;
+}
+
+static uint64_t thunk_TranslateMessage(Box64ThunkCall *call) {
+    MSG msg;
+    return thunk_load_msg(call, call->args[0], &msg) && TranslateMessage(&msg);
+}
+
+// 只能分派到宿主窗口过程；客户机注册的窗口过程不会从这里回调
+static uint64_t thunk_DispatchMessageA(Box64ThunkCall *call) {
+    MSG msg;
+    if (!thunk_load_msg(call, call->args[0], &msg)) {
+        return 0;
+    }
+    return (uint64_t)(int64_t)DispatchMessage(&msg);
+}
+
+static uint64_t thunk_GetDC(Box64ThunkCall *call) {
+    return (uintptr_t)GetDC(thunk_handle(call->args[0]));
+}
+
+// Rectangle(hdc, left, top, right, bottom)
+static uint64_t thunk_Rectangle(Box64ThunkCall *call) {
+    return Rectangle(thunk_handle(call->args[0]), (int)call->args[1], (int)call->args[2],
+                     (int)call->args[3], (int)call->args[4]);
+}
+
+static uint64_t thunk_CreateSolidBrush(Box64ThunkCall *call) {
+    return (uintptr_t)CreateSolidBrush((DWORD)call->args[0]);
+}
+
+static uint64_t thunk_GetStockObject(Box64ThunkCall *call) {
+    return (uintptr_t)GetStockObject((int)call->args[0]);
+}
+
+// CreatePen(iStyle, cWidth, color)
+static uint64_t thunk_CreatePen(Box64ThunkCall *call) {
+    return (uintptr_t)CreatePen((int)call->args[0], (int)call->args[1], (DWORD)call->args[2]);
+}
+
+static uint64_t thunk_DeleteObject(Box64ThunkCall *call) {
+    return DeleteObject(thunk_handle(call->args[0]));
+}
+
+static uint64_t thunk_ReleaseDC(Box64ThunkCall *call) {
+    return (uint32_t)ReleaseDC(thunk_handle(call->args[0]), thunk_handle(call->args[1]));
+}
+
+#define GUEST_PAINTSTRUCT_SIZE  72      // x64 PAINTSTRUCT：hdc@0 fErase@8 rcPaint@12 fRestore@28 fIncUpdate@32
+
+// BeginPaint(hWnd, lpPaint)
+static uint64_t thunk_BeginPaint(Box64ThunkCall *call) {
+    PAINTSTRUCT paint = {0};
+    HDC hdc = BeginPaint(thunk_handle(call->args[0]), &paint);
+    if (!hdc) {
+        return 0;
+    }
+    uint8_t guest[GUEST_PAINTSTRUCT_SIZE] = {0};
+    uint64_t guestDC = (uintptr_t)hdc;
+    memcpy(guest + 0, &guestDC, 8);
+    memcpy(guest + 8, &paint.fErase, 4);
+    memcpy(guest + 12, &paint.rcPaint, 16);
+    if (!box64_mmu_copy_to_guest(&call->ctx->mmu, call->args[1], guest, sizeof(guest))) {
+        ReleaseDC(thunk_handle(call->args[0]), hdc);
+        SetLastError(998); // ERROR_NOACCESS
+        return 0;
+    }
+    return guestDC;
+}
+
+// EndPaint(hWnd, lpPaint)：只用到 hdc
+static uint64_t thunk_EndPaint(Box64ThunkCall *call) {
+    uint64_t guestDC = 0;
+    if (!box64_mmu_copy_from_guest(&call->ctx->mmu, &guestDC, call->args[1], sizeof(guestDC))) {
+        return FALSE;
+    }
+    PAINTSTRUCT paint = { .hdc = thunk_handle(guestDC) };
+    return EndPaint(thunk_handle(call->args[0]), &paint);
+}
+
+// Ellipse(hdc, left, top, right, bottom)
+static uint64_t thunk_Ellipse(Box64ThunkCall *call) {
+    return Ellipse(thunk_handle(call->args[0]), (int)call->args[1], (int)call->args[2],
+                   (int)call->args[3], (int)call->args[4]);
+}
+
+// MoveToEx(hdc, x, y, lppt)
+static uint64_t thunk_MoveToEx(Box64ThunkCall *call) {
+    POINT previous;
+    if (!MoveToEx(thunk_handle(call->args[0]), (int)call->args[1], (int)call->args[2], &previous)) {
+        return FALSE;
+    }
+    return call->args[3] == 0 || box64_mmu_copy_to_guest(&call->ctx->mmu, call->args[3], &previous, sizeof(previous));
+}
+
+static uint64_t thunk_LineTo(Box64ThunkCall *call) {
+    return LineTo(thunk_handle(call->args[0]), (int)call->args[1], (int)call->args[2]);
+}
+
+// TextOutA(hdc, x, y, lpString, c)：超过 WINE_GDI_TEXT_MAX 的部分截断
+static uint64_t thunk_TextOutA(Box64ThunkCall *call) {
+    char text[WINE_GDI_TEXT_MAX];
+    const int count = (int)call->args[4];
+    const int length = count < 0 ? 0 : count > WINE_GDI_TEXT_MAX ? WINE_GDI_TEXT_MAX : count;
+    if (length > 0 && !box64_mmu_copy_from_guest(&call->ctx->mmu, text, call->args[3], (size_t)length)) {
+        SetLastError(998); // ERROR_NOACCESS
+        return FALSE;
+    }
+    return TextOut(thunk_handle(call->args[0]), (int)call->args[1], (int)call->args[2], text, length);
+}
+
+// FillRect(hdc, lprc, hbr)
+static uint64_t thunk_FillRect(Box64ThunkCall *call) {
+    RECT rect;
+    if (!box64_mmu_copy_from_guest(&call->ctx->mmu, &rect, call->args[1], sizeof(rect))) {
+        return 0;
+    }
+    return (uint32_t)FillRect(thunk_handle(call->args[0]), &rect, thunk_handle(call->args[2]));
+}
+
+static uint64_t thunk_SetPixel(Box64ThunkCall *call) {
+    return SetPixel(thunk_handle(call->args[0]), (int)call->args[1], (int)call->args[2], (DWORD)call->args[3]);
+}
+
+static uint64_t thunk_SelectObject(Box64ThunkCall *call) {
+    return (uintptr_t)SelectObject(thunk_handle(call->args[0]), thunk_handle(call->args[1]));
+}
+
+static uint64_t thunk_SetTextColor(Box64ThunkCall *call) {
+    return SetTextColor(thunk_handle(call->args[0]), (DWORD)call->args[1]);
+}
+
+static uint64_t thunk_SetBkColor(Box64ThunkCall *call) {
+    return SetBkColor(thunk_handle(call->args[0]), (DWORD)call->args[1]);
+}
+
+static uint64_t thunk_SetBkMode(Box64ThunkCall *call) {
+    return (uint32_t)SetBkMode(thunk_handle(call->args[0]), (int)call->args[1]);
+}
+
 @implementation WineAPI
 
 - (BOOL)initializeWineAPI {
@@ -57,24 +502,14 @@
     _lastError = 0;
     
     // 确保集合已初始化
-    if (!_windows) {
-        _windows = [NSMutableDictionary dictionary];
-    }
-    if (!_deviceContexts) {
-        _deviceContexts = [NSMutableDictionary dictionary];
-    }
     if (!_windowClasses) {
         _windowClasses = [NSMutableDictionary dictionary];
     }
-    if (!_messageQueue) {
-        _messageQueue = [NSMutableArray array];
+    if (!_handles) {
+        NSLog(@"[WineAPI] ❌ Handle table unavailable");
+        return NO;
     }
     
-    // 重置句柄生成器
-    _nextWindowHandle = 1000;
-    _nextDCHandle = 2000;
-    _quitMessagePosted = NO;
-    
     // 注册基础窗口类
     [self registerBasicWindowClasses];
     
@@ -106,6 +541,58 @@
     }
 }
 
+- (void)registerThunksWithRegistry:(struct Box64ThunkRegistry *)registry {
+    static const struct {
+        const char *dll;
+        const char *name;
+        Box64ThunkFn fn;
+        uint8_t argCount;
+    } thunks[] = {
+        { "kernel32", "GetLastError",        thunk_GetLastError,        0 },
+        { "kernel32", "SetLastError",        thunk_SetLastError,        1 },
+        { "kernel32", "GetCurrentThreadId",  thunk_GetCurrentThreadId,  0 },
+        { "kernel32", "GetCurrentProcessId", thunk_GetCurrentProcessId, 0 },
+        { "user32",   "MessageBoxA",         thunk_MessageBoxA,         4 },
+        { "user32",   "CreateWindowExA",     thunk_CreateWindowExA,     12 },
+        { "user32",   "ShowWindow",          thunk_ShowWindow,          2 },
+        { "user32",   "UpdateWindow",        thunk_UpdateWindow,        1 },
+        { "user32",   "DestroyWindow",       thunk_DestroyWindow,       1 },
+        { "user32",   "PostQuitMessage",     thunk_PostQuitMessage,     1 },
+        { "user32",   "GetMessageA",         thunk_GetMessageA,         4 },
+        { "user32",   "PeekMessageA",        thunk_PeekMessageA,        5 },
+        { "user32",   "TranslateMessage",    thunk_TranslateMessage,    1 },
+        { "user32",   "DispatchMessageA",    thunk_DispatchMessageA,    1 },
+        { "user32",   "GetDC",               thunk_GetDC,               1 },
+        { "user32",   "ReleaseDC",           thunk_ReleaseDC,           2 },
+        { "user32",   "BeginPaint",          thunk_BeginPaint,          2 },
+        { "user32",   "EndPaint",            thunk_EndPaint,            2 },
+        { "user32",   "FillRect",            thunk_FillRect,            3 },
+        { "gdi32",    "Rectangle",           thunk_Rectangle,           5 },
+        { "gdi32",    "Ellipse",             thunk_Ellipse,             5 },
+        { "gdi32",    "MoveToEx",            thunk_MoveToEx,            4 },
+        { "gdi32",    "LineTo",              thunk_LineTo,              3 },
+        { "gdi32",    "TextOutA",            thunk_TextOutA,            5 },
+        { "gdi32",    "SetPixel",            thunk_SetPixel,            4 },
+        { "gdi32",    "SelectObject",        thunk_SelectObject,        2 },
+        { "gdi32",    "SetTextColor",        thunk_SetTextColor,        2 },
+        { "gdi32",    "SetBkColor",          thunk_SetBkColor,          2 },
+        { "gdi32",    "SetBkMode",           thunk_SetBkMode,           2 },
+        { "gdi32",    "CreateSolidBrush",    thunk_CreateSolidBrush,    1 },
+        { "gdi32",    "GetStockObject",      thunk_GetStockObject,      1 },
+        { "gdi32",    "CreatePen",           thunk_CreatePen,           3 },
+        { "gdi32",    "DeleteObject",        thunk_DeleteObject,        1 },
+    };
+    
+    NSUInteger registered = 0;
+    for (size_t i = 0; i < sizeof(thunks) / sizeof(thunks[0]); i++) {
+        if (box64_thunk_register(registry, thunks[i].dll, thunks[i].name, thunks[i].fn,
+                                 thunks[i].argCount, (__bridge void *)self)) {
+            registered++;
+        }
+    }
+    NSLog(@"[WineAPI] Registered %lu import thunks", (unsigned long)registered);
+}
+
 + (instancetype)sharedAPI {
     static WineAPI *sharedInstance = nil;
     static dispatch_once_t onceToken;
@@ -118,18 +605,49 @@
 - (instancetype)init {
     self = [super init];
     if (self) {
-        _windows = [NSMutableDictionary dictionary];
-        _deviceContexts = [NSMutableDictionary dictionary];
         _windowClasses = [NSMutableDictionary dictionary];
-        _messageQueue = [NSMutableArray array];
-        _nextWindowHandle = 1000;
-        _nextDCHandle = 2000;
         _lastError = 0;
-        _quitMessagePosted = NO;
+        _handles = wine_handles_create(0);
+        _handleLock = [[NSLock alloc] init];
+        _listPoolLock = [[NSLock alloc] init];
+        _renderQueue = dispatch_queue_create("com.wineforios.gdi.render", DISPATCH_QUEUE_SERIAL);
+        [self createStockObjects];
     }
     return self;
 }
 
+- (void)dealloc {
+    WineHandleStats stats;
+    wine_handles_get_stats(_handles, &stats);
+    NSLog(@"[WineAPI] Releasing handle table: %u windows, %u DCs, %u brushes, %u pens still alive",
+          stats.live[WINE_HANDLE_WINDOW], stats.live[WINE_HANDLE_DC],
+          stats.live[WINE_HANDLE_BRUSH], stats.live[WINE_HANDLE_PEN]);
+    wine_handles_destroy(_handles, releaseHandleObject, NULL);
+    for (NSUInteger i = 0; i < _listPoolCount; i++) {
+        wine_gdi_list_destroy(_listPool[i]);
+        free(_listPool[i]);
+    }
+}
+
+// 与Windows相同的9个库存对象，进程内共享且不可删除
+- (void)createStockObjects {
+    static const DWORD brushColors[] = { 0xFFFFFF, 0xC0C0C0, 0x808080, 0x404040, 0x000000 };
+    for (int i = 0; i < STOCK_OBJECT_COUNT; i++) {
+        WineGDIObject *object = [[WineGDIObject alloc] init];
+        object.isStock = YES;
+        const BOOL isPen = i >= WHITE_PEN;
+        if (i <= BLACK_BRUSH) {
+            object.color = brushColors[i];
+        } else if (i == WHITE_PEN) {
+            object.color = 0xFFFFFF;
+        }
+        object.isNull = i == NULL_BRUSH || i == NULL_PEN;
+        object.penStyle = i == NULL_PEN ? PS_NULL : PS_SOLID;
+        object.width = isPen ? 1 : 0;
+        _stockObjects[i] = [self registerGDIObject:object pen:isPen];
+    }
+}
+
 #pragma mark - 线程安全辅助方法
 
 + (void)showAlertWithTitle:(NSString *)title message:(NSString *)message type:(DWORD)uType {
@@ -158,35 +676,281 @@
     });
 }
 
-#pragma mark - 内部辅助方法
+#pragma mark - 句柄表
+
+// 句柄表的读写都在 _handleLock 下；查到的对象在锁内转成强引用，解锁后别的线程释放句柄也不会让它失效
+// 释放句柄后对象的最后一个引用在锁外放掉，dealloc 里再访问句柄表不会死锁
+
+- (HWND)registerWindow:(WineWindow *)window {
+    [_handleLock lock];
+    @try {
+        return (HWND)(uintptr_t)wine_handles_alloc(_handles, WINE_HANDLE_WINDOW, (__bridge_retained void *)window);
+    } @finally {
+        [_handleLock unlock];
+    }
+}
+
+- (BOOL)releaseWindow:(HWND)hwnd {
+    void *object;
+    [_handleLock lock];
+    @try {
+        object = wine_handles_free(_handles, (WineHandle)(uintptr_t)hwnd, WINE_HANDLE_WINDOW);
+    } @finally {
+        [_handleLock unlock];
+    }
+    CFBridgingRelease(object);
+    return object != NULL;
+}
+
+- (HDC)registerDC:(WineDC *)dc {
+    [_handleLock lock];
+    @try {
+        return (HDC)(uintptr_t)wine_handles_alloc(_handles, WINE_HANDLE_DC, (__bridge_retained void *)dc);
+    } @finally {
+        [_handleLock unlock];
+    }
+}
+
+- (BOOL)releaseDC:(HDC)hdc {
+    void *object;
+    [_handleLock lock];
+    @try {
+        object = wine_handles_free(_handles, (WineHandle)(uintptr_t)hdc, WINE_HANDLE_DC);
+    } @finally {
+        [_handleLock unlock];
+    }
+    CFBridgingRelease(object);
+    return object != NULL;
+}
 
-- (HWND)generateWindowHandle {
-    return (HWND)(uintptr_t)_nextWindowHandle++;
+- (HGDIOBJ)registerGDIObject:(WineGDIObject *)object pen:(BOOL)isPen {
+    object.isPen = isPen;
+    [_handleLock lock];
+    @try {
+        return (HGDIOBJ)(uintptr_t)wine_handles_alloc(_handles, isPen ? WINE_HANDLE_PEN : WINE_HANDLE_BRUSH,
+                                                      (__bridge_retained void *)object);
+    } @finally {
+        [_handleLock unlock];
+    }
 }
 
-- (HDC)generateDCHandle {
-    return (HDC)(uintptr_t)_nextDCHandle++;
+- (BOOL)releaseGDIObject:(HGDIOBJ)handle {
+    void *released = NULL;
+    [_handleLock lock];
+    @try {
+        WineHandleType type;
+        WineGDIObject *object = (__bridge WineGDIObject *)wine_handles_lookup_any(_handles, (WineHandle)(uintptr_t)handle, &type);
+        if (!object || (type != WINE_HANDLE_BRUSH && type != WINE_HANDLE_PEN)) {
+            return NO;
+        }
+        if (!object.isStock) {
+            released = wine_handles_free(_handles, (WineHandle)(uintptr_t)handle, type);
+        }
+    } @finally {
+        [_handleLock unlock];
+    }
+    CFBridgingRelease(released);
+    return YES;
 }
 
+// 句柄高32位必须为0：客户机传来的64位值不能截断后碰巧命中
 - (WineWindow *)getWindow:(HWND)hwnd {
-    return _windows[@((uintptr_t)hwnd)];
+    const uintptr_t value = (uintptr_t)hwnd;
+    if (value > UINT32_MAX) {
+        return nil;
+    }
+    [_handleLock lock];
+    @try {
+        WineWindow *window = (__bridge WineWindow *)wine_handles_lookup(_handles, (WineHandle)value, WINE_HANDLE_WINDOW);
+        return window;
+    } @finally {
+        [_handleLock unlock];
+    }
 }
 
 - (WineDC *)getDC:(HDC)hdc {
-    return _deviceContexts[@((uintptr_t)hdc)];
+    const uintptr_t value = (uintptr_t)hdc;
+    if (value > UINT32_MAX) {
+        return nil;
+    }
+    [_handleLock lock];
+    @try {
+        WineDC *dc = (__bridge WineDC *)wine_handles_lookup(_handles, (WineHandle)value, WINE_HANDLE_DC);
+        return dc;
+    } @finally {
+        [_handleLock unlock];
+    }
 }
 
-- (void)postMessage:(HWND)hwnd message:(DWORD)message wParam:(WPARAM)wParam lParam:(LPARAM)lParam {
-    NSDictionary *msg = @{
-        @"hwnd": @((uintptr_t)hwnd),
-        @"message": @(message),
-        @"wParam": @(wParam),
-        @"lParam": @(lParam),
-        @"time": @([[NSDate date] timeIntervalSince1970] * 1000)
-    };
+- (WineGDIObject *)getGDIObject:(HGDIOBJ)handle {
+    const uintptr_t value = (uintptr_t)handle;
+    if (value > UINT32_MAX) {
+        return nil;
+    }
+    [_handleLock lock];
+    @try {
+        WineHandleType type;
+        void *object = wine_handles_lookup_any(_handles, (WineHandle)value, &type);
+        WineGDIObject *gdiObject = object && (type == WINE_HANDLE_BRUSH || type == WINE_HANDLE_PEN)
+                                   ? (__bridge WineGDIObject *)object : nil;
+        return gdiObject;
+    } @finally {
+        [_handleLock unlock];
+    }
+}
+
+- (HGDIOBJ)stockObject:(int)index {
+    return index >= 0 && index < STOCK_OBJECT_COUNT ? _stockObjects[index] : NULL;
+}
+
+- (NSDictionary *)getHandleStatistics {
+    WineHandleStats stats;
+    [_handleLock lock];
+    @try {
+        wine_handles_get_stats(_handles, &stats);
+    } @finally {
+        [_handleLock unlock];
+    }
+    
+    NSMutableDictionary *result = [NSMutableDictionary dictionary];
+    for (int type = WINE_HANDLE_WINDOW; type < WINE_HANDLE_TYPE_COUNT; type++) {
+        NSString *name = @(wine_handle_type_name((WineHandleType)type));
+        result[name] = @{ @"live": @(stats.live[type]), @"peak": @(stats.peak[type]) };
+    }
+    result[@"capacity"] = @(stats.capacity);
+    result[@"allocations"] = @(stats.allocations);
+    result[@"frees"] = @(stats.frees);
+    result[@"stale_lookups"] = @(stats.stale_lookups);
+    return result;
+}
+
+#pragma mark - 批量绘制
+
+// 清空后的命令表保留容量，下一个DC复用时记录命令不再分配内存
+- (WineGDICommandList *)acquireCommandList {
+    WineGDICommandList *list = NULL;
+    [_listPoolLock lock];
+    @try {
+        if (_listPoolCount > 0) {
+            list = _listPool[--_listPoolCount];
+        }
+    } @finally {
+        [_listPoolLock unlock];
+    }
+    if (!list) {
+        list = malloc(sizeof(WineGDICommandList));
+        if (list) {
+            wine_gdi_list_init(list);
+        }
+    }
+    return list;
+}
+
+- (void)recycleCommandList:(WineGDICommandList *)list {
+    if (!list) {
+        return;
+    }
+    wine_gdi_list_reset(list);
+    [_listPoolLock lock];
+    @try {
+        if (_listPoolCount < GDI_LIST_POOL_SIZE) {
+            _listPool[_listPoolCount++] = list;
+            list = NULL;
+        }
+    } @finally {
+        [_listPoolLock unlock];
+    }
+    if (list) {
+        wine_gdi_list_destroy(list);
+        free(list);
+    }
+}
+
+- (void)submitDrawing:(WineDC *)dc {
+    WineGDICommandList *list = dc.commands;
+    if (!list || list->count == 0) {
+        return;
+    }
+    dc.commands = [self acquireCommandList];
+    
+    WineWindow *window = [self getWindow:dc.hwnd];
+    if (!window.surface) {
+        [self recycleCommandList:list];
+        return;
+    }
+    
+    // 渲染队列是串行的，同一窗口的批次按提交顺序落到表面上；只把脏矩形交给主线程重绘
+    dispatch_async(_renderQueue, ^{
+        WineDamageSet damage = { .count = 0 };
+        [window.surfaceLock lock];
+        @try {
+            self->_executedCommands += wine_gdi_execute(window.surface, list, NULL);
+            damage.count = wine_surface_take_damage(window.surface, damage.rects, WINE_SURFACE_MAX_DAMAGE);
+        } @finally {
+            [window.surfaceLock unlock];
+        }
+        self->_submittedBatches++;
+        self->_uploadedRects += damage.count;
+        [self recycleCommandList:list];
+        
+        if (damage.count == 0) {
+            return;
+        }
+        dispatch_async(dispatch_get_main_queue(), ^{
+            UIView *view = window.view;
+            for (uint32_t i = 0; i < damage.count; i++) {
+                const WineGDIRect *rect = &damage.rects[i];
+                [view setNeedsDisplayInRect:CGRectMake(rect->left, rect->top, rect->right - rect->left,
+                                                       rect->bottom - rect->top)];
+            }
+        });
+    });
+}
+
+- (WineSurfaceView *)surfaceViewForWindow:(HWND)hwnd {
+    WineWindow *window = [self getWindow:hwnd];
+    if (!window.surface) {
+        return nil;
+    }
+    if ([window.view isKindOfClass:[WineSurfaceView class]]) {
+        return (WineSurfaceView *)window.view;
+    }
+    WineSurfaceView *view = [[WineSurfaceView alloc] initWithFrame:CGRectMake(window.rect.left, window.rect.top,
+                                                                             window.surface->width,
+                                                                             window.surface->height)];
+    view.wineWindow = window;
+    window.view = view;
+    return view;
+}
+
+- (NSDictionary *)getRenderStatistics {
+    __block NSDictionary *result = nil;
+    dispatch_sync(_renderQueue, ^{
+        result = @{
+            @"batches": @(self->_submittedBatches),
+            @"commands": @(self->_executedCommands),
+            @"damage_rects": @(self->_uploadedRects),
+        };
+    });
+    return result;
+}
+
+#pragma mark - 内部辅助方法
+
+- (BOOL)postMessage:(HWND)hwnd message:(DWORD)message wParam:(WPARAM)wParam lParam:(LPARAM)lParam {
+    WineWindow *window = hwnd ? [self getWindow:hwnd] : nil;
+    if (hwnd && !window) {
+        SetLastError(1400); // ERROR_INVALID_WINDOW_HANDLE
+        return NO;
+    }
     
-    [_messageQueue addObject:msg];
-    NSLog(@"[WineAPI] Posted message 0x%X to window %p", message, hwnd);
+    WineMsgQueue *queue = window.messageQueue ?: WineCurrentThreadQueue();
+    if (!wine_msgq_post(queue, (uintptr_t)hwnd, message, wParam, lParam)) {
+        NSLog(@"[WineAPI] ⚠️ Message queue full, dropped message 0x%X to window %p", message, hwnd);
+        SetLastError(1816); // ERROR_NOT_ENOUGH_QUOTA
+        return NO;
+    }
+    return YES;
 }
 
 @end
@@ -201,9 +965,9 @@ void SetLastError(DWORD error) {
     [WineAPI sharedAPI].lastError = error;
 }
 
+// 与客户机线程（CreateThread）使用同一套线程ID
 DWORD GetCurrentThreadId(void) {
-    pthread_t thread = pthread_self();
-    return (DWORD)((uintptr_t)thread & 0xFFFFFFFF);
+    return box64_thread_current_id();
 }
 
 DWORD GetCurrentProcessId(void) {
@@ -266,9 +1030,27 @@ HWND CreateWindow(LPCSTR lpClassName, LPCSTR lpWindowName, DWORD dwStyle,
     window.rect = (RECT){x, y, x + nWidth, y + nHeight};
     window.wndProc = (LRESULT (*)(HWND, DWORD, WPARAM, LPARAM))[classInfo[@"wndProc"] pointerValue];
     
+    // 常驻后备表面，以窗口类的背景画刷清屏（不是画刷句柄时按白色）
+    WineGDIObject *background = [api getGDIObject:[classInfo[@"hbrBackground"] pointerValue]];
+    const BOOL validSize = nWidth > 0 && nHeight > 0 &&
+                           nWidth <= WINE_SURFACE_MAX_DIMENSION && nHeight <= WINE_SURFACE_MAX_DIMENSION;
+    window.surface = wine_surface_create(validSize ? nWidth : DEFAULT_SURFACE_WIDTH,
+                                         validSize ? nHeight : DEFAULT_SURFACE_HEIGHT,
+                                         background && !background.isPen ? background.color : 0xFFFFFF);
+    if (window.surface) {
+        window.surface->text_renderer = WineCoreTextRenderer;
+    } else {
+        NSLog(@"[WineAPI] ⚠️ Backing surface unavailable for window %@, drawing will be dropped", window.windowText);
+    }
+    
     // 生成窗口句柄
-    HWND hwnd = [api generateWindowHandle];
-    api.windows[@((uintptr_t)hwnd)] = window;
+    window.messageQueue = WineCurrentThreadQueue();
+    wine_msgq_retain(window.messageQueue);
+    HWND hwnd = [api registerWindow:window];
+    if (!hwnd) {
+        SetLastError(1158); // ERROR_NO_MORE_USER_HANDLES
+        return (HWND)0;
+    }
     
     NSLog(@"[WineAPI] Created window %p (%@) - UI creation skipped for testing", hwnd, window.windowText);
     
@@ -350,8 +1132,8 @@ BOOL DestroyWindow(HWND hWnd) {
         DestroyWindow(childHwnd);
     }
     
-    // 从窗口列表中移除
-    [api.windows removeObjectForKey:@((uintptr_t)hWnd)];
+    // 释放句柄，旧句柄之后查找不到
+    [api releaseWindow:hWnd];
     
     NSLog(@"[WineAPI] Destroyed window %p", hWnd);
     return TRUE;
@@ -373,65 +1155,33 @@ LRESULT DefWindowProc(HWND hWnd, DWORD Msg, WPARAM wParam, LPARAM lParam) {
 #pragma mark - 消息循环API
 
 BOOL GetMessage(LPMSG lpMsg, HWND hWnd, DWORD wMsgFilterMin, DWORD wMsgFilterMax) {
-    WineAPI *api = [WineAPI sharedAPI];
-    
-    // 🔧 修复：添加超时机制，避免无限等待
-    NSDate *timeoutDate = [NSDate dateWithTimeIntervalSinceNow:0.1]; // 100ms超时
-    
-    while (api.messageQueue.count == 0 && !api.quitMessagePosted) {
-        // 运行运行循环一小段时间
-        BOOL hasRunLoop = [[NSRunLoop currentRunLoop] runMode:NSDefaultRunLoopMode beforeDate:timeoutDate];
-        
-        if (!hasRunLoop || [timeoutDate timeIntervalSinceNow] < 0) {
-            // 超时或没有运行循环，返回FALSE表示没有消息
-            NSLog(@"[WineAPI] GetMessage timeout, no messages available");
+    // 🔧 在当前线程的队列上阻塞等待，超时视为没有消息
+    WineQueuedMsg queued;
+    WineMsgqResult result = wine_msgq_get(WineCurrentThreadQueue(), &queued, (uintptr_t)hWnd,
+                                          wMsgFilterMin, wMsgFilterMax, GETMESSAGE_TIMEOUT_MS);
+    switch (result) {
+        case WINE_MSGQ_MESSAGE:
+            WineCopyQueuedMessage(&queued, lpMsg);
+            return TRUE;
+        case WINE_MSGQ_QUIT:
+            WineCopyQueuedMessage(&queued, lpMsg);
+            NSLog(@"[WineAPI] WM_QUIT received, exiting message loop");
             return FALSE;
-        }
-    }
-    
-    if (api.quitMessagePosted) {
-        NSLog(@"[WineAPI] WM_QUIT received, exiting message loop");
-        return FALSE; // WM_QUIT收到
-    }
-    
-    if (api.messageQueue.count > 0) {
-        NSDictionary *msg = api.messageQueue.firstObject;
-        [api.messageQueue removeObjectAtIndex:0];
-        
-        lpMsg->hwnd = (HWND)[msg[@"hwnd"] unsignedIntegerValue];
-        lpMsg->message = [msg[@"message"] unsignedIntValue];
-        lpMsg->wParam = (WPARAM)[msg[@"wParam"] unsignedIntValue];
-        lpMsg->lParam = (LPARAM)[msg[@"lParam"] intValue];
-        lpMsg->time = [msg[@"time"] unsignedIntValue];
-        lpMsg->pt = (POINT){0, 0};
-        
-        NSLog(@"[WineAPI] GetMessage returning message 0x%X", lpMsg->message);
-        return TRUE;
+        case WINE_MSGQ_EMPTY:
+            break;
     }
-    
+    NSLog(@"[WineAPI] GetMessage timeout, no messages available");
     return FALSE;
 }
 
 BOOL PeekMessage(LPMSG lpMsg, HWND hWnd, DWORD wMsgFilterMin, DWORD wMsgFilterMax, DWORD wRemoveMsg) {
-    WineAPI *api = [WineAPI sharedAPI];
-    
-    if (api.messageQueue.count == 0) {
+    WineQueuedMsg queued;
+    WineMsgqResult result = wine_msgq_peek(WineCurrentThreadQueue(), &queued, (uintptr_t)hWnd,
+                                           wMsgFilterMin, wMsgFilterMax, (wRemoveMsg & PM_REMOVE) != 0);
+    if (result == WINE_MSGQ_EMPTY) {
         return FALSE;
     }
-    
-    NSDictionary *msg = api.messageQueue.firstObject;
-    
-    lpMsg->hwnd = (HWND)[msg[@"hwnd"] unsignedIntegerValue];
-    lpMsg->message = [msg[@"message"] unsignedIntValue];
-    lpMsg->wParam = (WPARAM)[msg[@"wParam"] unsignedIntValue];
-    lpMsg->lParam = (LPARAM)[msg[@"lParam"] intValue];
-    lpMsg->time = [msg[@"time"] unsignedIntValue];
-    lpMsg->pt = (POINT){0, 0};
-    
-    if (wRemoveMsg) {
-        [api.messageQueue removeObjectAtIndex:0];
-    }
-    
+    WineCopyQueuedMessage(&queued, lpMsg);
     return TRUE;
 }
 
@@ -451,23 +1201,47 @@ LRESULT DispatchMessage(const MSG *lpMsg) {
 }
 
 void PostQuitMessage(int nExitCode) {
-    WineAPI *api = [WineAPI sharedAPI];
-    api.quitMessagePosted = YES;
-    
-    NSDictionary *msg = @{
-        @"hwnd": @0,
-        @"message": @(WM_QUIT),
-        @"wParam": @(nExitCode),
-        @"lParam": @0,
-        @"time": @([[NSDate date] timeIntervalSince1970] * 1000)
-    };
-    
-    [api.messageQueue addObject:msg];
+    // WM_QUIT 只是队列上的标志，在其他投递消息之后取出
+    wine_msgq_post_quit(WineCurrentThreadQueue(), nExitCode);
     NSLog(@"[WineAPI] Posted WM_QUIT message with exit code %d", nExitCode);
 }
 
 #pragma mark - 绘图API实现
 
+// GetDC/BeginPaint 共用：DC从池中取命令表，选入默认的黑色画笔和白色画刷
+static HDC WineCreateWindowDC(WineAPI *api, HWND hWnd) {
+    WineDC *dc = [[WineDC alloc] init];
+    dc.hwnd = hWnd;
+    dc.selectedPen = [api stockObject:BLACK_PEN];
+    dc.selectedBrush = [api stockObject:WHITE_BRUSH];
+    dc.commands = [api acquireCommandList];
+    HDC hdc = dc.commands ? [api registerDC:dc] : (HDC)0;
+    if (!hdc) {
+        [api recycleCommandList:dc.commands];
+        dc.commands = NULL;
+        SetLastError(8); // ERROR_NOT_ENOUGH_MEMORY
+    }
+    return hdc;
+}
+
+// 可以记录命令的DC；命令表没有了（内存不足）时按失败处理
+static WineDC *WineDrawingDC(HDC hdc) {
+    WineDC *dc = [[WineAPI sharedAPI] getDC:hdc];
+    if (!dc || !dc.commands) {
+        SetLastError(6); // ERROR_INVALID_HANDLE
+        return nil;
+    }
+    return dc;
+}
+
+// 每条记录之后检查：命令积累太多时先交给渲染队列
+static BOOL WineRecorded(WineDC *dc, bool recorded) {
+    if (dc.commands->count >= GDI_FLUSH_COMMANDS) {
+        [[WineAPI sharedAPI] submitDrawing:dc];
+    }
+    return recorded;
+}
+
 HDC BeginPaint(HWND hWnd, LPPAINTSTRUCT lpPaint) {
     WineAPI *api = [WineAPI sharedAPI];
     WineWindow *window = [api getWindow:hWnd];
@@ -477,83 +1251,205 @@ HDC BeginPaint(HWND hWnd, LPPAINTSTRUCT lpPaint) {
         return (HDC)0;
     }
     
-    HDC hdc = [api generateDCHandle];
-    WineDC *dc = [[WineDC alloc] init];
-    dc.hwnd = hWnd;
-    
-    // 🔧 修复：图形上下文创建在主线程
-    ENSURE_MAIN_THREAD_SYNC(^{
-        if (window.view) {
-            CGSize size = window.view.bounds.size;
-            UIGraphicsBeginImageContext(size);
-            dc.cgContext = UIGraphicsGetCurrentContext();
-        }
-    });
-    
-    api.deviceContexts[@((uintptr_t)hdc)] = dc;
+    HDC hdc = WineCreateWindowDC(api, hWnd);
+    if (!hdc) {
+        return (HDC)0;
+    }
     
+    // 后备表面一直保留上次的内容，客户区坐标即表面坐标
     if (lpPaint) {
         lpPaint->hdc = hdc;
-        lpPaint->fErase = TRUE;
-        lpPaint->rcPaint = window.rect;
+        lpPaint->fErase = FALSE;
+        lpPaint->rcPaint = window.surface ? (RECT){0, 0, window.surface->width, window.surface->height}
+                                          : (RECT){0, 0, 0, 0};
+    }
+    if (window.messageQueue) {
+        wine_msgq_validate(window.messageQueue, (uintptr_t)hWnd);
     }
     
     NSLog(@"[WineAPI] BeginPaint for window %p, DC=%p", hWnd, hdc);
     return hdc;
 }
 
+BOOL EndPaint(HWND hWnd, const PAINTSTRUCT *lpPaint) {
+    if (!lpPaint) {
+        return FALSE;
+    }
+    return ReleaseDC(hWnd, lpPaint->hdc) == 1;
+}
+
 HDC GetDC(HWND hWnd) {
     WineAPI *api = [WineAPI sharedAPI];
-    WineWindow *window = [api getWindow:hWnd];
-    
-    if (!window) {
+    if (![api getWindow:hWnd]) {
         SetLastError(1400);
         return (HDC)0;
     }
     
-    HDC hdc = [api generateDCHandle];
-    WineDC *dc = [[WineDC alloc] init];
-    dc.hwnd = hWnd;
-    
-    // 🔧 修复：图形上下文创建在主线程
-    ENSURE_MAIN_THREAD_SYNC(^{
-        if (window.view) {
-            CGSize size = window.view.bounds.size;
-            UIGraphicsBeginImageContext(size);
-            dc.cgContext = UIGraphicsGetCurrentContext();
-        }
-    });
-    
-    api.deviceContexts[@((uintptr_t)hdc)] = dc;
-    
-    NSLog(@"[WineAPI] GetDC for window %p, DC=%p", hWnd, hdc);
+    HDC hdc = WineCreateWindowDC(api, hWnd);
+    if (hdc) {
+        NSLog(@"[WineAPI] GetDC for window %p, DC=%p", hWnd, hdc);
+    }
     return hdc;
 }
 
-// 其他绘图函数保持不变，已经是线程安全的
-BOOL Rectangle(HDC hdc, int left, int top, int right, int bottom) {
+// 提交DC上剩下的命令并释放DC；不释放的话DC句柄一直存活，可在 getHandleStatistics 中看到
+int ReleaseDC(HWND hWnd, HDC hDC) {
     WineAPI *api = [WineAPI sharedAPI];
-    WineDC *dc = [api getDC:hdc];
+    WineDC *dc = [api getDC:hDC];
+    if (!dc || (hWnd && dc.hwnd != hWnd)) {
+        return 0;
+    }
     
-    if (!dc || !dc.cgContext) {
+    [api submitDrawing:dc];
+    [api recycleCommandList:dc.commands];
+    dc.commands = NULL;
+    [api releaseDC:hDC];
+    return 1;
+}
+
+BOOL Rectangle(HDC hdc, int left, int top, int right, int bottom) {
+    WineDC *dc = WineDrawingDC(hdc);
+    if (!dc) {
         return FALSE;
     }
-    
-    CGRect rect = CGRectMake(left, top, right - left, bottom - top);
-    CGContextSetStrokeColorWithColor(dc.cgContext, [UIColor blackColor].CGColor);
-    CGContextSetLineWidth(dc.cgContext, 1.0);
-    CGContextStrokeRect(dc.cgContext, rect);
-    
-    return TRUE;
+    WineGDIRect rect = { left, top, right, bottom };
+    return WineRecorded(dc, wine_gdi_rectangle(dc.commands, dc.state, &rect));
+}
+
+BOOL Ellipse(HDC hdc, int left, int top, int right, int bottom) {
+    WineDC *dc = WineDrawingDC(hdc);
+    if (!dc) {
+        return FALSE;
+    }
+    WineGDIRect rect = { left, top, right, bottom };
+    return WineRecorded(dc, wine_gdi_ellipse(dc.commands, dc.state, &rect));
+}
+
+// c 为字节数（ANSI），超过 WINE_GDI_TEXT_MAX 的部分截断
+BOOL TextOut(HDC hdc, int x, int y, LPCSTR lpString, int c) {
+    WineDC *dc = WineDrawingDC(hdc);
+    if (!dc || (!lpString && c > 0) || c < 0) {
+        return FALSE;
+    }
+    return WineRecorded(dc, wine_gdi_text_out(dc.commands, dc.state, x, y, lpString ?: "", (uint32_t)c));
+}
+
+BOOL LineTo(HDC hdc, int x, int y) {
+    WineDC *dc = WineDrawingDC(hdc);
+    if (!dc) {
+        return FALSE;
+    }
+    return WineRecorded(dc, wine_gdi_line_to(dc.commands, dc.state, x, y));
+}
+
+BOOL MoveToEx(HDC hdc, int x, int y, LPPOINT lppt) {
+    WineDC *dc = WineDrawingDC(hdc);
+    if (!dc) {
+        return FALSE;
+    }
+    if (lppt) {
+        *lppt = (POINT){dc.state->position_x, dc.state->position_y};
+    }
+    return wine_gdi_move_to(dc.state, x, y);
+}
+
+int FillRect(HDC hdc, const RECT *lprc, HBRUSH hbr) {
+    WineDC *dc = WineDrawingDC(hdc);
+    WineGDIObject *brush = [[WineAPI sharedAPI] getGDIObject:hbr];
+    if (!dc || !lprc || !brush || brush.isPen) {
+        return 0;
+    }
+    if (brush.isNull) {
+        return 1;
+    }
+    WineGDIRect rect = { lprc->left, lprc->top, lprc->right, lprc->bottom };
+    return WineRecorded(dc, wine_gdi_fill_rect(dc.commands, &rect, brush.color)) ? 1 : 0;
+}
+
+DWORD SetPixel(HDC hdc, int x, int y, DWORD color) {
+    WineDC *dc = WineDrawingDC(hdc);
+    if (!dc) {
+        return CLR_INVALID;
+    }
+    color &= 0x00FFFFFF;
+    return WineRecorded(dc, wine_gdi_set_pixel(dc.commands, x, y, color)) ? color : CLR_INVALID;
+}
+
+// 只支持画笔和画刷；选入时把颜色/宽度拷进DC状态，之后删除对象不影响已选入的DC
+HGDIOBJ SelectObject(HDC hdc, HGDIOBJ h) {
+    WineDC *dc = WineDrawingDC(hdc);
+    WineGDIObject *object = [[WineAPI sharedAPI] getGDIObject:h];
+    if (!dc || !object) {
+        return NULL;
+    }
+    HGDIOBJ previous;
+    if (object.isPen) {
+        previous = dc.selectedPen;
+        dc.selectedPen = h;
+        dc.state->pen_color = object.color;
+        dc.state->pen_width = object.width;
+        dc.state->pen_null = object.isNull;
+    } else {
+        previous = dc.selectedBrush;
+        dc.selectedBrush = h;
+        dc.state->brush_color = object.color;
+        dc.state->brush_null = object.isNull;
+    }
+    return previous;
+}
+
+DWORD SetTextColor(HDC hdc, DWORD color) {
+    WineDC *dc = WineDrawingDC(hdc);
+    if (!dc) {
+        return CLR_INVALID;
+    }
+    const DWORD previous = dc.state->text_color;
+    dc.state->text_color = color & 0x00FFFFFF;
+    return previous;
+}
+
+DWORD SetBkColor(HDC hdc, DWORD color) {
+    WineDC *dc = WineDrawingDC(hdc);
+    if (!dc) {
+        return CLR_INVALID;
+    }
+    const DWORD previous = dc.state->background_color;
+    dc.state->background_color = color & 0x00FFFFFF;
+    return previous;
+}
+
+int SetBkMode(HDC hdc, int mode) {
+    WineDC *dc = WineDrawingDC(hdc);
+    if (!dc || (mode != TRANSPARENT && mode != OPAQUE)) {
+        SetLastError(87); // ERROR_INVALID_PARAMETER
+        return 0;
+    }
+    const int previous = dc.state->background_mode;
+    dc.state->background_mode = mode;
+    return previous;
 }
 
 HBRUSH CreateSolidBrush(DWORD color) {
-    static NSUInteger brushCounter = 3000;
-    return (HBRUSH)(uintptr_t)brushCounter++;
+    WineGDIObject *brush = [[WineGDIObject alloc] init];
+    brush.color = color & 0x00FFFFFF;
+    return [[WineAPI sharedAPI] registerGDIObject:brush pen:NO];
+}
+
+HPEN CreatePen(int style, int width, DWORD color) {
+    WineGDIObject *pen = [[WineGDIObject alloc] init];
+    pen.color = color & 0x00FFFFFF;
+    pen.penStyle = style;
+    pen.width = width > 0 ? width : 1;
+    pen.isNull = style == PS_NULL;
+    return [[WineAPI sharedAPI] registerGDIObject:pen pen:YES];
 }
 
 HBRUSH GetStockObject(int object) {
-    return (HBRUSH)(uintptr_t)(5000 + object);
+    return [[WineAPI sharedAPI] stockObject:object];
+}
+
+BOOL DeleteObject(HGDIOBJ ho) {
+    return [[WineAPI sharedAPI] releaseGDIObject:ho];
 }
 
 #pragma mark - 消息框API
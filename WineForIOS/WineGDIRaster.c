@@ -0,0 +1,527 @@
+// WineGDIRaster.c - 后备表面与GDI命令光栅化实现
+#include "WineGDIRaster.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INITIAL_COMMANDS    64
+#define INITIAL_TEXT        256
+#define COORDINATE_LIMIT    (1 << 24)       // 记录时钳制坐标，光栅化中的乘法不会溢出
+
+static inline int32_t min_i32(int32_t a, int32_t b) { return a < b ? a : b; }
+static inline int32_t max_i32(int32_t a, int32_t b) { return a > b ? a : b; }
+
+static inline int32_t clamp_coordinate(int32_t value) {
+    return value < -COORDINATE_LIMIT ? -COORDINATE_LIMIT : value > COORDINATE_LIMIT ? COORDINATE_LIMIT : value;
+}
+
+static inline WineGDIRect intersect(const WineGDIRect *a, const WineGDIRect *b) {
+    return (WineGDIRect){ max_i32(a->left, b->left), max_i32(a->top, b->top),
+                          min_i32(a->right, b->right), min_i32(a->bottom, b->bottom) };
+}
+
+static inline WineGDIRect unite(const WineGDIRect *a, const WineGDIRect *b) {
+    return (WineGDIRect){ min_i32(a->left, b->left), min_i32(a->top, b->top),
+                          max_i32(a->right, b->right), max_i32(a->bottom, b->bottom) };
+}
+
+static inline int64_t rect_area(const WineGDIRect *rect) {
+    return wine_gdi_rect_empty(rect) ? 0 : (int64_t)(rect->right - rect->left) * (rect->bottom - rect->top);
+}
+
+// MARK: - 表面
+
+static void fill_all(WineSurface *surface, uint32_t pixel) {
+    const size_t count = (size_t)surface->stride * (size_t)surface->height;
+    for (size_t i = 0; i < count; i++) {
+        surface->pixels[i] = pixel;
+    }
+}
+
+static bool valid_size(int32_t width, int32_t height) {
+    return width > 0 && height > 0 && width <= WINE_SURFACE_MAX_DIMENSION && height <= WINE_SURFACE_MAX_DIMENSION;
+}
+
+WineSurface *wine_surface_create(int32_t width, int32_t height, uint32_t background) {
+    if (!valid_size(width, height)) {
+        return NULL;
+    }
+    WineSurface *surface = calloc(1, sizeof(WineSurface));
+    if (!surface) {
+        return NULL;
+    }
+    surface->pixels = malloc((size_t)width * (size_t)height * sizeof(uint32_t));
+    if (!surface->pixels) {
+        free(surface);
+        return NULL;
+    }
+    surface->width = width;
+    surface->height = height;
+    surface->stride = width;
+    fill_all(surface, wine_gdi_pixel(background));
+    WineGDIRect all = { 0, 0, width, height };
+    wine_surface_add_damage(surface, &all);
+    return surface;
+}
+
+void wine_surface_destroy(WineSurface *surface) {
+    if (surface) {
+        free(surface->pixels);
+        free(surface);
+    }
+}
+
+bool wine_surface_resize(WineSurface *surface, int32_t width, int32_t height, uint32_t background) {
+    if (!valid_size(width, height)) {
+        return false;
+    }
+    if (width == surface->width && height == surface->height) {
+        return true;
+    }
+    uint32_t *pixels = malloc((size_t)width * (size_t)height * sizeof(uint32_t));
+    if (!pixels) {
+        return false;
+    }
+    free(surface->pixels);
+    surface->pixels = pixels;
+    surface->width = width;
+    surface->height = height;
+    surface->stride = width;
+    fill_all(surface, wine_gdi_pixel(background));
+    surface->damage_count = 0;
+    WineGDIRect all = { 0, 0, width, height };
+    wine_surface_add_damage(surface, &all);
+    return true;
+}
+
+void wine_surface_add_damage(WineSurface *surface, const WineGDIRect *rect) {
+    const WineGDIRect bounds = { 0, 0, surface->width, surface->height };
+    WineGDIRect added = intersect(rect, &bounds);
+    if (wine_gdi_rect_empty(&added)) {
+        return;
+    }
+
+    // 与已有矩形相交或相邻时直接合并
+    for (uint32_t i = 0; i < surface->damage_count; i++) {
+        WineGDIRect *existing = &surface->damage[i];
+        if (added.left <= existing->right && added.right >= existing->left &&
+            added.top <= existing->bottom && added.bottom >= existing->top) {
+            *existing = unite(existing, &added);
+            return;
+        }
+    }
+    if (surface->damage_count < WINE_SURFACE_MAX_DAMAGE) {
+        surface->damage[surface->damage_count++] = added;
+        return;
+    }
+
+    // 已满：并入使面积增长最小的那一块
+    uint32_t best = 0;
+    int64_t bestGrowth = INT64_MAX;
+    for (uint32_t i = 0; i < surface->damage_count; i++) {
+        WineGDIRect merged = unite(&surface->damage[i], &added);
+        const int64_t growth = rect_area(&merged) - rect_area(&surface->damage[i]);
+        if (growth < bestGrowth) {
+            bestGrowth = growth;
+            best = i;
+        }
+    }
+    surface->damage[best] = unite(&surface->damage[best], &added);
+}
+
+uint32_t wine_surface_take_damage(WineSurface *surface, WineGDIRect *rects, uint32_t max) {
+    const uint32_t count = surface->damage_count < max ? surface->damage_count : max;
+    memcpy(rects, surface->damage, count * sizeof(WineGDIRect));
+    if (count < surface->damage_count && count > 0) {
+        // 调用方放不下的部分并入最后一块，不丢失
+        for (uint32_t i = count; i < surface->damage_count; i++) {
+            rects[count - 1] = unite(&rects[count - 1], &surface->damage[i]);
+        }
+    }
+    surface->damage_count = 0;
+    return count;
+}
+
+// MARK: - 状态与命令表
+
+void wine_gdi_state_init(WineGDIState *state) {
+    *state = (WineGDIState){
+        .pen_color = 0x000000,
+        .pen_width = 1,
+        .pen_null = false,
+        .brush_color = 0xFFFFFF,
+        .brush_null = false,
+        .text_color = 0x000000,
+        .background_color = 0xFFFFFF,
+        .background_mode = WINE_GDI_OPAQUE,
+        .font_height = 16,
+        .position_x = 0,
+        .position_y = 0,
+    };
+}
+
+void wine_gdi_list_init(WineGDICommandList *list) {
+    memset(list, 0, sizeof(*list));
+}
+
+void wine_gdi_list_destroy(WineGDICommandList *list) {
+    free(list->commands);
+    free(list->text);
+    memset(list, 0, sizeof(*list));
+}
+
+void wine_gdi_list_reset(WineGDICommandList *list) {
+    list->count = 0;
+    list->text_used = 0;
+}
+
+static WineGDICommand *append(WineGDICommandList *list, WineGDIOp op) {
+    if (list->count == list->capacity) {
+        const uint32_t capacity = list->capacity ? list->capacity * 2 : INITIAL_COMMANDS;
+        WineGDICommand *commands = realloc(list->commands, capacity * sizeof(WineGDICommand));
+        if (!commands) {
+            return NULL;
+        }
+        list->commands = commands;
+        list->capacity = capacity;
+    }
+    WineGDICommand *command = &list->commands[list->count++];
+    memset(command, 0, sizeof(*command));
+    command->op = (uint8_t)op;
+    return command;
+}
+
+static WineGDIRect clamp_rect(const WineGDIRect *rect) {
+    return (WineGDIRect){ clamp_coordinate(rect->left), clamp_coordinate(rect->top),
+                          clamp_coordinate(rect->right), clamp_coordinate(rect->bottom) };
+}
+
+// GDI接受左右/上下颠倒的矩形
+static WineGDIRect normalize_rect(const WineGDIRect *rect) {
+    WineGDIRect clamped = clamp_rect(rect);
+    return (WineGDIRect){ min_i32(clamped.left, clamped.right), min_i32(clamped.top, clamped.bottom),
+                          max_i32(clamped.left, clamped.right), max_i32(clamped.top, clamped.bottom) };
+}
+
+static void apply_state(WineGDICommand *command, const WineGDIState *state) {
+    command->pen_null = state->pen_null;
+    command->brush_null = state->brush_null;
+    command->pen_width = state->pen_null ? 0 : max_i32(state->pen_width, 1);
+    command->pen_color = wine_gdi_pixel(state->pen_color);
+    command->fill_color = wine_gdi_pixel(state->brush_color);
+}
+
+bool wine_gdi_fill_rect(WineGDICommandList *list, const WineGDIRect *rect, uint32_t colorref) {
+    WineGDICommand *command = append(list, WINE_GDI_FILL_RECT);
+    if (!command) {
+        return false;
+    }
+    command->rect = clamp_rect(rect);
+    command->fill_color = wine_gdi_pixel(colorref);
+    return true;
+}
+
+bool wine_gdi_rectangle(WineGDICommandList *list, const WineGDIState *state, const WineGDIRect *rect) {
+    WineGDICommand *command = append(list, WINE_GDI_RECTANGLE);
+    if (!command) {
+        return false;
+    }
+    apply_state(command, state);
+    command->rect = normalize_rect(rect);
+    return true;
+}
+
+bool wine_gdi_ellipse(WineGDICommandList *list, const WineGDIState *state, const WineGDIRect *rect) {
+    WineGDICommand *command = append(list, WINE_GDI_ELLIPSE);
+    if (!command) {
+        return false;
+    }
+    apply_state(command, state);
+    command->rect = normalize_rect(rect);
+    return true;
+}
+
+bool wine_gdi_move_to(WineGDIState *state, int32_t x, int32_t y) {
+    state->position_x = clamp_coordinate(x);
+    state->position_y = clamp_coordinate(y);
+    return true;
+}
+
+bool wine_gdi_line_to(WineGDICommandList *list, WineGDIState *state, int32_t x, int32_t y) {
+    const int32_t startX = state->position_x;
+    const int32_t startY = state->position_y;
+    wine_gdi_move_to(state, x, y);
+    if (state->pen_null) {
+        return true;
+    }
+    WineGDICommand *command = append(list, WINE_GDI_LINE);
+    if (!command) {
+        return false;
+    }
+    apply_state(command, state);
+    command->rect = (WineGDIRect){ startX, startY, state->position_x, state->position_y };
+    return true;
+}
+
+bool wine_gdi_text_out(WineGDICommandList *list, const WineGDIState *state, int32_t x, int32_t y,
+                       const char *text, uint32_t length) {
+    if (length > WINE_GDI_TEXT_MAX) {
+        length = WINE_GDI_TEXT_MAX;
+    }
+    if (list->text_used + length > list->text_capacity) {
+        uint32_t capacity = list->text_capacity ? list->text_capacity : INITIAL_TEXT;
+        while (capacity < list->text_used + length) {
+            capacity *= 2;
+        }
+        char *pool = realloc(list->text, capacity);
+        if (!pool) {
+            return false;
+        }
+        list->text = pool;
+        list->text_capacity = capacity;
+    }
+    WineGDICommand *command = append(list, WINE_GDI_TEXT);
+    if (!command) {
+        return false;
+    }
+    memcpy(list->text + list->text_used, text, length);
+    command->text_offset = list->text_used;
+    command->text_length = length;
+    list->text_used += length;
+
+    command->rect = (WineGDIRect){ clamp_coordinate(x), clamp_coordinate(y), 0, 0 };
+    command->text_color = wine_gdi_pixel(state->text_color);
+    command->fill_color = wine_gdi_pixel(state->background_color);
+    command->opaque = state->background_mode == WINE_GDI_OPAQUE;
+    command->font_height = max_i32(state->font_height, 1);
+    return true;
+}
+
+bool wine_gdi_set_pixel(WineGDICommandList *list, int32_t x, int32_t y, uint32_t colorref) {
+    WineGDICommand *command = append(list, WINE_GDI_SET_PIXEL);
+    if (!command) {
+        return false;
+    }
+    command->rect = (WineGDIRect){ clamp_coordinate(x), clamp_coordinate(y), 0, 0 };
+    command->fill_color = wine_gdi_pixel(colorref);
+    return true;
+}
+
+// MARK: - 光栅化
+
+// 所有写像素的操作都经过这里：裁剪后按行填充，并扩展本条命令的绘制区域
+static void fill_rect(WineSurface *surface, const WineGDIRect *clip, int32_t left, int32_t top,
+                      int32_t right, int32_t bottom, uint32_t pixel, WineGDIRect *drawn) {
+    const WineGDIRect wanted = { left, top, right, bottom };
+    const WineGDIRect area = intersect(&wanted, clip);
+    if (wine_gdi_rect_empty(&area)) {
+        return;
+    }
+    const int32_t width = area.right - area.left;
+    for (int32_t y = area.top; y < area.bottom; y++) {
+        uint32_t *row = surface->pixels + (size_t)y * (size_t)surface->stride + area.left;
+        for (int32_t x = 0; x < width; x++) {
+            row[x] = pixel;
+        }
+    }
+    *drawn = wine_gdi_rect_empty(drawn) ? area : unite(drawn, &area);
+}
+
+static void draw_rectangle(WineSurface *surface, const WineGDIRect *clip, const WineGDICommand *command,
+                           WineGDIRect *drawn) {
+    const WineGDIRect *r = &command->rect;
+    // 画笔在边框内侧（相当于 PS_INSIDEFRAME），宽度超过一半时整个矩形都是边框
+    const int32_t w = min_i32(command->pen_width, min_i32((r->right - r->left + 1) / 2, (r->bottom - r->top + 1) / 2));
+    if (w > 0) {
+        fill_rect(surface, clip, r->left, r->top, r->right, r->top + w, command->pen_color, drawn);
+        fill_rect(surface, clip, r->left, r->bottom - w, r->right, r->bottom, command->pen_color, drawn);
+        fill_rect(surface, clip, r->left, r->top + w, r->left + w, r->bottom - w, command->pen_color, drawn);
+        fill_rect(surface, clip, r->right - w, r->top + w, r->right, r->bottom - w, command->pen_color, drawn);
+    }
+    if (!command->brush_null) {
+        fill_rect(surface, clip, r->left + w, r->top + w, r->right - w, r->bottom - w, command->fill_color, drawn);
+    }
+}
+
+// 椭圆在第 y 行覆盖的像素区间 [x0, x1)：像素中心落在椭圆内
+static bool ellipse_span(double cx, double cy, double rx, double ry, int32_t y, int32_t *x0, int32_t *x1) {
+    if (rx <= 0 || ry <= 0) {
+        return false;
+    }
+    const double dy = ((double)y + 0.5 - cy) / ry;
+    if (dy <= -1.0 || dy >= 1.0) {
+        return false;
+    }
+    const double half = rx * sqrt(1.0 - dy * dy);
+    *x0 = (int32_t)ceil(cx - half - 0.5);
+    *x1 = (int32_t)floor(cx + half - 0.5) + 1;
+    return *x1 > *x0;
+}
+
+static void draw_ellipse(WineSurface *surface, const WineGDIRect *clip, const WineGDICommand *command,
+                         WineGDIRect *drawn) {
+    const WineGDIRect *r = &command->rect;
+    const double cx = ((double)r->left + r->right) / 2.0;
+    const double cy = ((double)r->top + r->bottom) / 2.0;
+    const double rx = ((double)r->right - r->left) / 2.0;
+    const double ry = ((double)r->bottom - r->top) / 2.0;
+    const double w = command->pen_width;
+    const int32_t top = max_i32(r->top, clip->top);
+    const int32_t bottom = min_i32(r->bottom, clip->bottom);
+
+    for (int32_t y = top; y < bottom; y++) {
+        int32_t outer0, outer1, inner0, inner1;
+        if (!ellipse_span(cx, cy, rx, ry, y, &outer0, &outer1)) {
+            continue;
+        }
+        if (!ellipse_span(cx, cy, rx - w, ry - w, y, &inner0, &inner1)) {
+            inner0 = inner1 = outer1;   // 整行都是边框
+        }
+        if (w > 0) {
+            fill_rect(surface, clip, outer0, y, inner0, y + 1, command->pen_color, drawn);
+            fill_rect(surface, clip, inner1, y, outer1, y + 1, command->pen_color, drawn);
+        }
+        if (!command->brush_null) {
+            fill_rect(surface, clip, inner0, y, inner1, y + 1, command->fill_color, drawn);
+        }
+    }
+}
+
+// 沿主轴逐像素：第 i 个像素的次轴坐标为四舍五入的 i*d_minor/d_major，只遍历主轴落在裁剪区附近的部分
+static void draw_line(WineSurface *surface, const WineGDIRect *clip, const WineGDICommand *command,
+                      WineGDIRect *drawn) {
+    const int64_t x0 = command->rect.left, y0 = command->rect.top;
+    const int64_t dx = command->rect.right - x0, dy = command->rect.bottom - y0;
+    const int64_t adx = dx < 0 ? -dx : dx, ady = dy < 0 ? -dy : dy;
+    const bool xMajor = adx >= ady;
+    const int64_t steps = xMajor ? adx : ady;
+    if (steps == 0) {
+        return;
+    }
+    const int64_t minorSpan = xMajor ? ady : adx;
+    const int64_t majorStart = xMajor ? x0 : y0, minorStart = xMajor ? y0 : x0;
+    const int64_t majorSign = (xMajor ? dx : dy) < 0 ? -1 : 1, minorSign = (xMajor ? dy : dx) < 0 ? -1 : 1;
+    const int32_t w = command->pen_width;
+    const int32_t before = (w - 1) / 2, after = w - before;    // 以像素为中心的 w×w 笔触
+    const int64_t clipLow = (xMajor ? clip->left : clip->top) - after;
+    const int64_t clipHigh = (xMajor ? clip->right : clip->bottom) + before;
+
+    int64_t first = 0, last = steps;    // [first, last)
+    if (majorSign > 0) {
+        first = clipLow - majorStart > first ? clipLow - majorStart : first;
+        last = clipHigh - majorStart < last ? clipHigh - majorStart : last;
+    } else {
+        first = majorStart - clipHigh + 1 > first ? majorStart - clipHigh + 1 : first;
+        last = majorStart - clipLow + 1 < last ? majorStart - clipLow + 1 : last;
+    }
+    for (int64_t i = first; i < last; i++) {
+        const int64_t major = majorStart + majorSign * i;
+        const int64_t minor = minorStart + minorSign * ((2 * i * minorSpan + steps) / (2 * steps));
+        const int32_t x = (int32_t)(xMajor ? major : minor), y = (int32_t)(xMajor ? minor : major);
+        fill_rect(surface, clip, x - before, y - before, x + after, y + after, command->pen_color, drawn);
+    }
+}
+
+// 没有文字回调时：每个字符一个 (高/2)×高 的单元，非空白字符画一个空心方框
+static int32_t draw_placeholder_text(WineSurface *surface, const WineGDIRect *clip, int32_t x, int32_t y,
+                                     const char *text, uint32_t length, uint32_t color, int32_t height,
+                                     WineGDIRect *drawn) {
+    const int32_t cell = max_i32(height / 2, 1);
+    if (surface) {
+        for (uint32_t i = 0; i < length; i++) {
+            const int32_t left = x + (int32_t)i * cell;
+            if ((unsigned char)text[i] <= ' ' || cell < 3 || height < 4) {
+                continue;
+            }
+            const int32_t l = left + 1, r = left + cell - 1, t = y + 2, b = y + height - 1;
+            fill_rect(surface, clip, l, t, r, t + 1, color, drawn);
+            fill_rect(surface, clip, l, b - 1, r, b, color, drawn);
+            fill_rect(surface, clip, l, t + 1, l + 1, b - 1, color, drawn);
+            fill_rect(surface, clip, r - 1, t + 1, r, b - 1, color, drawn);
+        }
+    }
+    return cell * (int32_t)length;
+}
+
+static void draw_text(WineSurface *surface, const WineGDIRect *clip, const WineGDICommandList *list,
+                      const WineGDICommand *command, WineGDIRect *drawn) {
+    const char *text = list->text + command->text_offset;
+    const int32_t x = command->rect.left, y = command->rect.top;
+    const int32_t height = command->font_height;
+    WineGDIRect rendered = { 0, 0, 0, 0 };
+
+    if (command->opaque) {
+        // 先量宽度（surface 传NULL），再铺背景
+        const int32_t width = surface->text_renderer
+            ? surface->text_renderer(NULL, x, y, text, command->text_length, command->text_color, height,
+                                     &rendered, surface->text_user)
+            : draw_placeholder_text(NULL, clip, x, y, text, command->text_length, command->text_color, height, drawn);
+        fill_rect(surface, clip, x, y, x + width, y + height, command->fill_color, drawn);
+    }
+    if (surface->text_renderer) {
+        surface->text_renderer(surface, x, y, text, command->text_length, command->text_color, height,
+                               &rendered, surface->text_user);
+        rendered = intersect(&rendered, clip);
+        if (!wine_gdi_rect_empty(&rendered)) {
+            *drawn = wine_gdi_rect_empty(drawn) ? rendered : unite(drawn, &rendered);
+        }
+    } else {
+        draw_placeholder_text(surface, clip, x, y, text, command->text_length, command->text_color, height, drawn);
+    }
+}
+
+uint32_t wine_gdi_execute(WineSurface *surface, const WineGDICommandList *list, const WineGDIRect *clip) {
+    const WineGDIRect bounds = { 0, 0, surface->width, surface->height };
+    const WineGDIRect area = clip ? intersect(clip, &bounds) : bounds;
+    if (wine_gdi_rect_empty(&area)) {
+        return 0;
+    }
+
+    // 相邻命令的绘制区域先在本地合并，减少脏矩形集合的合并次数
+    WineGDIRect pending = { 0, 0, 0, 0 };
+    for (uint32_t i = 0; i < list->count; i++) {
+        const WineGDICommand *command = &list->commands[i];
+        WineGDIRect drawn = { 0, 0, 0, 0 };
+        switch ((WineGDIOp)command->op) {
+            case WINE_GDI_FILL_RECT:
+                fill_rect(surface, &area, command->rect.left, command->rect.top, command->rect.right,
+                          command->rect.bottom, command->fill_color, &drawn);
+                break;
+            case WINE_GDI_RECTANGLE:
+                draw_rectangle(surface, &area, command, &drawn);
+                break;
+            case WINE_GDI_ELLIPSE:
+                draw_ellipse(surface, &area, command, &drawn);
+                break;
+            case WINE_GDI_LINE:
+                draw_line(surface, &area, command, &drawn);
+                break;
+            case WINE_GDI_TEXT:
+                draw_text(surface, &area, list, command, &drawn);
+                break;
+            case WINE_GDI_SET_PIXEL:
+                fill_rect(surface, &area, command->rect.left, command->rect.top, command->rect.left + 1,
+                          command->rect.top + 1, command->fill_color, &drawn);
+                break;
+        }
+        if (wine_gdi_rect_empty(&drawn)) {
+            continue;
+        }
+        if (wine_gdi_rect_empty(&pending)) {
+            pending = drawn;
+            continue;
+        }
+        const WineGDIRect merged = unite(&pending, &drawn);
+        // 合并后的面积不超过两者之和的两倍时才合并，否则先提交前一块
+        if (rect_area(&merged) <= 2 * (rect_area(&pending) + rect_area(&drawn))) {
+            pending = merged;
+        } else {
+            wine_surface_add_damage(surface, &pending);
+            pending = drawn;
+        }
+    }
+    if (!wine_gdi_rect_empty(&pending)) {
+        wine_surface_add_damage(surface, &pending);
+    }
+    return list->count;
+}
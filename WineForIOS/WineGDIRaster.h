@@ -0,0 +1,156 @@
+// WineGDIRaster.h - 窗口后备表面与批量GDI光栅化
+// 纯C实现，替代每次 GetDC/BeginPaint 都新建 UIGraphics 图像上下文的做法：
+//   表面：每个窗口一块常驻的 32位像素缓冲（与 CGBitmapContext 的 BGRA 预乘 little-endian 布局相同），
+//         窗口尺寸不变时一直复用
+//   命令表：DC 上的 GDI 调用只把画笔/画刷/文字颜色连同坐标记录成定长命令，不接触像素；
+//           命令表清空后保留容量，稳定运行时记录不分配内存
+//   执行：整张命令表一次性光栅化到表面（可在任意线程），每条命令的包围盒并入脏矩形集合，
+//         上层只需要把脏矩形上传到屏幕
+//   文字：字形由调用方注册的回调绘制（iOS上用CoreText），没有回调时画等宽的占位方框
+// 坐标语义与GDI一致：矩形的右/下边界不含在内，LineTo 不画终点像素
+#ifndef WINE_GDI_RASTER_H
+#define WINE_GDI_RASTER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define WINE_SURFACE_MAX_DIMENSION  8192
+#define WINE_SURFACE_MAX_DAMAGE     16      // 超过时合并面积增长最小的两块
+#define WINE_GDI_TEXT_MAX           1024    // 单条 TextOut 的最大字节数，超出截断
+
+// COLORREF（0x00BBGGRR）转表面像素（0xAARRGGBB，不透明）
+static inline uint32_t wine_gdi_pixel(uint32_t colorref) {
+    return 0xFF000000u | ((colorref & 0xFF) << 16) | (colorref & 0xFF00) | ((colorref >> 16) & 0xFF);
+}
+
+typedef struct WineGDIRect {
+    int32_t left;
+    int32_t top;
+    int32_t right;                          // 不含
+    int32_t bottom;                         // 不含
+} WineGDIRect;
+
+static inline bool wine_gdi_rect_empty(const WineGDIRect *rect) {
+    return rect->right <= rect->left || rect->bottom <= rect->top;
+}
+
+typedef struct WineSurface WineSurface;
+
+// 文字回调：在 (x, y) 处（文字单元左上角）绘制 text，返回绘制的宽度，bounds 返回实际写入的区域
+// surface 为NULL时只量宽度（不透明背景模式先量再铺底色）
+typedef int32_t (*WineGDITextRenderer)(WineSurface *surface, int32_t x, int32_t y, const char *text, uint32_t length,
+                                       uint32_t color, int32_t font_height, WineGDIRect *bounds, void *user);
+
+struct WineSurface {
+    uint32_t *pixels;
+    int32_t width;
+    int32_t height;
+    int32_t stride;                         // 每行像素数
+    WineGDIRect damage[WINE_SURFACE_MAX_DAMAGE];
+    uint32_t damage_count;
+    WineGDITextRenderer text_renderer;
+    void *text_user;
+};
+
+// 以 background（COLORREF）填充；尺寸超出范围或内存不足返回NULL
+WineSurface *wine_surface_create(int32_t width, int32_t height, uint32_t background);
+void wine_surface_destroy(WineSurface *surface);
+
+// 尺寸变化时重新分配并清为 background，整个表面记为脏；尺寸不变时什么也不做
+bool wine_surface_resize(WineSurface *surface, int32_t width, int32_t height, uint32_t background);
+
+// 把矩形（先裁剪到表面）并入脏矩形集合
+void wine_surface_add_damage(WineSurface *surface, const WineGDIRect *rect);
+
+// 取出并清空脏矩形，返回个数
+uint32_t wine_surface_take_damage(WineSurface *surface, WineGDIRect *rects, uint32_t max);
+
+// MARK: - 绘图状态
+
+#define WINE_GDI_PS_SOLID   0
+#define WINE_GDI_PS_NULL    5
+#define WINE_GDI_TRANSPARENT 1
+#define WINE_GDI_OPAQUE     2
+
+typedef struct WineGDIState {
+    uint32_t pen_color;                     // COLORREF
+    int32_t pen_width;
+    bool pen_null;
+    uint32_t brush_color;
+    bool brush_null;
+    uint32_t text_color;
+    uint32_t background_color;
+    int32_t background_mode;                // WINE_GDI_TRANSPARENT / WINE_GDI_OPAQUE
+    int32_t font_height;
+    int32_t position_x;                     // MoveToEx/LineTo 的当前位置
+    int32_t position_y;
+} WineGDIState;
+
+// GDI默认值：黑色1像素实线画笔、白色画刷、黑字白底不透明、16像素字体、当前位置(0,0)
+void wine_gdi_state_init(WineGDIState *state);
+
+// MARK: - 命令表
+
+typedef enum WineGDIOp {
+    WINE_GDI_FILL_RECT = 1,                 // 用 color 填充 rect
+    WINE_GDI_RECTANGLE,                     // 画笔描边 + 画刷填充内部
+    WINE_GDI_ELLIPSE,
+    WINE_GDI_LINE,                          // (x0,y0) -> (x1,y1)，不含终点
+    WINE_GDI_TEXT,
+    WINE_GDI_SET_PIXEL
+} WineGDIOp;
+
+typedef struct WineGDICommand {
+    uint8_t op;
+    bool pen_null;
+    bool brush_null;
+    bool opaque;                            // 文字背景
+    int32_t pen_width;
+    int32_t font_height;
+    uint32_t pen_color;                     // 已换算为表面像素
+    uint32_t fill_color;                    // 画刷/填充/文字背景
+    uint32_t text_color;
+    WineGDIRect rect;                       // 线段时为两个端点 (left,top)-(right,bottom)
+    uint32_t text_offset;                   // 文字在 text 池中的位置
+    uint32_t text_length;
+} WineGDICommand;
+
+typedef struct WineGDICommandList {
+    WineGDICommand *commands;
+    uint32_t count;
+    uint32_t capacity;
+    char *text;
+    uint32_t text_used;
+    uint32_t text_capacity;
+} WineGDICommandList;
+
+void wine_gdi_list_init(WineGDICommandList *list);
+void wine_gdi_list_destroy(WineGDICommandList *list);
+
+// 清空但保留容量
+void wine_gdi_list_reset(WineGDICommandList *list);
+
+// 记录函数按当前状态生成命令，内存不足时返回false（命令被丢弃）
+bool wine_gdi_fill_rect(WineGDICommandList *list, const WineGDIRect *rect, uint32_t colorref);
+bool wine_gdi_rectangle(WineGDICommandList *list, const WineGDIState *state, const WineGDIRect *rect);
+bool wine_gdi_ellipse(WineGDICommandList *list, const WineGDIState *state, const WineGDIRect *rect);
+bool wine_gdi_move_to(WineGDIState *state, int32_t x, int32_t y);
+bool wine_gdi_line_to(WineGDICommandList *list, WineGDIState *state, int32_t x, int32_t y);
+bool wine_gdi_text_out(WineGDICommandList *list, const WineGDIState *state, int32_t x, int32_t y,
+                       const char *text, uint32_t length);
+bool wine_gdi_set_pixel(WineGDICommandList *list, int32_t x, int32_t y, uint32_t colorref);
+
+// 在 surface 上执行整张命令表（裁剪到 clip，NULL 表示整个表面），返回执行的命令数
+// 每条命令的实际绘制区域并入表面的脏矩形
+uint32_t wine_gdi_execute(WineSurface *surface, const WineGDICommandList *list, const WineGDIRect *clip);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WINE_GDI_RASTER_H
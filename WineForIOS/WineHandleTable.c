@@ -0,0 +1,218 @@
+// WineHandleTable.c - 分代句柄表实现
+#include "WineHandleTable.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_CAPACITY    256
+#define NO_SLOT             UINT32_MAX
+
+typedef struct HandleSlot {
+    void *object;
+    uint32_t next_free;                     // 空闲链表，存活时无意义
+    uint8_t generation;                     // 当前（存活）或下一次分配（空闲）使用的代数
+    uint8_t type;                           // WINE_HANDLE_FREE 表示空闲
+} HandleSlot;
+
+struct WineHandleTable {
+    HandleSlot *slots;
+    uint32_t capacity;
+    uint32_t free_head;                     // 先进先出：从头取、往尾放
+    uint32_t free_tail;
+    uint32_t live[WINE_HANDLE_TYPE_COUNT];
+    uint32_t peak[WINE_HANDLE_TYPE_COUNT];
+    uint64_t allocations;
+    uint64_t frees;
+    uint64_t stale_lookups;
+};
+
+static inline WineHandle encode(uint32_t index, WineHandleType type, uint8_t generation) {
+    return ((WineHandle)generation << WINE_HANDLE_GENERATION_SHIFT) |
+           ((WineHandle)type << WINE_HANDLE_TYPE_SHIFT) | index;
+}
+
+static inline uint32_t handle_index(WineHandle handle) {
+    return handle & (WINE_HANDLE_MAX_OBJECTS - 1);
+}
+
+static inline uint8_t handle_generation(WineHandle handle) {
+    return (uint8_t)((handle >> WINE_HANDLE_GENERATION_SHIFT) & WINE_HANDLE_MAX_GENERATION);
+}
+
+static inline WineHandleType handle_type(WineHandle handle) {
+    return (WineHandleType)((handle >> WINE_HANDLE_TYPE_SHIFT) & 0xF);
+}
+
+static void push_free(WineHandleTable *table, uint32_t index) {
+    table->slots[index].next_free = NO_SLOT;
+    if (table->free_tail == NO_SLOT) {
+        table->free_head = index;
+    } else {
+        table->slots[table->free_tail].next_free = index;
+    }
+    table->free_tail = index;
+}
+
+// 新槽位按下标顺序接到空闲链表尾部
+static bool grow(WineHandleTable *table, uint32_t capacity) {
+    if (capacity > WINE_HANDLE_MAX_OBJECTS) {
+        capacity = WINE_HANDLE_MAX_OBJECTS;
+    }
+    if (capacity <= table->capacity) {
+        return false;
+    }
+    HandleSlot *slots = realloc(table->slots, capacity * sizeof(HandleSlot));
+    if (!slots) {
+        return false;
+    }
+    table->slots = slots;
+    for (uint32_t i = table->capacity; i < capacity; i++) {
+        slots[i] = (HandleSlot){ .object = NULL, .generation = 1, .type = WINE_HANDLE_FREE };
+        push_free(table, i);
+    }
+    table->live[WINE_HANDLE_FREE] += capacity - table->capacity;
+    table->capacity = capacity;
+    return true;
+}
+
+WineHandleTable *wine_handles_create(uint32_t initial_capacity) {
+    WineHandleTable *table = calloc(1, sizeof(WineHandleTable));
+    if (!table) {
+        return NULL;
+    }
+    table->free_head = table->free_tail = NO_SLOT;
+    if (!grow(table, initial_capacity ? initial_capacity : DEFAULT_CAPACITY)) {
+        free(table);
+        return NULL;
+    }
+    return table;
+}
+
+void wine_handles_destroy(WineHandleTable *table, WineHandleRelease release, void *context) {
+    if (!table) {
+        return;
+    }
+    if (release) {
+        for (uint32_t i = 0; i < table->capacity; i++) {
+            if (table->slots[i].type != WINE_HANDLE_FREE) {
+                release(table->slots[i].object, (WineHandleType)table->slots[i].type, context);
+            }
+        }
+    }
+    free(table->slots);
+    free(table);
+}
+
+// MARK: - 分配与释放
+
+WineHandle wine_handles_alloc(WineHandleTable *table, WineHandleType type, void *object) {
+    if (!object || type <= WINE_HANDLE_FREE || type >= WINE_HANDLE_TYPE_COUNT) {
+        return 0;
+    }
+    if (table->free_head == NO_SLOT && !grow(table, table->capacity * 2)) {
+        return 0;
+    }
+
+    const uint32_t index = table->free_head;
+    HandleSlot *slot = &table->slots[index];
+    table->free_head = slot->next_free;
+    if (table->free_head == NO_SLOT) {
+        table->free_tail = NO_SLOT;
+    }
+
+    slot->object = object;
+    slot->type = (uint8_t)type;
+    table->live[WINE_HANDLE_FREE]--;
+    if (++table->live[type] > table->peak[type]) {
+        table->peak[type] = table->live[type];
+    }
+    table->allocations++;
+    return encode(index, type, slot->generation);
+}
+
+void *wine_handles_free(WineHandleTable *table, WineHandle handle, WineHandleType type) {
+    void *object = wine_handles_lookup(table, handle, type);
+    if (!object) {
+        return NULL;
+    }
+    const uint32_t index = handle_index(handle);
+    HandleSlot *slot = &table->slots[index];
+    slot->object = NULL;
+    slot->type = WINE_HANDLE_FREE;
+    slot->generation = slot->generation == WINE_HANDLE_MAX_GENERATION ? 1 : slot->generation + 1;
+    push_free(table, index);
+    table->live[type]--;
+    table->live[WINE_HANDLE_FREE]++;
+    table->frees++;
+    return object;
+}
+
+// MARK: - 查找
+
+void *wine_handles_lookup(WineHandleTable *table, WineHandle handle, WineHandleType type) {
+    const uint32_t index = handle_index(handle);
+    if (handle_type(handle) == type && index < table->capacity) {
+        const HandleSlot *slot = &table->slots[index];
+        if (slot->type == type && slot->generation == handle_generation(handle)) {
+            return slot->object;
+        }
+    }
+    if (handle != 0) {
+        table->stale_lookups++;
+    }
+    return NULL;
+}
+
+void *wine_handles_lookup_any(WineHandleTable *table, WineHandle handle, WineHandleType *type) {
+    const WineHandleType encoded = handle_type(handle);
+    if (encoded == WINE_HANDLE_FREE || encoded >= WINE_HANDLE_TYPE_COUNT) {
+        if (handle != 0) {
+            table->stale_lookups++;
+        }
+        return NULL;
+    }
+    void *object = wine_handles_lookup(table, handle, encoded);
+    if (object && type) {
+        *type = encoded;
+    }
+    return object;
+}
+
+void wine_handles_enumerate(WineHandleTable *table, WineHandleType type, WineHandleVisitor visitor, void *context) {
+    for (uint32_t i = 0; i < table->capacity; i++) {
+        const HandleSlot *slot = &table->slots[i];
+        if (slot->type == type && type != WINE_HANDLE_FREE &&
+            !visitor(encode(i, type, slot->generation), slot->object, context)) {
+            return;
+        }
+    }
+}
+
+// MARK: - 统计
+
+uint32_t wine_handles_live_count(const WineHandleTable *table, WineHandleType type) {
+    return type < WINE_HANDLE_TYPE_COUNT ? table->live[type] : 0;
+}
+
+void wine_handles_get_stats(const WineHandleTable *table, WineHandleStats *stats) {
+    memcpy(stats->live, table->live, sizeof(stats->live));
+    memcpy(stats->peak, table->peak, sizeof(stats->peak));
+    stats->capacity = table->capacity;
+    stats->allocations = table->allocations;
+    stats->frees = table->frees;
+    stats->stale_lookups = table->stale_lookups;
+}
+
+const char *wine_handle_type_name(WineHandleType type) {
+    switch (type) {
+        case WINE_HANDLE_FREE:   return "free";
+        case WINE_HANDLE_WINDOW: return "window";
+        case WINE_HANDLE_DC:     return "dc";
+        case WINE_HANDLE_BRUSH:  return "brush";
+        case WINE_HANDLE_PEN:    return "pen";
+        case WINE_HANDLE_FONT:   return "font";
+        case WINE_HANDLE_BITMAP: return "bitmap";
+        case WINE_HANDLE_THREAD: return "thread";
+        case WINE_HANDLE_EVENT:  return "event";
+        default:                 return "unknown";
+    }
+}
@@ -0,0 +1,84 @@
+// WineHandleTable.h - USER/GDI 对象和内核对象（线程、事件）的分代句柄表
+// 纯C实现，替代以 NSNumber 为键的 NSMutableDictionary：
+//   句柄直接编码槽位下标、对象类型和代数，查找是一次数组下标加两次比较，不分配、不哈希
+//   释放的槽位按先进先出的顺序复用（同一槽位尽量晚复用），每次复用代数加一，旧句柄查找失败而不是指向新对象
+//   按类型统计存活对象数和峰值，用于发现泄漏的DC/画刷
+// 与原来的字典相同，不做同步，由调用方串行访问
+#ifndef WINE_HANDLE_TABLE_H
+#define WINE_HANDLE_TABLE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 句柄布局（32位，保证经客户机32位截断/符号扩展后不变）：
+//   [30..24] 代数（1..127，句柄因此永不为0）  [23..20] 类型  [19..0] 槽位下标
+#define WINE_HANDLE_INDEX_BITS      20
+#define WINE_HANDLE_TYPE_SHIFT      20
+#define WINE_HANDLE_GENERATION_SHIFT 24
+#define WINE_HANDLE_MAX_OBJECTS     (1u << WINE_HANDLE_INDEX_BITS)
+#define WINE_HANDLE_MAX_GENERATION  0x7F
+
+typedef uint32_t WineHandle;
+
+typedef enum WineHandleType {
+    WINE_HANDLE_FREE = 0,
+    WINE_HANDLE_WINDOW,
+    WINE_HANDLE_DC,
+    WINE_HANDLE_BRUSH,
+    WINE_HANDLE_PEN,
+    WINE_HANDLE_FONT,
+    WINE_HANDLE_BITMAP,
+    WINE_HANDLE_THREAD,             // Box64Engine 的内核对象，与 USER/GDI 对象不在同一张表里
+    WINE_HANDLE_EVENT,
+    WINE_HANDLE_TYPE_COUNT
+} WineHandleType;
+
+typedef struct WineHandleStats {
+    uint32_t live[WINE_HANDLE_TYPE_COUNT];  // live[WINE_HANDLE_FREE] 为空闲槽位数
+    uint32_t peak[WINE_HANDLE_TYPE_COUNT];
+    uint32_t capacity;                      // 已分配的槽位数
+    uint64_t allocations;
+    uint64_t frees;
+    uint64_t stale_lookups;                 // 已释放、类型不符或越界的句柄查找
+} WineHandleStats;
+
+typedef struct WineHandleTable WineHandleTable;
+
+// initial_capacity 为0时使用默认值；槽位数组按需倍增
+WineHandleTable *wine_handles_create(uint32_t initial_capacity);
+
+// release 对每个仍存活的对象调用一次（可为NULL）
+typedef void (*WineHandleRelease)(void *object, WineHandleType type, void *context);
+void wine_handles_destroy(WineHandleTable *table, WineHandleRelease release, void *context);
+
+// object 不能为NULL；槽位耗尽或内存不足返回0
+WineHandle wine_handles_alloc(WineHandleTable *table, WineHandleType type, void *object);
+
+// 句柄无效、已释放或类型不符时返回NULL
+void *wine_handles_lookup(WineHandleTable *table, WineHandle handle, WineHandleType type);
+
+// 任意类型的存活句柄，type 返回实际类型（可为NULL）
+void *wine_handles_lookup_any(WineHandleTable *table, WineHandle handle, WineHandleType *type);
+
+// 成功时返回对象指针（交还给调用方释放），句柄无效返回NULL
+void *wine_handles_free(WineHandleTable *table, WineHandle handle, WineHandleType type);
+
+// 按槽位顺序遍历某一类型的存活对象，回调返回false提前结束
+typedef bool (*WineHandleVisitor)(WineHandle handle, void *object, void *context);
+void wine_handles_enumerate(WineHandleTable *table, WineHandleType type, WineHandleVisitor visitor, void *context);
+
+uint32_t wine_handles_live_count(const WineHandleTable *table, WineHandleType type);
+void wine_handles_get_stats(const WineHandleTable *table, WineHandleStats *stats);
+
+const char *wine_handle_type_name(WineHandleType type);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WINE_HANDLE_TABLE_H
@@ -0,0 +1,394 @@
+// WineMessageQueue.c - 每线程Win32消息队列实现
+#include "WineMessageQueue.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#define WM_MOUSEFIRST       0x0200
+#define WM_MOUSELAST        0x020E
+
+// MARK: - 结构
+
+// 有界MPSC环的槽位：sequence == 位置 表示空闲可写，== 位置+1 表示已发布可读
+typedef struct RingSlot {
+    _Atomic uint64_t sequence;
+    WineQueuedMsg msg;
+} RingSlot;
+
+struct WineMsgQueue {
+    _Atomic uint32_t references;
+
+    // 生产者侧
+    RingSlot *slots;
+    uint64_t mask;
+    _Atomic uint64_t enqueue_position;
+    _Atomic uint64_t cursor;                // 最近一次鼠标消息的坐标，高32位x、低32位y
+
+    // 消费者侧（只由拥有队列的线程访问）
+    uint64_t dequeue_position;
+    WineQueuedMsg *backlog;                 // [head, tail) 为已搬出环但尚未取走的消息
+    uint32_t head;
+    uint32_t tail;
+    uint64_t *paint;                        // 待绘制的窗口，按投递先后排列且不重复
+    uint32_t paint_count;
+    uint32_t paint_capacity;
+
+    // WM_QUIT
+    _Atomic bool quit_pending;
+    _Atomic int32_t exit_code;
+
+    // 阻塞等待
+    pthread_mutex_t lock;
+    pthread_cond_t available;
+    _Atomic bool waiting;
+
+    _Atomic uint64_t posted;
+    _Atomic uint64_t dropped;
+    _Atomic uint64_t coalesced;
+    _Atomic uint64_t delivered;
+    _Atomic uint64_t waits;
+};
+
+static inline void count(_Atomic uint64_t *counter) {
+    atomic_fetch_add_explicit(counter, 1, memory_order_relaxed);
+}
+
+uint32_t wine_msgq_tick_count(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000);
+}
+
+// MARK: - 生命周期
+
+WineMsgQueue *wine_msgq_create(uint32_t capacity) {
+    if (capacity == 0) {
+        capacity = WINE_MSGQ_DEFAULT_CAPACITY;
+    }
+    if (capacity > (1u << 24)) {
+        return NULL;
+    }
+    uint32_t size = 2;
+    while (size < capacity) {
+        size <<= 1;
+    }
+
+    WineMsgQueue *queue = calloc(1, sizeof(WineMsgQueue));
+    if (!queue) {
+        return NULL;
+    }
+    queue->slots = calloc(size, sizeof(RingSlot));
+    queue->backlog = calloc(size, sizeof(WineQueuedMsg));
+    if (!queue->slots || !queue->backlog ||
+        pthread_mutex_init(&queue->lock, NULL) != 0) {
+        free(queue->slots);
+        free(queue->backlog);
+        free(queue);
+        return NULL;
+    }
+    if (pthread_cond_init(&queue->available, NULL) != 0) {
+        pthread_mutex_destroy(&queue->lock);
+        free(queue->slots);
+        free(queue->backlog);
+        free(queue);
+        return NULL;
+    }
+    for (uint32_t i = 0; i < size; i++) {
+        atomic_init(&queue->slots[i].sequence, i);
+    }
+    queue->mask = size - 1;
+    atomic_init(&queue->references, 1);
+    return queue;
+}
+
+void wine_msgq_retain(WineMsgQueue *queue) {
+    if (queue) {
+        atomic_fetch_add_explicit(&queue->references, 1, memory_order_relaxed);
+    }
+}
+
+void wine_msgq_release(WineMsgQueue *queue) {
+    if (!queue || atomic_fetch_sub_explicit(&queue->references, 1, memory_order_acq_rel) != 1) {
+        return;
+    }
+    pthread_cond_destroy(&queue->available);
+    pthread_mutex_destroy(&queue->lock);
+    free(queue->paint);
+    free(queue->backlog);
+    free(queue->slots);
+    free(queue);
+}
+
+// MARK: - 投递
+
+static void wake_waiter(WineMsgQueue *queue) {
+    // 与等待方的 waiting=true + 复查 配对：两边都有全屏障，至少一方能看到对方的写入
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&queue->waiting, memory_order_relaxed)) {
+        pthread_mutex_lock(&queue->lock);
+        pthread_cond_signal(&queue->available);
+        pthread_mutex_unlock(&queue->lock);
+    }
+}
+
+bool wine_msgq_post(WineMsgQueue *queue, uint64_t hwnd, uint32_t message, uint64_t wParam, int64_t lParam) {
+    uint64_t cursor;
+    if (message >= WM_MOUSEFIRST && message <= WM_MOUSELAST) {
+        // lParam 低16位为x、高16位为y，均有符号
+        cursor = ((uint64_t)(uint32_t)(int16_t)(lParam & 0xFFFF) << 32) |
+                 (uint32_t)(int16_t)((lParam >> 16) & 0xFFFF);
+        atomic_store_explicit(&queue->cursor, cursor, memory_order_relaxed);
+    } else {
+        cursor = atomic_load_explicit(&queue->cursor, memory_order_relaxed);
+    }
+
+    uint64_t position = atomic_load_explicit(&queue->enqueue_position, memory_order_relaxed);
+    RingSlot *slot;
+    for (;;) {
+        slot = &queue->slots[position & queue->mask];
+        const uint64_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        const int64_t difference = (int64_t)(sequence - position);
+        if (difference == 0) {
+            if (atomic_compare_exchange_weak_explicit(&queue->enqueue_position, &position, position + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (difference < 0) {
+            count(&queue->dropped);
+            return false;
+        } else {
+            position = atomic_load_explicit(&queue->enqueue_position, memory_order_relaxed);
+        }
+    }
+
+    slot->msg = (WineQueuedMsg){
+        .hwnd = hwnd,
+        .message = message,
+        .time = wine_msgq_tick_count(),
+        .wParam = wParam,
+        .lParam = lParam,
+        .pt_x = (int32_t)(cursor >> 32),
+        .pt_y = (int32_t)(uint32_t)cursor,
+    };
+    atomic_store_explicit(&slot->sequence, position + 1, memory_order_release);
+    count(&queue->posted);
+    wake_waiter(queue);
+    return true;
+}
+
+void wine_msgq_post_quit(WineMsgQueue *queue, int32_t exit_code) {
+    atomic_store_explicit(&queue->exit_code, exit_code, memory_order_relaxed);
+    atomic_store_explicit(&queue->quit_pending, true, memory_order_release);
+    wake_waiter(queue);
+}
+
+// MARK: - 消费者侧
+
+static bool ring_has_message(WineMsgQueue *queue) {
+    const RingSlot *slot = &queue->slots[queue->dequeue_position & queue->mask];
+    return atomic_load_explicit(&slot->sequence, memory_order_acquire) == queue->dequeue_position + 1;
+}
+
+static void add_paint(WineMsgQueue *queue, uint64_t hwnd) {
+    for (uint32_t i = 0; i < queue->paint_count; i++) {
+        if (queue->paint[i] == hwnd) {
+            count(&queue->coalesced);
+            return;
+        }
+    }
+    if (queue->paint_count == queue->paint_capacity) {
+        const uint32_t capacity = queue->paint_capacity ? queue->paint_capacity * 2 : 16;
+        uint64_t *paint = realloc(queue->paint, capacity * sizeof(uint64_t));
+        if (!paint) {
+            return;     // 丢掉一次重绘请求，窗口下次失效时再加入
+        }
+        queue->paint = paint;
+        queue->paint_capacity = capacity;
+    }
+    queue->paint[queue->paint_count++] = hwnd;
+}
+
+static void remove_paint(WineMsgQueue *queue, uint32_t index) {
+    memmove(&queue->paint[index], &queue->paint[index + 1],
+            (queue->paint_count - index - 1) * sizeof(uint64_t));
+    queue->paint_count--;
+}
+
+// 把环中已发布的消息搬到积压区，积压区满时剩下的留在环里
+static void drain(WineMsgQueue *queue) {
+    const uint32_t capacity = (uint32_t)queue->mask + 1;
+    while (ring_has_message(queue)) {
+        RingSlot *slot = &queue->slots[queue->dequeue_position & queue->mask];
+        const WineQueuedMsg *msg = &slot->msg;
+
+        if (msg->message == WINE_MSGQ_WM_PAINT) {
+            add_paint(queue, msg->hwnd);
+        } else if (msg->message == WINE_MSGQ_WM_MOUSEMOVE && queue->tail > queue->head &&
+                   queue->backlog[queue->tail - 1].message == WINE_MSGQ_WM_MOUSEMOVE &&
+                   queue->backlog[queue->tail - 1].hwnd == msg->hwnd) {
+            // 与Windows相同：只合并紧挨着的同窗口鼠标移动
+            queue->backlog[queue->tail - 1] = *msg;
+            count(&queue->coalesced);
+        } else {
+            if (queue->tail == capacity) {
+                if (queue->head == 0) {
+                    break;
+                }
+                memmove(queue->backlog, &queue->backlog[queue->head],
+                        (queue->tail - queue->head) * sizeof(WineQueuedMsg));
+                queue->tail -= queue->head;
+                queue->head = 0;
+            }
+            queue->backlog[queue->tail++] = *msg;
+        }
+
+        atomic_store_explicit(&slot->sequence, queue->dequeue_position + capacity, memory_order_release);
+        queue->dequeue_position++;
+    }
+}
+
+static inline bool hwnd_matches(uint64_t filter, uint64_t hwnd) {
+    return filter == 0 || (filter == WINE_MSGQ_THREAD_ONLY ? hwnd == 0 : hwnd == filter);
+}
+
+static inline bool range_matches(uint32_t filter_min, uint32_t filter_max, uint32_t message) {
+    return (filter_min == 0 && filter_max == 0) || (message >= filter_min && message <= filter_max);
+}
+
+WineMsgqResult wine_msgq_peek(WineMsgQueue *queue, WineQueuedMsg *out, uint64_t hwnd,
+                              uint32_t filter_min, uint32_t filter_max, bool remove) {
+    drain(queue);
+
+    // 投递的消息
+    for (uint32_t i = queue->head; i < queue->tail; i++) {
+        const WineQueuedMsg *msg = &queue->backlog[i];
+        if (!hwnd_matches(hwnd, msg->hwnd) || !range_matches(filter_min, filter_max, msg->message)) {
+            continue;
+        }
+        *out = *msg;
+        if (remove) {
+            if (i == queue->head) {
+                queue->head++;
+            } else {
+                memmove(&queue->backlog[i], &queue->backlog[i + 1],
+                        (queue->tail - i - 1) * sizeof(WineQueuedMsg));
+                queue->tail--;
+            }
+            if (queue->head == queue->tail) {
+                queue->head = queue->tail = 0;
+            }
+            count(&queue->delivered);
+        }
+        return WINE_MSGQ_MESSAGE;
+    }
+
+    // WM_QUIT 不受过滤条件影响
+    if (atomic_load_explicit(&queue->quit_pending, memory_order_acquire)) {
+        const uint64_t cursor = atomic_load_explicit(&queue->cursor, memory_order_relaxed);
+        *out = (WineQueuedMsg){
+            .message = WINE_MSGQ_WM_QUIT,
+            .time = wine_msgq_tick_count(),
+            .wParam = (uint64_t)(int64_t)atomic_load_explicit(&queue->exit_code, memory_order_relaxed),
+            .pt_x = (int32_t)(cursor >> 32),
+            .pt_y = (int32_t)(uint32_t)cursor,
+        };
+        if (remove) {
+            atomic_store_explicit(&queue->quit_pending, false, memory_order_relaxed);
+            count(&queue->delivered);
+        }
+        return WINE_MSGQ_QUIT;
+    }
+
+    // WM_PAINT 优先级最低；取走即移除，窗口过程不调用 BeginPaint 也不会反复收到
+    if (range_matches(filter_min, filter_max, WINE_MSGQ_WM_PAINT)) {
+        for (uint32_t i = 0; i < queue->paint_count; i++) {
+            if (!hwnd_matches(hwnd, queue->paint[i])) {
+                continue;
+            }
+            const uint64_t cursor = atomic_load_explicit(&queue->cursor, memory_order_relaxed);
+            *out = (WineQueuedMsg){
+                .hwnd = queue->paint[i],
+                .message = WINE_MSGQ_WM_PAINT,
+                .time = wine_msgq_tick_count(),
+                .pt_x = (int32_t)(cursor >> 32),
+                .pt_y = (int32_t)(uint32_t)cursor,
+            };
+            if (remove) {
+                remove_paint(queue, i);
+                count(&queue->delivered);
+            }
+            return WINE_MSGQ_MESSAGE;
+        }
+    }
+    return WINE_MSGQ_EMPTY;
+}
+
+static void deadline_after(struct timespec *deadline, uint32_t timeout_ms) {
+    // 条件变量按 CLOCK_REALTIME 计时（Darwin 不支持 pthread_condattr_setclock）
+    clock_gettime(CLOCK_REALTIME, deadline);
+    deadline->tv_sec += timeout_ms / 1000;
+    deadline->tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+    if (deadline->tv_nsec >= 1000000000L) {
+        deadline->tv_sec++;
+        deadline->tv_nsec -= 1000000000L;
+    }
+}
+
+WineMsgqResult wine_msgq_get(WineMsgQueue *queue, WineQueuedMsg *out, uint64_t hwnd,
+                             uint32_t filter_min, uint32_t filter_max, uint32_t timeout_ms) {
+    struct timespec deadline;
+    if (timeout_ms != WINE_MSGQ_WAIT_FOREVER) {
+        deadline_after(&deadline, timeout_ms);
+    }
+
+    for (;;) {
+        WineMsgqResult result = wine_msgq_peek(queue, out, hwnd, filter_min, filter_max, true);
+        if (result != WINE_MSGQ_EMPTY || timeout_ms == 0) {
+            return result;
+        }
+
+        bool timed_out = false;
+        pthread_mutex_lock(&queue->lock);
+        atomic_store_explicit(&queue->waiting, true, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
+        // 积压区已满时环中剩下的消息搬不过来，不能算作可取
+        const bool backlog_full = queue->tail - queue->head == (uint32_t)queue->mask + 1;
+        if ((backlog_full || !ring_has_message(queue)) &&
+            !atomic_load_explicit(&queue->quit_pending, memory_order_relaxed)) {
+            count(&queue->waits);
+            if (timeout_ms == WINE_MSGQ_WAIT_FOREVER) {
+                pthread_cond_wait(&queue->available, &queue->lock);
+            } else {
+                timed_out = pthread_cond_timedwait(&queue->available, &queue->lock, &deadline) == ETIMEDOUT;
+            }
+        }
+        atomic_store_explicit(&queue->waiting, false, memory_order_relaxed);
+        pthread_mutex_unlock(&queue->lock);
+
+        if (timed_out) {
+            return wine_msgq_peek(queue, out, hwnd, filter_min, filter_max, true);
+        }
+    }
+}
+
+void wine_msgq_validate(WineMsgQueue *queue, uint64_t hwnd) {
+    drain(queue);
+    for (uint32_t i = 0; i < queue->paint_count; i++) {
+        if (queue->paint[i] == hwnd) {
+            remove_paint(queue, i);
+            return;
+        }
+    }
+}
+
+void wine_msgq_get_stats(WineMsgQueue *queue, WineMsgqStats *stats) {
+    stats->posted = atomic_load_explicit(&queue->posted, memory_order_relaxed);
+    stats->dropped = atomic_load_explicit(&queue->dropped, memory_order_relaxed);
+    stats->coalesced = atomic_load_explicit(&queue->coalesced, memory_order_relaxed);
+    stats->delivered = atomic_load_explicit(&queue->delivered, memory_order_relaxed);
+    stats->waits = atomic_load_explicit(&queue->waits, memory_order_relaxed);
+    stats->pending = queue->tail - queue->head + queue->paint_count;
+}
@@ -0,0 +1,93 @@
+// WineMessageQueue.h - 每线程的Win32消息队列
+// 纯C实现，替代 NSDictionary + NSMutableArray 的消息队列：
+//   投递：任意线程向有界MPSC环写入定长 MSG，无锁；环满时投递失败（对应 PostMessage 的配额错误）
+//   取消息：只由拥有队列的线程调用，先把环中的消息搬到线程私有的积压区，再按 hwnd/消息范围过滤
+//   等待：队列空时在条件变量上阻塞，投递方只在有线程等待时才加锁唤醒
+//   合并：相邻的同窗口 WM_MOUSEMOVE 只保留最新一条；WM_PAINT 按窗口去重，在没有其他消息时才返回
+//   WM_QUIT 是标志而不是队列项，取完普通消息后返回且不受过滤条件影响（与Windows一致）
+//   time 字段取单调时钟的毫秒数（GetTickCount 语义，约49.7天回绕）
+#ifndef WINE_MESSAGE_QUEUE_H
+#define WINE_MESSAGE_QUEUE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define WINE_MSGQ_DEFAULT_CAPACITY  8192    // Windows每线程上限为10000条，取同量级的2的幂
+#define WINE_MSGQ_WAIT_FOREVER      UINT32_MAX
+
+#define WINE_MSGQ_WM_PAINT          0x000F
+#define WINE_MSGQ_WM_QUIT           0x0012
+#define WINE_MSGQ_WM_MOUSEMOVE      0x0200
+
+// hwnd 过滤：0 表示任意窗口，WINE_MSGQ_THREAD_ONLY（即 (HWND)-1）只取 hwnd 为0的线程消息
+#define WINE_MSGQ_THREAD_ONLY       UINT64_MAX
+
+// 与客户机 MSG 字段一一对应，句柄按64位保存
+typedef struct WineQueuedMsg {
+    uint64_t hwnd;
+    uint32_t message;
+    uint32_t time;
+    uint64_t wParam;
+    int64_t lParam;
+    int32_t pt_x;
+    int32_t pt_y;
+} WineQueuedMsg;
+
+typedef enum WineMsgqResult {
+    WINE_MSGQ_MESSAGE = 0,                  // 取到普通消息（包括 WM_PAINT）
+    WINE_MSGQ_QUIT,                         // 取到 WM_QUIT，out 中 wParam 为退出码
+    WINE_MSGQ_EMPTY                         // 没有匹配的消息（PeekMessage）或等待超时（GetMessage）
+} WineMsgqResult;
+
+typedef struct WineMsgqStats {
+    uint64_t posted;
+    uint64_t dropped;                       // 环满导致的投递失败
+    uint64_t coalesced;                     // 被合并掉的 WM_MOUSEMOVE / WM_PAINT
+    uint64_t delivered;
+    uint64_t waits;                         // 取消息时实际阻塞的次数
+    uint32_t pending;                       // 积压区中的消息数（不含环中尚未搬运的）
+} WineMsgqStats;
+
+typedef struct WineMsgQueue WineMsgQueue;
+
+// capacity 向上取整到2的幂，0表示默认值；创建时引用计数为1
+WineMsgQueue *wine_msgq_create(uint32_t capacity);
+
+// 队列被线程和它创建的窗口共同引用，最后一个引用释放时销毁
+void wine_msgq_retain(WineMsgQueue *queue);
+void wine_msgq_release(WineMsgQueue *queue);
+
+// 任意线程调用；time 和 pt 由队列填写（鼠标消息的 pt 取 lParam 中的坐标，其他消息取最近的鼠标位置）
+bool wine_msgq_post(WineMsgQueue *queue, uint64_t hwnd, uint32_t message, uint64_t wParam, int64_t lParam);
+
+// 任意线程调用；设置退出标志并唤醒等待者
+void wine_msgq_post_quit(WineMsgQueue *queue, int32_t exit_code);
+
+// 以下只能由拥有队列的线程调用
+// remove 为false时消息留在队列中（PM_NOREMOVE），WM_QUIT 的退出标志也只在 remove 时清除
+WineMsgqResult wine_msgq_peek(WineMsgQueue *queue, WineQueuedMsg *out, uint64_t hwnd,
+                              uint32_t filter_min, uint32_t filter_max, bool remove);
+
+// 阻塞直到有匹配的消息、WM_QUIT 或超时（毫秒，WINE_MSGQ_WAIT_FOREVER 不超时）
+WineMsgqResult wine_msgq_get(WineMsgQueue *queue, WineQueuedMsg *out, uint64_t hwnd,
+                             uint32_t filter_min, uint32_t filter_max, uint32_t timeout_ms);
+
+// BeginPaint/ValidateRect：丢弃该窗口尚未取走的 WM_PAINT
+void wine_msgq_validate(WineMsgQueue *queue, uint64_t hwnd);
+
+// 统计中 pending 只在拥有队列的线程上准确，其余计数可从任意线程读取
+void wine_msgq_get_stats(WineMsgQueue *queue, WineMsgqStats *stats);
+
+// 单调时钟的毫秒数，截断为32位
+uint32_t wine_msgq_tick_count(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WINE_MESSAGE_QUEUE_H
@@ -0,0 +1,566 @@
+// WineProfiler.c - 性能标记采集与聚合实现
+#include "WineProfiler.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__APPLE__)
+#include <mach/mach_time.h>
+#endif
+
+#define PROF_INTERN_SLOTS   256             // 开放寻址表，至少是标记上限的2倍
+#define PROF_RING_MASK      (WINE_PROF_RING_EVENTS - 1)
+#define PROF_SUB_BITS       3
+#define PROF_SUB_BUCKETS    (1u << PROF_SUB_BITS)
+#define PROF_MAX_OCTAVE     40              // 2^40 ns ≈ 18 分钟，更长的耗时计入最后一个桶
+#define PROF_BUCKETS        ((PROF_MAX_OCTAVE - PROF_SUB_BITS + 2) * PROF_SUB_BUCKETS)
+
+_Static_assert((WINE_PROF_RING_EVENTS & PROF_RING_MASK) == 0, "环大小必须是2的幂");
+_Static_assert(PROF_INTERN_SLOTS >= 2 * WINE_PROF_MAX_MARKERS, "登记表太小");
+
+enum {
+    PROF_PHASE_BEGIN = 0,
+    PROF_PHASE_END = 1
+};
+
+typedef struct ProfEvent {
+    uint64_t timestamp_ns;
+    WineProfMarker marker;
+    uint8_t phase;
+    uint8_t depth;
+    uint32_t reserved;
+} ProfEvent;
+
+typedef struct ProfFrame {
+    uint64_t start_ns;
+    uint64_t child_ns;                      // 已结束的直接子标记耗时之和
+    WineProfMarker marker;
+} ProfFrame;
+
+// 环和计数只由所属线程写；导出和统计从其他线程读（计数用 relaxed 原子，不用读改写）
+typedef struct ProfThread {
+    _Atomic uint64_t head;                  // 已写入的事件总数
+    _Atomic uint64_t export_from;           // reset 时的 head，之前的事件不再导出
+    _Atomic uint64_t unmatched_ends;
+    _Atomic uint64_t implicit_ends;
+    _Atomic uint64_t depth_overflows;
+    uint32_t tid;
+    uint32_t generation;                    // 与全局 reset 代数不同时丢弃栈上的区间
+    uint32_t depth;                         // 可能超过 WINE_PROF_MAX_DEPTH（超出部分只计层数）
+    char name[32];
+    ProfFrame stack[WINE_PROF_MAX_DEPTH];
+    ProfEvent events[WINE_PROF_RING_EVENTS];
+} ProfThread;
+
+typedef struct ProfMarkerAggregate {
+    _Atomic uint64_t count;
+    _Atomic uint64_t total_ns;
+    _Atomic uint64_t self_ns;
+    _Atomic uint64_t min_ns;
+    _Atomic uint64_t max_ns;
+    _Atomic uint32_t buckets[PROF_BUCKETS];
+} ProfMarkerAggregate;
+
+static pthread_mutex_t registry_lock = PTHREAD_MUTEX_INITIALIZER;
+static char marker_names[WINE_PROF_MAX_MARKERS][WINE_PROF_MAX_NAME];
+static _Atomic uint32_t marker_total = 0;
+static _Atomic uint16_t intern_slots[PROF_INTERN_SLOTS];   // 标记ID+1，0 为空
+static ProfMarkerAggregate aggregates[WINE_PROF_MAX_MARKERS];
+
+static ProfThread *_Atomic threads[WINE_PROF_MAX_THREADS];
+static _Atomic uint32_t thread_total = 0;
+static _Atomic uint64_t dropped_threads = 0;
+
+static _Atomic bool profiler_enabled = true;
+static _Atomic uint32_t reset_generation = 0;
+static _Atomic uint64_t epoch_ns = 0;
+
+static _Thread_local ProfThread *current_thread = NULL;
+static _Thread_local bool current_thread_rejected = false;
+
+// MARK: - 时间
+
+#if defined(__APPLE__)
+static mach_timebase_info_data_t timebase;
+static pthread_once_t timebase_once = PTHREAD_ONCE_INIT;
+
+static void load_timebase(void) {
+    mach_timebase_info(&timebase);
+}
+#endif
+
+uint64_t wine_prof_now_ns(void) {
+#if defined(__APPLE__)
+    pthread_once(&timebase_once, load_timebase);
+    return mach_absolute_time() * timebase.numer / timebase.denom;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+static uint64_t trace_epoch(void) {
+    uint64_t epoch = atomic_load_explicit(&epoch_ns, memory_order_relaxed);
+    if (epoch == 0) {
+        uint64_t expected = 0;
+        uint64_t now = wine_prof_now_ns();
+        epoch = atomic_compare_exchange_strong(&epoch_ns, &expected, now) ? now : expected;
+    }
+    return epoch;
+}
+
+// MARK: - 标记登记
+
+static uint32_t name_hash(const char *name) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; name[i] && i < WINE_PROF_MAX_NAME - 1; i++) {
+        hash = (hash ^ (uint8_t)name[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static bool name_matches(WineProfMarker marker, const char *name) {
+    return strncmp(marker_names[marker], name, WINE_PROF_MAX_NAME - 1) == 0;
+}
+
+// 找到时返回ID；否则返回 INVALID，*empty_slot 为探测到的第一个空位
+static WineProfMarker probe(const char *name, uint32_t hash, uint32_t *empty_slot) {
+    for (uint32_t i = 0; i < PROF_INTERN_SLOTS; i++) {
+        uint32_t slot = (hash + i) & (PROF_INTERN_SLOTS - 1);
+        uint16_t value = atomic_load_explicit(&intern_slots[slot], memory_order_acquire);
+        if (value == 0) {
+            *empty_slot = slot;
+            return WINE_PROF_INVALID_MARKER;
+        }
+        if (name_matches((WineProfMarker)(value - 1), name)) {
+            return (WineProfMarker)(value - 1);
+        }
+    }
+    *empty_slot = UINT32_MAX;
+    return WINE_PROF_INVALID_MARKER;
+}
+
+WineProfMarker wine_prof_intern(const char *name) {
+    if (!name || !name[0]) {
+        return WINE_PROF_INVALID_MARKER;
+    }
+    uint32_t hash = name_hash(name);
+    uint32_t empty_slot;
+    WineProfMarker marker = probe(name, hash, &empty_slot);
+    if (marker != WINE_PROF_INVALID_MARKER) {
+        return marker;
+    }
+
+    pthread_mutex_lock(&registry_lock);
+    marker = probe(name, hash, &empty_slot);
+    uint32_t count = atomic_load_explicit(&marker_total, memory_order_relaxed);
+    if (marker == WINE_PROF_INVALID_MARKER && empty_slot != UINT32_MAX && count < WINE_PROF_MAX_MARKERS) {
+        marker = (WineProfMarker)count;
+        strncpy(marker_names[marker], name, WINE_PROF_MAX_NAME - 1);
+        marker_names[marker][WINE_PROF_MAX_NAME - 1] = '\0';
+        atomic_store_explicit(&aggregates[marker].min_ns, UINT64_MAX, memory_order_relaxed);
+        atomic_store_explicit(&marker_total, count + 1, memory_order_release);
+        // 名字写完后再发布槽位，无锁读者看到槽位时一定能看到完整的名字
+        atomic_store_explicit(&intern_slots[empty_slot], (uint16_t)(marker + 1), memory_order_release);
+    }
+    pthread_mutex_unlock(&registry_lock);
+    return marker;
+}
+
+const char *wine_prof_marker_name(WineProfMarker marker) {
+    if (marker >= atomic_load_explicit(&marker_total, memory_order_acquire)) {
+        return NULL;
+    }
+    return marker_names[marker];
+}
+
+uint32_t wine_prof_marker_count(void) {
+    return atomic_load_explicit(&marker_total, memory_order_acquire);
+}
+
+void wine_prof_set_enabled(bool enabled) {
+    atomic_store_explicit(&profiler_enabled, enabled, memory_order_relaxed);
+}
+
+bool wine_prof_is_enabled(void) {
+    return atomic_load_explicit(&profiler_enabled, memory_order_relaxed);
+}
+
+// MARK: - 线程缓冲
+
+// 每个线程第一次使用时分配一次，线程退出后保留（其事件仍可导出）
+static ProfThread *register_thread(void) {
+    if (current_thread_rejected) {
+        return NULL;
+    }
+    ProfThread *thread = calloc(1, sizeof(ProfThread));
+    if (!thread) {
+        current_thread_rejected = true;
+        return NULL;
+    }
+    pthread_mutex_lock(&registry_lock);
+    uint32_t index = atomic_load_explicit(&thread_total, memory_order_relaxed);
+    if (index >= WINE_PROF_MAX_THREADS) {
+        pthread_mutex_unlock(&registry_lock);
+        free(thread);
+        current_thread_rejected = true;
+        return NULL;
+    }
+    thread->tid = index + 1;
+    thread->generation = atomic_load_explicit(&reset_generation, memory_order_acquire);
+    snprintf(thread->name, sizeof(thread->name), "Thread %u", thread->tid);
+    atomic_store_explicit(&threads[index], thread, memory_order_release);
+    atomic_store_explicit(&thread_total, index + 1, memory_order_release);
+    pthread_mutex_unlock(&registry_lock);
+
+    trace_epoch();
+    current_thread = thread;
+    return thread;
+}
+
+static inline ProfThread *acquire_thread(void) {
+    ProfThread *thread = current_thread;
+    if (!thread) {
+        thread = register_thread();
+        if (!thread) {
+            atomic_fetch_add_explicit(&dropped_threads, 1, memory_order_relaxed);
+            return NULL;
+        }
+    }
+    uint32_t generation = atomic_load_explicit(&reset_generation, memory_order_acquire);
+    if (thread->generation != generation) {
+        thread->generation = generation;
+        thread->depth = 0;
+    }
+    return thread;
+}
+
+void wine_prof_set_thread_name(const char *name) {
+    ProfThread *thread = current_thread ? current_thread : register_thread();
+    if (thread && name) {
+        // 名字只在这里写；导出时并发读到一半的名字只影响显示
+        snprintf(thread->name, sizeof(thread->name), "%s", name);
+    }
+}
+
+static inline void bump(_Atomic uint64_t *counter) {
+    // 单写者计数：不需要读改写
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + 1, memory_order_relaxed);
+}
+
+static inline void ring_push(ProfThread *thread, uint64_t timestamp, WineProfMarker marker, uint8_t phase,
+                             uint32_t depth) {
+    uint64_t head = atomic_load_explicit(&thread->head, memory_order_relaxed);
+    ProfEvent *event = &thread->events[head & PROF_RING_MASK];
+    event->timestamp_ns = timestamp;
+    event->marker = marker;
+    event->phase = phase;
+    event->depth = (uint8_t)depth;
+    atomic_store_explicit(&thread->head, head + 1, memory_order_release);
+}
+
+// MARK: - 直方图
+
+static inline uint32_t bucket_index(uint64_t value) {
+    if (value < PROF_SUB_BUCKETS) {
+        return (uint32_t)value;
+    }
+    uint32_t octave = 63 - (uint32_t)__builtin_clzll(value);
+    if (octave > PROF_MAX_OCTAVE) {
+        return PROF_BUCKETS - 1;
+    }
+    uint32_t sub = (uint32_t)(value >> (octave - PROF_SUB_BITS)) & (PROF_SUB_BUCKETS - 1);
+    return ((octave - PROF_SUB_BITS + 1) << PROF_SUB_BITS) | sub;
+}
+
+// 桶的代表值取区间中点
+static uint64_t bucket_value(uint32_t index) {
+    if (index < PROF_SUB_BUCKETS) {
+        return index;
+    }
+    uint32_t octave = (index >> PROF_SUB_BITS) + PROF_SUB_BITS - 1;
+    uint64_t width = 1ULL << (octave - PROF_SUB_BITS);
+    uint64_t lower = (uint64_t)(PROF_SUB_BUCKETS + (index & (PROF_SUB_BUCKETS - 1))) << (octave - PROF_SUB_BITS);
+    return lower + width / 2;
+}
+
+static inline void update_max(_Atomic uint64_t *target, uint64_t value) {
+    uint64_t seen = atomic_load_explicit(target, memory_order_relaxed);
+    while (value > seen &&
+           !atomic_compare_exchange_weak_explicit(target, &seen, value, memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+static inline void update_min(_Atomic uint64_t *target, uint64_t value) {
+    uint64_t seen = atomic_load_explicit(target, memory_order_relaxed);
+    while (value < seen &&
+           !atomic_compare_exchange_weak_explicit(target, &seen, value, memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+static inline void record_sample(WineProfMarker marker, uint64_t duration, uint64_t self) {
+    ProfMarkerAggregate *aggregate = &aggregates[marker];
+    atomic_fetch_add_explicit(&aggregate->buckets[bucket_index(duration)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&aggregate->total_ns, duration, memory_order_relaxed);
+    atomic_fetch_add_explicit(&aggregate->self_ns, self, memory_order_relaxed);
+    update_max(&aggregate->max_ns, duration);
+    update_min(&aggregate->min_ns, duration);
+    // count 最后增加：读者看到的 count 不会多于已计入的桶
+    atomic_fetch_add_explicit(&aggregate->count, 1, memory_order_release);
+}
+
+// MARK: - begin / end
+
+void wine_prof_begin(WineProfMarker marker) {
+    if (!atomic_load_explicit(&profiler_enabled, memory_order_relaxed) || marker >= WINE_PROF_MAX_MARKERS) {
+        return;
+    }
+    ProfThread *thread = acquire_thread();
+    if (!thread) {
+        return;
+    }
+    if (thread->depth >= WINE_PROF_MAX_DEPTH) {
+        thread->depth++;
+        bump(&thread->depth_overflows);
+        return;
+    }
+    uint64_t now = wine_prof_now_ns();
+    ProfFrame *frame = &thread->stack[thread->depth];
+    frame->start_ns = now;
+    frame->child_ns = 0;
+    frame->marker = marker;
+    ring_push(thread, now, marker, PROF_PHASE_BEGIN, thread->depth);
+    thread->depth++;
+}
+
+static inline void close_top(ProfThread *thread, uint64_t now) {
+    thread->depth--;
+    ProfFrame *frame = &thread->stack[thread->depth];
+    uint64_t duration = now > frame->start_ns ? now - frame->start_ns : 0;
+    uint64_t self = duration > frame->child_ns ? duration - frame->child_ns : 0;
+    if (thread->depth > 0) {
+        thread->stack[thread->depth - 1].child_ns += duration;
+    }
+    ring_push(thread, now, frame->marker, PROF_PHASE_END, thread->depth);
+    record_sample(frame->marker, duration, self);
+}
+
+void wine_prof_end(WineProfMarker marker) {
+    if (!atomic_load_explicit(&profiler_enabled, memory_order_relaxed) || marker >= WINE_PROF_MAX_MARKERS) {
+        return;
+    }
+    ProfThread *thread = current_thread;
+    if (!thread) {
+        return;
+    }
+    uint32_t generation = atomic_load_explicit(&reset_generation, memory_order_acquire);
+    if (thread->generation != generation) {
+        thread->generation = generation;
+        thread->depth = 0;
+        return;
+    }
+    if (thread->depth > WINE_PROF_MAX_DEPTH) {
+        thread->depth--;
+        return;
+    }
+    int32_t match = (int32_t)thread->depth - 1;
+    while (match >= 0 && thread->stack[match].marker != marker) {
+        match--;
+    }
+    if (match < 0) {
+        bump(&thread->unmatched_ends);
+        return;
+    }
+    uint64_t now = wine_prof_now_ns();
+    while ((int32_t)thread->depth - 1 > match) {
+        bump(&thread->implicit_ends);
+        close_top(thread, now);
+    }
+    close_top(thread, now);
+}
+
+// MARK: - 统计
+
+bool wine_prof_get_marker_stats(WineProfMarker marker, WineProfMarkerStats *stats) {
+    if (!stats) {
+        return false;
+    }
+    memset(stats, 0, sizeof(*stats));
+    if (marker >= wine_prof_marker_count()) {
+        return false;
+    }
+    ProfMarkerAggregate *aggregate = &aggregates[marker];
+    uint64_t count = atomic_load_explicit(&aggregate->count, memory_order_acquire);
+    if (count == 0) {
+        return false;
+    }
+
+    // 与写入并发时各桶之和可能略多于 count，按实际读到的桶总数求分位
+    uint32_t buckets[PROF_BUCKETS];
+    uint64_t bucket_total = 0;
+    for (uint32_t i = 0; i < PROF_BUCKETS; i++) {
+        buckets[i] = atomic_load_explicit(&aggregate->buckets[i], memory_order_relaxed);
+        bucket_total += buckets[i];
+    }
+    stats->count = count;
+    stats->total_ns = atomic_load_explicit(&aggregate->total_ns, memory_order_relaxed);
+    stats->self_ns = atomic_load_explicit(&aggregate->self_ns, memory_order_relaxed);
+    stats->min_ns = atomic_load_explicit(&aggregate->min_ns, memory_order_relaxed);
+    stats->max_ns = atomic_load_explicit(&aggregate->max_ns, memory_order_relaxed);
+
+    const double quantiles[3] = { 0.50, 0.95, 0.99 };
+    uint64_t *outputs[3] = { &stats->p50_ns, &stats->p95_ns, &stats->p99_ns };
+    uint64_t seen = 0;
+    uint32_t index = 0;
+    for (int q = 0; q < 3; q++) {
+        uint64_t rank = (uint64_t)(quantiles[q] * (double)bucket_total + 0.5);
+        if (rank == 0) {
+            rank = 1;
+        }
+        while (index < PROF_BUCKETS && seen + buckets[index] < rank) {
+            seen += buckets[index];
+            index++;
+        }
+        uint64_t value = bucket_value(index < PROF_BUCKETS ? index : PROF_BUCKETS - 1);
+        // 桶中点可能落在实际观测范围外
+        if (value > stats->max_ns) value = stats->max_ns;
+        if (value < stats->min_ns) value = stats->min_ns;
+        *outputs[q] = value;
+    }
+    return true;
+}
+
+void wine_prof_get_counters(WineProfCounters *counters) {
+    if (!counters) {
+        return;
+    }
+    memset(counters, 0, sizeof(*counters));
+    uint32_t total = atomic_load_explicit(&thread_total, memory_order_acquire);
+    for (uint32_t i = 0; i < total; i++) {
+        ProfThread *thread = atomic_load_explicit(&threads[i], memory_order_acquire);
+        if (!thread) continue;
+        counters->events += atomic_load_explicit(&thread->head, memory_order_relaxed) -
+                            atomic_load_explicit(&thread->export_from, memory_order_relaxed);
+        counters->unmatched_ends += atomic_load_explicit(&thread->unmatched_ends, memory_order_relaxed);
+        counters->implicit_ends += atomic_load_explicit(&thread->implicit_ends, memory_order_relaxed);
+        counters->depth_overflows += atomic_load_explicit(&thread->depth_overflows, memory_order_relaxed);
+    }
+    counters->dropped_threads = atomic_load_explicit(&dropped_threads, memory_order_relaxed);
+    counters->threads = total;
+    counters->markers = wine_prof_marker_count();
+}
+
+void wine_prof_reset(void) {
+    pthread_mutex_lock(&registry_lock);
+    uint32_t markers = atomic_load_explicit(&marker_total, memory_order_relaxed);
+    for (uint32_t m = 0; m < markers; m++) {
+        ProfMarkerAggregate *aggregate = &aggregates[m];
+        atomic_store_explicit(&aggregate->count, 0, memory_order_relaxed);
+        atomic_store_explicit(&aggregate->total_ns, 0, memory_order_relaxed);
+        atomic_store_explicit(&aggregate->self_ns, 0, memory_order_relaxed);
+        atomic_store_explicit(&aggregate->max_ns, 0, memory_order_relaxed);
+        atomic_store_explicit(&aggregate->min_ns, UINT64_MAX, memory_order_relaxed);
+        for (uint32_t i = 0; i < PROF_BUCKETS; i++) {
+            atomic_store_explicit(&aggregate->buckets[i], 0, memory_order_relaxed);
+        }
+    }
+    uint32_t total = atomic_load_explicit(&thread_total, memory_order_relaxed);
+    for (uint32_t i = 0; i < total; i++) {
+        ProfThread *thread = atomic_load_explicit(&threads[i], memory_order_relaxed);
+        atomic_store_explicit(&thread->export_from, atomic_load_explicit(&thread->head, memory_order_acquire),
+                              memory_order_relaxed);
+        atomic_store_explicit(&thread->unmatched_ends, 0, memory_order_relaxed);
+        atomic_store_explicit(&thread->implicit_ends, 0, memory_order_relaxed);
+        atomic_store_explicit(&thread->depth_overflows, 0, memory_order_relaxed);
+    }
+    atomic_store_explicit(&dropped_threads, 0, memory_order_relaxed);
+    atomic_store_explicit(&epoch_ns, wine_prof_now_ns(), memory_order_relaxed);
+    atomic_fetch_add_explicit(&reset_generation, 1, memory_order_release);
+    pthread_mutex_unlock(&registry_lock);
+}
+
+// MARK: - Chrome trace 导出
+
+static void write_json_string(FILE *out, const char *text) {
+    fputc('"', out);
+    for (const unsigned char *p = (const unsigned char *)text; *p; p++) {
+        if (*p == '"' || *p == '\\') {
+            fputc('\\', out);
+            fputc(*p, out);
+        } else if (*p < 0x20) {
+            fprintf(out, "\\u%04x", *p);
+        } else {
+            fputc(*p, out);
+        }
+    }
+    fputc('"', out);
+}
+
+uint64_t wine_prof_export_chrome_trace(FILE *out) {
+    if (!out) {
+        return 0;
+    }
+    // 快照缓冲区较大，放堆上；只在导出时分配
+    ProfEvent *snapshot = malloc(sizeof(ProfEvent) * WINE_PROF_RING_EVENTS);
+    if (!snapshot) {
+        return 0;
+    }
+    uint64_t epoch = trace_epoch();
+    uint64_t written = 0;
+    bool first = true;
+    fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", out);
+
+    uint32_t total = atomic_load_explicit(&thread_total, memory_order_acquire);
+    for (uint32_t t = 0; t < total; t++) {
+        ProfThread *thread = atomic_load_explicit(&threads[t], memory_order_acquire);
+        if (!thread) continue;
+
+        fprintf(out, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":",
+                first ? "" : ",", thread->tid);
+        write_json_string(out, thread->name);
+        fputs("}}", out);
+        first = false;
+
+        // 所属线程可能正在写：先复制，再按复制后的 head 丢掉可能已被覆盖的部分
+        uint64_t head = atomic_load_explicit(&thread->head, memory_order_acquire);
+        uint64_t start = atomic_load_explicit(&thread->export_from, memory_order_relaxed);
+        if (head - start > WINE_PROF_RING_EVENTS) {
+            start = head - WINE_PROF_RING_EVENTS;
+        }
+        for (uint64_t i = start; i < head; i++) {
+            snapshot[i - start] = thread->events[i & PROF_RING_MASK];
+        }
+        atomic_thread_fence(memory_order_acquire);
+        uint64_t head_after = atomic_load_explicit(&thread->head, memory_order_relaxed);
+        uint64_t valid_from = head_after > WINE_PROF_RING_EVENTS ? head_after - WINE_PROF_RING_EVENTS : 0;
+        if (valid_from > start) {
+            valid_from = valid_from < head ? valid_from : head;
+        } else {
+            valid_from = start;
+        }
+
+        // 被覆盖的 begin 对应的 end 不输出：只在已输出的 begin 之内配对
+        uint32_t open = 0;
+        for (uint64_t i = valid_from; i < head; i++) {
+            const ProfEvent *event = &snapshot[i - start];
+            if (event->phase == PROF_PHASE_END) {
+                if (open == 0) continue;
+                open--;
+            } else {
+                open++;
+            }
+            const char *name = wine_prof_marker_name(event->marker);
+            double ts = event->timestamp_ns >= epoch ? (double)(event->timestamp_ns - epoch) / 1000.0 : 0.0;
+            fputs(",\n{\"name\":", out);
+            write_json_string(out, name ? name : "?");
+            fprintf(out, ",\"cat\":\"wine\",\"ph\":\"%s\",\"ts\":%.3f,\"pid\":1,\"tid\":%u}",
+                    event->phase == PROF_PHASE_BEGIN ? "B" : "E", ts, thread->tid);
+            written++;
+        }
+    }
+    fputs("\n]}\n", out);
+    free(snapshot);
+    return written;
+}
@@ -0,0 +1,84 @@
+// WineProfiler.h - 性能标记（begin/end 区间）的采集、聚合与 Chrome trace 导出
+// 纯C实现，替代 MoltenVKBridge 里用 NSValue 包装 PerformanceMarker 追加到数组、结束时 strcmp 线性查找的做法：
+//   标记ID：名字只在第一次出现时登记（加锁），之后的查找走无锁的开放寻址表；热路径建议缓存ID
+//   采集：每个线程一个单写者环（环满时覆盖最旧的事件）和一个嵌套栈，begin/end 不加锁、不分配内存；
+//         时间源是 mach_absolute_time（Apple）/ clock_gettime(CLOCK_MONOTONIC)，单位纳秒
+//   嵌套：end 时匹配栈上最近的同名标记，中间未结束的标记一起隐式结束；
+//         父标记累计子标记耗时，得到每个标记的自身耗时（帧内各阶段的拆分）
+//   聚合：end 时把耗时计入该标记的对数分桶直方图（每个2的幂区间8个子桶，相对误差约6%），
+//         读取时由直方图求 p50/p95/p99，不需要保留全部样本
+//   导出：遍历各线程环中仍保留的事件，写成 Chrome trace JSON（chrome://tracing、Perfetto 可直接打开）
+// 除 reset 外所有函数都可以在任意线程调用；reset 与并发的 begin/end 同时发生时，跨越 reset 的区间被丢弃
+#ifndef WINE_PROFILER_H
+#define WINE_PROFILER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define WINE_PROF_MAX_MARKERS       128
+#define WINE_PROF_MAX_NAME          48      // 含结尾的 '\0'，更长的名字被截断（截断后相同的名字共用一个ID）
+#define WINE_PROF_MAX_DEPTH         32      // 超过的嵌套层只保持配对，不记录
+#define WINE_PROF_MAX_THREADS       64      // 超过的线程的事件被丢弃并计数
+#define WINE_PROF_RING_EVENTS       4096    // 每线程保留的最近事件数（2的幂）
+#define WINE_PROF_INVALID_MARKER    0xFFFF
+
+typedef uint16_t WineProfMarker;
+
+typedef struct WineProfMarkerStats {
+    uint64_t count;
+    uint64_t total_ns;
+    uint64_t self_ns;                       // 扣除嵌套子标记后的耗时
+    uint64_t min_ns;
+    uint64_t max_ns;
+    uint64_t p50_ns;
+    uint64_t p95_ns;
+    uint64_t p99_ns;
+} WineProfMarkerStats;
+
+typedef struct WineProfCounters {
+    uint64_t events;                        // 写入环的 begin/end 事件总数
+    uint64_t unmatched_ends;                // end 找不到对应的 begin
+    uint64_t implicit_ends;                 // 因外层标记结束而被隐式结束的标记
+    uint64_t depth_overflows;               // 超过最大嵌套深度、未记录的 begin
+    uint64_t dropped_threads;               // 线程数超限时被丢弃的 begin/end
+    uint32_t threads;
+    uint32_t markers;
+} WineProfCounters;
+
+// 名字 → ID；表满时返回 WINE_PROF_INVALID_MARKER（对它的 begin/end 是空操作）
+WineProfMarker wine_prof_intern(const char *name);
+const char *wine_prof_marker_name(WineProfMarker marker);
+uint32_t wine_prof_marker_count(void);
+
+// 默认开启；关闭后 begin/end 只读一个原子标志就返回
+void wine_prof_set_enabled(bool enabled);
+bool wine_prof_is_enabled(void);
+
+void wine_prof_begin(WineProfMarker marker);
+void wine_prof_end(WineProfMarker marker);
+
+// 当前线程在 trace 里显示的名字（可选）
+void wine_prof_set_thread_name(const char *name);
+
+uint64_t wine_prof_now_ns(void);
+
+// 没有任何完成样本时返回false
+bool wine_prof_get_marker_stats(WineProfMarker marker, WineProfMarkerStats *stats);
+void wine_prof_get_counters(WineProfCounters *counters);
+
+// 清空直方图和各线程环中已有的事件；标记ID保持不变
+void wine_prof_reset(void);
+
+// 写出 Chrome trace JSON，返回写出的事件数；环中开头那些 begin 已被覆盖的 end 会被跳过
+uint64_t wine_prof_export_chrome_trace(FILE *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WINE_PROFILER_H
@@ -0,0 +1,943 @@
+// X86Decoder.c - 表驱动的x86-64指令解码器
+// 热路径：前缀分类表 + 操作码属性表查找，不做任何字符串操作
+// 冷路径：x86_format_insn 按需生成Intel语法助记符
+#include "X86Decoder.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+// MARK: - 操作码属性表
+
+// 属性位布局（uint16_t）:
+//   [0:3]  操作数形式 X86OperandForm
+//   [4:7]  立即数类型
+//   [8]    有ModR/M
+//   [9]    8位操作数
+//   [10]   64位模式下默认64位操作数（PUSH/POP/近跳转）
+//   [11]   64位模式下无效
+//   [12]   F6/F7组：/0 /1 带立即数
+//   [13]   特权/不安全
+//   [14]   控制流转移
+enum {
+    IMM_NONE = 0,
+    IMM_8,          // ib
+    IMM_16,         // iw
+    IMM_Z,          // iz: 16/32位，64位操作数时符号扩展
+    IMM_V,          // iv: 16/32/64位（MOV r, imm）
+    IMM_16_8,       // ENTER iw, ib
+    IMM_REL8,       // rel8
+    IMM_RELZ,       // rel32
+    IMM_MOFFS       // 按地址宽度
+};
+
+#define F(form)   ((uint16_t)(form))
+#define I(kind)   ((uint16_t)((kind) << 4))
+#define M         ((uint16_t)(1 << 8))
+#define B         ((uint16_t)(1 << 9))
+#define D64       ((uint16_t)(1 << 10))
+#define INV       ((uint16_t)(1 << 11))
+#define G3        ((uint16_t)(1 << 12))
+#define U         ((uint16_t)(1 << 13))
+#define BR        ((uint16_t)(1 << 14))
+
+#define ATTR_FORM(a)  ((a) & 0x0F)
+#define ATTR_IMM(a)   (((a) >> 4) & 0x0F)
+
+// 00-3F 的ALU行: op r/m8,r8 / op r/m,r / op r8,r/m8 / op r,r/m / op AL,ib / op eAX,iz
+#define ALU_ROW \
+    M | B | F(X86_FORM_RM_REG), M | F(X86_FORM_RM_REG), \
+    M | B | F(X86_FORM_REG_RM), M | F(X86_FORM_REG_RM), \
+    I(IMM_8) | B | F(X86_FORM_ACC_IMM), I(IMM_Z) | F(X86_FORM_ACC_IMM)
+
+#define ROW4(x) x, x, x, x
+#define ROW8(x) ROW4(x), ROW4(x)
+#define ROW16(x) ROW8(x), ROW8(x)
+
+static const uint16_t primary_attrs[256] = {
+    /* 00 */ ALU_ROW, INV, INV,
+    /* 08 */ ALU_ROW, INV, 0 /* 0F escape */,
+    /* 10 */ ALU_ROW, INV, INV,
+    /* 18 */ ALU_ROW, INV, INV,
+    /* 20 */ ALU_ROW, 0 /* ES */, INV,
+    /* 28 */ ALU_ROW, 0 /* CS */, INV,
+    /* 30 */ ALU_ROW, 0 /* SS */, INV,
+    /* 38 */ ALU_ROW, 0 /* DS */, INV,
+    /* 40 */ ROW16(0 /* REX */),
+    /* 50 */ ROW16(F(X86_FORM_REG_OPC) | D64),
+    /* 60 */ INV, INV, INV, M | F(X86_FORM_REG_RM),
+    /* 64 */ 0, 0, 0, 0,
+    /* 68 */ I(IMM_Z) | F(X86_FORM_IMM) | D64, M | I(IMM_Z) | F(X86_FORM_REG_RM_IMM),
+    /* 6A */ I(IMM_8) | F(X86_FORM_IMM) | D64, M | I(IMM_8) | F(X86_FORM_REG_RM_IMM),
+    /* 6C */ B | U, U, B | U, U,
+    /* 70 */ ROW16(I(IMM_REL8) | F(X86_FORM_REL) | D64 | BR),
+    /* 80 */ M | B | I(IMM_8) | F(X86_FORM_RM_IMM), M | I(IMM_Z) | F(X86_FORM_RM_IMM),
+    /* 82 */ INV, M | I(IMM_8) | F(X86_FORM_RM_IMM),
+    /* 84 */ M | B | F(X86_FORM_RM_REG), M | F(X86_FORM_RM_REG),
+    /* 86 */ M | B | F(X86_FORM_RM_REG), M | F(X86_FORM_RM_REG),
+    /* 88 */ M | B | F(X86_FORM_RM_REG), M | F(X86_FORM_RM_REG),
+    /* 8A */ M | B | F(X86_FORM_REG_RM), M | F(X86_FORM_REG_RM),
+    /* 8C */ M | F(X86_FORM_RM_REG), M | F(X86_FORM_REG_RM),
+    /* 8E */ M | F(X86_FORM_REG_RM), M | F(X86_FORM_RM) | D64,
+    /* 90 */ ROW8(F(X86_FORM_REG_OPC)),
+    /* 98 */ F(X86_FORM_NONE), F(X86_FORM_NONE), INV, F(X86_FORM_NONE),
+    /* 9C */ F(X86_FORM_NONE) | D64, F(X86_FORM_NONE) | D64, F(X86_FORM_NONE), F(X86_FORM_NONE),
+    /* A0 */ B | I(IMM_MOFFS) | F(X86_FORM_MOFFS), I(IMM_MOFFS) | F(X86_FORM_MOFFS),
+    /* A2 */ B | I(IMM_MOFFS) | F(X86_FORM_MOFFS), I(IMM_MOFFS) | F(X86_FORM_MOFFS),
+    /* A4 */ B, 0, B, 0,
+    /* A8 */ B | I(IMM_8) | F(X86_FORM_ACC_IMM), I(IMM_Z) | F(X86_FORM_ACC_IMM),
+    /* AA */ B, 0, B, 0, B, 0,
+    /* B0 */ ROW8(B | I(IMM_8) | F(X86_FORM_REG_IMM)),
+    /* B8 */ ROW8(I(IMM_V) | F(X86_FORM_REG_IMM)),
+    /* C0 */ M | B | I(IMM_8) | F(X86_FORM_RM_IMM), M | I(IMM_8) | F(X86_FORM_RM_IMM),
+    /* C2 */ I(IMM_16) | F(X86_FORM_IMM) | D64 | BR, F(X86_FORM_NONE) | D64 | BR,
+    /* C4 */ INV /* VEX3 */, INV /* VEX2 */,
+    /* C6 */ M | B | I(IMM_8) | F(X86_FORM_RM_IMM), M | I(IMM_Z) | F(X86_FORM_RM_IMM),
+    /* C8 */ I(IMM_16_8) | F(X86_FORM_IMM) | D64, F(X86_FORM_NONE) | D64,
+    /* CA */ I(IMM_16) | F(X86_FORM_IMM) | U | BR, F(X86_FORM_NONE) | U | BR,
+    /* CC */ U, I(IMM_8) | F(X86_FORM_IMM) | U, INV, U | BR,
+    /* D0 */ M | B | F(X86_FORM_RM), M | F(X86_FORM_RM), M | B | F(X86_FORM_RM), M | F(X86_FORM_RM),
+    /* D4 */ INV, INV, INV, B,
+    /* D8 */ ROW8(M | F(X86_FORM_RM)),
+    /* E0 */ I(IMM_REL8) | F(X86_FORM_REL) | D64 | BR, I(IMM_REL8) | F(X86_FORM_REL) | D64 | BR,
+    /* E2 */ I(IMM_REL8) | F(X86_FORM_REL) | D64 | BR, I(IMM_REL8) | F(X86_FORM_REL) | D64 | BR,
+    /* E4 */ B | I(IMM_8) | F(X86_FORM_IMM) | U, I(IMM_8) | F(X86_FORM_IMM) | U,
+    /* E6 */ B | I(IMM_8) | F(X86_FORM_IMM) | U, I(IMM_8) | F(X86_FORM_IMM) | U,
+    /* E8 */ I(IMM_RELZ) | F(X86_FORM_REL) | D64 | BR, I(IMM_RELZ) | F(X86_FORM_REL) | D64 | BR,
+    /* EA */ INV, I(IMM_REL8) | F(X86_FORM_REL) | D64 | BR,
+    /* EC */ B | U, U, B | U, U,
+    /* F0 */ 0 /* LOCK */, U, 0 /* REPNE */, 0 /* REP */,
+    /* F4 */ U, 0, M | B | F(X86_FORM_RM) | G3, M | F(X86_FORM_RM) | G3,
+    /* F8 */ 0, 0, U, U, 0, 0,
+    /* FE */ M | B | F(X86_FORM_RM), M | F(X86_FORM_RM)
+};
+
+// 0F 两字节操作码属性表
+static const uint16_t secondary_attrs[256] = {
+    /* 00 */ M | F(X86_FORM_RM) | U, M | F(X86_FORM_RM) | U, M | F(X86_FORM_REG_RM) | U, M | F(X86_FORM_REG_RM) | U,
+    /* 04 */ INV, U | BR /* SYSCALL */, U, U | BR /* SYSRET */,
+    /* 08 */ U, U, INV, U /* UD2 */,
+    /* 0C */ INV, M | F(X86_FORM_RM), 0 /* FEMMS */, INV,
+    /* 10 */ M | F(X86_FORM_REG_RM), M | F(X86_FORM_RM_REG), M | F(X86_FORM_REG_RM), M | F(X86_FORM_RM_REG),
+    /* 14 */ M | F(X86_FORM_REG_RM), M | F(X86_FORM_REG_RM), M | F(X86_FORM_REG_RM), M | F(X86_FORM_RM_REG),
+    /* 18 */ ROW8(M | F(X86_FORM_RM)),
+    /* 20 */ M | U, M | U, M | U, M | U, INV, INV, INV, INV,
+    /* 28 */ M | F(X86_FORM_REG_RM), M | F(X86_FORM_RM_REG), M | F(X86_FORM_REG_RM), M | F(X86_FORM_RM_REG),
+    /* 2C */ M | F(X86_FORM_REG_RM), M | F(X86_FORM_REG_RM), M | F(X86_FORM_REG_RM), M | F(X86_FORM_REG_RM),
+    /* 30 */ U, 0 /* RDTSC */, U, U, U | BR, U | BR, INV, U,
+    /* 38 */ 0 /* 0F38 escape */, INV, 0 /* 0F3A escape */, INV, INV, INV, INV, INV,
+    /* 40 */ ROW16(M | F(X86_FORM_REG_RM)),
+    /* 50 */ ROW16(M | F(X86_FORM_REG_RM)),
+    /* 60 */ ROW16(M | F(X86_FORM_REG_RM)),
+    /* 70 */ M | I(IMM_8) | F(X86_FORM_REG_RM_IMM), M | I(IMM_8) | F(X86_FORM_RM_IMM),
+    /* 72 */ M | I(IMM_8) | F(X86_FORM_RM_IMM), M | I(IMM_8) | F(X86_FORM_RM_IMM),
+    /* 74 */ M | F(X86_FORM_REG_RM), M | F(X86_FORM_REG_RM), M | F(X86_FORM_REG_RM), 0 /* EMMS */,
+    /* 78 */ M | U, M | U, INV, INV,
+    /* 7C */ M | F(X86_FORM_REG_RM), M | F(X86_FORM_REG_RM), M | F(X86_FORM_RM_REG), M | F(X86_FORM_RM_REG),
+    /* 80 */ ROW16(I(IMM_RELZ) | F(X86_FORM_REL) | D64 | BR),
+    /* 90 */ ROW16(M | B | F(X86_FORM_RM)),
+    /* A0 */ D64, D64, 0 /* CPUID */, M | F(X86_FORM_RM_REG),
+    /* A4 */ M | I(IMM_8) | F(X86_FORM_RM_REG), M | F(X86_FORM_RM_REG), INV, INV,
+    /* A8 */ D64, D64, U /* RSM */, M | F(X86_FORM_RM_REG),
+    /* AC */ M | I(IMM_8) | F(X86_FORM_RM_REG), M | F(X86_FORM_RM_REG), M | F(X86_FORM_RM), M | F(X86_FORM_REG_RM),
+    /* B0 */ M | B | F(X86_FORM_RM_REG), M | F(X86_FORM_RM_REG), M | F(X86_FORM_REG_RM), M | F(X86_FORM_RM_REG),
+    /* B4 */ M | F(X86_FORM_REG_RM), M | F(X86_FORM_REG_RM), M | F(X86_FORM_REG_RM), M | F(X86_FORM_REG_RM),
+    /* B8 */ M | F(X86_FORM_REG_RM), M | F(X86_FORM_REG_RM), M | I(IMM_8) | F(X86_FORM_RM_IMM), M | F(X86_FORM_RM_REG),
+    /* BC */ M | F(X86_FORM_REG_RM), M | F(X86_FORM_REG_RM), M | F(X86_FORM_REG_RM), M | F(X86_FORM_REG_RM),
+    /* C0 */ M | B | F(X86_FORM_RM_REG), M | F(X86_FORM_RM_REG), M | I(IMM_8) | F(X86_FORM_REG_RM_IMM), M | F(X86_FORM_RM_REG),
+    /* C4 */ M | I(IMM_8) | F(X86_FORM_REG_RM_IMM), M | I(IMM_8) | F(X86_FORM_REG_RM_IMM),
+    /* C6 */ M | I(IMM_8) | F(X86_FORM_REG_RM_IMM), M | F(X86_FORM_RM),
+    /* C8 */ ROW8(F(X86_FORM_REG_OPC)),
+    /* D0 */ ROW4(M | F(X86_FORM_REG_RM)),
+    /* D4 */ M | F(X86_FORM_REG_RM), M | F(X86_FORM_REG_RM), M | F(X86_FORM_RM_REG) /* MOVQ */, M | F(X86_FORM_REG_RM),
+    /* D8 */ ROW8(M | F(X86_FORM_REG_RM)),
+    /* E0 */ ROW16(M | F(X86_FORM_REG_RM)),
+    /* F0 */ ROW16(M | F(X86_FORM_REG_RM))
+};
+
+// 前缀分类表：0 = 非前缀
+enum {
+    PFX_NONE = 0,
+    PFX_LOCK,
+    PFX_REP,
+    PFX_REPNE,
+    PFX_OPSIZE,
+    PFX_ADDRSIZE,
+    PFX_SEGMENT,
+    PFX_REX
+};
+
+static const uint8_t prefix_class[256] = {
+    [0x26] = PFX_SEGMENT, [0x2E] = PFX_SEGMENT, [0x36] = PFX_SEGMENT, [0x3E] = PFX_SEGMENT,
+    [0x40] = PFX_REX, [0x41] = PFX_REX, [0x42] = PFX_REX, [0x43] = PFX_REX,
+    [0x44] = PFX_REX, [0x45] = PFX_REX, [0x46] = PFX_REX, [0x47] = PFX_REX,
+    [0x48] = PFX_REX, [0x49] = PFX_REX, [0x4A] = PFX_REX, [0x4B] = PFX_REX,
+    [0x4C] = PFX_REX, [0x4D] = PFX_REX, [0x4E] = PFX_REX, [0x4F] = PFX_REX,
+    [0x64] = PFX_SEGMENT, [0x65] = PFX_SEGMENT,
+    [0x66] = PFX_OPSIZE, [0x67] = PFX_ADDRSIZE,
+    [0xF0] = PFX_LOCK, [0xF2] = PFX_REPNE, [0xF3] = PFX_REP
+};
+
+// MARK: - 解码
+
+static inline uint16_t load_u16(const uint8_t *p) {
+    uint16_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t load_u32(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t load_u64(const uint8_t *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// 超出可用字节时区分"截断"和"超过15字节上限"
+static inline X86DecodeStatus overrun_status(size_t needed) {
+    return needed > X86_MAX_INSN_LENGTH ? X86_DECODE_TOO_LONG : X86_DECODE_TRUNCATED;
+}
+
+X86DecodeStatus x86_decode(const uint8_t *code, size_t max_length, X86DecodedInsn *insn) {
+    memset(insn, 0, sizeof(*insn));
+    insn->base = X86_REG_NONE;
+    insn->index = X86_REG_NONE;
+
+    if (!code || max_length == 0) {
+        return X86_DECODE_TRUNCATED;
+    }
+
+    const size_t limit = max_length < X86_MAX_INSN_LENGTH ? max_length : X86_MAX_INSN_LENGTH;
+    size_t pos = 0;
+    uint16_t prefixes = 0;
+    uint8_t rex = 0;
+
+    // 1. 前缀：每个字节一次表查找
+    for (;;) {
+        if (pos >= limit) {
+            return overrun_status(pos + 1);
+        }
+        uint8_t byte = code[pos];
+        uint8_t cls = prefix_class[byte];
+        if (cls == PFX_NONE) {
+            break;
+        }
+        // REX只有紧挨操作码时才生效，后面再出现传统前缀则作废
+        if (cls != PFX_REX) {
+            rex = 0;
+        }
+        switch (cls) {
+            case PFX_LOCK:     prefixes |= X86_PREFIX_LOCK; break;
+            case PFX_REP:      prefixes = (uint16_t)((prefixes & ~X86_PREFIX_REPNE) | X86_PREFIX_REP); break;
+            case PFX_REPNE:    prefixes = (uint16_t)((prefixes & ~X86_PREFIX_REP) | X86_PREFIX_REPNE); break;
+            case PFX_OPSIZE:   prefixes |= X86_PREFIX_OPSIZE; break;
+            case PFX_ADDRSIZE: prefixes |= X86_PREFIX_ADDRSIZE; break;
+            case PFX_SEGMENT:  prefixes |= X86_PREFIX_SEGMENT; insn->segment = byte; break;
+            case PFX_REX:      rex = byte; break;
+        }
+        pos++;
+    }
+
+    // 2. 操作码与映射
+    uint8_t map = X86_MAP_PRIMARY;
+    uint8_t opcode = code[pos++];
+    uint16_t attr;
+
+    if (opcode == 0x0F) {
+        if (pos >= limit) {
+            return overrun_status(pos + 1);
+        }
+        opcode = code[pos++];
+        if (opcode == 0x38 || opcode == 0x3A) {
+            map = (opcode == 0x38) ? X86_MAP_0F38 : X86_MAP_0F3A;
+            if (pos >= limit) {
+                return overrun_status(pos + 1);
+            }
+            opcode = code[pos++];
+            attr = (map == X86_MAP_0F38) ? (M | F(X86_FORM_REG_RM))
+                                         : (M | I(IMM_8) | F(X86_FORM_REG_RM_IMM));
+        } else {
+            map = X86_MAP_0F;
+            attr = secondary_attrs[opcode];
+        }
+        // 0F映射下 66/F2/F3 作为强制前缀；F2/F3 优先于 66
+        if (prefixes & X86_PREFIX_REPNE) {
+            insn->mandatory_prefix = 0xF2;
+        } else if (prefixes & X86_PREFIX_REP) {
+            insn->mandatory_prefix = 0xF3;
+        } else if (prefixes & X86_PREFIX_OPSIZE) {
+            insn->mandatory_prefix = 0x66;
+        }
+    } else {
+        attr = primary_attrs[opcode];
+    }
+
+    insn->map = map;
+    insn->opcode = opcode;
+    insn->prefixes = prefixes;
+    insn->rex = rex;
+    insn->form = (uint8_t)ATTR_FORM(attr);
+    insn->length = (uint8_t)pos;
+
+    if (attr & INV) {
+        return X86_DECODE_INVALID;
+    }
+
+    uint8_t flags = 0;
+    if (attr & U) {
+        flags |= X86_INSN_UNSAFE;
+    }
+    if (attr & BR) {
+        flags |= X86_INSN_BRANCH;
+    }
+
+    // 3. 操作数宽度
+    bool default64 = (attr & D64) != 0;
+    insn->address_size = (prefixes & X86_PREFIX_ADDRSIZE) ? 4 : 8;
+
+    // 4. ModR/M + SIB + 位移
+    if (attr & M) {
+        if (pos >= limit) {
+            return overrun_status(pos + 1);
+        }
+        uint8_t modrm = code[pos++];
+        uint8_t mod = modrm >> 6;
+        uint8_t rm = modrm & 7;
+        flags |= X86_INSN_HAS_MODRM;
+        insn->modrm = modrm;
+        insn->mod = mod;
+        insn->reg = (uint8_t)(((modrm >> 3) & 7) | (X86_REX_R(rex) << 3));
+
+        if (mod == 3) {
+            insn->rm = (uint8_t)(rm | (X86_REX_B(rex) << 3));
+        } else {
+            flags |= X86_INSN_MEMORY;
+            insn->scale = 1;
+            if (rm == 4) {
+                if (pos >= limit) {
+                    return overrun_status(pos + 1);
+                }
+                uint8_t sib = code[pos++];
+                uint8_t index = (uint8_t)(((sib >> 3) & 7) | (X86_REX_X(rex) << 3));
+                uint8_t base = sib & 7;
+                flags |= X86_INSN_HAS_SIB;
+                insn->sib = sib;
+                insn->scale = (uint8_t)(1 << (sib >> 6));
+                insn->index = (index == 4) ? X86_REG_NONE : index;
+                if (base == 5 && mod == 0) {
+                    insn->disp_size = 4;
+                } else {
+                    insn->base = (uint8_t)(base | (X86_REX_B(rex) << 3));
+                }
+            } else if (rm == 5 && mod == 0) {
+                flags |= X86_INSN_RIP_REL;
+                insn->disp_size = 4;
+            } else {
+                insn->base = (uint8_t)(rm | (X86_REX_B(rex) << 3));
+            }
+            if (mod == 1) {
+                insn->disp_size = 1;
+            } else if (mod == 2) {
+                insn->disp_size = 4;
+            }
+        }
+
+        if (insn->disp_size) {
+            if (pos + insn->disp_size > limit) {
+                return overrun_status(pos + insn->disp_size);
+            }
+            insn->disp = (insn->disp_size == 1) ? (int8_t)code[pos] : (int32_t)load_u32(code + pos);
+            pos += insn->disp_size;
+        }
+
+        // FF组: /2 CALL /4 JMP /6 PUSH 默认64位，/2-/5 为控制流转移
+        if (map == X86_MAP_PRIMARY && opcode == 0xFF) {
+            uint8_t group_op = (modrm >> 3) & 7;
+            if (group_op == 2 || group_op == 4 || group_op == 6) {
+                default64 = true;
+            }
+            if (group_op >= 2 && group_op <= 5) {
+                flags |= X86_INSN_BRANCH;
+            }
+        }
+    } else if (insn->form == X86_FORM_REG_OPC || insn->form == X86_FORM_REG_IMM) {
+        insn->reg = (uint8_t)((opcode & 7) | (X86_REX_B(rex) << 3));
+    }
+
+    if (attr & B) {
+        insn->operand_size = 1;
+    } else if (X86_REX_W(rex)) {
+        insn->operand_size = 8;
+    } else if (prefixes & X86_PREFIX_OPSIZE) {
+        insn->operand_size = 2;
+    } else {
+        insn->operand_size = default64 ? 8 : 4;
+    }
+
+    // 5. 立即数
+    uint8_t imm_kind = (uint8_t)ATTR_IMM(attr);
+    if ((attr & G3) && x86_insn_group_op(insn) <= 1) {
+        // TEST r/m, imm
+        imm_kind = (attr & B) ? IMM_8 : IMM_Z;
+        insn->form = X86_FORM_RM_IMM;
+    }
+
+    if (imm_kind != IMM_NONE) {
+        uint8_t size;
+        switch (imm_kind) {
+            case IMM_8:
+            case IMM_REL8:  size = 1; break;
+            case IMM_16:    size = 2; break;
+            case IMM_16_8:  size = 3; break;
+            case IMM_RELZ:  size = 4; break;
+            case IMM_Z:     size = (insn->operand_size == 2) ? 2 : 4; break;
+            case IMM_V:     size = insn->operand_size; break;
+            case IMM_MOFFS: size = insn->address_size; break;
+            default:        size = 0; break;
+        }
+        if (pos + size > limit) {
+            return overrun_status(pos + size);
+        }
+        const uint8_t *p = code + pos;
+        switch (size) {
+            case 1:
+                insn->imm = (int8_t)p[0];
+                break;
+            case 2:
+                insn->imm = (imm_kind == IMM_16) ? (int64_t)load_u16(p) : (int16_t)load_u16(p);
+                break;
+            case 3:
+                insn->imm = (int64_t)load_u16(p) | ((int64_t)p[2] << 16);
+                break;
+            case 4:
+                // MOV r32, imm32 与 moffs32 零扩展，其余符号扩展
+                insn->imm = (imm_kind == IMM_V || imm_kind == IMM_MOFFS) ? (int64_t)load_u32(p)
+                                                                         : (int32_t)load_u32(p);
+                break;
+            case 8:
+                insn->imm = (int64_t)load_u64(p);
+                break;
+        }
+        insn->imm_size = size;
+        pos += size;
+    }
+
+    insn->flags = flags;
+    insn->length = (uint8_t)pos;
+    return X86_DECODE_OK;
+}
+
+// MARK: - 助记符格式化（冷路径）
+
+static const char *const reg_names_64[16] = {
+    "RAX", "RCX", "RDX", "RBX", "RSP", "RBP", "RSI", "RDI",
+    "R8", "R9", "R10", "R11", "R12", "R13", "R14", "R15"
+};
+static const char *const reg_names_32[16] = {
+    "EAX", "ECX", "EDX", "EBX", "ESP", "EBP", "ESI", "EDI",
+    "R8D", "R9D", "R10D", "R11D", "R12D", "R13D", "R14D", "R15D"
+};
+static const char *const reg_names_16[16] = {
+    "AX", "CX", "DX", "BX", "SP", "BP", "SI", "DI",
+    "R8W", "R9W", "R10W", "R11W", "R12W", "R13W", "R14W", "R15W"
+};
+static const char *const reg_names_8_rex[16] = {
+    "AL", "CL", "DL", "BL", "SPL", "BPL", "SIL", "DIL",
+    "R8B", "R9B", "R10B", "R11B", "R12B", "R13B", "R14B", "R15B"
+};
+static const char *const reg_names_8_legacy[8] = {
+    "AL", "CL", "DL", "BL", "AH", "CH", "DH", "BH"
+};
+static const char *const xmm_names[16] = {
+    "XMM0", "XMM1", "XMM2", "XMM3", "XMM4", "XMM5", "XMM6", "XMM7",
+    "XMM8", "XMM9", "XMM10", "XMM11", "XMM12", "XMM13", "XMM14", "XMM15"
+};
+
+static const char *const condition_names[16] = {
+    "O", "NO", "B", "AE", "E", "NE", "BE", "A",
+    "S", "NS", "P", "NP", "L", "GE", "LE", "G"
+};
+
+static const char *const alu_names[8] = { "ADD", "OR", "ADC", "SBB", "AND", "SUB", "XOR", "CMP" };
+static const char *const shift_names[8] = { "ROL", "ROR", "RCL", "RCR", "SHL", "SHR", "SAL", "SAR" };
+static const char *const group3_names[8] = { "TEST", "TEST", "NOT", "NEG", "MUL", "IMUL", "DIV", "IDIV" };
+static const char *const group5_names[8] = { "INC", "DEC", "CALL", "CALLF", "JMP", "JMPF", "PUSH", "(bad)" };
+
+static const char *const primary_names[256] = {
+    [0x63] = "MOVSXD", [0x68] = "PUSH", [0x69] = "IMUL", [0x6A] = "PUSH", [0x6B] = "IMUL",
+    [0x6C] = "INSB", [0x6D] = "INS", [0x6E] = "OUTSB", [0x6F] = "OUTS",
+    [0x84] = "TEST", [0x85] = "TEST", [0x86] = "XCHG", [0x87] = "XCHG",
+    [0x88] = "MOV", [0x89] = "MOV", [0x8A] = "MOV", [0x8B] = "MOV",
+    [0x8C] = "MOV", [0x8D] = "LEA", [0x8E] = "MOV", [0x8F] = "POP",
+    [0x98] = "CDQE", [0x99] = "CQO", [0x9B] = "FWAIT", [0x9C] = "PUSHF", [0x9D] = "POPF",
+    [0x9E] = "SAHF", [0x9F] = "LAHF",
+    [0xA0] = "MOV", [0xA1] = "MOV", [0xA2] = "MOV", [0xA3] = "MOV",
+    [0xA4] = "MOVS", [0xA5] = "MOVS", [0xA6] = "CMPS", [0xA7] = "CMPS",
+    [0xA8] = "TEST", [0xA9] = "TEST", [0xAA] = "STOS", [0xAB] = "STOS",
+    [0xAC] = "LODS", [0xAD] = "LODS", [0xAE] = "SCAS", [0xAF] = "SCAS",
+    [0xC2] = "RET", [0xC3] = "RET", [0xC6] = "MOV", [0xC7] = "MOV",
+    [0xC8] = "ENTER", [0xC9] = "LEAVE", [0xCA] = "RETF", [0xCB] = "RETF",
+    [0xCC] = "INT3", [0xCD] = "INT", [0xCF] = "IRETQ", [0xD7] = "XLAT",
+    [0xE0] = "LOOPNE", [0xE1] = "LOOPE", [0xE2] = "LOOP", [0xE3] = "JRCXZ",
+    [0xE4] = "IN", [0xE5] = "IN", [0xE6] = "OUT", [0xE7] = "OUT",
+    [0xE8] = "CALL", [0xE9] = "JMP", [0xEB] = "JMP",
+    [0xEC] = "IN", [0xED] = "IN", [0xEE] = "OUT", [0xEF] = "OUT",
+    [0xF1] = "INT1", [0xF4] = "HLT", [0xF5] = "CMC",
+    [0xF8] = "CLC", [0xF9] = "STC", [0xFA] = "CLI", [0xFB] = "STI", [0xFC] = "CLD", [0xFD] = "STD",
+    [0xFE] = "INC"
+};
+
+static const char *const secondary_names[256] = {
+    [0x00] = "SLDT", [0x01] = "SGDT", [0x02] = "LAR", [0x03] = "LSL", [0x05] = "SYSCALL",
+    [0x06] = "CLTS", [0x07] = "SYSRET", [0x08] = "INVD", [0x09] = "WBINVD", [0x0B] = "UD2",
+    [0x0D] = "PREFETCHW", [0x0E] = "FEMMS",
+    [0x10] = "MOVUPS", [0x11] = "MOVUPS", [0x12] = "MOVLPS", [0x13] = "MOVLPS",
+    [0x14] = "UNPCKLPS", [0x15] = "UNPCKHPS", [0x16] = "MOVHPS", [0x17] = "MOVHPS",
+    [0x18] = "PREFETCH", [0x1F] = "NOP",
+    [0x20] = "MOV", [0x21] = "MOV", [0x22] = "MOV", [0x23] = "MOV",
+    [0x28] = "MOVAPS", [0x29] = "MOVAPS", [0x2A] = "CVTPI2PS", [0x2B] = "MOVNTPS",
+    [0x2C] = "CVTTPS2PI", [0x2D] = "CVTPS2PI", [0x2E] = "UCOMISS", [0x2F] = "COMISS",
+    [0x30] = "WRMSR", [0x31] = "RDTSC", [0x32] = "RDMSR", [0x33] = "RDPMC",
+    [0x34] = "SYSENTER", [0x35] = "SYSEXIT", [0x37] = "GETSEC",
+    [0x50] = "MOVMSKPS", [0x51] = "SQRTPS", [0x52] = "RSQRTPS", [0x53] = "RCPPS",
+    [0x54] = "ANDPS", [0x55] = "ANDNPS", [0x56] = "ORPS", [0x57] = "XORPS",
+    [0x58] = "ADDPS", [0x59] = "MULPS", [0x5A] = "CVTPS2PD", [0x5B] = "CVTDQ2PS",
+    [0x5C] = "SUBPS", [0x5D] = "MINPS", [0x5E] = "DIVPS", [0x5F] = "MAXPS",
+    [0x60] = "PUNPCKLBW", [0x61] = "PUNPCKLWD", [0x62] = "PUNPCKLDQ", [0x63] = "PACKSSWB",
+    [0x64] = "PCMPGTB", [0x65] = "PCMPGTW", [0x66] = "PCMPGTD", [0x67] = "PACKUSWB",
+    [0x68] = "PUNPCKHBW", [0x69] = "PUNPCKHWD", [0x6A] = "PUNPCKHDQ", [0x6B] = "PACKSSDW",
+    [0x6C] = "PUNPCKLQDQ", [0x6D] = "PUNPCKHQDQ", [0x6E] = "MOVD", [0x6F] = "MOVQ",
+    [0x70] = "PSHUFW", [0x71] = "PSHIFTW", [0x72] = "PSHIFTD", [0x73] = "PSHIFTQ",
+    [0x74] = "PCMPEQB", [0x75] = "PCMPEQW", [0x76] = "PCMPEQD", [0x77] = "EMMS",
+    [0x78] = "VMREAD", [0x79] = "VMWRITE",
+    [0x7E] = "MOVD", [0x7F] = "MOVQ",
+    [0xA0] = "PUSH FS", [0xA1] = "POP FS", [0xA2] = "CPUID", [0xA3] = "BT",
+    [0xA4] = "SHLD", [0xA5] = "SHLD", [0xA8] = "PUSH GS", [0xA9] = "POP GS", [0xAA] = "RSM",
+    [0xAB] = "BTS", [0xAC] = "SHRD", [0xAD] = "SHRD", [0xAE] = "FXSAVE/FENCE", [0xAF] = "IMUL",
+    [0xB0] = "CMPXCHG", [0xB1] = "CMPXCHG", [0xB2] = "LSS", [0xB3] = "BTR",
+    [0xB4] = "LFS", [0xB5] = "LGS", [0xB6] = "MOVZX", [0xB7] = "MOVZX",
+    [0xB8] = "POPCNT", [0xB9] = "UD1", [0xBA] = "BT*", [0xBB] = "BTC",
+    [0xBC] = "BSF", [0xBD] = "BSR", [0xBE] = "MOVSX", [0xBF] = "MOVSX",
+    [0xC0] = "XADD", [0xC1] = "XADD", [0xC2] = "CMPPS", [0xC3] = "MOVNTI",
+    [0xC4] = "PINSRW", [0xC5] = "PEXTRW", [0xC6] = "SHUFPS", [0xC7] = "CMPXCHG16B",
+    [0xD4] = "PADDQ", [0xD5] = "PMULLW", [0xD7] = "PMOVMSKB",
+    [0xDB] = "PAND", [0xDF] = "PANDN", [0xEB] = "POR", [0xEF] = "PXOR",
+    [0xFA] = "PSUBD", [0xFB] = "PSUBQ", [0xFC] = "PADDB", [0xFD] = "PADDW", [0xFE] = "PADDD",
+    [0xFF] = "UD0"
+};
+
+// 0F映射下带强制前缀的名称；表中为NULL时沿用 secondary_names（如 66 0F B6 MOVZX r16）
+static const char *const secondary_names_66[256] = {
+    [0x10] = "MOVUPD", [0x11] = "MOVUPD", [0x12] = "MOVLPD", [0x13] = "MOVLPD",
+    [0x14] = "UNPCKLPD", [0x15] = "UNPCKHPD", [0x16] = "MOVHPD", [0x17] = "MOVHPD",
+    [0x28] = "MOVAPD", [0x29] = "MOVAPD", [0x2A] = "CVTPI2PD", [0x2B] = "MOVNTPD",
+    [0x2C] = "CVTTPD2PI", [0x2D] = "CVTPD2PI", [0x2E] = "UCOMISD", [0x2F] = "COMISD",
+    [0x50] = "MOVMSKPD", [0x51] = "SQRTPD", [0x54] = "ANDPD", [0x55] = "ANDNPD",
+    [0x56] = "ORPD", [0x57] = "XORPD", [0x58] = "ADDPD", [0x59] = "MULPD",
+    [0x5A] = "CVTPD2PS", [0x5B] = "CVTPS2DQ", [0x5C] = "SUBPD", [0x5D] = "MINPD",
+    [0x5E] = "DIVPD", [0x5F] = "MAXPD",
+    [0x6F] = "MOVDQA", [0x70] = "PSHUFD", [0x7C] = "HADDPD", [0x7D] = "HSUBPD", [0x7F] = "MOVDQA",
+    [0xC2] = "CMPPD", [0xC6] = "SHUFPD", [0xD0] = "ADDSUBPD", [0xD6] = "MOVQ", [0xE6] = "CVTTPD2DQ"
+};
+
+static const char *const secondary_names_f2[256] = {
+    [0x10] = "MOVSD", [0x11] = "MOVSD", [0x12] = "MOVDDUP",
+    [0x2A] = "CVTSI2SD", [0x2C] = "CVTTSD2SI", [0x2D] = "CVTSD2SI",
+    [0x51] = "SQRTSD", [0x58] = "ADDSD", [0x59] = "MULSD", [0x5A] = "CVTSD2SS",
+    [0x5C] = "SUBSD", [0x5D] = "MINSD", [0x5E] = "DIVSD", [0x5F] = "MAXSD",
+    [0x70] = "PSHUFLW", [0x7C] = "HADDPS", [0x7D] = "HSUBPS",
+    [0xC2] = "CMPSD", [0xD0] = "ADDSUBPS", [0xE6] = "CVTPD2DQ", [0xF0] = "LDDQU"
+};
+
+static const char *const secondary_names_f3[256] = {
+    [0x10] = "MOVSS", [0x11] = "MOVSS", [0x12] = "MOVSLDUP", [0x16] = "MOVSHDUP",
+    [0x2A] = "CVTSI2SS", [0x2C] = "CVTTSS2SI", [0x2D] = "CVTSS2SI",
+    [0x51] = "SQRTSS", [0x52] = "RSQRTSS", [0x53] = "RCPSS", [0x58] = "ADDSS", [0x59] = "MULSS",
+    [0x5A] = "CVTSS2SD", [0x5B] = "CVTTPS2DQ", [0x5C] = "SUBSS", [0x5D] = "MINSS",
+    [0x5E] = "DIVSS", [0x5F] = "MAXSS",
+    [0x6F] = "MOVDQU", [0x70] = "PSHUFHW", [0x7E] = "MOVQ", [0x7F] = "MOVDQU",
+    [0xB8] = "POPCNT", [0xBC] = "TZCNT", [0xBD] = "LZCNT", [0xC2] = "CMPSS", [0xE6] = "CVTDQ2PD"
+};
+
+const char *x86_register_name(uint8_t reg, uint8_t size, bool has_rex) {
+    reg &= 15;
+    switch (size) {
+        case 1:  return (has_rex || reg >= 8) ? reg_names_8_rex[reg] : reg_names_8_legacy[reg];
+        case 2:  return reg_names_16[reg];
+        case 4:  return reg_names_32[reg];
+        default: return reg_names_64[reg];
+    }
+}
+
+// 是否以XMM寄存器作为 reg/rm 操作数（仅用于格式化）
+static bool uses_xmm_operands(const X86DecodedInsn *insn) {
+    if (insn->map == X86_MAP_0F38 || insn->map == X86_MAP_0F3A) {
+        return true;
+    }
+    if (insn->map != X86_MAP_0F) {
+        return false;
+    }
+    uint8_t op = insn->opcode;
+    return (op >= 0x10 && op <= 0x17) || (op >= 0x28 && op <= 0x2F) ||
+           (op >= 0x50 && op <= 0x7F && op != 0x77) ||
+           op == 0xC2 || (op >= 0xC4 && op <= 0xC6) || (op >= 0xD0 && op <= 0xFE);
+}
+
+// SSE指令里 reg / rm 哪一侧是通用寄存器（MOVD、CVTSI2SD、CVTTSD2SI、MOVMSKPD、PEXTRW 等）
+static bool xmm_reg_is_gpr(const X86DecodedInsn *insn) {
+    uint8_t op = insn->opcode;
+    bool scalar = insn->mandatory_prefix == 0xF2 || insn->mandatory_prefix == 0xF3;
+    return op == 0x50 || op == 0xC5 || op == 0xD7 || ((op == 0x2C || op == 0x2D) && scalar);
+}
+
+static bool xmm_rm_is_gpr(const X86DecodedInsn *insn) {
+    uint8_t op = insn->opcode;
+    bool scalar = insn->mandatory_prefix == 0xF2 || insn->mandatory_prefix == 0xF3;
+    return op == 0xC4 || (op == 0x2A && scalar) ||
+           ((op == 0x6E || op == 0x7E) && insn->mandatory_prefix != 0xF3);
+}
+
+// SSE内存操作数宽度：标量 F3 取32位、F2 取64位，其余按指令
+static uint8_t xmm_memory_size(const X86DecodedInsn *insn) {
+    uint8_t op = insn->opcode;
+    switch (insn->mandatory_prefix) {
+        case 0xF3:
+            if (op == 0x7E || op == 0xE6) return 8;
+            if (op == 0x10 || op == 0x11 || op == 0x2C || op == 0x2D || op == 0xC2 ||
+                (op >= 0x51 && op <= 0x5F && op != 0x5B)) return 4;
+            return 16;
+        case 0xF2:
+            if (op == 0x10 || op == 0x11 || op == 0x12 || op == 0x2C || op == 0x2D || op == 0xC2 ||
+                (op >= 0x51 && op <= 0x5F)) return 8;
+            return 16;
+        case 0x66:
+            if (op == 0x12 || op == 0x13 || op == 0x16 || op == 0x17 ||
+                op == 0x2E || op == 0x2F || op == 0xD6) return 8;
+            return 16;
+        default:
+            if (op == 0x2E || op == 0x2F) return 4;
+            if (op == 0x12 || op == 0x13 || op == 0x16 || op == 0x17) return 8;
+            return 16;
+    }
+}
+
+// SSE指令里的通用寄存器不受 66 前缀影响，按 REX.W 取32/64位
+static uint8_t gpr_operand_size(const X86DecodedInsn *insn) {
+    if (uses_xmm_operands(insn)) {
+        return X86_REX_W(insn->rex) ? 8 : 4;
+    }
+    return insn->operand_size;
+}
+
+static const char *secondary_mnemonic(const X86DecodedInsn *insn) {
+    uint8_t op = insn->opcode;
+    const char *name = NULL;
+    switch (insn->mandatory_prefix) {
+        case 0x66: name = secondary_names_66[op]; break;
+        case 0xF2: name = secondary_names_f2[op]; break;
+        case 0xF3: name = secondary_names_f3[op]; break;
+    }
+    if (!name && (op == 0x6E || op == 0x7E) && X86_REX_W(insn->rex)) {
+        name = "MOVQ";
+    }
+    return name ? name : secondary_names[op];
+}
+
+typedef struct FormatBuffer {
+    char *data;
+    size_t size;
+    size_t used;
+} FormatBuffer;
+
+static void fb_append(FormatBuffer *fb, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+static void fb_append(FormatBuffer *fb, const char *fmt, ...) {
+    if (fb->used >= fb->size) {
+        return;
+    }
+    va_list args;
+    va_start(args, fmt);
+    int written = vsnprintf(fb->data + fb->used, fb->size - fb->used, fmt, args);
+    va_end(args);
+    if (written > 0) {
+        fb->used += (size_t)written;
+        if (fb->used >= fb->size) {
+            fb->used = fb->size - 1;
+        }
+    }
+}
+
+static const char *size_keyword(uint8_t size) {
+    switch (size) {
+        case 1:  return "BYTE";
+        case 2:  return "WORD";
+        case 4:  return "DWORD";
+        case 16: return "XMMWORD";
+        default: return "QWORD";
+    }
+}
+
+static void format_reg(FormatBuffer *fb, const X86DecodedInsn *insn, uint8_t reg, bool xmm) {
+    fb_append(fb, "%s", xmm ? xmm_names[reg & 15] : x86_register_name(reg, gpr_operand_size(insn), insn->rex != 0));
+}
+
+static void format_memory(FormatBuffer *fb, const X86DecodedInsn *insn, uint8_t size) {
+    static const char *const seg_names[256] = {
+        [0x26] = "ES", [0x2E] = "CS", [0x36] = "SS", [0x3E] = "DS", [0x64] = "FS", [0x65] = "GS"
+    };
+    fb_append(fb, "%s PTR ", size_keyword(size));
+    if (insn->segment) {
+        fb_append(fb, "%s:", seg_names[insn->segment]);
+    }
+    fb_append(fb, "[");
+    bool any = false;
+    if (insn->flags & X86_INSN_RIP_REL) {
+        fb_append(fb, "RIP");
+        any = true;
+    } else if (insn->base != X86_REG_NONE) {
+        fb_append(fb, "%s", x86_register_name(insn->base, insn->address_size, true));
+        any = true;
+    }
+    if (insn->index != X86_REG_NONE) {
+        fb_append(fb, "%s%s*%u", any ? "+" : "", x86_register_name(insn->index, insn->address_size, true), insn->scale);
+        any = true;
+    }
+    if (insn->disp_size || !any) {
+        int64_t disp = insn->disp;
+        if (any) {
+            fb_append(fb, "%s0x%llX", disp < 0 ? "-" : "+", (unsigned long long)(disp < 0 ? -disp : disp));
+        } else {
+            fb_append(fb, "0x%llX", (unsigned long long)(uint32_t)insn->disp);
+        }
+    }
+    fb_append(fb, "]");
+}
+
+static void format_rm(FormatBuffer *fb, const X86DecodedInsn *insn, bool xmm) {
+    // MOVZX/MOVSX 的源操作数宽度与目标不同
+    uint8_t size = gpr_operand_size(insn);
+    if (insn->map == X86_MAP_0F && (insn->opcode == 0xB6 || insn->opcode == 0xBE)) {
+        size = 1;
+    } else if (insn->map == X86_MAP_0F && (insn->opcode == 0xB7 || insn->opcode == 0xBF)) {
+        size = 2;
+    }
+    if (insn->flags & X86_INSN_MEMORY) {
+        // PINSRW 的内存源是16位，寄存器源是32位
+        if (xmm) {
+            size = xmm_memory_size(insn);
+        } else if (insn->map == X86_MAP_0F && insn->opcode == 0xC4) {
+            size = 2;
+        }
+        format_memory(fb, insn, size);
+    } else if (xmm) {
+        fb_append(fb, "%s", xmm_names[insn->rm & 15]);
+    } else {
+        fb_append(fb, "%s", x86_register_name(insn->rm, size, insn->rex != 0));
+    }
+}
+
+static void format_imm(FormatBuffer *fb, const X86DecodedInsn *insn) {
+    uint64_t value = (uint64_t)insn->imm;
+    if (insn->imm_size == 3) {
+        // ENTER iw, ib：解码时打包为 iw | ib << 16
+        fb_append(fb, "0x%llX, 0x%llX", (unsigned long long)(value & 0xFFFF), (unsigned long long)((value >> 16) & 0xFF));
+        return;
+    }
+    uint8_t size = insn->imm_size < insn->operand_size ? insn->operand_size : insn->imm_size;
+    if (size < 8) {
+        value &= (1ULL << (size * 8)) - 1;
+    }
+    fb_append(fb, "0x%llX", (unsigned long long)value);
+}
+
+static const char *primary_mnemonic(const X86DecodedInsn *insn) {
+    uint8_t op = insn->opcode;
+    uint8_t group_op = x86_insn_group_op(insn);
+
+    if (op < 0x40 && (op & 7) < 6) {
+        return alu_names[op >> 3];
+    }
+    if (op >= 0x50 && op <= 0x57) return "PUSH";
+    if (op >= 0x58 && op <= 0x5F) return "POP";
+    if (op >= 0x90 && op <= 0x97) {
+        if (op == 0x90 && insn->reg == 0) {
+            return (insn->prefixes & X86_PREFIX_REP) ? "PAUSE" : "NOP";
+        }
+        return "XCHG";
+    }
+    if (op >= 0xB0 && op <= 0xBF) return "MOV";
+    if (op >= 0xD8 && op <= 0xDF) return "FPU";
+
+    switch (op) {
+        case 0x80: case 0x81: case 0x83:
+            return alu_names[group_op];
+        case 0xC0: case 0xC1: case 0xD0: case 0xD1: case 0xD2: case 0xD3:
+            return shift_names[group_op];
+        case 0xF6: case 0xF7:
+            return group3_names[group_op];
+        case 0xFE:
+            return group_op == 0 ? "INC" : (group_op == 1 ? "DEC" : "(bad)");
+        case 0xFF:
+            return group5_names[group_op];
+        case 0x98:
+            return insn->operand_size == 8 ? "CDQE" : (insn->operand_size == 2 ? "CBW" : "CWDE");
+        case 0x99:
+            return insn->operand_size == 8 ? "CQO" : (insn->operand_size == 2 ? "CWD" : "CDQ");
+    }
+    return primary_names[op];
+}
+
+size_t x86_format_insn(const X86DecodedInsn *insn, uint64_t address, char *buffer, size_t buffer_size) {
+    if (!buffer || buffer_size == 0) {
+        return 0;
+    }
+    buffer[0] = '\0';
+    if (!insn || insn->length == 0) {
+        return 0;
+    }
+
+    FormatBuffer fb = { buffer, buffer_size, 0 };
+    const char *name = NULL;
+    char cc_name[16];
+    bool xmm = uses_xmm_operands(insn);
+    bool reg_xmm = xmm && !xmm_reg_is_gpr(insn);
+    bool rm_xmm = xmm && !xmm_rm_is_gpr(insn);
+    X86OperandForm form = (X86OperandForm)insn->form;
+
+    if (insn->prefixes & X86_PREFIX_LOCK) {
+        fb_append(&fb, "LOCK ");
+    }
+
+    if (insn->map == X86_MAP_PRIMARY) {
+        name = primary_mnemonic(insn);
+        if (insn->opcode >= 0x70 && insn->opcode <= 0x7F) {
+            snprintf(cc_name, sizeof(cc_name), "J%s", condition_names[insn->opcode & 15]);
+            name = cc_name;
+        }
+        // 字符串指令：REP前缀 + 宽度后缀
+        if (insn->opcode >= 0xA4 && insn->opcode <= 0xAF && insn->opcode != 0xA8 && insn->opcode != 0xA9) {
+            if (insn->prefixes & X86_PREFIX_REP) {
+                fb_append(&fb, (insn->opcode == 0xA6 || insn->opcode == 0xA7 ||
+                                insn->opcode == 0xAE || insn->opcode == 0xAF) ? "REPE " : "REP ");
+            } else if (insn->prefixes & X86_PREFIX_REPNE) {
+                fb_append(&fb, "REPNE ");
+            }
+            static const char suffix[9] = { 0, 'B', 'W', 0, 'D', 0, 0, 0, 'Q' };
+            fb_append(&fb, "%s%c", name, suffix[insn->operand_size]);
+            return fb.used;
+        }
+    } else if (insn->map == X86_MAP_0F) {
+        uint8_t op = insn->opcode;
+        if (op >= 0x40 && op <= 0x4F) {
+            snprintf(cc_name, sizeof(cc_name), "CMOV%s", condition_names[op & 15]);
+            name = cc_name;
+        } else if (op >= 0x80 && op <= 0x8F) {
+            snprintf(cc_name, sizeof(cc_name), "J%s", condition_names[op & 15]);
+            name = cc_name;
+        } else if (op >= 0x90 && op <= 0x9F) {
+            snprintf(cc_name, sizeof(cc_name), "SET%s", condition_names[op & 15]);
+            name = cc_name;
+        } else if (op >= 0xC8 && op <= 0xCF) {
+            name = "BSWAP";
+        } else {
+            name = secondary_mnemonic(insn);
+        }
+        // F3 0F 7E 是 MOVQ xmm, xmm/m64，方向与 MOVD r/m, xmm 相反
+        if (op == 0x7E && insn->mandatory_prefix == 0xF3) {
+            form = X86_FORM_REG_RM;
+        }
+    }
+
+    if (name) {
+        fb_append(&fb, "%s", name);
+    } else if (insn->map == X86_MAP_PRIMARY) {
+        fb_append(&fb, "DB 0x%02X", insn->opcode);
+        return fb.used;
+    } else {
+        static const char *const map_names[4] = { "", "0F", "0F38", "0F3A" };
+        fb_append(&fb, "%s_%02X", map_names[insn->map & 3], insn->opcode);
+    }
+
+    switch (form) {
+        case X86_FORM_NONE:
+            break;
+        case X86_FORM_REG_OPC:
+            if (insn->map == X86_MAP_PRIMARY && insn->opcode == 0x90 && insn->reg == 0) {
+                break;
+            }
+            fb_append(&fb, " ");
+            format_reg(&fb, insn, insn->reg, false);
+            if (insn->map == X86_MAP_PRIMARY && insn->opcode >= 0x91 && insn->opcode <= 0x97) {
+                fb_append(&fb, ", %s", x86_register_name(0, insn->operand_size, insn->rex != 0));
+            }
+            break;
+        case X86_FORM_REG_IMM:
+            fb_append(&fb, " ");
+            format_reg(&fb, insn, insn->reg, false);
+            fb_append(&fb, ", ");
+            format_imm(&fb, insn);
+            break;
+        case X86_FORM_RM:
+            fb_append(&fb, " ");
+            format_rm(&fb, insn, rm_xmm);
+            break;
+        case X86_FORM_RM_REG:
+            fb_append(&fb, " ");
+            format_rm(&fb, insn, rm_xmm);
+            fb_append(&fb, ", ");
+            format_reg(&fb, insn, insn->reg, reg_xmm);
+            if (insn->imm_size) {
+                fb_append(&fb, ", ");
+                format_imm(&fb, insn);
+            }
+            break;
+        case X86_FORM_REG_RM:
+            fb_append(&fb, " ");
+            format_reg(&fb, insn, insn->reg, reg_xmm);
+            fb_append(&fb, ", ");
+            format_rm(&fb, insn, rm_xmm);
+            break;
+        case X86_FORM_RM_IMM:
+            fb_append(&fb, " ");
+            format_rm(&fb, insn, rm_xmm);
+            fb_append(&fb, ", ");
+            format_imm(&fb, insn);
+            break;
+        case X86_FORM_REG_RM_IMM:
+            fb_append(&fb, " ");
+            format_reg(&fb, insn, insn->reg, reg_xmm);
+            fb_append(&fb, ", ");
+            format_rm(&fb, insn, rm_xmm);
+            fb_append(&fb, ", ");
+            format_imm(&fb, insn);
+            break;
+        case X86_FORM_ACC_IMM:
+            fb_append(&fb, " %s, ", x86_register_name(0, insn->operand_size, insn->rex != 0));
+            format_imm(&fb, insn);
+            break;
+        case X86_FORM_IMM:
+            fb_append(&fb, " ");
+            format_imm(&fb, insn);
+            break;
+        case X86_FORM_REL: {
+            uint64_t target = address + insn->length + (uint64_t)insn->imm;
+            fb_append(&fb, " 0x%llX", (unsigned long long)target);
+            break;
+        }
+        case X86_FORM_MOFFS: {
+            const char *acc = x86_register_name(0, insn->operand_size, false);
+            if (insn->opcode <= 0xA1) {
+                fb_append(&fb, " %s, [0x%llX]", acc, (unsigned long long)insn->imm);
+            } else {
+                fb_append(&fb, " [0x%llX], %s", (unsigned long long)insn->imm, acc);
+            }
+            break;
+        }
+    }
+
+    return fb.used;
+}
@@ -0,0 +1,131 @@
+// X86Decoder.h - 表驱动的x86-64指令解码器
+// 纯C实现，不依赖Foundation，可直接在Linux主机上编译（见 PortableTests/）
+#ifndef X86_DECODER_H
+#define X86_DECODER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define X86_MAX_INSN_LENGTH 15
+#define X86_REG_NONE        0xFF
+
+// 解码结果状态
+typedef enum X86DecodeStatus {
+    X86_DECODE_OK = 0,
+    X86_DECODE_TRUNCATED,      // 字节流在指令中途结束
+    X86_DECODE_INVALID,        // 64位模式下无效的操作码
+    X86_DECODE_TOO_LONG        // 超过15字节上限
+} X86DecodeStatus;
+
+// 操作码映射
+typedef enum X86OpcodeMap {
+    X86_MAP_PRIMARY = 0,       // 单字节操作码
+    X86_MAP_0F,                // 0F xx
+    X86_MAP_0F38,              // 0F 38 xx
+    X86_MAP_0F3A               // 0F 3A xx
+} X86OpcodeMap;
+
+// 操作数形式 - 执行器按形式分派，不需要再回看原始字节
+typedef enum X86OperandForm {
+    X86_FORM_NONE = 0,         // 无显式操作数: NOP, RET, CDQ...
+    X86_FORM_REG_OPC,          // 寄存器编码在操作码低3位: PUSH r, BSWAP r
+    X86_FORM_REG_IMM,          // 操作码寄存器 + 立即数: MOV r, imm
+    X86_FORM_RM,               // 单个 r/m: INC r/m, SETcc, POP r/m
+    X86_FORM_RM_REG,           // r/m <- reg: MOV r/m, r
+    X86_FORM_REG_RM,           // reg <- r/m: MOV r, r/m
+    X86_FORM_RM_IMM,           // r/m, imm: ADD r/m, imm
+    X86_FORM_REG_RM_IMM,       // reg, r/m, imm: IMUL r, r/m, imm
+    X86_FORM_ACC_IMM,          // AL/eAX, imm: ADD EAX, imm32
+    X86_FORM_IMM,              // 仅立即数: PUSH imm, RET imm16, INT imm8
+    X86_FORM_REL,              // 相对跳转: Jcc, JMP, CALL
+    X86_FORM_MOFFS             // MOV AL/eAX <-> [moffs]
+} X86OperandForm;
+
+// 前缀位
+enum {
+    X86_PREFIX_LOCK     = 1 << 0,
+    X86_PREFIX_REP      = 1 << 1,   // F3
+    X86_PREFIX_REPNE    = 1 << 2,   // F2
+    X86_PREFIX_OPSIZE   = 1 << 3,   // 66
+    X86_PREFIX_ADDRSIZE = 1 << 4,   // 67
+    X86_PREFIX_SEGMENT  = 1 << 5    // 段超越，具体段在 segment 字段
+};
+
+// 解码标志
+enum {
+    X86_INSN_HAS_MODRM  = 1 << 0,
+    X86_INSN_HAS_SIB    = 1 << 1,
+    X86_INSN_MEMORY     = 1 << 2,   // r/m 是内存操作数
+    X86_INSN_RIP_REL    = 1 << 3,   // [RIP + disp32]
+    X86_INSN_UNSAFE     = 1 << 4,   // 特权/IO/系统调用类指令
+    X86_INSN_BRANCH     = 1 << 5    // 会改变控制流（用于基本块划分）
+};
+
+// REX位
+#define X86_REX_W(rex) (((rex) >> 3) & 1)
+#define X86_REX_R(rex) (((rex) >> 2) & 1)
+#define X86_REX_X(rex) (((rex) >> 1) & 1)
+#define X86_REX_B(rex) ((rex) & 1)
+
+// 紧凑的操作数形式记录（约40字节），解码热路径只写这个结构
+typedef struct X86DecodedInsn {
+    uint8_t length;            // 指令总长度
+    uint8_t map;               // X86OpcodeMap
+    uint8_t opcode;            // 映射内的操作码字节
+    uint8_t form;              // X86OperandForm
+    uint16_t prefixes;         // X86_PREFIX_* 位
+    uint8_t rex;               // REX字节，无则为0
+    uint8_t segment;           // 段超越前缀字节，无则为0
+    uint8_t mandatory_prefix;  // 0F映射下的强制前缀: 0 / 0x66 / 0xF2 / 0xF3
+    uint8_t modrm;
+    uint8_t sib;
+    uint8_t mod;               // ModR/M.mod
+    uint8_t reg;               // ModR/M.reg（已合并REX.R，0-15）或操作码寄存器
+    uint8_t rm;                // ModR/M.rm（已合并REX.B，0-15），内存操作数时无意义
+    uint8_t base;              // 内存操作数基址寄存器，X86_REG_NONE表示无
+    uint8_t index;             // 内存操作数索引寄存器，X86_REG_NONE表示无
+    uint8_t scale;             // 1/2/4/8
+    uint8_t operand_size;      // 操作数字节数: 1/2/4/8
+    uint8_t address_size;      // 地址字节数: 4/8
+    uint8_t imm_size;          // 立即数字节数（ENTER为3）
+    uint8_t disp_size;         // 位移字节数: 0/1/4
+    uint8_t flags;             // X86_INSN_* 位
+    int32_t disp;              // 符号扩展后的位移
+    int64_t imm;               // 符号扩展后的立即数（MOV r64, imm64 为完整值）
+} X86DecodedInsn;
+
+// 解码单条指令；成功时返回 X86_DECODE_OK 且 insn->length > 0
+X86DecodeStatus x86_decode(const uint8_t *code, size_t max_length, X86DecodedInsn *insn);
+
+// 按需格式化助记符（Intel语法），返回写入的字符数（不含结尾0）
+// address 为该指令的客户机地址，用于计算相对跳转目标；未知时传0
+// 只在日志、反汇编等冷路径调用，解码本身不生成任何字符串
+size_t x86_format_insn(const X86DecodedInsn *insn, uint64_t address, char *buffer, size_t buffer_size);
+
+// 寄存器名（size为1/2/4/8字节；has_rex影响8位寄存器4-7的命名）
+const char *x86_register_name(uint8_t reg, uint8_t size, bool has_rex);
+
+// 辅助判定
+static inline bool x86_insn_is_memory(const X86DecodedInsn *insn) {
+    return (insn->flags & X86_INSN_MEMORY) != 0;
+}
+
+static inline bool x86_insn_is_branch(const X86DecodedInsn *insn) {
+    return (insn->flags & X86_INSN_BRANCH) != 0;
+}
+
+// ModR/M组指令（80/81/83/C1/F7/FF...）的子操作码，即未合并REX.R的 reg 字段
+static inline uint8_t x86_insn_group_op(const X86DecodedInsn *insn) {
+    return (uint8_t)((insn->modrm >> 3) & 7);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // X86_DECODER_H